@@ -0,0 +1,327 @@
+/*
+ * main.c - CAN log decoder
+ *
+ *  Expands the compressed CAN log records of a DPMU CAN log image back to
+ *  debug_log_t records, printed one per line as CSV, and reports the
+ *  compression ratio of the image.
+ *
+ *  The image is a dump of the CAN log region of the external flash: 16 bit
+ *  words, low byte first, starting at CAN_LOG_ADDRESS_START. The layout is
+ *  described in dpmu_cpu1/app/src/log.c, the constants and the delta decoder
+ *  are the firmware ones from dpmu_cpu1/app/inc/can_log_codec.h and
+ *  dpmu_cpu1/app/src/can_log_codec.c.
+ *
+ *  With -r the input is a download by SDO from index 0x4011, sub index
+ *  S_CAN_LOG_READ: a stream of records starting with a keyframe, without
+ *  sector headers and unused block ends.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "can_log_codec.h"
+
+#define DEBUG_LOG_WORDS             CAN_LOG_RECORD_RAW_WORDS
+
+/* word offset of a debug_log_t member */
+#define FIELD_OFFSET(member)        (offsetof(debug_log_t, member) / sizeof(uint16_t))
+
+/*
+ * The image holds debug_log_t as laid out by the C28x compiler: 16 bit
+ * words with 32 bit members on even words. The host layout is the same as
+ * long as the 32 bit members are 4 byte aligned, these fail when GlobalV.h
+ * changes in a way that breaks it.
+ */
+_Static_assert(sizeof(debug_log_t) == 62 * sizeof(uint16_t), "debug_log_t is not 62 words");
+_Static_assert(sizeof(can_log_sector_header_t) == 4 * sizeof(uint16_t), "can_log_sector_header_t is not 4 words");
+_Static_assert(FIELD_OFFSET(ISen1) == 2, "debug_log_t.ISen1 moved");
+_Static_assert(FIELD_OFFSET(cellVoltage) == 21, "debug_log_t.cellVoltage moved");
+_Static_assert(FIELD_OFFSET(counter) == 52, "debug_log_t.counter moved");
+_Static_assert(FIELD_OFFSET(CurrentTime) == 54, "debug_log_t.CurrentTime moved");
+_Static_assert(FIELD_OFFSET(address) == 58, "debug_log_t.address moved");
+_Static_assert(FIELD_OFFSET(cpu2_error_code) == 60, "debug_log_t.cpu2_error_code moved");
+
+typedef enum {
+    FIELD_U32,
+    FIELD_I16,
+    FIELD_U16
+} field_type_t;
+
+typedef struct {
+    const char *name;
+    uint16_t offset;            /* words into debug_log_t */
+    field_type_t type;
+    uint16_t count;
+} field_t;
+
+/* debug_log_t, dpmu_cpu1/common/inc/GlobalV.h */
+static const field_t fields[] = {
+    { "MagicNumber",               FIELD_OFFSET(MagicNumber),                FIELD_U32, 1 },
+    { "ISen1",                     FIELD_OFFSET(ISen1),                      FIELD_I16, 1 },
+    { "ISen2",                     FIELD_OFFSET(ISen2),                      FIELD_I16, 1 },
+    { "IF_1",                      FIELD_OFFSET(IF_1),                       FIELD_I16, 1 },
+    { "I_Dab2",                    FIELD_OFFSET(I_Dab2),                     FIELD_I16, 1 },
+    { "I_Dab3",                    FIELD_OFFSET(I_Dab3),                     FIELD_I16, 1 },
+    { "Vbus",                      FIELD_OFFSET(Vbus),                       FIELD_I16, 1 },
+    { "VStore",                    FIELD_OFFSET(VStore),                     FIELD_I16, 1 },
+    { "AvgVbus",                   FIELD_OFFSET(AvgVbus),                    FIELD_I16, 1 },
+    { "AvgVStore",                 FIELD_OFFSET(AvgVStore),                  FIELD_I16, 1 },
+    { "BaseBoardTemperature",      FIELD_OFFSET(BaseBoardTemperature),       FIELD_I16, 1 },
+    { "MainBoardTemperature",      FIELD_OFFSET(MainBoardTemperature),       FIELD_I16, 1 },
+    { "MezzanineBoardTemperature", FIELD_OFFSET(MezzanineBoardTemperature),  FIELD_I16, 1 },
+    { "PowerBankBoardTemperature", FIELD_OFFSET(PowerBankBoardTemperature),  FIELD_I16, 1 },
+    { "RegulateAvgInputCurrent",   FIELD_OFFSET(RegulateAvgInputCurrent),    FIELD_I16, 1 },
+    { "RegulateAvgOutputCurrent",  FIELD_OFFSET(RegulateAvgOutputCurrent),   FIELD_I16, 1 },
+    { "RegulateAvgVStore",         FIELD_OFFSET(RegulateAvgVStore),          FIELD_I16, 1 },
+    { "RegulateAvgVbus",           FIELD_OFFSET(RegulateAvgVbus),            FIELD_I16, 1 },
+    { "RegulateIRef",              FIELD_OFFSET(RegulateIRef),               FIELD_I16, 1 },
+    { "ILoop_PiOutput",            FIELD_OFFSET(ILoop_PiOutput),             FIELD_U16, 1 },
+    { "cellVoltage",               FIELD_OFFSET(cellVoltage),                FIELD_I16, NUMBER_OF_CELLS },
+    { "CurrentState",              FIELD_OFFSET(CurrentState),               FIELD_I16, 1 },
+    { "counter",                   FIELD_OFFSET(counter),                    FIELD_U32, 1 },
+    { "CurrentTime",               FIELD_OFFSET(CurrentTime),                FIELD_U32, 1 },
+    { "elapsed_time",              FIELD_OFFSET(elapsed_time),               FIELD_U16, 1 },
+    { "address",                   FIELD_OFFSET(address),                    FIELD_U32, 1 },
+    { "cpu2_error_code",           FIELD_OFFSET(cpu2_error_code),            FIELD_U16, 1 },
+};
+
+typedef struct {
+    uint32_t sector;
+    uint32_t sequence;
+} sector_order_t;
+
+static struct {
+    uint32_t sectors;
+    uint32_t keyframes;
+    uint32_t deltas;
+    uint32_t errors;
+    uint64_t storedWords;
+} stats;
+
+static uint16_t *image;
+static size_t imageWords;
+static int printRecords = 1;
+static int recordStream = 0;
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-s] [-r] image\n", name);
+    fprintf(stderr, "  -s  statistics only, do not print the records\n");
+    fprintf(stderr, "  -r  the image is a record stream, not the CAN log region\n");
+    exit(EXIT_FAILURE);
+}
+
+static void load_image(const char *fileName)
+{
+    FILE *file = fopen(fileName, "rb");
+    long size;
+    uint8_t *bytes;
+
+    if (file == NULL) {
+        perror(fileName);
+        exit(EXIT_FAILURE);
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    bytes = malloc(size);
+    image = malloc((size / 2 + 1) * sizeof(uint16_t));
+    if ((bytes == NULL) || (image == NULL) || (fread(bytes, 1, size, file) != (size_t)size)) {
+        fprintf(stderr, "%s: can not read image\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+
+    imageWords = size / 2;
+    for (size_t i = 0; i < imageWords; i++) {
+        image[i] = bytes[2 * i] | (bytes[2 * i + 1] << 8);
+    }
+    free(bytes);
+}
+
+static int compare_sequence(const void *a, const void *b)
+{
+    const sector_order_t *sa = a;
+    const sector_order_t *sb = b;
+
+    return (sa->sequence > sb->sequence) - (sa->sequence < sb->sequence);
+}
+
+static uint32_t get_u32(const uint16_t *words)
+{
+    return words[0] | ((uint32_t)words[1] << 16);
+}
+
+static void print_header(void)
+{
+    const char *separator = "";
+
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        for (uint16_t n = 0; n < fields[f].count; n++) {
+            if (fields[f].count > 1) {
+                printf("%s%s%u", separator, fields[f].name, n + 1);
+            } else {
+                printf("%s%s", separator, fields[f].name);
+            }
+            separator = ",";
+        }
+    }
+    printf("\n");
+}
+
+static void print_record(const uint16_t *record)
+{
+    const char *separator = "";
+
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        for (uint16_t n = 0; n < fields[f].count; n++) {
+            const uint16_t *value = &record[fields[f].offset + n];
+
+            switch (fields[f].type) {
+            case FIELD_U32:
+                printf("%s%lu", separator, (unsigned long)get_u32(value));
+                break;
+            case FIELD_I16:
+                printf("%s%d", separator, (int16_t)*value);
+                break;
+            case FIELD_U16:
+            default:
+                printf("%s%u", separator, *value);
+                break;
+            }
+            separator = ",";
+        }
+    }
+    printf("\n");
+}
+
+/* decodes the records following each other from a keyframe, a block or a record stream */
+static void decode_records(const uint16_t *block, size_t size)
+{
+    debug_log_t record;
+    size_t pos = 0;
+    int haveKeyframe = 0;
+
+    while (pos < size) {
+        uint16_t header = block[pos];
+        uint16_t words = CAN_LOG_RECORD_WORDS(header);
+        const uint16_t *payload = &block[pos + 1];
+
+        if (header == 0xFFFF) {
+            break;
+        }
+        if (pos + 1 + words > size) {
+            stats.errors++;
+            break;
+        }
+
+        if ((CAN_LOG_RECORD_TYPE(header) == CAN_LOG_RECORD_KEYFRAME) && (words == DEBUG_LOG_WORDS)) {
+            memcpy(&record, payload, sizeof(record));
+            haveKeyframe = 1;
+            stats.keyframes++;
+        } else if ((CAN_LOG_RECORD_TYPE(header) == CAN_LOG_RECORD_DELTA) && haveKeyframe &&
+                   can_log_decode_delta(payload, words, &record)) {
+            stats.deltas++;
+        } else {
+            /* the rest of the block can not be decoded */
+            stats.errors++;
+            break;
+        }
+
+        stats.storedWords += 1 + words;
+        if (printRecords) {
+            print_record((const uint16_t *)&record);
+        }
+        pos += 1 + words;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    sector_order_t *order;
+    uint32_t sectors;
+    uint32_t inUse = 0;
+    uint64_t rawWords;
+    clock_t start;
+    int c;
+
+    while ((c = getopt(argc, argv, "srh")) != -1) {
+        switch (c) {
+        case 's':
+            printRecords = 0;
+            break;
+        case 'r':
+            recordStream = 1;
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+    }
+
+    load_image(argv[optind]);
+
+    /* a record stream has no sector headers */
+    sectors = recordStream ? 0 : imageWords / CAN_LOG_SECTOR_SIZE;
+    order = calloc(sectors + 1, sizeof(sector_order_t));
+    if (order == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    /* sectors in use, oldest first */
+    for (uint32_t s = 0; s < sectors; s++) {
+        const uint16_t *header = &image[s * CAN_LOG_SECTOR_SIZE];
+        uint32_t sequence = get_u32(&header[2]);
+
+        if ((header[0] == CAN_LOG_MAGIC) && (sequence != 0) && (sequence != 0xFFFFFFFFu)) {
+            order[inUse].sector = s;
+            order[inUse].sequence = sequence;
+            inUse++;
+        }
+    }
+    qsort(order, inUse, sizeof(sector_order_t), compare_sequence);
+
+    if (printRecords) {
+        print_header();
+    }
+
+    start = clock();
+    if (recordStream) {
+        decode_records(image, imageWords);
+    }
+    for (uint32_t i = 0; i < inUse; i++) {
+        const uint16_t *sector = &image[order[i].sector * CAN_LOG_SECTOR_SIZE];
+
+        stats.sectors++;
+        for (uint32_t b = 0; b < CAN_LOG_BLOCKS_PER_SECTOR; b++) {
+            const uint16_t *block = &sector[CAN_LOG_SECTOR_HEADER_WORDS + b * CAN_LOG_BLOCK_WORDS];
+
+            if (block[0] == 0xFFFF) {
+                break;
+            }
+            decode_records(block, CAN_LOG_BLOCK_WORDS);
+        }
+    }
+
+    rawWords = (uint64_t)(stats.keyframes + stats.deltas) * DEBUG_LOG_WORDS;
+    fprintf(stderr, "sectors: %lu, keyframes: %lu, deltas: %lu, errors: %lu\n",
+            (unsigned long)stats.sectors, (unsigned long)stats.keyframes,
+            (unsigned long)stats.deltas, (unsigned long)stats.errors);
+    fprintf(stderr, "words raw: %llu, stored: %llu, compression ratio: %.2f, decode: %.1f ms\n",
+            (unsigned long long)rawWords, (unsigned long long)stats.storedWords,
+            stats.storedWords ? (double)rawWords / stats.storedWords : 0.0,
+            1000.0 * (clock() - start) / CLOCKS_PER_SEC);
+
+    free(order);
+    free(image);
+    return stats.errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/*
+ * test_roundtrip.c - CAN log encode and decode round trip
+ *
+ *  Encodes simulated debug_log_t records with the firmware encoder,
+ *  dpmu_cpu1/app/src/can_log_codec.c, into two images:
+ *
+ *  - a CAN log region laid out the way log.c writes it: sector headers,
+ *    keyframe blocks of CAN_LOG_BLOCK_WORDS, deltas and keyframes where a
+ *    delta does not pay, the first sector in use not being the first one of
+ *    the region so that the decoder has to order the sectors
+ *  - a record stream holding every record as a keyframe
+ *
+ *  "make test" decodes both with can_log_decode and compares the output, so
+ *  every field of every record has to survive the round trip.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "can_log_codec.h"
+
+#define REGION_SECTORS  3u
+#define FIRST_SECTOR    1u      /* sector taken into use first */
+
+static uint16_t region[REGION_SECTORS * CAN_LOG_SECTOR_SIZE];
+
+static void write_words(FILE *file, const uint16_t *words, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        fputc(words[i] & 0xFF, file);
+        fputc(words[i] >> 8, file);
+    }
+}
+
+/* a charge ramp with some noise, the way the firmware logs it */
+static void simulate(debug_log_t *record, uint32_t n)
+{
+    uint32_t noise = n * 2654435761u;
+
+    record->MagicNumber = 0xDEADBEEFu;
+    record->ISen1 = (int16_t)(1200 + (noise >> 28));
+    record->ISen2 = (int16_t)(1180 + ((noise >> 24) & 0xF));
+    record->IF_1 = (int16_t)(n % 7);
+    record->Vbus = (int16_t)(2400 + ((noise >> 20) & 0x3));
+    record->VStore = (int16_t)(n / 3);
+    record->AvgVbus = 2401;
+    record->AvgVStore = (int16_t)(n / 3);
+    record->BaseBoardTemperature = (int16_t)(25 + n / 1000);
+    record->RegulateIRef = (int16_t)((n < 100) ? 10 * n : 1000);
+    record->ILoop_PiOutput = (uint16_t)(noise >> 16);
+    for (uint16_t c = 0; c < NUMBER_OF_CELLS; c++) {
+        record->cellVoltage[c] = (int16_t)(n / 30 + c + ((noise >> c) & 1));
+    }
+    record->CurrentState = (int16_t)((n < 100) ? 3 : 4);
+    record->counter = n;
+    record->CurrentTime = 1700000000u + n / 10;
+    record->elapsed_time = (uint16_t)(n * 100);
+    record->cpu2_error_code = (n % 500 == 499) ? 0x8000u : 0;
+
+    /* every so often everything changes, a delta is larger than a keyframe */
+    if (n % 997 == 996) {
+        for (uint16_t c = 0; c < NUMBER_OF_CELLS; c++) {
+            record->cellVoltage[c] = (int16_t)(noise ^ (c * 0x9E37));
+        }
+        record->ISen1 = -20000;
+        record->ISen2 = 20000;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static uint16_t encoded[CAN_LOG_ENCODED_MAX_WORDS];
+    debug_log_t record;
+    debug_log_t previous;
+    uint32_t records;
+    uint32_t sector = FIRST_SECTOR;
+    uint32_t sequence = 0;          /* 0: no sector open yet */
+    uint32_t block = 0;
+    uint32_t next = 0;              /* next free word of the open block */
+    uint32_t blockEnd = 0;          /* 0: no open block */
+    uint64_t stored = 0;
+    FILE *regionFile;
+    FILE *streamFile;
+
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s records region.bin stream.bin\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    records = strtoul(argv[1], NULL, 0);
+    regionFile = fopen(argv[2], "wb");
+    streamFile = fopen(argv[3], "wb");
+    if ((regionFile == NULL) || (streamFile == NULL)) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+
+    memset(region, 0xFF, sizeof(region));
+    memset(&record, 0, sizeof(record));
+
+    for (uint32_t n = 0; n < records; n++) {
+        uint16_t words = 0;
+
+        simulate(&record, n);
+
+        if (blockEnd != 0) {
+            record.address = next;
+            words = can_log_encode_delta(&record, &previous, encoded);
+            if (words > CAN_LOG_KEYFRAME_WORDS) {
+                words = can_log_encode_keyframe(&record, encoded);
+            }
+            if (next + words > blockEnd) {
+                blockEnd = 0;
+                block++;
+            }
+        }
+
+        if (blockEnd == 0) {
+            if ((sequence == 0) || (block >= CAN_LOG_BLOCKS_PER_SECTOR)) {
+                uint16_t *header;
+
+                if (sequence != 0) {
+                    region[sector * CAN_LOG_SECTOR_SIZE + 1] = CAN_LOG_SECTOR_FULL;
+                    sector = (sector + 1) % REGION_SECTORS;
+                    if (sector == FIRST_SECTOR) {
+                        fprintf(stderr, "%u records do not fit in %u sectors\n", records, REGION_SECTORS);
+                        return EXIT_FAILURE;
+                    }
+                }
+                sequence++;
+                header = &region[sector * CAN_LOG_SECTOR_SIZE];
+                header[0] = CAN_LOG_MAGIC;
+                header[1] = CAN_LOG_SECTOR_OPEN;
+                header[2] = (uint16_t)sequence;
+                header[3] = (uint16_t)(sequence >> 16);
+                block = 0;
+            }
+            next = sector * CAN_LOG_SECTOR_SIZE + CAN_LOG_SECTOR_HEADER_WORDS + block * CAN_LOG_BLOCK_WORDS;
+            blockEnd = next + CAN_LOG_BLOCK_WORDS;
+            record.address = next;
+            words = can_log_encode_keyframe(&record, encoded);
+        }
+
+        memcpy(&region[next], encoded, words * sizeof(uint16_t));
+        next += words;
+        stored += words;
+        memcpy(&previous, &record, sizeof(record));
+
+        words = can_log_encode_keyframe(&record, encoded);
+        write_words(streamFile, encoded, words);
+    }
+
+    write_words(regionFile, region, sizeof(region) / sizeof(region[0]));
+    fclose(regionFile);
+    fclose(streamFile);
+
+    fprintf(stderr, "encoded %u records in %llu words\n", records, (unsigned long long)stored);
+    return EXIT_SUCCESS;
+}
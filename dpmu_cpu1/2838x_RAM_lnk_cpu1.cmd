@@ -50,7 +50,8 @@ MEMORY
    FLASH12          : origin = 0x0BC000, length = 0x002000  /* on-chip Flash */
    FLASH13          : origin = 0x0BE000, length = 0x002000  /* on-chip Flash */
    CPU1TOCPU2RAM    : origin = 0x03A000, length = 0x000800
-   CPU2TOCPU1RAM    : origin = 0x03B000, length = 0x000800
+   CPU2TOCPU1RAM    : origin = 0x03B000, length = 0x000300
+   CPU2TOCPU1RAM_LOG : origin = 0x03B300, length = 0x000500
 
    CPUTOCMRAM       : origin = 0x039000, length = 0x000800
    CMTOCPURAM       : origin = 0x038000, length = 0x000800
@@ -89,6 +90,7 @@ SECTIONS
 
    MSGRAM_CPU1_TO_CPU2 > CPU1TOCPU2RAM, type=NOINIT
    MSGRAM_CPU2_TO_CPU1 > CPU2TOCPU1RAM, type=NOINIT
+   MSGRAM_CPU2_TO_CPU1_LOG > CPU2TOCPU1RAM_LOG, type=NOINIT
    MSGRAM_CPU_TO_CM   > CPUTOCMRAM, type=NOINIT
    MSGRAM_CM_TO_CPU   > CMTOCPURAM, type=NOINIT
 
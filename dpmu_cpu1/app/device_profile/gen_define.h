@@ -17,8 +17,8 @@
 #define CO_REC_BUFFER_COUNTS	10u
 #define CO_TR_BUFFER_COUNTS	10u
 /* Number of objects per line */
-#define CO_OBJECTS_LINE_0_CNT	59u
-#define CO_OBJECT_COUNTS	59u
+#define CO_OBJECTS_LINE_0_CNT	60u
+#define CO_OBJECT_COUNTS	60u
 #define CO_COB_COUNTS	12u
 #define CO_TXPDO_COUNTS	4u
 #define CO_RXPDO_COUNTS	2u
@@ -50,9 +50,10 @@
 #define CO_STORE_NVS_CNT	0u
 #define CO_EMCY_ERROR_HISTORY 10u
 #define CO_SDO_BLOCK		1u
-#define CO_SDO_BLOCK_SIZE	4u
+#define CO_SDO_BLOCK_SIZE	127u
 #define CO_SDO_BLOCK_MIN_SIZE	4u
-#define CO_SSDO_DOMAIN_CNT	2u
+#define CO_SSDO_DOMAIN_CNT	32u
+#define CO_SDO_SPLIT_INDICATION	1u
 #define CO_INHIBIT_SUPPORTED	1u
 /* number of used COB objects */
 #define CO_COB_CNT	12u
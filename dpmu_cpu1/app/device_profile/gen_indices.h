@@ -196,6 +196,12 @@
 #define I_CAN_LOG                	0x4011u
 #define  S_CAN_LOG_READ           	0x1u
 #define  S_CAN_LOG_RESET          	0x2u
+#define  S_CAN_LOG_READ_FROM      	0x3u
+#define  S_CAN_LOG_READ_MAX       	0x4u
+#define  S_CAN_LOG_CURSOR         	0x5u
+#define I_STATE_MACHINE_STATS    	0x4012u
+#define  S_STATE_MACHINE_STATS_READ	0x1u
+#define  S_STATE_MACHINE_STATS_RESET	0x2u
 #define I_IO                     	0x6000u
 #define  S_STATE_OF_SWITCHES      	0x1u
 #define I_POLARITY_INPUT_8_BIT   	0x6002u
@@ -33,13 +33,13 @@
 /* definition of static indication function pointers */
 
 /* number of objects */
-#define CO_OD_ASSIGN_CNT 59u
-#define CO_OBJ_DESC_CNT 518u
+#define CO_OD_ASSIGN_CNT 60u
+#define CO_OBJ_DESC_CNT 524u
 
 /* definition of managed variables */
-static UNSIGNED8 CO_STORAGE_CLASS	od_u8[121];
+static UNSIGNED8 CO_STORAGE_CLASS	od_u8[122];
 static UNSIGNED16 CO_STORAGE_CLASS	od_u16[7];
-static UNSIGNED32 CO_STORAGE_CLASS	od_u32[261];
+static UNSIGNED32 CO_STORAGE_CLASS	od_u32[264];
 static INTEGER8  CO_STORAGE_CLASS	od_i8[9];
 static INTEGER16 CO_STORAGE_CLASS	od_i16[11];
 static INTEGER32 CO_STORAGE_CLASS	od_i32[7];
@@ -127,13 +127,16 @@ static CO_CONST UNSIGNED32 CO_CONST_STORAGE_CLASS	od_const_vis_string_len[1] = {
 	22};
 
 /* definition of application variables */
-static CO_DOMAIN_PTR	od_domain[2] = {
+static CO_DOMAIN_PTR	od_domain[3] = {
+	NULL,
 	NULL,
 	NULL};
-static UNSIGNED32 CO_STORAGE_CLASS	od_domain_len[2] = {
+static UNSIGNED32 CO_STORAGE_CLASS	od_domain_len[3] = {
+	0ul,
 	0ul,
 	0ul};
-static UNSIGNED32 CO_STORAGE_CLASS	od_domain_actLen[2] = {
+static UNSIGNED32 CO_STORAGE_CLASS	od_domain_actLen[3] = {
+	0ul,
 	0ul,
 	0ul};
 
@@ -602,9 +605,15 @@ CO_CONST CO_OBJECT_DESC_T CO_CONST_STORAGE_CLASS od_description[CO_OBJ_DESC_CNT]
 	{ (UNSIGNED8)1u, CO_DTYPE_U8_VAR   , (UNSIGNED16)95u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_WRITE | CO_ATTR_DEFVAL,  (UNSIGNED16)3u},/* 0x4010:1*/ 
 	{ (UNSIGNED8)2u, CO_DTYPE_DOMAIN   , (UNSIGNED16)0u, CO_ATTR_READ,  (UNSIGNED16)0u},/* 0x4010:2*/ 
 	{ (UNSIGNED8)3u, CO_DTYPE_U8_VAR   , (UNSIGNED16)96u, CO_ATTR_NUM | CO_ATTR_WRITE,  (UNSIGNED16)0u},/* 0x4010:3*/ 
-	{ (UNSIGNED8)0u, CO_DTYPE_U8_CONST , (UNSIGNED16)5u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_DEFVAL,  (UNSIGNED16)5u},/* 0x4011:0*/ 
+	{ (UNSIGNED8)0u, CO_DTYPE_U8_CONST , (UNSIGNED16)6u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_DEFVAL,  (UNSIGNED16)6u},/* 0x4011:0*/ 
 	{ (UNSIGNED8)1u, CO_DTYPE_DOMAIN   , (UNSIGNED16)1u, CO_ATTR_READ,  (UNSIGNED16)0u},/* 0x4011:1*/ 
 	{ (UNSIGNED8)2u, CO_DTYPE_U8_VAR   , (UNSIGNED16)97u, CO_ATTR_NUM | CO_ATTR_WRITE,  (UNSIGNED16)0u},/* 0x4011:2*/ 
+	{ (UNSIGNED8)3u, CO_DTYPE_U32_VAR  , (UNSIGNED16)261u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_WRITE | CO_ATTR_DEFVAL,  (UNSIGNED16)1u},/* 0x4011:3*/ 
+	{ (UNSIGNED8)4u, CO_DTYPE_U32_VAR  , (UNSIGNED16)262u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_WRITE | CO_ATTR_DEFVAL,  (UNSIGNED16)1u},/* 0x4011:4*/ 
+	{ (UNSIGNED8)5u, CO_DTYPE_U32_VAR  , (UNSIGNED16)263u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_DEFVAL,  (UNSIGNED16)1u},/* 0x4011:5*/ 
+	{ (UNSIGNED8)0u, CO_DTYPE_U8_CONST , (UNSIGNED16)5u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_DEFVAL,  (UNSIGNED16)5u},/* 0x4012:0*/ 
+	{ (UNSIGNED8)1u, CO_DTYPE_DOMAIN   , (UNSIGNED16)2u, CO_ATTR_READ,  (UNSIGNED16)0u},/* 0x4012:1*/ 
+	{ (UNSIGNED8)2u, CO_DTYPE_U8_VAR   , (UNSIGNED16)121u, CO_ATTR_NUM | CO_ATTR_WRITE,  (UNSIGNED16)0u},/* 0x4012:2*/ 
 	{ (UNSIGNED8)0u, CO_DTYPE_U8_CONST , (UNSIGNED16)3u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_DEFVAL,  (UNSIGNED16)3u},/* 0x6000:0*/ 
 	{ (UNSIGNED8)1u, CO_DTYPE_U8_VAR   , (UNSIGNED16)98u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_WRITE | CO_ATTR_MAP_TR | CO_ATTR_MAP_REC | CO_ATTR_DEFVAL,  (UNSIGNED16)3u},/* 0x6000:1*/ 
 	{ (UNSIGNED8)0u, CO_DTYPE_U8_CONST , (UNSIGNED16)8u, CO_ATTR_NUM | CO_ATTR_READ | CO_ATTR_DEFVAL,  (UNSIGNED16)8u},/* 0x6002:0*/ 
@@ -705,21 +714,22 @@ CO_CONST CO_OD_ASSIGN_T CO_CONST_STORAGE_CLASS od_assign[CO_OD_ASSIGN_CNT] = {
 	{ 0x4002u, 1u, 0u, CO_ODTYPE_VAR, 457u },
 	{ 0x4003u, 1u, 0u, CO_ODTYPE_VAR, 458u },
 	{ 0x4010u, 4u, 3u, CO_ODTYPE_STRUCT, 459u },
-	{ 0x4011u, 3u, 2u, CO_ODTYPE_STRUCT, 463u },
-	{ 0x6000u, 2u, 1u, CO_ODTYPE_ARRAY, 466u },
-	{ 0x6002u, 4u, 3u, CO_ODTYPE_ARRAY, 468u },
-	{ 0x6005u, 1u, 0u, CO_ODTYPE_VAR, 472u },
-	{ 0x6006u, 4u, 3u, CO_ODTYPE_ARRAY, 473u },
-	{ 0x6007u, 4u, 3u, CO_ODTYPE_ARRAY, 477u },
-	{ 0x6008u, 4u, 3u, CO_ODTYPE_ARRAY, 481u },
-	{ 0x6200u, 7u, 6u, CO_ODTYPE_ARRAY, 485u },
-	{ 0x6202u, 2u, 1u, CO_ODTYPE_ARRAY, 492u },
-	{ 0x6401u, 4u, 4u, CO_ODTYPE_ARRAY, 494u },
-	{ 0x6411u, 9u, 8u, CO_ODTYPE_ARRAY, 498u },
-	{ 0x6421u, 2u, 1u, CO_ODTYPE_ARRAY, 507u },
-	{ 0x6423u, 1u, 0u, CO_ODTYPE_VAR, 509u },
-	{ 0x6424u, 4u, 4u, CO_ODTYPE_ARRAY, 510u },
-	{ 0x6425u, 4u, 4u, CO_ODTYPE_ARRAY, 514u },
+	{ 0x4011u, 6u, 5u, CO_ODTYPE_STRUCT, 463u },
+	{ 0x4012u, 3u, 2u, CO_ODTYPE_STRUCT, 469u },
+	{ 0x6000u, 2u, 1u, CO_ODTYPE_ARRAY, 472u },
+	{ 0x6002u, 4u, 3u, CO_ODTYPE_ARRAY, 474u },
+	{ 0x6005u, 1u, 0u, CO_ODTYPE_VAR, 478u },
+	{ 0x6006u, 4u, 3u, CO_ODTYPE_ARRAY, 479u },
+	{ 0x6007u, 4u, 3u, CO_ODTYPE_ARRAY, 483u },
+	{ 0x6008u, 4u, 3u, CO_ODTYPE_ARRAY, 487u },
+	{ 0x6200u, 7u, 6u, CO_ODTYPE_ARRAY, 491u },
+	{ 0x6202u, 2u, 1u, CO_ODTYPE_ARRAY, 498u },
+	{ 0x6401u, 4u, 4u, CO_ODTYPE_ARRAY, 500u },
+	{ 0x6411u, 9u, 8u, CO_ODTYPE_ARRAY, 504u },
+	{ 0x6421u, 2u, 1u, CO_ODTYPE_ARRAY, 513u },
+	{ 0x6423u, 1u, 0u, CO_ODTYPE_VAR, 515u },
+	{ 0x6424u, 4u, 4u, CO_ODTYPE_ARRAY, 516u },
+	{ 0x6425u, 4u, 4u, CO_ODTYPE_ARRAY, 520u },
 };
 
 /* static PDO mapping tables */
@@ -17,19 +17,12 @@ typedef enum {
     MANUFACTURER_PARAMETER_LAST
 }  manufacturer_parameter_idx_t;
 
-typedef enum {
-    AppVarsRead,
-    AppVarsWrite,
-    AppVarsWait
-} app_vars_cmd_t;
-
 typedef enum {
     CapacitanceAppVar,
     SerialNumberAppVar,
     AllAppVars
 } app_vars_type_t;
 
-void ResetHandleAppVarsOnExternalFlashSM();
 void AppVarsReadRequest();
 bool AppVarsReadRequestReady();
 void AppVarsSaveRequest(app_vars_t *newAppVarsToSave, app_vars_type_t appVarType);
@@ -0,0 +1,40 @@
+/*
+ * can_bench.h
+ *
+ *  SDO and PDO timing against the object dictionary, on the virtual CAN bus
+ *  (CODRV_VBUS), see can_bench.c.
+ *
+ *  Bus times are in bits, at the bit rate of codrvVbusBitRate() they give
+ *  the time the transfer would take on a real bus.
+ */
+
+#ifndef APP_INC_CAN_BENCH_H_
+#define APP_INC_CAN_BENCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    CAN_BENCH_SDO_UPLOAD,           /* expedited or segmented, chosen by the server */
+    CAN_BENCH_SDO_BLOCK_UPLOAD,
+    CAN_BENCH_SDO_DOWNLOAD          /* writes back the value read, expedited up to 4 bytes */
+} can_bench_sdo_t;
+
+typedef struct {
+    uint32_t transfers;             /* transfers done */
+    uint32_t bytes;                 /* payload of all transfers */
+    uint32_t frames;                /* frames on the bus, both directions */
+    uint32_t busBits;               /* bus time of all transfers */
+    uint32_t maxBusBits;            /* longest transfer */
+    uint32_t cycles;                /* CPU time of all transfers */
+    uint32_t maxCycles;
+    uint32_t abortCode;             /* SDO abort of the last transfer, 0 - none */
+} can_bench_result_t;
+
+// Transfers index:subIndex loops times, false on a timeout or an abort.
+bool can_bench_sdo(can_bench_sdo_t kind, uint16_t index, uint8_t subIndex,
+                   uint8_t blockSize, uint16_t loops, can_bench_result_t *result);
+// Requests TPDO pdoNr loops times, the latency lasts until the bench has the frame.
+bool can_bench_tpdo(uint16_t pdoNr, uint16_t loops, can_bench_result_t *result);
+
+#endif /* APP_INC_CAN_BENCH_H_ */
@@ -0,0 +1,53 @@
+/*
+ * can_log_codec.h
+ *
+ *  Layout and record encoding of the CAN log region, see log.c.
+ *
+ *  Nothing here touches the hardware, the host tool can_log_decode builds
+ *  can_log_codec.c as well. Sizes are in 16 bit words, sizeof() is divided
+ *  by sizeof(uint16_t) so that they hold on the host too.
+ */
+
+#ifndef APP_INC_CAN_LOG_CODEC_H_
+#define APP_INC_CAN_LOG_CODEC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "GlobalV.h"
+
+#define CAN_LOG_MAGIC       0x55AAu     /* CAN log sector header */
+
+#define CAN_LOG_SECTOR_OPEN 0xFFFFu     /* records are added to the sector */
+#define CAN_LOG_SECTOR_FULL 0x0000u     /* programmed when the log moves on to the next sector */
+
+/* record header word: type in the top 4 bits, payload words below */
+#define CAN_LOG_RECORD_KEYFRAME             0x1u    /* a copy of the debug_log_t */
+#define CAN_LOG_RECORD_DELTA                0x2u    /* changed words bitmap and zigzag varints */
+#define CAN_LOG_RECORD_HEADER(type, words)  ((uint16_t)(((type) << 12) | (words)))
+#define CAN_LOG_RECORD_TYPE(header)         ((uint16_t)(header) >> 12)
+#define CAN_LOG_RECORD_WORDS(header)        ((uint16_t)(header) & 0x0FFFu)
+
+/* first words of every sector of the CAN log region */
+typedef struct {
+    uint16_t magic;                 /* CAN_LOG_MAGIC */
+    uint16_t state;                 /* CAN_LOG_SECTOR_OPEN or CAN_LOG_SECTOR_FULL */
+    uint32_t sequence;              /* one higher for each sector taken into use, starts at 1 */
+} can_log_sector_header_t;
+
+#define CAN_LOG_SECTOR_SIZE         0x8000u     /* SA4..SA18 are all 32k words */
+#define CAN_LOG_SECTOR_HEADER_WORDS (sizeof(can_log_sector_header_t) / sizeof(uint16_t))
+#define CAN_LOG_BLOCK_WORDS         256u        /* keyframe interval */
+#define CAN_LOG_BLOCKS_PER_SECTOR   ((uint16_t)((CAN_LOG_SECTOR_SIZE - CAN_LOG_SECTOR_HEADER_WORDS) / CAN_LOG_BLOCK_WORDS))
+
+#define CAN_LOG_RECORD_RAW_WORDS    (sizeof(debug_log_t) / sizeof(uint16_t))
+#define CAN_LOG_KEYFRAME_WORDS      (1 + CAN_LOG_RECORD_RAW_WORDS)
+#define CAN_LOG_DELTA_BITMAP_BYTES  ((CAN_LOG_RECORD_RAW_WORDS + 7) / 8)
+#define CAN_LOG_DELTA_MAX_BYTES     (CAN_LOG_DELTA_BITMAP_BYTES + 3 * CAN_LOG_RECORD_RAW_WORDS)
+#define CAN_LOG_ENCODED_MAX_WORDS   (1 + (CAN_LOG_DELTA_MAX_BYTES + 1) / 2)
+
+uint16_t can_log_encode_keyframe(const debug_log_t *record, uint16_t *encoded);
+uint16_t can_log_encode_delta(const debug_log_t *record, const debug_log_t *previous, uint16_t *encoded);
+bool can_log_decode_delta(const uint16_t *payload, uint16_t words, debug_log_t *record);
+
+#endif /* APP_INC_CAN_LOG_CODEC_H_ */
@@ -10,8 +10,14 @@
 
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "co_datatype.h"
 
 bool check_changes_from_CPU2(void);
+uint8_t cpu2_state_machine_stats_read(UNSIGNED16 index, UNSIGNED8 subIndex);
+void cpu2_state_machine_stats_read_domain(uint32_t offset, uint32_t size);
+void cpu2_state_machine_stats_reset(void);
 
 
 #endif /* APP_INC_CHECK_CPU2_H_ */
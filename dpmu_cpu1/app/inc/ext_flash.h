@@ -36,13 +36,11 @@
 //#define APP_VARS_EXT_FLASH_ADDRESS_START   ( EXT_FLASH_START_ADDRESS_CS3 ) + 0x100
 #define APP_VARS_EXT_FLASH_ADDRESS_END     ( APP_VARS_EXT_FLASH_ADDRESS_START + (APP_VARS_EXT_FLASH_SIZE - 1) )
 
+// Parameter store, two sectors used in turn, see param_store.c
+#define PARAM_STORE_SECTOR_SIZE         0x1000
+#define PARAM_STORE_SECTOR_A_ADDRESS    ( EXT_FLASH_START_ADDRESS_CS3 + 0x3000 /*ex_flash_info[EXT_FLASH_SA2].addr*/)
+#define PARAM_STORE_SECTOR_B_ADDRESS    ( EXT_FLASH_START_ADDRESS_CS3 + 0x4000 /*ex_flash_info[EXT_FLASH_SA3].addr*/)
 
-typedef enum {
-    EXT_FLASH_BUF_WRITE_DONE = 0,
-    EXT_FLASH_BUF_WAITING,
-    EXT_FLASH_BUF_WRITE_ONGOING,
-    EXT_FLASH_BUF_WRITE_TIME_OUT
-} ext_flash_buff_write_status_t;
 
 typedef enum {
     EXT_FLASH_SA0 = 0,
@@ -83,6 +81,65 @@ typedef enum {
     EXT_FLASH_SA_LAST
 } ext_flash_sector_t;
 
+/**
+ * Program command counters.
+ */
+typedef struct ext_flash_stats
+{
+    uint32_t programs;              // word and write buffer program commands
+    uint32_t words;                 // words programmed
+    uint32_t busCycles;             // bus write cycles of the program commands
+    uint32_t timeouts;              // program commands that did not complete
+} ext_flash_stats_t;
+
+/**
+ * Erase commands per sector since reset, a chip erase counts for every sector.
+ */
+typedef struct ext_flash_wear
+{
+    uint32_t chipErases;
+    uint32_t sectorErases[EXT_FLASH_SA_LAST];
+} ext_flash_wear_t;
+
+/**
+ * Queued flash operations, see ext_flash_task().
+ */
+typedef enum {
+    EXT_FLASH_OP_PROGRAM = 0,
+    EXT_FLASH_OP_ERASE_SECTOR,
+    EXT_FLASH_OP_ERASE_CHIP,
+    EXT_FLASH_OP_TYPES
+} ext_flash_op_type_t;
+
+typedef enum {
+    EXT_FLASH_OP_OK = 0,
+    EXT_FLASH_OP_TIME_OUT,
+    EXT_FLASH_OP_FAIL               // program range not erased, the rest of the operation was not programmed
+} ext_flash_op_status_t;
+
+// Called from ext_flash_task() when a queued operation is done.
+typedef void (*ext_flash_op_callback_t)(ext_flash_op_status_t status, void *context);
+
+typedef struct ext_flash_op
+{
+    ext_flash_op_type_t type;
+    uint32_t addr;
+    const uint16_t *buf;            // program only
+    size_t len;                     // program only, words left
+    ext_flash_op_callback_t callback;
+    void *context;
+} ext_flash_op_t;
+
+#define EXT_FLASH_LATENCY_BINS  16
+#define EXT_FLASH_LATENCY_BIN0  16      // us, bin n: latency < (EXT_FLASH_LATENCY_BIN0 << n), last bin the rest
+
+typedef struct ext_flash_latency
+{
+    uint32_t count;
+    uint32_t maxUs;
+    uint32_t histogram[EXT_FLASH_LATENCY_BINS];
+} ext_flash_latency_t;
+
 /**
  * A structure describing the layout etc. of the external flash sectors.
  */
@@ -122,27 +179,49 @@ uint16_t ext_flash_read_word(uint32_t addr);
  */
 void ext_flash_read_buf(uint32_t addr, uint16_t *buf, size_t len);
 
+/*
+ * The blocking program and erase functions below first run the queued
+ * operations to completion, see ext_flash_task(), then hold the flash for
+ * their own command.
+ */
+
 /**
  * Programs single 16b word to Flash address.
+ * Returns false if the word is not erased or the command did not complete.
+ */
+bool ext_flash_write_word(uint32_t addr, uint16_t data);
+
+/**
+ * Programs up to one write buffer page of 16b words to Flash address.
+ * Returns the number of words consumed from buf, 0 if the page range is not
+ * erased or the command did not complete.
+ */
+size_t ext_flash_write_page(uint32_t addr, const uint16_t *buf, size_t len);
+
+/**
+ * Number of words, at most len, one program command can write from addr.
  */
-void ext_flash_write_word(uint32_t addr, uint16_t data);
+size_t ext_flash_page_words(uint32_t addr, size_t len);
 
 /**
  * Programs buffer of 16b words to Flash address.
+ * Returns false at the first page that could not be programmed.
  */
-void ext_flash_write_buf(uint32_t addr, uint16_t *buf, size_t len);
+bool ext_flash_write_buf(uint32_t addr, uint16_t *buf, size_t len);
 
 /**
  * Erases entire Flash memory space.
+ * Returns false if the erase did not complete in time.
  */
-void ext_flash_chip_erase(void);
+bool ext_flash_chip_erase(void);
 
 /**
  * Erases addressed Flash sector.
+ * Returns false if the erase did not complete in time.
  */
 //void ext_flash_erase_sector(uint32_t addr);
-void ext_flash_erase_sector_by_descriptor(ext_flash_desc_t *sector_desc);
-void ext_flash_erase_sector(uint32_t sa);
+bool ext_flash_erase_sector_by_descriptor(ext_flash_desc_t *sector_desc);
+bool ext_flash_erase_sector(uint32_t sa);
 void start_ext_flash_erase_sector(uint32_t sa);
 bool verify_ext_flash_erase_sector_done();
 
@@ -162,40 +241,53 @@ void ext_flash_config(void);
 void ext_flash_test(void);
 
 /**
- * Verifies if the flash is ready after an erase
+ * Shows program command counters, command latencies and sector wear.
  */
-bool ext_flash_ready(void);
+void ext_flash_print_stats(void);
 
 /**
- * Asserts command to fully erase the flash memory
+ * Queue program and erase operations. Return false if the queue is full.
+ * The callback, if any, is called from ext_flash_task(). A program
+ * operation reaching words that are not erased stops with EXT_FLASH_OP_FAIL.
  */
-void ext_command_flash_chip_erase(void);
+bool ext_flash_queue_program(uint32_t addr, const uint16_t *buf, size_t len,
+                             ext_flash_op_callback_t callback, void *context);
+bool ext_flash_queue_erase_sector(uint32_t addr, ext_flash_op_callback_t callback, void *context);
+bool ext_flash_queue_chip_erase(ext_flash_op_callback_t callback, void *context);
 
 /**
- * Initialize the parameters for the non ext_flash_non_blocking_read_buf function
+ * True when no queued operation is pending or in progress.
  */
-void ext_flash_init_non_blocking_read(uint32_t addr, uint16_t *bufferAddr, size_t len);
+bool ext_flash_idle(void);
 
+/**
+ * Runs the operation queue, called from the super loop.
+ */
+void ext_flash_task(void);
 
 /**
- * Initialize the parameters for the non ext_flash_non_blocking_write_buf function
+ * Verifies if the flash is ready after an erase
  */
-void ext_flash_init_non_blocking_write(uint32_t addr, uint16_t *bufferAddr, size_t len);
+bool ext_flash_ready(void);
 
 /**
- * Reads buffer of 16b words from flash address without blocking in a while loop.
+ * Initialize the parameters for the non ext_flash_non_blocking_read_buf function
  */
-bool ext_flash_non_blocking_read_buf();
+void ext_flash_init_non_blocking_read(uint32_t addr, uint16_t *bufferAddr, size_t len);
 
 /**
- * Write buffer of 16b words from flash address without blocking in a while loop.
- * Returns status of the writing.
- *      EXT_FLASH_BUF_WAITING,
- *      EXT_FLASH_BUF_WRITE_ONGOING,
- * When done OK returns EXT_FLASH_BUF_WRITE_DONE
- * When done NOT OK returns EXT_FLASH_BUF_WRITE_TIME_OUT
+ * Reads buffer of 16b words from flash address without blocking in a while loop.
  */
-ext_flash_buff_write_status_t ext_flash_non_blocking_write_buf();
+bool ext_flash_non_blocking_read_buf();
+
+// Program command counters.
+extern ext_flash_stats_t ext_flash_stats;
+
+// Command latencies per operation type.
+extern ext_flash_latency_t ext_flash_latency[EXT_FLASH_OP_TYPES];
+
+// Erase commands per sector.
+extern ext_flash_wear_t ext_flash_wear;
 
 // Information base describing the external flash.
 extern const ext_flash_desc_t ex_flash_info[];
@@ -203,6 +295,12 @@ extern const ext_flash_desc_t ex_flash_info[];
 // Data buffer mapped to external flash. (CS3 area is max 1MB.)
 extern uint16_t g_ext_flash_data[EXT_FLASH_SIZE_CS3];
 
+#if !defined(__TMS320C28XX__)
+// Host builds, bus cycles to the CS3 window, see host_test/nor_flash.c.
+uint16_t ext_flash_bus_read(uint32_t addr);
+void ext_flash_bus_write(uint32_t addr, uint16_t data);
+#endif
+
 
 
 #endif /* APP_INC_EXT_FLASH_H_ */
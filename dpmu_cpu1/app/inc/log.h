@@ -12,8 +12,7 @@
 #include "co_odaccess.h"
 #include "co_datatype.h"
 #include "GlobalV.h"
-
-#define CAN_LOG_MAGIC       0x55AAu
+#include "can_log_codec.h"
 
 #define FIRST_LOG_SECTOR    EXT_FLASH_SA4
 #define LAST_LOG_SECTOR     EXT_FLASH_SA34
@@ -28,7 +27,6 @@ typedef enum  {
     WriteToFlash,
     WaitWriteToFlashDone,
     ReadBackLogFromFlash,
-    WaitReadLogFromFlashDone,
     StartEraseAllCanLogFlash,
     EraseCANLogFlashSector,
     WaitingEraseDone,
@@ -80,7 +78,10 @@ typedef struct{
 extern unsigned char  message[];
 
 RET_T log_debug_log_set_state(uint8_t value);
-void log_read_domain(UNSIGNED16 index, UNSIGNED8 subindex, UNSIGNED32 domainBufSize, UNSIGNED32 domainTransferedSize);
+RET_T log_read_domain(UNSIGNED16 index, UNSIGNED8 subindex, UNSIGNED32 domainBufSize, UNSIGNED32 domainTransferedSize);
+void log_read_domain_finished(UNSIGNED16 index, UNSIGNED8 subindex, UNSIGNED32 transferedSize, RET_T result);
+void log_domain_prefetch(void);
+void log_domain_print_stats(void);
 uint8_t log_debug_log_read(
         BOOL_T      execute,
         UNSIGNED8   sdoNr,
@@ -126,7 +127,9 @@ void log_can_read_non_blocking_start(uint32_t canLogFlashSourceAddress,
                                      unsigned char *dataBuffer,
                                      uint16_t size_in_words );
 bool log_can_read_non_blocking_done();
-bool calc_next_free_addr_and_verify_erase_sector(uint32_t can_log_current_write_address,
-                                                 uint16_t log_size_in_words);
+bool calc_next_free_addr_and_verify_erase_sector(uint32_t *can_log_write_address,
+                                                 debug_log_t *record);
 void print_log_can_to_serial(debug_log_t *readBack );
+void log_debug_log_print_stats(void);
+void log_can_print_stats(void);
 #endif /* COAPPL_LOG_H_ */
@@ -0,0 +1,58 @@
+/*
+ * param_store.h
+ *
+ *  Key-value store for parameters in external flash, see param_store.c.
+ *
+ *  Values are read from a RAM copy made when the store is mounted, setting
+ *  a value updates the RAM copy at once and the flash later, from
+ *  param_store_task(). Nothing here waits for the flash.
+ */
+
+#ifndef APP_INC_PARAM_STORE_H_
+#define APP_INC_PARAM_STORE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "GlobalV.h"
+
+typedef enum {
+    PARAM_KEY_CAPACITANCE = 1,      /* param_capacitance_t */
+    PARAM_KEY_SERIAL_NUMBER,        /* SERIAL_NUMBER_SIZE_IN_CHARS unsigned char */
+    PARAM_KEYS
+} param_key_t;
+
+typedef struct {
+    float initialCapacitance;
+    float currentCapacitance;
+} param_capacitance_t;
+
+typedef struct {
+    uint32_t mountCycles;           /* duration of the last mount */
+    uint16_t mountRecords;          /* records read by the last mount */
+    bool     imported;              /* the last mount took the values from the old app_vars_t log */
+    uint32_t records;               /* records committed */
+    uint32_t compactions;
+    uint32_t errors;                /* flash operations that failed or timed out */
+    uint32_t verifyErrors;          /* compactions aborted, the copy read back differed */
+    uint32_t lastCommitMs;          /* from queuing a record to its commit word being programmed */
+    uint32_t maxCommitMs;
+} param_store_stats_t;
+
+extern param_store_stats_t param_store_stats;
+
+void param_store_mount(void);
+bool param_store_mounted(void);
+// Copies the value of key to value, false if the key has never been set.
+bool param_store_get(param_key_t key, void *value);
+// Sets the value of key, false if the key is unknown.
+bool param_store_set(param_key_t key, const void *value);
+// True when every value set is committed to flash.
+bool param_store_committed(void);
+// Writes values set to flash, called from the super loop.
+void param_store_task(void);
+// Stops flash accesses, while the entire flash is erased.
+void param_store_suspend(bool suspend);
+void param_store_print_stats(void);
+
+#endif /* APP_INC_PARAM_STORE_H_ */
@@ -17,6 +17,24 @@
 extern struct lfs_config ext_flash_lfs_config;
 extern lfs_t ext_flash_lfs;
 
+/**
+ * Block device counters, the cycles are IPC counter cycles spent in the
+ * callbacks.
+ */
+typedef struct lfs_api_bd_stats
+{
+    uint32_t reads;
+    uint32_t readWords;
+    uint32_t readCycles;
+    uint32_t progs;
+    uint32_t progWords;
+    uint32_t progCycles;
+    uint32_t erases;
+    uint32_t eraseCycles;
+} lfs_api_bd_stats_t;
+
+extern lfs_api_bd_stats_t lfs_api_bd_stats;
+
 /**
  * Read a region in a block. Negative error codes are propagated to the user.
  */
@@ -69,4 +87,16 @@ int lfs_api_unmount_filesystem(void);
  */
 int lfs_api_show_directory_contents(const char *dir_name);
 
+/**
+ * Times mount, file creation, append, read back and traversal of the
+ * filesystem and shows the block device counters. Erases nothing but the
+ * blocks littlefs allocates, the files are removed again.
+ */
+int lfs_api_benchmark(uint16_t files, uint32_t words);
+
+/**
+ * Shows the block device counters.
+ */
+void lfs_api_print_bd_stats(void);
+
 #endif /* APP_LITTLEFS_INC_LFS_API_H_ */
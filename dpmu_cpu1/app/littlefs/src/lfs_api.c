@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "driverlib.h"
 #include "device.h"
@@ -21,14 +23,34 @@
 #define EMIF1_CS4N_START_ADD               0x00380000U
 #define EMIF1_CS4N_END_ADD                 0x003DFFFFU
 
+/*
+ * Sizes are in 16 bit words, the "bytes" of this CPU. Reads are copied from
+ * the flash in runs, programs use the write buffer, so large caches cost
+ * RAM only. Each open file mallocs one more cache, mind the heap size.
+ */
+#ifndef LFS_MIN_READ_SIZE
 #define LFS_MIN_READ_SIZE   16                  // min read size
-#define LFS_MIN_PROG_SIZE   16                  // min write size
+#endif
+#ifndef LFS_MIN_PROG_SIZE
+#define LFS_MIN_PROG_SIZE   32                  // min write size, one write buffer page
+#endif
 #define LFS_BLOCK_SIZE      0x8000              // size of erasable block in bytes
 #define LFS_BLOCK_COUNT     31                  // number of erasable blocks
-#define LFS_CACHE_SIZE      16                  // size of block cache in bytes
-#define LFS_LOOKAHEAD_SIZE  32                  // size of lookahead buffer in bytes
+#ifndef LFS_CACHE_SIZE
+#define LFS_CACHE_SIZE      128                 // size of block cache in bytes
+#endif
+#ifndef LFS_LOOKAHEAD_SIZE
+#define LFS_LOOKAHEAD_SIZE  8                   // size of lookahead buffer in bytes, 64 blocks
+#endif
 #define LFS_BLOCK_CYCLES    100
 
+#if (LFS_CACHE_SIZE % LFS_MIN_READ_SIZE) || (LFS_CACHE_SIZE % LFS_MIN_PROG_SIZE) || (LFS_BLOCK_SIZE % LFS_CACHE_SIZE)
+#error "LFS_CACHE_SIZE must be a multiple of the read and prog sizes and divide the block size"
+#endif
+#if (LFS_LOOKAHEAD_SIZE % 8) || (8 * LFS_LOOKAHEAD_SIZE < LFS_BLOCK_COUNT)
+#error "LFS_LOOKAHEAD_SIZE must be a multiple of 8 and cover all blocks"
+#endif
+
 /**
  * Local data.
  */
@@ -44,6 +66,7 @@ static lfs_file_t file;
  * Global data.
  */
 lfs_t ext_flash_lfs;
+lfs_api_bd_stats_t lfs_api_bd_stats;
 
 struct lfs_config ext_flash_lfs_config = {
         // block device operations
@@ -70,16 +93,28 @@ struct lfs_config ext_flash_lfs_config = {
 
 extern struct Serial cli_serial;
 
+/**
+ * The blocking flash functions must not run while a queued operation,
+ * e.g. a CAN log page, is in progress.
+ */
+static void lfs_api_wait_flash_idle(void)
+{
+    while (!ext_flash_idle()) {
+        ext_flash_task();
+    }
+}
+
 int lfs_api_block_device_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
 {
     uint32_t address = EMIF1_CS3N_START_ADD + SECTOR_OFFSET + c->block_size * block + off;
+    uint32_t start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
 
-    uint16_t *dst = buffer;
+    lfs_api_wait_flash_idle();
+    ext_flash_read_buf(address, buffer, size);
 
-    for (uint32_t i = 0; i < size; ++i) {
-        uint16_t data = ext_flash_read_word(address + i);
-        *dst++ = data;
-    }
+    lfs_api_bd_stats.reads++;
+    lfs_api_bd_stats.readWords += size;
+    lfs_api_bd_stats.readCycles += (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start;
 
     return LFS_ERR_OK;
 }
@@ -87,25 +122,34 @@ int lfs_api_block_device_read(const struct lfs_config *c, lfs_block_t block, lfs
 int lfs_api_block_device_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
 {
     uint32_t address = EMIF1_CS3N_START_ADD + SECTOR_OFFSET + c->block_size * block + off;
+    uint32_t start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    bool ok;
 
-    const uint16_t *src = buffer;
+    lfs_api_wait_flash_idle();
+    // one write buffer command per page, the prog size keeps the pages whole
+    ok = ext_flash_write_buf(address, (uint16_t *)buffer, size);
 
-    for (uint32_t i = 0; i < size; ++i) {
-        uint16_t data;
-        data = *src++;
-        ext_flash_write_word(address + i, data);
-    }
+    lfs_api_bd_stats.progs++;
+    lfs_api_bd_stats.progWords += size;
+    lfs_api_bd_stats.progCycles += (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start;
 
-    return LFS_ERR_OK;
+    // not erased or timed out, littlefs treats the block as bad and relocates
+    return ok ? LFS_ERR_OK : LFS_ERR_CORRUPT;
 }
 
 int lfs_api_block_device_erase(const struct lfs_config *c, lfs_block_t block)
 {
     uint32_t address = EMIF1_CS3N_START_ADD + SECTOR_OFFSET + c->block_size * block;
+    uint32_t start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    bool ok;
 
-    ext_flash_erase_sector(address);
+    lfs_api_wait_flash_idle();
+    ok = ext_flash_erase_sector(address);
 
-    return LFS_ERR_OK;
+    lfs_api_bd_stats.erases++;
+    lfs_api_bd_stats.eraseCycles += (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start;
+
+    return ok ? LFS_ERR_OK : LFS_ERR_CORRUPT;
 }
 
 int lfs_api_block_device_sync(const struct lfs_config *c)
@@ -404,3 +448,139 @@ void lfs_api_file_system_test(void)
 
     lfs_api_unmount_filesystem();
 }
+
+#define LFS_API_BENCH_CHUNK     64              // words per lfs_file_write()
+
+static uint16_t l_bench_buffer[LFS_API_BENCH_CHUNK];
+
+static uint32_t lfs_api_ms(uint32_t cycles)
+{
+    return cycles / (DEVICE_SYSCLK_FREQ / 1000);
+}
+
+static int lfs_api_count_block(void *data, lfs_block_t block)
+{
+    (void)block;
+    (*(uint32_t *)data)++;
+    return 0;
+}
+
+void lfs_api_print_bd_stats(void)
+{
+    Serial_printf(&cli_serial, " reads: %lu, %lu words, %lu ms\r\n", lfs_api_bd_stats.reads,
+                  lfs_api_bd_stats.readWords, lfs_api_ms(lfs_api_bd_stats.readCycles));
+    Serial_printf(&cli_serial, " progs: %lu, %lu words, %lu ms\r\n", lfs_api_bd_stats.progs,
+                  lfs_api_bd_stats.progWords, lfs_api_ms(lfs_api_bd_stats.progCycles));
+    Serial_printf(&cli_serial, " erases: %lu, %lu ms\r\n", lfs_api_bd_stats.erases,
+                  lfs_api_ms(lfs_api_bd_stats.eraseCycles));
+}
+
+static void lfs_api_bench_result(const char *step, uint32_t start)
+{
+    Serial_printf(&cli_serial, "%-10s %8lu ms\r\n", step,
+                  lfs_api_ms((uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start));
+    lfs_api_print_bd_stats();
+    memset(&lfs_api_bd_stats, 0, sizeof(lfs_api_bd_stats));
+}
+
+int lfs_api_benchmark(uint16_t files, uint32_t words)
+{
+    char name[16];
+    uint32_t start;
+    uint32_t done;
+    uint32_t blocks = 0;
+    uint16_t f;
+    uint16_t i;
+    lfs_size_t chunk;
+    int err;
+
+    memset(&lfs_api_bd_stats, 0, sizeof(lfs_api_bd_stats));
+
+    start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    err = lfs_api_mount_filesystem();
+    if (err) {
+        return err;
+    }
+    lfs_api_bench_result("mount", start);
+
+    do {
+        start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+        for (f = 0; f < files; f++) {
+            snprintf(name, sizeof(name), "bench_%u", f);
+            if ((err = lfs_file_open(&ext_flash_lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC)) < 0) {
+                break;
+            }
+            if ((err = lfs_file_close(&ext_flash_lfs, &file)) < 0) {
+                break;
+            }
+        }
+        if (err < 0) {
+            break;
+        }
+        lfs_api_bench_result("create", start);
+
+        /* append to the first file, a counting pattern read back below */
+        start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+        if ((err = lfs_file_open(&ext_flash_lfs, &file, "bench_0", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND)) < 0) {
+            break;
+        }
+        for (done = 0; done < words; done += chunk) {
+            chunk = (words - done < LFS_API_BENCH_CHUNK) ? words - done : LFS_API_BENCH_CHUNK;
+            for (i = 0; i < chunk; i++) {
+                l_bench_buffer[i] = (uint16_t)(done + i);
+            }
+            if ((err = lfs_file_write(&ext_flash_lfs, &file, l_bench_buffer, chunk)) < 0) {
+                break;
+            }
+        }
+        if (err < 0) {
+            lfs_file_close(&ext_flash_lfs, &file);
+            break;
+        }
+        if ((err = lfs_file_close(&ext_flash_lfs, &file)) < 0) {
+            break;
+        }
+        lfs_api_bench_result("append", start);
+
+        start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+        if ((err = lfs_file_open(&ext_flash_lfs, &file, "bench_0", LFS_O_RDONLY)) < 0) {
+            break;
+        }
+        for (done = 0; done < words; done += chunk) {
+            chunk = (words - done < LFS_API_BENCH_CHUNK) ? words - done : LFS_API_BENCH_CHUNK;
+            if ((err = lfs_file_read(&ext_flash_lfs, &file, l_bench_buffer, chunk)) < 0) {
+                break;
+            }
+            for (i = 0; i < chunk; i++) {
+                if (l_bench_buffer[i] != (uint16_t)(done + i)) {
+                    err = LFS_ERR_CORRUPT;
+                    break;
+                }
+            }
+            if (err < 0) {
+                break;
+            }
+        }
+        lfs_file_close(&ext_flash_lfs, &file);
+        if (err < 0) {
+            break;
+        }
+        lfs_api_bench_result("read", start);
+
+        start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+        if ((err = lfs_fs_traverse(&ext_flash_lfs, lfs_api_count_block, &blocks)) < 0) {
+            break;
+        }
+        Serial_printf(&cli_serial, "%lu blocks in use\r\n", blocks);
+        lfs_api_bench_result("traverse", start);
+
+        for (f = 0; f < files; f++) {
+            snprintf(name, sizeof(name), "bench_%u", f);
+            lfs_remove(&ext_flash_lfs, name);
+        }
+    } while (0);
+
+    lfs_api_unmount_filesystem();
+
+    return (err < 0) ? err : 0;
+}
@@ -12,396 +12,117 @@
 #include "application_vars.h"
 #include "ext_flash.h"
 #include "fwupdate.h"
+#include "param_store.h"
 #include "serial.h"
 
 extern struct Serial cli_serial;
 
+/*
+ * The application variables are kept by the parameter store, see
+ * param_store.c. The functions below map app_vars_t to its keys.
+ */
 
-enum HAVSMStates { HAVWaitCommand = 0, HAVReadInit, HAVReadCurrentAppVars,
-                   HAVSaveInit, HAVSaveNewAppVarsToFlash, HAVResetSM};
-static States_t HAVSM = { 0 };
-
-uint32_t appVarsNextFreeAddress = APP_VARS_EXT_FLASH_ADDRESS_START;
-app_vars_t currentAppVars;
-app_vars_t newAppVars;
-bool currentAppVarsValid = false;
-bool startReadAppVarsFlag = false;
-bool startSaveAppVarsToFlashFlag = false;
-bool newAppVarsAvailableFlag = false;
-bool CANLogEntireFlashResetInitiated = false;
-bool CANLogEntireFlashResetReady = false;
-
-app_vars_type_t appVarTypeToSave;
-app_vars_cmd_t appVarsCommand = AppVarsWait;
-
+static app_vars_t currentAppVars;
 
-bool RetriveAppVarsFromExtFlash();
-bool SaveNewAppVarsToExtFlash();
-void PrepareNewAppVarToSave();
 
 void AppVarsReadRequest() {
-    appVarsCommand = AppVarsRead;
+    // otherwise mounted by HandleAppVarsOnExternalFlashSM() once the flash is idle
+    if( ( param_store_mounted() == false ) && ( ext_flash_idle() == true ) ) {
+        param_store_mount();
+    }
 }
 
 bool AppVarsReadRequestReady() {
-    return currentAppVarsValid;
+    return param_store_mounted();
 }
 
 app_vars_t* GetCurrentAppVars() {
+    param_capacitance_t capacitance;
+    bool valid;
+
+    memset( &currentAppVars, 0, sizeof(app_vars_t) );
+    valid = param_store_get( PARAM_KEY_CAPACITANCE, &capacitance );
+    if( valid == true ) {
+        currentAppVars.initialCapacitance = capacitance.initialCapacitance;
+        currentAppVars.currentCapacitance = capacitance.currentCapacitance;
+    }
+    if( param_store_get( PARAM_KEY_SERIAL_NUMBER, currentAppVars.serialNumber ) == true ) {
+        valid = true;
+    }
+    currentAppVars.MagicNumber = valid ? MAGIC_NUMBER : 0xFFFFFFFF;
     return &currentAppVars;
 }
 
 
 void AppVarsSaveRequest(app_vars_t *newAppVarsToSave, app_vars_type_t appVarType) {
-    appVarsCommand = AppVarsWrite;
-    memcpy( &newAppVars, newAppVarsToSave, sizeof(app_vars_t) );
-    newAppVarsAvailableFlag = true;
-    currentAppVarsValid = false;
-    appVarTypeToSave = appVarType;
+    param_capacitance_t capacitance;
+
+    capacitance.initialCapacitance = newAppVarsToSave->initialCapacitance;
+    capacitance.currentCapacitance = newAppVarsToSave->currentCapacitance;
+
+    switch( appVarType ) {
+        case CapacitanceAppVar:
+            param_store_set( PARAM_KEY_CAPACITANCE, &capacitance );
+            break;
+        case SerialNumberAppVar:
+            param_store_set( PARAM_KEY_SERIAL_NUMBER, newAppVarsToSave->serialNumber );
+            break;
+        case AllAppVars:
+            param_store_set( PARAM_KEY_CAPACITANCE, &capacitance );
+            param_store_set( PARAM_KEY_SERIAL_NUMBER, newAppVarsToSave->serialNumber );
+            break;
+        default:
+            break;
+    }
 }
 
 bool AppVarsSaveRequestReady() {
-    if( newAppVarsAvailableFlag == true ) {
-        return false;
-    } else {
-        return true;
-    }
+    return param_store_committed();
 }
 
 void AppVarsInformEntireFlashResetInitiated(){
-    CANLogEntireFlashResetInitiated = true;
+    param_store_suspend( true );
 }
 
 void AppVarsInformEntireFlashResetReady(){
-    CANLogEntireFlashResetReady = true;
+    // the store is mounted again by HandleAppVarsOnExternalFlashSM()
+    param_store_suspend( false );
 }
 
 void HandleAppVarsOnExternalFlashSM() {
-
-    switch( HAVSM.State_Current ) {
-
-        case HAVWaitCommand:
-            switch ( appVarsCommand ) {
-                case AppVarsRead:
-                    HAVSM.State_Next = HAVReadInit;
-                    break;
-                case AppVarsWrite:
-                    HAVSM.State_Next = HAVSaveInit;
-                    break;
-                case AppVarsWait:
-                default:
-                    HAVSM.State_Next = HAVWaitCommand;
-
-            }
-            appVarsCommand = AppVarsWait;
-
-            break;
-
-        case HAVReadInit:
-            if( currentAppVarsValid == false ) {
-                startReadAppVarsFlag = true;
-                HAVSM.State_Next = HAVReadCurrentAppVars;
-            } else {
-                startReadAppVarsFlag = false;
-                HAVSM.State_Next = HAVWaitCommand;
-            }
-            break;
-
-        case HAVReadCurrentAppVars:
-            if( RetriveAppVarsFromExtFlash() == true ) {
-                HAVSM.State_Next = HAVWaitCommand;
-            }
-            break;
-
-        case HAVSaveInit:
-            if( newAppVarsAvailableFlag == true ) {
-                HAVSM.State_Next = HAVSaveNewAppVarsToFlash;
-                startSaveAppVarsToFlashFlag = true;
-            } else {
-                HAVSM.State_Next = HAVWaitCommand;
-            }
-            break;
-
-        case HAVSaveNewAppVarsToFlash:
-            if( SaveNewAppVarsToExtFlash() == true ) {
-                newAppVarsAvailableFlag = false;
-                HAVSM.State_Next = HAVReadInit;
-            }
-            break;
-
-        case HAVResetSM:
-            if( CANLogEntireFlashResetReady == true ){
-                appVarsNextFreeAddress = APP_VARS_EXT_FLASH_ADDRESS_START;
-                currentAppVarsValid = false;
-                startReadAppVarsFlag = false;
-                startSaveAppVarsToFlashFlag = false;
-                newAppVarsAvailableFlag = false;
-                appVarsCommand = AppVarsWait;
-                CANLogEntireFlashResetInitiated = false;
-                CANLogEntireFlashResetReady = false;
-                HAVSM.State_Next = HAVWaitCommand;
-            }
-            break;
-
-        default:
-            HAVSM.State_Next = HAVWaitCommand;
-    }
-    //if( HAVSM.State_Current != HAVSM.State_Next ) {
-    //    Serial_debug(DEBUG_INFO, &cli_serial, "HAVSM.State_Current[%d] -> HAVSM.State_Next[%d]\r\n", HAVSM.State_Current, HAVSM.State_Next );
-    //}
-    if( CANLogEntireFlashResetInitiated == true){
-        HAVSM.State_Next = HAVResetSM;
-        CANLogEntireFlashResetReady = false;
-    }
-    HAVSM.State_Current = HAVSM.State_Next;
-
+    param_store_task();
 }
 
-bool SaveNewAppVarsToExtFlash( ) {
-
-    static bool retVal = false;
-    enum SNASMStates { SNAWaitStart = 0, SNAInit, SNAEraseSector, SNAWaitSectorEraseDone,
-        SNAPrepareForWrite, SNAWrite, SNAEnd};
-    static States_t SNASM = { 0 };
-    static ext_flash_desc_t appVarsExtFlashDescToErase;
-    uint16_t status;
-
-    retVal = false;
-    switch( SNASM.State_Current ) {
-
-        case SNAWaitStart:
-            if( startSaveAppVarsToFlashFlag == true ) {
-                startSaveAppVarsToFlashFlag = false;
-                SNASM.State_Next = SNAInit;
-            }
-            break;
-
-        case SNAInit:
-            if( appVarsNextFreeAddress == APP_VARS_EXT_FLASH_ADDRESS_START) {
-                SNASM.State_Next = SNAEraseSector;
-            } else {
-                SNASM.State_Next = SNAPrepareForWrite;
-            }
-            break;
 
-        case SNAEraseSector:
-            memcpy( &appVarsExtFlashDescToErase,
-                    ext_flash_sector_from_address( APP_VARS_EXT_FLASH_ADDRESS_START ),
-                    sizeof(ext_flash_desc_t) );
-            Serial_debug( DEBUG_INFO, &cli_serial, "Before appVarsExtFlashDescToErase addr:[0x%08p] sector:[%u]\r\n",
-                          appVarsExtFlashDescToErase.addr, appVarsExtFlashDescToErase.sector );
-            appVarsExtFlashDescToErase.addr =  APP_VARS_EXT_FLASH_ADDRESS_START;
-            Serial_debug( DEBUG_INFO, &cli_serial, "After appVarsExtFlashDescToErase addr:[0x%08p] sector:[%u]\r\n",
-                          appVarsExtFlashDescToErase.addr, appVarsExtFlashDescToErase.sector );
-            ext_flash_erase_sector_by_descriptor( &appVarsExtFlashDescToErase );
-            SNASM.State_Next = SNAWaitSectorEraseDone;
-            break;
-
-        case SNAWaitSectorEraseDone:
-            if( ext_flash_ready() ) {
-                SNASM.State_Next = SNAPrepareForWrite;
-            }
-            break;
-
-        case SNAPrepareForWrite:
-            PrepareNewAppVarToSave();
-//            Serial_debug(DEBUG_INFO, &cli_serial, "Saving to ext flash addr[0x%08p]\r\nnewAppVars.magicNumber:[0x%08p]\r\n",
-//                         appVarsNextFreeAddress, newAppVars.MagicNumber);
-//            Serial_debug(DEBUG_INFO, &cli_serial, "newAppVars.initialCapacitance[%6.2f], newAppVars.currentCapacitance:[%6.2f]\r\n",
-//                         newAppVars.initialCapacitance, newAppVars.currentCapacitance);
-//            Serial_debug(DEBUG_INFO, &cli_serial, "newAppVars.SerialNumber:[0..%d]:[", (SERIAL_NUMBER_SIZE_IN_CHARS-1) );
-//            for(int i=0;i<SERIAL_NUMBER_SIZE_IN_CHARS;i++) {
-//                Serial_debug(DEBUG_INFO, &cli_serial, "%d ", newAppVars.serialNumber[i]);
-//            }
-//            Serial_debug(DEBUG_INFO, &cli_serial, "]\r\n");
-            ext_flash_init_non_blocking_write( appVarsNextFreeAddress, (uint16_t *)&newAppVars, sizeof(app_vars_t) );
-            SNASM.State_Next = SNAWrite;
-            break;
+/**
+ * Returns the next 3 characters of the serial number, cycling through it.
+ * Bits 24..31 are the index of the characters, bits 0..23 the characters.
+ */
+bool RetriveSerialNumberFromFlash( uint32_t *serialNumber32bits ){
 
-        case SNAWrite:
-            status = ext_flash_non_blocking_write_buf();
-            //Serial_debug(DEBUG_INFO, &cli_serial, "ext_flash_non_blocking_write_buf status=[%d]\r\n", status);
-            if( status ==  EXT_FLASH_BUF_WRITE_DONE || status == EXT_FLASH_BUF_WRITE_TIME_OUT) {
-                SNASM.State_Next = SNAEnd;
-            }
-            break;
-        case SNAEnd:
-            retVal = true;
-            SNASM.State_Next = SNAWaitStart;
-            break;
-        default:
-            SNASM.State_Next = SNAWaitStart;
+    static uint32_t serialNumberIdx = 0;
+    unsigned char serialNumber[SERIAL_NUMBER_SIZE_IN_CHARS];
+    uint32_t charTemp;
+    uint16_t auxIdx;
 
+    if( param_store_get( PARAM_KEY_SERIAL_NUMBER, serialNumber ) == false ) {
+        memset( serialNumber, 0xFF, sizeof(serialNumber) );
     }
-    //if( SNASM.State_Current != SNASM.State_Next ) {
-    //    Serial_debug(DEBUG_INFO, &cli_serial, "SNASM.State_Current[%d] -> SNASM.State_Next[%d]\r\n", SNASM.State_Current, SNASM.State_Next );
-    //}
-    SNASM.State_Current = SNASM.State_Next;
-    return retVal;
-}
-
-bool RetriveAppVarsFromExtFlash() {
-    enum RAVSMStates { RAVWaitStart = 0, RAVInit, RAVVerifyDataValidFromFlash, RAVNextAddress,
-                            RAVVerifyNextMemoryEmptyInFlash, RAVEnd };
-    static States_t RAVSM = { 0 };
-    static bool validDataFound = false;
-    static bool retValue = false;
-    static uint32_t addr = APP_VARS_EXT_FLASH_ADDRESS_START;
-    static app_vars_t emptyAppVars;
-
-    switch ( RAVSM.State_Current) {
-        case RAVWaitStart:
-            retValue = false;
-            if( startReadAppVarsFlag == true ) {
-                startReadAppVarsFlag = false;
-                RAVSM.State_Next = RAVInit;
-            }
-            break;
-
-        case RAVInit:
-            addr = APP_VARS_EXT_FLASH_ADDRESS_START;
-            RAVSM.State_Next = RAVVerifyDataValidFromFlash;
-            ext_flash_init_non_blocking_read(addr, (uint16_t *)&currentAppVars, sizeof(app_vars_t) );
-            break;
-
-        case RAVVerifyDataValidFromFlash:
-            if( ext_flash_non_blocking_read_buf() == true ) {
-                //Serial_debug(DEBUG_INFO, &cli_serial, "Read from flash addr:[0x%08p]\r\ncurrentAppVars MagicNumber[0x%08p]\r\n", addr, currentAppVars.MagicNumber );
-                //Serial_debug(DEBUG_INFO, &cli_serial, "currentAppVars.initialCapacitance[%6.2f], currentAppVars.currentCapacitance:[%6.2f]\r\n",
-                //             currentAppVars.initialCapacitance, currentAppVars.currentCapacitance);
-
-                //Serial_debug(DEBUG_INFO, &cli_serial, "currentAppVars.SerialNumber:[0..%d]:[", (SERIAL_NUMBER_SIZE_IN_CHARS-1) );
-                //for(int i=0;i<SERIAL_NUMBER_SIZE_IN_CHARS;i++) {
-                //    Serial_debug(DEBUG_INFO, &cli_serial, "%d ", currentAppVars.serialNumber[i]);
-                //}
-                //Serial_debug(DEBUG_INFO, &cli_serial, "]\r\n");
-
-                if( currentAppVars.MagicNumber == MAGIC_NUMBER) {
-                    validDataFound = true;
-                }
-                RAVSM.State_Next = RAVNextAddress;
-            }
-            break;
-
-        case RAVNextAddress:
-            addr = addr + sizeof(app_vars_t);
-            if( ( addr >= APP_VARS_EXT_FLASH_ADDRESS_END ) ||
-                ( (addr + sizeof(app_vars_t) ) >= APP_VARS_EXT_FLASH_ADDRESS_END ) ) {
-                appVarsNextFreeAddress = APP_VARS_EXT_FLASH_ADDRESS_START;
-                RAVSM.State_Next = RAVEnd;
-            } else {
-                ext_flash_init_non_blocking_read(addr, (uint16_t *)&emptyAppVars, sizeof(app_vars_t) );
-                if( validDataFound == true ) {
-                    RAVSM.State_Next = RAVVerifyNextMemoryEmptyInFlash;
-                } else {
-                    RAVSM.State_Next = RAVVerifyDataValidFromFlash;
-                }
-            }
-            break;
 
-        case RAVVerifyNextMemoryEmptyInFlash:
-            if( ext_flash_non_blocking_read_buf() == true ) {
-                //Serial_debug(DEBUG_INFO, &cli_serial, "RAVVerifyNextMemoryEmptyInFlash addr:[0x%08p]\r\ncurrentAppVars MagicNumber[0x%08p]\r\n", addr, currentAppVars.MagicNumber );
-                if( emptyAppVars.MagicNumber == 0xFFFFFFFF) {
-                        appVarsNextFreeAddress =  addr;
-                        RAVSM.State_Next = RAVEnd;
-                } else {
-                    validDataFound = false;
-                    ext_flash_init_non_blocking_read(addr, (uint16_t *)&currentAppVars, sizeof(app_vars_t) );
-                    RAVSM.State_Next = RAVVerifyDataValidFromFlash;
-                }
-            }
-            break;
-
-        case RAVEnd:
-            currentAppVarsValid = true;
-            retValue = true;
-            RAVSM.State_Next = RAVWaitStart;
-            break;
+    *serialNumber32bits = (serialNumberIdx & 0x000000FF) << 24;
+    auxIdx = serialNumberIdx * 3;
+    for( int i=0; i<3; i++) {
+        charTemp = serialNumber[auxIdx+i] & 0xFF;
+        *serialNumber32bits = *serialNumber32bits | (charTemp << (8*i));
     }
-    //if( RAVSM.State_Current != RAVSM.State_Next ) {
-    //    Serial_debug(DEBUG_INFO, &cli_serial, "RAVSM.State_Current[%d] -> RAVSM.State_Next[%d]\r\n", RAVSM.State_Current, RAVSM.State_Next );
-    //}
-    RAVSM.State_Current = RAVSM.State_Next;
+    Serial_debug(DEBUG_INFO, &cli_serial, "Partial SN[%lu]:[0x%08p]\r\n", serialNumberIdx, *serialNumber32bits );
 
-    return retValue;
-}
-
-
-bool RetriveSerialNumberFromFlash( uint32_t *serialNumber32bits ){
-
-    enum RSNStates { RSNInit, RSNRetriveFromFlash, RSNReturnPartialSerialNumber, RSNIncremetIdx };
-    static States_t RSNSM = { 0 };
-    static app_vars_t *appVars;
-    static bool retVal = false;
-    uint32_t mask[]={0x000000FF, 0x0000FF00, 0x00FF0000};
-    uint32_t charTemp;
-    uint32_t serNumberCMD;
-    static uint32_t serialNumberIdx =0;
-    uint16_t auxIdx = 0;
-    static uint16_t timeOutCount;
-    static app_vars_t appVarsTimeout;
-
-    retVal = false;
-
-    switch( RSNSM.State_Current ) {
-        case RSNInit:
-            AppVarsReadRequest();
-            RSNSM.State_Next = RSNRetriveFromFlash;
-            serialNumberIdx = 0;
-            timeOutCount = 0;
-            break;
-        case RSNRetriveFromFlash:
-            HandleAppVarsOnExternalFlashSM();
-            timeOutCount++;
-            if( AppVarsReadRequestReady() ) {
-                appVars = GetCurrentAppVars();
-                Serial_debug(DEBUG_INFO, &cli_serial, "Retrieved appVars->serialNumber = [");
-                for(int i = 0; i<SERIAL_NUMBER_SIZE_IN_CHARS;i++) {
-                    Serial_debug(DEBUG_INFO, &cli_serial, "%c ", appVars->serialNumber[i]);
-                }
-                Serial_debug(DEBUG_INFO, &cli_serial, "]\r\n");
-                RSNSM.State_Next = RSNReturnPartialSerialNumber;
-                Serial_debug(DEBUG_CRITICAL, &cli_serial, "RetriveSerialNumberFromFlash ended with timeOutCount=[%d]\r\n", timeOutCount );
-            }
-            if(timeOutCount==65535){
-                strncpy( (char *)appVarsTimeout.serialNumber, "TIME OUT READING SERIAL NUMBER", SERIAL_NUMBER_SIZE_IN_CHARS);
-                appVars = &appVarsTimeout;
-                RSNSM.State_Next = RSNReturnPartialSerialNumber;
-                Serial_debug(DEBUG_CRITICAL, &cli_serial, "RetriveSerialNumberFromFlash ended with timeOutCount=[%d]\r\n", timeOutCount );
-            }
-            break;
-        case RSNReturnPartialSerialNumber:
-            serNumberCMD = (serialNumberIdx & 0x000000FF) << 24;
-            *serialNumber32bits = serNumberCMD;
-            auxIdx = serialNumberIdx * 3;
-            for( int i=0; i<3; i++) {
-                charTemp = appVars->serialNumber[auxIdx+i];
-                charTemp = charTemp << (8*i);
-                charTemp = charTemp & mask[i];
-                *serialNumber32bits = *serialNumber32bits | charTemp;
-            }
-            Serial_debug(DEBUG_CRITICAL, &cli_serial, "Partial SN[%lu]:[0x%08p]\r\n", serialNumberIdx, *serialNumber32bits );
-            retVal = true;
-            RSNSM.State_Next = RSNIncremetIdx;
-            break;
-        case RSNIncremetIdx:
-            serialNumberIdx++;
-            if( serialNumberIdx < SERIAL_NUMBER_SIZE_IN_CHARS/3){
-                RSNSM.State_Next = RSNReturnPartialSerialNumber;
-            } else {
-                RSNSM.State_Next = RSNInit;
-            }
-            break;
-        default:
-            RSNSM.State_Next = 0;
+    serialNumberIdx++;
+    if( serialNumberIdx >= SERIAL_NUMBER_SIZE_IN_CHARS/3 ) {
+        serialNumberIdx = 0;
     }
-    //if( RSNSM.State_Current != RSNSM.State_Next ) {
-    //    Serial_debug(DEBUG_INFO,&cli_serial,"RSNSM.State_Current[%d] = RSNSM.State_Next[%d]\r\n",RSNSM.State_Current, RSNSM.State_Next);
-    //}
-    RSNSM.State_Current = RSNSM.State_Next;
 
-    return retVal;
+    return true;
 }
 
 
@@ -432,92 +153,30 @@ void SaveSerialNumberToFlash( uint32_t serNumberCMD ) {
 }
 
 
+/**
+ * Returns the next manufacturer defined parameter, cycling through them.
+ * Bits 24..31 are the index of the parameter, bits 0..15 its value.
+ */
+bool RestoreManucfturerDefinedParemters( uint32_t *outputValue ){
+    static manufacturer_parameter_idx_t paramIdx = MANUFACTURER_PARAMETER_CRC_CPU1;
+    uint16_t retrievedValue = 0x0000;
 
-void PrepareNewAppVarToSave() {
-    app_vars_t auxAppVarsToSave;
-    memcpy( &auxAppVarsToSave, &currentAppVars, sizeof( app_vars_t ) );
-    switch( appVarTypeToSave ) {
-        case CapacitanceAppVar:
-            auxAppVarsToSave.currentCapacitance = newAppVars.currentCapacitance;
-            auxAppVarsToSave.initialCapacitance = newAppVars.initialCapacitance;
+    switch( paramIdx ) {
+        case MANUFACTURER_PARAMETER_CRC_CPU1:
+            retrievedValue = retriveCPUChecksumFromFlash( CPU1_NUMBER );
             break;
-        case SerialNumberAppVar:
-            memcpy( &auxAppVarsToSave.serialNumber, &newAppVars.serialNumber, SERIAL_NUMBER_SIZE_IN_CHARS );
-            break;
-        case AllAppVars:
-            memcpy( &auxAppVarsToSave, &newAppVars, sizeof(app_vars_t) );
+        case MANUFACTURER_PARAMETER_CRC_CPU2:
+            retrievedValue = retriveCPUChecksumFromFlash( CPU2_NUMBER );
             break;
         default:
             break;
     }
-    auxAppVarsToSave.MagicNumber = MAGIC_NUMBER;
-    memcpy(&newAppVars, &auxAppVarsToSave, sizeof( app_vars_t) );
-}
-
-
-bool RestoreManucfturerDefinedParemters( uint32_t *outputValue ){
-    enum RMDPStates { RMDPInit, RMDPRetriveParameter, RMDPIncremetIdx, RMDPEnd };
-    static States_t RMDPSM = { 0 };
-    static manufacturer_parameter_idx_t paramIdx = MANUFACTURER_PARAMETER_CRC_CPU1;
-
-    static uint16_t retrievedValue_0_15 = 0x0000;
-    static uint16_t retrievedValue_16_24 = 0x0000;
-    static uint32_t aux32Bits = 0x00000000;
-    static bool retVal = false;
-
-
-    *outputValue = 0x00000000;
-
-    retVal = false;
-    switch ( RMDPSM.State_Current ) {
-
-        case RMDPInit:
-            paramIdx = MANUFACTURER_PARAMETER_CRC_CPU1;
-            retrievedValue_0_15 = 0x0000;
-            retrievedValue_16_24 = 0x0000;
-            RMDPSM.State_Next = RMDPRetriveParameter;
-            break;
-
-        case RMDPRetriveParameter:
-            switch( paramIdx ) {
-                case MANUFACTURER_PARAMETER_CRC_CPU1:
-                    retrievedValue_0_15 = retriveCPUChecksumFromFlash( CPU1_NUMBER  );
-                    break;
-                case MANUFACTURER_PARAMETER_CRC_CPU2:
-                    retrievedValue_0_15  = retriveCPUChecksumFromFlash( CPU2_NUMBER  );
-                    break;
-            }
-            aux32Bits = 0x00000000 | (uint32_t)paramIdx;
-            aux32Bits = 0xFF000000 & (aux32Bits << 24);
-            *outputValue = aux32Bits;
-            aux32Bits = 0x00000000 | (uint32_t)(retrievedValue_16_24);
-            aux32Bits = 0x00FF0000 & (aux32Bits << 16);
-            *outputValue = *outputValue | aux32Bits;
-            aux32Bits = 0x0000FFFF & (uint32_t)retrievedValue_0_15;
-            *outputValue = *outputValue | aux32Bits;
-            RMDPSM.State_Next = RMDPIncremetIdx;
-            retVal = true;
-            break;
-
-            case RMDPIncremetIdx:
-                paramIdx++;
-                if( paramIdx == MANUFACTURER_PARAMETER_LAST ) {
-                    RMDPSM.State_Next = RMDPEnd;
-                } else {
-                    RMDPSM.State_Next = RMDPRetriveParameter;
-                }
-                break;
-
-            case RMDPEnd:
-                RMDPSM.State_Next = RMDPInit;
-                break;
-
-            default:
-                RMDPSM.State_Next = RMDPInit;
+    *outputValue = ((uint32_t)paramIdx << 24) | (uint32_t)retrievedValue;
 
+    paramIdx++;
+    if( paramIdx == MANUFACTURER_PARAMETER_LAST ) {
+        paramIdx = MANUFACTURER_PARAMETER_CRC_CPU1;
     }
-    //Serial_printf(&cli_serial, "%s %d RMDPSM.State_Current[%d] = RMDPSM.State_Next[%d] paramIdx[%d]\r\n",
-    //              __FUNCTION__, __LINE__, RMDPSM.State_Current, RMDPSM.State_Next, paramIdx);
-    RMDPSM.State_Current = RMDPSM.State_Next;
-    return retVal;
+
+    return true;
 }
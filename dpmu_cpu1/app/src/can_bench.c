@@ -0,0 +1,399 @@
+/*
+ * can_bench.c
+ *
+ *  SDO and PDO timing against the object dictionary of this node, on the
+ *  virtual CAN bus (CODRV_VBUS, canopen/codrv/vbus).
+ *
+ *  The bench is client node CAN_BENCH_NODE of the bus, it talks to the stack
+ *  with raw SDO frames, as an SDO client on another node would. The stack is
+ *  run by calling coCommTask() until the answer is on the bus, so the bus
+ *  time of a transfer is what it takes on a real bus at the same bit rate,
+ *  without the time a real node needs to answer.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "driverlib.h"
+#include "device.h"
+#include "gen_define.h"
+#include "co_canopen.h"
+#include "can_bench.h"
+#include "log.h"
+
+#ifdef CODRV_VBUS
+
+#include "canopen/codrv/vbus/codrv_vbus.h"
+
+#define CAN_BENCH_NODE          1u      /* bus node of the bench */
+#define CAN_BENCH_TIMEOUT       ((uint32_t)DEVICE_SYSCLK_FREQ / 10u)    /* 100 ms for an answer */
+#define CAN_BENCH_DATA_SIZE     256u    /* bytes kept of an upload, for writing them back */
+
+/* SDO command specifiers, CiA 301 */
+#define SDO_UPLOAD_INIT         0x40u
+#define SDO_UPLOAD_SEGMENT      0x60u
+#define SDO_DOWNLOAD_INIT       0x20u
+#define SDO_DOWNLOAD_SEGMENT    0x00u
+#define SDO_DOWNLOAD_INIT_RESP  0x60u
+#define SDO_DOWNLOAD_SEG_RESP   0x20u
+#define SDO_BLOCK_UPLOAD        0xA0u
+#define SDO_BLOCK_UPLOAD_RESP   0xC0u
+#define SDO_ABORT               0x80u
+
+#define SDO_BLOCK_START         0x03u
+#define SDO_BLOCK_ACK           0x02u
+#define SDO_BLOCK_END           0x01u
+
+#define SDO_TOGGLE              0x10u
+
+static uint8_t  bench_data[CAN_BENCH_DATA_SIZE];
+static uint32_t bench_size;             /* bytes of the last upload */
+static uint32_t bench_abort;            /* abort code of the last transfer */
+
+static uint32_t bench_cycles(void)
+{
+    return (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+}
+
+static uint32_t bench_u32(const UNSIGNED8 *data)
+{
+    return  (uint32_t)(data[0] & 0xFFu)
+         | ((uint32_t)(data[1] & 0xFFu) << 8)
+         | ((uint32_t)(data[2] & 0xFFu) << 16)
+         | ((uint32_t)(data[3] & 0xFFu) << 24);
+}
+
+static void bench_keep(const UNSIGNED8 *data, uint32_t offset, uint16_t len)
+{
+    for (uint16_t i = 0; i < len && offset + i < CAN_BENCH_DATA_SIZE; i++) {
+        bench_data[offset + i] = data[i] & 0xFFu;
+    }
+}
+
+static bool bench_send(uint32_t canId, const uint8_t data[CO_CAN_MAX_DATA_LEN], uint8_t len)
+{
+    CODRV_VBUS_MSG_T msg;
+
+    msg.canId = canId;
+    msg.busTime = 0;
+    msg.flags = 0;
+    msg.len = len;
+    memset(msg.data, 0, sizeof(msg.data));
+    memcpy(msg.data, data, len);
+
+    return codrvVbusTransmit(CAN_BENCH_NODE, &msg) == RET_OK;
+}
+
+/* drops frames left from an earlier transfer */
+static void bench_flush(void)
+{
+    CODRV_VBUS_MSG_T msg;
+
+    while (codrvVbusReceive(CAN_BENCH_NODE, &msg)) {
+    }
+}
+
+/* runs the stack until the bench receives a frame with canId */
+static bool bench_wait(uint32_t canId, CODRV_VBUS_MSG_T *msg)
+{
+    uint32_t start = bench_cycles();
+
+    do {
+        while (codrvVbusReceive(CAN_BENCH_NODE, msg)) {
+            if (msg->canId == canId && (msg->flags & CO_COBFLAG_RTR) == 0u) {
+                return true;
+            }
+        }
+        coCommTask();
+        log_domain_prefetch();      /* as the super loop does */
+    } while (bench_cycles() - start < CAN_BENCH_TIMEOUT);
+
+    return false;
+}
+
+/* waits for the next server frame, false on a timeout or an abort */
+static bool bench_response(CODRV_VBUS_MSG_T *resp)
+{
+    if (!bench_wait(0x580u + coNmtGetNodeId(), resp)) {
+        return false;
+    }
+    if ((resp->data[0] & 0xFFu) == SDO_ABORT) {
+        bench_abort = bench_u32(&resp->data[4]);
+        return false;
+    }
+    return true;
+}
+
+static bool bench_request(const uint8_t req[CO_CAN_MAX_DATA_LEN], CODRV_VBUS_MSG_T *resp)
+{
+    if (!bench_send(0x600u + coNmtGetNodeId(), req, CO_CAN_MAX_DATA_LEN)) {
+        return false;
+    }
+    return bench_response(resp);
+}
+
+static bool bench_upload(uint16_t index, uint8_t subIndex)
+{
+    uint8_t req[CO_CAN_MAX_DATA_LEN] = {SDO_UPLOAD_INIT, index & 0xFFu, index >> 8, subIndex};
+    CODRV_VBUS_MSG_T resp;
+    uint8_t toggle = 0;
+    uint16_t n;
+
+    if (!bench_request(req, &resp) || (resp.data[0] & 0xE0u) != SDO_UPLOAD_INIT) {
+        return false;
+    }
+
+    /* expedited, size indicated or not */
+    if (resp.data[0] & 0x02u) {
+        n = (resp.data[0] & 0x01u) ? 4u - ((resp.data[0] >> 2) & 0x03u) : 4u;
+        bench_keep(&resp.data[4], 0, n);
+        bench_size = n;
+        return true;
+    }
+
+    bench_size = 0;
+    do {
+        memset(req, 0, sizeof(req));
+        req[0] = SDO_UPLOAD_SEGMENT | toggle;
+        if (!bench_request(req, &resp)
+         || (resp.data[0] & 0xE0u) != 0x00u
+         || (resp.data[0] & SDO_TOGGLE) != toggle) {
+            return false;
+        }
+        n = 7u - ((resp.data[0] >> 1) & 0x07u);
+        bench_keep(&resp.data[1], bench_size, n);
+        bench_size += n;
+        toggle ^= SDO_TOGGLE;
+    } while ((resp.data[0] & 0x01u) == 0u);
+
+    return true;
+}
+
+static bool bench_block_upload(uint16_t index, uint8_t subIndex, uint8_t blockSize)
+{
+    uint8_t req[CO_CAN_MAX_DATA_LEN] = {SDO_BLOCK_UPLOAD, index & 0xFFu, index >> 8, subIndex, blockSize};
+    CODRV_VBUS_MSG_T resp;
+    uint8_t seqNo = 1;
+    bool last = false;
+
+    if (!bench_request(req, &resp) || (resp.data[0] & 0xE1u) != SDO_BLOCK_UPLOAD_RESP) {
+        return false;
+    }
+
+    memset(req, 0, sizeof(req));
+    req[0] = SDO_BLOCK_UPLOAD | SDO_BLOCK_START;
+    if (!bench_send(0x600u + coNmtGetNodeId(), req, CO_CAN_MAX_DATA_LEN)) {
+        return false;
+    }
+
+    bench_size = 0;
+    while (!last) {
+        if (!bench_response(&resp)) {
+            return false;
+        }
+        /* no frame is lost on the virtual bus, a sequence error is a failure */
+        if ((resp.data[0] & 0x7Fu) != seqNo) {
+            return false;
+        }
+        bench_keep(&resp.data[1], bench_size, 7u);
+        bench_size += 7u;
+        last = (resp.data[0] & 0x80u) != 0u;
+
+        if (last || seqNo == blockSize) {
+            memset(req, 0, sizeof(req));
+            req[0] = SDO_BLOCK_UPLOAD | SDO_BLOCK_ACK;
+            req[1] = seqNo;
+            req[2] = blockSize;
+            if (!bench_send(0x600u + coNmtGetNodeId(), req, CO_CAN_MAX_DATA_LEN)) {
+                return false;
+            }
+            seqNo = 0;
+        }
+        seqNo++;
+    }
+
+    /* end of the block upload, with the unused bytes of the last segment */
+    if (!bench_response(&resp) || (resp.data[0] & 0xE3u) != (SDO_BLOCK_UPLOAD_RESP | SDO_BLOCK_END)) {
+        return false;
+    }
+    bench_size -= (resp.data[0] >> 2) & 0x07u;
+
+    memset(req, 0, sizeof(req));
+    req[0] = SDO_BLOCK_UPLOAD | SDO_BLOCK_END;
+    if (!bench_send(0x600u + coNmtGetNodeId(), req, CO_CAN_MAX_DATA_LEN)) {
+        return false;
+    }
+    /* no answer to the end, one call puts it on the bus, the next one handles it */
+    coCommTask();
+    coCommTask();
+
+    return true;
+}
+
+static bool bench_download(uint16_t index, uint8_t subIndex)
+{
+    uint8_t req[CO_CAN_MAX_DATA_LEN] = {SDO_DOWNLOAD_INIT, index & 0xFFu, index >> 8, subIndex};
+    CODRV_VBUS_MSG_T resp;
+    uint8_t toggle = 0;
+    uint32_t offset = 0;
+    uint16_t n;
+
+    if (bench_size > CAN_BENCH_DATA_SIZE) {
+        return false;
+    }
+
+    if (bench_size > 0u && bench_size <= 4u) {
+        /* expedited, size indicated */
+        req[0] |= 0x03u | ((4u - bench_size) << 2);
+        memcpy(&req[4], bench_data, bench_size);
+        return bench_request(req, &resp) && (resp.data[0] & 0xFFu) == SDO_DOWNLOAD_INIT_RESP;
+    }
+
+    req[0] |= 0x01u;
+    req[4] = bench_size & 0xFFu;
+    req[5] = (bench_size >> 8) & 0xFFu;
+    if (!bench_request(req, &resp) || (resp.data[0] & 0xFFu) != SDO_DOWNLOAD_INIT_RESP) {
+        return false;
+    }
+
+    do {
+        n = (bench_size - offset > 7u) ? 7u : (uint16_t)(bench_size - offset);
+        memset(req, 0, sizeof(req));
+        req[0] = SDO_DOWNLOAD_SEGMENT | toggle | ((7u - n) << 1);
+        if (offset + n == bench_size) {
+            req[0] |= 0x01u;
+        }
+        memcpy(&req[1], &bench_data[offset], n);
+        if (!bench_request(req, &resp) || (resp.data[0] & 0xFFu) != (SDO_DOWNLOAD_SEG_RESP | toggle)) {
+            return false;
+        }
+        offset += n;
+        toggle ^= SDO_TOGGLE;
+    } while (offset < bench_size);
+
+    return true;
+}
+
+static void bench_account(can_bench_result_t *result, uint32_t bytes, uint32_t busBits, uint32_t cycles)
+{
+    result->transfers++;
+    result->bytes += bytes;
+    result->busBits += busBits;
+    result->cycles += cycles;
+    if (busBits > result->maxBusBits) {
+        result->maxBusBits = busBits;
+    }
+    if (cycles > result->maxCycles) {
+        result->maxCycles = cycles;
+    }
+}
+
+bool can_bench_sdo(can_bench_sdo_t kind, uint16_t index, uint8_t subIndex,
+                   uint8_t blockSize, uint16_t loops, can_bench_result_t *result)
+{
+    CODRV_VBUS_STATS_T before, after;
+    uint32_t bits, start;
+    bool ok = true;
+
+    memset(result, 0, sizeof(*result));
+    bench_abort = 0;
+    bench_flush();
+    if (blockSize == 0u || blockSize > 127u) {
+        blockSize = 127u;
+    }
+
+    /* the value written back */
+    if (kind == CAN_BENCH_SDO_DOWNLOAD && !bench_upload(index, subIndex)) {
+        result->abortCode = bench_abort;
+        return false;
+    }
+
+    codrvVbusGetStats(&before);
+    for (uint16_t loop = 0; ok && loop < loops; loop++) {
+        bits = codrvVbusTime();
+        start = bench_cycles();
+        switch (kind) {
+        case CAN_BENCH_SDO_UPLOAD:
+            ok = bench_upload(index, subIndex);
+            break;
+        case CAN_BENCH_SDO_BLOCK_UPLOAD:
+            ok = bench_block_upload(index, subIndex, blockSize);
+            break;
+        case CAN_BENCH_SDO_DOWNLOAD:
+            ok = bench_download(index, subIndex);
+            break;
+        default:
+            ok = false;
+            break;
+        }
+        if (ok) {
+            bench_account(result, bench_size, codrvVbusTime() - bits, bench_cycles() - start);
+        }
+    }
+    codrvVbusGetStats(&after);
+
+    result->frames = after.frames - before.frames;
+    result->abortCode = bench_abort;
+    return ok;
+}
+
+bool can_bench_tpdo(uint16_t pdoNr, uint16_t loops, can_bench_result_t *result)
+{
+    uint8_t nmtStart[CO_CAN_MAX_DATA_LEN] = {0x01u, coNmtGetNodeId()};
+    uint8_t none[CO_CAN_MAX_DATA_LEN] = {0};
+    CODRV_VBUS_STATS_T before, after;
+    CODRV_VBUS_MSG_T msg;
+    UNSIGNED32 cobId, syncId = 0x80u;
+    UNSIGNED8 transType;
+    uint32_t bits, start;
+
+    memset(result, 0, sizeof(*result));
+    bench_flush();
+    if (pdoNr == 0u
+     || coOdGetObj_u32(0x1800u + pdoNr - 1u, 1u, &cobId) != RET_OK
+     || coOdGetObj_u8(0x1800u + pdoNr - 1u, 2u, &transType) != RET_OK
+     || (cobId & 0x80000000ul) != 0u) {
+        return false;
+    }
+    /* synchronous acyclic PDOs go with the next SYNC, cyclic ones are not requested */
+    if (transType >= 1u && transType <= 240u) {
+        return false;
+    }
+    (void)coOdGetObj_u32(0x1005u, 0u, &syncId);
+
+    /* TPDOs need OPERATIONAL, started by the bench as a master would */
+    if (coNmtGetState() != CO_NMT_STATE_OPERATIONAL) {
+        if (!bench_send(0x000u, nmtStart, 2u)) {
+            return false;
+        }
+        coCommTask();
+        coCommTask();
+        if (coNmtGetState() != CO_NMT_STATE_OPERATIONAL) {
+            return false;
+        }
+    }
+
+    codrvVbusGetStats(&before);
+    for (uint16_t loop = 0; loop < loops; loop++) {
+        bits = codrvVbusTime();
+        start = bench_cycles();
+        if (coPdoReqNr(pdoNr, 0u) != RET_OK
+         || (transType == 0u && !bench_send(syncId & 0x7FFu, none, 0u))) {
+            return false;
+        }
+        /* the PDO sent on the start of OPERATIONAL may still be queued */
+        do {
+            if (!bench_wait(cobId & 0x1FFFFFFFul, &msg)) {
+                return false;
+            }
+        } while ((int32_t)(msg.busTime - bits) <= 0);
+        bench_account(result, msg.len, msg.busTime - bits, bench_cycles() - start);
+    }
+    codrvVbusGetStats(&after);
+
+    result->frames = after.frames - before.frames;
+    return true;
+}
+
+#endif /* CODRV_VBUS */
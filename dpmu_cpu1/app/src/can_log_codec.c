@@ -0,0 +1,113 @@
+/*
+ * can_log_codec.c
+ *
+ *  Keyframe and delta records of the CAN log, see can_log_codec.h.
+ *
+ *  A delta is a bitmap of the debug_log_t words that changed followed by
+ *  the zigzag varint encoded difference of each changed word, the bytes
+ *  packed low byte first.
+ */
+
+#include <string.h>
+
+#include "can_log_codec.h"
+
+static inline void can_log_put_byte(uint16_t *payload, uint16_t pos, uint16_t byte)
+{
+    if( pos & 1 ) {
+        payload[pos / 2] |= byte << 8;
+    } else {
+        payload[pos / 2] = byte;
+    }
+}
+
+static inline uint16_t can_log_get_byte(const uint16_t *payload, uint16_t pos)
+{
+    return (pos & 1) ? (payload[pos / 2] >> 8) : (payload[pos / 2] & 0xFF);
+}
+
+/**
+ * @brief   Encodes record as a keyframe, header word included
+ * @return  words written to encoded
+ */
+uint16_t can_log_encode_keyframe(const debug_log_t *record, uint16_t *encoded)
+{
+    memcpy(&encoded[1], record, sizeof(debug_log_t));
+    encoded[0] = CAN_LOG_RECORD_HEADER(CAN_LOG_RECORD_KEYFRAME, CAN_LOG_RECORD_RAW_WORDS);
+
+    return CAN_LOG_KEYFRAME_WORDS;
+}
+
+/**
+ * @brief   Encodes the difference of record to previous, header word included
+ *
+ * encoded must hold CAN_LOG_ENCODED_MAX_WORDS.
+ *
+ * @return  words written to encoded, more than CAN_LOG_KEYFRAME_WORDS when a
+ *          keyframe is smaller
+ */
+uint16_t can_log_encode_delta(const debug_log_t *record, const debug_log_t *previous, uint16_t *encoded)
+{
+    const uint16_t *current = (const uint16_t *)record;
+    const uint16_t *before = (const uint16_t *)previous;
+    uint16_t *payload = &encoded[1];
+    uint16_t pos = CAN_LOG_DELTA_BITMAP_BYTES;
+    uint16_t i, delta, zigzag;
+
+    for( i = 0; i < CAN_LOG_DELTA_BITMAP_BYTES; i++ ) {
+        can_log_put_byte(payload, i, 0);
+    }
+
+    for( i = 0; i < CAN_LOG_RECORD_RAW_WORDS; i++ ) {
+        delta = current[i] - before[i];
+        if( delta == 0 ) {
+            continue;
+        }
+        /* bit i % 8 of bitmap byte i / 8 */
+        payload[i / 16] |= 1u << (i % 16);
+
+        zigzag = (uint16_t)(delta << 1) ^ (uint16_t)((int16_t)delta >> 15);
+        while( zigzag >= 0x80 ) {
+            can_log_put_byte(payload, pos++, (zigzag & 0x7F) | 0x80);
+            zigzag >>= 7;
+        }
+        can_log_put_byte(payload, pos++, zigzag);
+    }
+
+    encoded[0] = CAN_LOG_RECORD_HEADER(CAN_LOG_RECORD_DELTA, (pos + 1) / 2);
+
+    return 1 + (pos + 1) / 2;
+}
+
+/**
+ * @brief   Applies the delta payload of words words to record, the record before it
+ * @return  false if the payload ends inside a varint
+ */
+bool can_log_decode_delta(const uint16_t *payload, uint16_t words, debug_log_t *record)
+{
+    uint16_t *current = (uint16_t *)record;
+    uint16_t pos = CAN_LOG_DELTA_BITMAP_BYTES;
+    uint16_t i, shift, zigzag, byte;
+
+    if( 2 * words < CAN_LOG_DELTA_BITMAP_BYTES ) {
+        return false;
+    }
+
+    for( i = 0; i < CAN_LOG_RECORD_RAW_WORDS; i++ ) {
+        if( (can_log_get_byte(payload, i / 8) & (1u << (i % 8))) == 0 ) {
+            continue;
+        }
+        zigzag = 0;
+        shift = 0;
+        do {
+            if( pos >= 2 * words ) {
+                return false;
+            }
+            byte = can_log_get_byte(payload, pos++);
+            zigzag |= (uint16_t)((byte & 0x7F) << shift);
+            shift += 7;
+        } while( (byte & 0x80) && (shift < 16) );
+        current[i] += (uint16_t)((zigzag >> 1) ^ (uint16_t)-(int16_t)(zigzag & 1));
+    }
+    return true;
+}
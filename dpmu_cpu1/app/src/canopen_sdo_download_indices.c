@@ -14,6 +14,7 @@
 #include <stdint.h>
 
 #include "application_vars.h"
+#include "check_CPU2.h"
 #include "cli_cpu1.h"
 #include "co_datatype.h"
 #include "co_odaccess.h"
@@ -748,6 +749,31 @@ static RET_T indices_I_CAN_LOG(BOOL_T execute, UNSIGNED8 sdoNr, UNSIGNED16  inde
 
         Serial_debug(DEBUG_INFO, &cli_serial, "S_CAN_LOG_RESET\r\n");
         break;
+    case S_CAN_LOG_READ_FROM:
+    case S_CAN_LOG_READ_MAX:
+        /* used by the next CAN_LOG_READ */
+        break;
+    default:
+        Serial_debug(DEBUG_ERROR, &cli_serial, "UNKNOWN CAN OD SUBINDEX: 0x%02x\r\n", subIndex);
+        retVal = RET_SUBIDX_NOT_FOUND;
+        break;
+    }
+
+    return retVal;
+}
+
+static RET_T indices_I_STATE_MACHINE_STATS(UNSIGNED8 subIndex)
+{
+    RET_T retVal = RET_OK;
+
+    Serial_debug(DEBUG_INFO, &cli_serial, "STATE_MACHINE_STATS  S 0x%0x  ", subIndex);
+
+    switch (subIndex)
+    {
+    case S_STATE_MACHINE_STATS_RESET:
+        cpu2_state_machine_stats_reset();
+        Serial_debug(DEBUG_INFO, &cli_serial, "S_STATE_MACHINE_STATS_RESET\r\n");
+        break;
     default:
         Serial_debug(DEBUG_ERROR, &cli_serial, "UNKNOWN CAN OD SUBINDEX: 0x%02x\r\n", subIndex);
         retVal = RET_SUBIDX_NOT_FOUND;
@@ -829,6 +855,9 @@ RET_T co_usr_sdo_dl_indices(
         case I_CAN_LOG:
             retVal = indices_I_CAN_LOG(execute, sdoNr, index, subIndex);
             break;
+        case I_STATE_MACHINE_STATS:
+            retVal = indices_I_STATE_MACHINE_STATS(subIndex);
+            break;
         default:
             Serial_debug(DEBUG_ERROR, &cli_serial, "UNKNOWN CAN OD INDEX: 0x%04x 0x%02x\r\n", index, subIndex);
         }
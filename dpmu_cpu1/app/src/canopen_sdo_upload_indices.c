@@ -9,6 +9,7 @@
 #define APP_SRC_CANOPEN_INDICES_C_
 
 #include "application_vars.h"
+#include "check_CPU2.h"
 #include "co_datatype.h"
 #include "co_odaccess.h"
 #include "convert.h"
@@ -62,7 +63,6 @@ static inline uint8_t indices_I_RESTORE_DEFAULT_PARAMETERS(UNSIGNED8 subIndex)
     static uint32_t value;
     static uint32_t serialNumber32bits;
     static uint32_t manufacturerParameter;
-    static uint16_t count = 0;
 
 
     switch (subIndex)
@@ -82,15 +82,14 @@ static inline uint8_t indices_I_RESTORE_DEFAULT_PARAMETERS(UNSIGNED8 subIndex)
     case S_RESTORE_MANUFACTURER_DEFINED_DEFAULT_PARAMETERS:
         retVal = coOdGetObj_u32(I_RESTORE_DEFAULT_PARAMETERS, S_RESTORE_MANUFACTURER_DEFINED_DEFAULT_PARAMETERS, &value);
         Serial_debug(DEBUG_INFO, &cli_serial, "S_RESTORE_MANUFACTURER_DEFINED_DEFAULT_PARAMETERS: 0x%x\r\n", value);
-        count = 0;
-        while( RestoreManucfturerDefinedParemters( &manufacturerParameter ) != true ) { count++; }
-        Serial_debug(DEBUG_INFO, &cli_serial, "%s manufacturerParameter: 0x%08p count:[%u]\r\n",
-                      __FUNCTION__, manufacturerParameter, count);
+        RestoreManucfturerDefinedParemters( &manufacturerParameter );
+        Serial_debug(DEBUG_INFO, &cli_serial, "%s manufacturerParameter: 0x%08p\r\n",
+                      __FUNCTION__, manufacturerParameter);
         coOdPutObj_u32( I_RESTORE_DEFAULT_PARAMETERS, S_RESTORE_MANUFACTURER_DEFINED_DEFAULT_PARAMETERS, manufacturerParameter);
         break;
     case S_RESTORE_SERIAL_NUMBER:
         retVal = coOdGetObj_u32(I_RESTORE_DEFAULT_PARAMETERS, S_RESTORE_SERIAL_NUMBER, &value);
-        while( RetriveSerialNumberFromFlash( &serialNumber32bits ) != true );
+        RetriveSerialNumberFromFlash( &serialNumber32bits );
         coOdPutObj_u32(I_RESTORE_DEFAULT_PARAMETERS, S_RESTORE_SERIAL_NUMBER, serialNumber32bits);
         break;
     default:
@@ -562,6 +561,12 @@ static inline uint8_t indices_I_CAN_LOG(BOOL_T execute, UNSIGNED8 sdoNr, UNSIGNE
         case S_CAN_LOG_READ:
             retVal = log_can_log_read(execute, sdoNr, index, subIndex);
             break;
+        case S_CAN_LOG_READ_FROM:
+        case S_CAN_LOG_READ_MAX:
+        case S_CAN_LOG_CURSOR:
+            /* plain values, read by the next CAN_LOG_READ */
+            retVal = RET_OK;
+            break;
         default:
             Serial_debug(DEBUG_ERROR, &cli_serial, "UNKNOWN CAN OD SUBINDEX: 0x%02x\r\n", subIndex);
     }
@@ -570,6 +575,22 @@ static inline uint8_t indices_I_CAN_LOG(BOOL_T execute, UNSIGNED8 sdoNr, UNSIGNE
     return retVal;
 }
 
+static inline uint8_t indices_I_STATE_MACHINE_STATS(UNSIGNED16  index, UNSIGNED8 subIndex)
+{
+    uint8_t retVal = CO_FALSE;
+
+    switch (subIndex)
+    {
+        case S_STATE_MACHINE_STATS_READ:
+            retVal = cpu2_state_machine_stats_read(index, subIndex);
+            break;
+        default:
+            Serial_debug(DEBUG_ERROR, &cli_serial, "UNKNOWN CAN OD SUBINDEX: 0x%02x\r\n", subIndex);
+    }
+
+    return retVal;
+}
+
 RET_T co_usr_sdo_ul_indices(
         BOOL_T      execute,
         UNSIGNED8   sdoNr,
@@ -652,6 +673,9 @@ RET_T co_usr_sdo_ul_indices(
         case I_CAN_LOG:
             retVal = indices_I_CAN_LOG(execute, sdoNr, index, subIndex);
             break;
+        case I_STATE_MACHINE_STATS:
+            retVal = indices_I_STATE_MACHINE_STATS(index, subIndex);
+            break;
         default:
             Serial_debug(DEBUG_ERROR, &cli_serial, "UNKNOWN CAN OD INDEX: 0x%04x 0x%02x\r\n", index, subIndex);
         }
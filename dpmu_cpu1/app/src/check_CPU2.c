@@ -9,11 +9,13 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "application_vars.h"
 #include "co_canopen.h"
 #include "common.h"
 #include "convert.h"
+#include "emifc.h"
 #include "ext_flash.h"
 #include "gen_indices.h"
 #include "initialization_app.h"
@@ -31,6 +33,15 @@ float         cap_energy_cell[30] = {0};
 static bool initial_values_read   = false;
 static bool initial_values_stored = false;
 
+/* CPU2 state machine statistics as they were when the SDO read started */
+static state_machine_stats_t state_machine_stats_snapshot;
+
+/* OD handles of objects written periodically, resolved on first use */
+static CO_OD_HANDLE_T current_state_handle;
+static CO_OD_HANDLE_T soh_energy_bank_handle;
+static CO_OD_HANDLE_T soh_energy_cell_handle[30];
+static bool soh_handles_resolved = false;
+
 static bool check_SoH(void)
 {
     bool values_updated = false;
@@ -81,8 +92,9 @@ static bool check_current_state(void)
         last_read_values.current_state = sharedVars_cpu2toCpu1.current_state;
 
         /* update state in CAN open OD */
-        coOdPutObj_u8(I_DPMU_STATE, S_DPMU_OPERATION_CURRENT_STATE,
-                      last_read_values.current_state);
+        if (current_state_handle.pDesc == NULL)
+            coOdGetObjHandle(I_DPMU_STATE, S_DPMU_OPERATION_CURRENT_STATE, &current_state_handle);
+        coOdPutObjH_u8(&current_state_handle, last_read_values.current_state);
 
         //if( last_read_values.current_state == Fault  ) {
         if( sharedVars_cpu2toCpu1.faultOccured == true ) {
@@ -130,7 +142,7 @@ static void read_initial_capacitances_from_flash(float *data, size_t length)
     ext_flash_read_buf(sector_info.addr, (uint16_t*)data, length);
 }
 
-static void write_initial_capacitances_to_flash(float *data, size_t length)
+static bool write_initial_capacitances_to_flash(float *data, size_t length)
 {
     /* set sector in external flash */
     ext_flash_desc_t sector_info;
@@ -139,8 +151,8 @@ static void write_initial_capacitances_to_flash(float *data, size_t length)
     /* look up address corresponding to start of sector */
     look_up_start_address_of_sector(&sector_info);
 
-    /* red buffer from external flash */
-    ext_flash_write_buf(sector_info.addr, (uint16_t*)data, length);
+    /* write buffer to external flash, fails if the sector is not erased */
+    return ext_flash_write_buf(sector_info.addr, (uint16_t*)data, length);
 }
 
 /* brief: read initial capacitance values from external FLASH
@@ -314,7 +326,10 @@ static RET_T store_initial_caps_in_external_flash(RET_T status, float *data)
                   data[i] = initial_cap_energy_cell[j];
                 }
 
-                write_initial_capacitances_to_flash(data, sizeof(data));
+                if(!write_initial_capacitances_to_flash(data, sizeof(data)))
+                {
+                    ret = RET_ERROR_STORE;
+                }
                 /* marked as written above if 'if(0 == data[0])' is true
                  * set 'initial_values_stored = true' is set the second time we
                  * call this function, guaranteeing that flash has been written
@@ -333,71 +348,21 @@ void store_SoH_in_OD(uint8_t soH_energy_bank, float cell[30])
 
     convert_soh_all_energy_cell_to_OD(cell, soH_energy_cell);
 
+    /* the objects are looked up once, then written through their handles */
+    if (soh_handles_resolved == false) {
+        coOdGetObjHandle(I_ENERGY_BANK_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_BANK,
+                         &soh_energy_bank_handle);
+        for (int i = 0; i < 30; i++)
+            coOdGetObjHandle(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_01 + i,
+                             &soh_energy_cell_handle[i]);
+        soh_handles_resolved = true;
+    }
+
     /* save calculated SoH for energy bank in CANopen OD */
-    coOdPutObj_u8(I_ENERGY_BANK_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_BANK,
-                  soH_energy_bank);
-    /* save calculated SoH per cell in CANopen OD */
-    int i = 0;
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_01,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_02,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_03,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_04,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_05,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_06,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_07,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_08,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_09,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_10,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_11,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_12,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_13,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_14,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_15,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_16,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_17,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_18,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_19,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_20,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_21,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_22,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_23,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_24,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_25,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_26,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_27,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_28,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_29,
-                  soH_energy_cell[i++]);
-    coOdPutObj_u8(I_ENERGY_CELL_SUMMARY, S_STATE_OF_HEALTH_OF_ENERGY_CELL_30,
-                  soH_energy_cell[i++]);
+    coOdPutObjH_u8(&soh_energy_bank_handle, soH_energy_bank);
+    /* save calculated SoH per cell in CANopen OD, S_STATE_OF_HEALTH_OF_ENERGY_CELL_01..30 are consecutive */
+    for (int i = 0; i < 30; i++)
+        coOdPutObjH_u8(&soh_energy_cell_handle[i], soH_energy_cell[i]);
 }
 
 void calculate_capacitance(void)
@@ -735,3 +700,51 @@ void calculate_SoH_energy_bank(float soH_energy_cell[30],
 //    return values_updated;
 //}
 
+
+/* brief: start of an SDO read of the CPU2 state machine statistics
+ *
+ * details: takes a snapshot of the statistics so the whole transfer is
+ *          consistent and points the OD domain to the transfer buffer,
+ *          log_read_domain() fills it chunk by chunk
+ *
+ * return: RET_OK
+ */
+uint8_t cpu2_state_machine_stats_read(UNSIGNED16 index, UNSIGNED8 subIndex)
+{
+    memcpy(&state_machine_stats_snapshot, &sharedVars_cpu2toCpu1.state_machine_stats,
+           sizeof(state_machine_stats_t));
+
+    coOdDomainAddrSet(index,
+                      subIndex,
+                      message,
+                      2 * sizeof(state_machine_stats_t)   /* '2x' we use 16 bit Words */
+                     );
+
+    return RET_OK;
+}
+
+/* brief: copies the next chunk of the snapshot to the transfer buffer
+ *
+ * argument: offset - 16 bit Words already transferred
+ *           size   - 16 bit Words to copy
+ */
+void cpu2_state_machine_stats_read_domain(uint32_t offset, uint32_t size)
+{
+    if (offset >= sizeof(state_machine_stats_t)) {
+        return;
+    }
+    if (size > TRANSFER_SIZE) {
+        size = TRANSFER_SIZE;
+    }
+    if (size > sizeof(state_machine_stats_t) - offset) {
+        size = sizeof(state_machine_stats_t) - offset;
+    }
+
+    memcpy(message, (uint16_t *)&state_machine_stats_snapshot + offset, size);
+}
+
+/* brief: asks CPU2 to clear the state machine statistics */
+void cpu2_state_machine_stats_reset(void)
+{
+    sharedVars_cpu1toCpu2.state_machine_stats_reset++;
+}
@@ -12,15 +12,23 @@
 #include <stdbool.h>
 
 #include "application_vars.h"
+#include "co_canopen.h"
+#ifdef CODRV_VBUS
+#include "canopen/codrv/vbus/codrv_vbus.h"
+#include "can_bench.h"
+#endif /* CODRV_VBUS */
 #include "common.h"
 #include "cli_cpu1.h"
+#include "cpu2_log.h"
 #include "hal.h"
 #include "i2c_com.h"
 #include "i2c_test.h"
 #include "log.h"
 #include "main.h"
+#include "param_store.h"
 #include "emifc.h"
 #include "ext_flash.h"
+#include "gen_indices.h"
 #include "shared_variables.h"
 #include "timer.h"
 #include "temperature_sensor.h"
@@ -71,6 +79,8 @@ static void cli_pwm_set_phase(void);
 static void cli_test_inrush_limiter(void);
 static void cli_ext_flash(void);
 static void cli_ext_flash_chip_erase(void);
+static void cli_ext_flash_stats(void);
+static void cli_param_store_stats(void);
 static void cli_set_sc_shortcircuit(void);
 static void cli_set_input_shortcircuit(void);
 static void cli_set_output_shortcircuit(void);
@@ -91,13 +101,24 @@ static void cli_cat(void);
 static void cli_create(void);
 static void cli_lfs_test2(void);
 static void cli_lfs_size(void);
+static void cli_lfs_bench(void);
 
 static void cli_write_testlog_debug(void);
 static void cli_write_testlog_can(void);
 
 static void cli_cpu2_cmd(void);
+static void cli_cpu2_log(void);
+static void cli_debug_log_stats(void);
+static void cli_can_log_stats(void);
 
 static void cli_dma_test_gsram_ext_ram(void);
+static void cli_emif_stats(void);
+static void cli_od_bench(void);
+static void cli_pdo_bench(void);
+static void cli_can_queue_stats(void);
+#ifdef CODRV_VBUS
+static void cli_can_bench(void);
+#endif /* CODRV_VBUS */
 
 static void cli_tq_blocking(void);
 static void cli_tq_async(void);
@@ -120,6 +141,8 @@ static const struct CliCmd cmds[] = {
     {"pwm_phase",   "[channel] [phase]",        &cli_pwm_set_phase,         "set pwm channel phase"                         },
     {"xflash",      "",                         &cli_ext_flash,             "test external flash access"                    },
     {"xflash_erase","",                         &cli_ext_flash_chip_erase,  "erase entire external flash"                   },
+    {"xflash_stats","",                         &cli_ext_flash_stats,       "show external flash program counters"          },
+    {"pstore",      "",                         &cli_param_store_stats,     "show parameter store state and counters"       },
     {"dl",          "",                         &cli_debug_level,           "set debug level (0=OFF)"                       },
     {"i2c",         "",                         &cli_i2c_test,              "test i2c devices"                              },
     {"i2c_scan",    "",                         &cli_i2c_scan,              "search for i2c devices"                              },
@@ -134,15 +157,26 @@ static const struct CliCmd cmds[] = {
     {"create",      "file",                     &cli_create,                "create new file"                               },
     {"lfs_test2",   "",                         &cli_lfs_test2,             "create log_xxxx and check write/read"          },
     {"lfs_size",    "",                         &cli_lfs_size,              "show size of external flash filesystem"        },
+    {"lfs_bench",   "[files] [words]",          &cli_lfs_bench,             "time mount, create, append, read and traversal"},
     {"",            "",                         NULL,                       ""                                              },
     {"dma_ext_ram", "startVal turns",           &cli_dma_test_gsram_ext_ram, "DMA for GSRAM0 -> ExtRAM -> GSRAM1, turns < 0 -> run forever"},
+    {"emif_stats",  "",                         &cli_emif_stats,            "show EMIF DMA transfer queue counters"         },
+    {"od_bench",    "[loops]",                  &cli_od_bench,              "time OD reads by index and by handle"          },
+    {"pdo_bench",   "[loops]",                  &cli_pdo_bench,             "check and time TPDO packing, bytes vs words"   },
+    {"canq",        "",                         &cli_can_queue_stats,       "show CANopen transmit queue depths"            },
+#ifdef CODRV_VBUS
+    {"can_bench",   "up|blk|down|log|pdo|err|rate|stats", &cli_can_bench,   "time SDO/PDO on the virtual CAN bus, no args for usage"},
+#endif /* CODRV_VBUS */
     {"tq_blocking", "duration",                 &cli_tq_blocking,           "test timer queue (and priority queue)"         },
     {"tq_async",    "duration",                 &cli_tq_async,              "test timer queue (and priority queue)"         },
     {"",            "",                         NULL,                       ""                                              },
     {"wr_debuglog", "startVal entries",         &cli_write_testlog_debug,   "write test data to debug log"                  },
     {"wr_canlog",   "startVal entries",         &cli_write_testlog_can,     "write test data to can log"                    },
+    {"logsnap",     "",                         &cli_debug_log_stats,       "show debug log snapshot and torn read counters"},
+    {"canlog",      "",                         &cli_can_log_stats,         "show CAN log stage backlog and drop counters"  },
     {"",            "",                         NULL,                       ""                                              },
     {"cpu2",        "subcommand",               &cli_cpu2_cmd,              "forward sub-command to CPU2"                   },
+    {"cpu2log",     "",                         &cli_cpu2_log,              "show CPU2 debug ring counters"                 },
     {"  swmatrix",  "[1..30]",                  &cli_switch_matrix,         "select a energy cell in external energy storage"},
     {"  swmatcont", "[turns]",                  &cli_switch_matrix_cont,    "continually iterate over energy cells in external energy storage (0 -> infinity)"},
     {"caps",        "[initialCap] [currentCap]",&cli_test_capacitance_in_flash,     "Write then read capacitances from flash"},
@@ -400,6 +434,7 @@ static void cli_test_capacitance_in_flash(void)
     AppVarsSaveRequest( &newAppVars, CapacitanceAppVar );
     appVarsSaved = false;
     do {
+        ext_flash_task();
         HandleAppVarsOnExternalFlashSM();
         if( AppVarsSaveRequestReady() == true ) {
             appVarsSaved = true;
@@ -409,6 +444,7 @@ static void cli_test_capacitance_in_flash(void)
     Serial_printf(&cli_serial, "Retrieving initial Capacitance from flash\r\n");
 
     for(int i=0;i<10000;i++) {
+        ext_flash_task();
         HandleAppVarsOnExternalFlashSM();
         if( AppVarsReadRequestReady() == true) {
             savedAppVars = GetCurrentAppVars();
@@ -910,7 +946,21 @@ static void cli_ext_flash(void)
 
 static void cli_ext_flash_chip_erase(void)
 {
-    ext_flash_chip_erase();
+    if (!ext_flash_chip_erase()) {
+        Serial_printf(&cli_serial, "Chip erase timed out\r\n");
+    }
+    cli_ok();
+}
+
+static void cli_ext_flash_stats(void)
+{
+    ext_flash_print_stats();
+    cli_ok();
+}
+
+static void cli_param_store_stats(void)
+{
+    param_store_print_stats();
     cli_ok();
 }
 
@@ -1068,6 +1118,28 @@ static void cli_lfs_size(void)
     }
 }
 
+static void cli_lfs_bench(void)
+{
+    unsigned int files = 4;
+    unsigned long words = 0x4000;
+    int err;
+
+    if (cli_nargs(&cli) == 1) {
+        sscanf(cli_args(&cli), "%u", &files);
+    } else if (cli_nargs(&cli) >= 2) {
+        sscanf(cli_args(&cli), "%u %lu", &files, &words);
+    }
+    if (files == 0) {
+        files = 1;
+    }
+
+    if ((err = lfs_api_benchmark(files, words))) {
+        cli_lfs_error(err);
+    } else {
+        cli_ok();
+    }
+}
+
 static void cli_write_testlog_debug(void)
 {
     uint8_t starting_value = 0;
@@ -1078,8 +1150,7 @@ static void cli_write_testlog_debug(void)
                                              (uint16_t*)message};
 
     debug_log_t readBack;
-    /* temporarily set CPU1 as master of memory section */
-    MemCfg_setGSRAMMasterSel(MEMCFG_SECT_GS3, MEMCFG_GSRAMMASTER_CPU1);
+    debug_log_t testLog = {0};
 
     uint8_t nr_of_arguments = cli_nargs(&cli);
     if(nr_of_arguments > 2)
@@ -1104,17 +1175,17 @@ static void cli_write_testlog_debug(void)
         bool status;
 
         value = ((0xff - value)<<8) | (value);
-        sharedVars_cpu2toCpu1.debug_log.counter   = j; //value + i++;
-        sharedVars_cpu2toCpu1.debug_log.ISen1    = 10+j; //value + i++;
-        sharedVars_cpu2toCpu1.debug_log.ISen2    = 20+j; //value + i++;
-        sharedVars_cpu2toCpu1.debug_log.IF_1     = 30+j; //value + i++;
-        sharedVars_cpu2toCpu1.debug_log.I_Dab2  = 60+j;  //value + i++;
-        sharedVars_cpu2toCpu1.debug_log.I_Dab3  = 70+j;  //value + i++;
-        sharedVars_cpu2toCpu1.debug_log.Vbus  = 80+j;    //value + i++;
-        sharedVars_cpu2toCpu1.debug_log.VStore  = 90+j;  // i++;
-        sharedVars_cpu2toCpu1.debug_log.elapsed_time  = 2000+j;  // i++;
-        sharedVars_cpu2toCpu1.debug_log.CurrentState  = j;  // i++;
-        status = log_store_debug_log((unsigned char *)&sharedVars_cpu2toCpu1.debug_log);
+        testLog.counter   = j; //value + i++;
+        testLog.ISen1    = 10+j; //value + i++;
+        testLog.ISen2    = 20+j; //value + i++;
+        testLog.IF_1     = 30+j; //value + i++;
+        testLog.I_Dab2  = 60+j;  //value + i++;
+        testLog.I_Dab3  = 70+j;  //value + i++;
+        testLog.Vbus  = 80+j;    //value + i++;
+        testLog.VStore  = 90+j;  // i++;
+        testLog.elapsed_time  = 2000+j;  // i++;
+        testLog.CurrentState  = j;  // i++;
+        status = log_store_debug_log((unsigned char *)&testLog);
 
         /* check if log is active */
         if(false == status)
@@ -1144,9 +1215,18 @@ static void cli_write_testlog_debug(void)
 
         emif1_ram_debug_log_read.address += emif1_ram_debug_log_read.size;
     }
+}
 
-    /* configure as normal - set CPU2 as master of memory section */
-    MemCfg_setGSRAMMasterSel(MEMCFG_SECT_GS3, MEMCFG_GSRAMMASTER_CPU2);
+static void cli_debug_log_stats(void)
+{
+    log_debug_log_print_stats();
+    cli_ok();
+}
+
+static void cli_can_log_stats(void)
+{
+    log_can_print_stats();
+    cli_ok();
 }
 
 static void cli_write_testlog_can(void)
@@ -1238,6 +1318,12 @@ static void cli_cpu2_cmd(void)
     cli_ok();
 }
 
+static void cli_cpu2_log(void)
+{
+    cpu2_log_print_stats();
+    cli_ok();
+}
+
 bool cli_switches(uint32_t switchs, bool state)
 {
     bool retval = false;
@@ -1282,6 +1368,267 @@ bool cli_switches_non_blocking(uint32_t switchs, bool state)
 #pragma DATA_SECTION(cliDmaTestDestinationMemory, "ramgs1");  // map the RX data to memory
 uint16_t cliDmaTestSourceMemory[16];
 uint16_t cliDmaTestDestinationMemory[16];
+static void cli_emif_stats(void)
+{
+    emifc_print_stats();
+    cli_ok();
+}
+
+static void cli_can_queue_stats(void)
+{
+    CO_QUEUE_STATS_T stats;
+
+    coQueueGetStats(&stats);
+
+    Serial_printf(&cli_serial, "\r\ntransmit buffers used:   %u (high water %u)\r\n", stats.bufUsed, stats.bufHighWater);
+    Serial_printf(&cli_serial, "transmit ring depth:     %u\r\n", stats.transmitDepth);
+    Serial_printf(&cli_serial, "waiting for inhibit:     %u (high water %u)\r\n", stats.inhibitDepth, stats.inhibitHighWater);
+    Serial_printf(&cli_serial, "COBs in inhibit time:    %u\r\n", stats.inhibitCobs);
+    Serial_printf(&cli_serial, "overflows:               %lu\r\n", stats.overflows);
+    cli_ok();
+}
+
+#ifdef CODRV_VBUS
+static void cli_can_bench_result(const char *name, const can_bench_result_t *result)
+{
+    uint32_t kbit = codrvVbusBitRate();
+    uint32_t transfers = result->transfers ? result->transfers : 1;
+    uint32_t busBits = result->busBits ? result->busBits : 1;
+
+    Serial_printf(&cli_serial, "\r\n%s: %lu transfers, %lu bytes, %lu frames each, at %lu kbit/s\r\n",
+                  name, result->transfers, result->bytes / transfers, result->frames / transfers, kbit);
+    Serial_printf(&cli_serial, "  bus:  %lu us/transfer (max %lu), %lu bytes/s\r\n",
+                  (result->busBits / transfers) * 1000ul / kbit, result->maxBusBits * 1000ul / kbit,
+                  (uint32_t)((uint64_t)result->bytes * kbit * 1000ul / busBits));
+    Serial_printf(&cli_serial, "  cpu:  %lu cycles/transfer (max %lu)\r\n",
+                  result->cycles / transfers, result->maxCycles);
+    if (result->abortCode != 0) {
+        Serial_printf(&cli_serial, "  SDO abort 0x%08lx\r\n", result->abortCode);
+    }
+}
+
+/* SDO and PDO against this node, from a client on the virtual CAN bus */
+static void cli_can_bench(void)
+{
+    char sub[8] = "";
+    unsigned int index = 0x1008, subIndex = 0, arg3 = 0, arg4 = 0;
+    unsigned long id = CODRV_VBUS_ALL_IDS;
+    can_bench_result_t result;
+    CODRV_VBUS_ERROR_T error;
+    CODRV_VBUS_STATS_T stats;
+    UNSIGNED16 tec, rec;
+    int n;
+
+    n = sscanf(cli_args(&cli), "%7s", sub);
+    if (n < 1) {
+        Serial_printf(&cli_serial, "\r\ncan_bench up   [index sub [loops]]        expedited/segmented upload, hex index\r\n");
+        Serial_printf(&cli_serial, "can_bench blk  [index sub [blksize [loops]]] block upload\r\n");
+        Serial_printf(&cli_serial, "can_bench down [index sub [loops]]        write back the value read\r\n");
+        Serial_printf(&cli_serial, "can_bench log  [blksize [bytes]]          CAN log download, oldest first\r\n");
+        Serial_printf(&cli_serial, "can_bench pdo  n [loops]                  TPDO latency\r\n");
+        Serial_printf(&cli_serial, "can_bench err  every [id|-1 [drop]]       error frames, lost frames, 0 = off\r\n");
+        Serial_printf(&cli_serial, "can_bench rate kbit                       bit rate\r\n");
+        Serial_printf(&cli_serial, "can_bench stats\r\n");
+        cli_ok();
+        return;
+    }
+
+    if (strcmp(sub, "up") == 0 || strcmp(sub, "down") == 0) {
+        arg3 = 100;
+        sscanf(cli_args(&cli), "%*s %x %x %u", &index, &subIndex, &arg3);
+        if (!can_bench_sdo(sub[0] == 'u' ? CAN_BENCH_SDO_UPLOAD : CAN_BENCH_SDO_DOWNLOAD,
+                           index, subIndex, 0, arg3 ? arg3 : 1, &result)) {
+            cli_can_bench_result(sub, &result);
+            cli_error("transfer failed");
+            return;
+        }
+        cli_can_bench_result(result.bytes / (result.transfers ? result.transfers : 1) <= 4 ? "expedited" : "segmented", &result);
+    } else if (strcmp(sub, "blk") == 0) {
+        arg3 = 127;
+        arg4 = 100;
+        sscanf(cli_args(&cli), "%*s %x %x %u %u", &index, &subIndex, &arg3, &arg4);
+        if (!can_bench_sdo(CAN_BENCH_SDO_BLOCK_UPLOAD, index, subIndex, arg3, arg4 ? arg4 : 1, &result)) {
+            cli_can_bench_result("block", &result);
+            cli_error("transfer failed");
+            return;
+        }
+        cli_can_bench_result("block", &result);
+    } else if (strcmp(sub, "log") == 0) {
+        uint32_t from, maxBytes, cursor;
+        bool ok;
+
+        arg3 = 127;
+        arg4 = 4096;
+        sscanf(cli_args(&cli), "%*s %u %u", &arg3, &arg4);
+
+        /* download from the oldest record, the cursor is kept as it was */
+        coOdGetObj_u32(I_CAN_LOG, S_CAN_LOG_READ_FROM, &from);
+        coOdGetObj_u32(I_CAN_LOG, S_CAN_LOG_READ_MAX, &maxBytes);
+        coOdGetObj_u32(I_CAN_LOG, S_CAN_LOG_CURSOR, &cursor);
+        coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_READ_FROM, 0);
+        coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_READ_MAX, arg4);
+        ok = can_bench_sdo(CAN_BENCH_SDO_BLOCK_UPLOAD, I_CAN_LOG, S_CAN_LOG_READ, arg3, 1, &result);
+        coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_READ_FROM, from);
+        coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_READ_MAX, maxBytes);
+        coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_CURSOR, cursor);
+
+        cli_can_bench_result("CAN log", &result);
+        log_domain_print_stats();
+        if (!ok) {
+            cli_error("transfer failed, CAN log empty?");
+            return;
+        }
+    } else if (strcmp(sub, "pdo") == 0) {
+        arg3 = 1;
+        arg4 = 100;
+        sscanf(cli_args(&cli), "%*s %u %u", &arg3, &arg4);
+        if (!can_bench_tpdo(arg3, arg4 ? arg4 : 1, &result)) {
+            cli_error("TPDO not received, disabled, cyclic or RTR only");
+            return;
+        }
+        cli_can_bench_result("TPDO", &result);
+    } else if (strcmp(sub, "err") == 0) {
+        sscanf(cli_args(&cli), "%*s %u %lx %u", &arg3, &id, &arg4);
+        error.errorEvery = arg3;
+        error.errorCanId = id;
+        error.dropEvery = arg4;
+        codrvVbusSetError(&error);
+    } else if (strcmp(sub, "rate") == 0) {
+        sscanf(cli_args(&cli), "%*s %u", &arg3);
+        if (codrvCanSetBitRate(arg3) != RET_OK) {
+            codrvCanEnable();
+            cli_error("bit rate not supported");
+            return;
+        }
+        codrvCanEnable();
+    } else if (strcmp(sub, "stats") == 0) {
+        codrvVbusGetStats(&stats);
+        codrvVbusGetErrorCounters(0, &tec, &rec);
+        Serial_printf(&cli_serial, "\r\nbus time:         %lu bits at %u kbit/s\r\n", stats.bits, codrvVbusBitRate());
+        Serial_printf(&cli_serial, "frames:           %lu (%lu stuff bits)\r\n", stats.frames, stats.stuffBits);
+        Serial_printf(&cli_serial, "arbitration lost: %lu\r\n", stats.arbitrationLost);
+        Serial_printf(&cli_serial, "error frames:     %lu\r\n", stats.errorFrames);
+        Serial_printf(&cli_serial, "dropped:          %lu\r\n", stats.drops);
+        Serial_printf(&cli_serial, "overruns:         %lu\r\n", stats.overruns);
+        Serial_printf(&cli_serial, "bus off:          %lu\r\n", stats.busOffs);
+        Serial_printf(&cli_serial, "stack TEC/REC:    %u/%u\r\n", tec, rec);
+        codrvVbusClearStats();
+    } else {
+        cli_error("unknown sub-command");
+        return;
+    }
+    cli_ok();
+}
+#endif /* CODRV_VBUS */
+
+/* reads the objects written most often, the state and the SoH of the bank and cells,
+ * first searching the OD for each read then through handles looked up once */
+static void cli_od_bench(void)
+{
+    unsigned int loops = 100;
+    CO_OD_HANDLE_T handles[32];
+    uint16_t index[32];
+    uint8_t subIndex[32];
+    uint8_t value;
+    uint32_t start, searchCycles, handleCycles, reads;
+    int i;
+
+    if (cli_nargs(&cli) >= 1) {
+        sscanf(cli_args(&cli), "%u", &loops);
+    }
+    if (loops == 0) {
+        loops = 1;
+    }
+
+    index[0] = I_DPMU_STATE;
+    subIndex[0] = S_DPMU_OPERATION_CURRENT_STATE;
+    index[1] = I_ENERGY_BANK_SUMMARY;
+    subIndex[1] = S_STATE_OF_HEALTH_OF_ENERGY_BANK;
+    for (i = 2; i < 32; i++) {
+        index[i] = I_ENERGY_CELL_SUMMARY;
+        subIndex[i] = S_STATE_OF_HEALTH_OF_ENERGY_CELL_01 + i - 2;
+    }
+    for (i = 0; i < 32; i++) {
+        if (coOdGetObjHandle(index[i], subIndex[i], &handles[i]) != RET_OK) {
+            cli_error("object not found");
+            return;
+        }
+    }
+    reads = (uint32_t)loops * 32;
+
+    start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    for (unsigned int loop = 0; loop < loops; loop++) {
+        for (i = 0; i < 32; i++) {
+            coOdGetObj_u8(index[i], subIndex[i], &value);
+        }
+    }
+    searchCycles = ((uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start) / reads;
+
+    start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    for (unsigned int loop = 0; loop < loops; loop++) {
+        for (i = 0; i < 32; i++) {
+            coOdGetObjH_u8(&handles[i], &value);
+        }
+    }
+    handleCycles = ((uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start) / reads;
+
+    Serial_printf(&cli_serial, "\r\n%lu reads of 32 objects\r\n", reads);
+    Serial_printf(&cli_serial, "  by index:  %lu cycles/read, %lu reads/s\r\n",
+                  searchCycles, (uint32_t)DEVICE_SYSCLK_FREQ / (searchCycles ? searchCycles : 1));
+    Serial_printf(&cli_serial, "  by handle: %lu cycles/read, %lu reads/s\r\n",
+                  handleCycles, (uint32_t)DEVICE_SYSCLK_FREQ / (handleCycles ? handleCycles : 1));
+    cli_ok();
+}
+
+static void cli_pdo_bench(void)
+{
+    unsigned int loops = 100;
+    UNSIGNED8 bytes[CO_CAN_MAX_DATA_LEN], words[CO_CAN_MAX_DATA_LEN];
+    uint32_t start, byteCycles, wordCycles;
+    uint16_t pdoNr;
+    int pdos = 0;
+
+    if (cli_nargs(&cli) >= 1) {
+        sscanf(cli_args(&cli), "%u", &loops);
+    }
+    if (loops == 0) {
+        loops = 1;
+    }
+
+    Serial_printf(&cli_serial, "\r\nTPDO  frame  bytewise  wordwise (cycles/PDO, %u loops)\r\n", loops);
+    for (pdoNr = 1; pdoNr <= 512; pdoNr++) {
+        if (coPdoGetTrData(pdoNr, bytes, CO_FALSE) != RET_OK) {
+            continue;
+        }
+        coPdoGetTrData(pdoNr, words, CO_TRUE);
+        pdos++;
+
+        start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+        for (unsigned int loop = 0; loop < loops; loop++) {
+            coPdoGetTrData(pdoNr, bytes, CO_FALSE);
+        }
+        byteCycles = ((uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start) / loops;
+
+        start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+        for (unsigned int loop = 0; loop < loops; loop++) {
+            coPdoGetTrData(pdoNr, words, CO_TRUE);
+        }
+        wordCycles = ((uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start) / loops;
+
+        /* the objects may change while timing, compare a fresh pair */
+        coPdoGetTrData(pdoNr, bytes, CO_FALSE);
+        coPdoGetTrData(pdoNr, words, CO_TRUE);
+        Serial_printf(&cli_serial, "%4u  %-5s  %8lu  %8lu\r\n", pdoNr,
+                      memcmp(bytes, words, sizeof(bytes)) ? "DIFF" : "same",
+                      byteCycles, wordCycles);
+    }
+    if (pdos == 0) {
+        cli_error("no mapped TPDO");
+        return;
+    }
+    cli_ok();
+}
+
 static void cli_dma_test_gsram_ext_ram(void)
 {
     int result_total = 0;
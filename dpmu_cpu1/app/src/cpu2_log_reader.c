@@ -0,0 +1,203 @@
+/*
+ * cpu2_log_reader.c
+ *
+ *  CPU1 side of the CPU2 to CPU1 debug ring, see cpu2_log.h.
+ *
+ *  Records are formatted here, when the super loop has time for it, and
+ *  forwarded to the CLI serial port. A record with an unknown id or length
+ *  means CPU2 was restarted or the ring is corrupt, the reader then skips
+ *  everything written so far.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cpu2_log.h"
+#include "main.h"
+#include "serial.h"
+#include "shared_variables.h"
+
+#define CPU2_LOG_LINE_LEN   (2 * CPU2_LOG_MAX_TEXT)
+#define CPU2_LOG_SPEC_LEN   16
+
+#define CPU2_LOG_FORMAT_STRING(id, fmt) fmt,
+
+static const char *const cpu2LogFormats[CPU2_LOG_NUM_OF_IDS] = {
+    CPU2_LOG_FORMATS(CPU2_LOG_FORMAT_STRING)
+};
+
+static struct {
+    uint32_t records;       /* records forwarded */
+    uint32_t resyncs;       /* invalid records, reader skipped to the write index */
+    uint32_t droppedSeen;   /* CPU2 drop count already reported */
+} cpu2LogReader;
+
+static char cpu2LogLine[CPU2_LOG_LINE_LEN + 1];
+
+void cpu2_log_reader_init(void)
+{
+    /* skip whatever an earlier run of CPU2 left in message RAM */
+    sharedVars_cpu1toCpu2.cpu2_log_tail = cpu2_log_ring.head;
+    cpu2LogReader.droppedSeen = 0;
+}
+
+static inline uint16_t cpu2_log_word(uint16_t idx)
+{
+    return cpu2_log_ring.buffer[idx & CPU2_LOG_RING_MASK];
+}
+
+static inline uint32_t cpu2_log_word32(uint16_t idx)
+{
+    return (uint32_t)cpu2_log_word(idx) | ((uint32_t)cpu2_log_word(idx + 1) << 16);
+}
+
+/**
+ * @brief  Formats an event record, one 32 bit argument per conversion
+ * The line starts with the IPC counter value at which CPU2 logged the event.
+ */
+static void cpu2_log_format(const char *fmt, uint32_t timestamp, uint16_t argIdx, uint16_t nargs)
+{
+    char spec[CPU2_LOG_SPEC_LEN];
+    uint16_t len;
+    uint16_t specLen;
+    uint16_t arg = 0;
+    uint32_t value;
+    bool isLong;
+    char conversion;
+    union {
+        uint32_t u;
+        float f;
+    } fvalue;
+
+    len = snprintf(cpu2LogLine, CPU2_LOG_LINE_LEN + 1, "[%10lu] ", timestamp);
+
+    while ((*fmt != '\0') && (len < CPU2_LOG_LINE_LEN)) {
+        if (*fmt != '%') {
+            cpu2LogLine[len++] = *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            cpu2LogLine[len++] = '%';
+            fmt += 2;
+            continue;
+        }
+
+        /* copy the conversion specification, e.g. "%5.2f" or "%lu" */
+        specLen = 0;
+        isLong = false;
+        do {
+            if (*fmt == 'l') {
+                isLong = true;
+            }
+            spec[specLen++] = *fmt++;
+        } while ((*fmt != '\0') && (strchr("diouxXcfFeEgGs", *fmt) == NULL) && (specLen < CPU2_LOG_SPEC_LEN - 2));
+        conversion = *fmt;
+        if (conversion != '\0') {
+            spec[specLen++] = *fmt++;
+        }
+        spec[specLen] = '\0';
+
+        value = (arg < nargs) ? cpu2_log_word32(argIdx + 2 * arg) : 0;
+        arg++;
+
+        switch (conversion) {
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            fvalue.u = value;
+            len += snprintf(&cpu2LogLine[len], CPU2_LOG_LINE_LEN + 1 - len, spec, (double)fvalue.f);
+            break;
+        case 'd': case 'i':
+            if (isLong) {
+                len += snprintf(&cpu2LogLine[len], CPU2_LOG_LINE_LEN + 1 - len, spec, (long)value);
+            } else {
+                len += snprintf(&cpu2LogLine[len], CPU2_LOG_LINE_LEN + 1 - len, spec, (int)value);
+            }
+            break;
+        case 'o': case 'u': case 'x': case 'X': case 'c':
+            if (isLong) {
+                len += snprintf(&cpu2LogLine[len], CPU2_LOG_LINE_LEN + 1 - len, spec, (unsigned long)value);
+            } else {
+                len += snprintf(&cpu2LogLine[len], CPU2_LOG_LINE_LEN + 1 - len, spec, (unsigned int)value);
+            }
+            break;
+        default:
+            /* strings can not be passed as arguments */
+            cpu2LogLine[len++] = '?';
+            break;
+        }
+        if (len > CPU2_LOG_LINE_LEN) {
+            len = CPU2_LOG_LINE_LEN;
+        }
+    }
+    cpu2LogLine[len] = '\0';
+}
+
+/**
+ * @brief  Forwards at most maxRecords records from CPU2 to the CLI serial port
+ * @return number of records forwarded
+ */
+uint16_t cpu2_log_process(uint16_t maxRecords)
+{
+    uint16_t tail = sharedVars_cpu1toCpu2.cpu2_log_tail;
+    uint16_t head = cpu2_log_ring.head;
+    uint16_t count = 0;
+    uint16_t id, len, i;
+    uint32_t dropped;
+
+    dropped = cpu2_log_ring.dropped;
+    if (dropped < cpu2LogReader.droppedSeen) {
+        /* CPU2 restarted */
+        cpu2LogReader.droppedSeen = 0;
+    }
+    if (dropped != cpu2LogReader.droppedSeen) {
+        Serial_printf(&cli_serial, "[cpu2 log: %lu records dropped]\r\n", dropped - cpu2LogReader.droppedSeen);
+        cpu2LogReader.droppedSeen = dropped;
+    }
+
+    /* read the records only after the write index that published them */
+    CPU2_LOG_BARRIER();
+
+    while ((tail != head) && (count < maxRecords)) {
+        id = cpu2_log_word(tail);
+        len = cpu2_log_word(tail + 1);
+
+        if ((id >= CPU2_LOG_NUM_OF_IDS) || ((uint16_t)(CPU2_LOG_HEADER_WORDS + len) > (uint16_t)(head - tail))) {
+            cpu2LogReader.resyncs++;
+            tail = head;
+            break;
+        }
+
+        if (id == CPU2_LOG_TEXT) {
+            for (i = 0; (i < len) && (2 * i < CPU2_LOG_LINE_LEN); i++) {
+                uint16_t word = cpu2_log_word(tail + CPU2_LOG_HEADER_WORDS + i);
+                cpu2LogLine[2 * i] = word & 0xFF;
+                cpu2LogLine[2 * i + 1] = word >> 8;
+            }
+            cpu2LogLine[2 * i] = '\0';
+        } else {
+            cpu2_log_format(cpu2LogFormats[id], cpu2_log_word32(tail + 2), tail + CPU2_LOG_HEADER_WORDS, len / 2);
+        }
+
+        /* free the record before the slow serial output */
+        tail += CPU2_LOG_HEADER_WORDS + len;
+        CPU2_LOG_BARRIER();
+        sharedVars_cpu1toCpu2.cpu2_log_tail = tail;
+
+        Serial_printf(&cli_serial, "%s", cpu2LogLine);
+        cpu2LogReader.records++;
+        count++;
+    }
+
+    sharedVars_cpu1toCpu2.cpu2_log_tail = tail;
+    return count;
+}
+
+void cpu2_log_print_stats(void)
+{
+    uint16_t used = cpu2_log_ring.head - sharedVars_cpu1toCpu2.cpu2_log_tail;
+
+    Serial_printf(&cli_serial, " written by CPU2: %lu, dropped: %lu\r\n", cpu2_log_ring.records, cpu2_log_ring.dropped);
+    Serial_printf(&cli_serial, " forwarded: %lu, resyncs: %lu, ring: %u/%u words\r\n",
+                  cpu2LogReader.records, cpu2LogReader.resyncs, used, CPU2_LOG_RING_SIZE);
+}
@@ -15,6 +15,7 @@
 #include "GlobalV.h"
 #include "gpio.h"
 #include "ext_flash.h"
+#include "timer.h"
 
 /**
  * Definitions.
@@ -26,13 +27,37 @@
 #define EXT_FLASH_RESET             33      // GPIO pin connected to external flash RESET pin
 #define EXT_FLASH_READY             36      // GPIO pin connected to external flash RDY/BSY pin
 #define EXT_FLASH_A19               91
+#define EXT_FLASH_A19_PAGE_WORDS    0x80000 // words selected by one A19 level, the CS3 window
 
-#define EXT_FLASH_WRITE_MAX_COUNT_TIME_OUT 10
+#define EXT_FLASH_PAGE_PROGRAM_TIME_OUT    2000    // blocking word and write buffer program, us
+
+#define EXT_FLASH_WRITE_BUFFER_MAX  32      // largest write buffer used, words
+#define EXT_FLASH_CFI_WRITE_BUFFER  0x2A    // CFI: max bytes in multi-byte write = 2^n
+
+// Operation queue, completion signalled by the rising edge of RDY/BSY on XINT4.
+#define EXT_FLASH_READY_XINT            GPIO_INT_XINT4
+#define EXT_FLASH_READY_INT             INT_XINT4
+#define EXT_FLASH_READY_ACK_GROUP       INTERRUPT_ACK_GROUP12
+#define EXT_FLASH_OP_QUEUE_LEN          8       // power of two
+#define EXT_FLASH_PROGRAM_TIME_OUT_MS   10
+#define EXT_FLASH_ERASE_TIME_OUT_MS     5000
+#define EXT_FLASH_CHIP_ERASE_TIME_OUT_MS 120000
+#define EXT_FLASH_CYCLES_PER_US         (DEVICE_SYSCLK_FREQ / 1000000)
 
 /**
  * Macro definitions.
  */
-#define FLASH_SEQ(addr, data)   do { *(uint16_t *)(EXT_FLASH_START_ADDRESS_CS3 + (addr)) = (data); } while (0)
+#if defined(__TMS320C28XX__)
+#define EXT_FLASH_BUS_READ(addr)        (*(volatile uint16_t *)(addr))
+#define EXT_FLASH_BUS_WRITE(addr, data) do { *(volatile uint16_t *)(addr) = (data); } while (0)
+#else
+// Host builds, the bus cycles go to the flash emulator, see ext_flash.h.
+#define EXT_FLASH_BUS_READ(addr)        ext_flash_bus_read(addr)
+#define EXT_FLASH_BUS_WRITE(addr, data) ext_flash_bus_write((addr), (data))
+#endif
+
+#define FLASH_SEQ(addr, data)   EXT_FLASH_BUS_WRITE(EXT_FLASH_START_ADDRESS_CS3 + (addr), (data))
+#define CFI_READ(offset)        EXT_FLASH_BUS_READ(EXT_FLASH_START_ADDRESS_CS3 + (offset))
 
 /**
  * External references.
@@ -44,11 +69,7 @@ uint16_t *non_blocking_read_buff_ptr;
 size_t non_blocking_read_count;
 size_t   non_blocking_read_len;
 
-uint32_t non_blocking_write_addr;
-uint16_t *non_blocking_write_buff_ptr;
-size_t non_blocking_write_count;
-size_t   non_blocking_write_len;
-bool non_blocking_write_buff_start_flag;
+ext_flash_stats_t ext_flash_stats;
 
 /**
  * Global data.
@@ -100,6 +121,45 @@ uint16_t g_ext_flash_data[EXT_FLASH_SIZE_CS3];
  */
 //static uint32_t l_active_page = 0;
 
+// Words programmed by one write buffer command, 1 if the device has no write buffer.
+static uint16_t l_write_buffer_words = 1;
+
+// Operation queue, filled and emptied from the super loop only.
+static ext_flash_op_t l_op_queue[EXT_FLASH_OP_QUEUE_LEN];
+static uint16_t l_op_head = 0;              // next free entry
+static uint16_t l_op_tail = 0;              // operation in progress or next to start
+static bool     l_op_active = false;        // a command of the tail operation is in progress
+static size_t   l_op_words = 0;             // words of the program command in progress
+static uint32_t l_op_start_ms;
+static uint32_t l_op_start_cycles;
+static volatile bool     l_op_ready = false;     // set by the RDY/BSY edge
+static volatile uint32_t l_op_ready_cycles;
+
+// Held by a blocking command, the queue issues nothing meanwhile.
+static bool     l_locked = false;
+
+// Command latency, from issuing a command until RDY/BSY goes high.
+ext_flash_latency_t ext_flash_latency[EXT_FLASH_OP_TYPES];
+
+ext_flash_wear_t ext_flash_wear;
+
+/**
+ * Takes the flash for a blocking command. Queued operations are run to
+ * completion first, a command may only be sent while no other is running.
+ */
+static void ext_flash_lock(void)
+{
+    while (!ext_flash_idle()) {
+        ext_flash_task();
+    }
+    l_locked = true;
+}
+
+static void ext_flash_unlock(void)
+{
+    l_locked = false;
+}
+
 void look_up_start_address_of_sector(ext_flash_desc_t *sector_desc)
 {
     /* add virtual address offset of external flash */
@@ -122,6 +182,14 @@ static inline uint32_t set_a19(uint32_t addr)
     return page;
 }
 
+/**
+ * CS3 window address of a flash address, A19 selects the half of the flash.
+ */
+static inline uint32_t window(uint32_t addr)
+{
+    return EXT_FLASH_START_ADDRESS_CS3 | (addr & (EXT_FLASH_A19_PAGE_WORDS - 1));
+}
+
 /**
  * enter_CFI - Enter Flash CFI mode to access device information
  */
@@ -177,19 +245,30 @@ uint16_t ext_flash_read_word(uint32_t addr)
 {
     set_a19(addr);
 
-    uint16_t data = *(uint16_t *)addr;
+    uint16_t data = EXT_FLASH_BUS_READ(window(addr));
 
     return data;
 }
 
 /**
- * Reads buffer of 16b words from flash address.
+ * Reads buffer of 16b words from flash address, A19 is set once per half
+ * of the flash and the words are copied straight from the CS3 window.
  */
 void ext_flash_read_buf(uint32_t addr, uint16_t *buf, size_t len)
 {
-    for (size_t i = 0; i < len; ++i) {
-        uint16_t data = ext_flash_read_word(addr + i);
-        *buf++ = data;
+    while (len > 0) {
+        size_t count = EXT_FLASH_A19_PAGE_WORDS - (addr & (EXT_FLASH_A19_PAGE_WORDS - 1));
+        uint32_t src = window(addr);
+
+        if (count > len) {
+            count = len;
+        }
+        set_a19(addr);
+        for (size_t i = 0; i < count; ++i) {
+            *buf++ = EXT_FLASH_BUS_READ(src++);
+        }
+        addr += count;
+        len -= count;
     }
 }
 
@@ -235,55 +314,212 @@ bool ext_flash_non_blocking_read_buf()
 
 
 /**
- * ext_flash_write_word - Program single 16b word to Flash address
+ * Sends a sector erase command for the sector holding addr, returns at once.
+ * Every sector erase goes through here.
  */
-void ext_flash_write_word(uint32_t addr, uint16_t data)
+static void ext_flash_command_sector_erase(uint32_t addr)
 {
-    // Make sure the flash is erased, otherwise function will hang during write.
-    if (ext_flash_read_word(addr) != 0xffff) {
-        return;
-    }
+    // keeps the sector address bits of the small sectors SA0..SA3 too
+    uint32_t sector_offset = addr & 0x7f000;
+
     set_a19(0);
 
     FLASH_SEQ(0x555, 0xAA);
     FLASH_SEQ(0x2AA, 0x55);
-    FLASH_SEQ(0X555, 0xA0);
+    FLASH_SEQ(0x555, 0x80);
+    FLASH_SEQ(0x555, 0xAA);
+    FLASH_SEQ(0x2AA, 0x55);
+    set_a19(addr);
+    FLASH_SEQ(sector_offset, 0x30);
+
+    ext_flash_wear.sectorErases[ext_flash_sector_from_address(addr)->sector]++;
+}
+
+/**
+ * Checks that a range of the flash is erased, programming can only clear bits.
+ */
+static bool ext_flash_erased(uint32_t addr, size_t len)
+{
+    uint32_t src = window(addr);
 
+    // a program command never crosses a write buffer page, nor the A19 boundary
     set_a19(addr);
+    for (size_t i = 0; i < len; ++i) {
+        if (EXT_FLASH_BUS_READ(src + i) != 0xffff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Issues a word program command or, for more than one word, a write buffer
+ * program command. Does not wait for the flash to complete the command.
+ * Returns false without programming anything if the range is not erased,
+ * the device would never complete the command.
+ */
+static bool ext_flash_start_program(uint32_t addr, const uint16_t *buf, size_t len)
+{
+    if (!ext_flash_erased(addr, len)) {
+        return false;
+    }
+    set_a19(0);
+
+    FLASH_SEQ(0x555, 0xAA);
+    FLASH_SEQ(0x2AA, 0x55);
+
+    if (len == 1) {
+        FLASH_SEQ(0X555, 0xA0);
+
+        set_a19(addr);
+
+        EXT_FLASH_BUS_WRITE(window(addr), *buf);
+
+        ext_flash_stats.busCycles += 4;
+    } else {
+        // The upper address bits of the unlock cycles are don't care, the
+        // remaining cycles all address the sector being programmed.
+        set_a19(addr);
+
+        uint32_t dst = window(addr);
+
+        EXT_FLASH_BUS_WRITE(dst, 0x25);         // write to buffer
+        EXT_FLASH_BUS_WRITE(dst, len - 1);      // word count
+        for (size_t i = 0; i < len; ++i) {
+            EXT_FLASH_BUS_WRITE(dst + i, buf[i]);
+        }
+        EXT_FLASH_BUS_WRITE(dst, 0x29);         // program buffer to flash
+
+        ext_flash_stats.busCycles += 5 + len;
+    }
 
-    *(uint16_t* ) addr = data;
+    ext_flash_stats.programs++;
+    ext_flash_stats.words += len;
 
+    return true;
+}
+
+/**
+ * Leaves the write buffer abort state after a failed write buffer program.
+ */
+static void ext_flash_write_buffer_abort_reset(void)
+{
+    set_a19(0);
+
+    FLASH_SEQ(0x555, 0xAA);
+    FLASH_SEQ(0x2AA, 0x55);
+    FLASH_SEQ(0x555, 0xF0);
+}
+
+/**
+ * Reads the write buffer size of the device from its CFI data.
+ */
+static void ext_flash_detect_write_buffer(void)
+{
+    uint16_t n;
+
+    enter_CFI();
+
+    l_write_buffer_words = 1;
+    if ((CFI_READ(16) == 0x51) && (CFI_READ(17) == 0x52) && (CFI_READ(18) == 0x59)) {
+        n = CFI_READ(EXT_FLASH_CFI_WRITE_BUFFER);
+        if ((n > 1) && (n < 16)) {
+            l_write_buffer_words = 1U << (n - 1);
+        }
+        if (l_write_buffer_words > EXT_FLASH_WRITE_BUFFER_MAX) {
+            l_write_buffer_words = EXT_FLASH_WRITE_BUFFER_MAX;
+        }
+    }
+
+    exit_CFI();
+}
+
+/**
+ * Number of words from addr, at most len, that one program command can write.
+ * A write buffer program must stay within one write buffer page.
+ */
+size_t ext_flash_page_words(uint32_t addr, size_t len)
+{
+    uint32_t offset = addr - EXT_FLASH_START_ADDRESS_CS3;
+    size_t room = l_write_buffer_words - (offset & (l_write_buffer_words - 1));
+
+    return (len < room) ? len : room;
+}
+
+/**
+ * Waits for the command just sent to complete, false after time_out_us.
+ */
+static bool ext_flash_wait_ready_us(uint32_t time_out_us)
+{
     DEVICE_DELAY_US(EXT_FLASH_BUSY_DELAY); // Wait for Ready/Busy# signal to become valid
 
     while ( !ext_flash_ready() ) {
-        // Wait for Flash to complete command
-        //TODO locking
+        if (time_out_us-- == 0) {
+            return false;
+        }
+        DEVICE_DELAY_US(1);
     }
+    return true;
 }
 
+/**
+ * Waits for the erase command just sent to complete, false after time_out_ms.
+ */
+static bool ext_flash_wait_ready_ms(uint32_t time_out_ms)
+{
+    uint32_t start = timer_get_ticks();
+
+    DEVICE_DELAY_US(EXT_FLASH_BUSY_DELAY); // Wait for Ready/Busy# signal to become valid
+
+    while ( !ext_flash_ready() ) {
+        if ((timer_get_ticks() - start) > time_out_ms) {
+            return false;
+        }
+    }
+    return true;
+}
 
 /**
  * ext_flash_write_word - Program single 16b word to Flash address
+ * Returns false, with nothing programmed, if the word is not erased.
  */
-void ext_flash_non_blocking_write_word(uint32_t addr, uint16_t data)
+bool ext_flash_write_word(uint32_t addr, uint16_t data)
 {
-    // Make sure the flash is erased, otherwise function will hang during write.
-    if (ext_flash_read_word(addr) != 0xffff) {
-        return;
-    }
-    set_a19(0);
+    return ext_flash_write_page(addr, &data, 1) == 1;
+}
 
-    FLASH_SEQ(0x555, 0xAA);
-    FLASH_SEQ(0x2AA, 0x55);
-    FLASH_SEQ(0X555, 0xA0);
+/**
+ * ext_flash_write_page - Program up to one write buffer page to Flash address
+ * Returns 0, with nothing programmed, if the page range is not erased, or if
+ * the command did not complete.
+ */
+size_t ext_flash_write_page(uint32_t addr, const uint16_t *buf, size_t len)
+{
+    size_t count = ext_flash_page_words(addr, len);
 
-    set_a19(addr);
+    ext_flash_lock();
 
-    *(uint16_t* ) addr = data;
+    if (!ext_flash_start_program(addr, buf, count)) {
+        // Not erased, the device would never complete the command.
+        count = 0;
+    } else if (!ext_flash_wait_ready_us(EXT_FLASH_PAGE_PROGRAM_TIME_OUT)) {
+        ext_flash_stats.timeouts++;
+        if (count > 1) {
+            ext_flash_write_buffer_abort_reset();
+        }
+        count = 0;
+    }
 
+    ext_flash_unlock();
+
+    return count;
 }
 
-void ext_command_flash_chip_erase(void) {
+/**
+ * Sends a chip erase command, returns at once.
+ */
+static void ext_flash_command_chip_erase(void)
+{
     set_a19(0);
 
     FLASH_SEQ(0x555, 0xAA);
@@ -293,6 +529,11 @@ void ext_command_flash_chip_erase(void) {
     FLASH_SEQ(0x2AA, 0x55);
     FLASH_SEQ(0x555, 0x10);
 
+    ext_flash_wear.chipErases++;
+    for (uint16_t sector = 0; sector < EXT_FLASH_SA_LAST; sector++) {
+        ext_flash_wear.sectorErases[sector]++;
+    }
+
     DEVICE_DELAY_US(EXT_FLASH_BUSY_DELAY); // Wait for Ready/Busy# signal to become valid
 
 }
@@ -308,192 +549,271 @@ bool ext_flash_ready() {
 
 
 /**
- * Programs buffer of 16b words to Flash address.
+ * Programs buffer of 16b words to Flash address, one write buffer page at a time.
+ * Returns false at the first page that could not be programmed.
  */
-void ext_flash_write_buf(uint32_t addr, uint16_t *buf, size_t len)
+bool ext_flash_write_buf(uint32_t addr, uint16_t *buf, size_t len)
 {
-    for (size_t i = 0; i < len; ++i) {
-        uint16_t data = *buf++;
-        ext_flash_write_word(addr + i, data);
+    while (len > 0) {
+        size_t count = ext_flash_write_page(addr, buf, len);
+        if (count == 0) {
+            return false;
+        }
+        addr += count;
+        buf += count;
+        len -= count;
     }
+    return true;
 }
 
 /**
- * Initialize the parameters for the non ext_flash_non_blocking_w_buf function
+ * RDY/BSY rising edge, the command in progress has completed.
  */
-void ext_flash_init_non_blocking_write(uint32_t addr, uint16_t *bufferAddr, size_t len)
+__interrupt void ext_flash_ready_isr(void)
 {
-    non_blocking_write_count = 0;
-    non_blocking_write_addr = addr;
-    non_blocking_write_len = len;
-    non_blocking_write_buff_ptr = bufferAddr;
-    non_blocking_write_buff_start_flag = true;
+    l_op_ready_cycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    l_op_ready = true;
+
+    Interrupt_clearACKGroup(EXT_FLASH_READY_ACK_GROUP);
 }
 
-ext_flash_buff_write_status_t ext_flash_non_blocking_write_buf()
+/**
+ * Routes RDY/BSY to XINT4, interrupting on the busy to ready edge.
+ */
+static void ext_flash_ready_interrupt_setup(void)
 {
-    static ext_flash_buff_write_status_t retVal = EXT_FLASH_BUF_WAITING;
-    static uint16_t timeout_count=0;
-    enum EFWStates { EFWWaitStart = 0, EFWInit,
-                     EFWWrite, EFWIncrement, EFWWaitExtFlashReady,
-                     EFWEndOk, EFWEndError};
-
-
-    static States_t EFWSM = { 0 };
+    GPIO_setInterruptPin(EXT_FLASH_READY, EXT_FLASH_READY_XINT);
+    GPIO_setInterruptType(EXT_FLASH_READY_XINT, GPIO_INT_TYPE_RISING_EDGE);
+    Interrupt_register(EXT_FLASH_READY_INT, &ext_flash_ready_isr);
+    GPIO_enableInterrupt(EXT_FLASH_READY_XINT);
+    Interrupt_enable(EXT_FLASH_READY_INT);
+}
 
+static void ext_flash_latency_record(ext_flash_op_type_t type, uint32_t cycles)
+{
+    ext_flash_latency_t *latency = &ext_flash_latency[type];
+    uint32_t us = cycles / EXT_FLASH_CYCLES_PER_US;
+    uint16_t bin = 0;
 
-    switch( EFWSM.State_Current ) {
+    while ((bin < EXT_FLASH_LATENCY_BINS - 1) && (us >= ((uint32_t)EXT_FLASH_LATENCY_BIN0 << bin))) {
+        bin++;
+    }
+    latency->histogram[bin]++;
+    latency->count++;
+    if (us > latency->maxUs) {
+        latency->maxUs = us;
+    }
+}
 
-        case EFWWaitStart:
-            retVal = EXT_FLASH_BUF_WAITING;
-            if( non_blocking_write_buff_start_flag == true ) {
-                retVal = EXT_FLASH_BUF_WRITE_ONGOING;
-                EFWSM.State_Next = EFWInit;
-            }
-            break;
-
-        case EFWInit:
-                if( non_blocking_write_len == 0 ||
-                    non_blocking_write_buff_ptr == 0 ||
-                    non_blocking_write_addr == 0 ) {
-
-                    EFWSM.State_Next = EFWEndOk;
-                } else {
-                    EFWSM.State_Next = EFWWrite;
-                }
-            break;
-
-        case EFWWrite:
-            ext_flash_non_blocking_write_word(non_blocking_write_addr, (*non_blocking_write_buff_ptr) );
-            timeout_count=0;
-            EFWSM.State_Next = EFWWaitExtFlashReady;
-            break;
-
-        case EFWWaitExtFlashReady:
-            DEVICE_DELAY_US(EXT_FLASH_BUSY_DELAY); // Wait for Ready/Busy# signal to become valid
-
-            if( ext_flash_ready() == true ) {
-                EFWSM.State_Next = EFWIncrement;
-            } else {
-                timeout_count++;
-                if( timeout_count >= EXT_FLASH_WRITE_MAX_COUNT_TIME_OUT ) {
-                    EFWSM.State_Next = EFWEndError;
-                } else {
-                    EFWSM.State_Next = EFWWaitExtFlashReady;
-                }
-            }
-            break;
-
-        case EFWIncrement:
-            non_blocking_write_count++;
-            if( non_blocking_write_count < non_blocking_write_len ) {
-                non_blocking_write_addr++;
-                non_blocking_write_buff_ptr++;
-                EFWSM.State_Next = EFWWrite;
-            } else {
-                EFWSM.State_Next = EFWEndOk;
-            }
-            break;
+/**
+ * Sends the next command of an operation to the flash, returns at once.
+ * Returns false if nothing was sent, the operation has failed.
+ */
+static bool ext_flash_op_issue(ext_flash_op_t *op)
+{
+    l_op_ready = false;
+    l_op_start_ms = timer_get_ticks();
+    l_op_start_cycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+
+    switch (op->type) {
+    case EXT_FLASH_OP_PROGRAM:
+        l_op_words = ext_flash_page_words(op->addr, op->len);
+        if (!ext_flash_start_program(op->addr, op->buf, l_op_words)) {
+            // Not erased, the device would never complete the command.
+            return false;
+        }
+        break;
 
-        case EFWEndOk:
-            non_blocking_write_buff_start_flag = false;
-            EFWSM.State_Next = EFWWaitStart;
-            retVal = EXT_FLASH_BUF_WRITE_DONE;
+    case EXT_FLASH_OP_ERASE_SECTOR:
+        ext_flash_command_sector_erase(op->addr);
         break;
 
-        case EFWEndError:
-            non_blocking_write_buff_start_flag = false;
-            EFWSM.State_Next = EFWWaitStart;
-            retVal = EXT_FLASH_BUF_WRITE_TIME_OUT;
+    case EXT_FLASH_OP_ERASE_CHIP:
+    default:
+        ext_flash_command_chip_erase();
         break;
+    }
+
+    l_op_active = true;
+    return true;
+}
 
+static void ext_flash_op_finish(ext_flash_op_t *op, ext_flash_op_status_t status)
+{
+    ext_flash_op_callback_t callback = op->callback;
+    void *context = op->context;
+
+    l_op_active = false;
+    l_op_tail = (l_op_tail + 1) & (EXT_FLASH_OP_QUEUE_LEN - 1);
+
+    if (callback != NULL) {
+        callback(status, context);
     }
+}
 
-    EFWSM.State_Current = EFWSM.State_Next;
-    return retVal;
+static bool ext_flash_op_queue(ext_flash_op_type_t type, uint32_t addr, const uint16_t *buf, size_t len,
+                               ext_flash_op_callback_t callback, void *context)
+{
+    ext_flash_op_t *op;
+
+    if (((l_op_head - l_op_tail) & (EXT_FLASH_OP_QUEUE_LEN - 1)) == EXT_FLASH_OP_QUEUE_LEN - 1) {
+        return false;
+    }
 
+    op = &l_op_queue[l_op_head];
+    op->type = type;
+    op->addr = addr;
+    op->buf = buf;
+    op->len = len;
+    op->callback = callback;
+    op->context = context;
+    l_op_head = (l_op_head + 1) & (EXT_FLASH_OP_QUEUE_LEN - 1);
 
+    return true;
 }
 
 /**
- * ext_flash_chip_erase - Erase entire Flash memory space
+ * Queues programming of a buffer, buf must stay valid until the callback.
  */
-void ext_flash_chip_erase(void)
+bool ext_flash_queue_program(uint32_t addr, const uint16_t *buf, size_t len,
+                             ext_flash_op_callback_t callback, void *context)
 {
-    ext_command_flash_chip_erase();
-    while ( !ext_flash_ready() ) {
-        // Wait for Flash to complete command
+    if ((len == 0) || (buf == NULL)) {
+        return false;
     }
+    return ext_flash_op_queue(EXT_FLASH_OP_PROGRAM, addr, buf, len, callback, context);
 }
 
 /**
- * ext_flash_erase_sector - Erase addressed Flash sector
+ * Queues erasing of the sector holding addr.
  */
-void ext_flash_erase_sector_by_descriptor(ext_flash_desc_t *sector_desc)
+bool ext_flash_queue_erase_sector(uint32_t addr, ext_flash_op_callback_t callback, void *context)
 {
+    return ext_flash_op_queue(EXT_FLASH_OP_ERASE_SECTOR, addr, NULL, 0, callback, context);
+}
 
-    uint32_t sector_offset;
+/**
+ * Queues erasing of the entire flash.
+ */
+bool ext_flash_queue_chip_erase(ext_flash_op_callback_t callback, void *context)
+{
+    return ext_flash_op_queue(EXT_FLASH_OP_ERASE_CHIP, 0, NULL, 0, callback, context);
+}
 
-    sector_offset = sector_desc->addr - EXT_FLASH_START_ADDRESS_CS3;
+/**
+ * True when no queued operation is pending or in progress.
+ */
+bool ext_flash_idle(void)
+{
+    return l_op_head == l_op_tail;
+}
 
-    set_a19(0);
+/**
+ * Runs the operation queue, called from the super loop. Never waits for
+ * the flash, a command in progress is completed by the RDY/BSY interrupt.
+ */
+void ext_flash_task(void)
+{
+    static const uint32_t time_out_ms[EXT_FLASH_OP_TYPES] = {
+        EXT_FLASH_PROGRAM_TIME_OUT_MS,
+        EXT_FLASH_ERASE_TIME_OUT_MS,
+        EXT_FLASH_CHIP_ERASE_TIME_OUT_MS
+    };
+    ext_flash_op_t *op;
 
-    FLASH_SEQ(0x555, 0xAA);
-    FLASH_SEQ(0x2AA, 0x55);
-    FLASH_SEQ(0x555, 0x80);
-    FLASH_SEQ(0x555, 0xAA);
-    FLASH_SEQ(0x2AA, 0x55);
-    FLASH_SEQ(sector_offset, 0x30);
+    if (l_locked || ext_flash_idle()) {
+        return;
+    }
+    op = &l_op_queue[l_op_tail];
 
-    DEVICE_DELAY_US(EXT_FLASH_BUSY_DELAY); // Wait for Ready/Busy# signal to become valid
+    if (!l_op_active) {
+        if (!ext_flash_op_issue(op)) {
+            ext_flash_op_finish(op, EXT_FLASH_OP_FAIL);
+        }
+        return;
+    }
 
-    while (GPIO_readPin(EXT_FLASH_READY) == 0) {
-        // Serial_printf( &cli_serial, "Waiting GPIO_readPin(EXT_FLASH_READY)=[%d]\r\n",GPIO_readPin(EXT_FLASH_READY) );
-        // Wait for Flash to complete command
-        DEVICE_DELAY_US( EXT_FLASH_BUSY_DELAY * 1000 );
+    if (!l_op_ready) {
+        if ((timer_get_ticks() - l_op_start_ms) > time_out_ms[op->type]) {
+            if ((op->type == EXT_FLASH_OP_PROGRAM) && (l_op_words > 1)) {
+                ext_flash_write_buffer_abort_reset();
+            }
+            ext_flash_stats.timeouts++;
+            ext_flash_op_finish(op, EXT_FLASH_OP_TIME_OUT);
+        }
+        return;
     }
-}
 
+    ext_flash_latency_record(op->type, l_op_ready_cycles - l_op_start_cycles);
 
-void ext_flash_erase_sector(uint32_t sa)
-{
-    uint32_t sector_offset = sa & 0xf8000;
+    if (op->type == EXT_FLASH_OP_PROGRAM) {
+        op->addr += l_op_words;
+        op->buf += l_op_words;
+        op->len -= l_op_words;
+        if (op->len > 0) {
+            l_op_active = false;
+            if (!ext_flash_op_issue(op)) {
+                ext_flash_op_finish(op, EXT_FLASH_OP_FAIL);
+            }
+            return;
+        }
+    }
 
-    set_a19(0);
+    ext_flash_op_finish(op, EXT_FLASH_OP_OK);
+}
 
-    FLASH_SEQ(0x555, 0xAA);
-    FLASH_SEQ(0x2AA, 0x55);
-    FLASH_SEQ(0x555, 0x80);
-    FLASH_SEQ(0x555, 0xAA);
-    FLASH_SEQ(0x2AA, 0x55);
-    FLASH_SEQ(sector_offset, 0x30);
+/**
+ * ext_flash_chip_erase - Erase entire Flash memory space
+ * Returns false if the erase did not complete in time.
+ */
+bool ext_flash_chip_erase(void)
+{
+    bool ok;
 
-    DEVICE_DELAY_US(EXT_FLASH_BUSY_DELAY); // Wait for Ready/Busy# signal to become valid
+    ext_flash_lock();
+    ext_flash_command_chip_erase();
+    ok = ext_flash_wait_ready_ms(EXT_FLASH_CHIP_ERASE_TIME_OUT_MS);
+    ext_flash_unlock();
 
-    while (GPIO_readPin(EXT_FLASH_READY) == 0) {
-        // Wait for Flash to complete command
-    }
+    return ok;
 }
 
-void start_ext_flash_erase_sector(uint32_t sa)
+/**
+ * ext_flash_erase_sector - Erase addressed Flash sector
+ */
+bool ext_flash_erase_sector_by_descriptor(ext_flash_desc_t *sector_desc)
 {
-    uint32_t sector_offset = sa & 0xf8000;
+    return ext_flash_erase_sector(sector_desc->addr);
+}
 
-    set_a19(0);
+/**
+ * Erases the sector holding addr. Returns false if the erase did not complete in time.
+ */
+bool ext_flash_erase_sector(uint32_t sa)
+{
+    bool ok;
 
-    FLASH_SEQ(0x555, 0xAA);
-    FLASH_SEQ(0x2AA, 0x55);
-    FLASH_SEQ(0x555, 0x80);
-    FLASH_SEQ(0x555, 0xAA);
-    FLASH_SEQ(0x2AA, 0x55);
-    FLASH_SEQ(sector_offset, 0x30);
+    ext_flash_lock();
+    ext_flash_command_sector_erase(sa);
+    ok = ext_flash_wait_ready_ms(EXT_FLASH_ERASE_TIME_OUT_MS);
+    ext_flash_unlock();
 
-    DEVICE_DELAY_US(EXT_FLASH_BUSY_DELAY);
+    return ok;
+}
 
+/**
+ * Queues erasing of a sector, see verify_ext_flash_erase_sector_done().
+ */
+void start_ext_flash_erase_sector(uint32_t sa)
+{
+    ext_flash_queue_erase_sector(sa, NULL, NULL);
 }
 
+/**
+ * True when the queued erase, and anything queued before it, is done.
+ */
 bool verify_ext_flash_erase_sector_done(){
-    return (GPIO_readPin(EXT_FLASH_READY) == 0);
+    return ext_flash_idle();
 }
 
 
@@ -651,6 +971,50 @@ void ext_flash_config(void)
     tparam.wStrobe = 7;
     tparam.wHold = 0;
     EMIF_setAsyncTimingParams(EMIF1_BASE, EMIF_ASYNC_CS3_OFFSET, &tparam);
+
+    //
+    // Use the write buffer of the device, if it has one.
+    //
+    DEVICE_DELAY_US(EXT_FLASH_RESET_DELAY);         // RESET was just deasserted
+    ext_flash_detect_write_buffer();
+
+    ext_flash_ready_interrupt_setup();
+}
+
+/**
+ * ext_flash_print_stats - show program command counters.
+ */
+void ext_flash_print_stats(void)
+{
+    Serial_printf(&cli_serial, "Write buffer: %u words\r\n", l_write_buffer_words);
+    Serial_printf(&cli_serial, "Program commands: %lu, words: %lu, bus cycles: %lu, time outs: %lu\r\n",
+                  ext_flash_stats.programs, ext_flash_stats.words, ext_flash_stats.busCycles, ext_flash_stats.timeouts);
+
+    for (uint16_t type = 0; type < EXT_FLASH_OP_TYPES; type++) {
+        static const char *const names[EXT_FLASH_OP_TYPES] = { "program", "sector erase", "chip erase" };
+        const ext_flash_latency_t *latency = &ext_flash_latency[type];
+
+        Serial_printf(&cli_serial, "%s: %lu commands, max %lu us\r\n", names[type], latency->count, latency->maxUs);
+        for (uint16_t bin = 0; bin < EXT_FLASH_LATENCY_BINS; bin++) {
+            if (latency->histogram[bin] == 0) {
+                continue;
+            }
+            if (bin < EXT_FLASH_LATENCY_BINS - 1) {
+                Serial_printf(&cli_serial, "  < %8lu us: %lu\r\n",
+                              (uint32_t)EXT_FLASH_LATENCY_BIN0 << bin, latency->histogram[bin]);
+            } else {
+                Serial_printf(&cli_serial, "  rest       : %lu\r\n", latency->histogram[bin]);
+            }
+        }
+    }
+
+    Serial_printf(&cli_serial, "Erases per sector, %lu chip erases included:\r\n", ext_flash_wear.chipErases);
+    for (uint16_t sector = 0; sector < EXT_FLASH_SA_LAST; sector++) {
+        if (ext_flash_wear.sectorErases[sector] != ext_flash_wear.chipErases) {
+            Serial_printf(&cli_serial, "  SA%-2u 0x%06lx: %lu\r\n", sector, ex_flash_info[sector].addr,
+                          ext_flash_wear.sectorErases[sector]);
+        }
+    }
 }
 
 /**
@@ -658,13 +1022,15 @@ void ext_flash_config(void)
  */
 void ext_flash_test(void)
 {
+    static uint16_t testData[BUFFER_WORDS];
+
     //
     // Test interface with flash by reading CFI data
     //
     enter_CFI();
 
-    if ((g_ext_flash_data[16] != 0x51) || (g_ext_flash_data[17] != 0x52) || (g_ext_flash_data[18] != 0x59)) {
-        Serial_printf(&cli_serial, "Unknown flash device: [%04x] [%04x] [%04x]\r\n", g_ext_flash_data[16], g_ext_flash_data[17], g_ext_flash_data[18]);
+    if ((CFI_READ(16) != 0x51) || (CFI_READ(17) != 0x52) || (CFI_READ(18) != 0x59)) {
+        Serial_printf(&cli_serial, "Unknown flash device: [%04x] [%04x] [%04x]\r\n", CFI_READ(16), CFI_READ(17), CFI_READ(18));
         exit_CFI();
         return;
     }
@@ -684,7 +1050,7 @@ void ext_flash_test(void)
     //
     Serial_printf(&cli_serial, "Verifying flash erased ...\r\n");
     for (uint16_t word = 0; word < BUFFER_WORDS; word++) {
-        if (g_ext_flash_data[(uint32_t)word + 0x8000U] != 0xFFFF) {
+        if (ext_flash_read_word(EXT_FLASH_START_ADDRESS_CS3 + 0x8000U + word) != 0xFFFF) {
             Serial_printf(&cli_serial, "Flash erase failed!\r\n");
             return;
         }
@@ -695,22 +1061,20 @@ void ext_flash_test(void)
     //
     Serial_printf(&cli_serial, "Writing test data to flash ...\r\n");
     for (uint16_t word = 0; word < BUFFER_WORDS; word++) {
-        uint32_t wraddr = (uint32_t) &g_ext_flash_data[0x8000 + word];
-        if (word == 0) {
-            Serial_printf(&cli_serial, "Write starts at 0x%lx\r\n", wraddr);
-        }
-//        ext_flash_write_word((uint32_t) &g_ext_flash_data[0x8000 + word], word);
-        ext_flash_write_word(wraddr, word);
+        testData[word] = word;
     }
+    Serial_printf(&cli_serial, "Write starts at 0x%lx, %u words per program command\r\n",
+                  EXT_FLASH_START_ADDRESS_CS3 + 0x8000U, l_write_buffer_words);
+    ext_flash_write_buf(EXT_FLASH_START_ADDRESS_CS3 + 0x8000U, testData, BUFFER_WORDS);
 
-    ext_flash_write_word((uint32_t) &g_ext_flash_data[0x0007ff00], 0x1234);
+    ext_flash_write_word(EXT_FLASH_START_ADDRESS_CS3 + 0x0007ff00U, 0x1234);
 
     //
     // Verify dataBuffer contents
     //
     Serial_printf(&cli_serial, "Verifying test data in flash ...\r\n");
     for (uint16_t word = 0; word < BUFFER_WORDS; word++) {
-        if (g_ext_flash_data[(uint32_t)word + 0x8000U] != word) {
+        if (ext_flash_read_word(EXT_FLASH_START_ADDRESS_CS3 + 0x8000U + word) != word) {
             Serial_printf(&cli_serial, "Verification failed!\r\n");
             return;
         }
@@ -5,13 +5,17 @@
  *      Author: vb
  */
 
+#include <stddef.h>
 #include <string.h>
 
 #include "application_vars.h"
 #include "board.h"
+#include "can_log_codec.h"
+#include "check_CPU2.h"
 #include "co_canopen.h"
 #include "co_common.h"
 #include "co_p401.h"
+#include "device.h"
 #include "emifc.h"
 #include "error_handling.h"
 #include "ext_flash.h"
@@ -51,12 +55,171 @@ static uint32_t can_log_next_free_address           = CAN_LOG_ADDRESS_START;
 //used in non-blocking write do flash operation
 static uint32_t log_store_destination_address = 0;
 static uint32_t log_store_source_address = 0;
-static unsigned char *log_store_data_buffer_pnt = 0;
+static uint16_t *log_store_data_buffer_pnt = 0;   /* indexed in words */
 static uint16_t log_store_size_in_words = 0;
 static uint16_t log_store_count_data = 0;
 
 static bool can_log_possible = false;
 
+/* CAN log sectors
+ *
+ * Every sector of the CAN log region starts with a can_log_sector_header_t
+ * holding a sequence number, one higher for each sector taken into use, and
+ * the fill state of the sector. Records never cross a sector boundary.
+ * Sequence numbers increase from the first sector of the region up to the
+ * head sector, the sectors after it are older or erased, so the head is
+ * found with a binary search over the sector headers and the last written
+ * block with a binary search within the head sector.
+ *
+ * The rest of a sector is divided in blocks of CAN_LOG_BLOCK_WORDS. The
+ * records of a block follow each other without gaps, the first one is a
+ * keyframe, a copy of the debug_log_t, the others are normally deltas
+ * against the record before them, encoded by can_log_codec.c. A record is
+ * decoded starting from the keyframe of its block, at most
+ * CAN_LOG_BLOCK_WORDS are read.
+ */
+#define CAN_LOG_SECTORS             ((uint16_t)((CAN_LOG_ADDRESS_END - CAN_LOG_ADDRESS_START) / CAN_LOG_SECTOR_SIZE))
+#define CAN_LOG_SEQUENCE_ERASED     0u
+#define CAN_LOG_SEQUENCE_INVALID    0xFFFFFFFFu
+
+static uint32_t can_log_sequence = 0;           /* sequence number of the head sector */
+static bool can_log_head_sector_open = false;   /* false: the next record goes to a new sector */
+
+static struct {
+    uint16_t headerReads;   /* sector headers read, since the last boot scan */
+    uint16_t recordProbes;  /* block and record headers read, since the last boot scan */
+    uint32_t cycles;        /* duration of the last boot scan */
+} can_log_scan;
+
+/* record being written and the state of the block it goes to */
+static uint16_t can_log_encoded[CAN_LOG_ENCODED_MAX_WORDS];
+static uint16_t can_log_encoded_words = 0;
+static debug_log_t can_log_previous;            /* last record of the open block */
+static bool can_log_block_open = false;         /* false: the next record starts a new block */
+static uint32_t can_log_block_end;
+
+static struct {
+    uint32_t keyframes;
+    uint32_t deltas;
+    uint32_t rawWords;      /* CAN_LOG_RECORD_RAW_WORDS per record */
+    uint32_t storedWords;   /* words written, record headers included */
+    uint32_t encodeCycles;
+    uint32_t maxEncodeCycles;
+} can_log_codec;
+
+/* CAN log download over SDO
+ *
+ * A position in the CAN log is the sequence number of a sector times
+ * CAN_LOG_SECTOR_SIZE plus the offset in the sector. Positions only grow,
+ * also over restarts, so a host continues a download from CAN_LOG_CURSOR,
+ * the position after the last record it received.
+ *
+ * The domain of CAN_LOG_READ is a stream of records as they are stored in
+ * flash, without sector headers and unused block ends. The first record is
+ * always sent as a keyframe, the records after it are decoded against the
+ * record before them in the stream.
+ */
+#define CAN_LOG_FROM_OLDEST         0u
+#define CAN_LOG_FROM_CURSOR         0xFFFFFFFFu
+
+static uint32_t can_log_written_end = CAN_LOG_ADDRESS_START;   /* after the last programmed record */
+static uint32_t can_log_written_position = 0;                   /* log position of can_log_written_end */
+
+static struct {
+    uint32_t address;       /* record being sent */
+    uint32_t end;           /* address after the last record to send */
+    uint32_t remaining;     /* words left to send */
+    uint32_t cursor;        /* CAN_LOG_CURSOR once the SDO transfer completes */
+    uint16_t offset;        /* words of the record at address sent */
+    bool first;             /* the record at address goes out as keyframe */
+    bool lost;              /* the sector being sent was erased */
+    uint16_t keyframe[CAN_LOG_KEYFRAME_WORDS];
+} can_log_download;
+
+static struct {
+    uint32_t downloads;
+    uint32_t completed;     /* SDO transfer finished, cursor committed */
+    uint32_t aborted;       /* SDO transfer aborted, cursor kept */
+    uint32_t bytes;
+    uint32_t setupCycles;   /* last download */
+} can_log_download_stats;
+
+static uint32_t log_can_download_start(uint32_t from, uint32_t maxBytes);
+static void log_can_download_fill(uint16_t *buf, uint32_t size);
+
+/* SDO domain buffers of the debug log and the CAN log
+ *
+ * The SDO server sends one buffer while the next chunk is read into the other.
+ * log_read_domain() arms the prefetch, log_domain_prefetch() reads the chunk
+ * from the super loop while the stack waits for the bus, the debug log through
+ * the EMIF DMA. The DMA reaches GS RAM only.
+ *
+ * The indication never waits for the DMA. A chunk that is not in its buffer
+ * yet is answered with RET_SDO_SPLIT_INDICATION, the SDO server holds the
+ * transfer and log_domain_prefetch() continues it once the DMA is done.
+ */
+#define LOG_DOMAIN_CHUNK_BYTES      (7u * CO_SSDO_DOMAIN_CNT)   /* bytes per domain indication */
+#define LOG_DOMAIN_CHUNK_WORDS      ((LOG_DOMAIN_CHUNK_BYTES + 1) / 2)
+
+#pragma DATA_SECTION(log_domain_buf, "ramgs0")
+static uint16_t log_domain_buf[2][LOG_DOMAIN_CHUNK_WORDS];
+
+static struct {
+    uint16_t index;         /* domain being sent */
+    uint8_t subIndex;
+    uint8_t sdoNr;          /* SDO server sending it */
+    uint16_t current;       /* buffer the stack sends from */
+    uint32_t size;          /* domain size in bytes */
+    uint32_t next;          /* bytes sent before the next chunk */
+    uint32_t address;       /* debug log address of the prefetched chunk */
+    bool pending;           /* next chunk to be prefetched */
+    bool prefetched;        /* next chunk is in the other buffer, or on its way */
+    bool split;             /* the SDO server waits for the current chunk */
+    bool deferred;          /* the current chunk is read once the DMA is done */
+    uint32_t words;         /* size of the deferred chunk */
+    volatile bool dmaDone;  /* no prefetch DMA running */
+} log_domain = { 0, 0, 0, 0, 0, 0, 0, false, false, false, false, 0, true };
+
+static struct {
+    uint32_t chunks;            /* domain indications */
+    uint32_t prefetched;        /* chunks taken from the prefetch buffer */
+    uint32_t waited;            /* of those, still on the DMA, sent after a split indication */
+    uint32_t direct;            /* chunks read in the indication */
+    uint32_t indicationCycles;  /* time spent in the indication */
+    uint32_t maxIndicationCycles;
+    uint32_t prefetchCycles;    /* time spent prefetching, DMA not counted */
+} log_domain_stats;
+
+/* CAN log records waiting in RAM to be written to external flash
+ *
+ * Records are staged as soon as CPU2 publishes them and written in bursts,
+ * page by page, as long as the time budget of the super loop pass lasts.
+ * A record arriving while the stage is full is dropped.
+ */
+#define CAN_LOG_STAGE_RECORDS       8       /* power of two */
+#define CAN_LOG_DRAIN_BUDGET_US     1000    /* flash programming per super loop pass */
+#define CAN_LOG_CYCLES_PER_US       (DEVICE_SYSCLK_FREQ / 1000000)
+
+static debug_log_t can_log_stage[CAN_LOG_STAGE_RECORDS];
+static uint16_t can_log_stage_head = 0;     /* next free record */
+static uint16_t can_log_stage_tail = 0;     /* oldest record, being written */
+static uint32_t can_log_store_budget_start;
+
+static struct {
+    uint32_t staged;        /* records put in the stage */
+    uint32_t written;       /* records written to flash */
+    uint32_t dropped;       /* records lost, stage full */
+    uint32_t flashErrors;   /* records lost, flash not erased or program timed out */
+    uint32_t passes;        /* super loop passes that programmed flash */
+    uint16_t maxBacklog;    /* most records waiting at once */
+} can_log_stats;
+
+/* reads of the debug log record published by CPU2 */
+#define DEBUG_LOG_SNAPSHOT_ATTEMPTS 3
+static uint32_t debug_log_snapshots  = 0;   /* consistent copies taken */
+static uint32_t debug_log_torn_reads = 0;   /* copies discarded, CPU2 wrote the buffer meanwhile */
+static uint32_t debug_log_missed     = 0;   /* gave up after DEBUG_LOG_SNAPSHOT_ATTEMPTS */
+
 static States_t canLogState = { 0 };
 
 RET_T log_debug_log_set_state(uint8_t value)
@@ -71,107 +234,246 @@ RET_T log_debug_log_set_state(uint8_t value)
     return RET_OK;
 }
 
+/* debug log address to read from, wrapped to the start of the external RAM */
+static uint32_t log_debug_log_read_address(void)
+{
+    if( debug_log_last_read_address >= (EXT_RAM_START_ADDRESS_CS2 + EXT_RAM_SIZE_CS2) ) {
+        return EXT_RAM_START_ADDRESS_CS2;
+    }
+    return debug_log_last_read_address;
+}
+
+/* drops the prefetched chunk, a DMA still running is left to finish */
+static void log_domain_cancel(void)
+{
+    log_domain.pending = false;
+    log_domain.prefetched = false;
+    log_domain.split = false;
+    log_domain.deferred = false;
+}
+
+/* points index:subIndex to the first domain buffer, size in bytes */
+static void log_domain_start(UNSIGNED8 sdoNr, UNSIGNED16 index, UNSIGNED8 subIndex, uint32_t size)
+{
+    log_domain_cancel();
+    log_domain.sdoNr = sdoNr;
+    log_domain.index = index;
+    log_domain.subIndex = subIndex;
+    log_domain.size = size;
+    log_domain.current = 0;
+
+    coOdDomainAddrSet(index, subIndex, (CO_DOMAIN_PTR)log_domain_buf[0], size);
+}
+
+/**
+ * @brief   Reads words of the domain into the current buffer, in the indication
+ * @return  false if the debug log has nothing left to read
+ */
+static bool log_domain_read_direct(uint32_t words)
+{
+    uint32_t start_address;
+
+    if(I_DEBUG_LOG == log_domain.index)
+    {
+        if( debug_log_last_read_address >= debug_log_next_free_address   ) {
+            return false;
+        }
+        start_address = log_debug_log_read_address();
+
+        /* set CPU1 as master for memory */
+        MemCfg_setGSRAMMasterSel(MEMCFG_SECT_GS0, MEMCFG_GSRAMMASTER_CPU1);
+
+        emif1_log_read.address = start_address;
+        emif1_log_read.cpuType = CPU_TYPE_ONE;
+        emif1_log_read.data = log_domain_buf[log_domain.current];
+        emif1_log_read.size = words;
+        emifc_cpu_read_memory(&emif1_log_read);
+        debug_log_last_read_address = start_address + words;
+    } else {
+        log_can_download_fill(log_domain_buf[log_domain.current], words);
+    }
+    return true;
+}
+
+/* lets the SDO server send the chunk it was told to wait for */
+static void log_domain_continue(void)
+{
+    if( !log_domain.dmaDone ) {
+        return;
+    }
+    if( log_domain.deferred ) {
+        log_domain.deferred = false;
+        (void)log_domain_read_direct(log_domain.words);
+    }
+    log_domain.split = false;
+    (void)coSdoServerReadIndCont(log_domain.sdoNr, RET_OK);
+}
+
+/**
+ * @brief   Reads the next SDO domain chunk into the buffer not being sent
+ *
+ * Called from the super loop. The debug log is read by the EMIF DMA, a
+ * transfer held by log_read_domain() for it continues when the DMA is done.
+ * Only one DMA runs at a time, dmaDone tells about the last one queued.
+ */
+void log_domain_prefetch(void)
+{
+    uint32_t cycles;
+    uint32_t bytes;
+    uint16_t *buf;
+
+    if( log_domain.split ) {
+        log_domain_continue();
+    }
+    if( !log_domain.pending || !log_domain.dmaDone ) {
+        return;
+    }
+    cycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+
+    bytes = log_domain.size - log_domain.next;
+    if( bytes > LOG_DOMAIN_CHUNK_BYTES ) {
+        bytes = LOG_DOMAIN_CHUNK_BYTES;
+    }
+    buf = log_domain_buf[log_domain.current ^ 1];
+
+    if( I_DEBUG_LOG == log_domain.index ) {
+        if( debug_log_last_read_address >= debug_log_next_free_address ) {
+            log_domain.pending = false;
+            return;
+        }
+        log_domain.address = log_debug_log_read_address();
+        log_domain.dmaDone = false;
+
+        /* set CPU1 as master for memory */
+        MemCfg_setGSRAMMasterSel(MEMCFG_SECT_GS0, MEMCFG_GSRAMMASTER_CPU1);
+        if( !emifc_queue_read(log_domain.address, buf, (bytes + 1) / 2, emifc_set_flag, (void *)&log_domain.dmaDone) ) {
+            /* queue full, try again next pass */
+            log_domain.dmaDone = true;
+            return;
+        }
+    } else {
+        log_can_download_fill(buf, (bytes + 1) / 2);
+    }
+    log_domain.pending = false;
+    log_domain.prefetched = true;
+
+    log_domain_stats.prefetchCycles += (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - cycles;
+}
+
+void log_domain_print_stats(void)
+{
+    Serial_printf(&cli_serial, " domain chunks: %lu of %u bytes, prefetched: %lu (waited for DMA: %lu), read in indication: %lu\r\n",
+                  log_domain_stats.chunks, LOG_DOMAIN_CHUNK_BYTES, log_domain_stats.prefetched,
+                  log_domain_stats.waited, log_domain_stats.direct);
+    Serial_printf(&cli_serial, " domain indication: %lu us total, max %lu cycles, prefetch: %lu us total\r\n",
+                  log_domain_stats.indicationCycles / CAN_LOG_CYCLES_PER_US, log_domain_stats.maxIndicationCycles,
+                  log_domain_stats.prefetchCycles / CAN_LOG_CYCLES_PER_US);
+}
+
 /** \brief function pointer to SDO server read domain event
 * \param index - object index
 * \param subindex - object subindex
 * \param domainBufSize - actual size at domain buffer
 * \param transferSize - actual transfered size
 *
-* \return RET_T
+* \return RET_OK, or RET_SDO_SPLIT_INDICATION while the chunk is still on its way
 */
-void log_read_domain(UNSIGNED16 index, UNSIGNED8 subindex, UNSIGNED32 domainBufSize, UNSIGNED32 domainTransferedSize)
+RET_T log_read_domain(UNSIGNED16 index, UNSIGNED8 subindex, UNSIGNED32 domainBufSize, UNSIGNED32 domainTransferedSize)
 {
-    uint32_t start_address = 0;
+    uint32_t words;
+    uint32_t cycles;
 
-    static uint32_t sumOfTransferedBytes = 0;
+    if(I_STATE_MACHINE_STATS == index)
+    {
+        /* CAN/CANopen standard uses Bytes, we store 16 bit Words */
+        cpu2_state_machine_stats_read_domain((domainTransferedSize + 1) / 2, (domainBufSize + 1) / 2);
+        return RET_OK;
+    }
+    if( (I_DEBUG_LOG != index) && (I_CAN_LOG != index) ) {
+        return RET_OK;
+    }
+    if( (log_domain.index != index) || (domainTransferedSize >= log_domain.size) ) {
+        /* the stack asks once more after the last chunk of a block */
+        return RET_OK;
+    }
 
-    //Disable new logs while in transfer
-    sharedVars_cpu1toCpu2.debug_log_disable_flag = true;
+    cycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
 
     // Doublecheck that domainbufsize are not bigger than allocated buf size.
-    if (domainBufSize > TRANSFER_SIZE ) {
-        domainBufSize = TRANSFER_SIZE;
+    if (domainBufSize > LOG_DOMAIN_CHUNK_BYTES ) {
+        domainBufSize = LOG_DOMAIN_CHUNK_BYTES;
     }
 
     /* CAN/CANopen standard uses Bytes, we store 16 bit Words */
-    domainBufSize = (domainBufSize + 1) / 2;
-    domainTransferedSize = (domainTransferedSize + 1) / 2;
-
-    if(I_DEBUG_LOG == index)
-    {
-        if( debug_log_last_read_address >= debug_log_next_free_address   ) {
-            //debug_log_last_read_address = debug_log_last_read_address;
-            return;
+    words = (domainBufSize + 1) / 2;
+
+    if( log_domain.prefetched && (log_domain.next == domainTransferedSize) ) {
+        /* read while the previous chunk was sent */
+        log_domain.prefetched = false;
+        log_domain.current ^= 1;
+        if(I_DEBUG_LOG == index) {
+            debug_log_last_read_address = log_domain.address + words;
         }
-        start_address = debug_log_last_read_address;
-        if(start_address >= (EXT_RAM_START_ADDRESS_CS2 + EXT_RAM_SIZE_CS2))
-            start_address = EXT_RAM_START_ADDRESS_CS2;
-    }
-    if(I_CAN_LOG == index)
-    {
-//        if( can_log_last_read_address >= can_log_next_free_address   ) {
-//            can_log_last_read_address = can_log_last_read_address;
-//            return;
-//        }
-        start_address = can_log_last_read_address;
-        if(start_address >= CAN_LOG_ADDRESS_END) {
-            start_address = CAN_LOG_ADDRESS_START;
+        log_domain_stats.prefetched++;
+        if( !log_domain.dmaDone ) {
+            /* held until log_domain_prefetch() sees the DMA done */
+            log_domain_stats.waited++;
+            log_domain.split = true;
         }
+    } else {
+        log_domain_cancel();
+
+        if( !log_domain.dmaDone ) {
+            /* the DMA of a dropped prefetch still writes to a buffer */
+            log_domain.words = words;
+            log_domain.deferred = true;
+            log_domain.split = true;
+        } else if( !log_domain_read_direct(words) ) {
+            return RET_OK;
+        }
+        log_domain_stats.direct++;
     }
 
+    /* the stack sends from the start of the domain after each indication */
+    coOdDomainAddrSet(index, subindex, (CO_DOMAIN_PTR)log_domain_buf[log_domain.current], log_domain.size);
 
-    /* set CPU1 as master for memory */
-    MemCfg_setGSRAMMasterSel(MEMCFG_SECT_GS0, MEMCFG_GSRAMMASTER_CPU1);
-    //MemCfg_setGSRAMMasterSel(MEMCFG_SECT_GS3, MEMCFG_GSRAMMASTER_CPU1);
-
-    if (I_DEBUG_LOG == index) {
-
-        emif1_log_read.address = start_address;
-        emif1_log_read.cpuType = CPU_TYPE_ONE;
-        emif1_log_read.data = (uint16_t *)message;
-        emif1_log_read.size = domainBufSize;
-        //DMA_configBurst(CPU1_EXT_MEM_BASE, TRANSFER_SIZE, 1, 1);
-        emifc_cpu_read_memory(&emif1_log_read);
-        debug_log_last_read_address = start_address + domainBufSize;
-        sumOfTransferedBytes = sumOfTransferedBytes + domainBufSize;
-        if( sumOfTransferedBytes >= sizeof(debug_log_t) ) {
-            //debug_log_last_read_address = debug_log_last_read_address + sizeof(debug_log_t);
-            sumOfTransferedBytes = 0;
-        }
-        if( (debug_log_next_free_address - debug_log_last_read_address) == 0 ){
-            sharedVars_cpu1toCpu2.debug_log_disable_flag = false;
-        }
+    log_domain.next = domainTransferedSize + domainBufSize;
+    log_domain.pending = (log_domain.next < log_domain.size);
 
+    cycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - cycles;
+    log_domain_stats.chunks++;
+    log_domain_stats.indicationCycles += cycles;
+    if( cycles > log_domain_stats.maxIndicationCycles ) {
+        log_domain_stats.maxIndicationCycles = cycles;
     }
 
-    if (I_CAN_LOG == index) {
-        emif1_log_read.address = start_address;
-        emif1_log_read.cpuType = CPU_TYPE_ONE;
-        emif1_log_read.data = (uint16_t *)message;
-        emif1_log_read.size = domainBufSize;
-        ext_flash_read_buf(emif1_log_read.address, (uint16_t*)emif1_log_read.data, emif1_log_read.size);
-        can_log_last_read_address = start_address + domainBufSize;
-
-        sumOfTransferedBytes = sumOfTransferedBytes + domainBufSize;
-        if( sumOfTransferedBytes >= sizeof(debug_log_t) ) {
-            //debug_log_last_read_address = debug_log_last_read_address + sizeof(debug_log_t);
-            sumOfTransferedBytes = 0;
-        }
+    return log_domain.split ? RET_SDO_SPLIT_INDICATION : RET_OK;
+}
 
-        //Enable new logs after transfer
-        sharedVars_cpu1toCpu2.debug_log_disable_flag = false;
-//        if( (can_log_next_free_address - can_log_last_read_address) == 0 ){
-//            sharedVars_cpu1toCpu2.debug_log_disable_flag = false;
-//        }
+/**
+ * @brief   SDO server domain read finished event
+ *
+ * Called once per upload of a domain, with RET_OK after the client got the
+ * last byte, with the abort reason otherwise. CAN_LOG_CURSOR moves on only
+ * when the whole CAN_LOG_READ domain was delivered, an aborted download is
+ * repeated from the same position.
+ */
+void log_read_domain_finished(UNSIGNED16 index, UNSIGNED8 subindex, UNSIGNED32 transferedSize, RET_T result)
+{
+    if( (log_domain.index != index) || (log_domain.subIndex != subindex) ) {
+        return;
     }
+    log_domain_cancel();
 
-//    Serial_debug(DEBUG_INFO, &cli_serial, "%08x  ", start_address);
-//    Serial_debug(DEBUG_INFO, &cli_serial, "%04x  ", domainBufSize);
-//    for(int i = 0; i < domainBufSize; i++)
-//    {
-//        Serial_debug(DEBUG_INFO, &cli_serial, "%04x ", message[i]);
-//    }
-//    Serial_debug(DEBUG_INFO, &cli_serial, "\r\n");
+    if( I_CAN_LOG != index ) {
+        return;
+    }
+    if( (RET_OK == result) && (transferedSize == log_domain.size) ) {
+        coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_CURSOR, can_log_download.cursor);
+        can_log_download_stats.completed++;
+    } else {
+        can_log_download_stats.aborted++;
+    }
 }
 
 uint8_t log_debug_log_read(
@@ -196,24 +498,11 @@ uint8_t log_debug_log_read(
             (uint16_t*)message
          };
 
-        /* set the CANopen OD object to point to the right domain, the variable message
-         * set the CANopen OD object size to MESSAGE_LENGTH
-         */
-        coOdDomainAddrSet(
-                            index,              /**< index of object */
-                            subIndex,           /**< subindex of object */
-                            message,            /**< pointer to domain */
-                            sizeToTransfer  //2 * debug_log_size  /**< domain length */ /* '2x' we use 16 bit Words */
-                         );
-        sharedVars_cpu1toCpu2.debug_log_disable_flag = true;
+        /* set the CANopen OD object to point to the domain buffers */
+        log_domain_start(sdoNr, index, subIndex, sizeToTransfer);  /* '2x' we use 16 bit Words */
         return RET_OK;
     } else {
-        coOdDomainAddrSet(
-                            index,              /**< index of object */
-                            subIndex,           /**< subindex of object */
-                            message,            /**< pointer to domain */
-                            0 //2 * debug_log_size  /**< domain length */ /* '2x' we use 16 bit Words */
-                         );
+        log_domain_start(sdoNr, index, subIndex, 0);
         return RET_FLASH_EMPTY;
     }
 
@@ -260,6 +549,12 @@ void log_debug_log_reset(uint8_t resetType)
  */
 
 
+/**
+ * @brief   Prepares the CAN_LOG_READ domain
+ *
+ * The download starts at the position in CAN_LOG_READ_FROM and holds at most
+ * CAN_LOG_READ_MAX bytes, see log_can_download_start().
+ */
 uint8_t log_can_log_read(
         BOOL_T      execute,
         UNSIGNED8   sdoNr,
@@ -267,52 +562,23 @@ uint8_t log_can_log_read(
         UNSIGNED8   subIndex
     )
 {
-
+    uint32_t from = CAN_LOG_FROM_OLDEST;
+    uint32_t maxBytes = 0;
     uint32_t sizeToTransfer;
 
-
-    if( can_log_last_read_address > can_log_next_free_address) {
-        sizeToTransfer = 2 * (  CAN_LOG_ADDRESS_END - can_log_last_read_address);
-        sizeToTransfer = sizeToTransfer + 2 * ( can_log_next_free_address - CAN_LOG_ADDRESS_START);
-    } else {
-        sizeToTransfer = 2 * (can_log_next_free_address - can_log_last_read_address);
+    coOdGetObj_u32(I_CAN_LOG, S_CAN_LOG_READ_FROM, &from);
+    coOdGetObj_u32(I_CAN_LOG, S_CAN_LOG_READ_MAX, &maxBytes);
+    if( from == CAN_LOG_FROM_CURSOR ) {
+        coOdGetObj_u32(I_CAN_LOG, S_CAN_LOG_CURSOR, &from);
     }
-    Serial_printf(&cli_serial, "DOWNLOAD ALL CAN LOG\r\n");
-    sizeToTransfer = 2 * (CAN_LOG_ADDRESS_END - CAN_LOG_ADDRESS_START);
-    can_log_last_read_address = CAN_LOG_ADDRESS_START;
 
-    if(  sizeToTransfer > 0 ) {
+    sizeToTransfer = log_can_download_start(from, maxBytes);
+    Serial_debug(DEBUG_INFO, &cli_serial, "DOWNLOAD CAN LOG from position:[%lu] bytes:[%lu]\r\n", from, sizeToTransfer);
 
-        //TODO probably EXT_RAM_START_ADDRESS_CS2 -> debug_log_start_address
-        /* set the correct starting address of the external memory */
-        emif1_log_read = (EMIF1_Config){
-            can_log_last_read_address, //EXT_RAM_START_ADDRESS_CS2,
-            CPU_TYPE_ONE,
-            TRANSFER_SIZE,
-            (uint16_t*)message
-         };
-
-        /* set the CANopen OD object to point to the right domain, the variable message
-         * set the CANopen OD object size to MESSAGE_LENGTH
-         */
-        coOdDomainAddrSet(
-                            index,              /**< index of object */
-                            subIndex,           /**< subindex of object */
-                            message,            /**< pointer to domain */
-                            sizeToTransfer  //2 * debug_log_size  /**< domain length */ /* '2x' we use 16 bit Words */
-                         );
-        //sharedVars_cpu1toCpu2.debug_log_disable_flag = true;
-        return RET_OK;
-    } else {
-        coOdDomainAddrSet(
-                            index,              /**< index of object */
-                            subIndex,           /**< subindex of object */
-                            message,            /**< pointer to domain */
-                            0 //2 * debug_log_size  /**< domain length */ /* '2x' we use 16 bit Words */
-                         );
-        return RET_FLASH_EMPTY;
-    }
+    /* set the CANopen OD object to point to the domain buffers */
+    log_domain_start(sdoNr, index, subIndex, sizeToTransfer);
 
+    return (sizeToTransfer > 0) ? RET_OK : RET_FLASH_EMPTY;
 }
 
 void log_can_log_reset(void)
@@ -401,30 +667,470 @@ bool log_store_debug_log(unsigned char *pnt)
 
 
 
+static inline uint32_t log_can_sector_address(uint16_t sector)
+{
+    return CAN_LOG_ADDRESS_START + (uint32_t)sector * CAN_LOG_SECTOR_SIZE;
+}
+
+static inline uint16_t log_can_sector_of(uint32_t address)
+{
+    return (uint16_t)((address - CAN_LOG_ADDRESS_START) / CAN_LOG_SECTOR_SIZE);
+}
+
+static inline uint32_t log_can_block_address(uint16_t sector, uint16_t block)
+{
+    return log_can_sector_address(sector) + CAN_LOG_SECTOR_HEADER_WORDS + (uint32_t)block * CAN_LOG_BLOCK_WORDS;
+}
+
+/* block of an address after the sector header */
+static inline uint16_t log_can_block_of(uint32_t address)
+{
+    return (uint16_t)((((address - CAN_LOG_ADDRESS_START) % CAN_LOG_SECTOR_SIZE) - CAN_LOG_SECTOR_HEADER_WORDS) / CAN_LOG_BLOCK_WORDS);
+}
+
+/**
+ * @brief   Reads the header of a CAN log sector
+ * @return  sequence number of the sector, CAN_LOG_SEQUENCE_ERASED if the
+ *          sector is not in use, CAN_LOG_SEQUENCE_INVALID if it holds
+ *          something else than the CAN log
+ */
+static uint32_t log_can_sector_sequence(uint16_t sector, uint16_t *state)
+{
+    can_log_sector_header_t header;
+
+    ext_flash_read_buf(log_can_sector_address(sector), (uint16_t *)&header, CAN_LOG_SECTOR_HEADER_WORDS);
+    can_log_scan.headerReads++;
+
+    if( header.sequence == 0xFFFFFFFFu ) {
+        /* erased, or the header was not completely programmed */
+        return ((header.magic == 0xFFFFu) || (header.magic == CAN_LOG_MAGIC)) ? CAN_LOG_SEQUENCE_ERASED : CAN_LOG_SEQUENCE_INVALID;
+    }
+    if( (header.magic != CAN_LOG_MAGIC) || (header.sequence == CAN_LOG_SEQUENCE_ERASED) ) {
+        return CAN_LOG_SEQUENCE_INVALID;
+    }
+    if( state != NULL ) {
+        *state = header.state;
+    }
+    return header.sequence;
+}
+
+static bool log_can_block_written(uint16_t sector, uint16_t block)
+{
+    can_log_scan.recordProbes++;
+
+    return ext_flash_read_word(log_can_block_address(sector, block)) != 0xFFFFu;
+}
+
+/* address after the last record of a block */
+static uint32_t log_can_block_used_end(uint16_t sector, uint16_t block)
+{
+    uint32_t address = log_can_block_address(sector, block);
+    uint32_t end = address + CAN_LOG_BLOCK_WORDS;
+    uint16_t header;
+
+    while( address < end ) {
+        header = ext_flash_read_word(address);
+        can_log_scan.recordProbes++;
+        if( (CAN_LOG_RECORD_TYPE(header) != CAN_LOG_RECORD_KEYFRAME) &&
+            (CAN_LOG_RECORD_TYPE(header) != CAN_LOG_RECORD_DELTA) ) {
+            break;
+        }
+        address += 1 + CAN_LOG_RECORD_WORDS(header);
+    }
+    return (address < end) ? address : end;
+}
+
+/**
+ * @brief   Decodes the record stored at address
+ *
+ * Walks the block of the record from its keyframe.
+ *
+ * @return  false if no record starts at address
+ */
+static bool log_can_decode_record(uint32_t address, debug_log_t *record)
+{
+    static uint16_t delta[CAN_LOG_ENCODED_MAX_WORDS];
+    uint16_t sector = log_can_sector_of(address);
+    uint32_t current = log_can_block_address(sector, log_can_block_of(address));
+    uint32_t payload;
+    uint16_t header, words;
+
+    while( current <= address ) {
+        header = ext_flash_read_word(current);
+        words = CAN_LOG_RECORD_WORDS(header);
+        payload = current + 1;
+
+        if( CAN_LOG_RECORD_TYPE(header) == CAN_LOG_RECORD_KEYFRAME ) {
+            ext_flash_read_buf(payload, (uint16_t *)record, CAN_LOG_RECORD_RAW_WORDS);
+        } else if( (CAN_LOG_RECORD_TYPE(header) == CAN_LOG_RECORD_DELTA) &&
+                   (current != log_can_block_address(sector, log_can_block_of(address))) &&
+                   (words < CAN_LOG_ENCODED_MAX_WORDS) ) {
+            ext_flash_read_buf(payload, delta, words);
+            if( can_log_decode_delta(delta, words, record) == false ) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+
+        if( current == address ) {
+            return true;
+        }
+        current = payload + words;
+    }
+    return false;
+}
+
+static inline uint32_t log_can_next_block(uint16_t sector, uint16_t block)
+{
+    if( ++block >= CAN_LOG_BLOCKS_PER_SECTOR ) {
+        block = 0;
+        sector = (sector + 1) % CAN_LOG_SECTORS;
+    }
+    return log_can_block_address(sector, block);
+}
+
+/* moves an address in a sector header or after the last block to the start of a block */
+static uint32_t log_can_align_address(uint32_t address)
+{
+    uint16_t sector = log_can_sector_of(address);
+
+    if( address - log_can_sector_address(sector) < CAN_LOG_SECTOR_HEADER_WORDS ) {
+        return log_can_block_address(sector, 0);
+    }
+    if( log_can_block_of(address) >= CAN_LOG_BLOCKS_PER_SECTOR ) {
+        return log_can_next_block(sector, CAN_LOG_BLOCKS_PER_SECTOR - 1);
+    }
+    return address;
+}
+
+/**
+ * @brief   Finds the first record at or after address
+ *
+ * Skips the unused ends of blocks and the sector headers.
+ *
+ * @return  end, aligned to a block, if there is no record before it
+ */
+static uint32_t log_can_next_record(uint32_t address, uint32_t end)
+{
+    uint16_t header;
+    uint16_t blocks;
+
+    end = log_can_align_address(end);
+    address = log_can_align_address(address);
+
+    for( blocks = 0; (address != end) && (blocks <= CAN_LOG_SECTORS * CAN_LOG_BLOCKS_PER_SECTOR); blocks++ ) {
+        header = ext_flash_read_word(address);
+        if( (CAN_LOG_RECORD_TYPE(header) == CAN_LOG_RECORD_KEYFRAME) ||
+            (CAN_LOG_RECORD_TYPE(header) == CAN_LOG_RECORD_DELTA) ) {
+            return address;
+        }
+        address = log_can_next_block(log_can_sector_of(address), log_can_block_of(address));
+    }
+    return end;
+}
+
+/* log position of an address in a sector in use */
+static uint32_t log_can_position_of(uint32_t address)
+{
+    uint16_t sector = log_can_sector_of(address);
+
+    return log_can_sector_sequence(sector, NULL) * CAN_LOG_SECTOR_SIZE + (address - log_can_sector_address(sector));
+}
+
+/**
+ * @brief   Finds the first record at or after a log position
+ *
+ * A position in a sector that has been overwritten since gives the oldest
+ * record.
+ *
+ * @return  address of the record, can_log_written_end aligned to a block if
+ *          there is none
+ */
+static uint32_t log_can_find_position(uint32_t position)
+{
+    uint32_t sequence = position / CAN_LOG_SECTOR_SIZE;
+    uint32_t address, current, end;
+    uint16_t sector, header;
+
+    if( position >= can_log_written_position ) {
+        return log_can_align_address(can_log_written_end);
+    }
+
+    for( sector = 0; sector < CAN_LOG_SECTORS; sector++ ) {
+        if( log_can_sector_sequence(sector, NULL) == sequence ) {
+            break;
+        }
+    }
+    if( sector == CAN_LOG_SECTORS ) {
+        return log_can_next_record(can_log_start_address, can_log_written_end);
+    }
+
+    address = log_can_align_address(log_can_sector_address(sector) + position % CAN_LOG_SECTOR_SIZE);
+    if( log_can_sector_of(address) == sector ) {
+        /* records do not start at fixed addresses, walk the block up to the position */
+        current = log_can_block_address(sector, log_can_block_of(address));
+        end = current + CAN_LOG_BLOCK_WORDS;
+        while( current < address ) {
+            header = ext_flash_read_word(current);
+            if( (CAN_LOG_RECORD_TYPE(header) != CAN_LOG_RECORD_KEYFRAME) &&
+                (CAN_LOG_RECORD_TYPE(header) != CAN_LOG_RECORD_DELTA) ) {
+                current = end;
+                break;
+            }
+            current += 1 + CAN_LOG_RECORD_WORDS(header);
+        }
+        address = (current < end) ? current : end;
+    }
+    return log_can_next_record(address, can_log_written_end);
+}
+
+/**
+ * @brief   Prepares the CAN_LOG_READ domain
+ *
+ * The download holds the records from the position from up to the last
+ * programmed record, or as many whole records as fit in maxBytes.
+ *
+ * @param   from        log position, CAN_LOG_FROM_OLDEST for the whole log
+ * @param   maxBytes    0 for no limit
+ * @return  size of the domain in bytes
+ */
+static uint32_t log_can_download_start(uint32_t from, uint32_t maxBytes)
+{
+    uint32_t setupStart = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    uint32_t end = log_can_align_address(can_log_written_end);
+    uint32_t limit = (maxBytes == 0) ? 0xFFFFFFFFu : maxBytes / 2;
+    uint32_t address, total, words;
+    uint16_t header;
+
+    if( from == CAN_LOG_FROM_OLDEST ) {
+        address = log_can_next_record(can_log_start_address, end);
+    } else {
+        address = log_can_find_position(from);
+    }
+
+    can_log_download.address = address;
+    can_log_download.offset = 0;
+    can_log_download.first = true;
+    can_log_download.lost = false;
+
+    /* the first record goes out as a keyframe, the others as stored */
+    total = 0;
+    while( address != end ) {
+        header = ext_flash_read_word(address);
+        words = (total == 0) ? CAN_LOG_KEYFRAME_WORDS : 1 + CAN_LOG_RECORD_WORDS(header);
+        if( total + words > limit ) {
+            break;
+        }
+        total += words;
+        address = log_can_next_record(address + 1 + CAN_LOG_RECORD_WORDS(header), end);
+    }
+
+    can_log_download.end = address;
+    can_log_download.remaining = total;
+    can_log_download.cursor = (address == end) ? can_log_written_position : log_can_position_of(address);
+
+    if( total > 0 ) {
+        can_log_download.keyframe[0] = CAN_LOG_RECORD_HEADER(CAN_LOG_RECORD_KEYFRAME, CAN_LOG_RECORD_RAW_WORDS);
+        if( log_can_decode_record(can_log_download.address, (debug_log_t *)&can_log_download.keyframe[1]) == false ) {
+            can_log_download.lost = true;
+        }
+    }
+
+    can_log_download_stats.downloads++;
+    can_log_download_stats.setupCycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - setupStart;
+
+    return 2 * total;
+}
+
+/**
+ * @brief   Copies the next size words of the CAN_LOG_READ domain to buf
+ *
+ * Records erased by the log wrapping around during the download are sent
+ * as erased flash, a decoder stops at the first 0xFFFF record header.
+ * The chunk may be read ahead of the SDO transfer, CAN_LOG_CURSOR is only
+ * committed by log_read_domain_finished().
+ */
+static void log_can_download_fill(uint16_t *buf, uint32_t size)
+{
+    uint16_t header, words, chunk;
+
+    if( size > can_log_download.remaining ) {
+        size = can_log_download.remaining;
+    }
+    can_log_download.remaining -= size;
+    can_log_download_stats.bytes += 2 * size;
+
+    while( size > 0 ) {
+        if( can_log_download.address == can_log_download.end ) {
+            can_log_download.lost = true;
+        }
+        if( can_log_download.lost ) {
+            while( size > 0 ) {
+                *buf++ = 0xFFFFu;
+                size--;
+            }
+            break;
+        }
+
+        header = ext_flash_read_word(can_log_download.address);
+        words = can_log_download.first ? CAN_LOG_KEYFRAME_WORDS : 1 + CAN_LOG_RECORD_WORDS(header);
+        chunk = ((uint32_t)(words - can_log_download.offset) < size) ? words - can_log_download.offset : (uint16_t)size;
+
+        if( can_log_download.first ) {
+            memcpy(buf, &can_log_download.keyframe[can_log_download.offset], chunk * sizeof(uint16_t));
+        } else {
+            ext_flash_read_buf(can_log_download.address + can_log_download.offset, buf, chunk);
+        }
+        buf += chunk;
+        size -= chunk;
+        can_log_download.offset += chunk;
+
+        if( can_log_download.offset == words ) {
+            can_log_download.offset = 0;
+            can_log_download.first = false;
+            can_log_download.address = log_can_next_record(can_log_download.address + 1 + CAN_LOG_RECORD_WORDS(header),
+                                                           can_log_download.end);
+        }
+    }
+}
+
+/* sector header operations are queued behind the other flash users,
+ * the buffers must stay valid until the operation is done */
+static can_log_sector_header_t can_log_open_header;
+static const uint16_t can_log_sector_full = CAN_LOG_SECTOR_FULL;
+
+static void log_can_flash_op_done(ext_flash_op_status_t status, void *context)
+{
+    (void)context;
+
+    if( status != EXT_FLASH_OP_OK ) {
+        can_log_stats.flashErrors++;
+    }
+}
+
+/* takes an erased sector into use as the new head sector */
+static void log_can_open_sector(uint16_t sector)
+{
+    can_log_open_header.magic = CAN_LOG_MAGIC;
+    can_log_open_header.state = CAN_LOG_SECTOR_OPEN;
+    can_log_open_header.sequence = ++can_log_sequence;
+
+    if( !ext_flash_queue_program(log_can_sector_address(sector), (const uint16_t *)&can_log_open_header,
+                                 CAN_LOG_SECTOR_HEADER_WORDS, log_can_flash_op_done, NULL) ) {
+        can_log_stats.flashErrors++;
+    }
+    can_log_head_sector_open = true;
+}
+
+/* marks the head sector full, the next record goes to the next sector */
+static void log_can_close_sector(uint16_t sector)
+{
+    if( !ext_flash_queue_program(log_can_sector_address(sector) + offsetof(can_log_sector_header_t, state) / sizeof(uint16_t),
+                                 &can_log_sector_full, 1, log_can_flash_op_done, NULL) ) {
+        can_log_stats.flashErrors++;
+    }
+    can_log_head_sector_open = false;
+}
+
+/**
+ * @brief   Finds the head of the CAN log from the sector headers
+ *
+ * Sets can_log_sequence, can_log_head_sector_open and can_log_start_address.
+ *
+ * @return  false if the region holds something else than the CAN log
+ */
 bool can_log_search_free_debug_address( uint32_t *nextFreeAddress ){
-    debug_log_t current_saved_log;
-    debug_log_t next_saved_log;
-
-    uint32_t addr = CAN_LOG_ADDRESS_START;
-    uint32_t nextAddr;
-    bool freeAdrressFound = false;
-    while( addr < CAN_LOG_ADDRESS_END - sizeof(debug_log_t) ) {
-        ext_flash_read_buf(addr, (uint16_t *)&current_saved_log, sizeof(debug_log_t) );
-        //Serial_printf(&cli_serial,"%s--->addr[%08p] current_saved_log.MagicNumber[%08p]\r\n",__FUNCTION__, addr, current_saved_log.MagicNumber);
-        if( current_saved_log.MagicNumber != MAGIC_NUMBER) {
-            if( current_saved_log.MagicNumber == 0xFFFFFFFF) {
-                nextAddr = addr + sizeof(debug_log_t);
-                ext_flash_read_buf(nextAddr, (uint16_t *)&next_saved_log, sizeof(debug_log_t) );
-                if( next_saved_log.MagicNumber == 0xFFFFFFFF ) {
-                    freeAdrressFound = true;
-                    *nextFreeAddress =  addr;
-                    break;
+    uint32_t scanStart = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    uint32_t first, sequence;
+    uint16_t lo, hi, mid, head, oldest, state, sector;
+
+    can_log_scan.headerReads = 0;
+    can_log_scan.recordProbes = 0;
+    /* the last record is not known, the next one starts a new block */
+    can_log_block_open = false;
+
+    first = log_can_sector_sequence(0, NULL);
+    if( first == CAN_LOG_SEQUENCE_INVALID ) {
+        return false;
+    }
+
+    if( first != CAN_LOG_SEQUENCE_ERASED ) {
+        /* the last sector with a sequence number not below the first sector's is the head */
+        lo = 0;
+        hi = CAN_LOG_SECTORS;
+        while( hi - lo > 1 ) {
+            mid = (lo + hi) / 2;
+            sequence = log_can_sector_sequence(mid, NULL);
+            if( sequence == CAN_LOG_SEQUENCE_INVALID ) {
+                return false;
+            }
+            if( sequence >= first ) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        head = lo;
+    } else {
+        /* empty, or the first sector was being erased when the log wrapped,
+         * rare enough to look at every header */
+        head = 0;
+        first = CAN_LOG_SEQUENCE_ERASED;
+        for( sector = 1; sector < CAN_LOG_SECTORS; sector++ ) {
+            sequence = log_can_sector_sequence(sector, NULL);
+            if( sequence == CAN_LOG_SEQUENCE_INVALID ) {
+                return false;
+            }
+            if( sequence > first ) {
+                first = sequence;
+                head = sector;
+            }
+        }
+    }
+
+    sequence = log_can_sector_sequence(head, &state);
+    can_log_sequence = sequence;
+
+    if( sequence == CAN_LOG_SEQUENCE_ERASED ) {
+        /* empty log */
+        can_log_head_sector_open = false;
+        *nextFreeAddress = log_can_sector_address(0);
+        can_log_start_address = log_can_block_address(0, 0);
+    } else {
+        if( state == CAN_LOG_SECTOR_FULL ) {
+            can_log_head_sector_open = false;
+            *nextFreeAddress = log_can_sector_address((head + 1) % CAN_LOG_SECTORS);
+        } else {
+            /* blocks are written in order, the log ends in the last written one */
+            lo = 0;
+            hi = CAN_LOG_BLOCKS_PER_SECTOR;
+            while( lo < hi ) {
+                mid = (lo + hi) / 2;
+                if( log_can_block_written(head, mid) ) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
                 }
             }
+            can_log_head_sector_open = true;
+            *nextFreeAddress = (lo == 0) ? log_can_block_address(head, 0) : log_can_block_used_end(head, lo - 1);
         }
-        addr = addr + sizeof(debug_log_t);
+
+        /* the oldest sector follows the head, unless the log has not wrapped yet */
+        oldest = 0;
+        for( sector = 1; sector <= 2; sector++ ) {
+            mid = (head + sector) % CAN_LOG_SECTORS;
+            if( (mid != head) && (log_can_sector_sequence(mid, NULL) != CAN_LOG_SEQUENCE_ERASED) ) {
+                oldest = mid;
+                break;
+            }
+        }
+        can_log_start_address = log_can_block_address(oldest, 0);
     }
-    return freeAdrressFound;
+
+    can_log_scan.cycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - scanStart;
+    return true;
 }
 
 void log_can_init(void)
@@ -434,69 +1140,111 @@ void log_can_init(void)
 
     freeAdrressFound = can_log_search_free_debug_address( &can_log_next_free_address );
     if( freeAdrressFound == false ) {
-        Serial_debug(DEBUG_INFO, &cli_serial, "CAN LOG MEMORY FULL. CORESPONDING FLASH MEMORY SHALL BE ERASED\r\n" );
+        Serial_debug(DEBUG_INFO, &cli_serial, "CAN LOG SECTOR HEADERS NOT FOUND. CORESPONDING FLASH MEMORY SHALL BE ERASED\r\n" );
         can_log_next_free_address = CAN_LOG_ADDRESS_START;
         can_log_start_address = CAN_LOG_ADDRESS_START;
         can_log_last_read_address = CAN_LOG_ADDRESS_START;
         log_can_log_reset();
         can_log_possible = false;
+        can_log_written_position = 0;
     } else {
-        can_log_start_address = can_log_next_free_address;
         can_log_last_read_address = can_log_next_free_address;
+        if( can_log_head_sector_open ) {
+            can_log_written_position = can_log_sequence * CAN_LOG_SECTOR_SIZE +
+                    (can_log_next_free_address - log_can_sector_address(log_can_sector_of(can_log_next_free_address)));
+        } else {
+            /* the next record starts the next sector */
+            can_log_written_position = (can_log_sequence + 1) * CAN_LOG_SECTOR_SIZE;
+        }
     }
+    can_log_written_end = can_log_next_free_address;
     //Serial_printf(&cli_serial, "%s can_log_possible[%d] can_log_next_free_address[%08p], can_log_last_read_address[%08p], can_log_start_address[%08p]\r\n",__FUNCTION__,
     //              can_log_possible, can_log_next_free_address, can_log_last_read_address, can_log_start_address);
 }
 
-bool calc_next_free_addr_and_verify_erase_sector(uint32_t can_log_current_write_address, uint16_t log_size_in_words ){
+/**
+ * @brief   Encodes a record and reserves room for it at the head of the CAN log
+ *
+ * The record is encoded to can_log_encoded, as a delta if it fits in the
+ * open block, otherwise as the keyframe of the next block. A block that
+ * does not fit in the head sector goes to the start of the next sector,
+ * which then has to be erased and opened first. Fills in record->address.
+ *
+ * @return  true if the sector of the record must be erased and opened
+ */
+bool calc_next_free_addr_and_verify_erase_sector(uint32_t *can_log_write_address, debug_log_t *record ){
+    uint32_t encodeStart = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    uint32_t cycles;
+    uint16_t sector = log_can_sector_of(can_log_next_free_address);
+    uint16_t block = 0;
+    uint16_t next_sector;
+    bool needToEraseNextSector = false;
+    bool reserved = false;
 
-    const ext_flash_desc_t *current_sector_desc;
-    const ext_flash_desc_t *next_sector_desc;
-    const ext_flash_desc_t *last_read_addr_sector_desc;
-    ext_flash_desc_t update_last_read_addr_sector_desc;
-    uint16_t update_last_read_addr_sector = 0;
+    if( can_log_head_sector_open && can_log_block_open ) {
+        record->address = can_log_next_free_address;
+        can_log_encoded_words = can_log_encode_delta(record, &can_log_previous, can_log_encoded);
+        if( can_log_encoded_words > CAN_LOG_KEYFRAME_WORDS ) {
+            can_log_encoded_words = can_log_encode_keyframe(record, can_log_encoded);
+        }
+        reserved = (can_log_next_free_address + can_log_encoded_words <= can_log_block_end);
+        block = log_can_block_of(can_log_block_end - 1) + 1;
+    } else if( can_log_head_sector_open ) {
+        block = log_can_block_of(can_log_next_free_address);
+        if( can_log_next_free_address != log_can_block_address(sector, block) ) {
+            block++;
+        }
+    }
 
-    bool needToEraseNextSector = false;
+    if( !reserved ) {
+        if( can_log_head_sector_open && (block >= CAN_LOG_BLOCKS_PER_SECTOR) ) {
+            log_can_close_sector(sector);
+            sector = (sector + 1) % CAN_LOG_SECTORS;
+        }
 
-    // Calculate next free address by adding size of log message.
-    can_log_next_free_address += log_size_in_words;
+        if( !can_log_head_sector_open ) {
+            needToEraseNextSector = true;
+            block = 0;
 
-    // Check if next free address wraps around in memory.
-    if (can_log_next_free_address > CAN_LOG_ADDRESS_END) {
-        // Address wraps around.
-        can_log_next_free_address = CAN_LOG_ADDRESS_START;
+            // The sector is erased, move the read and start addresses to the next sector.
+            next_sector = (sector + 1) % CAN_LOG_SECTORS;
+            if( log_can_sector_of(can_log_last_read_address) == sector ) {
+                can_log_last_read_address = log_can_block_address(next_sector, 0);
+            }
+            if( log_can_sector_of(can_log_start_address) == sector ) {
+                can_log_start_address = log_can_block_address(next_sector, 0);
+            }
+            if( (can_log_download.remaining > 0) && (log_can_sector_of(can_log_download.address) == sector) ) {
+                can_log_download.lost = true;
+            }
+        }
 
-        needToEraseNextSector = true;
+        can_log_next_free_address = log_can_block_address(sector, block);
+        can_log_block_end = can_log_next_free_address + CAN_LOG_BLOCK_WORDS;
+        can_log_block_open = true;
 
+        record->address = can_log_next_free_address;
+        can_log_encoded_words = can_log_encode_keyframe(record, can_log_encoded);
     }
-    // Get pointer to info on current sector.
-    current_sector_desc = ext_flash_sector_from_address(can_log_current_write_address);
-    // Get pointer to info on next sector.
-    next_sector_desc = ext_flash_sector_from_address(can_log_next_free_address);
-
-    //Serial_printf(&cli_serial, "current_sector_desc->sector[%d]addr[%08p] == next_sector_desc->sector[%d]addr[%08p]\r\n", current_sector_desc->sector,can_log_current_write_address,
-    //              next_sector_desc->sector, can_log_next_free_address);
-    if (current_sector_desc->sector != next_sector_desc->sector) {
-        // Return true to inform state machine to erase next sector.
-        needToEraseNextSector = true;
 
+    if( CAN_LOG_RECORD_TYPE(can_log_encoded[0]) == CAN_LOG_RECORD_KEYFRAME ) {
+        can_log_codec.keyframes++;
+    } else {
+        can_log_codec.deltas++;
     }
+    can_log_codec.rawWords += CAN_LOG_RECORD_RAW_WORDS;
+    can_log_codec.storedWords += can_log_encoded_words;
+    memcpy(&can_log_previous, record, sizeof(debug_log_t));
 
-    if( needToEraseNextSector == true ) {
-        //Update last_read_address to next sector initial address if it's current sector shall be erased
-        last_read_addr_sector_desc = ext_flash_sector_from_address(can_log_last_read_address);
-        if( last_read_addr_sector_desc->sector == next_sector_desc->sector ) {
-            update_last_read_addr_sector = (uint16_t)last_read_addr_sector_desc->sector + 1;
-            if(update_last_read_addr_sector > EXT_FLASH_SA_LAST) {
-                can_log_last_read_address = CAN_LOG_ADDRESS_START;
-            } else {
+    *can_log_write_address = can_log_next_free_address;
+    can_log_next_free_address += can_log_encoded_words;
 
-                update_last_read_addr_sector_desc.sector = (ext_flash_sector_t)update_last_read_addr_sector;
-                look_up_start_address_of_sector( &update_last_read_addr_sector_desc );
-                can_log_last_read_address = update_last_read_addr_sector_desc.addr;
-            }
-        }
+    cycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - encodeStart;
+    can_log_codec.encodeCycles += cycles;
+    if( cycles > can_log_codec.maxEncodeCycles ) {
+        can_log_codec.maxEncodeCycles = cycles;
     }
+
     return needToEraseNextSector;
 }
 
@@ -510,17 +1258,17 @@ bool calc_next_free_addr_and_verify_erase_sector(uint32_t can_log_current_write_
 void log_can_store_non_blocking_start(uint32_t canLogFlashDestAddress, unsigned char *dataBuffer, uint16_t size_in_words ){
     log_store_destination_address = canLogFlashDestAddress;
     log_store_size_in_words = size_in_words;
-    log_store_data_buffer_pnt = dataBuffer;
+    log_store_data_buffer_pnt = (uint16_t *)dataBuffer;
     log_store_count_data = 0;
 }
 
 void log_can_read_non_blocking_start(uint32_t canLogFlashSourceAddress, unsigned char *dataBuffer, uint16_t size_in_words ){
     log_store_source_address = canLogFlashSourceAddress;
     log_store_size_in_words = size_in_words;
-    log_store_data_buffer_pnt = dataBuffer;
+    log_store_data_buffer_pnt = (uint16_t *)dataBuffer;
     log_store_count_data = 0;
 
-    memset(dataBuffer, size_in_words, 0 );
+    memset(dataBuffer, 0, size_in_words * sizeof(uint16_t));
 
 
 }
@@ -540,18 +1288,122 @@ bool log_can_read_non_blocking_done()
 }
 
 
+/* restarts the flash programming time budget, once per super loop pass */
+static inline void log_can_store_budget_start(void)
+{
+    can_log_store_budget_start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+}
+
+static inline bool log_can_store_budget_left(void)
+{
+    return ((uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - can_log_store_budget_start) <
+            (uint32_t)CAN_LOG_DRAIN_BUDGET_US * CAN_LOG_CYCLES_PER_US;
+}
+
+/**
+ * @brief   Continues a store started by log_can_store_non_blocking_start()
+ *
+ * Programs whole flash pages until the data is stored or the time budget
+ * of this super loop pass, see log_can_store_budget_start(), is used up.
+ *
+ * @return  true when all data is stored
+ */
 bool log_can_store_non_blocking_done()
 {
-    if( log_store_count_data < log_store_size_in_words )
+    size_t written;
+
+    while( log_store_count_data < log_store_size_in_words )
     {
+        if( !ext_flash_idle() ) {
+            /* a queued flash operation is running */
+            return false;
+        }
 
-        ext_flash_write_word(log_store_destination_address, log_store_data_buffer_pnt[log_store_count_data]);
-        log_store_destination_address++;
-        log_store_count_data++;
-    } else {
-        return true;
+        written = ext_flash_write_page(log_store_destination_address,
+                                       &log_store_data_buffer_pnt[log_store_count_data],
+                                       log_store_size_in_words - log_store_count_data);
+        if( written == 0 ) {
+            /* give the record up, the next one starts a new block with a
+             * keyframe, a delta must not refer to this one */
+            can_log_stats.flashErrors++;
+            can_log_block_open = false;
+            log_store_count_data = log_store_size_in_words;
+            break;
+        }
+        log_store_destination_address += written;
+        log_store_count_data += written;
+
+        if( !log_can_store_budget_left() ) {
+            break;
+        }
     }
-    return false;
+    return log_store_count_data >= log_store_size_in_words;
+}
+
+static inline uint16_t log_can_stage_backlog(void)
+{
+    return (can_log_stage_head - can_log_stage_tail) & (2 * CAN_LOG_STAGE_RECORDS - 1);
+}
+
+/**
+ * @brief   Moves a new record published by CPU2, if any, to the stage
+ */
+static void log_can_stage_new_record(void)
+{
+    uint16_t backlog;
+
+    if( verify_new_can_data_to_log() == false ) {
+        return;
+    }
+
+    backlog = log_can_stage_backlog();
+    if( backlog >= CAN_LOG_STAGE_RECORDS ) {
+        can_log_stats.dropped++;
+        return;
+    }
+
+    memcpy(&can_log_stage[can_log_stage_head & (CAN_LOG_STAGE_RECORDS - 1)], (const void *)&debug_log_copy, sizeof(debug_log_t));
+    can_log_stage_head = (can_log_stage_head + 1) & (2 * CAN_LOG_STAGE_RECORDS - 1);
+    can_log_stats.staged++;
+
+    if( backlog + 1 > can_log_stats.maxBacklog ) {
+        can_log_stats.maxBacklog = backlog + 1;
+    }
+}
+
+static inline debug_log_t *log_can_stage_oldest(void)
+{
+    return &can_log_stage[can_log_stage_tail & (CAN_LOG_STAGE_RECORDS - 1)];
+}
+
+static inline void log_can_stage_release(void)
+{
+    can_log_stage_tail = (can_log_stage_tail + 1) & (2 * CAN_LOG_STAGE_RECORDS - 1);
+    can_log_stats.written++;
+}
+
+void log_can_print_stats(void)
+{
+    Serial_printf(&cli_serial, " staged: %lu, written: %lu, dropped: %lu, flash errors: %lu, programming passes: %lu\r\n",
+                  can_log_stats.staged, can_log_stats.written, can_log_stats.dropped, can_log_stats.flashErrors,
+                  can_log_stats.passes);
+    Serial_printf(&cli_serial, " backlog: %u/%u records, max: %u, next free address: 0x%08lx\r\n",
+                  log_can_stage_backlog(), CAN_LOG_STAGE_RECORDS, can_log_stats.maxBacklog, can_log_next_free_address);
+    Serial_printf(&cli_serial, " head sector sequence: %lu, %s, %u sectors of %u blocks\r\n",
+                  can_log_sequence, can_log_head_sector_open ? "open" : "closed",
+                  CAN_LOG_SECTORS, CAN_LOG_BLOCKS_PER_SECTOR);
+    Serial_printf(&cli_serial, " keyframes: %lu, deltas: %lu, words raw: %lu, stored: %lu, ratio: %lu%%\r\n",
+                  can_log_codec.keyframes, can_log_codec.deltas, can_log_codec.rawWords, can_log_codec.storedWords,
+                  (can_log_codec.storedWords > 0) ? (100 * can_log_codec.rawWords / can_log_codec.storedWords) : 0);
+    Serial_printf(&cli_serial, " encode: %lu us total, max %lu cycles\r\n",
+                  can_log_codec.encodeCycles / CAN_LOG_CYCLES_PER_US, can_log_codec.maxEncodeCycles);
+    Serial_printf(&cli_serial, " boot scan: %u header reads, %u record probes, %lu us\r\n",
+                  can_log_scan.headerReads, can_log_scan.recordProbes, can_log_scan.cycles / CAN_LOG_CYCLES_PER_US);
+    Serial_printf(&cli_serial, " downloads: %lu, completed: %lu, aborted: %lu, bytes sent: %lu, last setup: %lu us, written up to position: %lu\r\n",
+                  can_log_download_stats.downloads, can_log_download_stats.completed, can_log_download_stats.aborted,
+                  can_log_download_stats.bytes,
+                  can_log_download_stats.setupCycles / CAN_LOG_CYCLES_PER_US, can_log_written_position);
+    log_domain_print_stats();
 }
 
 
@@ -564,14 +1416,18 @@ void log_can_state_machine(void) {
     static uint32_t can_log_write_address;
     static debug_log_t readBack;
 
+    /* stage new records in every state, writing them may have to wait */
+    log_can_stage_new_record();
+    log_can_store_budget_start();
+
     switch( canLogState.State_Current ) {
 
         case Logging:
-            if( verify_new_can_data_to_log() == true) {
+            /* the records and the sector headers follow the queued flash
+             * operations, so the queue always has room for the headers */
+            if( (log_can_stage_backlog() > 0) && ext_flash_idle() ) {
                 timeStart = timer_get_ticks();
-                can_log_write_address = can_log_next_free_address;
-                sharedVars_cpu1toCpu2.debug_log_disable_flag = true;
-                needToEraseNextSector = calc_next_free_addr_and_verify_erase_sector( can_log_write_address, sizeof(debug_log_t) );
+                needToEraseNextSector = calc_next_free_addr_and_verify_erase_sector( &can_log_write_address, log_can_stage_oldest() );
                 if( needToEraseNextSector == true) {
                     canLogState.State_Next = EraseNextSector;
                 } else {
@@ -581,54 +1437,69 @@ void log_can_state_machine(void) {
             break;
 
         case EraseNextSector:
-            Serial_debug(DEBUG_INFO, &cli_serial, "Erasing CAN LOG next sector\r\n");
-            start_ext_flash_erase_sector(can_log_next_free_address);
-            canLogState.State_Next = WaitEraseSectorDone;
+            if( ext_flash_queue_erase_sector(can_log_write_address, log_can_flash_op_done, NULL) == true ) {
+                Serial_debug(DEBUG_INFO, &cli_serial, "Erasing CAN LOG next sector\r\n");
+                canLogState.State_Next = WaitEraseSectorDone;
+            }
             break;
 
         case WaitEraseSectorDone:
-            if( verify_ext_flash_erase_sector_done() == true ){
+            if( ext_flash_idle() == true ){
+                log_can_open_sector(log_can_sector_of(can_log_write_address));
                 canLogState.State_Next = WriteToFlash;
             }
             break;
 
         case WriteToFlash:
-            log_can_store_non_blocking_start(can_log_write_address, (unsigned char *)&debug_log_copy, sizeof(debug_log_t));
+            log_can_store_non_blocking_start(can_log_write_address, (unsigned char *)can_log_encoded, can_log_encoded_words);
             canLogState.State_Next = WaitWriteToFlashDone;
-            break;
+            /* no break, start programming in this pass */
 
         case WaitWriteToFlashDone:
-            if( log_can_store_non_blocking_done() == true) {
+            can_log_stats.passes++;
+            while( log_can_store_non_blocking_done() == true) {
+                log_can_stage_release();
+                can_log_written_end = can_log_write_address + can_log_encoded_words;
+                can_log_written_position = can_log_sequence * CAN_LOG_SECTOR_SIZE +
+                        (can_log_written_end - log_can_sector_address(log_can_sector_of(can_log_write_address)));
                 debug_log_last_writen_address = can_log_write_address;
-                sharedVars_cpu1toCpu2.debug_log_disable_flag = false;
                 Serial_debug(DEBUG_INFO, &cli_serial, "Time to store log in flash:[%lu]\r\n", timer_get_ticks() - timeStart);
                 if( debug_level == DEBUG_INFO) {
                     //log_debug_read_from_flash();
                     canLogState.State_Next = ReadBackLogFromFlash;
-                } else {
-                    canLogState.State_Next = Logging;
+                    break;
                 }
+                canLogState.State_Next = Logging;
+
+                /* continue with the next staged record while the budget lasts,
+                 * a record needing a sector erase waits for the next pass */
+                if( (log_can_stage_backlog() == 0) || !log_can_store_budget_left() ) {
+                    break;
+                }
+                needToEraseNextSector = calc_next_free_addr_and_verify_erase_sector( &can_log_write_address, log_can_stage_oldest() );
+                if( needToEraseNextSector == true ) {
+                    canLogState.State_Next = EraseNextSector;
+                    break;
+                }
+                log_can_store_non_blocking_start(can_log_write_address, (unsigned char *)can_log_encoded, can_log_encoded_words);
+                canLogState.State_Next = WaitWriteToFlashDone;
             }
             break;
 
         case ReadBackLogFromFlash:
-            log_can_read_non_blocking_start(can_log_write_address, (unsigned char *)&readBack, sizeof(debug_log_t));
-            canLogState.State_Next = WaitReadLogFromFlashDone;
-            break;
-
-        case WaitReadLogFromFlashDone:
-            if( log_can_read_non_blocking_done() == true) {
+            if( log_can_decode_record(can_log_write_address, &readBack) == true ) {
                 print_log_can_to_serial(&readBack);
-                Serial_debug(DEBUG_INFO, &cli_serial, "Time to store and read log from flash:[%lu]\r\n", timer_get_ticks() - timeStart);
-                canLogState.State_Next = Logging;
+            } else {
+                Serial_debug(DEBUG_INFO, &cli_serial, "No CAN log record at:[0x%08lx]\r\n", can_log_write_address);
             }
+            Serial_debug(DEBUG_INFO, &cli_serial, "Time to store and read log from flash:[%lu]\r\n", timer_get_ticks() - timeStart);
+            canLogState.State_Next = Logging;
             break;
 
         case StartEraseAllCanLogFlash:
             // Call command do erase can log ext flash
             Serial_debug(DEBUG_INFO, &cli_serial, "CAN LOG Flash erase start\r\n");
             timeStart = timer_get_ticks();
-            sharedVars_cpu1toCpu2.debug_log_disable_flag = true;
 
             flashDescStart = ext_flash_sector_from_address( CAN_LOG_ADDRESS_START );
             Serial_debug(DEBUG_INFO, &cli_serial, "CAN_LOG_ADDRESS_START sector:[0x%02X] address:[0x%08p] flash_offset:[0x%08p]\r\n",
@@ -649,7 +1520,10 @@ void log_can_state_machine(void) {
             Serial_debug(DEBUG_INFO, &cli_serial, "ERASING CAN_LOG_ADDRESS sector:[0x%02X] address:[0x%08p] flash_offset:[0x%08p]\r\n",
                          flashDescToErase.sector, flashDescToErase.addr, (flashDescToErase.addr - EXT_FLASH_START_ADDRESS_CS3) );
 
-            ext_flash_erase_sector_by_descriptor( &flashDescToErase );
+            if( ext_flash_queue_erase_sector(flashDescToErase.addr, log_can_flash_op_done, NULL) == false ) {
+                /* queue full, try again on the next pass */
+                break;
+            }
 
             flashDescToErase.sector++;
 
@@ -661,11 +1535,10 @@ void log_can_state_machine(void) {
             break;
 
         case WaitingEraseDone:
-            if( ext_flash_ready() ) {
+            if( ext_flash_idle() ) {
                 if( flashDescToErase.sector > flashDescEnd->sector ) {
                     log_can_init();
                     Serial_debug(DEBUG_INFO, &cli_serial, "External Flash erase stop. Time:[%lu]\r\n", timer_get_ticks() - timeStart);
-                    sharedVars_cpu1toCpu2.debug_log_disable_flag = false;
                     canLogState.State_Next = Logging;
                 } else {
                     canLogState.State_Next = EraseCANLogFlashSector;
@@ -678,18 +1551,17 @@ void log_can_state_machine(void) {
             // Call command do erase entire flash_chip_erase
             Serial_debug(DEBUG_INFO, &cli_serial, "Entire Flash erase start\r\n");
             timeStart = timer_get_ticks();
-            sharedVars_cpu1toCpu2.debug_log_disable_flag = true;
-            ext_command_flash_chip_erase();
-            AppVarsInformEntireFlashResetInitiated();
-            canLogState.State_Next = WaitingEntireEraseDone;
+            if( ext_flash_queue_chip_erase(NULL, NULL) == true ) {
+                AppVarsInformEntireFlashResetInitiated();
+                canLogState.State_Next = WaitingEntireEraseDone;
+            }
 
             break;
 
         case WaitingEntireEraseDone:
-            if( ext_flash_ready() ) {
+            if( ext_flash_idle() ) {
                 log_can_init();
                 Serial_debug(DEBUG_INFO, &cli_serial, "External Flash erase stop. Time:[%lu]\r\n", timer_get_ticks() - timeStart);
-                sharedVars_cpu1toCpu2.debug_log_disable_flag = false;
                 AppVarsInformEntireFlashResetReady();
                 canLogState.State_Next = Logging;
             }
@@ -703,6 +1575,53 @@ void log_can_state_machine(void) {
     canLogState.State_Current = canLogState.State_Next;
 }
 
+/* counter of the latest record published by CPU2, only a hint, the record may be rewritten */
+static inline uint32_t log_debug_log_latest_counter(void)
+{
+    return sharedVars_cpu2toCpu1.debug_log.record[sharedVars_cpu2toCpu1.debug_log.published & 1].counter;
+}
+
+/**
+ * @brief  Copies the latest complete debug log record published by CPU2
+ * CPU2 is never stopped, a copy it overwrote is detected by the sequence
+ * number of the buffer and taken again.
+ * @return false if every attempt was torn
+ */
+static bool log_debug_log_snapshot(debug_log_t *copy)
+{
+    const volatile uint16_t *src;
+    uint16_t *dst = (uint16_t *)copy;
+    uint16_t attempt, buffer, sequence, i;
+
+    for (attempt = 0; attempt < DEBUG_LOG_SNAPSHOT_ATTEMPTS; attempt++) {
+        buffer = sharedVars_cpu2toCpu1.debug_log.published & 1;
+        sequence = sharedVars_cpu2toCpu1.debug_log.sequence[buffer];
+
+        if ((sequence & 1) == 0) {
+            /* word by word through a volatile pointer, keeps the copy between the sequence reads */
+            src = (const volatile uint16_t *)&sharedVars_cpu2toCpu1.debug_log.record[buffer];
+            for (i = 0; i < CAN_LOG_RECORD_RAW_WORDS; i++) {
+                dst[i] = src[i];
+            }
+            if (sharedVars_cpu2toCpu1.debug_log.sequence[buffer] == sequence) {
+                debug_log_snapshots++;
+                return true;
+            }
+        }
+        debug_log_torn_reads++;
+    }
+
+    debug_log_missed++;
+    return false;
+}
+
+void log_debug_log_print_stats(void)
+{
+    Serial_printf(&cli_serial, " snapshots: %lu, torn reads: %lu, missed: %lu, CPU2 sequence: %u/%u\r\n",
+                  debug_log_snapshots, debug_log_torn_reads, debug_log_missed,
+                  sharedVars_cpu2toCpu1.debug_log.sequence[0], sharedVars_cpu2toCpu1.debug_log.sequence[1]);
+}
+
 /* check if there are new debug data to store */
 bool verify_new_can_data_to_log(void)
 {
@@ -712,17 +1631,14 @@ bool verify_new_can_data_to_log(void)
 
     timer_time_t ptime;
 
-    if( ( can_log_possible == false ) || ( sharedVars_cpu1toCpu2.debug_log_disable_flag == true ) ) {
+    if( can_log_possible == false ) {
         return false;
     }
 
-    /* check if there are new debug data to store */
-    if (last_debug_log_number != sharedVars_cpu2toCpu1.debug_log.counter)
+    /* check if there are new debug data to store, make local copy of data */
+    if( ( last_debug_log_number != log_debug_log_latest_counter() ) &&
+        ( log_debug_log_snapshot((debug_log_t *)&debug_log_copy) == true ) )
     {
-
-        /* make local copy of data */
-        sharedVars_cpu1toCpu2.debug_log_disable_flag = true;
-        memcpy((void *)&debug_log_copy, (void *)&sharedVars_cpu2toCpu1.debug_log, sizeof(debug_log_t));
         timer_get_time(&ptime);
         debug_log_copy.MagicNumber = MAGIC_NUMBER;
         debug_log_copy.CurrentTime = ptime.can_time;
@@ -730,13 +1646,12 @@ bool verify_new_can_data_to_log(void)
         debug_log_copy.MainBoardTemperature = temperatureSensorVector[TEMPERATURE_SENSOR_MAIN];
         debug_log_copy.MezzanineBoardTemperature = temperatureSensorVector[TEMPERATURE_SENSOR_MEZZANINE];
         debug_log_copy.PowerBankBoardTemperature = temperatureSensorVector[TEMPERATURE_SENSOR_PWR_BANK];
-        debug_log_copy.address = can_log_next_free_address;
+        /* the flash address is filled in when the record leaves the stage */
 
         /* update last read counter value */
         last_debug_log_number = debug_log_copy.counter;
 
         newDataAvailable = true;
-        sharedVars_cpu1toCpu2.debug_log_disable_flag = false;
     }
     return newDataAvailable;
 }
@@ -749,16 +1664,14 @@ void log_store_debug_log_to_flash(void)
 
     timer_time_t ptime;
 
-    if( ( can_log_possible == false ) || ( sharedVars_cpu1toCpu2.debug_log_disable_flag == true ) ) {
+    if( can_log_possible == false ) {
         return;
     }
 
-    /* check if there are new debug data to store */
-    if (last_debug_log_number != sharedVars_cpu2toCpu1.debug_log.counter)
+    /* check if there are new debug data to store, make local copy of data */
+    if( ( last_debug_log_number != log_debug_log_latest_counter() ) &&
+        ( log_debug_log_snapshot((debug_log_t *)&debug_log_copy) == true ) )
     {
-
-        /* make local copy of data */
-        memcpy((void *)&debug_log_copy, (void *)&sharedVars_cpu2toCpu1.debug_log, sizeof(debug_log_t));
         timer_get_time(&ptime);
         debug_log_copy.MagicNumber = MAGIC_NUMBER;
         debug_log_copy.CurrentTime = ptime.can_time;
@@ -784,16 +1697,10 @@ void log_store_debug_log_to_ram(void)
 
     timer_time_t ptime;
 
-    if( sharedVars_cpu1toCpu2.debug_log_disable_flag == true ) {
-        return;
-    }
-
-    /* check if there are new debug data to store */
-    if (last_debug_log_number != sharedVars_cpu2toCpu1.debug_log.counter)
+    /* check if there are new debug data to store, make local copy of data */
+    if( ( last_debug_log_number != log_debug_log_latest_counter() ) &&
+        ( log_debug_log_snapshot((debug_log_t *)&debug_log_copy) == true ) )
     {
-
-        /* make local copy of data */
-        memcpy((void *)&debug_log_copy, (void *)&sharedVars_cpu2toCpu1.debug_log, sizeof(debug_log_t));
         timer_get_time(&ptime);
         debug_log_copy.MagicNumber = 0xDEADFACE;
         debug_log_copy.CurrentTime = ptime.can_time;
@@ -893,7 +1800,7 @@ void log_debug_read_from_flash() {
         memset(&readBack, 0, sizeof(debug_log_t) );
         memset((void *)message, 0, TRANSFER_SIZE );
 
-        ext_flash_read_buf( debug_log_last_writen_address, (uint16_t*)message, sizeof(debug_log_t));
+        ext_flash_read_buf( debug_log_last_writen_address, (uint16_t*)message, CAN_LOG_RECORD_RAW_WORDS);
 
         memcpy((void *)&readBack, (void *)message,  sizeof(debug_log_t));
 
@@ -966,38 +1873,41 @@ void getObjData(
         UNSIGNED8   subIndex
     )
 {
+    /* the caller already looked the object up, read it without searching again */
+    CO_OD_HANDLE_T handle = { pDesc, index, subIndex };
+
     switch (pDesc->dType)
     {
         case CO_DTYPE_U8_CONST:
         case CO_DTYPE_BOOL_CONST:
-            coOdGetObj_u8(index, subIndex, pObj);
+            coOdGetObjH_u8(&handle, pObj);
             break;
         case CO_DTYPE_U16_CONST:
-            coOdGetObj_u16(index, subIndex, pObj);
+            coOdGetObjH_u16(&handle, pObj);
             break;
         case CO_DTYPE_U32_CONST:
-            coOdGetObj_u32(index, subIndex, pObj);
+            coOdGetObjH_u32(&handle, pObj);
             break;
         case CO_DTYPE_R32_CONST:
-            coOdGetObj_r32(index, subIndex, pObj);
+            coOdGetObjH_r32(&handle, pObj);
             break;
         case CO_DTYPE_U8_VAR:
         case CO_DTYPE_BOOL_VAR:
-            coOdGetObj_u8(index, subIndex, pObj);
+            coOdGetObjH_u8(&handle, pObj);
             break;
         case CO_DTYPE_U16_VAR:
-            coOdGetObj_u16(index, subIndex, pObj);
+            coOdGetObjH_u16(&handle, pObj);
             break;
         case CO_DTYPE_U32_VAR:
-            coOdGetObj_u32(index, subIndex, pObj);
+            coOdGetObjH_u32(&handle, pObj);
             break;
         case CO_DTYPE_R32_VAR:
-            coOdGetObj_r32(index, subIndex, pObj);
+            coOdGetObjH_r32(&handle, pObj);
             break;
         case CO_DTYPE_U8_PTR:
         case CO_DTYPE_BOOL_PTR:
             /* table initialized ? */
-            coOdGetObj_u8(index, subIndex, pObj);
+            coOdGetObjH_u8(&handle, pObj);
             break;
         case CO_DTYPE_U16_PTR:
 //            /* table initialized ? */
@@ -1012,22 +1922,22 @@ void getObjData(
 //            }
             break;
         case CO_DTYPE_I8_CONST:
-            coOdGetObj_i8(index, subIndex, pObj);
+            coOdGetObjH_i8(&handle, pObj);
             break;
         case CO_DTYPE_I16_CONST:
-            coOdGetObj_i16(index, subIndex, pObj);
+            coOdGetObjH_i16(&handle, pObj);
             break;
         case CO_DTYPE_I32_CONST:
-            coOdGetObj_i32(index, subIndex, pObj);
+            coOdGetObjH_i32(&handle, pObj);
             break;
         case CO_DTYPE_I8_VAR:
-            coOdGetObj_i8(index, subIndex, pObj);
+            coOdGetObjH_i8(&handle, pObj);
             break;
         case CO_DTYPE_I16_VAR:
-            coOdGetObj_i16(index, subIndex, pObj);
+            coOdGetObjH_i16(&handle, pObj);
             break;
         case CO_DTYPE_I32_VAR:
-            coOdGetObj_i32(index, subIndex, pObj);
+            coOdGetObjH_i32(&handle, pObj);
             break;
         case CO_DTYPE_I8_PTR:
 //            /* table initialized ? */
@@ -1086,7 +1996,7 @@ void getObjData(
         case CO_DTYPE_U8_NMT:
         case CO_DTYPE_U8_SRDO:
         case CO_DTYPE_U8_GFC:
-            coOdGetObj_u8(index, subIndex, pObj);
+            coOdGetObjH_u8(&handle, pObj);
             break;
         case CO_DTYPE_U16_TPDO:
         case CO_DTYPE_U16_RPDO:
@@ -1096,7 +2006,7 @@ void getObjData(
         case CO_DTYPE_U16_NETWORK:
         case CO_DTYPE_U16_SRDO:
         case CO_DTYPE_U16_FLYMA:
-            coOdGetObj_u16(index, subIndex, pObj);
+            coOdGetObjH_u16(&handle, pObj);
             break;
         case CO_DTYPE_U32_SDO_SERVER:
         case CO_DTYPE_U32_SDO_CLIENT:
@@ -1113,7 +2023,7 @@ void getObjData(
         case CO_DTYPE_U32_NETWORK:
         case CO_DTYPE_U32_NMT:
         case CO_DTYPE_U32_SRDO:
-            coOdGetObj_u32(index, subIndex, pObj);
+            coOdGetObjH_u32(&handle, pObj);
             break;
         default:
             ;
@@ -22,6 +22,7 @@
 #include "co_canopen.h"
 #include "common.h"
 #include "co_p401.h"
+#include "cpu2_log.h"
 #include "debug_log.h"
 #include "initialization_app.h"
 #include "emifc.h"
@@ -82,6 +83,7 @@ void main(void)
     /* also starts the heart-beat */
     co_init();
     coEventRegister_SDO_SERVER_DOMAIN_READ(log_read_domain);
+    coEventRegister_SDO_SERVER_DOMAIN_READ_FINISHED(log_read_domain_finished);
 
 
 
@@ -182,6 +184,7 @@ void main(void)
     MemCfg_setGSRAMMasterSel(MEMCFG_SECT_GS3, MEMCFG_GSRAMMASTER_CPU2);
 
     InitializeCPU1ToCPU2SharedVariables();
+    cpu2_log_reader_init();
 
     log_debug_log_set_state(true);
 
@@ -223,7 +226,11 @@ void main(void)
 
         cli_check_for_new_commands_from_UART();
 
-        while (coCommTask() == CO_TRUE);
+        while (coCommTask() == CO_TRUE) {
+            /* read the next SDO domain chunk while the stack waits for the bus */
+            log_domain_prefetch();
+        }
+        log_domain_prefetch();
 
         co401Task();
 
@@ -238,6 +245,12 @@ void main(void)
         //log_debug_read_from_ram( );
         log_can_state_machine();
 
+        /* start queued flash operations, report completed ones */
+        ext_flash_task();
+
+        /* start EMIF transfers held back while CPU2 had EMIF1 */
+        emifc_task();
+
 
         /* check every second */
         readAlltemperatures();
@@ -291,6 +304,8 @@ static void check_cpu2_ind(void)
  * Check for debug messages from CPU2.
  *
  * These messages are meant to be forwarded to the cli_serial device.
+ * The application on CPU2 logs to cpu2_log_ring, the CPU2 bootloader
+ * still sends its messages one at a time with IPC_CPU2_PRINT.
  */
 void check_cpu2_dbg(void)
 {
@@ -298,6 +313,8 @@ void check_cpu2_dbg(void)
     uint32_t addr;
     uint32_t data;
 
+    cpu2_log_process(CPU2_LOG_RECORDS_PER_POLL);
+
     if (IPC_readCommand(IPC_CPU1_L_CPU2_R, IPC_FLAG_CPU2_DBG, false, &cmd, &addr, &data) != false) {
         switch (cmd) {
         case IPC_CPU2_PRINT:
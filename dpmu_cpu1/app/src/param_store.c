@@ -0,0 +1,617 @@
+/*
+ * param_store.c
+ *
+ *  Log structured key-value store for parameters, see param_store.h.
+ *
+ *  Two flash sectors are used in turn. The active sector starts with a
+ *  header and holds records appended one after the other:
+ *      header:  magic, reserved, generation low, generation high
+ *      record:  (key << 8) | words, value (words), commit
+ *  The commit word is a checksum of the record header and value and is
+ *  programmed last, by its own flash operation. A record without a valid
+ *  commit word was torn by a reset and is skipped. The latest committed
+ *  record of a key holds its value.
+ *
+ *  When the active sector is full the latest values are copied to the other
+ *  sector, which then gets the header with the next generation. The copy is
+ *  read back and compared before the header is programmed, and the magic
+ *  word is programmed last, until then the old sector stays the active one.
+ *  A compaction is given up on any failed flash operation and started again
+ *  from the erase.
+ *  At mount the sector with a valid header and the highest generation is
+ *  scanned once, the values are kept in RAM from then on.
+ *
+ *  Values saved by the old app_vars_t log are imported when neither sector
+ *  has a valid header.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ext_flash.h"
+#include "main.h"
+#include "param_store.h"
+#include "serial.h"
+#include "timer.h"
+
+#define PARAM_STORE_MAGIC           0x4B56
+#define PARAM_STORE_HEADER_WORDS    4
+/* flash words of a value of size sizeof units, on the C28x these are words too */
+#define PARAM_STORE_WORDS(size)     (((size) + sizeof(uint16_t) - 1) / sizeof(uint16_t))
+#define PARAM_STORE_MAX_WORDS       PARAM_STORE_WORDS(SERIAL_NUMBER_SIZE_IN_CHARS)
+#define PARAM_STORE_APP_VARS_WORDS  PARAM_STORE_WORDS(sizeof(app_vars_t))
+#define PARAM_STORE_RECORD_WORDS(words) ((words) + 2)
+#define PARAM_STORE_ERASED          0xFFFF
+#define PARAM_STORE_NO_SECTOR       0xFFFF
+
+typedef enum {
+    PSTORE_IDLE = 0,
+    PSTORE_RECORD,          /* programming record header and value */
+    PSTORE_COMMIT,          /* programming the commit word of the record */
+    PSTORE_ERASE,           /* compaction, erasing the other sector */
+    PSTORE_COPY,            /* compaction, programming the latest values */
+    PSTORE_GENERATION,      /* compaction, programming the new generation */
+    PSTORE_MAGIC            /* compaction, programming the magic word, switches sector */
+} param_store_state_t;
+
+typedef struct {
+    uint16_t value[PARAM_STORE_MAX_WORDS];
+    bool valid;
+    bool dirty;             /* set since the last record of the key */
+} param_store_entry_t;
+
+/* value size in words, 0 for unused keys */
+static const uint16_t paramStoreWords[PARAM_KEYS] = {
+    0,
+    PARAM_STORE_WORDS(sizeof(param_capacitance_t)),
+    PARAM_STORE_WORDS(SERIAL_NUMBER_SIZE_IN_CHARS)
+};
+
+static const uint32_t paramStoreSectors[2] = {
+    PARAM_STORE_SECTOR_A_ADDRESS,
+    PARAM_STORE_SECTOR_B_ADDRESS
+};
+
+param_store_stats_t param_store_stats;
+
+static param_store_entry_t paramStoreCache[PARAM_KEYS];
+
+static struct {
+    bool mounted;
+    bool suspended;
+    uint16_t active;                /* index in paramStoreSectors, or PARAM_STORE_NO_SECTOR */
+    uint32_t generation;            /* of the active sector */
+    uint32_t free;                  /* next free address of the active sector */
+    param_store_state_t state;
+    uint16_t target;                /* sector being compacted to */
+    uint32_t address;               /* of the record or header being programmed */
+    uint16_t keys;                  /* bit per key in the operation in progress */
+    uint16_t words;                 /* words programmed by the operation in progress */
+    uint32_t startMs;
+    bool opPending;                 /* a queued flash operation has not called back */
+    bool opDone;
+    ext_flash_op_status_t opStatus;
+} paramStore = { .active = PARAM_STORE_NO_SECTOR };
+
+/* flash buffers, must stay valid until the operation calls back */
+static uint16_t paramStoreBuf[PARAM_STORE_HEADER_WORDS +
+                              PARAM_STORE_RECORD_WORDS(PARAM_STORE_WORDS(sizeof(param_capacitance_t))) +
+                              PARAM_STORE_RECORD_WORDS(PARAM_STORE_MAX_WORDS)];
+static uint16_t paramStoreWord[2];
+
+static inline uint32_t param_store_sector_end(uint16_t sector)
+{
+    return paramStoreSectors[sector] + PARAM_STORE_SECTOR_SIZE;
+}
+
+/**
+ * @brief  Commit word of a record, never 0xFFFF so that it can not read as erased
+ */
+static uint16_t param_store_checksum(uint16_t header, const uint16_t *value, uint16_t words)
+{
+    uint16_t sum = header;
+    uint16_t i;
+
+    for (i = 0; i < words; i++) {
+        sum = ((sum << 1) | (sum >> 15)) + value[i];
+    }
+    return sum & 0x7FFF;
+}
+
+static bool param_store_valid_header(uint16_t header)
+{
+    uint16_t key = header >> 8;
+
+    return (key > 0) && (key < PARAM_KEYS) && ((header & 0xFF) == paramStoreWords[key]);
+}
+
+/**
+ * @brief  Generation of a sector, 0 if the sector has no valid header
+ */
+static uint32_t param_store_read_generation(uint16_t sector)
+{
+    uint16_t header[PARAM_STORE_HEADER_WORDS];
+    uint32_t generation;
+
+    ext_flash_read_buf(paramStoreSectors[sector], header, PARAM_STORE_HEADER_WORDS);
+    generation = (uint32_t)header[2] | ((uint32_t)header[3] << 16);
+
+    if ((header[0] != PARAM_STORE_MAGIC) || (generation == 0xFFFFFFFF)) {
+        return 0;
+    }
+    return generation;
+}
+
+/**
+ * @brief  Reads the records of the active sector into the cache
+ */
+static void param_store_scan(void)
+{
+    uint16_t value[PARAM_STORE_MAX_WORDS];
+    uint32_t addr = paramStoreSectors[paramStore.active] + PARAM_STORE_HEADER_WORDS;
+    uint32_t end = param_store_sector_end(paramStore.active);
+    uint16_t header, words, key;
+
+    while (addr < end) {
+        header = ext_flash_read_word(addr);
+        if (header == PARAM_STORE_ERASED) {
+            break;
+        }
+        key = header >> 8;
+        words = header & 0xFF;
+        if (!param_store_valid_header(header) || (addr + PARAM_STORE_RECORD_WORDS(words) > end)) {
+            /* torn record header, nothing more can be appended behind it */
+            addr = end;
+            break;
+        }
+
+        ext_flash_read_buf(addr + 1, value, words);
+        if (ext_flash_read_word(addr + 1 + words) == param_store_checksum(header, value, words)) {
+            memcpy(paramStoreCache[key].value, value, words * sizeof(uint16_t));
+            paramStoreCache[key].valid = true;
+        }
+        param_store_stats.mountRecords++;
+        addr += PARAM_STORE_RECORD_WORDS(words);
+    }
+
+    paramStore.free = addr;
+}
+
+/**
+ * @brief  Takes the values from the latest record of the old app_vars_t log
+ */
+static void param_store_import(void)
+{
+    app_vars_t appVars;
+    param_capacitance_t capacitance;
+    uint32_t magic;
+    uint32_t addr;
+    uint32_t latest = 0;
+
+    for (addr = APP_VARS_EXT_FLASH_ADDRESS_START;
+         addr + PARAM_STORE_APP_VARS_WORDS < APP_VARS_EXT_FLASH_ADDRESS_END;
+         addr += PARAM_STORE_APP_VARS_WORDS) {
+        magic = (uint32_t)ext_flash_read_word(addr) | ((uint32_t)ext_flash_read_word(addr + 1) << 16);
+        if (magic == 0xFFFFFFFF) {
+            break;
+        }
+        if (magic == MAGIC_NUMBER) {
+            latest = addr;
+        }
+    }
+    if (latest == 0) {
+        return;
+    }
+
+    ext_flash_read_buf(latest, (uint16_t *)&appVars, PARAM_STORE_APP_VARS_WORDS);
+    capacitance.initialCapacitance = appVars.initialCapacitance;
+    capacitance.currentCapacitance = appVars.currentCapacitance;
+    param_store_set(PARAM_KEY_CAPACITANCE, &capacitance);
+    param_store_set(PARAM_KEY_SERIAL_NUMBER, appVars.serialNumber);
+    param_store_stats.imported = true;
+}
+
+/**
+ * @brief  Builds the RAM copy of the values, reads the flash directly
+ * Called when no flash operation is queued.
+ */
+void param_store_mount(void)
+{
+    uint32_t start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    uint32_t generation[2];
+    uint16_t sector;
+
+    memset(paramStoreCache, 0, sizeof(paramStoreCache));
+    paramStore.state = PSTORE_IDLE;
+    paramStore.opDone = false;
+    paramStore.active = PARAM_STORE_NO_SECTOR;
+    paramStore.generation = 0;
+    paramStore.free = 0;
+    param_store_stats.mountRecords = 0;
+    param_store_stats.imported = false;
+
+    for (sector = 0; sector < 2; sector++) {
+        generation[sector] = param_store_read_generation(sector);
+        if ((generation[sector] != 0) && (generation[sector] > paramStore.generation)) {
+            paramStore.active = sector;
+            paramStore.generation = generation[sector];
+        }
+    }
+
+    if (paramStore.active != PARAM_STORE_NO_SECTOR) {
+        param_store_scan();
+    } else {
+        param_store_import();
+    }
+
+    paramStore.mounted = true;
+    param_store_stats.mountCycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start;
+}
+
+bool param_store_mounted(void)
+{
+    return paramStore.mounted;
+}
+
+bool param_store_get(param_key_t key, void *value)
+{
+    if ((key == 0) || (key >= PARAM_KEYS) || !paramStoreCache[key].valid) {
+        return false;
+    }
+    memcpy(value, paramStoreCache[key].value, paramStoreWords[key] * sizeof(uint16_t));
+    return true;
+}
+
+bool param_store_set(param_key_t key, const void *value)
+{
+    param_store_entry_t *entry;
+
+    if ((key == 0) || (key >= PARAM_KEYS)) {
+        return false;
+    }
+    entry = &paramStoreCache[key];
+
+    if (entry->valid && (memcmp(entry->value, value, paramStoreWords[key] * sizeof(uint16_t)) == 0)) {
+        /* unchanged, save the flash */
+        return true;
+    }
+    memcpy(entry->value, value, paramStoreWords[key] * sizeof(uint16_t));
+    entry->valid = true;
+    entry->dirty = true;
+    return true;
+}
+
+bool param_store_committed(void)
+{
+    uint16_t key;
+
+    if (!paramStore.mounted || (paramStore.state != PSTORE_IDLE)) {
+        return false;
+    }
+    for (key = 1; key < PARAM_KEYS; key++) {
+        if (paramStoreCache[key].dirty) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void param_store_suspend(bool suspend)
+{
+    paramStore.suspended = suspend;
+    if (!suspend) {
+        /* the flash was changed behind the store's back */
+        paramStore.mounted = false;
+    }
+}
+
+static void param_store_op_done(ext_flash_op_status_t status, void *context)
+{
+    (void)context;
+
+    paramStore.opPending = false;
+    paramStore.opDone = true;
+    paramStore.opStatus = status;
+}
+
+static bool param_store_queue(uint32_t addr, const uint16_t *buf, uint16_t len)
+{
+    if (!ext_flash_queue_program(addr, buf, len, param_store_op_done, NULL)) {
+        return false;
+    }
+    paramStore.opPending = true;
+    paramStore.opDone = false;
+    return true;
+}
+
+/**
+ * @brief  Appends one record to buf, clears the dirty flag of the key
+ * @return words appended
+ */
+static uint16_t param_store_build_record(uint16_t *buf, uint16_t key)
+{
+    uint16_t words = paramStoreWords[key];
+    uint16_t header = (key << 8) | words;
+
+    buf[0] = header;
+    memcpy(&buf[1], paramStoreCache[key].value, words * sizeof(uint16_t));
+    buf[1 + words] = param_store_checksum(header, &buf[1], words);
+
+    paramStoreCache[key].dirty = false;
+    paramStore.keys |= 1 << key;
+    return PARAM_STORE_RECORD_WORDS(words);
+}
+
+/**
+ * @brief  Marks the keys of a failed operation for another try
+ */
+static void param_store_redirty(void)
+{
+    uint16_t key;
+
+    for (key = 1; key < PARAM_KEYS; key++) {
+        if (paramStore.keys & (1 << key)) {
+            paramStoreCache[key].dirty = true;
+        }
+    }
+    paramStore.keys = 0;
+    param_store_stats.errors++;
+}
+
+/**
+ * @brief  Gives up a compaction, the target has no valid header and the active sector is unchanged
+ */
+static void param_store_abort_compaction(void)
+{
+    param_store_redirty();
+    paramStore.state = PSTORE_IDLE;
+}
+
+/**
+ * @brief  Reads back the records copied by PSTORE_COPY
+ * Called when no flash operation is queued.
+ * @return true if every record in flash equals the one in paramStoreBuf
+ */
+static bool param_store_verify_copy(void)
+{
+    uint16_t record[PARAM_STORE_RECORD_WORDS(PARAM_STORE_MAX_WORDS)];
+    uint32_t addr = paramStoreSectors[paramStore.target] + PARAM_STORE_HEADER_WORDS;
+    uint16_t pos = 0;
+    uint16_t words;
+
+    while (pos < paramStore.words) {
+        words = PARAM_STORE_RECORD_WORDS(paramStoreBuf[pos] & 0xFF);
+        ext_flash_read_buf(addr + pos, record, words);
+        if (memcmp(record, &paramStoreBuf[pos], words * sizeof(uint16_t)) != 0) {
+            return false;
+        }
+        pos += words;
+    }
+    return true;
+}
+
+static void param_store_commit_done(void)
+{
+    uint32_t ms = timer_get_ticks() - paramStore.startMs;
+
+    param_store_stats.lastCommitMs = ms;
+    if (ms > param_store_stats.maxCommitMs) {
+        param_store_stats.maxCommitMs = ms;
+    }
+    paramStore.keys = 0;
+    paramStore.state = PSTORE_IDLE;
+}
+
+/**
+ * @brief  Starts writing the first dirty key, or a compaction if it does not fit
+ */
+static void param_store_start(void)
+{
+    uint16_t key;
+
+    for (key = 1; key < PARAM_KEYS; key++) {
+        if (paramStoreCache[key].dirty) {
+            break;
+        }
+    }
+    if (key == PARAM_KEYS) {
+        return;
+    }
+
+    paramStore.startMs = timer_get_ticks();
+    paramStore.keys = 0;
+
+    if ((paramStore.active != PARAM_STORE_NO_SECTOR) &&
+        (paramStore.free + PARAM_STORE_RECORD_WORDS(paramStoreWords[key]) <= param_store_sector_end(paramStore.active))) {
+        paramStore.address = paramStore.free;
+        paramStore.words = param_store_build_record(paramStoreBuf, key);
+        paramStore.state = PSTORE_RECORD;
+    } else {
+        paramStore.target = (paramStore.active == 0) ? 1 : 0;
+        paramStore.state = PSTORE_ERASE;
+    }
+}
+
+/**
+ * @brief  Queues the flash operation of the current state
+ */
+static void param_store_issue(void)
+{
+    uint16_t words;
+    uint16_t key;
+    uint32_t generation;
+
+    switch (paramStore.state) {
+    case PSTORE_RECORD:
+        /* everything but the commit word */
+        param_store_queue(paramStore.address, paramStoreBuf, paramStore.words - 1);
+        break;
+
+    case PSTORE_COMMIT:
+        param_store_queue(paramStore.address + paramStore.words - 1, &paramStoreBuf[paramStore.words - 1], 1);
+        break;
+
+    case PSTORE_ERASE:
+        if (ext_flash_queue_erase_sector(paramStoreSectors[paramStore.target], param_store_op_done, NULL)) {
+            paramStore.opPending = true;
+            paramStore.opDone = false;
+        }
+        break;
+
+    case PSTORE_COPY:
+        if (paramStore.keys == 0) {
+            words = 0;
+            for (key = 1; key < PARAM_KEYS; key++) {
+                if (paramStoreCache[key].valid) {
+                    words += param_store_build_record(&paramStoreBuf[words], key);
+                }
+            }
+            paramStore.words = words;
+        }
+        param_store_queue(paramStoreSectors[paramStore.target] + PARAM_STORE_HEADER_WORDS,
+                          paramStoreBuf, paramStore.words);
+        break;
+
+    case PSTORE_GENERATION:
+        generation = paramStore.generation + 1;
+        paramStoreWord[0] = (uint16_t)generation;
+        paramStoreWord[1] = (uint16_t)(generation >> 16);
+        param_store_queue(paramStoreSectors[paramStore.target] + 2, paramStoreWord, 2);
+        break;
+
+    case PSTORE_MAGIC:
+        paramStoreWord[0] = PARAM_STORE_MAGIC;
+        param_store_queue(paramStoreSectors[paramStore.target], paramStoreWord, 1);
+        break;
+
+    case PSTORE_IDLE:
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief  Moves to the next state when the flash operation of the current state is done
+ */
+static void param_store_advance(void)
+{
+    bool ok = (paramStore.opStatus == EXT_FLASH_OP_OK);
+
+    paramStore.opDone = false;
+
+    switch (paramStore.state) {
+    case PSTORE_RECORD:
+    case PSTORE_COMMIT:
+        /* the space is used even if programming failed, also after
+         * EXT_FLASH_OP_FAIL the pages before the one not erased are programmed */
+        if (!ok) {
+            paramStore.free = param_store_sector_end(paramStore.active);
+            param_store_redirty();
+            paramStore.state = PSTORE_IDLE;
+        } else if (paramStore.state == PSTORE_RECORD) {
+            paramStore.state = PSTORE_COMMIT;
+        } else {
+            paramStore.free += paramStore.words;
+            param_store_stats.records++;
+            param_store_commit_done();
+        }
+        break;
+
+    case PSTORE_ERASE:
+        if (ok) {
+            paramStore.keys = 0;
+            paramStore.state = PSTORE_COPY;
+        } else {
+            param_store_abort_compaction();
+        }
+        break;
+
+    case PSTORE_COPY:
+    case PSTORE_GENERATION:
+    case PSTORE_MAGIC:
+        if (!ok) {
+            param_store_abort_compaction();
+        } else if (paramStore.state == PSTORE_COPY) {
+            if (param_store_verify_copy()) {
+                paramStore.state = PSTORE_GENERATION;
+            } else {
+                param_store_stats.verifyErrors++;
+                param_store_abort_compaction();
+            }
+        } else if (paramStore.state == PSTORE_GENERATION) {
+            paramStore.state = PSTORE_MAGIC;
+        } else {
+            paramStore.active = paramStore.target;
+            paramStore.generation++;
+            paramStore.free = paramStoreSectors[paramStore.active] + PARAM_STORE_HEADER_WORDS + paramStore.words;
+            param_store_stats.compactions++;
+            param_store_commit_done();
+        }
+        break;
+
+    case PSTORE_IDLE:
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief  Writes the values set to flash, one queued flash operation at a time
+ * Never waits for the flash, called from the super loop.
+ */
+void param_store_task(void)
+{
+    if (paramStore.opPending) {
+        return;
+    }
+    if (paramStore.suspended) {
+        return;
+    }
+    if (!paramStore.mounted) {
+        if (ext_flash_idle()) {
+            param_store_mount();
+        }
+        return;
+    }
+
+    if (paramStore.opDone) {
+        if ((paramStore.state == PSTORE_COPY) && !ext_flash_idle()) {
+            /* the copy is read back directly, not while the flash is busy */
+            return;
+        }
+        param_store_advance();
+    }
+    if (paramStore.state == PSTORE_IDLE) {
+        param_store_start();
+    }
+    if (paramStore.state != PSTORE_IDLE) {
+        /* retried on the next pass if the flash queue is full */
+        param_store_issue();
+    }
+}
+
+void param_store_print_stats(void)
+{
+    uint16_t key;
+
+    if (paramStore.active == PARAM_STORE_NO_SECTOR) {
+        Serial_printf(&cli_serial, " active sector: none\r\n");
+    } else {
+        Serial_printf(&cli_serial, " active sector: %u at 0x%08lx, generation: %lu, free: %lu words\r\n",
+                      paramStore.active, paramStoreSectors[paramStore.active], paramStore.generation,
+                      param_store_sector_end(paramStore.active) - paramStore.free);
+    }
+    Serial_printf(&cli_serial, " mounted: %u, mount: %lu cycles, %u records, imported: %u\r\n",
+                  paramStore.mounted, param_store_stats.mountCycles, param_store_stats.mountRecords,
+                  param_store_stats.imported);
+    for (key = 1; key < PARAM_KEYS; key++) {
+        Serial_printf(&cli_serial, " key %u: %u words, valid: %u, dirty: %u\r\n",
+                      key, paramStoreWords[key], paramStoreCache[key].valid, paramStoreCache[key].dirty);
+    }
+    Serial_printf(&cli_serial, " records: %lu, compactions: %lu, errors: %lu, verify errors: %lu, state: %u\r\n",
+                  param_store_stats.records, param_store_stats.compactions, param_store_stats.errors,
+                  param_store_stats.verifyErrors, paramStore.state);
+    Serial_printf(&cli_serial, " commit: last %lu ms, max %lu ms\r\n",
+                  param_store_stats.lastCommitMs, param_store_stats.maxCommitMs);
+}
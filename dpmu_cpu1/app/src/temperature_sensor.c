@@ -13,6 +13,7 @@
 #include "canopen_emcy.h"
 #include "cli_cpu1.h"
 #include "co_common.h"
+#include "co_odaccess.h"
 #include "common.h"
 #include "device.h"
 #include "error_handling.h"
@@ -37,6 +38,22 @@ int16_t temperatureSensorVector[4];
 int16_t temperatureHotPoint;
 int16_t temperature_absolute_max_limit;
 int16_t temperature_high_limit;
+
+/* OD handles of the temperatures, resolved on first use */
+static CO_OD_HANDLE_T temperature_handle[4];
+
+/*
+ * writes a temperature to the OD without searching it each time
+ */
+static void temperature_to_od(uint8_t temp_sensor_number, uint8_t subIndex, int16_t temperature)
+{
+    CO_OD_HANDLE_T *handle = &temperature_handle[temp_sensor_number];
+
+    if (handle->pDesc == NULL)
+        coOdGetObjHandle(I_TEMPERATURE, subIndex, handle);
+    coOdPutObjH_i8(handle, temperature);
+}
+
 /*
  * returns pointer do wanted sensor struct
  */
@@ -147,7 +164,7 @@ void temperature_sensor_read_all_temperatures(void)
                 read_temperature_max = -128;
                 //read_temperature >>= 8;   /* convert to full degrees */
                 temperatureSensorVector[TEMPERATURE_SENSOR_BASE] = read_temperature;
-                coOdPutObj_i8(I_TEMPERATURE, S_TEMPERATURE_BASE, read_temperature);
+                temperature_to_od(TEMPERATURE_SENSOR_BASE, S_TEMPERATURE_BASE, read_temperature);
                 read_temperature_max = MAX(read_temperature, read_temperature_max);
                 sensorCount = 1;
             }
@@ -163,7 +180,7 @@ void temperature_sensor_read_all_temperatures(void)
             {
                 //read_temperature >>= 8;   /* convert to full degrees */
                 temperatureSensorVector[TEMPERATURE_SENSOR_MAIN] = read_temperature;
-                coOdPutObj_i8(I_TEMPERATURE, S_TEMPERATURE_MAIN, read_temperature);
+                temperature_to_od(TEMPERATURE_SENSOR_MAIN, S_TEMPERATURE_MAIN, read_temperature);
                 read_temperature_max = MAX(read_temperature, read_temperature_max);
                 sensorCount = 2;
             }
@@ -179,7 +196,7 @@ void temperature_sensor_read_all_temperatures(void)
             {
                 //read_temperature >>= 8;   /* convert to full degrees */
                 temperatureSensorVector[TEMPERATURE_SENSOR_MEZZANINE] = read_temperature;
-                coOdPutObj_i8(I_TEMPERATURE, S_TEMPERATURE_MEZZANINE, read_temperature);
+                temperature_to_od(TEMPERATURE_SENSOR_MEZZANINE, S_TEMPERATURE_MEZZANINE, read_temperature);
                 read_temperature_max = MAX(read_temperature, read_temperature_max);
                 sensorCount = 3;
             }
@@ -195,7 +212,7 @@ void temperature_sensor_read_all_temperatures(void)
             {
                 //read_temperature >>= 8;   /* convert to full degrees */
                 temperatureSensorVector[TEMPERATURE_SENSOR_PWR_BANK] = read_temperature;
-                coOdPutObj_i8(I_TEMPERATURE, S_TEMPERATURE_PWR_BANK, read_temperature);
+                temperature_to_od(TEMPERATURE_SENSOR_PWR_BANK, S_TEMPERATURE_PWR_BANK, read_temperature);
                 read_temperature_max = MAX(read_temperature, read_temperature_max);
                 sensorCount = 0;
                 temperatureHotPoint = read_temperature_max;
@@ -43,6 +43,9 @@
 ---------------------------------------------------------------------------*/
 #include <gen_define.h>
 
+/* replaced by the virtual CAN bus, see codrv/vbus */
+#ifndef CODRV_VBUS
+
 #include <co_datatype.h>
 #include <co_drv.h>
 #include <co_commtask.h>
@@ -1455,3 +1458,5 @@ static UNSIGNED8 trData[8] = {1,2,3,4,5,6,7,8};
     return (retVal);
 }
 #endif /* DRIVER_TEST */
+
+#endif /* CODRV_VBUS */
@@ -0,0 +1,194 @@
+/*
+* codrv_cpu_linux.c - CPU driver part for the virtual CAN bus on Linux
+*
+*-------------------------------------------------------------------
+*
+*
+*-------------------------------------------------------------------
+*
+*
+*/
+
+/********************************************************************/
+/**
+* \brief CPU specific routines for a Linux host
+*
+* \file codrv_cpu_linux.c
+*
+* Replaces codrv_cpu_28379d.c when the stack runs on the virtual CAN bus
+* in a host process (host_test/can_bench_host.c). The CPU timer 0
+* interrupt is an interval timer, coTimerTick() is called from its
+* SIGALRM handler as from codrvTimerISR() on the target.
+*
+* There is no CAN controller, the bus is run by codrvCanDriverHandler()
+* and codrvVbusStep(), so the CAN interrupt functions do nothing.
+*
+*/
+
+/* the CCS project builds every source, this one only for the host */
+#if defined(CODRV_VBUS) && !defined(__TMS320C28XX__)
+
+/* header of standard C - libraries
+---------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+/* header of project specific types
+---------------------------------------------------------------------------*/
+#include <gen_define.h>
+
+#include <co_datatype.h>
+#include <co_drv.h>
+#include <co_timer.h>
+
+#include "codrv_cpu_linux.h"
+
+
+/* constant definitions
+---------------------------------------------------------------------------*/
+
+/* OS related default definition */
+#ifdef CO_OS_SIGNAL_TIMER
+#else /* CO_OS_SIGNAL_TIMER */
+#  define CO_OS_SIGNAL_TIMER
+#endif /* CO_OS_SIGNAL_TIMER */
+
+
+/* local defined data types
+---------------------------------------------------------------------------*/
+
+/* list of external used functions, if not in headers
+---------------------------------------------------------------------------*/
+
+/* list of global defined functions
+---------------------------------------------------------------------------*/
+
+/* list of local defined functions
+---------------------------------------------------------------------------*/
+static void codrvTimerSignal(int sig);
+
+/* external variables
+---------------------------------------------------------------------------*/
+
+/* global variables
+---------------------------------------------------------------------------*/
+
+/* local defined variables
+---------------------------------------------------------------------------*/
+
+
+/***************************************************************************/
+/**
+* \brief codrvHardwareInit - hardware initialization
+*
+* Nothing to do for the clock and the interrupt controller of a process.
+*/
+void codrvHardwareInit(void)
+{
+	codrvHardwareCanInit();
+}
+
+/***************************************************************************/
+/**
+* \brief codrvHardwareCanInit - CAN related hardware initialization
+*
+* The virtual bus has no pins.
+*/
+void codrvHardwareCanInit(void)
+{
+}
+
+/***************************************************************************/
+/**
+* \brief codrvCanEnableInterrupt - enable the CAN interrupt
+*
+*/
+void codrvCanEnableInterrupt(void)
+{
+}
+
+/***************************************************************************/
+/**
+* \brief codrvCanDisableInterrupt - disable the CAN interrupt
+*
+*/
+void codrvCanDisableInterrupt(void)
+{
+}
+
+/***************************************************************************/
+/**
+* \brief codrvCanSetTxInterrupt - set pending bit of the Transmit interrupt
+*
+*/
+void codrvCanSetTxInterrupt(void)
+{
+	/* not possible */
+}
+
+/***************************************************************************/
+/**
+* \brief codrvTimerSetup - init and configure the hardware Timer
+*
+* This function starts a cyclic interval timer of the process
+* with the timer interval given by the function parameter.
+*
+* \return RET_T
+* \retval RET_OK
+*	intialization of the timer was ok
+* \retval RET_INTERNAL_ERROR
+*	the signal handler or the timer could not be set
+*
+*/
+RET_T codrvTimerSetup(
+		UNSIGNED32	timerInterval		/**< timer interval in usec */
+	)
+{
+struct sigaction action;
+struct itimerval timer;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = codrvTimerSignal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGALRM, &action, NULL) != 0)  {
+		return(RET_INTERNAL_ERROR);
+	}
+
+	timer.it_interval.tv_sec = timerInterval / 1000000ul;
+	timer.it_interval.tv_usec = timerInterval % 1000000ul;
+	timer.it_value = timer.it_interval;
+	if (setitimer(ITIMER_REAL, &timer, NULL) != 0)  {
+		return(RET_INTERNAL_ERROR);
+	}
+
+	return(RET_OK);
+}
+
+
+/***************************************************************************/
+/**
+* \brief codrvTimerSignal - Timer signal handler
+*
+* The counterpart of codrvTimerISR(), it interrupts the process
+* wherever it is, as the timer interrupt does on the target.
+*
+* \return void
+*
+*/
+static void codrvTimerSignal(
+		int sig
+    )
+{
+	(void)sig;
+
+	/* inform stack about new timer event */
+	coTimerTick();
+
+	/* signal timer tick */
+	CO_OS_SIGNAL_TIMER
+}
+
+#endif /* CODRV_VBUS && !__TMS320C28XX__ */
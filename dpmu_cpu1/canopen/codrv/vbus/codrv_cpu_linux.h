@@ -0,0 +1,28 @@
+/*
+* codrv_cpu_linux.h
+*
+*-------------------------------------------------------------------
+*
+*
+*-------------------------------------------------------------------
+*
+*
+*/
+
+/********************************************************************/
+/**
+* \file
+* \brief CPU driver part for the virtual CAN bus on a Linux host
+*
+*/
+
+#ifndef CODRV_CPU_LINUX_H
+#define CODRV_CPU_LINUX_H 1
+
+/* general hardware initialization */
+void codrvHardwareInit(void);
+
+/* init CAN related hardware part */
+void codrvHardwareCanInit(void);
+
+#endif /* CODRV_CPU_LINUX_H */
@@ -0,0 +1,1077 @@
+/*
+* codrv_vbus.c - virtual CAN bus driver
+*
+*-------------------------------------------------------------------
+*
+*
+*-------------------------------------------------------------------
+*
+*
+*/
+
+/********************************************************************/
+/**
+* \brief virtual CAN bus driver
+*
+* \file
+*
+* This module connects the CANopen stack to a CAN bus in memory,
+* instead of the D_CAN controller. It is used with CODRV_VBUS defined,
+* codrv_dcan.c is left out then.
+*
+* State:
+* - Transmit and receive data and remote frames, base and extended ids.
+* - Bit timing: frame length incl. stuff bits, CRC and interframe space.
+* - Arbitration by id between all nodes with a pending frame.
+* - Error injection: error frames for selected frames, lost frames.
+* - Error counters, error passive and bus off with automatic bus on.
+*
+* The bus is run from codrvCanDriverHandler() and codrvCanInterrupt(),
+* or by codrvVbusStep() from a client.
+*
+*/
+
+/* header of standard C - libraries
+---------------------------------------------------------------------------*/
+#include <stddef.h>
+#include <string.h>
+
+/* header of project specific types
+---------------------------------------------------------------------------*/
+#include <gen_define.h>
+
+#ifdef CODRV_VBUS
+
+#include <co_datatype.h>
+#include <co_drv.h>
+#include <co_commtask.h>
+
+#include <codrv_error.h>
+#include "codrv_vbus.h"
+
+
+/* constant definitions
+---------------------------------------------------------------------------*/
+#define VBUS_STACK_NODE		0u
+
+/* CRC, ACK and end of frame */
+#define VBUS_CRC_POLY		0x4599u
+#define VBUS_TAIL_BITS		(1u + 2u + 7u + 3u)	/* CRC del., ACK, EOF, IFS */
+
+/* error frame after half of the frame: flag, delimiter, IFS */
+#define VBUS_ERROR_FRAME_BITS	(6u + 8u + 3u)
+
+/* bus on after 128 x 11 recessive bits */
+#define VBUS_BUSOFF_RECOVERY_BITS	(128u * 11u)
+
+/* max. frames in one call of codrvCanInterrupt() */
+#define VBUS_MAX_STEPS		(CODRV_VBUS_NODE_CNT * CODRV_VBUS_QUEUE_LEN)
+
+/* OS related macros - default definition */
+#ifdef CO_OS_SIGNAL_CAN_RECEIVE
+#else
+#  define CO_OS_SIGNAL_CAN_RECEIVE
+#endif
+
+#ifdef CO_OS_SIGNAL_CAN_TRANSMIT
+#else
+#  define CO_OS_SIGNAL_CAN_TRANSMIT
+#endif
+
+
+/* local defined data types
+---------------------------------------------------------------------------*/
+typedef struct {
+	CODRV_VBUS_MSG_T	txQueue[CODRV_VBUS_QUEUE_LEN];
+	CODRV_VBUS_MSG_T	rxQueue[CODRV_VBUS_QUEUE_LEN];
+	UNSIGNED16	txRd;
+	UNSIGNED16	txCnt;
+	UNSIGNED16	rxRd;
+	UNSIGNED16	rxCnt;
+	UNSIGNED16	tec;			/* transmit error counter */
+	UNSIGNED16	rec;			/* receive error counter */
+	UNSIGNED16	busOffBits;		/* bits until bus on, 0 - not bus off */
+	BOOL_T		connected;		/* client used the bus, receives frames */
+} VBUS_NODE_T;
+
+/* bit stream state for stuffing and CRC */
+typedef struct {
+	UNSIGNED16	bits;
+	UNSIGNED16	stuffBits;
+	UNSIGNED16	crc;
+	UNSIGNED8	lastBit;
+	UNSIGNED8	run;
+} VBUS_BITSTREAM_T;
+
+/* list of external used functions, if not in headers
+---------------------------------------------------------------------------*/
+void codrvCanInterrupt(void);
+
+/* list of global defined functions
+---------------------------------------------------------------------------*/
+
+/* list of local defined functions
+---------------------------------------------------------------------------*/
+static void vbusReset(void);
+static BOOL_T vbusClientFull(void);
+static UNSIGNED32 vbusArbitrationKey(CO_CONST CODRV_VBUS_MSG_T *pMsg);
+static void vbusPutBits(VBUS_BITSTREAM_T *pStream, UNSIGNED32 value,
+		UNSIGNED8 cnt, BOOL_T crc);
+static UNSIGNED16 vbusFrameBits(CO_CONST CODRV_VBUS_MSG_T *pMsg,
+		UNSIGNED16 *pStuffBits);
+static void vbusAdvance(UNSIGNED16 bits);
+static BOOL_T vbusInjectError(CO_CONST CODRV_VBUS_MSG_T *pMsg);
+static void vbusDeliver(UNSIGNED8 txNode, CO_CONST CODRV_VBUS_MSG_T *pMsg);
+static void vbusStackReceive(CO_CONST CODRV_VBUS_MSG_T *pMsg);
+static void vbusStackTransmitted(void);
+static void codrvCanErrorHandler(void);
+
+/* external variables
+---------------------------------------------------------------------------*/
+
+/* global variables
+---------------------------------------------------------------------------*/
+
+/* local defined variables
+---------------------------------------------------------------------------*/
+static BOOL_T canEnabled = CO_FALSE; /**< CAN bus on */
+
+/** currently TX message */
+static CO_CAN_TR_MSG_T *pTxBuf = NULL;
+
+static VBUS_NODE_T vbusNode[CODRV_VBUS_NODE_CNT];
+static UNSIGNED32 vbusBits;			/**< bus time in bits */
+static UNSIGNED16 vbusKbit;			/**< bit rate in kbit/s */
+static UNSIGNED32 vbusErrorCnt;		/**< frames checked for error injection */
+static UNSIGNED32 vbusDropCnt;		/**< frames checked for drop injection */
+static CODRV_VBUS_ERROR_T vbusError;
+static CODRV_VBUS_STATS_T vbusStats;
+
+/** supported bit rates in kbit/s */
+static CO_CONST UNSIGNED16 vbusBitRates[] = {
+	10u, 20u, 50u, 100u, 125u, 250u, 500u, 800u, 1000u, 0u
+};
+
+
+/***************************************************************************/
+/**
+* \brief codrvCanInit - initialize CAN controller
+*
+* This function initializes the virtual bus and configures the bit rate.
+* At the end of the function, the CAN controller is in state disabled.
+*
+* \return RET_T
+* \retval RET_OK
+*	initialization was ok
+*
+*/
+RET_T codrvCanInit(
+		UNSIGNED16	bitRate		/**< CAN bitrate */
+	)
+{
+	canEnabled = CO_FALSE;
+	pTxBuf = NULL;
+
+	/* error states */
+	codrvCanErrorInit();
+
+	vbusReset();
+
+	return(codrvCanSetBitRate(bitRate));
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvCanSetBitRate - set CAN bitrate
+*
+* The CAN controller is disabled, as on the D_CAN controller.
+* The bit rate is used for the bus time only.
+*
+* \return RET_T
+* \retval RET_OK
+*	setup bitrate was ok
+* \retval RET_DRV_WRONG_BITRATE
+*	bitrate not supported
+*
+*/
+RET_T codrvCanSetBitRate(
+		UNSIGNED16	bitRate		/**< CAN bitrate in kbit/s */
+	)
+{
+UNSIGNED8 i = 0u;
+
+	/* stop CAN controller */
+	(void)codrvCanDisable();
+
+	while (vbusBitRates[i] != 0u)  {
+		if (vbusBitRates[i] == bitRate)  {
+			vbusKbit = bitRate;
+			return(RET_OK);
+		}
+		i++;
+	}
+
+	/* if bitrate not supported */
+	return(RET_DRV_WRONG_BITRATE);
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvCanEnable - enable CAN controller
+*
+* \return RET_T
+* \retval RET_OK
+*	CAN controller is enabled
+*
+*/
+RET_T codrvCanEnable(
+		void
+	)
+{
+	canEnabled = CO_TRUE;
+
+	/* transmit messages queued while disabled */
+	(void)codrvCanStartTransmission();
+
+	return(RET_OK);
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvCanDisable - disable CAN controller
+*
+* A frame already handed to the bus is still transmitted.
+*
+* \return RET_T
+* \retval RET_OK
+*	CAN controller is disabled
+*
+*/
+RET_T codrvCanDisable(
+		void
+	)
+{
+	canEnabled = CO_FALSE;
+
+	return(RET_OK);
+}
+
+
+#ifdef CO_DRV_FILTER
+/***********************************************************************/
+/**
+* \brief codrvCanSetFilter - set acceptance filter
+*
+* The virtual bus delivers all frames, the stack filters them.
+*
+* \return RET_T
+* \retval RET_OK
+*	OK
+*
+*/
+RET_T codrvCanSetFilter(
+		CO_CAN_COB_T * pCanCob /**< COB reference */
+	)
+{
+	(void)pCanCob;
+
+	return(RET_OK);
+}
+#endif /* CO_DRV_FILTER */
+
+
+/***********************************************************************/
+/**
+* \brief codrvCanStartTransmission - start can transmission if not active
+*
+* The next message of the transmit queue is handed to the bus,
+* if no message of the stack is pending.
+*
+* \return RET_T
+* \retval RET_OK
+*	start transmission was succesful
+* \retval RET_DRV_ERROR
+*	CAN controller disabled
+*
+*/
+RET_T codrvCanStartTransmission(
+		void
+	)
+{
+VBUS_NODE_T *pNode = &vbusNode[VBUS_STACK_NODE];
+CODRV_VBUS_MSG_T *pMsg;
+
+	/* if can is not enabled, return with error */
+	if (canEnabled != CO_TRUE)  {
+		return(RET_DRV_ERROR);
+	}
+
+	if (pTxBuf != NULL)  {
+		/* transmission active */
+		return(RET_OK);
+	}
+
+	/* get next message from transmit queue */
+	pTxBuf = coQueueGetNextTransmitMessage();
+	if (pTxBuf != NULL)  {
+		pMsg = &pNode->txQueue[0];
+		pMsg->canId = pTxBuf->canId;
+		pMsg->flags = pTxBuf->flags & (CO_COBFLAG_RTR | CO_COBFLAG_EXTENDED);
+		pMsg->len = pTxBuf->len;
+		memcpy(&pMsg->data[0], &pTxBuf->data[0], CO_CAN_MAX_DATA_LEN);
+		pNode->txRd = 0u;
+		pNode->txCnt = 1u;
+	}
+
+	return(RET_OK);
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvCanInterrupt - run the bus
+*
+* Transmits the pending frames of all nodes, in arbitration order,
+* until the bus is idle.
+* It stops while the receive queue of a client is full,
+* clients read their frames between the calls.
+*
+* \return void
+*
+*/
+void codrvCanInterrupt(void)
+{
+UNSIGNED16 steps = 0u;
+
+	while ((steps < VBUS_MAX_STEPS) && (vbusClientFull() == CO_FALSE))  {
+		if (codrvVbusStep() == CO_FALSE)  {
+			break;
+		}
+		steps++;
+	}
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvCanErrorHandler - local Error handler
+*
+* Derives the CAN state from the error counters of the stack node.
+*
+* \return void
+*
+*/
+static void codrvCanErrorHandler(void)
+{
+CAN_ERROR_FLAGS_T * pError;
+CO_CONST VBUS_NODE_T *pNode = &vbusNode[VBUS_STACK_NODE];
+
+	pError = codrvCanErrorGetFlags();
+
+	if (pNode->busOffBits != 0u)  {
+		pError->canNewState = Error_Busoff;
+	} else
+	if (canEnabled == CO_FALSE)  {
+		pError->canNewState = Error_Offline;
+	} else
+	if ((pNode->tec > 127u) || (pNode->rec > 127u))  {
+		pError->canNewState = Error_Passive;
+	} else {
+		pError->canNewState = Error_Active;
+	}
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvCanDriverHandler - can driver handler
+*
+* This function is cyclically called from the CANopen stack.
+* It runs the bus and informs the stack about CAN state changes.
+*
+* \return void
+*
+*/
+void codrvCanDriverHandler(
+		void
+	)
+{
+	codrvCanInterrupt();
+
+	/* check current state */
+	codrvCanErrorHandler();
+
+	/* inform stack about the state changes during two handler calls */
+	(void)codrvCanErrorInformStack();
+
+	return;
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusTransmit - transmit a frame from a client node
+*
+* The frame is queued, it is transmitted by the next codrvVbusStep().
+*
+* \return RET_T
+* \retval RET_OK
+*	frame queued
+* \retval RET_INVALID_PARAMETER
+*	no client node
+* \retval RET_DRV_BUSY
+*	transmit queue full
+*
+*/
+RET_T codrvVbusTransmit(
+		UNSIGNED8		node,		/**< client node, 1.. */
+		CO_CONST CODRV_VBUS_MSG_T *pMsg	/**< frame */
+	)
+{
+VBUS_NODE_T *pNode;
+
+	if ((node == VBUS_STACK_NODE) || (node >= CODRV_VBUS_NODE_CNT))  {
+		return(RET_INVALID_PARAMETER);
+	}
+	pNode = &vbusNode[node];
+	pNode->connected = CO_TRUE;
+	if (pNode->txCnt >= CODRV_VBUS_QUEUE_LEN)  {
+		return(RET_DRV_BUSY);
+	}
+
+	pNode->txQueue[(pNode->txRd + pNode->txCnt) % CODRV_VBUS_QUEUE_LEN] = *pMsg;
+	pNode->txCnt++;
+
+	return(RET_OK);
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusReceive - get a frame received by a client node
+*
+* \return BOOL_T
+* \retval CO_TRUE
+*	frame copied to pMsg
+* \retval CO_FALSE
+*	no frame received
+*
+*/
+BOOL_T codrvVbusReceive(
+		UNSIGNED8		node,		/**< client node, 1.. */
+		CODRV_VBUS_MSG_T *pMsg		/**< received frame */
+	)
+{
+VBUS_NODE_T *pNode;
+
+	if ((node == VBUS_STACK_NODE) || (node >= CODRV_VBUS_NODE_CNT))  {
+		return(CO_FALSE);
+	}
+	pNode = &vbusNode[node];
+	pNode->connected = CO_TRUE;
+	if (pNode->rxCnt == 0u)  {
+		return(CO_FALSE);
+	}
+
+	*pMsg = pNode->rxQueue[pNode->rxRd];
+	pNode->rxRd = (pNode->rxRd + 1u) % CODRV_VBUS_QUEUE_LEN;
+	pNode->rxCnt--;
+
+	return(CO_TRUE);
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusStep - transmit one frame
+*
+* The pending frame with the lowest arbitration value wins the bus.
+* If nothing is pending, but a node is bus off,
+* the bus time runs until the node is bus on again.
+*
+* \return BOOL_T
+* \retval CO_TRUE
+*	a frame, an error frame or a bus off recovery was on the bus
+* \retval CO_FALSE
+*	bus idle
+*
+*/
+BOOL_T codrvVbusStep(
+		void
+	)
+{
+VBUS_NODE_T *pNode;
+CODRV_VBUS_MSG_T msg;
+UNSIGNED32 key;
+UNSIGNED32 bestKey = 0xFFFFFFFFul;
+UNSIGNED16 bits;
+UNSIGNED16 stuffBits;
+UNSIGNED16 recovery = 0u;
+UNSIGNED8 node;
+UNSIGNED8 txNode = CODRV_VBUS_NODE_CNT;
+UNSIGNED8 pending = 0u;
+
+	/* arbitration */
+	for (node = 0u; node < CODRV_VBUS_NODE_CNT; node++)  {
+		pNode = &vbusNode[node];
+		if (pNode->busOffBits != 0u)  {
+			if ((recovery == 0u) || (pNode->busOffBits < recovery))  {
+				recovery = pNode->busOffBits;
+			}
+		} else
+		if (pNode->txCnt != 0u)  {
+			pending++;
+			key = vbusArbitrationKey(&pNode->txQueue[pNode->txRd]);
+			/* same id from two nodes - the lower node wins */
+			if ((txNode == CODRV_VBUS_NODE_CNT) || (key < bestKey))  {
+				bestKey = key;
+				txNode = node;
+			}
+		} else {
+			/* nothing to transmit */
+		}
+	}
+
+	if (txNode == CODRV_VBUS_NODE_CNT)  {
+		if (recovery == 0u)  {
+			return(CO_FALSE);
+		}
+		/* idle bus until the first node is bus on again */
+		vbusAdvance(recovery);
+		return(CO_TRUE);
+	}
+
+	vbusStats.arbitrationLost += (UNSIGNED32)pending - 1u;
+
+	pNode = &vbusNode[txNode];
+	msg = pNode->txQueue[pNode->txRd];
+	bits = vbusFrameBits(&msg, &stuffBits);
+
+	if (vbusInjectError(&msg) == CO_TRUE)  {
+		/* error frame, the frame stays pending */
+		vbusStats.errorFrames++;
+		vbusAdvance((bits / 2u) + VBUS_ERROR_FRAME_BITS);
+
+		pNode->tec += 8u;
+		for (node = 0u; node < CODRV_VBUS_NODE_CNT; node++)  {
+			if ((node != txNode) && (vbusNode[node].busOffBits == 0u)
+			 && (vbusNode[node].rec < 255u))  {
+				vbusNode[node].rec++;
+			}
+		}
+		if (pNode->tec > 255u)  {
+			vbusStats.busOffs++;
+			pNode->busOffBits = VBUS_BUSOFF_RECOVERY_BITS;
+		}
+		return(CO_TRUE);
+	}
+
+	vbusAdvance(bits);
+	vbusStats.frames++;
+	vbusStats.stuffBits += stuffBits;
+	msg.busTime = vbusBits;
+
+	pNode->txRd = (pNode->txRd + 1u) % CODRV_VBUS_QUEUE_LEN;
+	pNode->txCnt--;
+	if (pNode->tec > 0u)  {
+		pNode->tec--;
+	}
+
+	vbusDeliver(txNode, &msg);
+
+	if (txNode == VBUS_STACK_NODE)  {
+		vbusStackTransmitted();
+	}
+
+	return(CO_TRUE);
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusTime - bus time
+*
+* \return UNSIGNED32
+*	bus time in bits
+*
+*/
+UNSIGNED32 codrvVbusTime(
+		void
+	)
+{
+	return(vbusBits);
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusBitRate - bit rate
+*
+* \return UNSIGNED16
+*	bit rate in kbit/s
+*
+*/
+UNSIGNED16 codrvVbusBitRate(
+		void
+	)
+{
+	return(vbusKbit);
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusSetError - set error injection
+*
+* \return void
+*
+*/
+void codrvVbusSetError(
+		CO_CONST CODRV_VBUS_ERROR_T *pError	/**< error injection */
+	)
+{
+	vbusError = *pError;
+	vbusErrorCnt = 0u;
+	vbusDropCnt = 0u;
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusGetStats - get bus statistics
+*
+* \return void
+*
+*/
+void codrvVbusGetStats(
+		CODRV_VBUS_STATS_T *pStats	/**< statistics */
+	)
+{
+	*pStats = vbusStats;
+	pStats->bits = vbusBits;
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusClearStats - clear bus statistics
+*
+* The bus time is not reset.
+*
+* \return void
+*
+*/
+void codrvVbusClearStats(
+		void
+	)
+{
+	memset(&vbusStats, 0, sizeof(vbusStats));
+}
+
+
+/***********************************************************************/
+/**
+* \brief codrvVbusGetErrorCounters - get the error counters of a node
+*
+* \return void
+*
+*/
+void codrvVbusGetErrorCounters(
+		UNSIGNED8		node,		/**< node, 0 - stack */
+		UNSIGNED16		*pTec,		/**< transmit error counter */
+		UNSIGNED16		*pRec		/**< receive error counter */
+	)
+{
+	if (node >= CODRV_VBUS_NODE_CNT)  {
+		*pTec = 0u;
+		*pRec = 0u;
+		return;
+	}
+	*pTec = vbusNode[node].tec;
+	*pRec = vbusNode[node].rec;
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusReset - reset all nodes and the statistics
+*
+* \internal
+*
+* \return void
+*
+*/
+static void vbusReset(
+		void
+	)
+{
+	memset(&vbusNode[0], 0, sizeof(vbusNode));
+	memset(&vbusError, 0, sizeof(vbusError));
+	vbusBits = 0u;
+	vbusErrorCnt = 0u;
+	vbusDropCnt = 0u;
+	codrvVbusClearStats();
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusClientFull - check the receive queues of the clients
+*
+* \internal
+*
+* Only connected clients count, the others get no frames.
+*
+* \return BOOL_T
+* \retval CO_TRUE
+*	a client receive queue is full
+*
+*/
+static BOOL_T vbusClientFull(
+		void
+	)
+{
+UNSIGNED8 node;
+
+	for (node = VBUS_STACK_NODE + 1u; node < CODRV_VBUS_NODE_CNT; node++)  {
+		if (vbusNode[node].rxCnt >= CODRV_VBUS_QUEUE_LEN)  {
+			return(CO_TRUE);
+		}
+	}
+
+	return(CO_FALSE);
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusArbitrationKey - arbitration field as number
+*
+* \internal
+*
+* The bits of the arbitration field, from the first:
+* base id, RTR or SRR, IDE, extended id, RTR.
+* A lower key wins the arbitration.
+*
+* \return UNSIGNED32
+*	key
+*
+*/
+static UNSIGNED32 vbusArbitrationKey(
+		CO_CONST CODRV_VBUS_MSG_T *pMsg	/**< frame */
+	)
+{
+UNSIGNED32 key;
+
+	if ((pMsg->flags & CO_COBFLAG_EXTENDED) == 0u)  {
+		key = (pMsg->canId & 0x7FFul) << 21;
+		if ((pMsg->flags & CO_COBFLAG_RTR) != 0u)  {
+			key |= 1ul << 20;
+		}
+	} else {
+		key = ((pMsg->canId >> 18) & 0x7FFul) << 21;
+		key |= (1ul << 20) | (1ul << 19);	/* SRR, IDE */
+		key |= (pMsg->canId & 0x3FFFFul) << 1;
+		if ((pMsg->flags & CO_COBFLAG_RTR) != 0u)  {
+			key |= 1ul;
+		}
+	}
+
+	return(key);
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusPutBits - add bits to the stuffed part of a frame
+*
+* \internal
+*
+* \return void
+*
+*/
+static void vbusPutBits(
+		VBUS_BITSTREAM_T *pStream,	/**< bit stream */
+		UNSIGNED32		value,		/**< bits, msb first */
+		UNSIGNED8		cnt,		/**< number of bits */
+		BOOL_T			crc			/**< bits are part of the CRC */
+	)
+{
+UNSIGNED8 bit;
+
+	while (cnt > 0u)  {
+		cnt--;
+		bit = (UNSIGNED8)((value >> cnt) & 1u);
+
+		if (crc == CO_TRUE)  {
+			if ((bit ^ ((pStream->crc >> 14) & 1u)) != 0u)  {
+				pStream->crc = ((pStream->crc << 1) ^ VBUS_CRC_POLY) & 0x7FFFu;
+			} else {
+				pStream->crc = (pStream->crc << 1) & 0x7FFFu;
+			}
+		}
+
+		if (bit == pStream->lastBit)  {
+			pStream->run++;
+		} else {
+			pStream->lastBit = bit;
+			pStream->run = 1u;
+		}
+		pStream->bits++;
+
+		/* 5 equal bits - stuff bit of the other level */
+		if (pStream->run == 5u)  {
+			pStream->bits++;
+			pStream->stuffBits++;
+			pStream->lastBit = bit ^ 1u;
+			pStream->run = 1u;
+		}
+	}
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusFrameBits - length of a frame on the bus
+*
+* \internal
+*
+* \return UNSIGNED16
+*	bits from start of frame to the end of the interframe space
+*
+*/
+static UNSIGNED16 vbusFrameBits(
+		CO_CONST CODRV_VBUS_MSG_T *pMsg,	/**< frame */
+		UNSIGNED16		*pStuffBits		/**< stuff bits of the frame */
+	)
+{
+VBUS_BITSTREAM_T stream;
+UNSIGNED8 rtr;
+UNSIGNED8 len;
+UNSIGNED8 i;
+
+	stream.bits = 0u;
+	stream.stuffBits = 0u;
+	stream.crc = 0u;
+	stream.lastBit = 2u;
+	stream.run = 0u;
+
+	rtr = ((pMsg->flags & CO_COBFLAG_RTR) != 0u) ? 1u : 0u;
+	len = (pMsg->len > CO_CAN_MAX_DATA_LEN) ? CO_CAN_MAX_DATA_LEN : pMsg->len;
+
+	/* SOF */
+	vbusPutBits(&stream, 0u, 1u, CO_TRUE);
+	if ((pMsg->flags & CO_COBFLAG_EXTENDED) == 0u)  {
+		vbusPutBits(&stream, pMsg->canId & 0x7FFul, 11u, CO_TRUE);
+		vbusPutBits(&stream, rtr, 1u, CO_TRUE);
+		/* IDE, r0 */
+		vbusPutBits(&stream, 0u, 2u, CO_TRUE);
+	} else {
+		vbusPutBits(&stream, (pMsg->canId >> 18) & 0x7FFul, 11u, CO_TRUE);
+		/* SRR, IDE */
+		vbusPutBits(&stream, 3u, 2u, CO_TRUE);
+		vbusPutBits(&stream, pMsg->canId & 0x3FFFFul, 18u, CO_TRUE);
+		vbusPutBits(&stream, rtr, 1u, CO_TRUE);
+		/* r1, r0 */
+		vbusPutBits(&stream, 0u, 2u, CO_TRUE);
+	}
+	vbusPutBits(&stream, len, 4u, CO_TRUE);
+	if (rtr == 0u)  {
+		for (i = 0u; i < len; i++)  {
+			vbusPutBits(&stream, pMsg->data[i] & 0xFFu, 8u, CO_TRUE);
+		}
+	}
+	vbusPutBits(&stream, stream.crc, 15u, CO_FALSE);
+
+	*pStuffBits = stream.stuffBits;
+
+	return(stream.bits + VBUS_TAIL_BITS);
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusAdvance - advance the bus time
+*
+* \internal
+*
+* Nodes that are bus off count the bits for the recovery.
+*
+* \return void
+*
+*/
+static void vbusAdvance(
+		UNSIGNED16		bits		/**< bits on the bus */
+	)
+{
+UNSIGNED8 node;
+VBUS_NODE_T *pNode;
+
+	vbusBits += bits;
+
+	for (node = 0u; node < CODRV_VBUS_NODE_CNT; node++)  {
+		pNode = &vbusNode[node];
+		if (pNode->busOffBits != 0u)  {
+			if (pNode->busOffBits > bits)  {
+				pNode->busOffBits -= bits;
+			} else {
+				/* automatic bus on */
+				pNode->busOffBits = 0u;
+				pNode->tec = 0u;
+				pNode->rec = 0u;
+			}
+		}
+	}
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusInjectError - check error injection for a frame
+*
+* \internal
+*
+* \return BOOL_T
+* \retval CO_TRUE
+*	destroy the frame by an error frame
+*
+*/
+static BOOL_T vbusInjectError(
+		CO_CONST CODRV_VBUS_MSG_T *pMsg	/**< frame */
+	)
+{
+	if (vbusError.errorEvery == 0u)  {
+		return(CO_FALSE);
+	}
+	if ((vbusError.errorCanId != CODRV_VBUS_ALL_IDS)
+	 && (vbusError.errorCanId != pMsg->canId))  {
+		return(CO_FALSE);
+	}
+
+	vbusErrorCnt++;
+	if ((vbusErrorCnt % vbusError.errorEvery) != 0u)  {
+		return(CO_FALSE);
+	}
+
+	return(CO_TRUE);
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusDeliver - deliver a frame to all other nodes
+*
+* \internal
+*
+* \return void
+*
+*/
+static void vbusDeliver(
+		UNSIGNED8		txNode,		/**< transmitting node */
+		CO_CONST CODRV_VBUS_MSG_T *pMsg	/**< frame */
+	)
+{
+UNSIGNED8 node;
+VBUS_NODE_T *pNode;
+
+	for (node = 0u; node < CODRV_VBUS_NODE_CNT; node++)  {
+		pNode = &vbusNode[node];
+		if ((node == txNode) || (pNode->busOffBits != 0u))  {
+			continue;
+		}
+		/* a client nobody reads would stop the bus, see vbusClientFull() */
+		if ((node != VBUS_STACK_NODE) && (pNode->connected == CO_FALSE))  {
+			continue;
+		}
+		if (pNode->rec > 0u)  {
+			pNode->rec--;
+		}
+
+		if (node == VBUS_STACK_NODE)  {
+			vbusStackReceive(pMsg);
+		} else
+		if (pNode->rxCnt >= CODRV_VBUS_QUEUE_LEN)  {
+			vbusStats.overruns++;
+		} else {
+			pNode->rxQueue[(pNode->rxRd + pNode->rxCnt) % CODRV_VBUS_QUEUE_LEN] = *pMsg;
+			pNode->rxCnt++;
+		}
+	}
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusStackReceive - hand a frame to the stack
+*
+* \internal
+*
+* \return void
+*
+*/
+static void vbusStackReceive(
+		CO_CONST CODRV_VBUS_MSG_T *pMsg	/**< frame */
+	)
+{
+UNSIGNED8 *pRecDataBuf;
+CAN_ERROR_FLAGS_T * pError;
+
+	if (canEnabled != CO_TRUE)  {
+		return;
+	}
+
+	if (vbusError.dropEvery != 0u)  {
+		vbusDropCnt++;
+		if ((vbusDropCnt % vbusError.dropEvery) == 0u)  {
+			vbusStats.drops++;
+			pError = codrvCanErrorGetFlags();
+			pError->canErrorRxOverrun = CO_TRUE;
+			return;
+		}
+	}
+
+	/* get receiveBuffer, NULL for RTR and 0 bytes */
+	pRecDataBuf = coQueueGetReceiveBuffer(pMsg->canId, pMsg->len, pMsg->flags);
+	if (pRecDataBuf != NULL)  {
+		memcpy(pRecDataBuf, &pMsg->data[0], pMsg->len);
+
+		/* set buffer filled */
+		coQueueReceiveBufferIsFilled();
+	}
+
+	/* signal received message */
+	CO_OS_SIGNAL_CAN_RECEIVE
+}
+
+
+/***********************************************************************/
+/**
+* \brief vbusStackTransmitted - frame of the stack transmitted
+*
+* \internal
+*
+* Inform the stack and hand the next message to the bus.
+*
+* \return void
+*
+*/
+static void vbusStackTransmitted(
+		void
+	)
+{
+	/* inform stack about transmitted message */
+	if (pTxBuf != NULL)  {
+		coQueueMsgTransmitted(pTxBuf);
+		pTxBuf = NULL;
+	}
+
+	(void)codrvCanStartTransmission();
+
+	/* signal transmitted message */
+	CO_OS_SIGNAL_CAN_TRANSMIT
+}
+
+#endif /* CODRV_VBUS */
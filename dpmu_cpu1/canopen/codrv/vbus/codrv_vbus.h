@@ -0,0 +1,88 @@
+/*
+* codrv_vbus.h - virtual CAN bus driver
+*
+*-------------------------------------------------------------------
+*
+*
+*-------------------------------------------------------------------
+*
+*
+*/
+
+/********************************************************************/
+/**
+* \file
+* \brief virtual CAN bus
+*
+* Node 0 of the bus is the CANopen stack, connected by the codrv*
+* functions. The other nodes are clients, they transmit and receive
+* frames by codrvVbusTransmit() and codrvVbusReceive(). A client is
+* connected with its first call of one of them, before that it gets
+* no frames and does not hold up the bus.
+*
+* The bus time counts bits, it advances only with frames and error frames
+* on the bus, idle time between frames is not modelled.
+*
+*/
+
+#ifndef CODRV_VBUS_H
+#define CODRV_VBUS_H 1
+
+/* constant definitions
+---------------------------------------------------------------------------*/
+#ifndef CODRV_VBUS_NODE_CNT
+# define CODRV_VBUS_NODE_CNT	3u		/**< nodes incl. the stack */
+#endif /* CODRV_VBUS_NODE_CNT */
+
+#ifndef CODRV_VBUS_QUEUE_LEN
+# define CODRV_VBUS_QUEUE_LEN	8u		/**< frames per client and direction */
+#endif /* CODRV_VBUS_QUEUE_LEN */
+
+#define CODRV_VBUS_ALL_IDS		0xFFFFFFFFul	/**< error injection for all ids */
+
+
+/* datatypes
+---------------------------------------------------------------------------*/
+/** frame on the virtual bus */
+typedef struct {
+	UNSIGNED32	canId;			/**< can identifier */
+	UNSIGNED32	busTime;		/**< bus time in bits at the end of the frame */
+	UNSIGNED8	flags;			/**< CO_COBFLAG_RTR, CO_COBFLAG_EXTENDED */
+	UNSIGNED8	len;			/**< msg len */
+	UNSIGNED8	data[CO_CAN_MAX_DATA_LEN];	/**< data */
+} CODRV_VBUS_MSG_T;
+
+/** error injection */
+typedef struct {
+	UNSIGNED16	errorEvery;		/**< destroy every n-th frame, 0 - off */
+	UNSIGNED32	errorCanId;		/**< only frames with this id, or CODRV_VBUS_ALL_IDS */
+	UNSIGNED16	dropEvery;		/**< stack loses every n-th received frame, 0 - off */
+} CODRV_VBUS_ERROR_T;
+
+/** bus statistics */
+typedef struct {
+	UNSIGNED32	frames;			/**< frames transmitted */
+	UNSIGNED32	bits;			/**< bus time in bits, incl. stuff bits */
+	UNSIGNED32	stuffBits;		/**< stuff bits of the frames */
+	UNSIGNED32	errorFrames;	/**< frames destroyed by error injection */
+	UNSIGNED32	arbitrationLost;	/**< frames that had to wait for a lower id */
+	UNSIGNED32	drops;			/**< frames lost by the stack, injected */
+	UNSIGNED32	overruns;		/**< frames lost, receive queue full */
+	UNSIGNED32	busOffs;		/**< bus off events */
+} CODRV_VBUS_STATS_T;
+
+
+/* function prototypes
+---------------------------------------------------------------------------*/
+RET_T codrvVbusTransmit(UNSIGNED8 node, CO_CONST CODRV_VBUS_MSG_T *pMsg);
+BOOL_T codrvVbusReceive(UNSIGNED8 node, CODRV_VBUS_MSG_T *pMsg);
+BOOL_T codrvVbusStep(void);
+UNSIGNED32 codrvVbusTime(void);
+UNSIGNED16 codrvVbusBitRate(void);
+void codrvVbusSetError(CO_CONST CODRV_VBUS_ERROR_T *pError);
+void codrvVbusGetStats(CODRV_VBUS_STATS_T *pStats);
+void codrvVbusClearStats(void);
+void codrvVbusGetErrorCounters(UNSIGNED8 node, UNSIGNED16 *pTec,
+		UNSIGNED16 *pRec);
+
+#endif /* CODRV_VBUS_H */
@@ -85,6 +85,18 @@ typedef struct {
 } CO_NV_STORAGE CODRV_BTR_T;
 
 
+/** transmit queue statistics, see coQueueGetStats() */
+typedef struct {
+	UNSIGNED16			bufUsed;		/**< transmit buffers in use */
+	UNSIGNED16			bufHighWater;	/**< max. transmit buffers in use */
+	UNSIGNED16			transmitDepth;	/**< messages at transmit ring */
+	UNSIGNED16			inhibitDepth;	/**< messages waiting for inhibit time */
+	UNSIGNED16			inhibitHighWater;	/**< max. messages waiting for inhibit time */
+	UNSIGNED16			inhibitCobs;	/**< cobs with active inhibit time */
+	UNSIGNED32			overflows;		/**< messages rejected, all buffers in use */
+} CO_QUEUE_STATS_T;
+
+
 
 /* function prototypes */
 
@@ -119,6 +131,7 @@ EXTERN_DECL void	coQueueReceiveBufferIsFilled(void);
 EXTERN_DECL BOOL_T	coQueueReceiveMessageAvailable(void);
 EXTERN_DECL CO_CAN_TR_MSG_T *coQueueGetNextTransmitMessage(void);
 EXTERN_DECL void	coQueueMsgTransmitted(const CO_CAN_TR_MSG_T *pBuf);
+EXTERN_DECL void	coQueueGetStats(CO_QUEUE_STATS_T *pStats);
 EXTERN_DECL RET_T	CUSTOMER_TRANSMIT_MESSAGES_CALLBACK(
 						UNSIGNED32 canId, UNSIGNED8 len, UNSIGNED8 *buffer);
 #ifdef OLD_FIXED_BUFFER
@@ -145,6 +145,16 @@ typedef struct {
 } CO_NV_STORAGE CO_OD_ASSIGN_T;
 
 
+/**
+* handle of an object, see coOdGetObjHandle()
+*/
+typedef struct {
+	CO_CONST CO_OBJECT_DESC_T *pDesc;	/**< object description */
+	UNSIGNED16	index;				/**< object index */
+	UNSIGNED8	subIndex;			/**< subindex */
+} CO_OD_HANDLE_T;
+
+
 /* data variables from OD */
 typedef struct {
 	CO_CONST UNSIGNED8	 *odConst_u8;
@@ -267,6 +277,37 @@ EXTERN_DECL RET_T coOdPutObj_u64(UNSIGNED16 index,
 					UNSIGNED8 subIndex, UNSIGNED64 newVal);
 #endif /* CO_EXTENDED_DATA_TYPES */
 
+EXTERN_DECL RET_T coOdGetObjHandle(UNSIGNED16 index,
+					UNSIGNED8 subIndex, CO_OD_HANDLE_T *pHandle);
+EXTERN_DECL RET_T coOdGetObjH_u32(CO_CONST CO_OD_HANDLE_T *pHandle,
+					UNSIGNED32 *pObj);
+EXTERN_DECL RET_T coOdGetObjH_u16(CO_CONST CO_OD_HANDLE_T *pHandle,
+					UNSIGNED16 *pObj);
+EXTERN_DECL RET_T coOdGetObjH_u8(CO_CONST CO_OD_HANDLE_T *pHandle,
+					UNSIGNED8 *pObj);
+EXTERN_DECL RET_T coOdGetObjH_i32(CO_CONST CO_OD_HANDLE_T *pHandle,
+					INTEGER32 *pObj);
+EXTERN_DECL RET_T coOdGetObjH_i16(CO_CONST CO_OD_HANDLE_T *pHandle,
+					INTEGER16 *pObj);
+EXTERN_DECL RET_T coOdGetObjH_i8(CO_CONST CO_OD_HANDLE_T *pHandle,
+					INTEGER8 *pObj);
+EXTERN_DECL RET_T coOdGetObjH_r32(CO_CONST CO_OD_HANDLE_T *pHandle,
+					REAL32 *pObj);
+EXTERN_DECL RET_T coOdPutObjH_u32(CO_CONST CO_OD_HANDLE_T *pHandle,
+					UNSIGNED32 newVal);
+EXTERN_DECL RET_T coOdPutObjH_u16(CO_CONST CO_OD_HANDLE_T *pHandle,
+					UNSIGNED16 newVal);
+EXTERN_DECL RET_T coOdPutObjH_u8(CO_CONST CO_OD_HANDLE_T *pHandle,
+					UNSIGNED8 newVal);
+EXTERN_DECL RET_T coOdPutObjH_i32(CO_CONST CO_OD_HANDLE_T *pHandle,
+					INTEGER32 newVal);
+EXTERN_DECL RET_T coOdPutObjH_i16(CO_CONST CO_OD_HANDLE_T *pHandle,
+					INTEGER16 newVal);
+EXTERN_DECL RET_T coOdPutObjH_i8(CO_CONST CO_OD_HANDLE_T *pHandle,
+					INTEGER8 newVal);
+EXTERN_DECL RET_T coOdPutObjH_r32(CO_CONST CO_OD_HANDLE_T *pHandle,
+					REAL32 newVal);
+
 EXTERN_DECL void *coOdGetObjAddr(UNSIGNED16 index,
 					UNSIGNED8 subIndex);
 EXTERN_DECL CO_CONST void *coOdGetObjAddrR(UNSIGNED16 index,
@@ -110,6 +110,8 @@ EXTERN_DECL RET_T coPdoReqObj(UNSIGNED16 index,
 
 EXTERN_DECL BOOL_T coPdoObjIsMapped(UNSIGNED16 pdoNr,
 				UNSIGNED16 index, UNSIGNED8 subIndex);
+EXTERN_DECL RET_T coPdoGetTrData(UNSIGNED16 pdoNr, UNSIGNED8 pData[],
+				BOOL_T packProg);
 
 EXTERN_DECL RET_T coMPdoReq(UNSIGNED16 pdoNr, UNSIGNED8 dstNode,
 				UNSIGNED16 index, UNSIGNED8 subIndex, UNSIGNED8 flags);
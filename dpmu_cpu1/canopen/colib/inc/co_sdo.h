@@ -79,6 +79,16 @@ typedef RET_T(*CO_EVENT_SDO_SERVER_DOMAIN_READ_T)(UNSIGNED16, UNSIGNED8, UNSIGNE
 typedef void(*CO_EVENT_SDO_SERVER_DOMAIN_READ_T)(UNSIGNED16, UNSIGNED8, UNSIGNED32, UNSIGNED32);
 #endif /* CO_SDO_SPLIT_INDICATION */
 
+/** \brief function pointer to SDO server read domain finished event
+* \param index - object index
+* \param subindex - object subindex
+* \param transferSize - overall transfered size
+* \param result - RET_OK if all data was sent, else the abort reason
+*
+* \return void
+*/
+typedef void(*CO_EVENT_SDO_SERVER_DOMAIN_READ_FINISHED_T)(UNSIGNED16, UNSIGNED8, UNSIGNED32, RET_T);
+
 /** \brief function pointer to SDO client read event
  * \param sdoNr - sdo number
  * \param index - object index
@@ -125,6 +135,7 @@ EXTERN_DECL RET_T coEventRegister_SDO_SERVER_WRITE(CO_EVENT_SDO_SERVER_T pFuncti
 EXTERN_DECL RET_T coEventRegister_SDO_SERVER_CHECK_WRITE(CO_EVENT_SDO_SERVER_CHECK_WRITE_T pFunction);
 EXTERN_DECL RET_T coEventRegister_SDO_SERVER_DOMAIN_WRITE(CO_EVENT_SDO_SERVER_DOMAIN_WRITE_T pFunction);
 EXTERN_DECL RET_T coEventRegister_SDO_SERVER_DOMAIN_READ(CO_EVENT_SDO_SERVER_DOMAIN_READ_T pFunction);
+EXTERN_DECL RET_T coEventRegister_SDO_SERVER_DOMAIN_READ_FINISHED(CO_EVENT_SDO_SERVER_DOMAIN_READ_FINISHED_T pFunction);
 
 EXTERN_DECL RET_T coSdoClientInit(UNSIGNED8);
 EXTERN_DECL RET_T coSdoRead(UNSIGNED8 sdoNr, UNSIGNED16 index,
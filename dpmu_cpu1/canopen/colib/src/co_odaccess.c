@@ -534,26 +534,59 @@ CO_CONST UNSIGNED8	*pAddr;
 
 /***************************************************************************/
 /**
-* \brief coOdGetObj_u8 - get UNSIGNED8 object
+* \brief coOdGetObjHandle - get handle of an object
 *
-* Get an object from the object dictionary from type UNSIGNED8.
+* Looks up an object once, the handle can then be used with the
+* coOdGetObjH_xx and coOdPutObjH_xx functions for repeated accesses
+* without searching the object dictionary again.
+* The handle stays valid as long as the object dictionary is not changed,
+* if the object is not found, the handle is cleared and accesses by it fail.
 *
 * \return RET_T
 *
 */
-RET_T coOdGetObj_u8(
+RET_T coOdGetObjHandle(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		UNSIGNED8		*pObj		/**< pointer to object */
+		CO_OD_HANDLE_T	*pHandle	/**< pointer to handle */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
 RET_T	retVal;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjDescPtr(index, subIndex, &pHandle->pDesc);
 	if (retVal != RET_OK)  {
+		pHandle->pDesc = NULL;
 		return(retVal);
 	}
+	pHandle->index = index;
+	pHandle->subIndex = subIndex;
+
+	return(RET_OK);
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdGetObjH_u8 - get UNSIGNED8 object by handle
+*
+* Get an object from the object dictionary from type UNSIGNED8,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdGetObjH_u8(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		UNSIGNED8		*pObj		/**< pointer to object */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
 
 	switch (pDesc->dType)  {
 		case CO_DTYPE_BOOL_CONST:
@@ -589,27 +622,54 @@ RET_T	retVal;
 
 /***************************************************************************/
 /**
-* \brief coOdGetObj_u16 - get UNSIGNED16 object
+* \brief coOdGetObj_u8 - get UNSIGNED8 object
 *
-* Get an object from the object dictionary from type UNSIGNED16.
+* Get an object from the object dictionary from type UNSIGNED8.
 *
 * \return RET_T
 *
 */
-RET_T coOdGetObj_u16(
+RET_T coOdGetObj_u8(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		UNSIGNED16		*pObj		/**< pointer to object */
+		UNSIGNED8		*pObj		/**< pointer to object */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdGetObjH_u8(&handle, pObj));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdGetObjH_u16 - get UNSIGNED16 object by handle
+*
+* Get an object from the object dictionary from type UNSIGNED16,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdGetObjH_u16(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		UNSIGNED16		*pObj		/**< pointer to object */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_U16_CONST:
 		case CO_DTYPE_U16_VAR:
@@ -635,27 +695,54 @@ RET_T	retVal;
 
 /***************************************************************************/
 /**
-* \brief coOdGetObj_u32 - get UNSIGNED32 object
+* \brief coOdGetObj_u16 - get UNSIGNED16 object
 *
-* Get an object from the object dictionary from type UNSIGNED32.
+* Get an object from the object dictionary from type UNSIGNED16.
 *
 * \return RET_T
 *
 */
-RET_T coOdGetObj_u32(
+RET_T coOdGetObj_u16(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		UNSIGNED32		*pObj		/**< pointer to object */
+		UNSIGNED16		*pObj		/**< pointer to object */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
 
-	retVal = coOdGetObjDescPtr(index, subIndex, &pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdGetObjH_u16(&handle, pObj));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdGetObjH_u32 - get UNSIGNED32 object by handle
+*
+* Get an object from the object dictionary from type UNSIGNED32,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdGetObjH_u32(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		UNSIGNED32		*pObj		/**< pointer to object */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_U32_CONST:
 		case CO_DTYPE_U32_VAR:
@@ -687,6 +774,33 @@ RET_T	retVal;
 }
 
 
+/***************************************************************************/
+/**
+* \brief coOdGetObj_u32 - get UNSIGNED32 object
+*
+* Get an object from the object dictionary from type UNSIGNED32.
+*
+* \return RET_T
+*
+*/
+RET_T coOdGetObj_u32(
+		UNSIGNED16		index,		/**< index of object */
+		UNSIGNED8		subIndex,	/**< subindex of object */
+		UNSIGNED32		*pObj		/**< pointer to object */
+	)
+{
+CO_OD_HANDLE_T	handle;
+RET_T	retVal;
+
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
+	if (retVal != RET_OK)  {
+		return(retVal);
+	}
+
+	return(coOdGetObjH_u32(&handle, pObj));
+}
+
+
 #ifdef CO_EXTENDED_DATA_TYPES
 /***************************************************************************/
 /**
@@ -847,25 +961,25 @@ RET_T	retVal;
 
 /***************************************************************************/
 /**
-* \brief coOdGetObj_i8 - get INTEGER8 object
+* \brief coOdGetObjH_i8 - get INTEGER8 object by handle
 *
-* Get an object from the object dictionary from type INTEGER8.
+* Get an object from the object dictionary from type INTEGER8,
+* using a handle from coOdGetObjHandle() instead of searching.
 *
 * \return RET_T
 *
 */
-RET_T coOdGetObj_i8(
-		UNSIGNED16		index,		/**< index of object */
-		UNSIGNED8		subIndex,	/**< subindex of object */
+RET_T coOdGetObjH_i8(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
 		INTEGER8		*pObj		/**< pointer to object */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED8	subIndex = pHandle->subIndex;
 RET_T	retVal;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
-	if (retVal != RET_OK)  {
-		return(retVal);
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
 	}
 
 	switch (pDesc->dType)  {
@@ -886,27 +1000,54 @@ RET_T	retVal;
 
 /***************************************************************************/
 /**
-* \brief coOdGetObj_i16 - get INTEGER16 object
+* \brief coOdGetObj_i8 - get INTEGER8 object
 *
-* Get an object from the object dictionary from type INTEGER16.
+* Get an object from the object dictionary from type INTEGER8.
 *
 * \return RET_T
 *
 */
-RET_T coOdGetObj_i16(
+RET_T coOdGetObj_i8(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		INTEGER16		*pObj		/**< pointer to object */
+		INTEGER8		*pObj		/**< pointer to object */
 	)
 {
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
-CO_CONST CO_OBJECT_DESC_T *pDesc;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdGetObjH_i8(&handle, pObj));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdGetObjH_i16 - get INTEGER16 object by handle
+*
+* Get an object from the object dictionary from type INTEGER16,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdGetObjH_i16(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		INTEGER16		*pObj		/**< pointer to object */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_I16_VAR:
 		case CO_DTYPE_I16_PTR:
@@ -924,27 +1065,54 @@ CO_CONST CO_OBJECT_DESC_T *pDesc;
 
 /***************************************************************************/
 /**
-* \brief coOdGetObj_i32 - get INTEGER32 object
+* \brief coOdGetObj_i16 - get INTEGER16 object
 *
-* Get an object from the object dictionary from type INTEGER32.
+* Get an object from the object dictionary from type INTEGER16.
 *
 * \return RET_T
 *
 */
-RET_T coOdGetObj_i32(
+RET_T coOdGetObj_i16(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		INTEGER32		*pObj		/**< pointer to object */
+		INTEGER16		*pObj		/**< pointer to object */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdGetObjH_i16(&handle, pObj));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdGetObjH_i32 - get INTEGER32 object by handle
+*
+* Get an object from the object dictionary from type INTEGER32,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdGetObjH_i32(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		INTEGER32		*pObj		/**< pointer to object */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_I32_VAR:
 		case CO_DTYPE_I32_PTR:
@@ -960,31 +1128,58 @@ RET_T	retVal;
 }
 
 
-#ifdef CO_BOOTLOADER_MODE
-#else /* CO_BOOTLOADER_MODE */
 /***************************************************************************/
 /**
-* \brief coOdGetObj_r32 - get REAL32 object
+* \brief coOdGetObj_i32 - get INTEGER32 object
 *
-* Get an object from the object dictionary from type REAL32.
+* Get an object from the object dictionary from type INTEGER32.
 *
 * \return RET_T
 *
 */
-RET_T coOdGetObj_r32(
+RET_T coOdGetObj_i32(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		REAL32			*pObj		/**< pointer to object */
+		INTEGER32		*pObj		/**< pointer to object */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdGetObjH_i32(&handle, pObj));
+}
+
+
+#ifdef CO_BOOTLOADER_MODE
+#else /* CO_BOOTLOADER_MODE */
+/***************************************************************************/
+/**
+* \brief coOdGetObjH_r32 - get REAL32 object by handle
+*
+* Get an object from the object dictionary from type REAL32,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdGetObjH_r32(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		REAL32			*pObj		/**< pointer to object */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_R32_VAR:
 		case CO_DTYPE_R32_PTR:
@@ -998,33 +1193,61 @@ RET_T	retVal;
 
 	return(retVal);
 }
-#endif /* CO_BOOTLOADER_MODE */
 
 
 /***************************************************************************/
 /**
-* \brief coOdPutObj_u8 - put UNSIGNED8 value to object
+* \brief coOdGetObj_r32 - get REAL32 object
 *
-* Put value from type UNSIGNED8 to the object dictionary
+* Get an object from the object dictionary from type REAL32.
 *
 * \return RET_T
 *
 */
-RET_T coOdPutObj_u8(
+RET_T coOdGetObj_r32(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		UNSIGNED8		newVal		/**< new value */
+		REAL32			*pObj		/**< pointer to object */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
-BOOL_T	changed = CO_FALSE;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdGetObjH_r32(&handle, pObj));
+}
+#endif /* CO_BOOTLOADER_MODE */
+
+
+/***************************************************************************/
+/**
+* \brief coOdPutObjH_u8 - put UNSIGNED8 object by handle
+*
+* Put value from type UNSIGNED8 to the object dictionary,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdPutObjH_u8(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		UNSIGNED8		newVal		/**< new value */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED16	index = pHandle->index;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+BOOL_T	changed = CO_FALSE;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_BOOL_VAR:
 		case CO_DTYPE_BOOL_PTR:
@@ -1068,28 +1291,56 @@ BOOL_T	changed = CO_FALSE;
 
 /***************************************************************************/
 /**
-* \brief coOdPutObj_u16 - put UNSIGNED16 value to object
+* \brief coOdPutObj_u8 - put UNSIGNED8 value to object
 *
-* Put value from type UNSIGNED16 to the object dictionary
+* Put value from type UNSIGNED8 to the object dictionary
 *
 * \return RET_T
 *
 */
-RET_T coOdPutObj_u16(
+RET_T coOdPutObj_u8(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		UNSIGNED16		newVal		/**< new value */
+		UNSIGNED8		newVal		/**< new value */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
-BOOL_T	changed = CO_FALSE;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdPutObjH_u8(&handle, newVal));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdPutObjH_u16 - put UNSIGNED16 object by handle
+*
+* Put value from type UNSIGNED16 to the object dictionary,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdPutObjH_u16(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		UNSIGNED16		newVal		/**< new value */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED16	index = pHandle->index;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+BOOL_T	changed = CO_FALSE;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_U16_VAR:
 		case CO_DTYPE_U16_PTR:
@@ -1124,28 +1375,56 @@ BOOL_T	changed = CO_FALSE;
 
 /***************************************************************************/
 /**
-* \brief coOdPutObj_u32 - put UNSIGNED32 value to object
+* \brief coOdPutObj_u16 - put UNSIGNED16 value to object
 *
-* Put value from type UNSIGNED32 to the object dictionary
+* Put value from type UNSIGNED16 to the object dictionary
 *
 * \return RET_T
 *
 */
-RET_T coOdPutObj_u32(
+RET_T coOdPutObj_u16(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		UNSIGNED32		newVal		/**< new value */
+		UNSIGNED16		newVal		/**< new value */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
-BOOL_T	changed = CO_FALSE;
 
-	retVal = coOdGetObjDescPtr(index, subIndex, &pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdPutObjH_u16(&handle, newVal));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdPutObjH_u32 - put UNSIGNED32 object by handle
+*
+* Put value from type UNSIGNED32 to the object dictionary,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdPutObjH_u32(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		UNSIGNED32		newVal		/**< new value */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED16	index = pHandle->index;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+BOOL_T	changed = CO_FALSE;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_U32_VAR:
 		case CO_DTYPE_U32_PTR:
@@ -1187,28 +1466,56 @@ BOOL_T	changed = CO_FALSE;
 
 /***************************************************************************/
 /**
-* \brief coOdPutObj_i8 - Put INTEGER8 object
+* \brief coOdPutObj_u32 - put UNSIGNED32 value to object
 *
-* Put value from type INTEGER8 to the object dictionary
+* Put value from type UNSIGNED32 to the object dictionary
 *
 * \return RET_T
 *
 */
-RET_T coOdPutObj_i8(
+RET_T coOdPutObj_u32(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		INTEGER8		newVal		/**< new value */
+		UNSIGNED32		newVal		/**< new value */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
-BOOL_T	changed = CO_FALSE;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdPutObjH_u32(&handle, newVal));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdPutObjH_i8 - put INTEGER8 object by handle
+*
+* Put value from type INTEGER8 to the object dictionary,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdPutObjH_i8(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		INTEGER8		newVal		/**< new value */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED16	index = pHandle->index;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+BOOL_T	changed = CO_FALSE;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_I8_VAR:
 		case CO_DTYPE_I8_PTR:
@@ -1229,28 +1536,56 @@ BOOL_T	changed = CO_FALSE;
 
 /***************************************************************************/
 /**
-* \brief coOdPutObj_i16 - Put INTEGER16 object
+* \brief coOdPutObj_i8 - Put INTEGER8 object
 *
-* Put value from type INTEGER16 to the object dictionary
+* Put value from type INTEGER8 to the object dictionary
 *
 * \return RET_T
 *
 */
-RET_T coOdPutObj_i16(
+RET_T coOdPutObj_i8(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		INTEGER16		newVal		/**< new value */
+		INTEGER8		newVal		/**< new value */
 	)
 {
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
-CO_CONST CO_OBJECT_DESC_T *pDesc;
-BOOL_T	changed = CO_FALSE;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdPutObjH_i8(&handle, newVal));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdPutObjH_i16 - put INTEGER16 object by handle
+*
+* Put value from type INTEGER16 to the object dictionary,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdPutObjH_i16(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		INTEGER16		newVal		/**< new value */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED16	index = pHandle->index;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+BOOL_T	changed = CO_FALSE;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_I16_VAR:
 		case CO_DTYPE_I16_PTR:
@@ -1271,28 +1606,56 @@ BOOL_T	changed = CO_FALSE;
 
 /***************************************************************************/
 /**
-* \brief coOdPutObj_i32 - Put INTEGER32 object
+* \brief coOdPutObj_i16 - Put INTEGER16 object
 *
-* Put value from type INTEGER32 to the object dictionary
+* Put value from type INTEGER16 to the object dictionary
 *
 * \return RET_T
 *
 */
-RET_T coOdPutObj_i32(
+RET_T coOdPutObj_i16(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		INTEGER32		newVal		/**< new value */
+		INTEGER16		newVal		/**< new value */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
-BOOL_T	changed = CO_FALSE;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdPutObjH_i16(&handle, newVal));
+}
+
+
+/***************************************************************************/
+/**
+* \brief coOdPutObjH_i32 - put INTEGER32 object by handle
+*
+* Put value from type INTEGER32 to the object dictionary,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdPutObjH_i32(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		INTEGER32		newVal		/**< new value */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED16	index = pHandle->index;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+BOOL_T	changed = CO_FALSE;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_I32_VAR:
 		case CO_DTYPE_I32_PTR:
@@ -1312,32 +1675,60 @@ BOOL_T	changed = CO_FALSE;
 }
 
 
-#ifdef CO_BOOTLOADER_MODE
-#else /* CO_BOOTLOADER_MODE */
 /***************************************************************************/
 /**
-* \brief coOdPutObj_r32 - Put REAL32 object
+* \brief coOdPutObj_i32 - Put INTEGER32 object
 *
-* Put value from type REAL32 to the object dictionary
+* Put value from type INTEGER32 to the object dictionary
 *
 * \return RET_T
 *
 */
-RET_T coOdPutObj_r32(
+RET_T coOdPutObj_i32(
 		UNSIGNED16		index,		/**< index of object */
 		UNSIGNED8		subIndex,	/**< subindex of object */
-		REAL32			newVal		/**< new value */
+		INTEGER32		newVal		/**< new value */
 	)
 {
-CO_CONST CO_OBJECT_DESC_T *pDesc;
+CO_OD_HANDLE_T	handle;
 RET_T	retVal;
-BOOL_T	changed = CO_FALSE;
 
-	retVal = coOdGetObjDescPtr(index, subIndex,	&pDesc);
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
 	if (retVal != RET_OK)  {
 		return(retVal);
 	}
 
+	return(coOdPutObjH_i32(&handle, newVal));
+}
+
+
+#ifdef CO_BOOTLOADER_MODE
+#else /* CO_BOOTLOADER_MODE */
+/***************************************************************************/
+/**
+* \brief coOdPutObjH_r32 - put REAL32 object by handle
+*
+* Put value from type REAL32 to the object dictionary,
+* using a handle from coOdGetObjHandle() instead of searching.
+*
+* \return RET_T
+*
+*/
+RET_T coOdPutObjH_r32(
+		CO_CONST CO_OD_HANDLE_T *pHandle,	/**< handle of object */
+		REAL32			newVal		/**< new value */
+	)
+{
+CO_CONST CO_OBJECT_DESC_T *pDesc = pHandle->pDesc;
+UNSIGNED16	index = pHandle->index;
+UNSIGNED8	subIndex = pHandle->subIndex;
+RET_T	retVal;
+BOOL_T	changed = CO_FALSE;
+
+	if (pDesc == NULL)  {
+		return(RET_IDX_NOT_FOUND);
+	}
+
 	switch (pDesc->dType)  {
 		case CO_DTYPE_R32_VAR:
 		case CO_DTYPE_R32_PTR:
@@ -1355,6 +1746,33 @@ BOOL_T	changed = CO_FALSE;
 
 	return(retVal);
 }
+
+
+/***************************************************************************/
+/**
+* \brief coOdPutObj_r32 - Put REAL32 object
+*
+* Put value from type REAL32 to the object dictionary
+*
+* \return RET_T
+*
+*/
+RET_T coOdPutObj_r32(
+		UNSIGNED16		index,		/**< index of object */
+		UNSIGNED8		subIndex,	/**< subindex of object */
+		REAL32			newVal		/**< new value */
+	)
+{
+CO_OD_HANDLE_T	handle;
+RET_T	retVal;
+
+	retVal = coOdGetObjHandle(index, subIndex, &handle);
+	if (retVal != RET_OK)  {
+		return(retVal);
+	}
+
+	return(coOdPutObjH_r32(&handle, newVal));
+}
 #endif /* CO_BOOTLOADER_MODE */
 
 
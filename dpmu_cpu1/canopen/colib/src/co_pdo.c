@@ -105,6 +105,11 @@ static CO_INLINE CO_REC_PDO_T *getReceivePdo(UNSIGNED16 idx);
 static UNSIGNED8 checkRecPdoMappingTable(
 		CO_REC_PDO_T *pPdo, UNSIGNED8 mapCnt);
 static RET_T pdoReceiveData(UNSIGNED16 pdoIdx, CO_CONST UNSIGNED8 pData[]);
+# ifdef CO_PDO_PACK_PROG
+static void buildRecPackProg(CO_REC_PDO_T *pPdo);
+static CO_INLINE BOOL_T pdoUnpackWords(void *pVar, CO_CONST UNSIGNED8 pData[],
+		CO_CONST CO_PDO_PACK_STEP_T *pStep);
+# endif /* CO_PDO_PACK_PROG */
 static void stopRecPdoTimer(const CO_REC_PDO_T *pPdo);
 static void pdoReceiveEventTimer(void *ptr);
 # ifdef CO_EVENT_PDO
@@ -119,6 +124,13 @@ static UNSIGNED8 checkTrPdoMappingTable(CO_TR_PDO_T *pPdo,
 static RET_T setupTrPdoTimer(CO_TR_PDO_T *pPdo);
 static void pdoEventTimer(void *ptr);
 static RET_T pdoTransmitData(CO_CONST CO_TR_PDO_T *pPdo, UNSIGNED8 flags);
+static void pdoFillData(CO_CONST CO_TR_PDO_T *pPdo, UNSIGNED8 trData[],
+		BOOL_T packProg);
+# ifdef CO_PDO_PACK_PROG
+static void buildTrPackProg(CO_TR_PDO_T *pPdo);
+static CO_INLINE void pdoPackWords(UNSIGNED8 trData[], CO_CONST void *pVar,
+		CO_CONST CO_PDO_PACK_STEP_T *pStep);
+# endif /* CO_PDO_PACK_PROG */
 #endif /* CO_PDO_TRANSMIT_CNT */
 #ifdef CO_TR_PDO_DYN_MAP_ENTRIES
 static UNSIGNED16 createPdoTrMapTable(UNSIGNED16 index);
@@ -129,6 +141,10 @@ static UNSIGNED16 createPdoRecMapTable(UNSIGNED16 index);
 static RET_T setupPdoRecMapTable(UNSIGNED16 mapTableIdx, UNSIGNED16 index);
 #endif /* CO_REC_PDO_DYN_MAP_ENTRIES */
 static RET_T setPdoCob(COB_REFERENZ_T cobRef, UNSIGNED32 cobId, UNSIGNED8 len);
+#ifdef CO_PDO_PACK_PROG
+static void pdoPackStep(CO_PDO_PACK_STEP_T *pStep, UNSIGNED16 offs,
+		UNSIGNED8 len, BOOL_T numeric);
+#endif /* CO_PDO_PACK_PROG */
 
 /* external variables
 ---------------------------------------------------------------------------*/
@@ -370,13 +386,6 @@ static RET_T pdoTransmitData(
 {
 RET_T	retVal;
 UNSIGNED8	trData[CO_CAN_MAX_DATA_LEN];	/* data */
-UNSIGNED8	cnt;
-UNSIGNED8	offs;
-# ifdef CO_EVENT_PDO_UPDATE_CNT
-UNSIGNED16	index;
-UNSIGNED8	subIndex;
-UNSIGNED8	utCnt;
-# endif /* CO_EVENT_PDO_UPDATE_CNT */
 
 #ifdef CO_MPDO_PRODUCER
 	/* MPDO are not allowed to send with this function */
@@ -389,7 +398,48 @@ UNSIGNED8	utCnt;
 		return(RET_MAP_LEN_ERROR);
 	}
 
-	memset(&trData[0], 0, sizeof(trData));
+	pdoFillData(pPdo, &trData[0], CO_TRUE);
+
+	/* transmit data */
+	retVal = icoTransmitMessage(pPdo->cob, &trData[0], flags);
+
+	return(retVal);
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief pdoFillData - copy mapped objects to the PDO data
+*
+* Byte aligned numeric objects are copied by the pack program
+* of the PDO, if packProg is CO_TRUE,
+* all other objects by coNumMemcpyUnpack().
+*
+* \return none
+*
+*/
+static void pdoFillData(
+		CO_CONST CO_TR_PDO_T		*pPdo,		/* pointer to pdo */
+		UNSIGNED8		trData[],	/* CO_CAN_MAX_DATA_LEN bytes */
+		BOOL_T			packProg	/* use pack program */
+	)
+{
+UNSIGNED8	cnt;
+UNSIGNED8	offs;
+# ifdef CO_EVENT_PDO_UPDATE_CNT
+UNSIGNED16	index;
+UNSIGNED8	subIndex;
+UNSIGNED8	utCnt;
+# endif /* CO_EVENT_PDO_UPDATE_CNT */
+
+#ifdef CO_PDO_PACK_PROG
+#else /* CO_PDO_PACK_PROG */
+	(void)packProg;
+#endif /* CO_PDO_PACK_PROG */
+
+	memset(&trData[0], 0, CO_CAN_MAX_DATA_LEN);
 
 	offs = 0u;
 
@@ -416,6 +466,19 @@ UNSIGNED8	utCnt;
 # endif /* CO_DYNAMIC_OD_PTR_REFRESH */
 #endif /* CO_DYNAMIC_OBJDIC */
 
+#ifdef CO_PDO_PACK_PROG
+		if ((packProg == CO_TRUE) && (cnt < pPdo->packProg.stepCnt)
+		 && (pPdo->packProg.step[cnt].op != (UNSIGNED8)CO_PDO_PACK_GENERIC))  {
+			/* byte aligned numeric value, copy word by word */
+			/* lock OD */
+			CO_OS_LOCK_OD
+			pdoPackWords(&trData[0],
+				pPdo->mapTableConst->mapEntry[cnt].pVar,
+				&pPdo->packProg.step[cnt]);
+			/* unlock OD */
+			CO_OS_UNLOCK_OD
+		} else
+#endif /* CO_PDO_PACK_PROG */
 #ifdef CO_PDO_BIT_MAPPING
 		/* byte order? */
 		if (((offs % 8u) == 0u)
@@ -461,25 +524,151 @@ UNSIGNED8	utCnt;
 			}
 		}
 #else /* CO_PDO_BIT_MAPPING */
-		/* lock OD */
-		CO_OS_LOCK_OD
-		/* numeric value ? */
-		coNumMemcpyUnpack(&trData[offs],
-			pPdo->mapTableConst->mapEntry[cnt].pVar,
-			(UNSIGNED32)pPdo->mapTableConst->mapEntry[cnt].len,
-			(UNSIGNED16)pPdo->mapTableConst->mapEntry[cnt].numeric, 0u);
-		/* unlock OD */
-		CO_OS_UNLOCK_OD
+		{
+			/* lock OD */
+			CO_OS_LOCK_OD
+			/* numeric value ? */
+			coNumMemcpyUnpack(&trData[offs],
+				pPdo->mapTableConst->mapEntry[cnt].pVar,
+				(UNSIGNED32)pPdo->mapTableConst->mapEntry[cnt].len,
+				(UNSIGNED16)pPdo->mapTableConst->mapEntry[cnt].numeric, 0u);
+			/* unlock OD */
+			CO_OS_UNLOCK_OD
+		}
 #endif /* CO_PDO_BIT_MAPPING */
 
 		offs += pPdo->mapTableConst->mapEntry[cnt].len;
 	}
 
-	/* transmit data */
-	retVal = icoTransmitMessage(pPdo->cob, &trData[0], flags);
+	return;
+}
 
-	return(retVal);
+
+/***************************************************************************/
+/**
+* \brief coPdoGetTrData - get the data of a transmit PDO
+*
+* This function copies all mapped objects of a transmit PDO
+* into pData, as they would be transmitted, but doesn't transmit it.
+* With packProg == CO_FALSE the objects are copied byte by byte only,
+* so it can be used to check and time the word wise pack program.
+*
+* \return RET_T
+* \retval RET_INVALID_PARAMETER
+*	unknown PDO number
+* \retval RET_MAP_LEN_ERROR
+*	PDO has no mapping
+* \retval RET_OK
+*	data are valid
+*
+*/
+RET_T coPdoGetTrData(
+		UNSIGNED16		pdoNr,		/* PDO number */
+		UNSIGNED8		pData[],	/* CO_CAN_MAX_DATA_LEN bytes */
+		BOOL_T			packProg	/* use pack program */
+	)
+{
+CO_TR_PDO_T	*pPdo;
+
+	pPdo = icoPdoSearchTransmitPdo(pdoNr);
+	if (pPdo == NULL)  {
+		return(RET_INVALID_PARAMETER);
+	}
+
+#ifdef CO_MPDO_PRODUCER
+	if (pPdo->pdoType != CO_PDO_TYPE_STD)  {
+		return(RET_PARAMETER_INCOMPATIBLE);
+	}
+#endif /* CO_MPDO_PRODUCER */
+	if (pPdo->mapTableConst->mapCnt == 0u)  {
+		return(RET_MAP_LEN_ERROR);
+	}
+
+	pdoFillData(pPdo, pData, packProg);
+
+	return(RET_OK);
+}
+
+
+#ifdef CO_PDO_PACK_PROG
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief pdoPackWords - copy a byte aligned numeric object to PDO data
+*
+* The low byte of each word is transmitted first.
+*
+* \return none
+*
+*/
+static CO_INLINE void pdoPackWords(
+		UNSIGNED8		trData[],	/* PDO data */
+		CO_CONST void	*pVar,		/* object */
+		CO_CONST CO_PDO_PACK_STEP_T	*pStep	/* pack step */
+	)
+{
+CO_CONST UNSIGNED16	*pWord = (CO_CONST UNSIGNED16 *)pVar;
+UNSIGNED8	*pDest = &trData[pStep->offs];
+UNSIGNED8	len;
+
+	switch (pStep->op)  {
+		case CO_PDO_PACK_U8:
+			pDest[0] = (UNSIGNED8)(pWord[0] & 0xffu);
+			break;
+		case CO_PDO_PACK_U16:
+			pDest[0] = (UNSIGNED8)(pWord[0] & 0xffu);
+			pDest[1] = (UNSIGNED8)(pWord[0] >> 8u);
+			break;
+		case CO_PDO_PACK_U32:
+			pDest[0] = (UNSIGNED8)(pWord[0] & 0xffu);
+			pDest[1] = (UNSIGNED8)(pWord[0] >> 8u);
+			pDest[2] = (UNSIGNED8)(pWord[1] & 0xffu);
+			pDest[3] = (UNSIGNED8)(pWord[1] >> 8u);
+			break;
+		default:
+			len = pStep->len;
+			while (len >= 2u)  {
+				pDest[0] = (UNSIGNED8)(*pWord & 0xffu);
+				pDest[1] = (UNSIGNED8)(*pWord >> 8u);
+				pDest += 2u;
+				pWord++;
+				len -= 2u;
+			}
+			if (len != 0u)  {
+				pDest[0] = (UNSIGNED8)(*pWord & 0xffu);
+			}
+			break;
+	}
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief buildTrPackProg - compile the mapping of a transmit PDO
+*
+* \return none
+*
+*/
+static void buildTrPackProg(
+		CO_TR_PDO_T		*pPdo	/* pointer to pdo */
+	)
+{
+UNSIGNED8	cnt;
+UNSIGNED16	offs = 0u;
+
+	for (cnt = 0u; (cnt < pPdo->mapTableConst->mapCnt)
+			&& (cnt < CO_MAX_MAP_ENTRIES); cnt++)  {
+		pdoPackStep(&pPdo->packProg.step[cnt], offs,
+			pPdo->mapTableConst->mapEntry[cnt].len,
+			pPdo->mapTableConst->mapEntry[cnt].numeric);
+		offs += pPdo->mapTableConst->mapEntry[cnt].len;
+	}
+	pPdo->packProg.stepCnt = cnt;
 }
+#endif /* CO_PDO_PACK_PROG */
 
 
 /***************************************************************************/
@@ -698,6 +887,19 @@ BOOL_T		changed;
 		/* not for dummy mapping */
 		if (pRecPdo->mapTableConst->mapEntry[cnt].pVar != NULL)  {
 
+#ifdef CO_PDO_PACK_PROG
+			if ((cnt < pRecPdo->packProg.stepCnt)
+			 && (pRecPdo->packProg.step[cnt].op != (UNSIGNED8)CO_PDO_PACK_GENERIC))  {
+				/* byte aligned numeric value, copy word by word */
+				/* lock OD */
+				CO_OS_LOCK_OD
+				changed = pdoUnpackWords(
+					pRecPdo->mapTableConst->mapEntry[cnt].pVar,
+					&pData[0], &pRecPdo->packProg.step[cnt]);
+				/* unlock OD */
+				CO_OS_UNLOCK_OD
+			} else
+#endif /* CO_PDO_PACK_PROG */
 #ifdef CO_PDO_BIT_MAPPING
 			/* byte order? */
 			if (((offs % 8u) == 0u)
@@ -748,25 +950,26 @@ BOOL_T		changed;
 				CO_OS_UNLOCK_OD
 			}
 #else /* CO_PDO_BIT_MAPPING */
-
+			{
 #ifdef CO_DYNAMIC_OBJDIC
 # ifdef CO_DYNAMIC_OD_PTR_REFRESH
-			/* update address again for get/set OD */
-			pRecPdo->mapTable->mapEntry[cnt].pVar = 
-				coOdGetObjAddr(
-				pRecPdo->mapTableConst->mapEntry[cnt].val >> 16,
-				(pRecPdo->mapTableConst->mapEntry[cnt].val >> 8) & 0xff);
+				/* update address again for get/set OD */
+				pRecPdo->mapTable->mapEntry[cnt].pVar = 
+					coOdGetObjAddr(
+					pRecPdo->mapTableConst->mapEntry[cnt].val >> 16,
+					(pRecPdo->mapTableConst->mapEntry[cnt].val >> 8) & 0xff);
 # endif /* CO_DYNAMIC_OD_PTR_REFRESH */
 #endif /* CO_DYNAMIC_OBJDIC */
-			/* lock OD */
-			CO_OS_LOCK_OD
-			changed = coNumMemcpyPack(
-				pRecPdo->mapTableConst->mapEntry[cnt].pVar,
-				&pData[offs],
-				(UNSIGNED32)pRecPdo->mapTableConst->mapEntry[cnt].len,
-				(UNSIGNED16)pRecPdo->mapTableConst->mapEntry[cnt].numeric, 0u);
-			/* unlock OD */
-			CO_OS_UNLOCK_OD
+				/* lock OD */
+				CO_OS_LOCK_OD
+				changed = coNumMemcpyPack(
+					pRecPdo->mapTableConst->mapEntry[cnt].pVar,
+					&pData[offs],
+					(UNSIGNED32)pRecPdo->mapTableConst->mapEntry[cnt].len,
+					(UNSIGNED16)pRecPdo->mapTableConst->mapEntry[cnt].numeric, 0u);
+				/* unlock OD */
+				CO_OS_UNLOCK_OD
+			}
 #endif /* CO_PDO_BIT_MAPPING */
 
 #ifdef CO_EVENT_OBJECT_CHANGED
@@ -797,6 +1000,102 @@ BOOL_T		changed;
 }
 
 
+#ifdef CO_PDO_PACK_PROG
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief pdoUnpackWords - copy PDO data to a byte aligned numeric object
+*
+* An odd length keeps the high byte of the last word.
+*
+* \return BOOL_T changed
+*
+*/
+static CO_INLINE BOOL_T pdoUnpackWords(
+		void			*pVar,		/* object */
+		CO_CONST UNSIGNED8	pData[],	/* PDO data */
+		CO_CONST CO_PDO_PACK_STEP_T	*pStep	/* pack step */
+	)
+{
+UNSIGNED16	*pWord = (UNSIGNED16 *)pVar;
+CO_CONST UNSIGNED8	*pSrc = &pData[pStep->offs];
+UNSIGNED16	w;
+UNSIGNED16	diff = 0u;
+UNSIGNED8	len;
+
+	switch (pStep->op)  {
+		case CO_PDO_PACK_U8:
+			w = (pWord[0] & 0xff00u) | (pSrc[0] & 0xffu);
+			diff = w ^ pWord[0];
+			pWord[0] = w;
+			break;
+		case CO_PDO_PACK_U16:
+			w = (pSrc[0] & 0xffu) | (UNSIGNED16)((UNSIGNED16)pSrc[1] << 8u);
+			diff = w ^ pWord[0];
+			pWord[0] = w;
+			break;
+		case CO_PDO_PACK_U32:
+			w = (pSrc[0] & 0xffu) | (UNSIGNED16)((UNSIGNED16)pSrc[1] << 8u);
+			diff = w ^ pWord[0];
+			pWord[0] = w;
+			w = (pSrc[2] & 0xffu) | (UNSIGNED16)((UNSIGNED16)pSrc[3] << 8u);
+			diff |= w ^ pWord[1];
+			pWord[1] = w;
+			break;
+		default:
+			len = pStep->len;
+			while (len >= 2u)  {
+				w = (pSrc[0] & 0xffu) | (UNSIGNED16)((UNSIGNED16)pSrc[1] << 8u);
+				diff |= w ^ *pWord;
+				*pWord = w;
+				pSrc += 2u;
+				pWord++;
+				len -= 2u;
+			}
+			if (len != 0u)  {
+				w = (*pWord & 0xff00u) | (pSrc[0] & 0xffu);
+				diff |= w ^ *pWord;
+				*pWord = w;
+			}
+			break;
+	}
+
+	if (diff != 0u)  {
+		return(CO_TRUE);
+	}
+	return(CO_FALSE);
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief buildRecPackProg - compile the mapping of a receive PDO
+*
+* \return none
+*
+*/
+static void buildRecPackProg(
+		CO_REC_PDO_T	*pPdo	/* pointer to pdo */
+	)
+{
+UNSIGNED8	cnt;
+UNSIGNED16	offs = 0u;
+
+	for (cnt = 0u; (cnt < pPdo->mapTableConst->mapCnt)
+			&& (cnt < CO_MAX_MAP_ENTRIES); cnt++)  {
+		pdoPackStep(&pPdo->packProg.step[cnt], offs,
+			pPdo->mapTableConst->mapEntry[cnt].len,
+			pPdo->mapTableConst->mapEntry[cnt].numeric);
+		offs += pPdo->mapTableConst->mapEntry[cnt].len;
+	}
+	pPdo->packProg.stepCnt = cnt;
+}
+#endif /* CO_PDO_PACK_PROG */
+
+
 /***************************************************************************/
 /**
 * \internal stopRecPdoTimer - stop receive timer
@@ -1446,6 +1745,11 @@ UNSIGNED32	entry;
 		return(RET_SDO_TRANSFER_NOT_SUPPORTED);
 	}
 
+# ifdef CO_PDO_PACK_PROG
+	/* use the generic copy until the mapping is compiled again */
+	pPdo->packProg.stepCnt = 0u;
+# endif /* CO_PDO_PACK_PROG */
+
 # ifdef CO_TR_PDO_DYN_MAP_ENTRIES
 	if (pPdo->dynMapping == CO_TRUE)  {
 		pMap = &mapTablesTrPDO[pPdo->mapTableIdx];
@@ -1468,6 +1772,10 @@ UNSIGNED32	entry;
 	}
 # endif /* CO_TR_PDO_DYN_MAP_ENTRIES */
 
+# ifdef CO_PDO_PACK_PROG
+	buildTrPackProg(pPdo);
+# endif /* CO_PDO_PACK_PROG */
+
 	return(retVal);
 }
 #endif /* CO_PDO_TRANSMIT_CNT */
@@ -1919,6 +2227,11 @@ CO_REC_PDO_T *pPdo;
 		return(RET_SDO_TRANSFER_NOT_SUPPORTED);
 	}
 
+# ifdef CO_PDO_PACK_PROG
+	/* use the generic copy until the mapping is compiled again */
+	pPdo->packProg.stepCnt = 0u;
+# endif /* CO_PDO_PACK_PROG */
+
 	if (pPdo->dynMapping == CO_TRUE)  {
 		pMap = &mapTablesRecPDO[pPdo->mapTableIdx];
 
@@ -1939,6 +2252,10 @@ CO_REC_PDO_T *pPdo;
 		}
 	}
 
+# ifdef CO_PDO_PACK_PROG
+	buildRecPackProg(pPdo);
+# endif /* CO_PDO_PACK_PROG */
+
 	return(retVal);
 }
 # endif /* CO_REC_PDO_DYN_MAP_ENTRIES */
@@ -2329,6 +2646,9 @@ PDO_TR_MAP_TABLE_T map;
 # endif /* CO_REC_PDO_DYN_MAP_ENTRIES */
 #endif /* CO_PDO_RECEIVE_CNT */
 
+#ifdef CO_PDO_PACK_PROG
+	buildTrPackProg(pPdo);
+#endif /* CO_PDO_PACK_PROG */
 
 	return(offs);
 }
@@ -2626,6 +2946,10 @@ PDO_REC_MAP_TABLE_T map;
 # ifdef CO_REC_PDO_DYN_MAP_ENTRIES
 # endif /* CO_REC_PDO_DYN_MAP_ENTRIES */
 
+# ifdef CO_PDO_PACK_PROG
+	buildRecPackProg(pPdo);
+# endif /* CO_PDO_PACK_PROG */
+
 	return(offs);
 }
 
@@ -2806,6 +3130,62 @@ RET_T	retVal;
 }
 
 
+#ifdef CO_PDO_PACK_PROG
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief pdoPackStep - compile one mapping entry
+*
+* Numeric objects starting and ending at a byte boundary
+* are copied word by word,
+* all others by the generic coNumMemcpyPack/Unpack().
+*
+* \return none
+*
+*/
+static void pdoPackStep(
+		CO_PDO_PACK_STEP_T	*pStep,		/* pack step */
+		UNSIGNED16		offs,			/* offset in the PDO */
+		UNSIGNED8		len,			/* length of the entry */
+		BOOL_T			numeric			/* numeric flag */
+	)
+{
+	pStep->op = (UNSIGNED8)CO_PDO_PACK_GENERIC;
+
+# ifdef CO_PDO_BIT_MAPPING
+	if (((offs % 8u) != 0u) || ((len % 8u) != 0u))  {
+		return;
+	}
+	offs >>= 3;
+	len >>= 3;
+# endif /* CO_PDO_BIT_MAPPING */
+
+	pStep->offs = (UNSIGNED8)offs;
+	pStep->len = len;
+	if ((numeric == CO_FALSE) || (len == 0u)
+	 || ((offs + len) > CO_PDO_MAX_DATA_LEN))  {
+		return;
+	}
+
+	switch (len)  {
+		case 1u:
+			pStep->op = (UNSIGNED8)CO_PDO_PACK_U8;
+			break;
+		case 2u:
+			pStep->op = (UNSIGNED8)CO_PDO_PACK_U16;
+			break;
+		case 4u:
+			pStep->op = (UNSIGNED8)CO_PDO_PACK_U32;
+			break;
+		default:
+			pStep->op = (UNSIGNED8)CO_PDO_PACK_WORDS;
+			break;
+	}
+}
+#endif /* CO_PDO_PACK_PROG */
+
+
 /***************************************************************************/
 /**
 * \internal
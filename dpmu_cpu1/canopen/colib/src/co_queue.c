@@ -35,6 +35,7 @@
 #include "ico_indication.h"
 #include "ico_cobhandler.h"
 #include "ico_queue.h"
+#include "ico_timer.h"
 #ifdef ISOTP_SUPPORTED
 # include "iiso_tp.h"
 #endif
@@ -42,6 +43,8 @@
 /* constant definitions
 ---------------------------------------------------------------------------*/
 #define CO_CONFIG_REC_BUFFER_SIZE (CO_CONFIG_REC_BUFFER_CNT * (sizeof(CO_RECBUF_HDR_T) + CO_CAN_MAX_DATA_LEN))
+/* one entry more than buffers, so a full ring can be told from an empty one */
+#define CO_TRANS_RING_CNT	(CO_CONFIG_TRANS_BUFFER_CNT + 1u)
 
 /* local defined data types
 ---------------------------------------------------------------------------*/
@@ -61,6 +64,15 @@ struct CO_TRANS_QUEUE {
 };
 typedef struct CO_TRANS_QUEUE CO_TRANS_QUEUE_T;
 
+/* queue state of a cob, indexed by the cob reference */
+typedef struct {
+	CO_TRANS_QUEUE_T	*pInhibitFirst;	/* oldest message waiting for inhibit */
+	CO_TRANS_QUEUE_T	*pInhibitLast;	/* newest message waiting for inhibit */
+	CO_TRANS_QUEUE_T	*pTransmitLast;	/* newest message at transmit ring */
+	UNSIGNED32			inhibitEnd;		/* inhibit tick the inhibit time ends */
+	UNSIGNED16			heapPos;		/* position at inhibit heap + 1, 0 - inhibit not active */
+} CO_COB_QUEUE_T;
+
 
 typedef struct {
 	UNSIGNED32			canId;		/* CAN identifier */
@@ -107,13 +119,20 @@ typedef struct {
 ---------------------------------------------------------------------------*/
 static CO_TRANS_QUEUE_T	*searchLastMessage(UNSIGNED16 cobRef, BOOL_T all);
 static CO_TRANS_QUEUE_T	*getNextTransBuf(void);
+static void freeTransBuf(CO_TRANS_QUEUE_T *pTrBuf);
+static void transQueueReset(void);
+static CO_COB_QUEUE_T *getCobQueue(COB_REFERENZ_T cobRef);
+static UNSIGNED16 nextRingIdx(UNSIGNED16 idx);
 static void inhibitTimer(void *pData);
+static void startInhibit(COB_REFERENZ_T cobRef, UNSIGNED16 inhibit);
+static void inhibitHeapFix(UNSIGNED16 pos);
+static void inhibitHeapRemoveFirst(void);
 static void addToInhibitList(CO_TRANS_QUEUE_T *pTrBuf);
 static void addToTransmitList(CO_TRANS_QUEUE_T *pTrBuf);
 #ifdef CO_SYNC_SUPPORTED
 static void addToTransmitListFirst(CO_TRANS_QUEUE_T *pTrBuf);
 #endif /* CO_SYNC_SUPPORTED */
-static CO_TRANS_QUEUE_T *moveInhibitToTransmitList(CO_CONST CO_COB_T *pCob);
+static CO_TRANS_QUEUE_T *moveInhibitToTransmitList(COB_REFERENZ_T cobRef);
 
 /* external variables
 ---------------------------------------------------------------------------*/
@@ -142,8 +161,20 @@ static CO_TRANS_QUEUE_T	trDataBuffer[CO_CONFIG_TRANS_BUFFER_CNT];
 static CO_TRANS_QUEUE_T	trBuffer[CO_CONFIG_TRANS_BUFFER_CNT];
 #endif /* OLD_FIXED_BUFFER */
 static BOOL_T			drvBufAccess = { CO_TRUE };
-static CO_TRANS_QUEUE_T	*pInhibitList = { NULL };
-static CO_TRANS_QUEUE_T	*pTransmitList = { NULL };
+static CO_TRANS_QUEUE_T	*trFreeList[CO_CONFIG_TRANS_BUFFER_CNT];	/* free buffers, used as stack */
+static UNSIGNED16		trFreeCnt = { 0u };
+static CO_TRANS_QUEUE_T	*trRing[CO_TRANS_RING_CNT];	/* transmit ring, oldest message first */
+static UNSIGNED16		trRingRd = { 0u };		/* oldest message, only written by icoQueueHandler() */
+static UNSIGNED16		trRingTx = { 0u };		/* next message for the driver, only written by the driver */
+static UNSIGNED16		trRingWr = { 0u };		/* next free entry */
+static CO_COB_QUEUE_T	cobQueue[CO_COB_CNT];
+static UNSIGNED16		inhibitCnt = { 0u };	/* messages waiting for inhibit */
+static COB_REFERENZ_T	inhibitHeap[CO_COB_CNT];	/* cobs with active inhibit, first ending first */
+static UNSIGNED16		inhibitHeapCnt = { 0u };
+static CO_TIMER_T		inhibitHeapTimer;
+static BOOL_T			inhibitHeapTimerOn = { CO_FALSE };
+static UNSIGNED32		inhibitTick = { 0u };
+static CO_QUEUE_STATS_T	queueStats;
 static BOOL_T			recBufFull = { CO_FALSE };
 #ifdef CO_EVENT_SLEEP
 static BOOL_T			queueDisabled = { CO_FALSE };
@@ -783,6 +814,7 @@ RET_T icoTransmitMessage(
 	)
 {
 CO_COB_T	*pCob;
+CO_COB_QUEUE_T	*pCobQueue;
 CO_TRANS_QUEUE_T *pTrBuf = NULL;
 CO_TRANS_QUEUE_T *pLastBuf = NULL;
 UNSIGNED16	i;
@@ -801,13 +833,22 @@ BOOL_T		msgOverwrite = CO_FALSE;
 		return(RET_EVENT_NO_RESSOURCE);
 	}
 
+	pCobQueue = getCobQueue(cobRef);
+	if (pCobQueue == NULL)  {
+		return(RET_EVENT_NO_RESSOURCE);
+	}
+
 	/* if cob is disabled, return */
 	if ((pCob->canCob.flags & CO_COBFLAG_ENABLED) == 0u)  {
 		return(RET_COB_DISABLED);
 	}
 
 	/* if inhibit active ? */
-	inhibitActive = coTimerIsActive(&pCob->inhibitTimer);
+	if (pCobQueue->heapPos != 0u)  {
+		inhibitActive = CO_TRUE;
+	} else {
+		inhibitActive = CO_FALSE;
+	}
 	/* inhibit is active, return RET_INHIBIT_ACTIVE */
 	if ((flags & MSG_RET_INHIBIT) != 0u)  {
 		/* inhibit timer active ? */
@@ -902,6 +943,8 @@ BOOL_T		msgOverwrite = CO_FALSE;
 			/* start can transmission again */
 			(void) codrvCanStartTransmission();
 
+			queueStats.overflows++;
+
 			/* inform application */
 			coCommStateEvent(CO_COMM_STATE_EVENT_TR_QUEUE_OVERFLOW);
 			return(RET_DRV_TRANS_BUFFER_FULL);
@@ -1014,17 +1057,17 @@ BOOL_T icoQueueInhibitActive(
 	)
 {
 CO_COB_T	*pCob;
+CO_COB_QUEUE_T	*pCobQueue;
 CO_TRANS_QUEUE_T *pLastBuf;
-BOOL_T	inhibitActive;
 
 	pCob = icoCobGetPointer(cobRef);
-	if (pCob == NULL)  {
+	pCobQueue = getCobQueue(cobRef);
+	if ((pCob == NULL) || (pCobQueue == NULL))  {
 		return(CO_FALSE);
 	}
-	inhibitActive = coTimerIsActive(&pCob->inhibitTimer);
 	pLastBuf = searchLastMessage(cobRef, CO_TRUE);
 
-	if ((inhibitActive == CO_TRUE)
+	if ((pCobQueue->heapPos != 0u)
 	 || ((pLastBuf != NULL) && (pCob->inhibit != 0u))) {
 		return(CO_TRUE);
 	} else {
@@ -1056,8 +1099,7 @@ static UNSIGNED32 demoFctCnt = 0;
 
 	if (demoFctCnt > (CO_EVAL_TIMEOUT / CO_DEMO_TIMER_VALUE))  {
 /*		printf("**** Zeit ist um\n"); */
-		pInhibitList = (void *)0x17835;
-		pTransmitList = (void *)0x84653;
+		trFreeCnt = 0u;
 	}
 }
 #endif /* CO_EVAL_MODE */
@@ -1069,7 +1111,7 @@ static UNSIGNED32 demoFctCnt = 0;
 *
 * \brief addToInhibitList - add buffer to inhibit list
 *
-* Add an buffer entry to the inhibit list as the first element
+* Add an buffer entry to the inhibit list of its cob as the last element
 *
 *
 */
@@ -1077,23 +1119,28 @@ static void addToInhibitList(
 		CO_TRANS_QUEUE_T	*pTrBuf
 	)
 {
-CO_TRANS_QUEUE_T	*pList;
+CO_COB_QUEUE_T	*pCobQueue;
 
-	/*
-	printf("addToInhibitList: buf %ld - ", BUF_NUM(pTrBuf));
-	pList = pInhibitList;
-	while (pList != NULL)  {
-		printf("%ld ", BUF_NUM(pList));
-		pList = pList->pNext;
+	pCobQueue = getCobQueue(pTrBuf->cobRef);
+	if (pCobQueue == NULL)  {
+		freeTransBuf(pTrBuf);
+		return;
+	}
+
+	/* add it as last entry, the oldest message is sent first */
+	pTrBuf->pNext = NULL;
+	if (pCobQueue->pInhibitLast == NULL)  {
+		pCobQueue->pInhibitFirst = pTrBuf;
+	} else {
+		pCobQueue->pInhibitLast->pNext = pTrBuf;
+	}
+	pCobQueue->pInhibitLast = pTrBuf;
+
+	inhibitCnt++;
+	if (inhibitCnt > queueStats.inhibitHighWater)  {
+		queueStats.inhibitHighWater = inhibitCnt;
 	}
-	printf("\n");
-	*/
 
-	/* add it as first entry */
-	/* as first save actual pointer */
-	pList = pInhibitList;
-	pInhibitList = pTrBuf;
-	pTrBuf->pNext = pList;
 	/* save buffer state */
 	pTrBuf->state = CO_TR_STATE_WAITING;
 	/* printf(" WAITING\n"); */
@@ -1106,7 +1153,7 @@ CO_TRANS_QUEUE_T	*pList;
 *
 * \brief addToTransmitList - add an buffer to transmit list
 *
-* Add an buffer entry to the transmit list at the end of the list
+* Add an buffer entry to the transmit ring at the end of the ring
 *
 * \return none
 *
@@ -1115,28 +1162,25 @@ static void addToTransmitList(
 		CO_TRANS_QUEUE_T	*pTrBuf
 	)
 {
-CO_TRANS_QUEUE_T	*pList;
+CO_COB_QUEUE_T	*pCobQueue;
 
-	/* add it at last position */
-	pList = pTransmitList;
-
-	/* list empty ? */
-	if (pList == NULL)  {
-		/* save at first */
-		pTransmitList = pTrBuf;
-	} else {
-		/* look for end of the list */
-		while (pList->pNext != NULL)  {
-			pList = pList->pNext;
-		}
-		pList->pNext = pTrBuf;
-	}
+	/* add it at last position,
+	 * the ring has room for all buffers */
+	trRing[trRingWr] = pTrBuf;
 
 	/* set next element to 0 */
 	pTrBuf->pNext = NULL;
 	/* set buffer state */
 	pTrBuf->state = CO_TR_STATE_TO_TRANSMIT;
 	/* printf(" TO TRANSMIT\n"); */
+
+	pCobQueue = getCobQueue(pTrBuf->cobRef);
+	if (pCobQueue != NULL)  {
+		pCobQueue->pTransmitLast = pTrBuf;
+	}
+
+	/* the driver can take it from now */
+	trRingWr = nextRingIdx(trRingWr);
 }
 
 
@@ -1147,7 +1191,9 @@ CO_TRANS_QUEUE_T	*pList;
 *
 * \brief addToTransmitListFirst - add an buffer to transmit list at first pos
 *
-* Add an buffer entry to the transmit list at the start of the list
+* Add an buffer entry to the transmit ring before all entries
+* not given to the driver yet.
+* The driver buffer access has to be disabled.
 *
 * \return none
 *
@@ -1156,41 +1202,40 @@ static void addToTransmitListFirst(
 		CO_TRANS_QUEUE_T	*pTrBuf
 	)
 {
-CO_TRANS_QUEUE_T	*pList;
-
-	/* add it at last position */
-	pList = pTransmitList;
-
-	/* list empty ? */
-	if (pList == NULL)  {
-		/* save at first */
-		pTransmitList = pTrBuf;
-		/* set next element to 0 */
-		pTrBuf->pNext = NULL;
-	} else {
-		/* first entry to transmit ? */
-		if (pList->state == CO_TR_STATE_TO_TRANSMIT)  {
-			/* save as first element */
-			pTrBuf->pNext = pList;
-			pTransmitList = pTrBuf;
+CO_COB_QUEUE_T	*pCobQueue;
+UNSIGNED16	idx;
+UNSIGNED16	prevIdx;
+
+	/* move all entries to transmit one position back */
+	idx = trRingWr;
+	while (idx != trRingTx)  {
+		if (idx == 0u)  {
+			prevIdx = CO_TRANS_RING_CNT - 1u;
 		} else {
-			/* actual element is already transmitted */
-			while (pList->pNext != NULL)  {
-				if (pList->pNext->state == CO_TR_STATE_TO_TRANSMIT)  {
-					break;
-				}
-				pList = pList->pNext;
-			}
-
-			/* save after actual buffer */
-			pTrBuf->pNext = pList->pNext;
-			pList->pNext = pTrBuf;
+			prevIdx = idx - 1u;
 		}
+		trRing[idx] = trRing[prevIdx];
+		idx = prevIdx;
 	}
 
+	/* save as first element to transmit */
+	trRing[trRingTx] = pTrBuf;
+	pTrBuf->pNext = NULL;
+
 	/* set buffer state */
 	pTrBuf->state = CO_TR_STATE_TO_TRANSMIT;
 	/* printf(" TO TRANSMIT\n"); */
+
+	/* an older message to transmit stays the last one */
+	pCobQueue = getCobQueue(pTrBuf->cobRef);
+	if (pCobQueue != NULL)  {
+		if ((pCobQueue->pTransmitLast == NULL)
+		 || (pCobQueue->pTransmitLast->state != CO_TR_STATE_TO_TRANSMIT))  {
+			pCobQueue->pTransmitLast = pTrBuf;
+		}
+	}
+
+	trRingWr = nextRingIdx(trRingWr);
 }
 #endif /* CO_SYNC_SUPPORTED */
 
@@ -1199,32 +1244,26 @@ CO_TRANS_QUEUE_T	*pList;
 /**
 * \internal
 *
-* \brief moveInhibitToTransmitList - move last entry to transmit list
+* \brief moveInhibitToTransmitList - move oldest entry to transmit list
 *
 * \return pointer to moved entry
 *
 */
 static CO_TRANS_QUEUE_T *moveInhibitToTransmitList(
-		CO_CONST CO_COB_T	*pCob
+		COB_REFERENZ_T	cobRef
 	)
 {
-CO_TRANS_QUEUE_T	*pBuf;
-CO_TRANS_QUEUE_T	*pTrData = NULL;
-CO_COB_T	*cobPtr;
-
-	pBuf = pInhibitList;
+CO_COB_QUEUE_T	*pCobQueue;
+CO_TRANS_QUEUE_T	*pTrData;
 
-	/* look for last message at inhibit queue with this cobRef */
-	while (pBuf != NULL)  {
-		cobPtr = icoCobGetPointer(pBuf->cobRef);
-		if (cobPtr == pCob)  {
-			pTrData = pBuf;
-		}
-
-		/* search whole list - oldest message is at the end */
-		pBuf = pBuf->pNext;
+	pCobQueue = getCobQueue(cobRef);
+	if (pCobQueue == NULL)  {
+		return(NULL);
 	}
 
+	/* oldest message at inhibit queue with this cobRef */
+	pTrData = pCobQueue->pInhibitFirst;
+
 	/* buffer found ? */
 	if (pTrData != NULL)  {
 		/* transmit data found - copy it to transmit list */
@@ -1233,15 +1272,11 @@ CO_COB_T	*cobPtr;
 		drvBufAccess = CO_FALSE;
 
 		/* delete it from inhibit list */
-		if (pInhibitList == pTrData)  {
-			pInhibitList = pTrData->pNext;
-		} else {
-			pBuf = pInhibitList;
-			while (pBuf->pNext != pTrData)  {
-				pBuf = pBuf->pNext;
-			}
-			pBuf->pNext = pTrData->pNext;
+		pCobQueue->pInhibitFirst = pTrData->pNext;
+		if (pCobQueue->pInhibitFirst == NULL)  {
+			pCobQueue->pInhibitLast = NULL;
 		}
+		inhibitCnt--;
 
 		/* and save it at transmit list */
 		addToTransmitList(pTrData);
@@ -1273,6 +1308,9 @@ CO_COB_T	*cobPtr;
 * Parameter all gibt an, ob auch aktuell schon versendete Nachrichten
 * mit einbezogen werden sollen
 *
+* The messages of a cob are transmitted and released in the order
+* they were queued, so only the newest message has to be checked.
+*
 * \return buffer index
 *
 */
@@ -1281,41 +1319,26 @@ static CO_TRANS_QUEUE_T	*searchLastMessage(
 		BOOL_T			all			/* use all messages incl. transmitted messages*/
 	)
 {
-CO_TRANS_QUEUE_T	*pList;
-CO_TRANS_QUEUE_T	*pLast = NULL;
+CO_COB_QUEUE_T	*pCobQueue;
+CO_TRANS_QUEUE_T	*pLast;
+
+	pCobQueue = getCobQueue(cobRef);
+	if (pCobQueue == NULL)  {
+		return(NULL);
+	}
 
 	/* as first, look on inhibit list */
-	pList = pInhibitList;
-	while (pList != NULL)  {
-		/* correct cob reference ? */
-		if (pList->cobRef == cobRef)  {
-			/* yes, return pointer */
-			return(pList);
-		}
-		/* try until end of list */
-		pList = pList->pNext;
-	}
-
-	/* no entry at inhibit list found - try the same at transmit list */
-	pList = pTransmitList;
-	while (pList != NULL)  {
-		/* cobref found ? */
-		if (pList->cobRef == cobRef)  {
-			/* depending on parameter all */
-			if (all == CO_TRUE)  {
-				/* check state of the message */
-				if (pList->state != CO_TR_STATE_FREE)  {
-					pLast = pList;
-				}
-			} else {
-				if (pList->state == CO_TR_STATE_TO_TRANSMIT)  {
-					pLast = pList;
-				}
-			}
+	if (pCobQueue->pInhibitLast != NULL)  {
+		return(pCobQueue->pInhibitLast);
+	}
 
-			/* if we have found an entry, return it */
+	/* no entry at inhibit list found - try the same at transmit ring,
+	 * released buffers are removed from pTransmitLast */
+	pLast = pCobQueue->pTransmitLast;
+	if ((pLast != NULL) && (all != CO_TRUE))  {
+		if (pLast->state != CO_TR_STATE_TO_TRANSMIT)  {
+			pLast = NULL;
 		}
-		pList = pList->pNext;
 	}
 
 	return(pLast);
@@ -1339,29 +1362,11 @@ UNSIGNED32 icoQueueGetTransBufFillState(
 		void	/* no parameter */
 	)
 {
-UNSIGNED32	cnt = 0u;
-UNSIGNED32	i;
-
-	/* look for next free buffer */
-#ifdef OLD_FIXED_BUFFER
-	for (i = 0u; i < CO_CONFIG_TRANS_BUFFER_CNT; i++)  {
-		if (trDataBuffer[i].state == CO_TR_STATE_FREE)  {
-			cnt++;
-		}
-	}
+UNSIGNED32	cnt;
 
-	return(cnt * 100u / CO_CONFIG_TRANS_BUFFER_CNT);
-#else /* OLD_FIXED_BUFFER */
-	for (i = 0u; i < CO_CONFIG_TRANS_BUFFER_CNT; i++)  {
-		if (trBuffer[i].state == CO_TR_STATE_FREE)  {
-			cnt++;
-		}
-	}
+	cnt = (UNSIGNED32)trFreeCnt * 100u;
 
-	cnt *= 100u;
-	
 	return(100u - (cnt / CO_CONFIG_TRANS_BUFFER_CNT));
-#endif /* OLD_FIXED_BUFFER */
 }
 
 
@@ -1371,7 +1376,7 @@ UNSIGNED32	i;
 *
 * \brief getNextTransBuf - get next transmit buffer
 *
-* get next transmit buffer depending on the last transmission time
+* get the last released transmit buffer
 *
 * \return buffer index
 */
@@ -1379,34 +1384,136 @@ static CO_TRANS_QUEUE_T	*getNextTransBuf(
 		void	/* no parameter */
 	)
 {
-UNSIGNED16	i;
+UNSIGNED16	used;
 
-	/* look for next free buffer */
-#ifdef OLD_FIXED_BUFFER
-	for (i = 0u; i < CO_CONFIG_TRANS_BUFFER_CNT; i++)  {
-		if (trDataBuffer[i].state == CO_TR_STATE_FREE)  {
-			/* check for buffer full -
-			 * it comes over only if we use the last buffer */
-			if (i == (CO_CONFIG_TRANS_BUFFER_CNT - 1u))  {
-				coCommStateEvent(CO_COMM_STATE_EVENT_TR_QUEUE_FULL);
-			}
-			return(&trDataBuffer[i]);
-		}
+	/* no free buffer */
+	if (trFreeCnt == 0u)  {
+		return(NULL);
 	}
-#else /* OLD_FIXED_BUFFER */
-	for (i = 0u; i < CO_CONFIG_TRANS_BUFFER_CNT; i++)  {
-		if (trBuffer[i].state == CO_TR_STATE_FREE)  {
-			/* check for buffer full -
-			 * it comes over only if we use the last buffer */
-			if (i == (CO_CONFIG_TRANS_BUFFER_CNT - 1u))  {
-				coCommStateEvent(CO_COMM_STATE_EVENT_TR_QUEUE_FULL);
-			}
-			return(&trBuffer[i]);
+	trFreeCnt--;
+
+	used = CO_CONFIG_TRANS_BUFFER_CNT - trFreeCnt;
+	if (used > queueStats.bufHighWater)  {
+		queueStats.bufHighWater = used;
+	}
+
+	/* check for buffer full -
+	 * it comes over only if we use the last buffer */
+	if (trFreeCnt == 0u)  {
+		coCommStateEvent(CO_COMM_STATE_EVENT_TR_QUEUE_FULL);
+	}
+
+	return(trFreeList[trFreeCnt]);
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief freeTransBuf - release a transmit buffer
+*
+* \return none
+*/
+static void freeTransBuf(
+		CO_TRANS_QUEUE_T	*pTrBuf
+	)
+{
+CO_COB_QUEUE_T	*pCobQueue;
+
+	pTrBuf->state = CO_TR_STATE_FREE;
+
+	pCobQueue = getCobQueue(pTrBuf->cobRef);
+	if (pCobQueue != NULL)  {
+		if (pCobQueue->pTransmitLast == pTrBuf)  {
+			pCobQueue->pTransmitLast = NULL;
 		}
 	}
+
+	trFreeList[trFreeCnt] = pTrBuf;
+	trFreeCnt++;
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief transQueueReset - release all transmit buffers
+*
+* \return none
+*/
+static void transQueueReset(
+		void	/* no parameter */
+	)
+{
+UNSIGNED16	i;
+
+	(void)coTimerStop(&inhibitHeapTimer);
+	inhibitHeapTimerOn = CO_FALSE;
+	inhibitHeapCnt = 0u;
+	inhibitTick = 0u;
+	inhibitCnt = 0u;
+	memset(&cobQueue[0], 0, sizeof(cobQueue));
+
+	trRingRd = 0u;
+	trRingTx = 0u;
+	trRingWr = 0u;
+
+	/* first buffer is used first */
+	trFreeCnt = 0u;
+	for (i = CO_CONFIG_TRANS_BUFFER_CNT; i > 0u; i--)  {
+#ifdef OLD_FIXED_BUFFER
+		trDataBuffer[i - 1u].cobRef = 0xffffu;
+		freeTransBuf(&trDataBuffer[i - 1u]);
+#else /* OLD_FIXED_BUFFER */
+		trBuffer[i - 1u].cobRef = 0xffffu;
+		freeTransBuf(&trBuffer[i - 1u]);
 #endif /* OLD_FIXED_BUFFER */
+	}
+
+	memset(&queueStats, 0, sizeof(queueStats));
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief getCobQueue - get queue state of a cob
+*
+* \return pointer to queue state, NULL for unknown cobs
+*/
+static CO_COB_QUEUE_T *getCobQueue(
+		COB_REFERENZ_T	cobRef			/* cob reference */
+	)
+{
+	if (cobRef >= CO_COB_CNT)  {
+		return(NULL);
+	}
+
+	return(&cobQueue[cobRef]);
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief nextRingIdx - get next index of transmit ring
+*
+* \return next index
+*/
+static UNSIGNED16 nextRingIdx(
+		UNSIGNED16	idx
+	)
+{
+	idx++;
+	if (idx >= CO_TRANS_RING_CNT)  {
+		idx = 0u;
+	}
 
-	return(NULL);
+	return(idx);
 }
 
 
@@ -1416,7 +1523,7 @@ UNSIGNED16	i;
 *
 * This function returns the next available transmit message
 * from the transmit queue.
-* It increments also trBufferRdCnt.
+* It increments also trRingTx.
 *
 * \return CO_CAN_TR_MSG_T* pointer to next tx message
 * \retval !NULL
@@ -1436,22 +1543,20 @@ CO_TRANS_QUEUE_T *pBuf;
 		return(NULL);
 	}
 
-	/* start with first entry */
-	pBuf = pTransmitList;
-	while (pBuf != NULL)  {
-		/* correct state ? */
-		if (pBuf->state == CO_TR_STATE_TO_TRANSMIT)  {
-			/* set state to active */
-			pBuf->state = CO_TR_STATE_ACTIVE;
-			/* save handle */
-			pBuf->msg.handle = pBuf;
-			return(&pBuf->msg);
-		}
-
-		pBuf = pBuf->pNext;
+	/* all messages given to the driver ? */
+	if (trRingTx == trRingWr)  {
+		return(NULL);
 	}
 
-	return(NULL);
+	pBuf = trRing[trRingTx];
+	trRingTx = nextRingIdx(trRingTx);
+
+	/* set state to active */
+	pBuf->state = CO_TR_STATE_ACTIVE;
+	/* save handle */
+	pBuf->msg.handle = pBuf;
+
+	return(&pBuf->msg);
 }
 
 
@@ -1491,6 +1596,7 @@ void icoQueueHandler(
 	)
 {
 CO_COB_T	*pCob;
+CO_TRANS_QUEUE_T	*pTrBuf;
 
 /*
 * trBufferRdCnt is getting changed in interrupts, is there additional guarding needed?
@@ -1503,62 +1609,61 @@ CO_COB_T	*pCob;
 		coCommStateEvent(CO_COMM_STATE_EVENT_REC_QUEUE_OVERFLOW);
 	}
 
-	/* no entries at transmit list, return */
-	if (pTransmitList == NULL)  {
+	/* no entries at transmit ring, return */
+	if (trRingRd == trRingWr)  {
 		return;
 	}
 
 	/* check all buffer with state transmitted */
-	while (pTransmitList->state == CO_TR_STATE_TRANSMITTED)  {
+	while (trRingRd != trRingTx)  {
+		pTrBuf = trRing[trRingRd];
+		if (pTrBuf->state != CO_TR_STATE_TRANSMITTED)  {
+			break;
+		}
+
 		/* delete transmitted messages ...... and save inhibit */
 
 		/* get cob reference */
-		pCob = icoCobGetPointer(pTransmitList->cobRef);
+		pCob = icoCobGetPointer(pTrBuf->cobRef);
 		if (pCob != NULL)  {
 			/* if inhibit is != 0 */
 			if (pCob->inhibit != 0u)  {
-				/* start inhibit timer */
-				(void)coTimerStart(&pCob->inhibitTimer,
-						pCob->inhibit * 100ul,
-						inhibitTimer, pCob, CO_TIMER_ATTR_ROUNDUP); /*lint !e960 */
-				/* Derogation MisraC2004 R.16.9 function identifier used
-				 * without '&' or parenthesized parameter */
+				/* start inhibit time */
+				startInhibit(pTrBuf->cobRef, pCob->inhibit);
 			}
 			/* should this message create a tx acknowledge */
-			if ((pTransmitList->msg.flags & CO_COBFLAG_IND)
+			if ((pTrBuf->msg.flags & CO_COBFLAG_IND)
 					== CO_COBFLAG_IND)  {
 
 #ifdef ISOTP_CLIENT_CONNECTION_CNT
 				if (pCob->service == CO_SERVICE_ISOTP_CLIENT)  {
-					iisoTpClientTxAck(pTransmitList->cobRef, &pTransmitList->msg);
+					iisoTpClientTxAck(pTrBuf->cobRef, &pTrBuf->msg);
 				}
 #endif /* ISOTP_CLIENT_CONNECTION_CNT */
 			}
 
 		}
-		/* set buffer state */
-		pTransmitList->state = CO_TR_STATE_FREE;
+		/* release buffer */
+		freeTransBuf(pTrBuf);
 
-		/* set transmit list to next buffer */
-		pTransmitList = pTransmitList->pNext;
-		if (pTransmitList == NULL)  {
-			break;
-		}
+		/* set transmit ring to next buffer */
+		trRingRd = nextRingIdx(trRingRd);
 	}
 
-	/* transmit list is empty */
-	if (pTransmitList == NULL)  {
+	/* transmit ring is empty */
+	if (trRingRd == trRingWr)  {
 		/* inhibit list is also empty, signal it to eventHandler */
-		if (pInhibitList == NULL)  {
+		if (inhibitCnt == 0u)  {
 			coCommStateEvent(CO_COMM_STATE_EVENT_TR_QUEUE_EMPTY);
 		}
 	} else {
 		/* should buffer be transmitted? */
-		if (pTransmitList->state == CO_TR_STATE_TO_TRANSMIT)  {
+		if (trRingTx != trRingWr)  {
 			(void) codrvCanStartTransmission();
 		}
 	}
 
+
 }
 
 
@@ -1575,17 +1680,11 @@ void icoQueueDeleteInhibit(
 		COB_REFERENZ_T	cobRef			/* cob reference */
 	)
 {
-CO_COB_T	*pCob;
 CO_TRANS_QUEUE_T	*pData = NULL;
 
-	pCob = icoCobGetPointer(cobRef);
-	if (pCob == NULL)  {
-		return;
-	}
-
 	/* delete inhibit until list is empty */
 	do {
-		pData = moveInhibitToTransmitList(pCob);
+		pData = moveInhibitToTransmitList(cobRef);
 	} while (pData != NULL);
 }
 
@@ -1594,7 +1693,11 @@ CO_TRANS_QUEUE_T	*pData = NULL;
 /**
 * \internal
 *
-* \brief inhibitTimer - inhibit timer has been ellapsed
+* \brief inhibitTimer - inhibit tick has been ellapsed
+*
+* Moves a message of each cob whose inhibit time has ended
+* to the transmit ring.
+* The timer runs each timer interval as long as an inhibit time is active.
 *
 * \return none
 *
@@ -1603,11 +1706,162 @@ static void inhibitTimer(
 		void			*pData
 	)
 {
-CO_COB_T	*pCob;
+COB_REFERENZ_T	cobRef;
+
+	(void)pData;
+
+	inhibitTick++;
+
+	while (inhibitHeapCnt > 0u)  {
+		cobRef = inhibitHeap[0];
+		if ((INTEGER32)(inhibitTick - cobQueue[cobRef].inhibitEnd) < 0)  {
+			break;
+		}
+		inhibitHeapRemoveFirst();
+
+		(void)moveInhibitToTransmitList(cobRef);
+	}
+
+	/* no inhibit active, do not restart the timer after this call */
+	if (inhibitHeapCnt == 0u)  {
+		coTimerAttrChange(&inhibitHeapTimer, CO_TIMER_ATTR_ROUNDUP);
+		inhibitHeapTimerOn = CO_FALSE;
+	}
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief startInhibit - start inhibit time of a cob
+*
+* (Re)starts the inhibit time and sorts the cob into the inhibit heap.
+*
+* \return none
+*
+*/
+static void startInhibit(
+		COB_REFERENZ_T	cobRef,			/* cob reference */
+		UNSIGNED16		inhibit			/* inhibit time in 100 usec */
+	)
+{
+CO_COB_QUEUE_T	*pCobQueue;
+UNSIGNED32	interval;
+UNSIGNED32	ticks;
+
+	pCobQueue = getCobQueue(cobRef);
+	if (pCobQueue == NULL)  {
+		return;
+	}
+
+	/* inhibit time in timer ticks, rounded up */
+	interval = icoTimerGetInterval();
+	if (interval == 0u)  {
+		interval = 1u;
+	}
+	ticks = ((inhibit * 100ul) + interval - 1u) / interval;
+
+	if (inhibitHeapTimerOn == CO_TRUE)  {
+		/* the next tick comes before a whole interval */
+		ticks++;
+	} else {
+		(void)coTimerStart(&inhibitHeapTimer, interval,
+				inhibitTimer, NULL, CO_TIMER_ATTR_ROUNDUP_CYCLIC); /*lint !e960 */
+		/* Derogation MisraC2004 R.16.9 function identifier used
+		 * without '&' or parenthesized parameter */
+		inhibitHeapTimerOn = CO_TRUE;
+	}
+	pCobQueue->inhibitEnd = inhibitTick + ticks;
+
+	if (pCobQueue->heapPos == 0u)  {
+		/* add it as last entry */
+		inhibitHeap[inhibitHeapCnt] = cobRef;
+		inhibitHeapCnt++;
+		inhibitHeapFix(inhibitHeapCnt - 1u);
+	} else {
+		/* restarted */
+		inhibitHeapFix(pCobQueue->heapPos - 1u);
+	}
+}
+
 
-	pCob = (CO_COB_T *)pData;
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief inhibitHeapFix - move a heap entry to its position
+*
+* Moves the entry at pos up or down,
+* until no parent ends after it and no child ends before it.
+*
+* \return none
+*
+*/
+static void inhibitHeapFix(
+		UNSIGNED16		pos				/* heap position */
+	)
+{
+COB_REFERENZ_T	cobRef;
+UNSIGNED16	parent;
+UNSIGNED16	child;
+
+	cobRef = inhibitHeap[pos];
+
+	/* up */
+	while (pos > 0u)  {
+		parent = (pos - 1u) / 2u;
+		if ((INTEGER32)(cobQueue[cobRef].inhibitEnd
+				- cobQueue[inhibitHeap[parent]].inhibitEnd) >= 0)  {
+			break;
+		}
+		inhibitHeap[pos] = inhibitHeap[parent];
+		cobQueue[inhibitHeap[pos]].heapPos = pos + 1u;
+		pos = parent;
+	}
 
-	(void)moveInhibitToTransmitList(pCob);
+	/* down */
+	while (((2u * pos) + 1u) < inhibitHeapCnt)  {
+		child = (2u * pos) + 1u;
+		if (((child + 1u) < inhibitHeapCnt)
+		 && ((INTEGER32)(cobQueue[inhibitHeap[child + 1u]].inhibitEnd
+				- cobQueue[inhibitHeap[child]].inhibitEnd) < 0))  {
+			child++;
+		}
+		if ((INTEGER32)(cobQueue[inhibitHeap[child]].inhibitEnd
+				- cobQueue[cobRef].inhibitEnd) >= 0)  {
+			break;
+		}
+		inhibitHeap[pos] = inhibitHeap[child];
+		cobQueue[inhibitHeap[pos]].heapPos = pos + 1u;
+		pos = child;
+	}
+
+	inhibitHeap[pos] = cobRef;
+	cobQueue[cobRef].heapPos = pos + 1u;
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief inhibitHeapRemoveFirst - remove the cob ending first from the heap
+*
+* \return none
+*
+*/
+static void inhibitHeapRemoveFirst(
+		void	/* no parameter */
+	)
+{
+	cobQueue[inhibitHeap[0]].heapPos = 0u;
+
+	inhibitHeapCnt--;
+	if (inhibitHeapCnt > 0u)  {
+		inhibitHeap[0] = inhibitHeap[inhibitHeapCnt];
+		inhibitHeapFix(0u);
+	}
 }
 
 
@@ -1625,10 +1879,21 @@ void icoQueueDisable(
 		BOOL_T	on
 	)
 {
+UNSIGNED16	i;
+CO_TRANS_QUEUE_T	*pTrBuf;
+
 	queueDisabled = on;
 
 	/* delete all entries at the inhibit queue */
-	pInhibitList = NULL;
+	for (i = 0u; i < CO_COB_CNT; i++)  {
+		while (cobQueue[i].pInhibitFirst != NULL)  {
+			pTrBuf = cobQueue[i].pInhibitFirst;
+			cobQueue[i].pInhibitFirst = pTrBuf->pNext;
+			freeTransBuf(pTrBuf);
+		}
+		cobQueue[i].pInhibitLast = NULL;
+	}
+	inhibitCnt = 0u;
 }
 #endif /* CO_EVENT_SLEEP */
 
@@ -1648,22 +1913,10 @@ void coQueueInit(
 		void	/* no parameter */
 	)
 {
-UNSIGNED16	i;
-
 	/* transmit queue */
-#ifdef OLD_FIXED_BUFFER
-	for (i = 0u; i < CO_CONFIG_TRANS_BUFFER_CNT; i++)  {
-		trDataBuffer[i].state = CO_TR_STATE_FREE;
-	}
-#else /* OLD_FIXED_BUFFER */
-	for (i = 0u; i < CO_CONFIG_TRANS_BUFFER_CNT; i++)  {
-		trBuffer[i].state = CO_TR_STATE_FREE;
-	}
-#endif /* OLD_FIXED_BUFFER */
-
+	drvBufAccess = CO_FALSE;
+	transQueueReset();
 	drvBufAccess = CO_TRUE;
-	pInhibitList = NULL;
-	pTransmitList = NULL;
 
 	/* receive queue */
 	recBufferWrCnt = 0u;
@@ -1755,6 +2008,8 @@ CO_TRANS_QUEUE_T	*pTrBuf;
 		/* start can transmission again */
 		(void) codrvCanStartTransmission();
 
+		queueStats.overflows++;
+
 		/* inform application */
 		coCommStateEvent(CO_COMM_STATE_EVENT_TR_QUEUE_OVERFLOW);
 
@@ -1775,6 +2030,31 @@ CO_TRANS_QUEUE_T	*pTrBuf;
 #endif /* CO_GATEWAY_BUFFER */
 
 
+/***************************************************************************/
+/**
+*
+* \brief coQueueGetStats - get transmit queue statistics
+*
+* Returns the current depths of the transmit and inhibit queues
+* and their high water marks since the last coQueueInit().
+*
+* \return none
+*
+*/
+void coQueueGetStats(
+		CO_QUEUE_STATS_T	*pStats		/**< pointer to statistics */
+	)
+{
+	pStats->bufUsed = CO_CONFIG_TRANS_BUFFER_CNT - trFreeCnt;
+	pStats->bufHighWater = queueStats.bufHighWater;
+	pStats->transmitDepth = ((trRingWr + CO_TRANS_RING_CNT) - trRingRd) % CO_TRANS_RING_CNT;
+	pStats->inhibitDepth = inhibitCnt;
+	pStats->inhibitHighWater = queueStats.inhibitHighWater;
+	pStats->inhibitCobs = inhibitHeapCnt;
+	pStats->overflows = queueStats.overflows;
+}
+
+
 /***************************************************************************/
 /**
 * \internal
@@ -1800,9 +2080,8 @@ void icoQueueVarInit(
 
 		recBufferWrCnt = 0u;
 		recBufferRdCnt= 0u;
+		transQueueReset();
 		drvBufAccess = CO_TRUE;
-		pInhibitList = NULL;
-		pTransmitList = NULL;
 		recBufFull = CO_FALSE;
 
 #ifdef CO_EVENT_SLEEP
@@ -46,6 +46,9 @@
 
 /* constant definitions
 ------------------------------------------------------------------------------*/
+#ifndef CO_SDO_BLOCK_SIZE_MIN
+# define CO_SDO_BLOCK_SIZE_MIN	4u	/* smallest adapted download block size */
+#endif /* CO_SDO_BLOCK_SIZE_MIN */
 
 /* local defined data types
 ------------------------------------------------------------------------------*/
@@ -60,6 +63,7 @@
 ------------------------------------------------------------------------------*/
 static void sdoServerBlockTransmit(void *pData);
 static RET_T sdoServerBlockReadEnd(CO_SDO_SERVER_T *pSdo);
+static void sdoServerBlockSizeAdapt(CO_SDO_SERVER_T *pSdo, BOOL_T complete);
 
 
 /* external variables
@@ -113,7 +117,7 @@ UNSIGNED16	objAttr;
 
 	/* save blocksize */
 	pSdo->blockSize = pRecData->data[4];
-	if (pSdo->blockSize > 127u)  {
+	if ((pSdo->blockSize == 0u) || (pSdo->blockSize > 127u))  {
 		return(RET_SDO_WRONG_BLOCKSIZE);
 	}
 
@@ -405,6 +409,10 @@ RET_T	retVal = RET_OK;
 		pSdo->transferedSize = size;
 	}
 
+	/* block size for the next block, chosen by the client */
+	if ((pRecData->data[2] == 0u) || (pRecData->data[2] > 127u))  {
+		return(RET_SDO_WRONG_BLOCKSIZE);
+	}
 	pSdo->blockSize = pRecData->data[2];
 
 	pSdo->state = CO_SDO_STATE_BLOCK_UPLOAD;
@@ -458,6 +466,13 @@ UNSIGNED8	trData[CO_CAN_MAX_DATA_LEN];	/* data */
 
 	pSdo->state = CO_SDO_STATE_FREE;
 
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+	/* the client has confirmed all blocks of the domain */
+	if (pSdo->domainTransfer == CO_TRUE)  {
+		icoSdoDomainUserReadFinishedInd(pSdo, RET_OK);
+	}
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
+
 	return(retVal);
 }
 
@@ -557,7 +572,11 @@ UNSIGNED32	len = 0u;
 	trData[2] = (UNSIGNED8)(pSdo->index >> 8u);
 	trData[3] = pSdo->subIndex;
 
-	pSdo->blockSize = CO_SDO_BLOCK_SIZE;
+	/* start with the block size the last download ended with */
+	if (pSdo->blockSizeNext == 0u)  {
+		pSdo->blockSizeNext = CO_SDO_BLOCK_SIZE;
+	}
+	pSdo->blockSize = pSdo->blockSizeNext;
 
 	/* BLOCK_TEST D1 Start */
 	/* pSdo->blockSize = 0x81u; */
@@ -666,6 +685,10 @@ BOOL_T	changed;
 	/* block cnt reached ? */
 	if ((pRecData->data[0] & (UNSIGNED8)~(UNSIGNED8)CO_SDO_CCS_BLOCK_DL_LAST)
 			== pSdo->blockSize)  {
+		/* segments lost, if the block ends before the last expected one */
+		sdoServerBlockSizeAdapt(pSdo,
+			((pSdo->seqNr - 1u) == pSdo->blockSize) ? CO_TRUE : CO_FALSE);
+
 		/* send response to server */
 		if (retVal == RET_SDO_SPLIT_INDICATION) {
 			pSdo->state = CO_SDO_STATE_WR_BLOCK_SPLIT_INDICATION;
@@ -719,15 +742,49 @@ UNSIGNED8	trData[CO_CAN_MAX_DATA_LEN];	/* data */
 	/* transmit answer */
 	retVal = icoTransmitMessage(pSdo->trCob, &trData[0], 0u);
 
-	/* reset seqNr */
-	if ((pSdo->seqNr - 1u) == pSdo->blockSize)  {
-		pSdo->seqNr = 1u;
+	/* reset seqNr, the next block starts with the segment after ackseq */
+	pSdo->seqNr = 1u;
+
+	return(retVal);
+}
+
+
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief sdoServerBlockSizeAdapt - block size of the next download block
+*
+* The block size is halved after a block with lost segments
+* and doubled after a complete block,
+* between CO_SDO_BLOCK_SIZE_MIN and CO_SDO_BLOCK_SIZE.
+* It is sent with the block acknowledge
+* and used as initial block size of the next download.
+*
+* \return void
+*
+*/
+static void sdoServerBlockSizeAdapt(
+		CO_SDO_SERVER_T		*pSdo,		/* pointer to sdo */
+		BOOL_T				complete	/* all segments of the block received */
+	)
+{
+UNSIGNED16	size = pSdo->blockSize;
 
-		/* call user indication */
-/*		sdoServerDomainIndication(pSdo);*/
+	if (complete == CO_TRUE)  {
+		size <<= 1;
+	} else {
+		size >>= 1;
+		if (size < CO_SDO_BLOCK_SIZE_MIN)  {
+			size = CO_SDO_BLOCK_SIZE_MIN;
+		}
+	}
+	if (size > CO_SDO_BLOCK_SIZE)  {
+		size = CO_SDO_BLOCK_SIZE;
 	}
 
-	return(retVal);
+	pSdo->blockSize = (UNSIGNED8)size;
+	pSdo->blockSizeNext = pSdo->blockSize;
 }
 
 
@@ -129,6 +129,9 @@ static RET_T sdoServerWriteSegment(CO_SDO_SERVER_T *pSdo,
 		const CO_CAN_REC_MSG_T *pRecData);
 static RET_T sdoServerWriteIndCont(CO_SDO_SERVER_T *pSdo);
 static RET_T sdoServerReadIndCont(CO_SDO_SERVER_T	*pSdo);
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+static BOOL_T sdoServerDomainReadActive(CO_CONST CO_SDO_SERVER_T *pSdo);
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
 
 
 /* external variables
@@ -161,6 +164,10 @@ static CO_EVENT_SDO_SERVER_DOMAIN_WRITE_T	sdoServerDomainWriteTable[CO_EVENT_SSD
 static UNSIGNED8    sdoServerDomainReadTableCnt = 0u;
 static CO_EVENT_SDO_SERVER_DOMAIN_READ_T    sdoServerDomainReadTable[CO_EVENT_SSDO_DOMAIN_READ_CNT];
 #endif /* CO_EVENT_SSDO_DOMAIN_READ_CNT */
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+static UNSIGNED8    sdoServerDomainReadFinishedTableCnt = 0u;
+static CO_EVENT_SDO_SERVER_DOMAIN_READ_FINISHED_T    sdoServerDomainReadFinishedTable[CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT];
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
 
 
 /******************************************************************************/
@@ -273,6 +280,12 @@ CO_NMT_STATE_T nmtState;
 				(void)icoSdoDomainUserWriteInd(pSdo);
 			}
 #endif /* CO_EVENT_SSDO_DOMAIN_WRITE */
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+			/* send abort to domain read finished indication */
+			if (sdoServerDomainReadActive(pSdo) == CO_TRUE)  {
+				icoSdoDomainUserReadFinishedInd(pSdo, RET_ABORTED);
+			}
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
 
 			/* sdo abort handler */
 			pSdo->state = CO_SDO_STATE_FREE;
@@ -649,6 +662,14 @@ UNSIGNED8	dataOffs;
 		retVal = icoTransmitMessage(pSdo->trCob, &trData[0], 0u);
 	}
 
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+	/* last segment of the domain sent */
+	if ((retVal == RET_OK) && (pSdo->state == CO_SDO_STATE_FREE)
+	 && (pSdo->domainTransfer == CO_TRUE))  {
+		icoSdoDomainUserReadFinishedInd(pSdo, RET_OK);
+	}
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
+
 	return(retVal);
 }
 
@@ -1159,10 +1180,54 @@ UNSIGNED32	abortCode;
 		}
 	}
 
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+	if (sdoServerDomainReadActive(pSdo) == CO_TRUE)  {
+		icoSdoDomainUserReadFinishedInd(pSdo, errorReason);
+	}
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
+
 	pSdo->state = CO_SDO_STATE_FREE;
 }
 
 
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief sdoServerDomainReadActive - domain upload in progress
+*
+* \return BOOL_T
+*
+*/
+static BOOL_T sdoServerDomainReadActive(
+		CO_CONST CO_SDO_SERVER_T	*pSdo		/* pointer to sdo */
+	)
+{
+	if (pSdo->domainTransfer != CO_TRUE)  {
+		return(CO_FALSE);
+	}
+
+	switch (pSdo->state)  {
+		case CO_SDO_STATE_UPLOAD_INIT:
+		case CO_SDO_STATE_UPLOAD_SEGMENT:
+# ifdef CO_SDO_BLOCK
+		case CO_SDO_STATE_BLOCK_UPLOAD_INIT:
+		case CO_SDO_STATE_BLOCK_UPLOAD:
+		case CO_SDO_STATE_BLOCK_UPLOAD_RESP:
+		case CO_SDO_STATE_BLOCK_UPLOAD_LAST:
+		case CO_SDO_STATE_BLOCK_UPLOAD_END:
+# endif /* CO_SDO_BLOCK */
+			return(CO_TRUE);
+		default:
+			break;
+	}
+
+	return(CO_FALSE);
+}
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
+
+
 /******************************************************************************/
 /**
 * \internal
@@ -1379,6 +1444,36 @@ RET_T coEventRegister_SDO_SERVER_DOMAIN_READ(
 #endif /* CO_EVENT_SSDO_DOMAIN_READ_CNT */
 
 
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+/***************************************************************************/
+/**
+* \brief coEventRegister_SDO_SERVER_DOMAIN_READ_FINISHED - register SDO server domain read finished event
+*
+* This function registers a SDO server read domain finished indication function.
+* It is called once for each domain upload, after the last segment was sent
+* or, at a block transfer, after the client has confirmed the last block.
+* If the transfer was aborted by the client or by the server,
+* it is called with the abort reason instead of RET_OK.
+*
+* \return RET_T
+*
+*/
+RET_T coEventRegister_SDO_SERVER_DOMAIN_READ_FINISHED(
+        CO_EVENT_SDO_SERVER_DOMAIN_READ_FINISHED_T    pFunction    /**< pointer to function */
+    )
+{
+	if (sdoServerDomainReadFinishedTableCnt >= CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT) {
+		return(RET_EVENT_NO_RESSOURCE);
+	}
+
+	sdoServerDomainReadFinishedTable[sdoServerDomainReadFinishedTableCnt] = pFunction;
+	sdoServerDomainReadFinishedTableCnt++;
+
+	return(RET_OK);
+}
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
+
+
 /***************************************************************************/
 /**
 * \internal
@@ -1741,6 +1836,36 @@ UNSIGNED32		domainBufSize;	/* domain buffer size */
 }
 
 
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief icoSdoDomainUserReadFinishedInd - user domain read finished indication
+*
+* \return none
+*
+*/
+void icoSdoDomainUserReadFinishedInd(
+		const CO_SDO_SERVER_T	*pSdo,		/* pointer to sdo */
+		RET_T					result		/* RET_OK or abort reason */
+    )
+{
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT
+UNSIGNED8    cnt;
+
+	cnt = sdoServerDomainReadFinishedTableCnt;
+	while (cnt > 0u)  {
+		cnt--;
+		sdoServerDomainReadFinishedTable[cnt](pSdo->index, pSdo->subIndex,
+			pSdo->domainTransferedSize, result);
+	}
+#else /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
+(void)pSdo;
+(void)result;
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT */
+}
+
+
 /******************************************************************************/
 /******************************************************************************/
 /******************************************************************************/
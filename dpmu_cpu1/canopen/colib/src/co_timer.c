@@ -373,6 +373,23 @@ UNSIGNED32	ticks;
 }
 
 
+/***************************************************************************/
+/**
+* \internal
+*
+* \brief icoTimerGetInterval - get timer interval
+*
+* \return timer interval in usec
+*
+*/
+UNSIGNED32 icoTimerGetInterval(
+		void	/* no parameter */
+	)
+{
+	return(timerInterVal);
+}
+
+
 /***************************************************************************/
 /**
 * \brief coTimerInit - init timer interval
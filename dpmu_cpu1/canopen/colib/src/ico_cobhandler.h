@@ -74,7 +74,6 @@ typedef struct {
 	UNSIGNED16		serviceNr;		/* service number */
 	UNSIGNED16		inhibit;		/* inhibit time */
 	UNSIGNED8		len;			/* msg len */
-	CO_TIMER_T		inhibitTimer;	/* inhibit timer */
 } CO_COB_T;
 
 
@@ -27,6 +27,12 @@
 
 #define CO_PDO_MAX_DATA_LEN	CO_CAN_MAX_DATA_LEN
 
+/* on 16 bit DSPs byte aligned numeric map entries are packed word by word */
+#if defined(CO_CPU_DSP) && !defined(CO_BIG_ENDIAN) \
+ && !defined(CO_DYNAMIC_OD_PTR_REFRESH)
+# define CO_PDO_PACK_PROG	1u
+#endif /* defined(CO_CPU_DSP) && !defined(CO_BIG_ENDIAN) ... */
+
 
 # if defined(CO_PDO_TRANSMIT_CNT) || defined(CO_PDO_RECEIVE_CNT)
 
@@ -50,10 +56,36 @@ typedef enum {
 #endif /* defined(CO_MPDO_PRODUCER) | defined(CO_MPDO_CONSUMER) */
 
 
+#ifdef CO_PDO_PACK_PROG
+typedef enum {
+	CO_PDO_PACK_GENERIC,	/* bit mapped or not numeric, coNumMemcpy..() */
+	CO_PDO_PACK_U8,			/* one byte, low half of the word */
+	CO_PDO_PACK_U16,		/* one word */
+	CO_PDO_PACK_U32,		/* two words */
+	CO_PDO_PACK_WORDS		/* other byte aligned numeric lengths */
+} CO_PDO_PACK_OP_T;
+
+/* pack/unpack program, compiled from the mapping table when it is set up */
+typedef struct {
+	UNSIGNED8		op;			/* CO_PDO_PACK_OP_T */
+	UNSIGNED8		offs;		/* byte offset in the frame */
+	UNSIGNED8		len;		/* length in bytes */
+} CO_PDO_PACK_STEP_T;
+
+typedef struct {
+	CO_PDO_PACK_STEP_T	step[CO_MAX_MAP_ENTRIES];
+	UNSIGNED8		stepCnt;	/* mapping entries compiled */
+} CO_PDO_PACK_PROG_T;
+#endif /* CO_PDO_PACK_PROG */
+
+
 typedef struct {
 	UNSIGNED32		cobId;
 	CO_CONST PDO_TR_MAP_TABLE_T	*mapTableConst;
 	PDO_TR_MAP_TABLE_T	*mapTable;
+#ifdef CO_PDO_PACK_PROG
+	CO_PDO_PACK_PROG_T	packProg;
+#endif /* CO_PDO_PACK_PROG */
 	CO_TIMER_T		pdoTimer;
 	CO_PDO_STATE_T	state;			/* pdo state */
 	COB_REFERENZ_T	cob;
@@ -78,6 +110,9 @@ typedef struct {
 	UNSIGNED32		cobId;
 	CO_CONST PDO_REC_MAP_TABLE_T	*mapTableConst;
 	PDO_REC_MAP_TABLE_T	*mapTable;
+#ifdef CO_PDO_PACK_PROG
+	CO_PDO_PACK_PROG_T	packProg;
+#endif /* CO_PDO_PACK_PROG */
 	CO_TIMER_T		pdoTimer;
 	CO_PDO_STATE_T	state;			/* pdo state */
 	COB_REFERENZ_T	cob;
@@ -100,6 +100,11 @@
 # endif /* CO_EVENT_PROFILE_SSDO_DOMAIN_READ */
 #endif /* CO_EVENT_DYNAMIC_SSDO_DOMAIN_READ */
 
+/* SDO Server Domain Read finished, one for each domain read indication */
+#ifdef CO_EVENT_SSDO_DOMAIN_READ_CNT
+# define CO_EVENT_SSDO_DOMAIN_READ_FINISHED_CNT	(CO_EVENT_SSDO_DOMAIN_READ_CNT)
+#endif /* CO_EVENT_SSDO_DOMAIN_READ_CNT */
+
 
 /* datatypes */
 
@@ -143,6 +148,7 @@ typedef struct co_sdo_server_t {
 # ifdef CO_SDO_BLOCK
 	UNSIGNED8		seqNr;			/* sequence number */
 	UNSIGNED8		blockSize;		/* max number of blocks for one transfer */
+	UNSIGNED8		blockSizeNext;	/* adapted block size for the next download */
 	BOOL_T			blockCrcUsed;	/* use CRC */
 	UNSIGNED16		blockCrc;		/* CRC */
 	UNSIGNED32		blockCrcSize;	/* size of calculated crc sum */
@@ -180,6 +186,8 @@ RET_T	icoSdoCheckUserCheckWriteInd(UNSIGNED8 sdoNr,
 			UNSIGNED32 size);
 RET_T	icoSdoDomainUserWriteInd(const CO_SDO_SERVER_T *pSdo);
 RET_T	icoSdoDomainUserReadInd(const CO_SDO_SERVER_T *pSdo);
+void	icoSdoDomainUserReadFinishedInd(const CO_SDO_SERVER_T *pSdo,
+			RET_T result);
 void	icoSdoServerAbort(CO_SDO_SERVER_T *pSdo,
 			RET_T errorReason, BOOL_T fromClient);
 
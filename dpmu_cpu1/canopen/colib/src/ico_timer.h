@@ -27,6 +27,7 @@
 /* function prototypes */
 
 void	icoTimerCheck(void);
+UNSIGNED32 icoTimerGetInterval(void);
 
 #endif /* ICO_TIMER_H */
 
@@ -118,12 +118,25 @@ typedef struct States
     uint16_t State_Before_Balancing; // State before Balancing state
 } States_t;
 
+// Controller forms run by PiControllerRun() (CPU2 pi_controller.c)
+typedef enum PiForm
+{
+    PI_FORM_PARALLEL = 0,       // Parallel PI, integrator back-calculated on clamp
+    PI_FORM_SERIES_DCL,         // Series PI, integrator frozen on clamp (DCL_runPI_C2)
+    PI_FORM_PARALLEL_DCL,       // Parallel PI, integrator frozen on clamp (DCL_runPI_C3)
+    PI_FORM_PID_FILTERED        // Parallel PID, filtered derivative on measurement (DCL_runPID_C2)
+} PiForm_t;
+
+// Controller state, updated in place by PiControllerRun()
 typedef struct PiOutput
 {
     float Output;
     float Int_out;
     float calculated_error;
     uint16_t dutyCycle;
+    uint16_t clamped;   // Output was saturated on last update
+    float Deriv_d2;     // Derivative filter storage 1
+    float Deriv_d3;     // Derivative filter storage 2
 } PiOutput_t;
 
 typedef struct PI_Parameters
@@ -132,6 +145,10 @@ typedef struct PI_Parameters
     float Pgain;        // Proportion gain
     float UpperLimit;   // PI Output Upper Limit
     float LowerLimit;   // PI Output Lower Limit
+    float Dgain;        // Derivative gain, PI_FORM_PID_FILTERED only
+    float DfilterC1;    // Derivative filter coefficient 1, see PiControllerSetDerivativeFilter()
+    float DfilterC2;    // Derivative filter coefficient 2
+    uint16_t form;      // PiForm_t
 } PI_Parameters_t;
 
 
@@ -0,0 +1,116 @@
+/*
+ * cpu2_log.h
+ *
+ *  Single producer/single consumer ring carrying CPU2 debug output to CPU1.
+ *
+ *  CPU2 writes binary records into a ring in CPU2 to CPU1 message RAM and
+ *  never waits for CPU1. CPU1 reads the records from its super loop, formats
+ *  them and forwards them to the CLI serial port. The write index and the
+ *  counters are written by CPU2 only, the read index lives in
+ *  sharedVars_cpu1toCpu2 and is written by CPU1 only.
+ *
+ *  Record layout, in 16 bit words:
+ *      id, length of the arguments in words, timestamp low, timestamp high,
+ *      arguments
+ *  The timestamp is the low 32 bits of the IPC counter. A CPU2_LOG_TEXT
+ *  record carries a preformatted string packed two characters per word, the
+ *  other records carry one 32 bit word per conversion of their format string.
+ *
+ *  Only the CPU2 super loop writes the ring. Interrupt service routines post
+ *  events to a latch per id, the super loop moves them into the ring, so no
+ *  record is copied with interrupts disabled. Text that does not fit while a
+ *  CLI command runs goes to a backlog in CPU2 RAM, drained by the super loop
+ *  as CPU1 frees the ring.
+ */
+
+#ifndef COMMON_INC_CPU2_LOG_H_
+#define COMMON_INC_CPU2_LOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+#define CPU2_LOG_RING_SIZE      1024    /* words, power of two */
+#define CPU2_LOG_RING_MASK      (CPU2_LOG_RING_SIZE - 1)
+#define CPU2_LOG_HEADER_WORDS   4
+#define CPU2_LOG_MAX_ARGS       6
+#define CPU2_LOG_MAX_TEXT       MAX_CPU2_DBG_LEN
+#define CPU2_LOG_BACKLOG_SIZE   2048    /* words, power of two */
+
+/*
+ * Orders the record stores before the store of the index that publishes
+ * them to the other core, and the index load before the record loads.
+ */
+#if defined(__TMS320C28XX__)
+#define CPU2_LOG_BARRIER()      __asm(" RPT #7 || NOP")
+#else
+#define CPU2_LOG_BARRIER()      __sync_synchronize()
+#endif
+
+/* record ids and their format strings, CPU1 formats the records with these */
+#define CPU2_LOG_FORMATS(X) \
+    X(CPU2_LOG_TEXT,                "%s") \
+    X(CPU2_LOG_BUS_SHORT_CIRCUIT,   "ISen1f:[%5.2f]  or ISen2f:[%5.2f] or IF_1fIdx:[%5.2f] > SHORT_CIRCUIT_CURRENT:[%5.2f]\r\n") \
+    X(CPU2_LOG_LOAD_OVER_CURRENT,   "sensorVector[ISen1fIdx]:[%5.2f] max_allowed_load_current:[%5.2f] ") \
+    X(CPU2_LOG_BUS_OVER_VOLTAGE,    "DCDC_VI.avgVBus[%5.2f] max_allowed_dc_bus_voltage:[%5.2f]\r\n ") \
+    X(CPU2_LOG_BUS_UNDER_VOLTAGE,   "DCDC_VI.avgVBus[%5.2f] < min_allowed_dc_bus_voltage:[%5.2f]\r\n ")
+
+#define CPU2_LOG_ENUM(id, fmt) id,
+
+typedef enum cpu2_log_id {
+    CPU2_LOG_FORMATS(CPU2_LOG_ENUM)
+    CPU2_LOG_NUM_OF_IDS
+} cpu2_log_id_t;
+
+typedef struct cpu2_log_ring {
+    volatile uint16_t head;             /* next word to write, free running */
+    uint16_t reserved;
+    volatile uint32_t records;          /* records written */
+    volatile uint32_t dropped;          /* records dropped, ring or backlog full */
+    volatile uint16_t buffer[CPU2_LOG_RING_SIZE];
+} cpu2_log_ring_t;
+
+extern cpu2_log_ring_t cpu2_log_ring;
+
+/* float argument of CPU2_LOG_EVENT() */
+static inline uint32_t cpu2_log_float(float value)
+{
+    union {
+        float f;
+        uint32_t u;
+    } arg;
+
+    arg.f = value;
+    return arg.u;
+}
+
+/*
+ * CPU2 side
+ *
+ * CPU2_LOG_EVENT() may be called from interrupt context, each id from one
+ * context only. Every argument is one uint32_t, use cpu2_log_float() for
+ * floats. An event posted again before the super loop has moved the earlier
+ * one into the ring is dropped.
+ */
+#define CPU2_LOG_EVENT(id, ...) \
+    do { \
+        const uint32_t cpu2LogArgs[] = { __VA_ARGS__ }; \
+        cpu2_log_event((id), cpu2LogArgs, sizeof(cpu2LogArgs) / sizeof(cpu2LogArgs[0])); \
+    } while (0)
+
+void cpu2_log_init(void);
+bool cpu2_log_event(uint16_t id, const uint32_t *args, uint16_t nargs);
+bool cpu2_log_text(const char *text, uint16_t len);
+void cpu2_log_printf(const char *fmt, ...);
+void cpu2_log_set_deferred(bool deferred);
+void cpu2_log_poll(void);
+
+/* CPU1 side */
+#define CPU2_LOG_RECORDS_PER_POLL   4   /* records forwarded per super loop pass */
+
+void cpu2_log_reader_init(void);
+uint16_t cpu2_log_process(uint16_t maxRecords);
+void cpu2_log_print_stats(void);
+
+#endif /* COMMON_INC_CPU2_LOG_H_ */
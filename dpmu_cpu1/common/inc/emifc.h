@@ -41,12 +41,59 @@ typedef struct {
 
 extern unsigned char message[TRANSFER_SIZE];
 
+#define EMIFC_DMA_BURST_WORDS   32      /* largest DMA burst */
+#define EMIFC_QUEUE_LEN         8       /* power of two */
+
+// Called from the DMA interrupt when a queued transfer is done.
+typedef void (*emifc_callback_t)(void *context);
+
+typedef struct {
+    bool write;                 /* data -> address, else address -> data */
+    uint32_t address;
+    uint16_t cpuType;
+    uint16_t *data;
+    uint32_t size;              /* 16 bit words */
+    uint32_t done;              /* words handed to the DMA */
+    emifc_callback_t callback;
+    void *context;
+} emifc_request_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t completed;
+    uint32_t bursts;
+    uint32_t full;              /* requests refused, queue full */
+    uint32_t claims;            /* EMIF1 master claims, one per batch */
+    uint32_t claimRetries;      /* batch start deferred, CPU2 had EMIF1 */
+    uint32_t isrCycles;
+    uint32_t maxIsrCycles;
+    uint16_t maxDepth;
+} emifc_stats_t;
+
+extern emifc_stats_t emifc_stats;
+
 //bool emifc_execute();
 void emifc_set_cpun_as_master(EMIF1_Config* emif1);
 void emifc_realease_cpun_as_master(uint16_t cpuType);
 void emifc_cpu_write_memory(EMIF1_Config* emif1);
 void emifc_cpu_read_memory(EMIF1_Config* emif1);
 
+/*
+ * Queue transfers without waiting, size in 16 bit words. The buffer must
+ * stay valid until the callback, which may be NULL, is called. Transfers
+ * are done in the order they are queued. Return false if the queue is full.
+ * emifc_cpu_write_memory() and emifc_cpu_read_memory() queue and wait.
+ */
+bool emifc_queue_write(uint32_t address, const uint16_t *data, uint32_t size,
+                       emifc_callback_t callback, void *context);
+bool emifc_queue_read(uint32_t address, uint16_t *data, uint32_t size,
+                      emifc_callback_t callback, void *context);
+bool emifc_idle(void);
+void emifc_task(void);
+// Callback setting the volatile bool the context points to.
+void emifc_set_flag(void *context);
+void emifc_print_stats(void);
+
 //void emifc_pinmux_setup_flash(void);
 //uint16_t emifc_write_flash_data(uint32_t startAddr, uint32_t memSize);
 //uint16_t emifc_read_flash_data(uint32_t startAddr, uint32_t memSize);
@@ -50,8 +50,6 @@ typedef struct sharedVars_cpu1toCpu2_t // commonCpu1ToCpu2
 
     bool having_battery;    /* true for Lithium Battery, false for Super Capacitors */
 
-    bool debug_log_disable_flag;
-
     bool dpmu_default_flag;
 
     bool QsbSwitchRequestState;
@@ -70,6 +68,9 @@ typedef struct sharedVars_cpu1toCpu2_t // commonCpu1ToCpu2
     float input_short_circuit_current;
     float output_short_circuit_current;
 
+    uint16_t state_machine_stats_reset;     /* incremented to reset state_machine_stats */
+    volatile uint16_t cpu2_log_tail;        /* read index of cpu2_log_ring, written by CPU1 only */
+
 } sharedVars_cpu1toCpu2_t;
 
 extern struct sharedVars_cpu1toCpu2_t sharedVars_cpu1toCpu2;
@@ -85,9 +86,54 @@ typedef struct shared_energy_bank
     float    cellVoltageAfterFirstCharge[30];
 } shared_energy_bank_t;
 
+/* Main state machine instrumentation, updated by CPU2 every slow task tick.
+ * Read out as is through the OD domain 0x4012:1 */
+#define SM_STATS_MAX_STATES         32
+#define SM_STATS_MAX_TRANSITIONS    48
+#define SM_STATS_HISTOGRAM_BINS     8
+#define SM_STATS_HISTOGRAM_BIN0     256     /* bin n: cycles < (SM_STATS_HISTOGRAM_BIN0 << n), last bin the rest */
+
+typedef struct sm_state_stats
+{
+    uint32_t entries;               /* times the state was entered */
+    uint32_t ticks;                 /* slow task ticks spent in the state, one do-handler run each */
+    uint32_t minCycles;             /* do-handler execution time, SYSCLK cycles */
+    uint32_t maxCycles;
+    uint32_t meanCycles;
+    uint16_t state;                 /* Operating_state */
+    uint16_t histogram[SM_STATS_HISTOGRAM_BINS];
+} sm_state_stats_t;
+
+typedef struct sm_transition_stats
+{
+    uint32_t count;
+    uint16_t from;                  /* Operating_state */
+    uint16_t to;                    /* Operating_state */
+} sm_transition_stats_t;
+
+typedef struct state_machine_stats
+{
+    uint16_t numOfStates;
+    uint16_t numOfTransitions;
+    uint32_t forcedTransitions;     /* IOP requests, safe state and error handling */
+    sm_state_stats_t state[SM_STATS_MAX_STATES];
+    sm_transition_stats_t transition[SM_STATS_MAX_TRANSITIONS];
+} state_machine_stats_t;
+
+/* Latest debug log record from CPU2, double buffered and sequence locked.
+ * CPU2 fills the buffer that is not published, its sequence number is odd
+ * meanwhile, and then publishes it in one pass. CPU1 copies the published
+ * buffer and retries if its sequence number changed during the copy. */
+typedef struct debug_log_snapshot
+{
+    volatile uint16_t published;    /* buffer holding the latest complete record */
+    volatile uint16_t sequence[2];  /* per buffer, odd while CPU2 writes it */
+    debug_log_t record[2];
+} debug_log_snapshot_t;
+
 typedef struct sharedVars_cpu2toCpu1_t // commonCpu2ToCpu1
 {
-    debug_log_t debug_log;
+    debug_log_snapshot_t debug_log;
     uint16_t current_state;
     uint16_t error_code;
 
@@ -122,6 +168,8 @@ typedef struct sharedVars_cpu2toCpu1_t // commonCpu2ToCpu1
     shared_energy_bank_t energy_bank;
 
     bool faultOccured;
+
+    state_machine_stats_t state_machine_stats;
 } sharedVars_cpu2toCpu1_t;
 
 
@@ -16,12 +16,12 @@
 #include "emifc.h"
 #include "serial.h"
 #include "ext_flash.h"
+#include "main.h"
 
 static uint16_t configMaster = 0;
 
 uint16_t errCountGlobalCPU1 = 0U;
 uint32_t testStatusGlobalCPU1;
-uint32_t i, iter;
 
 #define MEM_RW_ITER    0x1U
 
@@ -32,10 +32,109 @@ uint32_t i, iter;
 unsigned char message[TRANSFER_SIZE];
 
 
-volatile int dma_test_xfer_done;
+/* queued transfers, the DMA interrupt starts the next burst
+ *
+ * A transfer is moved in bursts of EMIFC_DMA_BURST_WORDS words, each burst
+ * started by the completion interrupt of the one before it. EMIF1 is
+ * claimed when the first transfer of a batch starts and released when the
+ * queue runs empty. The claim is tried once, with interrupts disabled it
+ * must not wait for CPU2 to let go of EMIF1. A batch that does not get
+ * EMIF1 stays queued and emifc_task() tries again.
+ */
+static emifc_request_t l_queue[EMIFC_QUEUE_LEN];
+static volatile uint16_t l_queue_head = 0;      /* next free entry */
+static volatile uint16_t l_queue_tail = 0;      /* transfer in progress */
+static volatile bool l_queue_active = false;    /* DMA is running a burst */
+static uint16_t l_claimed_cpu = 0;              /* EMIF1 master claimed for the batch */
+
+emifc_stats_t emifc_stats;
+
+static inline uint16_t emifc_queue_depth(void)
+{
+    return (l_queue_head - l_queue_tail) & (2 * EMIFC_QUEUE_LEN - 1);
+}
+
+/* grabs EMIF1 for cpuType, false if the other CPU holds it */
+static bool emifc_claim_master(uint16_t cpuType)
+{
+    uint16_t master = (cpuType == CPU_TYPE_ONE) ? EMIF_MASTER_CPU1_G : EMIF_MASTER_CPU2_G;
+
+    if (l_claimed_cpu == cpuType) {
+        return true;
+    }
+    EMIF_selectMaster(EMIF1CONFIG_BASE, master);
+    if (HWREGH(EMIF1CONFIG_BASE + MEMCFG_O_EMIF1MSEL) != master) {
+        emifc_stats.claimRetries++;
+        return false;
+    }
+    l_claimed_cpu = cpuType;
+    emifc_stats.claims++;
+    return true;
+}
+
+static void emifc_release_master(void)
+{
+    if (l_claimed_cpu != 0) {
+        emifc_realease_cpun_as_master(l_claimed_cpu);
+    }
+    l_claimed_cpu = 0;
+}
+
+/* starts the next burst, calls back finished transfers, interrupts disabled */
+static void emifc_next_burst(void)
+{
+    emifc_request_t *request;
+    uint32_t words;
+
+    while (emifc_queue_depth() > 0) {
+        request = &l_queue[l_queue_tail & (EMIFC_QUEUE_LEN - 1)];
+
+        if (request->done < request->size) {
+            if (!emifc_claim_master(request->cpuType)) {
+                /* left queued for emifc_task() */
+                l_queue_active = false;
+                return;
+            }
+
+            words = request->size - request->done;
+            if (words > EMIFC_DMA_BURST_WORDS) {
+                words = EMIFC_DMA_BURST_WORDS;
+            }
+            /* step size of 1 word in the source and the destination */
+            DMA_configBurst(CPU1_EXT_MEM_BASE, (uint16_t)words, 1, 1);
+            if (request->write) {
+                DMA_configAddresses(CPU1_EXT_MEM_BASE, (const void *)(request->address + request->done),
+                                    (const void *)(request->data + request->done));
+            } else {
+                DMA_configAddresses(CPU1_EXT_MEM_BASE, (const void *)(request->data + request->done),
+                                    (const void *)(request->address + request->done));
+            }
+            request->done += words;
+            l_queue_active = true;
+            emifc_stats.bursts++;
+
+            DMA_startChannel(CPU1_EXT_MEM_BASE);
+            DMA_forceTrigger(CPU1_EXT_MEM_BASE);
+            return;
+        }
+
+        /* free the entry first, the callback may queue the next transfer */
+        l_queue_tail = (l_queue_tail + 1) & (2 * EMIFC_QUEUE_LEN - 1);
+        emifc_stats.completed++;
+        if (request->callback != NULL) {
+            request->callback(request->context);
+        }
+    }
+
+    l_queue_active = false;
+    emifc_release_master();
+}
 
 void INT_CPU1_EXT_MEM_ISR(void)
 {
+    uint32_t start = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R);
+    uint32_t cycles;
+
     // Stop DMA channel.
     DMA_stopChannel(CPU1_EXT_MEM_BASE);
 
@@ -44,11 +143,126 @@ void INT_CPU1_EXT_MEM_ISR(void)
     Interrupt_clearACKGroup(INT_CPU1_EXT_MEM_INTERRUPT_ACK_GROUP);
     EDIS;
 
-    dma_test_xfer_done = 1; // Test done.
+    emifc_next_burst();
+
+    cycles = (uint32_t)IPC_getCounter(IPC_CPU1_L_CPU2_R) - start;
+    emifc_stats.isrCycles += cycles;
+    if (cycles > emifc_stats.maxIsrCycles) {
+        emifc_stats.maxIsrCycles = cycles;
+    }
 
     return;
 }
 
+/**
+ * @brief  Queues a transfer between internal RAM and EMIF1
+ * @return false if the queue is full
+ */
+static bool emifc_queue(bool write, uint32_t address, uint16_t cpuType, uint16_t *data, uint32_t size,
+                        emifc_callback_t callback, void *context)
+{
+    emifc_request_t *request;
+    uint16_t depth;
+    uint16_t val;
+
+    val = __disable_interrupts();
+
+    depth = emifc_queue_depth();
+    if (depth >= EMIFC_QUEUE_LEN) {
+        emifc_stats.full++;
+        if (!(val & 1)) {
+            __enable_interrupts();
+        }
+        return false;
+    }
+
+    request = &l_queue[l_queue_head & (EMIFC_QUEUE_LEN - 1)];
+    request->write = write;
+    request->address = address;
+    request->cpuType = cpuType;
+    request->data = data;
+    request->size = size;
+    request->done = 0;
+    request->callback = callback;
+    request->context = context;
+    l_queue_head = (l_queue_head + 1) & (2 * EMIFC_QUEUE_LEN - 1);
+
+    emifc_stats.requests++;
+    if (depth + 1 > emifc_stats.maxDepth) {
+        emifc_stats.maxDepth = depth + 1;
+    }
+
+    if (!l_queue_active) {
+        emifc_next_burst();
+    }
+
+    if (!(val & 1)) {
+        __enable_interrupts();
+    }
+    return true;
+}
+
+bool emifc_queue_write(uint32_t address, const uint16_t *data, uint32_t size,
+                       emifc_callback_t callback, void *context)
+{
+    return emifc_queue(true, address, CPU_TYPE_ONE, (uint16_t *)data, size, callback, context);
+}
+
+bool emifc_queue_read(uint32_t address, uint16_t *data, uint32_t size,
+                      emifc_callback_t callback, void *context)
+{
+    return emifc_queue(false, address, CPU_TYPE_ONE, data, size, callback, context);
+}
+
+bool emifc_idle(void)
+{
+    return emifc_queue_depth() == 0;
+}
+
+/**
+ * @brief  Starts queued transfers held back because CPU2 had EMIF1
+ * Called from the super loop and while waiting for a transfer.
+ */
+void emifc_task(void)
+{
+    uint16_t val;
+
+    if (l_queue_active || (emifc_queue_depth() == 0)) {
+        return;
+    }
+
+    val = __disable_interrupts();
+    if (!l_queue_active) {
+        emifc_next_burst();
+    }
+    if (!(val & 1)) {
+        __enable_interrupts();
+    }
+}
+
+/* callback setting the volatile bool the context points to */
+void emifc_set_flag(void *context)
+{
+    *(volatile bool *)context = true;
+}
+
+/* queues a transfer and waits for it, the interrupt must be enabled */
+static void emifc_transfer_blocking(bool write, EMIF1_Config* emif1)
+{
+    volatile bool done = false;
+
+    while (!emifc_queue(write, emif1->address, emif1->cpuType, (uint16_t *)emif1->data, emif1->size, emifc_set_flag, (void *)&done))
+    {
+        asm(" RPT #255 || NOP");
+        emifc_task();
+    }
+    while (!done)
+    {
+        asm(" RPT #255 || NOP");
+        emifc_task();
+    }
+}
+
 void emifc_set_cpun_as_master(EMIF1_Config* emif1)
 {
     if (emif1->cpuType == CPU_TYPE_ONE && configMaster == 0){
@@ -79,129 +293,23 @@ void emifc_realease_cpun_as_master(uint16_t cpuType)
 
 void emifc_cpu_write_memory(EMIF1_Config* emif1)
 {
-    uint16_t max_dma_transfer_size = 32;
-    uint16_t number_of_tranfers = 1;
-    uint16_t remaining_bytes_to_transfer, current_transfer_size;
-    const void *src_address, *dest_address;
-    /* set CPUn as master for memory */
-    emifc_set_cpun_as_master(emif1);
-
-    configMaster = 1;
-
-//    /*** backup solution ***/
-//    uint16_t* memPtr = (uint16_t *)emif1->address;
-//
-//    for(uint32_t i = 0U; i < emif1->size; i++) {
-//        *(memPtr+i) = emif1->data[i];
-//    }
-
-//    /*** secondary solution - memcpy() ***/
-//    memcpy((volatile uint32_t*)emif1->address, (volatile uint16_t*)emif1->data, emif1->size);
-
-
-    number_of_tranfers = emif1->size / max_dma_transfer_size;
-
-    remaining_bytes_to_transfer = emif1->size;
-    src_address = (const void*)emif1->data;
-    dest_address = (const void*)emif1->address;
-    for( i=0; i <= number_of_tranfers; i++){
-        if( remaining_bytes_to_transfer >= max_dma_transfer_size) {
-            current_transfer_size = max_dma_transfer_size;
-            remaining_bytes_to_transfer = remaining_bytes_to_transfer - max_dma_transfer_size;
-        } else {
-            current_transfer_size = remaining_bytes_to_transfer;
-        }
-        /*** preferred solution - DMA ***/
-        dma_test_xfer_done = 0;
-
-        /* configure the burst
-         * base address for the DMA channel
-         * size of the data to be transmitted
-         * step size of address in the source address
-         * step size of address in the destination address
-         * */
-        //DMA_configBurst(CPU1_EXT_MEM_BASE, emif1->size, 1, 1);
-        DMA_configBurst(CPU1_EXT_MEM_BASE, current_transfer_size, 1, 1);
-        DMA_configAddresses(CPU1_EXT_MEM_BASE, dest_address, src_address);
-        DMA_startChannel(CPU1_EXT_MEM_BASE);
-        DMA_forceTrigger(CPU1_EXT_MEM_BASE);
-
-        /* Wait for DMA do finish */
-        /* CONTROL register, bit TRANSFERSTS, '1' = transfer active */
-        //  while (HWREGB(CPU1_EXT_MEM_BASE) & (1<<11)) //DmaRegs.CH2.CONTROL.bit.TRANSFERSTS
-        while (!dma_test_xfer_done)
-        {
-            asm(" RPT #255 || NOP");
-        }
-        src_address = src_address + current_transfer_size;
-        dest_address = dest_address + current_transfer_size;
-    }
-    // Release EMIF1
-    EMIF_selectMaster(EMIF1CONFIG_BASE, EMIF_MASTER_CPU1_NG);
+    emifc_transfer_blocking(true, emif1);
 }
 
 void emifc_cpu_read_memory(EMIF1_Config* emif1)
 {
-    uint16_t max_dma_transfer_size = 32;
-    uint16_t number_of_tranfers = 1;
-    uint16_t remaining_words_to_transfer, current_transfer_size;
-    const void *src_address, *dest_address;
-    emifc_set_cpun_as_master(emif1);
-
-    configMaster = 1;
-
-//    /*** backup solution ***/
-//    uint16_t* memPtr = (uint16_t *)emif1->address;
-//    for(i = 0U; i < emif1->size; i++){
-//        emif1->data[i] = *(memPtr + i);
-//    }
-
-    /*** secondary solution - memcpy() ***/
-    //memcpy((volatile uint16_t*)emif1->data, (volatile uint32_t*)emif1->address, emif1->size);
-
-
-    number_of_tranfers = emif1->size / max_dma_transfer_size;
-    remaining_words_to_transfer = emif1->size;
-    dest_address = (const void*)emif1->data;
-    src_address = (const void*)emif1->address;
-    for( i=0; i <= number_of_tranfers; i++){
-        if( remaining_words_to_transfer >= max_dma_transfer_size) {
-            current_transfer_size = max_dma_transfer_size;
-            remaining_words_to_transfer = remaining_words_to_transfer - max_dma_transfer_size;
-        } else {
-            current_transfer_size = remaining_words_to_transfer;
-        }
+    emifc_transfer_blocking(false, emif1);
+}
 
-        if( remaining_words_to_transfer == 0) {
-            break;
-        }
-        /*** preferred solution - DMA ***/
-        dma_test_xfer_done = 0;
-
-        /* configure the burst
-         * base address for the DMA channel
-         * size of the data to be transmitted
-         * step size of address in the source address
-         * step size of address in the destination address
-         * */
-        //DMA_configBurst(CPU1_EXT_MEM_BASE, emif1->size, 1, 1);
-        DMA_configBurst(CPU1_EXT_MEM_BASE, current_transfer_size, 1, 1);
-        DMA_configAddresses(CPU1_EXT_MEM_BASE, dest_address, src_address);
-        DMA_startChannel(CPU1_EXT_MEM_BASE);
-        DMA_forceTrigger(CPU1_EXT_MEM_BASE);
-
-        /* Wait for DMA do finish */
-        /* CONTROL register, bit TRANSFERSTS, '1' = transfer active */
-        //    while (HWREGB(CPU1_EXT_MEM_BASE) & (1<<11)) //DmaRegs.CH2.CONTROL.bit.TRANSFERSTS
-        while (!dma_test_xfer_done)
-        {
-            asm(" RPT #255 || NOP");
-        }
-        src_address = src_address + current_transfer_size;
-        dest_address = dest_address + current_transfer_size;
-    }
-    // Release EMIF1
-    EMIF_selectMaster(EMIF1CONFIG_BASE, EMIF_MASTER_CPU1_NG);
+void emifc_print_stats(void)
+{
+    Serial_printf(&cli_serial, " requests: %lu, completed: %lu, bursts: %lu, queue full: %lu\r\n",
+                  emifc_stats.requests, emifc_stats.completed, emifc_stats.bursts, emifc_stats.full);
+    Serial_printf(&cli_serial, " queue: %u/%u, max: %u, EMIF1 claims: %lu, held by CPU2: %lu\r\n",
+                  emifc_queue_depth(), EMIFC_QUEUE_LEN, emifc_stats.maxDepth, emifc_stats.claims,
+                  emifc_stats.claimRetries);
+    Serial_printf(&cli_serial, " interrupt: %lu cycles per burst, max %lu cycles\r\n",
+                  (emifc_stats.bursts > 0) ? (emifc_stats.isrCycles / emifc_stats.bursts) : 0, emifc_stats.maxIsrCycles);
 }
 
 void emifc_pinConfiguration(){
@@ -5,6 +5,7 @@
  *      Author: Henrik Borg henrik.borg@ekpower.se hb
  */
 
+#include "cpu2_log.h"
 #include "shared_variables.h"
 
 #pragma RETAIN(sharedVars_cpu1toCpu2)
@@ -17,3 +18,9 @@ sharedVars_cpu1toCpu2_t sharedVars_cpu1toCpu2 = {0};
 sharedVars_cpu2toCpu1_t sharedVars_cpu2toCpu1 = {0};
 
 
+/* not initialized, both cores initialize their own part of the ring */
+#pragma RETAIN(cpu2_log_ring)
+#pragma DATA_SECTION(cpu2_log_ring, "MSGRAM_CPU2_TO_CPU1_LOG")
+cpu2_log_ring_t cpu2_log_ring;
+
+
@@ -53,7 +53,8 @@ MEMORY
 //   FLASH13_RSVD     : origin = 0x0BFFF0, length = 0x000010  /* Reserve and do not use for code as per the errata advisory "Memory: Prefetching Beyond Valid Memory" */
 
    CPU1TOCPU2RAM   : origin = 0x03A000, length = 0x000800
-   CPU2TOCPU1RAM   : origin = 0x03B000, length = 0x000800
+   CPU2TOCPU1RAM   : origin = 0x03B000, length = 0x000300
+   CPU2TOCPU1RAM_LOG : origin = 0x03B300, length = 0x000500
 
    CPUTOCMRAM      : origin = 0x039000, length = 0x000800
    CMTOCPURAM      : origin = 0x038000, length = 0x000800
@@ -103,6 +104,7 @@ SECTIONS
 
    MSGRAM_CPU1_TO_CPU2 : > CPU1TOCPU2RAM, type=NOINIT
    MSGRAM_CPU2_TO_CPU1 : > CPU2TOCPU1RAM, type=NOINIT
+   MSGRAM_CPU2_TO_CPU1_LOG : > CPU2TOCPU1RAM_LOG, type=NOINIT
    MSGRAM_CPU_TO_CM    : > CPUTOCMRAM, type=NOINIT
    MSGRAM_CM_TO_CPU    : > CMTOCPURAM, type=NOINIT
 
@@ -15,6 +15,7 @@
 
 
 #include <math.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "board.h"
@@ -29,7 +30,8 @@
 void StartCllcControlLoop(uint16_t cellNr);
 void CllcControlLoop(uint16_t cellNr );
 void StopCllcControlLoop();
-PiOutput_t Pi_ControllerCllCFloat(PI_Parameters_t PI, PiOutput_t PIout, float Ref, float ValueRead);
+bool CllcControlLoopActive(void);
+uint16_t CllcControlLoopCellNr(void);
 extern PI_Parameters_t CellDischargePiParameter;
 
 
@@ -23,6 +23,7 @@
 
 
 #define TRACK_SENSOR_BUFFER_SIZE 128
+#define BOOST_CURRENT_AVG_WINDOW 25    /* samples of the fast path */
 
 #define MAXIMUM_INPUT_CURRENT 18.5
 #define MAXIMUM_BB_CURRENT 18.5
@@ -36,11 +37,10 @@ void DCDCInitializePWMForRegulateVoltage(void);
 void DCDC_current_boost_loop_float( void );
 void DCDC_voltage_pure_boost_loop_float( void );
 bool calculate_boost_current(void);
-PiOutput_t Pi_ControllerBoostFloat(PI_Parameters_t PI, PiOutput_t PIout, float Ref, float ValueRead);
-PiOutput_t Pi_ControllerBuckFloat(PI_Parameters_t PI, PiOutput_t PIout, float Ref, float ValueRead  );
 
 
 void DCDCConverterInit(void);
+void DCDCRegulateAveragesReset(void);
 void AdjustPulseBasedOnSupercapVoltage( void );
 void ResetPulseStateAdjust();
 uint16_t CalculateCurrentOffset(uint16_t Offsetinput);
@@ -8,17 +8,54 @@
 #ifndef APP_INC_BALANCING_H_
 #define APP_INC_BALANCING_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #define CELL_VOLTAGE_RATIO_LOW_THRESHOLD (2.7 / 3.0)  //0.90
 #define CELL_VOLTAGE_RATIO_HIGH_THRESHOLD (2.90 / 3.0) //0.967
 
+/* cell voltage scanner statistics, counts are state machine counts */
+typedef struct CellScanStats {
+    uint32_t scans;
+    uint32_t lastScanCounts;
+    uint32_t minScanCounts;
+    uint32_t maxScanCounts;
+    uint32_t lastScanTime;      /* ms */
+    uint32_t settleTimeouts;    /* cells sampled without having converged */
+    uint16_t minSettleCounts;
+    uint16_t maxSettleCounts;
+    uint16_t meanSettleCounts;  /* of the last scan */
+} CellScanStats_t;
 
+/* discharge windows of the balancing planner, ms */
+#define BALANCING_WINDOW_FIRST  5000    /* until the discharge rate has been measured */
+#define BALANCING_WINDOW_MIN    1000
+#define BALANCING_WINDOW_MAX    120000
+#define BALANCING_WINDOW_RATIO  0.9     /* of the time to discharge the whole excess */
 
+typedef struct BalancingPlan {
+    uint16_t cellsToBalance;            /* cells left in the plan */
+    uint16_t cellNr;                    /* cell discharged last, BAT_0 when not balancing */
+    uint32_t window;                    /* ms */
+    uint32_t windows;                   /* discharge windows run in this balancing */
+    uint32_t readTime;                  /* ms to read one cell after a window */
+    uint32_t projectedTimeToBalance;    /* ms */
+    uint32_t elapsedTime;               /* ms since the first plan */
+    float dischargeRate;                /* V/ms, last measured */
+} BalancingPlan_t;
+
+extern CellScanStats_t cellScanStats;
+extern BalancingPlan_t balancingPlan;
+
+
+void CellScanStatsReset(void);
+void CellScanStatsPrint(void);
+void BalancingPlanPrint(void);
 
 void EnableContinuousReadCellVoltages();
 void DisableContinuousReadCellVoltages();
 bool StatusContinousReadCellVoltages();
 bool ReadCellVoltagesStateMachine(float *cellVoltages, float *energyBankVoltage, bool *cellVoltageOverThreshold );
+bool ReadSingleCellVoltageStateMachine(uint16_t cellNr, float *cellVoltages);
 bool BalancingAllCells();
 bool ReadCellVoltagesDone();
 
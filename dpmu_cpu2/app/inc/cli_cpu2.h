@@ -12,23 +12,21 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "cpu2_log.h"
+
 /**
  * A debug print macro.
  *
+ * Formats the text on CPU2 and puts it in the debug ring to CPU1, does not
+ * wait for CPU1. The text is dropped if the ring is full.
+ *
  * !!! MUST NOT BE CALLED FROM INTERRRUPT CONTEXT !!!
+ * Use CPU2_LOG_EVENT() in interrupt service routines.
  */
-#define PRINT(fmt, ...) \
-    do { \
-        int dbglen = snprintf(ipc_debug_msg, MAX_CPU2_DBG_LEN, fmt, ##__VA_ARGS__); \
-        ipc_debug_msg[MAX_CPU2_DBG_LEN] = '\0'; \
-        if (IPC_sendCommand(IPC_CPU2_L_CPU1_R, IPC_FLAG_CPU2_DBG, false, IPC_CPU2_PRINT, (uint32_t)&ipc_debug_msg, dbglen)) { \
-            IPC_waitForAck(IPC_CPU2_L_CPU1_R, IPC_FLAG_CPU2_DBG); \
-        } \
-    } while (0)
+#define PRINT(fmt, ...) cpu2_log_printf(fmt, ##__VA_ARGS__)
 
 // Change this later.
 extern volatile uint16_t efuse_top_half_flag;
-extern char ipc_debug_msg[];
 
 /*
  *  The following functions are defined in cli_cpu2.c
@@ -0,0 +1,86 @@
+/*
+ * control_profile.h
+ *
+ *  Control loop profiling: per-rate execution cost and CPU load of the fast
+ *  control path (ADC B ISR) and the slow supervisory task, and transient
+ *  metrics (settling time, overshoot, time-to-charge) of the regulated
+ *  states of the main state machine. Per state statistics of the supervisory
+ *  task are kept in sharedVars_cpu2toCpu1.state_machine_stats.
+ */
+
+#ifndef APP_INC_CONTROL_PROFILE_H_
+#define APP_INC_CONTROL_PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CONTROL_PROFILE_SETTLING_BAND_RATIO 0.02    /* +/-2% of reference */
+#define CONTROL_PROFILE_SETTLING_BAND_MIN   0.05    /* absolute floor, A or V */
+
+typedef enum ControlRate
+{
+    CP_RateFast = 0,    /* INT_ADCINB_4_ISR, StateMachineFastTick() */
+    CP_RateSlow,        /* super loop, StateMachine() */
+    CP_NumOfRates
+} ControlRate_t;
+
+enum ControlProfileTrackedState
+{
+    CP_ChargeRamp = 0,
+    CP_Charge,
+    CP_Regulate,
+    CP_RegulateVoltage,
+    CP_NumOfTrackedStates
+};
+
+typedef struct ControlTickCost {
+    uint64_t firstStamp;
+    uint64_t entryStamp;
+    uint32_t tickCount;
+    uint32_t lastCycles;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t sumCycles;
+    uint32_t lastPeriodCycles;
+    uint32_t minPeriodCycles;
+    uint32_t maxPeriodCycles;
+    uint32_t overruns;          /* tick cost exceeded the measured period */
+} ControlTickCost_t;
+
+typedef struct ControlTransient {
+    uint16_t state;
+    uint32_t entries;
+    uint32_t entryTick;
+    uint32_t lastOutOfBandTick;
+    uint32_t durationTicks;
+    uint32_t settlingTicks;
+    float reference;
+    float peak;
+    float overshootPercent;
+} ControlTransient_t;
+
+typedef struct ControlProfile {
+    ControlTickCost_t rate[CP_NumOfRates];
+    ControlTransient_t transient[CP_NumOfTrackedStates];
+    uint32_t chargeStartTick;
+    uint32_t timeToChargeTicks;
+    bool chargeInProgress;
+} ControlProfile_t;
+
+extern ControlProfile_t controlProfile;
+
+void ControlProfileReset(void);
+void ControlProfileRateBegin(ControlRate_t rate);
+void ControlProfileRateEnd(ControlRate_t rate);
+void ControlProfileStateTransition(uint16_t stateFrom, uint16_t stateTo);
+void ControlProfileTrackTransient(uint16_t state);
+void ControlProfilePrint(void);
+void ControlProfileCheckResetRequest(void);
+void ControlProfileStateRunBegin(void);
+void ControlProfileStateRunEnd(uint16_t stateIdx);
+void ControlProfileStateEntered(uint16_t stateIdx);
+void ControlProfileStateTransitionTaken(uint16_t transitionIdx);
+void ControlProfileStateForcedTransition(void);
+void ControlProfileStatesPrint(void);
+
+#endif /* APP_INC_CONTROL_PROFILE_H_ */
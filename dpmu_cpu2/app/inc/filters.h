@@ -0,0 +1,52 @@
+/*
+ * filters.h
+ *
+ *  Signal filters producing a new filtered value on every sample:
+ *  running-sum moving average, first order IIR and median-of-N.
+ */
+
+#ifndef APP_INC_FILTERS_H_
+#define APP_INC_FILTERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MEDIAN_FILTER_MAX_LENGTH 9
+
+typedef struct MovingAverage {
+    float *buffer;      // window storage, 'length' elements supplied by the user
+    uint16_t length;    // window length in samples
+    uint16_t idx;       // next sample to overwrite
+    uint16_t count;     // samples in window until it is filled
+    float sum;
+    float nextSum;      // sum of the samples written since the last wrap
+    float output;
+} MovingAverage_t;
+
+typedef struct Iir1 {
+    float alpha;        // y = y + alpha * (x - y), 0 < alpha <= 1
+    float output;
+    bool primed;
+} Iir1_t;
+
+typedef struct Median {
+    float buffer[MEDIAN_FILTER_MAX_LENGTH];
+    uint16_t length;
+    uint16_t idx;
+    uint16_t count;
+    float output;
+} Median_t;
+
+void MovingAverageInit(MovingAverage_t *f, float *buffer, uint16_t length);
+void MovingAverageReset(MovingAverage_t *f);
+float MovingAverageUpdate(MovingAverage_t *f, float sample);
+
+void Iir1Init(Iir1_t *f, float alpha);
+void Iir1Reset(Iir1_t *f);
+float Iir1Update(Iir1_t *f, float sample);
+
+void MedianInit(Median_t *f, uint16_t length);
+void MedianReset(Median_t *f);
+float MedianUpdate(Median_t *f, float sample);
+
+#endif /* APP_INC_FILTERS_H_ */
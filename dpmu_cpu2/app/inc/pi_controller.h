@@ -0,0 +1,20 @@
+/*
+ * pi_controller.h
+ *
+ *  Common PI/PID controller engine for the buck, boost and CLLC loops.
+ *  Works in place on PiOutput_t, see PiForm_t in GlobalV.h for the forms.
+ */
+
+#ifndef APP_INC_PI_CONTROLLER_H_
+#define APP_INC_PI_CONTROLLER_H_
+
+#include <stdint.h>
+
+#include "GlobalV.h"
+
+float PiControllerRun(const PI_Parameters_t *PI, PiOutput_t *PIout, float Ref, float ValueRead);
+void PiControllerReset(PiOutput_t *PIout);
+void PiControllerBumplessInit(const PI_Parameters_t *PI, PiOutput_t *PIout, float Output, float Ref, float ValueRead);
+void PiControllerSetDerivativeFilter(PI_Parameters_t *PI, float fc, float T);
+
+#endif /* APP_INC_PI_CONTROLLER_H_ */
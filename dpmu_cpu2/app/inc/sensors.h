@@ -16,7 +16,6 @@
 typedef struct Sensor {
     char* name;
     float realValue;
-    uint16_t counts;
     bool newADCReady;
     uint16_t maxCounts;
     float zeroVoltageOffset;
@@ -44,14 +43,29 @@ enum sensorIndex
     LastSensorIdx = VStoreIdx
 };
 
+/*
+ * Packed struct-of-arrays table used by the batch conversion kernel
+ * ConvertSensorsCountsToReal(): realValue = counts * scale + offset.
+ * scale and offset fold ADC reference, full scale, differential mode,
+ * zero voltage offset, gain and polarity of each channel and are updated
+ * by UpdateSensorConversion() whenever one of those parameters changes.
+ */
+typedef struct SensorConversionTable {
+    uint16_t counts[NumOfSensors];
+    float scale[NumOfSensors];
+    float offset[NumOfSensors];
+} SensorConversionTable_t;
+
 
 
-void ConvertCountsToReal( Sensor_t *sensor);
 inline void ConvertSensorsCountsToReal();
+void UpdateSensorConversion( uint16_t sensorIdx );
+float SensorCountsToAdcVoltage( uint16_t sensorIdx );
 void InitializeSensorParameters();
 void ReadVbusVstoreV24f();
 int CalibrateZeroVoltageOffsetOfSensors();
 
 extern Sensor_t sensorVector[NumOfSensors];
+extern SensorConversionTable_t sensorConversion;
 extern bool runStateMachineFlag;
 #endif /* APP_INC_SENSOR_H_ */
@@ -19,22 +19,59 @@
 #include "main.h"
 #include "board.h"
 
-#define DELAY_50_SM_CYCLES 50
-#define DELAY_100_SM_CYCLES 100
 #define MAX_INRUSH_DUTY_CYCLE 1.0
 #define SOFTSTART_MAX_SAFE_RETRIES 30
 #define SOFTSTART_SAFE_LIMIT_DUTY_CYCLE_RATIO 0.25
 #define SOFTSTART_MAX_SAFE_VOLTAGE_TO_INRUSH  80.0
 #define SOFTSTART_DEVIATION_FROM_STORAGE_VOLTAGE_TO_INRUSH 2.0
 #define INRUSH_DUTY_CYLE_INCREMENT 5
+/* in samples of the fast path, see StateMachineFastTick() */
+#define AVG_VSTORE_WINDOW 10
+#define AVG_VBUS_WINDOW 10
 
+/*
+ * Rate split of the main state machine.
+ * The fast path (sensor conversion, PI loops, PWM update) runs every
+ * INT_ADCINB_4_ISR, one sample period of SM_FAST_TICK_US. The slow supervisory
+ * task (StateMachine()) runs from the super loop at most once every
+ * SM_SLOW_TASK_DIVIDER fast ticks. Slow ticks the super loop was too late for
+ * are not made up, they are counted in CounterGroup.SlowTaskSkippedTicks.
+ *
+ * The delays of the supervisory task are given in sample periods and
+ * converted to slow ticks with SM_CYCLES(), so they keep their length when
+ * the divider is changed. A delay lasts at least its length, longer when slow
+ * ticks are skipped.
+ */
+#define SM_FAST_TICK_US 17.5
+#define SM_SLOW_TASK_DIVIDER 10
+#define SM_CYCLES(samplePeriods) (((samplePeriods) + SM_SLOW_TASK_DIVIDER - 1) / SM_SLOW_TASK_DIVIDER)
+/* the fast path trips the DCDC when no slow tick was served for this many slow ticks (~90 ms) */
+#define SM_SLOW_TASK_STALL_TICKS 500
+
+#define DELAY_50_SM_CYCLES SM_CYCLES(50)
+#define DELAY_100_SM_CYCLES SM_CYCLES(100)
+#define EMERGENCY_STOP_SM_CYCLES SM_CYCLES(10)
+
+/*
+ * Table-driven supervisory task.
+ * Every state has optional entry, do and exit handlers and a list of guarded
+ * transitions. Each slow tick the do handler of the current state runs, then
+ * its transitions are evaluated in list order and the first one whose guard
+ * passes (no guard passes always) sets the next state and runs its action.
+ * IOP requests, the safe state and the error handling may still override the
+ * next state afterwards. Exit and entry handlers run when the state changes.
+ */
+#define SM_STATE_VALUE_RANGE 256    /* Operating_state values are 0..255 */
+#define SM_STATE_NONE   0xFFFFu     /* no target */
+#define SM_STATE_BEFORE 0xFFFEu     /* target is StateVector.State_Before */
+#define SM_STATE_KEEP   0xFFFDu     /* leave StateVector.State_Next as it is */
 
 
 
 typedef enum Balancing_state
 {
     BALANCE_INIT = 0,
-    BALANCE_VERIFY_HIGH_THRESHOLD,
+    BALANCE_PLAN,
     BALANCE_READ_CELL_VOLTAGES,
     BALANCE_CONNECT,
     BALANCE_DISCHARGE,
@@ -44,30 +81,54 @@ typedef enum Balancing_state
     BALANCE_DONE,
 }Balancing_state_t;
 
+/* state of each energy bank of the cell voltage scanner */
 typedef enum Read_cell_state
 {
     READ_CELL_INIT = 0,
     READ_CELL_CONNECT,
-    READ_CELL_CONNECT_DELAY,
+    READ_CELL_SETTLE,
     READ_CELL_VALUE,
     READ_NEXT_CELL,
-    READ_NEXT_ITERATION,
     READ_CELL_DONE,
 }Read_cell_state_t;
 
 typedef struct Counters
 {
     uint32_t StateMachineCounter;
+    uint32_t FastTickCounter;
+    uint32_t SlowTaskSkippedTicks;
+    uint32_t SlowTaskStalls;        /* DCDC tripped by the fast path, slow task held up */
     int16_t PrestateCounter;
     uint16_t InrushCurrentLimiterCounter;
     uint16_t SafeSoftStartCounter;
     uint16_t EmergencyCounter;
 } Counters_t;
 
+typedef struct StateTransition
+{
+    uint16_t to;                /* Operating_state or SM_STATE_BEFORE */
+    bool (*guard)(void);        /* NULL: always taken */
+    void (*action)(void);       /* NULL: none */
+} StateTransition_t;
+
+typedef struct StateDescriptor
+{
+    uint16_t state;             /* Operating_state */
+    void (*entry)(void);
+    void (*run)(void);          /* do handler, once every slow tick */
+    void (*exit)(void);
+    const StateTransition_t *transitions;
+    uint16_t numOfTransitions;
+    uint16_t idleRequestState;  /* next state when the IOP requests Idle */
+    uint16_t switchFaultState;  /* next state when the DPMU switches are not as expected, SM_STATE_NONE to ignore */
+} StateDescriptor_t;
+
 extern Counters_t CounterGroup ;
 
 void StateMachineInit(void);
 void StateMachine(void);
+void StateMachineFastTick(void);
+void StateMachineScheduler(void);
 void CalculateAvgVStore();
 void CalculateAvgVBus();
 void CheckMainStateMachineIsRunning();
@@ -180,6 +180,8 @@ void switch_matrix_reset(void);
 
 /* connects cell <battery_number> to llc */
 int switch_matrix_connect_cell(uint16_t battery_number);
+/* disconnects the energy bank of cell <cell_number>, the other bank is untouched */
+void switch_matrix_disconnect_bank(uint16_t cell_number);
 //void ActiveMatrixSwitches(void);
 void switch_matrix_set_cell_polarity(uint16_t cell_number);
 
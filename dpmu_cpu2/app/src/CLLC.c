@@ -16,6 +16,7 @@
 #include "cli_cpu2.h"
 #include "GlobalV.h"
 #include "hal.h"
+#include "pi_controller.h"
 #include "sensors.h"
 #include "switch_matrix.h"
 #include "timer.h"
@@ -32,12 +33,12 @@ PI_Parameters_t CellDischargePiParameter = { 0.0867, 9.09, 1, 0 };
 float CLLC_Discharge_I_Ref = 2.0;
 PiOutput_t CllcPIout = {0};
 
+/* Cell being discharged, the loop itself runs in the fast control path */
+static volatile uint16_t cllcActiveCellNr = BAT_0;
+
 void StartCllcControlLoop(uint16_t cellNr)
 {
-    CllcPIout.Int_out = 0.0;
-    CllcPIout.Output = 0.0;
-    CllcPIout.calculated_error = 0.0;
-    CllcPIout.dutyCycle = 0;
+    PiControllerReset(&CllcPIout);
 
     if (cellNr <= BAT_15)
     {
@@ -49,14 +50,26 @@ void StartCllcControlLoop(uint16_t cellNr)
         HAL_StopPwmCllcCellDischarge1();
         HAL_StartPwmCllcCellDischarge2();
     }
+    cllcActiveCellNr = cellNr;
 }
 
 void StopCllcControlLoop()
 {
+    cllcActiveCellNr = BAT_0;
     HAL_StopPwmCllcCellDischarge2();
     HAL_StopPwmCllcCellDischarge1();
 }
 
+bool CllcControlLoopActive(void)
+{
+    return cllcActiveCellNr != BAT_0;
+}
+
+uint16_t CllcControlLoopCellNr(void)
+{
+    return cllcActiveCellNr;
+}
+
 
 void CllcControlLoop(uint16_t cellNr ) {
 
@@ -66,51 +79,22 @@ void CllcControlLoop(uint16_t cellNr ) {
 
     if( cellNr <= BAT_15 ) {
 
-        CllcPIout = Pi_ControllerCllCFloat( CellDischargePiParameter,
-                                            CllcPIout,
-                                            CLLC_Discharge_I_Ref,
-                                            -sensorVector[I_Dab2fIdx].realValue );
+        PiControllerRun( &CellDischargePiParameter,
+                         &CllcPIout,
+                         CLLC_Discharge_I_Ref,
+                         -sensorVector[I_Dab2fIdx].realValue );
         PhaseshiftCount = CLLC_PHASE_180 - CllcPIout.Output;
         HAL_PWM_setPhaseShift(QABPWM_6_7_BASE, PhaseshiftCount);
 
     } else {
 
-        CllcPIout = Pi_ControllerCllCFloat( CellDischargePiParameter,
-                                            CllcPIout,
-                                            CLLC_Discharge_I_Ref,
-                                            -sensorVector[I_Dab3fIdx].realValue );
+        PiControllerRun( &CellDischargePiParameter,
+                         &CllcPIout,
+                         CLLC_Discharge_I_Ref,
+                         -sensorVector[I_Dab3fIdx].realValue );
         PhaseshiftCount = CLLC_PHASE_180 - CllcPIout.Output;
         HAL_PWM_setPhaseShift(QABPWM_14_15_BASE, PhaseshiftCount);
 
     }
 
 }
-
-PiOutput_t Pi_ControllerCllCFloat(PI_Parameters_t PI, PiOutput_t PIout, float Ref, float ValueRead)
-{
-    volatile float error;
-    error = Ref - ValueRead;
-
-    float P_out   = (float) error * PI.Pgain;
-    PIout.Int_out = (float) error * PI.Igain + PIout.Int_out;
-    PIout.Output = P_out + PIout.Int_out;
-    /**
-     * @brief Anti-windup
-     */
-
-    if (PIout.Output > PI.UpperLimit)
-    {
-        PIout.Output = PI.UpperLimit;
-        PIout.Int_out = PI.UpperLimit - P_out;
-    }
-
-    if (PIout.Output < PI.LowerLimit)
-    {
-        PIout.Output = PI.LowerLimit;
-        PIout.Int_out = PI.LowerLimit + P_out;
-    }
-
-    PIout.calculated_error = error;
-
-    return PIout;
-}
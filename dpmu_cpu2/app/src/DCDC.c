@@ -16,8 +16,10 @@
 #include "CLLC.h"
 #include "DCDC.h"
 #include "energy_storage.h"
+#include "filters.h"
 #include "GlobalV.h"
 #include "hal.h"
+#include "pi_controller.h"
 #include "sensors.h"
 #include "state_machine.h"
 #include "switches.h"
@@ -40,7 +42,16 @@ float trickleChargeDutyCycle[] =  { 0.005, 0.01, 0.015, 0.02 };
 
 
 float I_IN_LIMIT_RATE = 0.8;
-uint16_t NUMBER_OF_CURRENT_SAMPLES = 25;
+uint16_t NUMBER_OF_CURRENT_SAMPLES = BOOST_CURRENT_AVG_WINDOW;
+
+static float avgInputCurrentWindow[BOOST_CURRENT_AVG_WINDOW];
+static float avgOutputCurrentWindow[BOOST_CURRENT_AVG_WINDOW];
+static float avgVStoreWindow[BOOST_CURRENT_AVG_WINDOW];
+static float avgVbusWindow[BOOST_CURRENT_AVG_WINDOW];
+static MovingAverage_t avgInputCurrentFilter;
+static MovingAverage_t avgOutputCurrentFilter;
+static MovingAverage_t avgVStoreFilter;
+static MovingAverage_t avgVbusFilter;
 
 float trackSensorBuffer1[TRACK_SENSOR_BUFFER_SIZE];
 float trackSensorBuffer2[TRACK_SENSOR_BUFFER_SIZE];
@@ -87,10 +98,7 @@ void DCDC_current_buck_loop_float(void)
 
         float ISen2Float = sensorVector[ISen2fIdx].realValue;
 
-        ILoop_PiOutput = Pi_ControllerBuckFloat( ILoopParamBuck,
-                                                 ILoop_PiOutput,
-                                                 -DCDC_VI.I_Ref_Real,
-                                                 ISen2Float );
+        PiControllerRun( &ILoopParamBuck, &ILoop_PiOutput, -DCDC_VI.I_Ref_Real, ISen2Float );
 
         //dutyCycle = BUCK_NORMAL_MODE_TIME_BASE_PERIOD - (BUCK_NORMAL_MODE_TIME_BASE_PERIOD * -ILoop_PiOutput.Output);
         dutyCycle = (BUCK_NORMAL_MODE_TIME_BASE_PERIOD * -ILoop_PiOutput.Output);
@@ -106,10 +114,10 @@ void DCDC_voltage_boost_loop_float(void)
 {
     uint16_t dutyCycle;
 
-    VLoop_PiOutput = Pi_ControllerBoostFloat(VLoopParamBoost,
-                                             VLoop_PiOutput,
-                                             DCDC_VI.target_Voltage_At_DCBus * REG_TARGET_DC_BUS_VOLTAGE_RATIO,
-                                             sensorVector[VBusIdx].realValue);
+    PiControllerRun(&VLoopParamBoost,
+                    &VLoop_PiOutput,
+                    DCDC_VI.target_Voltage_At_DCBus * REG_TARGET_DC_BUS_VOLTAGE_RATIO,
+                    sensorVector[VBusIdx].realValue);
 //    DCDC_VI.I_Ref_Real =  (VLoop_PiOutput.Output);
 
     dutyCycle = BOOST_TIME_BASE_PERIOD - (BOOST_TIME_BASE_PERIOD * VLoop_PiOutput.Output);
@@ -126,6 +134,13 @@ void DCDCInitializePWMForRegulateVoltage()
 
     dutyCycle = BOOST_TIME_BASE_PERIOD * ( DCDC_VI.avgVStore / DCDC_VI.avgVBus );
 
+    // Start the voltage loop from the same duty cycle, dutyCycle = PERIOD - PERIOD * Output
+    PiControllerBumplessInit(&VLoopParamBoost,
+                             &VLoop_PiOutput,
+                             1.0 - ( DCDC_VI.avgVStore / DCDC_VI.avgVBus ),
+                             DCDC_VI.target_Voltage_At_DCBus * REG_TARGET_DC_BUS_VOLTAGE_RATIO,
+                             sensorVector[VBusIdx].realValue);
+
     HAL_PWM_setCounterCompareValue(BEG_1_2_BASE, EPWM_COUNTER_COMPARE_A, dutyCycle);
     HAL_StartPwmDCDC();
 }
@@ -135,10 +150,10 @@ void DCDC_current_boost_loop_float(void)
 
     uint16_t dutyCycle;
 
-    ILoop_PiOutput = Pi_ControllerBoostFloat(ILoopParamBoost,
-                                             ILoop_PiOutput,
-                                             DCDC_VI.I_Ref_Real,
-                                             sensorVector[ISen2fIdx].realValue);
+    PiControllerRun(&ILoopParamBoost,
+                    &ILoop_PiOutput,
+                    DCDC_VI.I_Ref_Real,
+                    sensorVector[ISen2fIdx].realValue);
 
     dutyCycle = BOOST_TIME_BASE_PERIOD - (BOOST_TIME_BASE_PERIOD * ILoop_PiOutput.Output);
 
@@ -147,37 +162,21 @@ void DCDC_current_boost_loop_float(void)
     ILoop_PiOutput.dutyCycle = dutyCycle;
 }
 
+/**
+ * @brief  Inductor current reference for Regulate
+ * Moving averages over the last NUMBER_OF_CURRENT_SAMPLES samples, so a new
+ * reference is calculated every sample. Called by StateMachineFastTick().
+ */
 bool calculate_boost_current(void)
 {
     bool retValue = false;
     float BoostGain;
-    static float sumInputCurrent=0;
-    static float sumOutputCurrent=0;
-    static float sumVStore=0;
-    static float sumVbus=0;
-
-    static uint16_t currentSampleCount = 0;
-
-    if( currentSampleCount < NUMBER_OF_CURRENT_SAMPLES ){
-        sumInputCurrent = sumInputCurrent + sensorVector[IF_1fIdx].realValue;
-        sumOutputCurrent = sumOutputCurrent + sensorVector[ISen1fIdx].realValue;
-        sumVbus = sumVbus + sensorVector[VBusIdx].realValue;
-        sumVStore = sumVStore + sensorVector[VStoreIdx].realValue;
-        currentSampleCount++;
-        return false;
-    } else {
-        DCDC_VI.RegulateAvgInputCurrent = sumInputCurrent / NUMBER_OF_CURRENT_SAMPLES;
-        DCDC_VI.RegulateAvgOutputCurrent = sumOutputCurrent / NUMBER_OF_CURRENT_SAMPLES;
-        DCDC_VI.RegulateAvgVbus = sumVbus / NUMBER_OF_CURRENT_SAMPLES;
-        DCDC_VI.RegulateAvgVStore = sumVStore / NUMBER_OF_CURRENT_SAMPLES;
+    static uint16_t trackSampleCount = 0;
 
-        sumInputCurrent=0;
-        sumOutputCurrent=0;
-        sumVStore=0;
-        sumVbus=0;
-
-        currentSampleCount = 0;
-    }
+    DCDC_VI.RegulateAvgInputCurrent = MovingAverageUpdate(&avgInputCurrentFilter, sensorVector[IF_1fIdx].realValue);
+    DCDC_VI.RegulateAvgOutputCurrent = MovingAverageUpdate(&avgOutputCurrentFilter, sensorVector[ISen1fIdx].realValue);
+    DCDC_VI.RegulateAvgVbus = MovingAverageUpdate(&avgVbusFilter, sensorVector[VBusIdx].realValue);
+    DCDC_VI.RegulateAvgVStore = MovingAverageUpdate(&avgVStoreFilter, sensorVector[VStoreIdx].realValue);
 
     //if( sensorVector[VStoreIdx].realValue > 30.0 ) {
     if( DCDC_VI.RegulateAvgVStore > 0.0 ) {
@@ -202,74 +201,16 @@ bool calculate_boost_current(void)
         }
      }
 
-    TrackSensorValueForDEBUG( DCDC_VI.RegulateAvgInputCurrent, DCDC_VI.RegulateAvgOutputCurrent, DCDC_VI.RegulateAvgVStore, DCDC_VI.RegulateAvgVbus );
-
-    return retValue;
-}
-
-
-
-
-PiOutput_t Pi_ControllerBuckFloat(PI_Parameters_t PI, PiOutput_t PIout,
-                                  float Ref, float ValueRead)
-{
-    volatile float error;
-    error = Ref - ValueRead;
-
-    float P_out   = (float) error * PI.Pgain;
-    PIout.Int_out = (float) error * PI.Igain + PIout.Int_out;
-    PIout.Output = P_out + PIout.Int_out;
-    /**
-     * @brief Anti-windup
-     */
-
-    if (PIout.Output > PI.UpperLimit)
-    {
-        PIout.Output = PI.UpperLimit;
-        PIout.Int_out = PI.UpperLimit - P_out;
-    }
-    
-    if (PIout.Output < PI.LowerLimit)
-    {
-        PIout.Output = PI.LowerLimit;
-        PIout.Int_out = PI.LowerLimit + P_out;
+    // Keep the same debug history span as with the former block average
+    if( ++trackSampleCount >= NUMBER_OF_CURRENT_SAMPLES ) {
+        trackSampleCount = 0;
+        TrackSensorValueForDEBUG( DCDC_VI.RegulateAvgInputCurrent, DCDC_VI.RegulateAvgOutputCurrent, DCDC_VI.RegulateAvgVStore, DCDC_VI.RegulateAvgVbus );
     }
 
-    PIout.calculated_error = error;
-
-    return PIout;
+    return retValue;
 }
 
 
-PiOutput_t Pi_ControllerBoostFloat(PI_Parameters_t PI, PiOutput_t PIout,
-                                   float Ref, float ValueRead)
-{
-    volatile float error;
-    error = Ref - ValueRead;
-
-    float P_out   = (float) error * PI.Pgain;
-    PIout.Int_out = (float) error * PI.Igain + PIout.Int_out;
-    PIout.Output = P_out + PIout.Int_out;
-    /**
-     * @brief Anti-windup
-     */
-
-    if (PIout.Output > PI.UpperLimit)
-    {
-        PIout.Output = PI.UpperLimit;
-        PIout.Int_out = PI.UpperLimit - P_out;
-    }
-    
-    if (PIout.Output < PI.LowerLimit)
-    {
-        PIout.Output = PI.LowerLimit;
-        PIout.Int_out = PI.LowerLimit + P_out;
-    }
-
-    PIout.calculated_error = error;
-
-    return PIout;
-}
 
 
 void DCDCConverterInit(void)
@@ -289,11 +230,13 @@ void DCDCConverterInit(void)
     ILoopParamBuck.Igain = 0.00167256;
     ILoopParamBuck.UpperLimit = -0.05;
     ILoopParamBuck.LowerLimit = -0.95 ;
+    ILoopParamBuck.form = PI_FORM_PARALLEL;
 
     ILoopParamBoost.Pgain = 0.002;
     ILoopParamBoost.Igain = 0.00167256;
     ILoopParamBoost.UpperLimit = 0.99;
     ILoopParamBoost.LowerLimit = 0.01;
+    ILoopParamBoost.form = PI_FORM_PARALLEL;
 
     /*Init Voltage boost Loop PI parameters */
     VLoopParamBoost.Pgain = 0.8761f * 0.0050354f;         /* 100*3.3/2^16            */
@@ -301,6 +244,7 @@ void DCDCConverterInit(void)
     //VLoopParamBoost.UpperLimit = 19.0;
     VLoopParamBoost.UpperLimit = 0.83;
     VLoopParamBoost.LowerLimit = 0.1;
+    VLoopParamBoost.form = PI_FORM_PARALLEL;
 
     /*Init Counters */
 
@@ -312,9 +256,30 @@ void DCDCConverterInit(void)
     CellDischargePiParameter.Igain = 0.0046648;
     CellDischargePiParameter.LowerLimit = CLLC_PHASE_180*0.02;
     CellDischargePiParameter.UpperLimit = CLLC_PHASE_180*0.98;
+    CellDischargePiParameter.form = PI_FORM_PARALLEL;
 
     DCDC_VI.I_Ref_Real = 0.50;
 
+    if( NUMBER_OF_CURRENT_SAMPLES > BOOST_CURRENT_AVG_WINDOW ) {
+        NUMBER_OF_CURRENT_SAMPLES = BOOST_CURRENT_AVG_WINDOW;
+    }
+    MovingAverageInit(&avgInputCurrentFilter, avgInputCurrentWindow, NUMBER_OF_CURRENT_SAMPLES);
+    MovingAverageInit(&avgOutputCurrentFilter, avgOutputCurrentWindow, NUMBER_OF_CURRENT_SAMPLES);
+    MovingAverageInit(&avgVStoreFilter, avgVStoreWindow, NUMBER_OF_CURRENT_SAMPLES);
+    MovingAverageInit(&avgVbusFilter, avgVbusWindow, NUMBER_OF_CURRENT_SAMPLES);
+
+}
+
+/**
+ * @brief  Clears the Regulate averages, so the boost current reference
+ * does not start from samples of an earlier Regulate
+ */
+void DCDCRegulateAveragesReset(void)
+{
+    MovingAverageReset(&avgInputCurrentFilter);
+    MovingAverageReset(&avgOutputCurrentFilter);
+    MovingAverageReset(&avgVStoreFilter);
+    MovingAverageReset(&avgVbusFilter);
 }
 
 
@@ -6,7 +6,10 @@
  */
 
 #include <error_handling.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "common.h"
 #include "balancing.h"
@@ -18,11 +21,25 @@
 #include "switch_matrix.h"
 #include "timer.h"
 
-#define TIMER_TICK_COUNT_5_SECS 5000
 
 uint16_t NUMBER_OF_READ_ITERATIONS = 5;
-uint16_t NCOUNTS_TO_STABLE_VOLTAGE = ( 3.5e-3 / 17.5e-6 ); //Each count takes ~17.5us.
-uint16_t NCOUNTS_TO_STABLE_VOLTAGE_VUP_VDOWN = 5 * ( 3.5e-3 / 17.5e-6 );
+/* counts are slow ticks of the state machine, see SM_CYCLES() */
+uint16_t NCOUNTS_TO_STABLE_VOLTAGE = SM_CYCLES(200);    /* 3.5 ms */
+uint16_t NCOUNTS_TO_STABLE_VOLTAGE_VUP_VDOWN = SM_CYCLES(5 * 200);
+
+/* Settling detection of the cell voltage scanner.
+ * Every NCOUNTS_SETTLE_SPAN counts the sensor value is compared to the value one
+ * span earlier. The sense path follows the cell as a first order lag, so the
+ * ratio of two successive changes is the share of the error left after a span
+ * and the error still to come is the sum of the geometric tail. The cell is
+ * settled when that estimate has been below SETTLE_TOLERANCE_VOLTAGE for
+ * SETTLE_CONVERGED_SPANS spans in a row. A change bigger than the one before
+ * never converges, changes of opposite sign are taken as noise about the final
+ * value. NCOUNTS_TO_STABLE_VOLTAGE is the timeout, the cell is sampled then anyway. */
+uint16_t NCOUNTS_SETTLE_MIN = SM_CYCLES(8);
+uint16_t NCOUNTS_SETTLE_SPAN = SM_CYCLES(8);
+uint16_t SETTLE_CONVERGED_SPANS = 2;
+float SETTLE_TOLERANCE_VOLTAGE = 0.002;
 
 
 
@@ -35,10 +52,52 @@ bool enableReadCellVoltages = false;
 bool readCellVoltagesDone = false;
 bool readCellVoltagesBalancingDone = false;
 
+/* One energy bank of the cell voltage scanner.
+ * The low bank (BAT_1..BAT_15) is measured by V_Dwnf and the high bank
+ * (BAT_16..BAT_30) by V_Upf, so both banks are scanned at the same time,
+ * each with its own switch matrix group. */
+typedef struct CellScanBank {
+    Read_cell_state_t state;
+    uint16_t sensorIdx;
+    const uint16_t *readOrder;  /* the cells of this bank in cellNrReadOrder */
+    uint16_t numOfCells;
+    float *voltages;            /* indexed by ConvCellNrToIdx() */
+    uint16_t cellReadCounter;
+    uint16_t cellNr;
+    uint16_t delayCount;        /* counts since the cell was connected */
+    uint16_t convergedSpans;
+    uint16_t sampleCount;
+    float settleReference;      /* sensor value at the start of the span */
+    float settleDelta;          /* change over the span before */
+    float sampleSum;
+} CellScanBank_t;
+
+static float cellVoltagesTemp[30];
+
+static CellScanBank_t cellScanBank[2] = {
+    { READ_CELL_INIT, V_DwnfIdx, &cellNrReadOrder[0],                   NUMBER_OF_CELLS / 2, cellVoltagesTemp },
+    { READ_CELL_INIT, V_UpfIdx,  &cellNrReadOrder[NUMBER_OF_CELLS / 2], NUMBER_OF_CELLS / 2, cellVoltagesTemp },
+};
+static CellScanBank_t singleCellScan;
+static uint16_t singleCellNr;
+
+static bool cellScanRestart = true;
+static float energyBankVoltageSum;
+static uint16_t energyBankVoltageCount;
+static uint32_t scanStartCount;
+static uint32_t scanStartTime;
+static uint32_t scanSettleCountSum;
+
+CellScanStats_t cellScanStats;
+
 
 uint16_t ConvCellNrToIdx(uint16_t cellNr);
 
 void EnableContinuousReadCellVoltages( ) {
+    if( enableReadCellVoltages == false ) {
+        /* the switch matrix may have been used while disabled */
+        cellScanRestart = true;
+    }
     enableReadCellVoltages = true;
 }
 void DisableContinuousReadCellVoltages( ) {
@@ -61,207 +120,459 @@ bool ReadCellVoltagesBalancingDone( ){
     return readCellVoltagesBalancingDone;
 }
 
-
-bool ReadCellVoltagesStateMachine(float *cellVoltages, float *energyBankVoltage, bool *cellVoltageOverThreshold )
+void CellScanStatsReset(void)
 {
+    memset(&cellScanStats, 0, sizeof(cellScanStats));
+}
 
-    static States_t read_cell_state = {READ_CELL_INIT};
-    static int cellNr = 15;
-    static int cellVoltagesIdx = 0;
-    static int cellReadCounter = 0;
-    static int iteration = 0;
-    static uint16_t readCellDelayCount = 0;
-    static uint16_t voltageOverThresholdCount = 0;
-    bool done = false;
-
-    volatile float cellVoltageValue;
-    static float cellVoltagesTemp[30];
+void CellScanStatsPrint(void)
+{
+    CellScanStats_t stats = cellScanStats;
 
+    PRINT("Cell scans %lu, settle timeouts %lu\r\n", stats.scans, stats.settleTimeouts);
+    if( stats.scans == 0 ) {
+        return;
+    }
+    PRINT("  scan counts last %lu min %lu max %lu, last scan %lu ms\r\n",
+          stats.lastScanCounts, stats.minScanCounts, stats.maxScanCounts, stats.lastScanTime);
+    PRINT("  settle counts per cell min %u max %u mean %u\r\n",
+          stats.minSettleCounts, stats.maxSettleCounts, stats.meanSettleCounts);
+}
 
+/**
+ * @brief  Sensor path of a bank has converged after the cell was connected
+ */
+static bool CellScanSettled(CellScanBank_t *bank, float value)
+{
+    float delta;
+    float remaining;
+
+    bank->delayCount++;
+
+    if( (bank->delayCount % NCOUNTS_SETTLE_SPAN) == 0 ) {
+        delta = value - bank->settleReference;
+        if( delta * bank->settleDelta <= 0.0f ) {
+            remaining = fabsf(delta);
+        } else if( fabsf(delta) < fabsf(bank->settleDelta) ) {
+            /* delta * r / (1 - r) with r = delta / settleDelta */
+            remaining = delta * delta / (bank->settleDelta - delta);
+            remaining = fabsf(remaining);
+        } else {
+            remaining = INFINITY;
+        }
+        if( remaining <= SETTLE_TOLERANCE_VOLTAGE ) {
+            bank->convergedSpans++;
+        } else {
+            bank->convergedSpans = 0;
+        }
+        bank->settleReference = value;
+        bank->settleDelta = delta;
+    }
 
-    if( enableReadCellVoltages == false ) {
-        return false;
+    if( (bank->delayCount >= NCOUNTS_SETTLE_MIN) && (bank->convergedSpans >= SETTLE_CONVERGED_SPANS) ) {
+        return true;
     }
+    if( bank->delayCount >= NCOUNTS_TO_STABLE_VOLTAGE ) {
+        cellScanStats.settleTimeouts++;
+        return true;
+    }
+    return false;
+}
 
+/**
+ * @brief  Advances one bank of the scanner by one count
+ * @return true when all the cells of the bank are read
+ */
+static bool CellScanBankStep(CellScanBank_t *bank)
+{
+    float value = sensorVector[bank->sensorIdx].realValue;
+    uint16_t cellVoltagesIdx;
 
-    switch(read_cell_state.State_Current)
+    switch(bank->state)
     {
     case READ_CELL_INIT:
-        if( cellVoltagesIdx < 15) {
-            cellVoltagesTemp[cellVoltagesIdx]      = 0;
-            cellVoltagesTemp[cellVoltagesIdx + 15] = 0;
-            cellVoltagesIdx++;
-        } else {
-            *cellVoltageOverThreshold = false;
-            *energyBankVoltage = 0;
-            cellReadCounter = 0;
-            iteration = 0;
-            readCellVoltagesDone = false;
-            read_cell_state.State_Next = READ_CELL_CONNECT;
-            //total_time_start = timer_get_ticks();
-            voltageOverThresholdCount = 0;
-        }
+        bank->cellReadCounter = 0;
+        bank->state = READ_CELL_CONNECT;
         break;
 
     case READ_CELL_CONNECT:
-        /* break before make */
-        switch_matrix_reset();
-
-        cellNr = cellNrReadOrder[cellReadCounter];
-        switch_matrix_connect_cell( cellNr );/* CELL[ 1..30] */
-        readCellDelayCount = 0;
-        read_cell_state.State_Next = READ_CELL_CONNECT_DELAY;
+        /* break before make, only this bank */
+        bank->cellNr = bank->readOrder[bank->cellReadCounter];
+        switch_matrix_disconnect_bank( bank->cellNr );
+        switch_matrix_connect_cell( bank->cellNr );
+        bank->delayCount = 0;
+        bank->convergedSpans = 0;
+        bank->settleReference = value;
+        bank->settleDelta = 0;
+        bank->state = READ_CELL_SETTLE;
         break;
 
-    case READ_CELL_CONNECT_DELAY:
-        if( readCellDelayCount == NCOUNTS_TO_STABLE_VOLTAGE ){
-            read_cell_state.State_Next = READ_CELL_VALUE;
-        } else {
-            readCellDelayCount++;
+    case READ_CELL_SETTLE:
+        if( CellScanSettled(bank, value) ) {
+            if( (cellScanStats.minSettleCounts == 0) || (bank->delayCount < cellScanStats.minSettleCounts) ) {
+                cellScanStats.minSettleCounts = bank->delayCount;
+            }
+            if( bank->delayCount > cellScanStats.maxSettleCounts ) {
+                cellScanStats.maxSettleCounts = bank->delayCount;
+            }
+            scanSettleCountSum += bank->delayCount;
+            bank->sampleSum = 0;
+            bank->sampleCount = 0;
+            bank->state = READ_CELL_VALUE;
         }
         break;
 
     case READ_CELL_VALUE:
-
-        if( (cellNr >= BAT_1) && ( cellNr <= BAT_15 ) ) {
-            /* CELL[ 1..15] */
-            if( sensorVector[V_DwnfIdx].convertedReady ) {
-                cellVoltageValue = sensorVector[V_DwnfIdx].realValue;
-                cellVoltagesIdx = ConvCellNrToIdx( cellNr );
-                if( (cellNr & 1) == 1) {
-                    cellVoltagesTemp[cellVoltagesIdx] = cellVoltagesTemp[cellVoltagesIdx] - cellVoltageValue;
-                } else {
-                    cellVoltagesTemp[cellVoltagesIdx] = cellVoltagesTemp[cellVoltagesIdx] + cellVoltageValue;
-                }
-                read_cell_state.State_Next = READ_NEXT_CELL;
-            }
-        } else if ( (cellNr >= BAT_16) &&  (cellNr <= BAT_30) ){
-            /* CELL[16..30] */
-            if( sensorVector[V_UpfIdx].convertedReady ) {
-                cellVoltageValue = sensorVector[V_UpfIdx].realValue;
-                cellVoltagesIdx = ConvCellNrToIdx( cellNr );
-                if( (cellNr & 1) == 1) {
-                    cellVoltagesTemp[cellVoltagesIdx] =  cellVoltagesTemp[cellVoltagesIdx]  - cellVoltageValue;
-                } else {
-                    cellVoltagesTemp[cellVoltagesIdx] =  cellVoltagesTemp[cellVoltagesIdx]  + cellVoltageValue;
-                }
-                read_cell_state.State_Next = READ_NEXT_CELL;
+        bank->sampleSum += value;
+        bank->sampleCount++;
+        if( bank->sampleCount >= NUMBER_OF_READ_ITERATIONS ) {
+            cellVoltagesIdx = ConvCellNrToIdx( bank->cellNr );
+            /* odd cells are measured with reversed polarity */
+            if( (bank->cellNr & 1) == 1) {
+                bank->voltages[cellVoltagesIdx] = -bank->sampleSum / (float)bank->sampleCount;
+            } else {
+                bank->voltages[cellVoltagesIdx] = bank->sampleSum / (float)bank->sampleCount;
             }
-        } else {
-            //Invalid cell number
-            read_cell_state.State_Next = READ_NEXT_CELL;
+            bank->state = READ_NEXT_CELL;
         }
         break;
 
     case READ_NEXT_CELL:
-        cellReadCounter++;
-        if( cellReadCounter < NUMBER_OF_CELLS ){
-            read_cell_state.State_Next = READ_CELL_CONNECT;
+        bank->cellReadCounter++;
+        if( bank->cellReadCounter < bank->numOfCells ) {
+            bank->state = READ_CELL_CONNECT;
         } else {
-            read_cell_state.State_Next = READ_NEXT_ITERATION;
+            switch_matrix_disconnect_bank( bank->cellNr );
+            bank->state = READ_CELL_DONE;
         }
         break;
 
-    case READ_NEXT_ITERATION:
-        iteration++;
-        cellReadCounter = 0;
-        if( iteration == NUMBER_OF_READ_ITERATIONS ) {
-            read_cell_state.State_Next = READ_CELL_DONE;
-        } else {
-            /* measure Voltage over energy bank */
-            *energyBankVoltage += sensorVector[VStoreIdx].realValue;
-            read_cell_state.State_Next = READ_CELL_CONNECT;
+    case READ_CELL_DONE:
+        break;
+    }
+
+    return bank->state == READ_CELL_DONE;
+}
+
+/**
+ * @brief  Publishes the cell voltages of a completed scan
+ */
+static void CellScanDone(float *cellVoltages, float *energyBankVoltage, bool *cellVoltageOverThreshold)
+{
+    uint32_t scanCounts = CounterGroup.StateMachineCounter - scanStartCount;
+    float highThreshold = sharedVars_cpu1toCpu2.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_HIGH_THRESHOLD;
+    bool overThreshold = false;
+    uint16_t i;
+
+    for( i = 0; i < NUMBER_OF_CELLS; i++ ) {
+        cellVoltages[i] = cellVoltagesTemp[i];
+        if( cellVoltages[i] > highThreshold ) {
+            overThreshold = true;
         }
+    }
+    if( energyBankVoltageCount > 0 ) {
+        *energyBankVoltage = energyBankVoltageSum / (float)energyBankVoltageCount;
+    }
+    *cellVoltageOverThreshold = overThreshold;
 
-        break;
+    cellScanStats.scans++;
+    cellScanStats.lastScanCounts = scanCounts;
+    if( (cellScanStats.scans == 1) || (scanCounts < cellScanStats.minScanCounts) ) {
+        cellScanStats.minScanCounts = scanCounts;
+    }
+    if( scanCounts > cellScanStats.maxScanCounts ) {
+        cellScanStats.maxScanCounts = scanCounts;
+    }
+    cellScanStats.lastScanTime = timer_get_ticks() - scanStartTime;
+    cellScanStats.meanSettleCounts = scanSettleCountSum / NUMBER_OF_CELLS;
+}
 
-    case READ_CELL_DONE:
-        /* calculate mean value for each cell Voltage */
-        if( cellReadCounter < 15 ) {
-            cellVoltages[cellReadCounter] = cellVoltagesTemp[cellReadCounter] / (float)iteration;
-            cellVoltages[cellReadCounter + 15] = cellVoltagesTemp[cellReadCounter + 15] / (float)iteration;
-
-            if( ( cellVoltages[cellReadCounter] > sharedVars_cpu1toCpu2.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_HIGH_THRESHOLD ) ||
-                    ( cellVoltages[cellReadCounter+15] > sharedVars_cpu1toCpu2.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_HIGH_THRESHOLD ) ) {
-                voltageOverThresholdCount++;
-            }
+/**
+ * @brief  Pipelined cell voltage scanner, one step every state machine count
+ * Both energy banks are scanned in parallel: while a cell of one bank settles
+ * a cell of the other bank may be sampled. A cell is sampled as soon as its
+ * sensor value has converged instead of after a fixed delay, and each
+ * connection is averaged over NUMBER_OF_READ_ITERATIONS consecutive samples.
+ * The outputs are only written when the whole scan is done.
+ * @return true when a scan has been completed
+ */
+bool ReadCellVoltagesStateMachine(float *cellVoltages, float *energyBankVoltage, bool *cellVoltageOverThreshold )
+{
+    bool lowDone, highDone;
+
+    if( enableReadCellVoltages == false ) {
+        return false;
+    }
+
+    if( cellScanRestart ) {
+        cellScanRestart = false;
+        cellScanBank[0].state = READ_CELL_INIT;
+        cellScanBank[1].state = READ_CELL_INIT;
+        energyBankVoltageSum = 0;
+        energyBankVoltageCount = 0;
+        scanSettleCountSum = 0;
+        scanStartCount = CounterGroup.StateMachineCounter;
+        scanStartTime = timer_get_ticks();
+        readCellVoltagesDone = false;
+    }
+
+    /* measure Voltage over energy bank */
+    energyBankVoltageSum += sensorVector[VStoreIdx].realValue;
+    energyBankVoltageCount++;
+
+    lowDone = CellScanBankStep( &cellScanBank[0] );
+    highDone = CellScanBankStep( &cellScanBank[1] );
+
+    if( lowDone && highDone ) {
+        CellScanDone( cellVoltages, energyBankVoltage, cellVoltageOverThreshold );
+        cellScanRestart = true;  /* prepare for next readings of all cell voltages */
+        readCellVoltagesDone = true;
+        ConfigReadCellVoltagesBalancingDone( true );
+        return true;    /* we are done with these readings */
+    }
+
+    return false;
+}
+
+/**
+ * @brief  Reads the voltage of one cell, one step every state machine count
+ * The continuous scan shall be disabled while a single cell is read.
+ * @return true when cellVoltages[ConvCellNrToIdx(cellNr)] has been updated
+ */
+bool ReadSingleCellVoltageStateMachine(uint16_t cellNr, float *cellVoltages)
+{
+    if( singleCellScan.state == READ_CELL_INIT ) {
+        singleCellNr = cellNr;
+        singleCellScan.sensorIdx = (cellNr <= BAT_15) ? V_DwnfIdx : V_UpfIdx;
+        singleCellScan.readOrder = &singleCellNr;
+        singleCellScan.numOfCells = 1;
+        singleCellScan.voltages = cellVoltages;
+    }
+
+    if( CellScanBankStep( &singleCellScan ) ) {
+        singleCellScan.state = READ_CELL_INIT;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Balancing planner
+ *
+ * The cells above the high threshold are kept in a max-heap on their excess
+ * voltage over the low threshold, so the cell furthest from the target is
+ * always discharged first. Each discharge window is sized from the excess
+ * voltage and the discharge rate measured in earlier windows, and only the
+ * discharged cell is read again afterwards. The whole bank is scanned when
+ * the plan is made and again when the heap is empty, to verify the result.
+ */
+typedef struct BalancingHeap {
+    uint16_t len;
+    uint16_t cellIdx[NUMBER_OF_CELLS];
+} BalancingHeap_t;
+
+static BalancingHeap_t balancingHeap;
+static float balancingExcess[NUMBER_OF_CELLS];       /* V over the low threshold */
+static float balancingDischargeRate[NUMBER_OF_CELLS]; /* V/ms, 0 until measured */
+static uint32_t balancingPlanStartTime;
+
+BalancingPlan_t balancingPlan;
+
+static inline bool BalancingHeapHigher(uint16_t i, uint16_t j)
+{
+    return balancingExcess[balancingHeap.cellIdx[i]] > balancingExcess[balancingHeap.cellIdx[j]];
+}
 
-            cellReadCounter++;
+static void BalancingHeapSwap(uint16_t i, uint16_t j)
+{
+    uint16_t cellIdx = balancingHeap.cellIdx[i];
+    balancingHeap.cellIdx[i] = balancingHeap.cellIdx[j];
+    balancingHeap.cellIdx[j] = cellIdx;
+}
+
+static void BalancingHeapInsert(uint16_t cellIdx)
+{
+    uint16_t i = balancingHeap.len;
+
+    if( balancingHeap.len >= NUMBER_OF_CELLS ) {
+        return;
+    }
+    balancingHeap.cellIdx[balancingHeap.len++] = cellIdx;
+
+    /* upheap */
+    while( (i > 0) && BalancingHeapHigher(i, (i - 1) / 2) ) {
+        BalancingHeapSwap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
 
+static uint16_t BalancingHeapRemove(void)
+{
+    uint16_t cellIdx = balancingHeap.cellIdx[0];
+    uint16_t i = 0;
+    uint16_t child;
+
+    balancingHeap.len--;
+    balancingHeap.cellIdx[0] = balancingHeap.cellIdx[balancingHeap.len];
+
+    /* downheap */
+    for( child = 1; child < balancingHeap.len; child = 2 * i + 1 ) {
+        if( ((child + 1) < balancingHeap.len) && BalancingHeapHigher(child + 1, child) ) {
+            child++;
+        }
+        if( !BalancingHeapHigher(child, i) ) {
+            break;
+        }
+        BalancingHeapSwap(i, child);
+        i = child;
+    }
+
+    return cellIdx;
+}
+
+static float BalancingDischargeRate(uint16_t cellIdx)
+{
+    if( balancingDischargeRate[cellIdx] > 0 ) {
+        return balancingDischargeRate[cellIdx];
+    }
+    /* not measured on this cell yet, the cells are alike */
+    return balancingPlan.dischargeRate;
+}
+
+/**
+ * @brief  Discharge window of a cell in ms, proportional to its excess voltage
+ */
+static uint32_t BalancingDischargeWindow(uint16_t cellIdx)
+{
+    float rate = BalancingDischargeRate(cellIdx);
+    float window;
+
+    if( rate <= 0 ) {
+        return BALANCING_WINDOW_FIRST;
+    }
+
+    /* stop a bit early, the remaining excess is taken in the next window */
+    window = BALANCING_WINDOW_RATIO * balancingExcess[cellIdx] / rate;
+    if( window < BALANCING_WINDOW_MIN ) {
+        return BALANCING_WINDOW_MIN;
+    }
+    if( window > BALANCING_WINDOW_MAX ) {
+        return BALANCING_WINDOW_MAX;
+    }
+    return (uint32_t)window;
+}
+
+/**
+ * @brief  Projected time until all the cells in the heap are discharged, ms
+ */
+static void BalancingUpdateProjection(void)
+{
+    uint32_t projection = 0;
+    float rate;
+    uint16_t cellIdx;
+    uint16_t i;
+
+    for( i = 0; i < balancingHeap.len; i++ ) {
+        cellIdx = balancingHeap.cellIdx[i];
+        rate = BalancingDischargeRate(cellIdx);
+        if( rate > 0 ) {
+            projection += (uint32_t)(balancingExcess[cellIdx] / rate);
         } else {
-            *energyBankVoltage = *energyBankVoltage / (float)iteration;
-            cellReadCounter = 0; /* prepare for next readings of each cell voltage */
-            iteration = 0;  /* prepare for next N readings of all cell voltages */
-            read_cell_state.State_Next = READ_CELL_INIT;
-            if( voltageOverThresholdCount > 0 ) {
-                *cellVoltageOverThreshold = true;
-            }
-            cellVoltagesIdx=0;
-            readCellVoltagesDone = true;
-            ConfigReadCellVoltagesBalancingDone( true );
-            done = true;    /* we are done with these readings */
-            //total_time_stop = timer_get_ticks();
+            projection += BALANCING_WINDOW_FIRST;
         }
-        break;
+        projection += balancingPlan.readTime;
     }
 
-    read_cell_state.State_Before = read_cell_state.State_Current;
-    read_cell_state.State_Current = read_cell_state.State_Next;
+    balancingPlan.cellsToBalance = balancingHeap.len;
+    balancingPlan.projectedTimeToBalance = projection;
+}
 
-    return done;
+/**
+ * @brief  Puts every cell above the high threshold in the heap
+ * @return number of cells to balance
+ */
+static uint16_t BalancingPlan(float *cellVoltageVector)
+{
+    float highThreshold = energy_bank_settings.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_HIGH_THRESHOLD;
+    float lowThreshold = energy_bank_settings.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_LOW_THRESHOLD;
+    uint16_t cellIdx;
+
+    balancingHeap.len = 0;
+    for( cellIdx = 0; cellIdx < NUMBER_OF_CELLS; cellIdx++ ) {
+        if( cellVoltageVector[cellIdx] >= highThreshold ) {
+            balancingExcess[cellIdx] = cellVoltageVector[cellIdx] - lowThreshold;
+            BalancingHeapInsert(cellIdx);
+        }
+    }
+    BalancingUpdateProjection();
+
+    return balancingHeap.len;
+}
+
+void BalancingPlanPrint(void)
+{
+    BalancingPlan_t plan = balancingPlan;
+
+    PRINT("Balancing cells left %u, projected time to balance %lu s, elapsed %lu s\r\n",
+          plan.cellsToBalance, plan.projectedTimeToBalance / 1000, plan.elapsedTime / 1000);
+    PRINT("  windows %lu, cellNr %u window %lu ms, discharge rate %8.6f mV/ms, read %lu ms\r\n",
+          plan.windows, plan.cellNr, plan.window, plan.dischargeRate * 1000, plan.readTime);
 }
 
 bool BalancingAllCells( float *cellVoltageVector ) {
     static uint16_t cellIndex, cellNr = BAT_1;
     static States_t balancing_state = { BALANCE_INIT };
     static bool done = false;
-    static uint16_t totalCellsUnderThreshold = 0;
-    volatile float dischargingCellVoltage;
+    static float dischargingInitialVoltage;
     static uint32_t discharging_initial_time, discharging_elapsed_time;
+    static uint32_t read_initial_time;
+    float lowThreshold;
+    float dropped;
 
     switch (balancing_state.State_Current)
     {
         case BALANCE_INIT:
-            cellNr = BAT_1;
-            cellIndex = ConvCellNrToIdx( cellNr );
             done = false;
             ConfigReadCellVoltagesBalancingDone( false );
             EnableContinuousReadCellVoltages();
-            totalCellsUnderThreshold = 0;
             balancing_state.State_Next = BALANCE_READ_CELL_VOLTAGES;
             break;
 
         case BALANCE_READ_CELL_VOLTAGES:
             if( ReadCellVoltagesBalancingDone() == true ) {
                 DisableContinuousReadCellVoltages();
-                balancing_state.State_Next = BALANCE_VERIFY_HIGH_THRESHOLD;
+                balancing_state.State_Next = BALANCE_PLAN;
             }
             break;
 
-        case BALANCE_VERIFY_HIGH_THRESHOLD:
-            cellIndex = ConvCellNrToIdx( cellNr );
-            if( cellVoltageVector[cellIndex] >= (energy_bank_settings.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_HIGH_THRESHOLD) ) {
-                balancing_state.State_Next = BALANCE_CONNECT;
-                PRINT("Start discharge cellNr:[%d] cellVoltageVector[cellIndex]:[%8.2f]\r\n", cellNr, cellVoltageVector[cellIndex]);
+        case BALANCE_PLAN:
+            if( BalancingPlan( cellVoltageVector ) == 0 ) {
+                balancing_state.State_Next = BALANCE_DONE;
             } else {
-                totalCellsUnderThreshold++;
+                if( balancingPlan.cellNr == BAT_0 ) {
+                    /* first plan of this balancing */
+                    balancingPlanStartTime = timer_get_ticks();
+                    balancingPlan.windows = 0;
+                    balancingPlan.elapsedTime = 0;
+                }
+                PRINT("Balancing plan: %u cells, projected time to balance %lu s\r\n",
+                      balancingPlan.cellsToBalance, balancingPlan.projectedTimeToBalance / 1000);
                 balancing_state.State_Next = BALANCE_NEXT_ITERATION;
             }
             break;
 
-
         case BALANCE_NEXT_ITERATION:
-            cellNr = cellNr + 1;
-            if( cellNr == BAT_15_N) {
-                cellNr = BAT_16;
-            }
-            if( cellNr > BAT_30) {
-                cellNr = BAT_1;
-            }
-            if( totalCellsUnderThreshold == 30 ) {
-                balancing_state.State_Next = BALANCE_DONE;
+            if( balancingHeap.len == 0 ) {
+                /* verify the whole bank */
+                balancing_state.State_Next = BALANCE_INIT;
             } else {
-                balancing_state.State_Next = BALANCE_VERIFY_HIGH_THRESHOLD;
+                cellIndex = BalancingHeapRemove();
+                cellNr = (cellIndex < 15) ? (cellIndex + BAT_1) : (cellIndex + BAT_16 - 15);
+                balancingPlan.cellNr = cellNr;
+                balancingPlan.window = BalancingDischargeWindow( cellIndex );
+                dischargingInitialVoltage = cellVoltageVector[cellIndex];
+                PRINT("Start discharge cellNr:[%d] cellVoltageVector[cellIndex]:[%8.2f] window:[%lu ms]\r\n", cellNr, cellVoltageVector[cellIndex], balancingPlan.window);
+                balancing_state.State_Next = BALANCE_CONNECT;
             }
             break;
 
@@ -271,43 +582,54 @@ bool BalancingAllCells( float *cellVoltageVector ) {
             switch_matrix_set_cell_polarity( cellNr );
             StartCllcControlLoop(cellNr);
             discharging_initial_time = timer_get_ticks();
+            balancingPlan.windows++;
             balancing_state.State_Next = BALANCE_DISCHARGE;
             break;
 
         case BALANCE_DISCHARGE:
-            CllcControlLoop( cellNr );
+            /* CllcControlLoop() runs in StateMachineFastTick() while discharging */
             discharging_elapsed_time = timer_get_ticks() - discharging_initial_time;
-            if( discharging_elapsed_time > TIMER_TICK_COUNT_5_SECS ) {
-                discharging_initial_time = timer_get_ticks();
+            if( discharging_elapsed_time > balancingPlan.window ) {
                 StopCllcControlLoop();
                 switch_matrix_reset();
-                switch_matrix_connect_cell( cellNr );
-                ConfigReadCellVoltagesBalancingDone( false );
-                EnableContinuousReadCellVoltages();
+                read_initial_time = timer_get_ticks();
                 balancing_state.State_Next = BALANCE_DISCHARGE_READ_CELL_VOLTAGES;
             }
             break;
 
         case BALANCE_DISCHARGE_READ_CELL_VOLTAGES:
-            if( ReadCellVoltagesBalancingDone() == true ) {
-                DisableContinuousReadCellVoltages();
+            /* only the discharged cell is read again */
+            if( ReadSingleCellVoltageStateMachine( cellNr, cellVoltageVector ) == true ) {
+                balancingPlan.readTime = timer_get_ticks() - read_initial_time;
                 balancing_state.State_Next = BALANCE_VERIFY_LOW_THRESHOLD;
             }
             break;
 
         case BALANCE_VERIFY_LOW_THRESHOLD:
-            cellIndex = ConvCellNrToIdx( cellNr );
             PRINT("Discharging cellNr:[%d] cellVoltageVector[cellIndex]:[%4.2f] Vstore:[%4.2f]\r\n", cellNr, cellVoltageVector[cellIndex], DCDC_VI.avgVStore);
-            if( cellVoltageVector[cellIndex] <= (energy_bank_settings.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_LOW_THRESHOLD) ) {
-                balancing_state.State_Next = BALANCE_INIT;
+
+            /* learn the discharge rate for the next windows */
+            dropped = dischargingInitialVoltage - cellVoltageVector[cellIndex];
+            if( (dropped > 0) && (discharging_elapsed_time > 0) ) {
+                balancingDischargeRate[cellIndex] = dropped / (float)discharging_elapsed_time;
+                balancingPlan.dischargeRate = balancingDischargeRate[cellIndex];
+            }
+
+            lowThreshold = energy_bank_settings.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_LOW_THRESHOLD;
+            if( cellVoltageVector[cellIndex] <= lowThreshold ) {
                 PRINT("Stop discharge cellNr:[%d] cellVoltageVector[cellIndex]:[%8.2f]\r\n", cellNr, cellVoltageVector[cellIndex]);
             } else {
-                balancing_state.State_Next = BALANCE_CONNECT;
+                balancingExcess[cellIndex] = cellVoltageVector[cellIndex] - lowThreshold;
+                BalancingHeapInsert( cellIndex );
             }
+            BalancingUpdateProjection();
+            balancingPlan.elapsedTime = timer_get_ticks() - balancingPlanStartTime;
+            balancing_state.State_Next = BALANCE_NEXT_ITERATION;
             break;
 
         case BALANCE_DONE:
             StopCllcControlLoop();
+            balancingPlan.cellNr = BAT_0;
             PRINT("==> Balancing done\r\n");
             done = true;
             balancing_state.State_Next = BALANCE_INIT;
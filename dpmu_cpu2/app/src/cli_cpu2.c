@@ -13,8 +13,10 @@
 #include <string.h>
 
 #include "common.h"
+#include "balancing.h"
 #include "cli_cpu2.h"
 #include "CLLC.h"
+#include "control_profile.h"
 #include "energy_storage.h"
 #include "hal.h"
 #include "sensors.h"
@@ -29,10 +31,6 @@ cpu1_command_t cpu1_command;
 #pragma DATA_SECTION(cpu2_status, "ramgs4")
 cpu2_status_t cpu2_status;
 
-// Buffer used to send CPU2 debug messages to CPU1 for sending to the serial port.
-#pragma DATA_SECTION(ipc_debug_msg, "MSGRAM_CPU2_TO_CPU1")
-char ipc_debug_msg[MAX_CPU2_DBG_LEN + 1];
-
 
 static void cli_switch_matrix(char *buf);
 static void cli_switch_matrix_cont(char *buf);
@@ -72,6 +70,11 @@ void check_incoming_cli_commands(void)
             // Special handling for 'cpu2' sub-commands from the CLI. We need to start with the Ack.
             IPC_ackFlagRtoL(IPC_CPU2_L_CPU1_R, IPC_FLAG_CLI);
 
+            // The print outs of a command may be longer than the debug ring,
+            // keep what does not fit in the backlog, the super loop passes it
+            // on as CPU1 reads the ring.
+            cpu2_log_set_deferred(true);
+
             // Act on sub-command here.
             char *subcmd = (char *)addr;
             if (strcmp(subcmd, "?") == 0) {
@@ -84,10 +87,28 @@ void check_incoming_cli_commands(void)
                 PRINT("measZeroI [turns] measure zero current offset for matrix switch (0 -> infinity)\r\n");
                 PRINT("measCellI [turns] measure cell current (0 -> infinity)\r\n");
                 PRINT("soh tests write/read SOH to/from external flash\r\n");
+                PRINT("prof [reset]      show/reset control loop tick cost and transient metrics\r\n");
+                PRINT("sm [reset]        show/reset state machine time in state, transitions and do handler cost\r\n");
+                PRINT("scan [reset]      show/reset cell voltage scan rate and settling\r\n");
+                PRINT("bal               show balancing plan and projected time to balance\r\n");
             } else if (strcmp(subcmd, "sc") == 0) {
                 efuse_top_half_flag = 1;
             } else if (strcmp(subcmd, "gs") == 0) {
                 PRINT(" Nothing here yet\r\n");
+            } else if (strcmp(subcmd, "prof") == 0) {
+                ControlProfilePrint();
+            } else if (strcmp(subcmd, "prof reset") == 0) {
+                ControlProfileReset();
+            } else if (strcmp(subcmd, "sm") == 0) {
+                ControlProfileStatesPrint();
+            } else if (strcmp(subcmd, "sm reset") == 0) {
+                ControlProfileReset();
+            } else if (strcmp(subcmd, "bal") == 0) {
+                BalancingPlanPrint();
+            } else if (strcmp(subcmd, "scan") == 0) {
+                CellScanStatsPrint();
+            } else if (strcmp(subcmd, "scan reset") == 0) {
+                CellScanStatsReset();
             } else if (strcmp(subcmd, "swmatrix") >= 0) {
                 cli_switch_matrix(subcmd);
             } else if (strcmp(subcmd, "swmatcont") >= 0) {
@@ -103,6 +124,7 @@ void check_incoming_cli_commands(void)
             }
 
             cli_ok();
+            cpu2_log_set_deferred(false);
         } else {
             // CLI test commands sent by the CLI 'ipc' command.
             switch (command) {
@@ -0,0 +1,379 @@
+/*
+ * control_profile.c
+ *
+ *  Control loop profiling for the main state machine.
+ *
+ *  The execution cost of the fast control path (INT_ADCINB_4_ISR) and of the
+ *  slow supervisory task (StateMachine() in the super loop) is measured with
+ *  the free running IPC counter (SYSCLK cycles) on entry and exit. The same
+ *  counter gives the real period between two runs and the CPU load per rate.
+ *
+ *  For the states that close a control loop the regulated value is compared
+ *  against its reference on every tick to get overshoot and settling time
+ *  (last tick outside +/-CONTROL_PROFILE_SETTLING_BAND_RATIO of the reference).
+ *  Time-to-charge is measured from ChargeInit until the charge is stopped.
+ *
+ *  Results are printed with the CLI command "cpu2 prof".
+ *
+ *  The supervisory task reports per state entries, ticks spent in the state
+ *  and the cost of the do handler (min/mean/max and a power of two histogram),
+ *  and how often each transition of the state table was taken. These live in
+ *  sharedVars_cpu2toCpu1.state_machine_stats so CPU1 can serve them on the OD,
+ *  they are printed with the CLI command "cpu2 sm".
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "common.h"
+#include "cli_cpu2.h"
+#include "control_profile.h"
+#include "DCDC.h"
+#include "GlobalV.h"
+#include "sensors.h"
+#include "shared_variables.h"
+#include "state_machine.h"
+
+ControlProfile_t controlProfile;
+
+static uint64_t stateRunEntryStamp;
+static uint64_t stateRunSumCycles[SM_STATS_MAX_STATES];
+static uint16_t lastStatsResetRequest = 0;
+
+static const uint16_t trackedStates[CP_NumOfTrackedStates] = {
+    ChargeRamp, Charge, Regulate, RegulateVoltage
+};
+
+static const char *rateNames[CP_NumOfRates] = { "fast", "slow" };
+
+static inline uint64_t ControlProfileCycles(void)
+{
+    return IPC_getCounter(IPC_CPU2_L_CPU1_R);
+}
+
+static int16_t ControlProfileTrackedIdx(uint16_t state)
+{
+    int16_t idx;
+
+    for (idx = 0; idx < CP_NumOfTrackedStates; idx++) {
+        if (trackedStates[idx] == state) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+void ControlProfileReset(void)
+{
+    state_machine_stats_t *stats = &sharedVars_cpu2toCpu1.state_machine_stats;
+    uint16_t idx;
+
+    memset(&controlProfile, 0, sizeof(controlProfile));
+    for (idx = 0; idx < CP_NumOfRates; idx++) {
+        controlProfile.rate[idx].minCycles = UINT32_MAX;
+        controlProfile.rate[idx].minPeriodCycles = UINT32_MAX;
+    }
+
+    for (idx = 0; idx < CP_NumOfTrackedStates; idx++) {
+        controlProfile.transient[idx].state = trackedStates[idx];
+    }
+
+    /* state and transition identities are set by StateMachineInit(), keep them */
+    stats->forcedTransitions = 0;
+    for (idx = 0; idx < SM_STATS_MAX_STATES; idx++) {
+        sm_state_stats_t *st = &stats->state[idx];
+        st->entries = 0;
+        st->ticks = 0;
+        st->minCycles = 0;
+        st->maxCycles = 0;
+        st->meanCycles = 0;
+        memset(st->histogram, 0, sizeof(st->histogram));
+        stateRunSumCycles[idx] = 0;
+    }
+    for (idx = 0; idx < SM_STATS_MAX_TRANSITIONS; idx++) {
+        stats->transition[idx].count = 0;
+    }
+}
+
+/**
+ * @brief  Resets the profile when CPU1 asks for it (OD 0x4012:2)
+ */
+void ControlProfileCheckResetRequest(void)
+{
+    if (sharedVars_cpu1toCpu2.state_machine_stats_reset != lastStatsResetRequest) {
+        lastStatsResetRequest = sharedVars_cpu1toCpu2.state_machine_stats_reset;
+        ControlProfileReset();
+    }
+}
+
+void ControlProfileStateRunBegin(void)
+{
+    stateRunEntryStamp = ControlProfileCycles();
+}
+
+/**
+ * @brief  Called after the do handler of the current state, once every slow tick
+ */
+void ControlProfileStateRunEnd(uint16_t stateIdx)
+{
+    sm_state_stats_t *st = &sharedVars_cpu2toCpu1.state_machine_stats.state[stateIdx];
+    uint32_t cycles = (uint32_t)(ControlProfileCycles() - stateRunEntryStamp);
+    uint32_t binLimit = SM_STATS_HISTOGRAM_BIN0;
+    uint16_t bin = 0;
+
+    st->ticks++;
+    stateRunSumCycles[stateIdx] += cycles;
+    st->meanCycles = (uint32_t)(stateRunSumCycles[stateIdx] / st->ticks);
+
+    if ((st->ticks == 1) || (cycles < st->minCycles)) {
+        st->minCycles = cycles;
+    }
+    if (cycles > st->maxCycles) {
+        st->maxCycles = cycles;
+    }
+
+    while ((bin < SM_STATS_HISTOGRAM_BINS - 1) && (cycles >= binLimit)) {
+        bin++;
+        binLimit <<= 1;
+    }
+    if (st->histogram[bin] < UINT16_MAX) {
+        st->histogram[bin]++;
+    }
+}
+
+void ControlProfileStateEntered(uint16_t stateIdx)
+{
+    sharedVars_cpu2toCpu1.state_machine_stats.state[stateIdx].entries++;
+}
+
+void ControlProfileStateTransitionTaken(uint16_t transitionIdx)
+{
+    if (transitionIdx < SM_STATS_MAX_TRANSITIONS) {
+        sharedVars_cpu2toCpu1.state_machine_stats.transition[transitionIdx].count++;
+    }
+}
+
+/**
+ * @brief  State changed by an IOP request, the safe state or the error handling
+ * instead of a transition of the state table
+ */
+void ControlProfileStateForcedTransition(void)
+{
+    sharedVars_cpu2toCpu1.state_machine_stats.forcedTransitions++;
+}
+
+/**
+ * @brief  Called when the fast (ISR) or slow (super loop) control task starts
+ */
+void ControlProfileRateBegin(ControlRate_t rate)
+{
+    ControlTickCost_t *tick = &controlProfile.rate[rate];
+    uint64_t now = ControlProfileCycles();
+
+    if (tick->tickCount > 0) {
+        tick->lastPeriodCycles = (uint32_t)(now - tick->entryStamp);
+        if (tick->lastPeriodCycles < tick->minPeriodCycles) {
+            tick->minPeriodCycles = tick->lastPeriodCycles;
+        }
+        if (tick->lastPeriodCycles > tick->maxPeriodCycles) {
+            tick->maxPeriodCycles = tick->lastPeriodCycles;
+        }
+    } else {
+        tick->firstStamp = now;
+    }
+    tick->entryStamp = now;
+}
+
+/**
+ * @brief  Called when the fast (ISR) or slow (super loop) control task is done
+ */
+void ControlProfileRateEnd(ControlRate_t rate)
+{
+    ControlTickCost_t *tick = &controlProfile.rate[rate];
+
+    tick->lastCycles = (uint32_t)(ControlProfileCycles() - tick->entryStamp);
+    tick->sumCycles += tick->lastCycles;
+    tick->tickCount++;
+
+    if (tick->lastCycles < tick->minCycles) {
+        tick->minCycles = tick->lastCycles;
+    }
+    if (tick->lastCycles > tick->maxCycles) {
+        tick->maxCycles = tick->lastCycles;
+    }
+    if ((tick->lastPeriodCycles != 0) && (tick->lastCycles > tick->lastPeriodCycles)) {
+        tick->overruns++;
+    }
+}
+
+void ControlProfileStateTransition(uint16_t stateFrom, uint16_t stateTo)
+{
+    uint32_t now = CounterGroup.StateMachineCounter;
+    int16_t idx;
+
+    idx = ControlProfileTrackedIdx(stateFrom);
+    if (idx >= 0) {
+        controlProfile.transient[idx].durationTicks = now - controlProfile.transient[idx].entryTick;
+    }
+
+    idx = ControlProfileTrackedIdx(stateTo);
+    if (idx >= 0) {
+        ControlTransient_t *tr = &controlProfile.transient[idx];
+        tr->entries++;
+        tr->entryTick = now;
+        tr->lastOutOfBandTick = now;
+        tr->settlingTicks = 0;
+        tr->peak = 0.0;
+        tr->overshootPercent = 0.0;
+    }
+
+    if (stateTo == ChargeInit && !controlProfile.chargeInProgress) {
+        controlProfile.chargeStartTick = now;
+        controlProfile.chargeInProgress = true;
+    }
+    if (controlProfile.chargeInProgress &&
+        (stateTo == ChargeStop || stateTo == BalancingInit || stateTo == Fault || stateTo == EmergencyStop)) {
+        controlProfile.timeToChargeTicks = now - controlProfile.chargeStartTick;
+        controlProfile.chargeInProgress = false;
+    }
+}
+
+/**
+ * @brief  Samples the regulated value of the current state against its reference
+ */
+void ControlProfileTrackTransient(uint16_t state)
+{
+    ControlTransient_t *tr;
+    float measured;
+    float reference;
+    float band;
+    int16_t idx;
+
+    idx = ControlProfileTrackedIdx(state);
+    if (idx < 0) {
+        return;
+    }
+    tr = &controlProfile.transient[idx];
+
+    switch (state) {
+        case ChargeRamp:
+        case Charge:
+            measured = -sensorVector[ISen2fIdx].realValue;
+            reference = DCDC_VI.I_Ref_Real;
+            break;
+        case Regulate:
+            measured = sensorVector[ISen2fIdx].realValue;
+            reference = DCDC_VI.I_Ref_Real;
+            break;
+        case RegulateVoltage:
+            measured = sensorVector[VBusIdx].realValue;
+            reference = DCDC_VI.target_Voltage_At_DCBus * REG_TARGET_DC_BUS_VOLTAGE_RATIO;
+            break;
+        default:
+            return;
+    }
+
+    tr->reference = reference;
+    if (measured > tr->peak) {
+        tr->peak = measured;
+        if (reference > 0.0 && measured > reference) {
+            tr->overshootPercent = 100.0 * (measured - reference) / reference;
+        }
+    }
+
+    band = fabsf(reference) * CONTROL_PROFILE_SETTLING_BAND_RATIO;
+    if (band < CONTROL_PROFILE_SETTLING_BAND_MIN) {
+        band = CONTROL_PROFILE_SETTLING_BAND_MIN;
+    }
+    if (fabsf(reference - measured) > band) {
+        tr->lastOutOfBandTick = CounterGroup.StateMachineCounter;
+    }
+    tr->settlingTicks = tr->lastOutOfBandTick - tr->entryTick;
+}
+
+/**
+ * @brief  Mean period of a rate in us, measured between its first and last run
+ */
+static float ControlProfileMeanPeriodUs(ControlRate_t rate)
+{
+    ControlTickCost_t *tick = &controlProfile.rate[rate];
+
+    if (tick->tickCount < 2) {
+        return 0.0;
+    }
+    return (float)(tick->entryStamp - tick->firstStamp) / (float)(tick->tickCount - 1)
+           / ((float)DEVICE_SYSCLK_FREQ / 1.0e6);
+}
+
+void ControlProfilePrint(void)
+{
+    float cyclesPerUs = (float)DEVICE_SYSCLK_FREQ / 1.0e6;
+    float slowPeriodUs = 0.0;
+    float load;
+    uint16_t idx;
+
+    for (idx = 0; idx < CP_NumOfRates; idx++) {
+        ControlTickCost_t tick = controlProfile.rate[idx];
+
+        if (tick.tickCount < 2) {
+            PRINT("Rate %s: not running\r\n", rateNames[idx]);
+            continue;
+        }
+        load = 100.0 * (float)tick.sumCycles / (float)(tick.entryStamp - tick.firstStamp);
+
+        PRINT("Rate %s: ticks:[%lu] period:[%6.2f]us min:[%lu] max:[%lu] cycles\r\n",
+              rateNames[idx], tick.tickCount, tick.lastPeriodCycles / cyclesPerUs,
+              tick.minPeriodCycles, tick.maxPeriodCycles);
+        PRINT("Rate %s: cost cycles min:[%lu] avg:[%lu] max:[%lu] load:[%5.1f]%% overruns:[%lu]\r\n",
+              rateNames[idx], tick.minCycles, (uint32_t)(tick.sumCycles / tick.tickCount),
+              tick.maxCycles, load, tick.overruns);
+    }
+    PRINT("Slow task divider:[%d] skipped ticks:[%lu] stalls:[%lu]\r\n", SM_SLOW_TASK_DIVIDER,
+          CounterGroup.SlowTaskSkippedTicks, CounterGroup.SlowTaskStalls);
+
+    /* transient metrics are counted in slow task ticks */
+    slowPeriodUs = ControlProfileMeanPeriodUs(CP_RateSlow);
+
+    for (idx = 0; idx < CP_NumOfTrackedStates; idx++) {
+        ControlTransient_t tr = controlProfile.transient[idx];
+        PRINT("State %03d n:[%lu] ref:[%7.2f] overshoot:[%6.2f]%% settling:[%8.2f]ms duration:[%lu]ticks\r\n",
+              tr.state, tr.entries, tr.reference, tr.overshootPercent,
+              tr.settlingTicks * slowPeriodUs / 1000.0, tr.durationTicks);
+    }
+
+    PRINT("Time to charge:[%8.2f]s%s\r\n",
+          controlProfile.timeToChargeTicks * slowPeriodUs / 1.0e6,
+          controlProfile.chargeInProgress ? " (charging)" : "");
+}
+
+void ControlProfileStatesPrint(void)
+{
+    state_machine_stats_t *stats = &sharedVars_cpu2toCpu1.state_machine_stats;
+    float slowPeriodMs = ControlProfileMeanPeriodUs(CP_RateSlow) / 1000.0;
+    uint16_t idx;
+
+    PRINT("State n:entries time:ms do cycles min/mean/max histogram <%d<<n cycles\r\n", SM_STATS_HISTOGRAM_BIN0);
+    for (idx = 0; idx < stats->numOfStates; idx++) {
+        sm_state_stats_t *st = &stats->state[idx];
+
+        if (st->ticks == 0) {
+            continue;
+        }
+        PRINT("State %03d n:[%lu] time:[%10.1f] cycles:[%lu/%lu/%lu] hist:[%u %u %u %u %u %u %u %u]\r\n",
+              st->state, st->entries, st->ticks * slowPeriodMs,
+              st->minCycles, st->meanCycles, st->maxCycles,
+              st->histogram[0], st->histogram[1], st->histogram[2], st->histogram[3],
+              st->histogram[4], st->histogram[5], st->histogram[6], st->histogram[7]);
+    }
+
+    for (idx = 0; idx < stats->numOfTransitions; idx++) {
+        sm_transition_stats_t *tr = &stats->transition[idx];
+
+        if (tr->count == 0) {
+            continue;
+        }
+        PRINT("Transition %03d -> %03d n:[%lu]\r\n", tr->from, tr->to, tr->count);
+    }
+    PRINT("Forced transitions:[%lu]\r\n", stats->forcedTransitions);
+}
@@ -0,0 +1,264 @@
+/*
+ * cpu2_log.c
+ *
+ *  CPU2 side of the CPU2 to CPU1 debug ring, see cpu2_log.h.
+ *
+ *  The ring has one writer, the super loop. Interrupt service routines only
+ *  fill the event latch of their id, cpu2_log_poll() turns latched events
+ *  into records. Nothing here waits for CPU1, a record that does not fit is
+ *  dropped and counted. While a CLI command runs its print outs, which are
+ *  longer than the ring, go to a backlog that cpu2_log_poll() passes on as
+ *  CPU1 frees the ring.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cpu2_log.h"
+#include "shared_variables.h"
+
+#define CPU2_LOG_BACKLOG_MASK   (CPU2_LOG_BACKLOG_SIZE - 1)
+
+/* one pending event per id, filled in interrupt context */
+typedef struct cpu2_log_latch {
+    volatile uint16_t posted;           /* incremented by the poster */
+    volatile uint16_t taken;            /* incremented by cpu2_log_poll() */
+    uint16_t nargs;
+    uint32_t timestamp;
+    uint32_t args[CPU2_LOG_MAX_ARGS];
+} cpu2_log_latch_t;
+
+static cpu2_log_latch_t cpu2LogLatch[CPU2_LOG_NUM_OF_IDS];
+static volatile uint16_t cpu2LogLatchLost[CPU2_LOG_NUM_OF_IDS];
+static uint16_t cpu2LogLatchLostSeen[CPU2_LOG_NUM_OF_IDS];
+
+/* text records waiting for room in the ring, super loop only */
+static uint16_t cpu2LogBacklog[CPU2_LOG_BACKLOG_SIZE];
+static uint16_t cpu2LogBacklogHead = 0;
+static uint16_t cpu2LogBacklogTail = 0;
+
+static bool cpu2LogDeferred = false;
+static char cpu2LogText[CPU2_LOG_MAX_TEXT + 1];
+
+void cpu2_log_init(void)
+{
+    uint16_t id;
+
+    for (id = 0; id < CPU2_LOG_NUM_OF_IDS; id++) {
+        cpu2LogLatch[id].taken = cpu2LogLatch[id].posted;
+        cpu2LogLatchLostSeen[id] = cpu2LogLatchLost[id];
+    }
+    cpu2LogBacklogHead = 0;
+    cpu2LogBacklogTail = 0;
+
+    cpu2_log_ring.records = 0;
+    cpu2_log_ring.dropped = 0;
+    cpu2_log_ring.head = sharedVars_cpu1toCpu2.cpu2_log_tail;
+}
+
+static inline uint16_t cpu2_log_free(void)
+{
+    return CPU2_LOG_RING_SIZE - (uint16_t)(cpu2_log_ring.head - sharedVars_cpu1toCpu2.cpu2_log_tail);
+}
+
+static inline uint16_t cpu2_log_backlog_used(void)
+{
+    return cpu2LogBacklogHead - cpu2LogBacklogTail;
+}
+
+static inline uint16_t cpu2_log_record_len(const uint32_t *args, uint16_t len)
+{
+    return CPU2_LOG_HEADER_WORDS + ((args != NULL) ? 2 * len : (len + 1) / 2);
+}
+
+/**
+ * @brief  Writes one record at head, the arguments are either 32 bit words or packed text
+ * @return the index after the record
+ */
+static uint16_t cpu2_log_put(volatile uint16_t *buffer, uint16_t mask, uint16_t head,
+                             uint16_t id, uint32_t timestamp,
+                             const uint32_t *args, const char *text, uint16_t len)
+{
+    uint16_t i;
+
+    buffer[head++ & mask] = id;
+    buffer[head++ & mask] = cpu2_log_record_len(args, len) - CPU2_LOG_HEADER_WORDS;
+    buffer[head++ & mask] = (uint16_t)timestamp;
+    buffer[head++ & mask] = (uint16_t)(timestamp >> 16);
+
+    if (args != NULL) {
+        for (i = 0; i < len; i++) {
+            buffer[head++ & mask] = (uint16_t)args[i];
+            buffer[head++ & mask] = (uint16_t)(args[i] >> 16);
+        }
+    } else {
+        for (i = 0; i < len; i += 2) {
+            buffer[head++ & mask] =
+                    (text[i] & 0xFF) | ((i + 1 < len) ? ((text[i + 1] & 0xFF) << 8) : 0);
+        }
+    }
+    return head;
+}
+
+/* makes the records up to head visible to CPU1 */
+static inline void cpu2_log_publish(uint16_t head, uint16_t records)
+{
+    CPU2_LOG_BARRIER();
+    cpu2_log_ring.head = head;
+    cpu2_log_ring.records += records;
+}
+
+static bool cpu2_log_write(uint16_t id, uint32_t timestamp, const uint32_t *args, const char *text, uint16_t len)
+{
+    uint16_t recordLen = cpu2_log_record_len(args, len);
+
+    if (recordLen > cpu2_log_free()) {
+        cpu2_log_ring.dropped++;
+        return false;
+    }
+
+    cpu2_log_publish(cpu2_log_put(cpu2_log_ring.buffer, CPU2_LOG_RING_MASK, cpu2_log_ring.head,
+                                  id, timestamp, args, text, len), 1);
+    return true;
+}
+
+/**
+ * @brief  Posts an event, may be called from interrupt context
+ * Only the latch of the id is written, cpu2_log_poll() writes the record.
+ */
+bool cpu2_log_event(uint16_t id, const uint32_t *args, uint16_t nargs)
+{
+    cpu2_log_latch_t *latch;
+    uint16_t i;
+
+    if (id >= CPU2_LOG_NUM_OF_IDS) {
+        return false;
+    }
+    latch = &cpu2LogLatch[id];
+
+    if (latch->posted != latch->taken) {
+        /* the earlier event has not been taken yet */
+        cpu2LogLatchLost[id]++;
+        return false;
+    }
+
+    if (nargs > CPU2_LOG_MAX_ARGS) {
+        nargs = CPU2_LOG_MAX_ARGS;
+    }
+    for (i = 0; i < nargs; i++) {
+        latch->args[i] = args[i];
+    }
+    latch->nargs = nargs;
+    latch->timestamp = (uint32_t)IPC_getCounter(IPC_CPU2_L_CPU1_R);
+
+    CPU2_LOG_BARRIER();
+    latch->posted++;
+    return true;
+}
+
+/**
+ * @brief  Logs a text from the super loop
+ * While deferred, text that does not fit in the ring is kept in the backlog.
+ * Text never overtakes the backlog, so the order of the lines is kept.
+ */
+bool cpu2_log_text(const char *text, uint16_t len)
+{
+    uint32_t timestamp = (uint32_t)IPC_getCounter(IPC_CPU2_L_CPU1_R);
+    uint16_t recordLen;
+
+    if (len > CPU2_LOG_MAX_TEXT) {
+        len = CPU2_LOG_MAX_TEXT;
+    }
+    recordLen = cpu2_log_record_len(NULL, len);
+
+    if ((cpu2_log_backlog_used() == 0) && (recordLen <= cpu2_log_free())) {
+        return cpu2_log_write(CPU2_LOG_TEXT, timestamp, NULL, text, len);
+    }
+
+    if ((cpu2LogDeferred || (cpu2_log_backlog_used() != 0)) &&
+        (recordLen <= CPU2_LOG_BACKLOG_SIZE - cpu2_log_backlog_used())) {
+        cpu2LogBacklogHead = cpu2_log_put(cpu2LogBacklog, CPU2_LOG_BACKLOG_MASK, cpu2LogBacklogHead,
+                                          CPU2_LOG_TEXT, timestamp, NULL, text, len);
+        return true;
+    }
+
+    cpu2_log_ring.dropped++;
+    return false;
+}
+
+/**
+ * @brief  Formats on CPU2 and logs the text, not for interrupt context
+ */
+void cpu2_log_printf(const char *fmt, ...)
+{
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(cpu2LogText, sizeof(cpu2LogText), fmt, args);
+    va_end(args);
+
+    if (len < 0) {
+        return;
+    }
+    if (len > CPU2_LOG_MAX_TEXT) {
+        len = CPU2_LOG_MAX_TEXT;
+    }
+    cpu2_log_text(cpu2LogText, len);
+}
+
+void cpu2_log_set_deferred(bool deferred)
+{
+    cpu2LogDeferred = deferred;
+}
+
+/**
+ * @brief  Moves latched events and backlogged text into the ring, called from the super loop
+ */
+void cpu2_log_poll(void)
+{
+    cpu2_log_latch_t *latch;
+    uint16_t id;
+    uint16_t lost;
+    uint16_t head;
+    uint16_t recordLen;
+    uint16_t records = 0;
+    uint16_t i;
+
+    for (id = 0; id < CPU2_LOG_NUM_OF_IDS; id++) {
+        latch = &cpu2LogLatch[id];
+
+        lost = cpu2LogLatchLost[id];
+        if (lost != cpu2LogLatchLostSeen[id]) {
+            cpu2_log_ring.dropped += (uint16_t)(lost - cpu2LogLatchLostSeen[id]);
+            cpu2LogLatchLostSeen[id] = lost;
+        }
+
+        if (latch->posted == latch->taken) {
+            continue;
+        }
+        CPU2_LOG_BARRIER();
+        cpu2_log_write(id, latch->timestamp, latch->args, NULL, latch->nargs);
+        latch->taken++;
+    }
+
+    /* whole records only, CPU1 must never see a partial one */
+    head = cpu2_log_ring.head;
+    while (cpu2_log_backlog_used() != 0) {
+        recordLen = CPU2_LOG_HEADER_WORDS + cpu2LogBacklog[(cpu2LogBacklogTail + 1) & CPU2_LOG_BACKLOG_MASK];
+        if (recordLen > (uint16_t)(CPU2_LOG_RING_SIZE - (uint16_t)(head - sharedVars_cpu1toCpu2.cpu2_log_tail))) {
+            break;
+        }
+        for (i = 0; i < recordLen; i++) {
+            cpu2_log_ring.buffer[head++ & CPU2_LOG_RING_MASK] =
+                    cpu2LogBacklog[cpu2LogBacklogTail++ & CPU2_LOG_BACKLOG_MASK];
+        }
+        records++;
+    }
+    if (records != 0) {
+        cpu2_log_publish(head, records);
+    }
+}
@@ -19,7 +19,6 @@
 extern sharedVars_cpu2toCpu1_t sharedVars_cpu2toCpu1;
 extern float cellVoltagesVector[30];
 
-bool debug_log_enable_flag = true;
 bool debug_log_force_update_flag = false ;
 uint32_t debug_counter = 0;
 
@@ -71,156 +70,66 @@ uint32_t SetDebugLogPeriod(void) {
             default:
                 debug_period_in_ms = LOG_PERIOD_IDLE;
         }
-        debug_log_enable_flag = true;
     }
     return debug_period_in_ms;
 }
 
-void DisableDebugLog(void){
-    debug_log_enable_flag = false;
-}
-
-void EnableDebugLog(void){
-    debug_log_enable_flag = true;
-}
-
-
 void ForceUpdateDebugLog(void) {
     debug_log_force_update_flag = true;
 }
 
-void UpdateDebugLogSM(void) {
-    enum { UDLInit, UDLWaitLogPeriod, UDLCopyVarsSection1, UDLCopyVarsSection2, UDLCopyVarsSection3,
-        UDLCopyVarsSection4, UDLCopyVarsSection5, UDLEnd };
-
-    static States_t UDLSM = { UDLInit };
-    static uint16_t cellIdx = 0;
-    static uint32_t last_timer = 0;
-    uint32_t current_timer;
-    static uint32_t elapsed_time;
-    static uint32_t debug_period_in_ms = LOG_PERIOD_IDLE;
-    if( debug_log_enable_flag == true ) {
-    debug_period_in_ms = SetDebugLogPeriod();
-    switch( UDLSM.State_Current) {
-        case UDLInit:
-//            UDLSM.State_Next = UDLWaitLogPeriod;
-//            break;
-//
-        case UDLWaitLogPeriod:
-            current_timer = timer_get_ticks();
-            elapsed_time = current_timer - last_timer;
-            if( current_timer < last_timer ) {
-                current_timer = 0;
-            } else if( ( elapsed_time >= debug_period_in_ms ) ) {
-                cellIdx=0;
-                debug_counter++;
-                last_timer = current_timer;
-                UDLSM.State_Next = UDLCopyVarsSection1;
-            }
-            break;
-        case UDLCopyVarsSection1:
-            sharedVars_cpu2toCpu1.debug_log.ISen1 = sensorVector[ISen1fIdx].realValue * 10;     // Storage current sensor (supercap) x10
-            sharedVars_cpu2toCpu1.debug_log.ISen2 = sensorVector[ISen2fIdx].realValue * 10;     // Output load current sensor x10
-            sharedVars_cpu2toCpu1.debug_log.IF_1 = sensorVector[IF_1fIdx].realValue * 10;       // Input current x10
-            UDLSM.State_Next = UDLCopyVarsSection2;
-            break;
-        case UDLCopyVarsSection2:
-            sharedVars_cpu2toCpu1.debug_log.Vbus = sensorVector[VBusIdx].realValue * 10;        // VBus voltage x10
-            sharedVars_cpu2toCpu1.debug_log.VStore = sensorVector[VStoreIdx].realValue * 10;    // VStore voltage x10
-            sharedVars_cpu2toCpu1.debug_log.cpu2_error_code = sharedVars_cpu2toCpu1.error_code;
-            sharedVars_cpu2toCpu1.debug_log.CurrentState = StateVector.State_Current;    // CPU2 current state of main state machine
-            sharedVars_cpu2toCpu1.debug_log.elapsed_time = elapsed_time;
-            if(debug_period_in_ms > LOG_PERIOD_IMEDIATELY ) {
-                UDLSM.State_Next = UDLCopyVarsSection3;
-            } else {
-                UDLSM.State_Next = UDLEnd;
-            }
-            break;
-        case UDLCopyVarsSection3:
-           sharedVars_cpu2toCpu1.debug_log.AvgVbus = DCDC_VI.avgVBus * 10;        // VBus voltage x10
-           sharedVars_cpu2toCpu1.debug_log.AvgVStore  = DCDC_VI.avgVStore * 10;        // VBus voltage x10
-            UDLSM.State_Next = UDLCopyVarsSection4;
-            break;
-        case UDLCopyVarsSection4:
-            sharedVars_cpu2toCpu1.debug_log.RegulateAvgInputCurrent = DCDC_VI.RegulateAvgInputCurrent * 10;
-            sharedVars_cpu2toCpu1.debug_log.RegulateAvgVStore = DCDC_VI.RegulateAvgVStore * 10;
-            sharedVars_cpu2toCpu1.debug_log.RegulateAvgVbus = DCDC_VI.RegulateAvgVbus * 10;
-            sharedVars_cpu2toCpu1.debug_log.RegulateAvgOutputCurrent = DCDC_VI.RegulateAvgOutputCurrent * 10;
-            sharedVars_cpu2toCpu1.debug_log.RegulateIRef = DCDC_VI.I_Ref_Real * 100;
-            sharedVars_cpu2toCpu1.debug_log.ILoop_PiOutput = ILoop_PiOutput.Output * 100;
-            sharedVars_cpu2toCpu1.debug_log.I_Dab2 = sensorVector[I_Dab2fIdx].realValue * 100;  // CLLC1 Current x100
-            sharedVars_cpu2toCpu1.debug_log.I_Dab3 = sensorVector[I_Dab3fIdx].realValue * 100;  // CLLC2 Current x100
-            UDLSM.State_Next = UDLCopyVarsSection5;
-            break;
-        case UDLCopyVarsSection5:
-            sharedVars_cpu2toCpu1.debug_log.cellVoltage[cellIdx] = cellVoltagesVector[cellIdx] * 100;
-            sharedVars_cpu2toCpu1.debug_log.cellVoltage[cellIdx+1] = cellVoltagesVector[cellIdx+1] * 100;
-            sharedVars_cpu2toCpu1.debug_log.cellVoltage[cellIdx+2] = cellVoltagesVector[cellIdx+2] * 100;
-            cellIdx = cellIdx + 3;
-            if( cellIdx >= NUMBER_OF_CELLS){
-                UDLSM.State_Next = UDLEnd;
-            }
-            break;
-        case UDLEnd:
-            sharedVars_cpu2toCpu1.debug_log.counter = debug_counter;
-            UDLSM.State_Next = UDLInit;
-            break;
-        default:
-            UDLSM.State_Next = UDLInit;
-
-        }
-    UDLSM.State_Current = UDLSM.State_Next;
+/**
+ * @brief  Publishes a complete record to CPU1 in one pass
+ * Fills the buffer CPU1 is not reading, see debug_log_snapshot_t.
+ */
+static void PublishDebugLog(uint32_t elapsed_time)
+{
+    uint16_t next = sharedVars_cpu2toCpu1.debug_log.published ^ 1;
+    volatile debug_log_t *log = &sharedVars_cpu2toCpu1.debug_log.record[next];
+    int i;
+
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;   /* odd, being written */
+
+    log->counter = debug_counter;
+    log->ISen1 = sensorVector[ISen1fIdx].realValue * 10;     // Storage current sensor (supercap) x10
+    log->ISen2 = sensorVector[ISen2fIdx].realValue * 10;     // Output load current sensor x10
+    log->IF_1 = sensorVector[IF_1fIdx].realValue * 10;       // Input current x10
+    log->I_Dab2 = sensorVector[I_Dab2fIdx].realValue * 100;  // CLLC1 Current x100
+    log->I_Dab3 = sensorVector[I_Dab3fIdx].realValue * 100;  // CLLC2 Current x100
+    log->Vbus = sensorVector[VBusIdx].realValue * 10;        // VBus voltage x10
+    log->AvgVbus = DCDC_VI.avgVBus * 10;                     // VBus voltage x10
+    log->VStore = sensorVector[VStoreIdx].realValue * 10;    // VStore voltage x10
+    log->AvgVStore = DCDC_VI.avgVStore * 10;                 // VStore voltage x10
+    log->RegulateAvgInputCurrent = DCDC_VI.RegulateAvgInputCurrent * 10;
+    log->RegulateAvgVStore = DCDC_VI.RegulateAvgVStore * 10;
+    log->RegulateAvgVbus = DCDC_VI.RegulateAvgVbus * 10;
+    log->RegulateAvgOutputCurrent = DCDC_VI.RegulateAvgOutputCurrent * 10;
+    log->RegulateIRef = DCDC_VI.I_Ref_Real * 100;
+    log->ILoop_PiOutput = ILoop_PiOutput.Output * 100;
+    log->cpu2_error_code = sharedVars_cpu2toCpu1.error_code;
+    log->CurrentState = StateVector.State_Current;    // CPU2 current state of main state machine
+    log->elapsed_time = elapsed_time;
+    for (i = 0; i < NUMBER_OF_CELLS; i++) {
+        log->cellVoltage[i] = cellVoltagesVector[i] * 100;
     }
+
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;   /* even, complete */
+    sharedVars_cpu2toCpu1.debug_log.published = next;
 }
 
 void UpdateDebugLog(void) {
     static uint32_t last_timer = 0;
     uint32_t current_timer, elapsed_time;
-    static uint32_t debug_period_in_ms = LOG_PERIOD_IDLE;
-    //uint16_t switches;
-    debug_period_in_ms = SetDebugLogPeriod();
-    if( debug_log_enable_flag == true ) {
-        current_timer = timer_get_ticks();
-        elapsed_time = current_timer - last_timer;
-        if( current_timer < last_timer ) {
-            current_timer = 0;
-        } else if( ( elapsed_time >= debug_period_in_ms ) ) {
-            debug_counter++;
-            sharedVars_cpu2toCpu1.debug_log.counter = debug_counter;
-            sharedVars_cpu2toCpu1.debug_log.ISen1 = sensorVector[ISen1fIdx].realValue * 10;     // Storage current sensor (supercap) x10
-            sharedVars_cpu2toCpu1.debug_log.ISen2 = sensorVector[ISen2fIdx].realValue * 10;     // Output load current sensor x10
-            sharedVars_cpu2toCpu1.debug_log.IF_1 = sensorVector[IF_1fIdx].realValue * 10;       // Input current x10
-            sharedVars_cpu2toCpu1.debug_log.I_Dab2 = sensorVector[I_Dab2fIdx].realValue * 100;  // CLLC1 Current x100
-            sharedVars_cpu2toCpu1.debug_log.I_Dab3 = sensorVector[I_Dab3fIdx].realValue * 100;  // CLLC2 Current x100
-            sharedVars_cpu2toCpu1.debug_log.Vbus = sensorVector[VBusIdx].realValue * 10;        // VBus voltage x10
-            sharedVars_cpu2toCpu1.debug_log.AvgVbus = DCDC_VI.avgVBus * 10;        // VBus voltage x10
-            sharedVars_cpu2toCpu1.debug_log.VStore = sensorVector[VStoreIdx].realValue * 10;    // VStore voltage x10
-            sharedVars_cpu2toCpu1.debug_log.AvgVStore  = DCDC_VI.avgVStore * 10;        // VBus voltage x10
-            sharedVars_cpu2toCpu1.debug_log.RegulateAvgInputCurrent = DCDC_VI.RegulateAvgInputCurrent * 10;
-            sharedVars_cpu2toCpu1.debug_log.RegulateAvgVStore = DCDC_VI.RegulateAvgVStore * 10;
-            sharedVars_cpu2toCpu1.debug_log.RegulateAvgVbus = DCDC_VI.RegulateAvgVbus * 10;
-            sharedVars_cpu2toCpu1.debug_log.RegulateAvgOutputCurrent = DCDC_VI.RegulateAvgOutputCurrent * 10;
-            sharedVars_cpu2toCpu1.debug_log.RegulateIRef = DCDC_VI.I_Ref_Real * 100;
-            sharedVars_cpu2toCpu1.debug_log.ILoop_PiOutput = ILoop_PiOutput.Output*100;
-            sharedVars_cpu2toCpu1.debug_log.cpu2_error_code = sharedVars_cpu2toCpu1.error_code;
-
-
-            sharedVars_cpu2toCpu1.debug_log.CurrentState = StateVector.State_Current;    // CPU2 current state of main state machine
-            sharedVars_cpu2toCpu1.debug_log.elapsed_time = elapsed_time;
-            for(int i=0; i<NUMBER_OF_CELLS; i++) {
-                sharedVars_cpu2toCpu1.debug_log.cellVoltage[i] = cellVoltagesVector[i]*100;
-            }
+    uint32_t debug_period_in_ms;
 
-            //switches = 0;
-            //switches = (GPIO_readPin(Qinb)==SW_ON) ? (switches |= QINB_MASK) : (switches &= ~QINB_MASK);
-            //switches = (GPIO_readPin(Qlb)==SW_ON)  ? (switches |= QLB_MASK)  : (switches &= ~QLB_MASK);
-            //switches = (GPIO_readPin(Qsb)==SW_ON) ? (switches |= QSB_MASK) : (switches &= ~QSB_MASK);
-            //switches = (GPIO_readPin(168)==SW_ON) ? (switches |= QINRUSH_MASK) : (switches &= ~QINRUSH_MASK);
-
-            //sharedVars_cpu2toCpu1.debug_log.Switches = switches;
-            last_timer = current_timer;
-        }
+    debug_period_in_ms = SetDebugLogPeriod();
+    current_timer = timer_get_ticks();
+    elapsed_time = current_timer - last_timer;
+    if( current_timer < last_timer ) {
+        current_timer = 0;
+    } else if( ( elapsed_time >= debug_period_in_ms ) ) {
+        debug_counter++;
+        PublishDebugLog(elapsed_time);
+        last_timer = current_timer;
     }
 }
-
-
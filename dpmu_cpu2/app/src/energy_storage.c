@@ -304,7 +304,7 @@ bool VerifyCapacitanceValueFromFlashValid(float capacitance){
     uint16_t *memValCapacitance;
     memValCapacitance = (uint16_t*)&capacitance;
 
-    for( int i=0; i<sizeof(float); i++) {
+    for( int i=0; i<sizeof(float)/sizeof(uint16_t); i++) {
         PRINT("memValCapacitance[%d]:[0x%04X] ",i, memValCapacitance[i]);
         if( memValCapacitance[i] != 0xFFFF ) {
             retVal = true;
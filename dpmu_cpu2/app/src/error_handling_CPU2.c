@@ -71,7 +71,9 @@ void HandleLoadOverCurrent(float max_allowed_load_current, uint16_t efuse_top_ha
 
         case LOCStopMainStateMachine:
             lastTime = timer_get_ticks();
-            PRINT("sensorVector[ISen1fIdx]:[%5.2f] max_allowed_load_current:[%5.2f] ",sensorVector[ISen1fIdx].realValue, max_allowed_load_current);
+            CPU2_LOG_EVENT(CPU2_LOG_LOAD_OVER_CURRENT,
+                           cpu2_log_float(sensorVector[ISen1fIdx].realValue),
+                           cpu2_log_float(max_allowed_load_current));
             // Sends main state_machine to Fault state
             dpmuErrorOcurredFlag = true;
             dpmuErrorOcurredClass = DPMU_ERROR_CLASS_SHORT_CIRCUT;
@@ -113,11 +115,11 @@ void HandleDCBusShortCircuit()
             sharedVars_cpu2toCpu1.error_code |= (1UL << ERROR_DISCHARGING);
         }
 
-        PRINT("ISen1f:[%5.2f]  or ISen2f:[%5.2f] or IF_1fIdx:[%5.2f] > SHORT_CIRCUIT_CURRENT:[%5.2f]\r\n",
-                     sensorVector[ISen1fIdx].realValue,
-                     sensorVector[ISen2fIdx].realValue,
-                     sensorVector[IF_1fIdx].realValue,
-                     DPMU_SHORT_CIRCUIT_CURRENT);
+        CPU2_LOG_EVENT(CPU2_LOG_BUS_SHORT_CIRCUIT,
+                       cpu2_log_float(sensorVector[ISen1fIdx].realValue),
+                       cpu2_log_float(sensorVector[ISen2fIdx].realValue),
+                       cpu2_log_float(sensorVector[IF_1fIdx].realValue),
+                       cpu2_log_float(DPMU_SHORT_CIRCUIT_CURRENT));
     } else {
         sharedVars_cpu2toCpu1.error_code &= ~(1UL << ERROR_BUS_SHORT_CIRCUIT);
         if( sensorVector[ISen2fIdx].realValue <= sharedVars_cpu1toCpu2.supercap_short_circuit_current ) {
@@ -159,8 +161,9 @@ void HandleDCBusOverVoltage() {
 
         case BOVStopMainStateMachine:
             lastTime = timer_get_ticks();
-            PRINT("DCDC_VI.avgVBus[%5.2f] max_allowed_dc_bus_voltage:[%5.2f]\r\n ",
-                  DCDC_VI.avgVBus, sharedVars_cpu1toCpu2.max_allowed_dc_bus_voltage);
+            CPU2_LOG_EVENT(CPU2_LOG_BUS_OVER_VOLTAGE,
+                           cpu2_log_float(DCDC_VI.avgVBus),
+                           cpu2_log_float(sharedVars_cpu1toCpu2.max_allowed_dc_bus_voltage));
             // Sends main state_machine to Fault state
             dpmuErrorOcurredFlag = true;
             dpmuErrorOcurredClass = DPMU_ERROR_CLASS_OVERVOLTAGE;
@@ -216,9 +219,9 @@ void HandleDCBusUnderVoltage() {
             }
             break;
         case BUVStopMainStateMachine:
-            PRINT("DCDC_VI.avgVBus[%5.2f] < min_allowed_dc_bus_voltage:[%5.2f]\r\n ",
-                  DCDC_VI.avgVBus,
-                  sharedVars_cpu1toCpu2.min_allowed_dc_bus_voltage/2);
+            CPU2_LOG_EVENT(CPU2_LOG_BUS_UNDER_VOLTAGE,
+                           cpu2_log_float(DCDC_VI.avgVBus),
+                           cpu2_log_float(sharedVars_cpu1toCpu2.min_allowed_dc_bus_voltage/2));
             // Sends main state_machine to Fault state
             dpmuErrorOcurredFlag = true;
             stateBUV.State_Next = BUVEnd;
@@ -0,0 +1,142 @@
+/*
+ * filters.c
+ *
+ *  Signal filters producing a new filtered value on every sample.
+ *
+ *  A moving average update is one add and one subtract regardless of the
+ *  window length. To stop float rounding errors from accumulating in the
+ *  running sum, a second sum is built from the samples as they are written.
+ *  When the window wraps it holds exactly the samples in the window and
+ *  replaces the running sum, so the correction costs one add per sample too.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "filters.h"
+
+void MovingAverageInit(MovingAverage_t *f, float *buffer, uint16_t length)
+{
+    f->buffer = buffer;
+    f->length = (length == 0) ? 1 : length;
+    MovingAverageReset(f);
+}
+
+void MovingAverageReset(MovingAverage_t *f)
+{
+    uint16_t i;
+
+    for (i = 0; i < f->length; i++) {
+        f->buffer[i] = 0.0;
+    }
+    f->idx = 0;
+    f->count = 0;
+    f->sum = 0.0;
+    f->nextSum = 0.0;
+    f->output = 0.0;
+}
+
+/**
+ * @brief  Adds a sample and returns the mean of the last 'length' samples
+ * (of all samples so far until the window is filled)
+ */
+float MovingAverageUpdate(MovingAverage_t *f, float sample)
+{
+    f->sum += sample - f->buffer[f->idx];
+    f->nextSum += sample;
+    f->buffer[f->idx] = sample;
+
+    f->idx++;
+    if (f->idx == f->length) {
+        f->idx = 0;
+        f->sum = f->nextSum;
+        f->nextSum = 0.0;
+    }
+
+    if (f->count < f->length) {
+        f->count++;
+    }
+    f->output = f->sum / f->count;
+
+    return f->output;
+}
+
+void Iir1Init(Iir1_t *f, float alpha)
+{
+    f->alpha = alpha;
+    Iir1Reset(f);
+}
+
+void Iir1Reset(Iir1_t *f)
+{
+    f->output = 0.0;
+    f->primed = false;
+}
+
+/**
+ * @brief  First order low pass, starts at the first sample
+ */
+float Iir1Update(Iir1_t *f, float sample)
+{
+    if (!f->primed) {
+        f->output = sample;
+        f->primed = true;
+    } else {
+        f->output += f->alpha * (sample - f->output);
+    }
+    return f->output;
+}
+
+void MedianInit(Median_t *f, uint16_t length)
+{
+    if (length == 0) {
+        length = 1;
+    }
+    if (length > MEDIAN_FILTER_MAX_LENGTH) {
+        length = MEDIAN_FILTER_MAX_LENGTH;
+    }
+    f->length = length;
+    MedianReset(f);
+}
+
+void MedianReset(Median_t *f)
+{
+    f->idx = 0;
+    f->count = 0;
+    f->output = 0.0;
+}
+
+/**
+ * @brief  Adds a sample and returns the median of the last 'length' samples
+ * Insertion sort of a copy, the window is at most MEDIAN_FILTER_MAX_LENGTH.
+ */
+float MedianUpdate(Median_t *f, float sample)
+{
+    float sorted[MEDIAN_FILTER_MAX_LENGTH];
+    float value;
+    int16_t i, j;
+
+    f->buffer[f->idx] = sample;
+    f->idx++;
+    if (f->idx == f->length) {
+        f->idx = 0;
+    }
+    if (f->count < f->length) {
+        f->count++;
+    }
+
+    for (i = 0; i < f->count; i++) {
+        value = f->buffer[i];
+        for (j = i - 1; (j >= 0) && (sorted[j] > value); j--) {
+            sorted[j + 1] = sorted[j];
+        }
+        sorted[j + 1] = value;
+    }
+
+    if (f->count & 1) {
+        f->output = sorted[f->count / 2];
+    } else {
+        f->output = 0.5 * (sorted[f->count / 2 - 1] + sorted[f->count / 2]);
+    }
+    return f->output;
+}
@@ -22,6 +22,7 @@
 #include "charge.h"
 #include "cli_cpu2.h"
 #include "common.h"
+#include "cpu2_log.h"
 #include "dcbus.h"
 #include "DCDC.h"
 #include "debug_log.h"
@@ -97,6 +98,9 @@ void main(void)
     //IPC_sync(IPC_CPU2_L_CPU1_R, IPC_FLAG11); // Needed only when running CPU2 without bootloader
     IPC_sync(IPC_CPU2_L_CPU1_R, IPC_FLAG31);
 
+    // CPU1 has set up the read index of the debug ring.
+    cpu2_log_init();
+
     Board_init();
     HAL_StopPwmDCDC();
     HAL_StopPwmInrushCurrentLimit();
@@ -146,11 +150,16 @@ void main(void)
         energy_storage_update_settings();
         energy_storage_check();
 
-        //UpdateDebugLog();
-        UpdateDebugLogSM();
+        UpdateDebugLog();
+
+        // Slow supervisory part of the main state machine, requested by the ADC ISR.
+        StateMachineScheduler();
 
         CheckMainStateMachineIsRunning();
 
+        // Move posted events and backlogged CLI output into the debug ring.
+        cpu2_log_poll();
+
     }
 }
 
@@ -205,12 +214,6 @@ static void check_incoming_commands(void)
 
         // Acknowledge the flag.
         IPC_ackFlagRtoL(IPC_CPU2_L_CPU1_R, IPC_FLAG_MESSAGE_CPU1_TO_CPU2);
-
-        if( sharedVars_cpu1toCpu2.debug_log_disable_flag==true ) {
-            DisableDebugLog();
-        } else {
-            EnableDebugLog();
-        }
     }
 }
 
@@ -0,0 +1,149 @@
+/*
+ * pi_controller.c
+ *
+ *  Common PI/PID controller engine for the buck, boost and CLLC loops.
+ *
+ *  The controller state (PiOutput_t) is updated in place through a pointer
+ *  and the parameters are only read, so nothing is copied per update. All
+ *  forms clamp the output to [LowerLimit, UpperLimit] with anti-windup:
+ *  PI_FORM_PARALLEL back-calculates the integrator to the clamped output,
+ *  the DCL forms freeze the integrator while the output is clamped.
+ */
+
+#include "GlobalV.h"
+#include "pi_controller.h"
+
+#define PI_CONTROLLER_CONST_PI 3.14159265358979
+
+static inline float PiControllerClamp(const PI_Parameters_t *PI, PiOutput_t *PIout, float Output)
+{
+    if (Output > PI->UpperLimit) {
+        PIout->clamped = 1;
+        return PI->UpperLimit;
+    }
+    if (Output < PI->LowerLimit) {
+        PIout->clamped = 1;
+        return PI->LowerLimit;
+    }
+    PIout->clamped = 0;
+    return Output;
+}
+
+/**
+ * @brief  Runs one controller update
+ * @return The clamped control effort, also stored in PIout->Output
+ */
+float PiControllerRun(const PI_Parameters_t *PI, PiOutput_t *PIout, float Ref, float ValueRead)
+{
+    float error = Ref - ValueRead;
+    float P_out;
+    float D_out;
+    float v1;
+    float unclamped;
+
+    switch (PI->form) {
+        case PI_FORM_SERIES_DCL:
+            P_out = PI->Pgain * error;
+            if (!PIout->clamped) {
+                PIout->Int_out += PI->Igain * P_out;
+            }
+            unclamped = P_out + PIout->Int_out;
+            PIout->Output = PiControllerClamp(PI, PIout, unclamped);
+            break;
+
+        case PI_FORM_PARALLEL_DCL:
+            P_out = PI->Pgain * error;
+            if (!PIout->clamped) {
+                PIout->Int_out += PI->Igain * error;
+            }
+            unclamped = P_out + PIout->Int_out;
+            PIout->Output = PiControllerClamp(PI, PIout, unclamped);
+            break;
+
+        case PI_FORM_PID_FILTERED:
+            P_out = PI->Pgain * error;
+            if (!PIout->clamped) {
+                PIout->Int_out += PI->Igain * error;
+            }
+            /* Derivative on measurement only, no kick on reference steps */
+            v1 = ValueRead * PI->Dgain * PI->DfilterC1;
+            D_out = v1 - PIout->Deriv_d2 - PIout->Deriv_d3;
+            PIout->Deriv_d2 = v1;
+            PIout->Deriv_d3 = D_out * PI->DfilterC2;
+            unclamped = P_out + PIout->Int_out - D_out;
+            PIout->Output = PiControllerClamp(PI, PIout, unclamped);
+            break;
+
+        case PI_FORM_PARALLEL:
+        default:
+            P_out = PI->Pgain * error;
+            PIout->Int_out += PI->Igain * error;
+            unclamped = P_out + PIout->Int_out;
+            PIout->Output = PiControllerClamp(PI, PIout, unclamped);
+            if (PIout->clamped) {
+                PIout->Int_out = PIout->Output - P_out;
+            }
+            break;
+    }
+
+    PIout->calculated_error = error;
+
+    return PIout->Output;
+}
+
+/**
+ * @brief  Clears the controller state, next output starts from zero
+ */
+void PiControllerReset(PiOutput_t *PIout)
+{
+    PIout->Output = 0.0;
+    PIout->Int_out = 0.0;
+    PIout->calculated_error = 0.0;
+    PIout->dutyCycle = 0;
+    PIout->clamped = 0;
+    PIout->Deriv_d2 = 0.0;
+    PIout->Deriv_d3 = 0.0;
+}
+
+/**
+ * @brief  Bumpless (re)start: preloads the integrator so that the first
+ * update with the given reference and measurement returns Output.
+ */
+void PiControllerBumplessInit(const PI_Parameters_t *PI, PiOutput_t *PIout, float Output, float Ref, float ValueRead)
+{
+    float error = Ref - ValueRead;
+
+    PiControllerReset(PIout);
+
+    if (Output > PI->UpperLimit) {
+        Output = PI->UpperLimit;
+    }
+    if (Output < PI->LowerLimit) {
+        Output = PI->LowerLimit;
+    }
+
+    /* Integrator after the first update: Int_out + Igain * (Pgain *) error */
+    if (PI->form == PI_FORM_SERIES_DCL) {
+        PIout->Int_out = Output - PI->Pgain * error - PI->Igain * PI->Pgain * error;
+    } else {
+        PIout->Int_out = Output - PI->Pgain * error - PI->Igain * error;
+    }
+
+    /* Start the derivative filter at steady state on the current measurement */
+    PIout->Deriv_d2 = ValueRead * PI->Dgain * PI->DfilterC1;
+    PIout->Output = Output;
+    PIout->calculated_error = error;
+}
+
+/**
+ * @brief  Sets the derivative path filter bandwidth (same as DCL_setPIDfilterBW)
+ * @param  fc  filter bandwidth in Hz
+ * @param  T   controller update period in seconds
+ */
+void PiControllerSetDerivativeFilter(PI_Parameters_t *PI, float fc, float T)
+{
+    float tau = 1.0 / (2.0 * PI_CONTROLLER_CONST_PI * fc);
+
+    PI->DfilterC1 = 2.0 / (T + 2.0 * tau);
+    PI->DfilterC2 = (T - 2.0 * tau) / (T + 2.0 * tau);
+}
@@ -9,6 +9,7 @@
 
 #include "board.h"
 #include "CLLC.h"
+#include "control_profile.h"
 #include "DCDC.h"
 #include "GlobalV.h"
 #include "hal.h"
@@ -17,27 +18,29 @@
 #include "switch_matrix.h"
 
 Sensor_t sensorVector[NumOfSensors];
+SensorConversionTable_t sensorConversion;
 
 /**
  * @brief  ADC B Interrupt 4 Function (former Current_Ov interrupt)
  */
 __interrupt void INT_ADCINB_4_ISR(void) {
 
-    sensorVector[ISen2fIdx].counts = ADC_readResult(ADCBRESULT_BASE, ADC_SOC_NUMBER0);
+    ControlProfileRateBegin(CP_RateFast);
+
+    sensorConversion.counts[ISen2fIdx] = ADC_readResult(ADCBRESULT_BASE, ADC_SOC_NUMBER0);
     sensorVector[ISen2fIdx].newADCReady = true;
     sensorVector[ISen2fIdx].convertedReady   = false;
 
-    sensorVector[IF_1fIdx].counts = ADC_readResult(ADCBRESULT_BASE, ADC_SOC_NUMBER1);
+    sensorConversion.counts[IF_1fIdx] = ADC_readResult(ADCBRESULT_BASE, ADC_SOC_NUMBER1);
     sensorVector[IF_1fIdx].newADCReady = true;
     sensorVector[IF_1fIdx].convertedReady   = false;
 
-    StateMachine();
-    //runStateMachineFlag = true;
+    StateMachineFastTick();
 
     ADC_clearInterruptStatus(ADCB_BASE, ADC_INT_NUMBER4);
     Interrupt_clearACKGroup( INT_ADCINB_4_INTERRUPT_ACK_GROUP );
 
-
+    ControlProfileRateEnd(CP_RateFast);
 }
 
 /**
@@ -46,11 +49,11 @@ __interrupt void INT_ADCINB_4_ISR(void) {
 void INT_ADCINA_2_ISR(void)
 {
 
-    sensorVector[VBusIdx].counts = ADC_readResult(ADCARESULT_BASE, ADC_SOC_NUMBER0);
+    sensorConversion.counts[VBusIdx] = ADC_readResult(ADCARESULT_BASE, ADC_SOC_NUMBER0);
     sensorVector[VBusIdx].newADCReady = true;
     sensorVector[VBusIdx].convertedReady = false;
 
-    sensorVector[VStoreIdx].counts = ADC_readResult(ADCARESULT_BASE, ADC_SOC_NUMBER1);
+    sensorConversion.counts[VStoreIdx] = ADC_readResult(ADCARESULT_BASE, ADC_SOC_NUMBER1);
     sensorVector[VStoreIdx].newADCReady = true;
     sensorVector[VStoreIdx].convertedReady = false;
 
@@ -66,7 +69,7 @@ void INT_ADCINA_2_ISR(void)
 
 __interrupt void INT_ADCINC_1_ISR(void) {
 
-    sensorVector[ISen1fIdx].counts = ADC_readResult(ADCCRESULT_BASE, ADC_SOC_NUMBER0);
+    sensorConversion.counts[ISen1fIdx] = ADC_readResult(ADCCRESULT_BASE, ADC_SOC_NUMBER0);
     sensorVector[ISen1fIdx].newADCReady = true;
     sensorVector[ISen1fIdx].convertedReady   = false;
 
@@ -82,10 +85,10 @@ __interrupt void INT_ADCINC_1_ISR(void) {
 
 __interrupt void INT_ADCIND_3_ISR(void){
 
-    sensorVector[V_DwnfIdx].counts = ADC_readResult(ADCDRESULT_BASE, ADC_SOC_NUMBER0);
-    sensorVector[V_UpfIdx].counts = ADC_readResult(ADCDRESULT_BASE, ADC_SOC_NUMBER1);
-    sensorVector[I_Dab2fIdx].counts = ADC_readResult(ADCDRESULT_BASE, ADC_SOC_NUMBER2);
-    sensorVector[I_Dab3fIdx].counts = ADC_readResult(ADCDRESULT_BASE, ADC_SOC_NUMBER3);
+    sensorConversion.counts[V_DwnfIdx] = ADC_readResult(ADCDRESULT_BASE, ADC_SOC_NUMBER0);
+    sensorConversion.counts[V_UpfIdx] = ADC_readResult(ADCDRESULT_BASE, ADC_SOC_NUMBER1);
+    sensorConversion.counts[I_Dab2fIdx] = ADC_readResult(ADCDRESULT_BASE, ADC_SOC_NUMBER2);
+    sensorConversion.counts[I_Dab3fIdx] = ADC_readResult(ADCDRESULT_BASE, ADC_SOC_NUMBER3);
 
     sensorVector[V_UpfIdx].newADCReady   = true;
     sensorVector[V_DwnfIdx].newADCReady  = true;
@@ -103,22 +106,34 @@ __interrupt void INT_ADCIND_3_ISR(void){
 
 }
 
-void ConvertCountsToReal( Sensor_t *sensor) {
-    if( sensor->newADCReady ) {
+/**
+ * @brief  Folds the parameters of one sensor into its multiply-add pair
+ *
+ * single ended:  v = ref * counts / max
+ * differential:  v = ref * ( 2 * counts / max - 1 )
+ * real = ( v - zeroVoltageOffset ) * gain, negated for inverted gain
+ */
+void UpdateSensorConversion( uint16_t sensorIdx ) {
+    Sensor_t *sensor = &sensorVector[sensorIdx];
+    float polarity = sensor->invertedGain ? -1.0 : 1.0;
+    float span = sensor->differentialADC ? 2.0 : 1.0;
+    float base = sensor->differentialADC ? -sensor->adcReference : 0.0;
+
+    sensorConversion.scale[sensorIdx]  = polarity * sensor->gain * span * sensor->adcReference / (float)sensor->maxCounts;
+    sensorConversion.offset[sensorIdx] = polarity * sensor->gain * ( base - sensor->zeroVoltageOffset );
+}
 
-        if( sensor->differentialADC ) {
-            sensor->realValue =  sensor->adcReference * ( ( 2 * (float)sensor->counts / (float)sensor->maxCounts ) -1 );
-        } else {
-            sensor->realValue = ( sensor->adcReference * ( (float)sensor->counts / (float)sensor->maxCounts ) );
-        }
-        if( sensor->invertedGain ) {
-            sensor->realValue = ( sensor->zeroVoltageOffset - sensor->realValue ) * sensor->gain;
-        } else {
-            sensor->realValue = ( sensor->realValue - sensor->zeroVoltageOffset ) * sensor->gain;
-        }
-        sensor->newADCReady = false;
-        sensor->convertedReady = true;
+/**
+ * @brief  ADC input voltage of a sensor, before zero offset and gain
+ */
+float SensorCountsToAdcVoltage( uint16_t sensorIdx ) {
+    Sensor_t *sensor = &sensorVector[sensorIdx];
+    float voltage = sensor->adcReference * ( (float)sensorConversion.counts[sensorIdx] / (float)sensor->maxCounts );
+
+    if( sensor->differentialADC ) {
+        voltage = 2 * voltage - sensor->adcReference;
     }
+    return voltage;
 }
 
 
@@ -130,6 +145,7 @@ void ConvertCountsToReal( Sensor_t *sensor) {
 
 int CalibrateZeroVoltageOffsetOfSensors() {
     static uint16_t IsensorsIdxList[] = { ISen1fIdx, ISen2fIdx, IF_1fIdx, I_Dab2fIdx, I_Dab3fIdx, V_UpfIdx, V_DwnfIdx}; //, VBusIdx, VStoreIdx};
+    uint16_t sensorIdx;
     Sensor_t *sensor;
     static float avgZeroVoltageOffset = 0.0;
     static uint16_t calibrationComplete = 0;
@@ -139,42 +155,49 @@ int CalibrateZeroVoltageOffsetOfSensors() {
     if ( calibrationComplete == 0 ) {
         switch_matrix_reset();
         DEVICE_DELAY_US(1000);
-        sensor = &sensorVector[IsensorsIdxList[idxCounter]];
+        sensorIdx = IsensorsIdxList[idxCounter];
+        sensor = &sensorVector[sensorIdx];
         // Calculates the average of the voltages read while there is no current flowing through sensors
         if( avgCounter < 50 ) {
             if( sensor->convertedReady == true) {
-                if( sensor->differentialADC ) {
-                    avgZeroVoltageOffset  = avgZeroVoltageOffset + sensor->adcReference * ( ( 2 * (float)sensor->counts / (float)sensor->maxCounts ) -1 );
-                } else {
-                    avgZeroVoltageOffset  = avgZeroVoltageOffset + sensor->adcReference * ( (float)sensor->counts / (float)sensor->maxCounts );
-                }
+                avgZeroVoltageOffset  = avgZeroVoltageOffset + SensorCountsToAdcVoltage( sensorIdx );
                 avgCounter++;
             }
         } else {
             // Save the voltage average as the zero voltage offset of the sensor
             sensor->zeroVoltageOffset = avgZeroVoltageOffset / avgCounter;
+            UpdateSensorConversion( sensorIdx );
             avgCounter = 0;
             avgZeroVoltageOffset = 0.0;
             idxCounter++;
         }
         // After all sensors in the list is set completes the calibration. It doesn't run anymore. Only with a reset
-        if(idxCounter == sizeof(IsensorsIdxList) ){
+        if(idxCounter == sizeof(IsensorsIdxList)/sizeof(IsensorsIdxList[0]) ){
             calibrationComplete = 1;
         }
     }
     return calibrationComplete;
 }
 
+/**
+ * @brief  Batch conversion kernel, runs every fast control tick
+ * One multiply-add per channel from the packed conversion table, no division
+ * and no branch on the sensor configuration. Channels without new ADC data
+ * convert to the same value again.
+ */
 inline void ConvertSensorsCountsToReal() {
-    uint16_t sensorIdx = 0;
+    uint16_t sensorIdx;
 
-    sensorIdx++;
     for(sensorIdx = 0; sensorIdx < NumOfSensors; sensorIdx++){
-        ConvertCountsToReal( &sensorVector[sensorIdx] );
+        sensorVector[sensorIdx].realValue = (float)sensorConversion.counts[sensorIdx] * sensorConversion.scale[sensorIdx]
+                                            + sensorConversion.offset[sensorIdx];
+        sensorVector[sensorIdx].convertedReady |= sensorVector[sensorIdx].newADCReady;
+        sensorVector[sensorIdx].newADCReady = false;
     }
 }
 
 void InitializeSensorParameters() {
+    uint16_t sensorIdx;
 
 
     sensorVector[ISen1fIdx].maxCounts = 65535;
@@ -251,6 +274,9 @@ void InitializeSensorParameters() {
     sensorVector[VStoreIdx].differentialADC = true;
     sensorVector[VStoreIdx].name = "VStore";
 
+    for( sensorIdx = 0; sensorIdx < NumOfSensors; sensorIdx++ ) {
+        UpdateSensorConversion( sensorIdx );
+    }
 }
 
 
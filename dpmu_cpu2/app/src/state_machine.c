@@ -17,13 +17,16 @@
 #include "cli_cpu2.h"
 #include "CLLC.h"
 #include "common.h"
+#include "control_profile.h"
 #include "DCDC.h"
 #include "debug_log.h"
 #include "energy_storage.h"
+#include "filters.h"
 #include "error_handling.h"
 #include "error_handling_CPU2.h"
 #include "GlobalV.h"
 #include "hal.h"
+#include "pi_controller.h"
 #include "sensors.h"
 #include "shared_variables.h"
 #include "state_machine.h"
@@ -55,365 +58,724 @@ void EnableOrDisblePWM();
 inline void EnableEFuseBBToStopDCDC_EPWM();
 void HandleDPMUErrorClass();
 
-void StateMachine(void)
+/* Slow task requests posted by the fast path and served by the super loop */
+static volatile uint16_t slowTaskRequestCount = 0;
+static volatile uint16_t slowTaskServedCount = 0;
+static uint16_t fastTicksToSlowTask = SM_SLOW_TASK_DIVIDER;
+static volatile bool slowTaskStalled = false;
+
+static float avgVStoreWindow[AVG_VSTORE_WINDOW];
+static float avgVBusWindow[AVG_VBUS_WINDOW];
+static MovingAverage_t avgVStoreFilter;
+static MovingAverage_t avgVBusFilter;
+
+static float I_Ref_Real_Final = 0.0;
+static float I_Ref_Real_Step = 0.0;
+
+/**
+ * @brief  Fast control path, called from INT_ADCINB_4_ISR every sample.
+ * Only sensor conversion, the averages, the PI loops and the PWM update run
+ * here. State transitions are decided by the slow supervisory task
+ * StateMachine().
+ */
+void StateMachineFastTick(void)
 {
-    static bool cellVoltageOverThreshold = false;
-    static float I_Ref_Real_Final = 0.0;
-    static bool EPMWStarted = false;
-
     ConvertSensorsCountsToReal();
+
+    /* windows are counted in samples, they keep their span only updated here */
     CalculateAvgVStore();
     CalculateAvgVBus();
 
     switch (StateVector.State_Current)
     {
-        case PreInitialized:
-            HandleFaultStateAckFromCPU1();
+        case ChargeRamp:
+        case Charge:
+            DCDC_current_buck_loop_float();
             break;
 
-        case Initialize: /* Initial state, initialization of the parameters*/
-            if( !DPMUInitializedFlag && (sharedVars_cpu1toCpu2.DPMUAppInfoInitializedFlag == true) ) {
-                if( CalibrateZeroVoltageOffsetOfSensors() ) {
-                    test_update_of_error_codes = true;
-                    HAL_DcdcNormalModePwmSetting();
-
-                    switches_Qinb( SW_OFF );
-                    switches_Qlb( SW_OFF );
-                    switches_Qsb( SW_OFF );
-                    sharedVars_cpu2toCpu1.faultOccured = false;
-                    if( sharedVars_cpu1toCpu2.dpmu_default_flag == true ) {
-                        StateVector.State_Next = SoftstartInitDefault;
-                    } else {
-                        StateVector.State_Next = SoftstartInitRedundant;
-                    }
-                }
-            } else {
-                StateVector.State_Next = StateVector.State_Before;
-            }
+        case ChargeStop:
+        case BalancingInit:
+            DCDC_VI.I_Ref_Real = 0.0;
+            DCDC_current_buck_loop_float();
+            break;
 
+        case Regulate:
+            calculate_boost_current();
+            DCDC_current_boost_loop_float();
             break;
 
-        case SoftstartInitDefault:
-            if( sensorVector[VBusIdx].realValue < SOFTSTART_MAX_SAFE_VOLTAGE_TO_INRUSH ) {
-                //Close output and sharing switches
-                switches_Qlb(SW_ON);
-                switches_Qsb(SW_ON);
-
-                // Initialize and start Inrush PWM
-                HAL_PWM_setCounterCompareValue(InrushCurrentLimit_BASE, EPWM_COUNTER_COMPARE_A, INRUSH_DUTY_CYLE_INCREMENT);
-                HAL_StartPwmInrushCurrentLimit();
-                CounterGroup.InrushCurrentLimiterCounter = 0;
-                CounterGroup.SafeSoftStartCounter = 0;
-                StateVector.State_Next = Softstart;
-            } else {
-                StateVector.State_Next = Fault;
-                PRINT("VBUS VOLTAGE TOO HIGH FOR INRUSH!!!");
-            }
+        case RegulateStop:
+            DCDC_VI.I_Ref_Real = 0.0;
+            DCDC_current_boost_loop_float();
             break;
 
-        case SoftstartInitRedundant:
-            if( sensorVector[VBusIdx].realValue < SOFTSTART_MAX_SAFE_VOLTAGE_TO_INRUSH ) {
-                //Opens output Switch and closes sharing switch
-                switches_Qlb(SW_OFF);
-                switches_Qsb(SW_ON);
-
-                // Initialize and start Inrush PWM
-                HAL_PWM_setCounterCompareValue(InrushCurrentLimit_BASE, EPWM_COUNTER_COMPARE_A, INRUSH_DUTY_CYLE_INCREMENT);
-                HAL_StartPwmInrushCurrentLimit();
-                CounterGroup.InrushCurrentLimiterCounter = 0;
-                CounterGroup.SafeSoftStartCounter = 0;
-                StateVector.State_Next = Softstart;
-            } else {
-                StateVector.State_Next = Fault;
-                PRINT("VBUS VOLTAGE TOO HIGH FOR INRUSH!!!");
-            }
+        case RegulateVoltage:
+            DCDC_voltage_boost_loop_float();
             break;
 
-        case Softstart: /* Soft start of the 200V Bus*/
+        default:
+            break;
+    }
 
-            if( DoneWithInrush() ) {
-                EnableEFuseBBToStopDCDC_EPWM();
-                switches_Qinb(SW_ON);
-                switches_Qsb(SW_ON);
-                //Stop In-rush PWM
-                HAL_PWM_setCounterCompareValue(InrushCurrentLimit_BASE, EPWM_COUNTER_COMPARE_A, 1);
-                HAL_StopPwmInrushCurrentLimit();
-                DPMUInitializedFlag = true;
-                StateVector.State_Next = Idle;
-            }
-            if( CounterGroup.SafeSoftStartCounter == SOFTSTART_MAX_SAFE_RETRIES ) {
-                StateVector.State_Next = Fault;
-            }
+    if( CllcControlLoopActive() ) {
+        CllcControlLoop( CllcControlLoopCellNr() );
+    }
 
-            break;
+    CounterGroup.FastTickCounter++;
 
-        case TrickleChargeInit:
-            if ( DCDC_VI.avgVStore >= energy_bank_settings.preconditional_threshold ) {
-                StateVector.State_Next = ChargeInit;
-            } else {
-                HAL_DcdcPulseModePwmSetting();
-                ResetPulseStateAdjust();
-                AdjustPulseBasedOnSupercapVoltage();
-                HAL_StartPwmDCDC();
-                CounterGroup.PrestateCounter = DELAY_50_SM_CYCLES;
-                StateVector.State_Next = TrickleChargeDelay;
-            }
-            break;
+    if( --fastTicksToSlowTask == 0 ) {
+        fastTicksToSlowTask = SM_SLOW_TASK_DIVIDER;
+        slowTaskRequestCount++;
 
-        case TrickleChargeDelay:
-            CounterGroup.PrestateCounter--;
-            if (CounterGroup.PrestateCounter == 0)
-            {
-                StateVector.State_Next = TrickleCharge;
-            }
-            break;
+        /* slow task watchdog: the super loop does not serve the slow ticks */
+        if( ((uint16_t)(slowTaskRequestCount - slowTaskServedCount) >= SM_SLOW_TASK_STALL_TICKS) && !slowTaskStalled ) {
+            HAL_StopPwmDCDC();
+            slowTaskStalled = true;
+            CounterGroup.SlowTaskStalls++;
+        }
+    }
+}
 
-        case TrickleCharge: /* Pulse charge state for when the super capacitor bank voltage is low */
-            AdjustPulseBasedOnSupercapVoltage();
-            if ( DCDC_VI.avgVStore >= energy_bank_settings.preconditional_threshold)
-            {
-                HAL_StopPwmDCDC();
-                StateVector.State_Next = ChargeInit;
-            }
-            if ( ReadCellVoltagesDone() == true){
-                if( cellVoltageOverThreshold ){
-                    StateVector.State_Next = StopEPWMs;
-                }
-            }
-            break;
+/**
+ * @brief  Runs the slow supervisory task from the super loop, at most once per
+ * slow tick. When the super loop was late for more than one slow tick the
+ * missed ones are dropped and counted, they are not run in a burst on the
+ * same sensor values.
+ */
+void StateMachineScheduler(void)
+{
+    uint16_t pending = slowTaskRequestCount - slowTaskServedCount;
 
-        case ChargeInit: /* Initialize the buck state */
+    if( pending == 0 ) {
+        return;
+    }
+    CounterGroup.SlowTaskSkippedTicks += pending - 1;
+    slowTaskServedCount += pending;
 
-            HAL_DcdcNormalModePwmSetting();
-            ILoop_PiOutput.Int_out = 0;
+    ControlProfileRateBegin(CP_RateSlow);
+    StateMachine();
+    ControlProfileRateEnd(CP_RateSlow);
+}
 
-            I_Ref_Real_Final = 0.5 * (  DCDC_VI.target_Voltage_At_DCBus * DCDC_VI.iIn_limit / energy_bank_settings.max_voltage_applied_to_energy_bank );
+/*
+ * State handlers, guards and transition actions of the supervisory task.
+ * Handlers that finish a piece of work with side effects (calibration,
+ * inrush, balancing...) report it in stateRunDone for SmGuardRunDone().
+ */
+static bool stateRunDone = false;
 
-            if( I_Ref_Real_Final >  MAX_INDUCTOR_BUCK_CURRENT ) {
-                I_Ref_Real_Final = MAX_INDUCTOR_BUCK_CURRENT;
-            }
-            DCDC_VI.I_Ref_Real = I_Ref_Real_Final / 100.0;
+static void StartInrushCurrentLimiter(void)
+{
+    HAL_PWM_setCounterCompareValue(InrushCurrentLimit_BASE, EPWM_COUNTER_COMPARE_A, INRUSH_DUTY_CYLE_INCREMENT);
+    HAL_StartPwmInrushCurrentLimit();
+    CounterGroup.InrushCurrentLimiterCounter = 0;
+    CounterGroup.SafeSoftStartCounter = 0;
+}
 
-            HAL_PWM_setCounterCompareValue( BEG_1_2_BASE, EPWM_COUNTER_COMPARE_A, 0.5*EPWM_getTimeBasePeriod(BEG_1_2_BASE) );
-            EPMWStarted = false;
-            DCDC_VI.counter = 0;
+static bool SmGuardRunDone(void)
+{
+    return stateRunDone;
+}
 
-            EnableContinuousReadCellVoltages();
-            StateVector.State_Next = ChargeRamp;
+static bool SmGuardCalibratedDefault(void)
+{
+    return stateRunDone && (sharedVars_cpu1toCpu2.dpmu_default_flag == true);
+}
 
-            break;
+static bool SmGuardCalibratedRedundant(void)
+{
+    return stateRunDone && (sharedVars_cpu1toCpu2.dpmu_default_flag != true);
+}
 
-        case ChargeRamp:
-            if( !EPMWStarted ) {
-                HAL_StartPwmDCDC();
-                EPMWStarted = true;
-            }
-            DCDC_current_buck_loop_float();
-            if( DCDC_VI.counter == DELAY_50_SM_CYCLES) {
-                DCDC_VI.counter = 0;
-                if( -(sensorVector[ISen2fIdx].realValue) >= DCDC_VI.I_Ref_Real ) {
-                    DCDC_VI.I_Ref_Real = DCDC_VI.I_Ref_Real + ( I_Ref_Real_Final / 100.0 );
-                    if( DCDC_VI.I_Ref_Real >= I_Ref_Real_Final ) {
-                        DCDC_VI.I_Ref_Real = I_Ref_Real_Final;
-                        StateVector.State_Next = Charge;
-                    }
-                }
-            } else {
-                DCDC_VI.counter++;
-            }
-            break;
+static bool SmGuardNotReadyToInitialize(void)
+{
+    return DPMUInitializedFlag || (sharedVars_cpu1toCpu2.DPMUAppInfoInitializedFlag != true);
+}
 
-        case Charge:
+static bool SmGuardVBusSafeForInrush(void)
+{
+    return sensorVector[VBusIdx].realValue < SOFTSTART_MAX_SAFE_VOLTAGE_TO_INRUSH;
+}
 
-            if( DCDC_VI.avgVStore < energy_bank_settings.max_voltage_applied_to_energy_bank * MAX_ENERGY_BANK_VOLTAGE_RATIO ) {
-                DCDC_current_buck_loop_float();
-            } else {
-                StateVector.State_Next = ChargeStop;
-            }
+static bool SmGuardSoftStartRetriesExceeded(void)
+{
+    return CounterGroup.SafeSoftStartCounter == SOFTSTART_MAX_SAFE_RETRIES;
+}
 
-            if( ReadCellVoltagesDone() == true) {
-                if( cellVoltageOverThreshold == true ) {
-                    StateVector.State_Next = BalancingInit; //Normal operation
-                }
-            }
+static bool SmGuardVStorePreconditioned(void)
+{
+    return DCDC_VI.avgVStore >= energy_bank_settings.preconditional_threshold;
+}
 
-            break;
+static bool SmGuardVStoreFull(void)
+{
+    return DCDC_VI.avgVStore >= energy_bank_settings.max_voltage_applied_to_energy_bank * MAX_ENERGY_BANK_VOLTAGE_RATIO;
+}
 
-        case ChargeStop:
-                DCDC_VI.I_Ref_Real = 0.0;
-                DCDC_current_buck_loop_float();
-                if( sensorVector[ISen2fIdx].realValue < 0.25 ) {
-                    StateVector.State_Next = StopEPWMs;
-                }
-              break;
+static bool SmGuardVStoreBelowMin(void)
+{
+    return DCDC_VI.avgVStore < energy_bank_settings.min_voltage_applied_to_energy_bank;
+}
 
-        case BalancingInit:
-            DCDC_VI.I_Ref_Real = 0.0;
-            DCDC_current_buck_loop_float();
+static bool SmGuardVStoreBelowMinInstant(void)
+{
+    return sensorVector[VStoreIdx].realValue < energy_bank_settings.min_voltage_applied_to_energy_bank;
+}
 
-            if( sensorVector[ISen2fIdx].realValue < 0.25 ) {
-                HAL_StopPwmDCDC();
-                StateVector.State_Next = Balancing;
-            }
-            break;
+static bool SmGuardCellOverThreshold(void)
+{
+    return (ReadCellVoltagesDone() == true) && cellVoltageOverThreshold;
+}
 
-        case Balancing:
+static bool SmGuardPrestateCounterExpired(void)
+{
+    return CounterGroup.PrestateCounter == 0;
+}
 
-            if( BalancingAllCells( &cellVoltagesVector[0] ) == true ) {
-               StateVector.State_Next = ChargeInit;
-            }
-            break;
+/* one ramp step from value toward target, never past it */
+static float SmRampToward(float value, float target, float step)
+{
+    if( value < target ) {
+        value += step;
+        if( value > target ) {
+            value = target;
+        }
+    } else if( value > target ) {
+        value -= step;
+        if( value < target ) {
+            value = target;
+        }
+    }
+    return value;
+}
 
-        case BalancingStop:
-            switch_matrix_reset();
-            StateVector.State_Next = StopEPWMs;
-            break;
+static bool SmGuardChargeRampDone(void)
+{
+    return DCDC_VI.I_Ref_Real == I_Ref_Real_Final;
+}
 
-        case RegulateInit:
-            DCDC_VI.I_Ref_Real = 0.0;
-            StateVector.State_Next = Regulate;
-            HAL_StopPwmDCDC();
-            HAL_DcdcRegulateVoltageAndCurrentModePwmSetting();
-            break;
+static bool SmGuardStorageCurrentLow(void)
+{
+    return sensorVector[ISen2fIdx].realValue < 0.25;
+}
 
-        case Regulate:
-            calculate_boost_current();
-            DCDC_current_boost_loop_float();
-            EnableOrDisblePWM(DCDC_VI.I_Ref_Real);
-            if( sensorVector[VStoreIdx].realValue < energy_bank_settings.min_voltage_applied_to_energy_bank ) {
-                StateVector.State_Next = RegulateStop;
-            }
-            if( DCDC_VI.avgVBus < REG_MIN_DC_BUS_VOLTAGE_RATIO * DCDC_VI.target_Voltage_At_DCBus ) {
-                if( sensorVector[ISen1fIdx].realValue >= MIN_OUTPUT_CURRENT_TO_REGULATE_VOLTAGE ) {
-                        StateVector.State_Next = RegulateVoltageInit;
-                }
-            }
-            break;
+static bool SmGuardBusLowWithLoad(void)
+{
+    return ( DCDC_VI.avgVBus < REG_MIN_DC_BUS_VOLTAGE_RATIO * DCDC_VI.target_Voltage_At_DCBus ) &&
+           ( sensorVector[ISen1fIdx].realValue >= MIN_OUTPUT_CURRENT_TO_REGULATE_VOLTAGE );
+}
 
-        case RegulateStop:
-            DCDC_VI.I_Ref_Real = 0.0;
-            DCDC_current_boost_loop_float();
-            if( sensorVector[ISen2fIdx].realValue < 0.25 ) {
-                StateVector.State_Next = StopEPWMs;
-            }
-            break;
+static bool SmGuardBusOverVoltage(void)
+{
+    return DCDC_VI.avgVBus > sharedVars_cpu1toCpu2.max_allowed_dc_bus_voltage;
+}
 
-        case EmergencyStop:
-            HAL_StopPwmDCDC();
-            if( CounterGroup.EmergencyCounter > 0) {
-                CounterGroup.EmergencyCounter--;
-            } else {
-                StateVector.State_Next = Fault;
-            }
-            break;
+static bool SmGuardNoLoad(void)
+{
+    return sensorVector[ISen1fIdx].realValue < MIN_OUTPUT_CURRENT_TO_REGULATE_VOLTAGE;
+}
 
-        case RegulateVoltageInit:
-            switches_Qinb( SW_OFF );
-            DCDCInitializePWMForRegulateVoltage();
-            StateVector.State_Next = RegulateVoltage;
-            break;
+static bool SmGuardEmergencyDelayExpired(void)
+{
+    return CounterGroup.EmergencyCounter == 0;
+}
 
-        case RegulateVoltage:
-            DCDC_voltage_boost_loop_float();
-            if( DCDC_VI.avgVStore < energy_bank_settings.min_voltage_applied_to_energy_bank ) {
-                StateVector.State_Next = RegulateVoltageStop;
+static void SmActionStopDcdcPwm(void)
+{
+    HAL_StopPwmDCDC();
+}
 
-            }
-            if(  DCDC_VI.avgVBus > sharedVars_cpu1toCpu2.max_allowed_dc_bus_voltage ) {
-                StateVector.State_Next = RegulateVoltageStop;
-            }
-            if( sensorVector[ISen1fIdx].realValue < MIN_OUTPUT_CURRENT_TO_REGULATE_VOLTAGE ) {
-                HAL_StopPwmDCDC();
-                StateVector.State_Next = RegulateVoltageWait;
-            }
-            break;
+static void SmActionStopAllEPWMs(void)
+{
+    StopAllEPWMs();
+}
 
-        case RegulateVoltageStop:
-            DPMUInitializedFlag = false;
-            StateVector.State_Next = StopEPWMs;
-            break;
+static void SmActionInitializeDone(void)
+{
+    test_update_of_error_codes = true;
+    HAL_DcdcNormalModePwmSetting();
 
-        case RegulateVoltageWait:
-            if( DCDC_VI.avgVBus < REG_MIN_DC_BUS_VOLTAGE_RATIO * DCDC_VI.target_Voltage_At_DCBus ) {
-                if( sensorVector[ISen1fIdx].realValue >= MIN_OUTPUT_CURRENT_TO_REGULATE_VOLTAGE ) {
-                    DCDCInitializePWMForRegulateVoltage();
-                    StateVector.State_Next = RegulateVoltage;
-                }
-            }
-            if(  DCDC_VI.avgVBus > sharedVars_cpu1toCpu2.max_allowed_dc_bus_voltage ) {
-                StateVector.State_Next = RegulateVoltageStop;
-            }
-            if( DCDC_VI.avgVStore < energy_bank_settings.min_voltage_applied_to_energy_bank ) {
-                StateVector.State_Next = RegulateVoltageStop;
+    switches_Qinb( SW_OFF );
+    switches_Qlb( SW_OFF );
+    switches_Qsb( SW_OFF );
+    sharedVars_cpu2toCpu1.faultOccured = false;
+}
 
-            }
-            break;
+static void SmActionStartInrushDefault(void)
+{
+    //Close output and sharing switches
+    switches_Qlb(SW_ON);
+    switches_Qsb(SW_ON);
 
-        case Fault:
-            HAL_StopPwmDCDC();
+    StartInrushCurrentLimiter();
+}
 
-            switches_Qlb( SW_OFF );
-            switches_Qsb( SW_OFF );
-            switches_Qinb( SW_OFF );
+static void SmActionStartInrushRedundant(void)
+{
+    //Opens output Switch and closes sharing switch
+    switches_Qlb(SW_OFF);
+    switches_Qsb(SW_ON);
 
-            CounterGroup.PrestateCounter = 0;
+    StartInrushCurrentLimiter();
+}
 
-            test_update_of_error_codes = false;
+static void SmActionInrushVoltageTooHigh(void)
+{
+    PRINT("VBUS VOLTAGE TOO HIGH FOR INRUSH!!!");
+}
 
-            DPMUInitializedFlag = false;
+static void SmActionSoftstartDone(void)
+{
+    EnableEFuseBBToStopDCDC_EPWM();
+    switches_Qinb(SW_ON);
+    switches_Qsb(SW_ON);
+    //Stop In-rush PWM
+    HAL_PWM_setCounterCompareValue(InrushCurrentLimit_BASE, EPWM_COUNTER_COMPARE_A, 1);
+    HAL_StopPwmInrushCurrentLimit();
+    DPMUInitializedFlag = true;
+}
 
-            StopAllEPWMs();
+static void SmActionStartTrickleCharge(void)
+{
+    HAL_DcdcPulseModePwmSetting();
+    ResetPulseStateAdjust();
+    AdjustPulseBasedOnSupercapVoltage();
+    HAL_StartPwmDCDC();
+    CounterGroup.PrestateCounter = DELAY_50_SM_CYCLES;
+}
 
-            ResetDpmuErrorOcurred();
+static void SmRunPreInitialized(void)
+{
+    HandleFaultStateAckFromCPU1();
+}
 
-            SignalFaultStateToCPU1();
+static void SmRunInitialize(void)
+{
+    if( !DPMUInitializedFlag && (sharedVars_cpu1toCpu2.DPMUAppInfoInitializedFlag == true) ) {
+        stateRunDone = CalibrateZeroVoltageOffsetOfSensors();
+    }
+}
 
-            StateVector.State_Next = DischargeVBUSToSupercap;
+static void SmRunSoftstart(void)
+{
+    stateRunDone = DoneWithInrush();
+}
 
-            break;
+static void SmRunTrickleChargeDelay(void)
+{
+    CounterGroup.PrestateCounter--;
+}
 
-        case DischargeVBUSToSupercap:
-            if( DCDC_VI.avgVStore < energy_bank_settings.max_voltage_applied_to_energy_bank * MAX_ENERGY_BANK_VOLTAGE_RATIO ) {
-                HAL_DcdcPulseModePwmSetting();
-                ResetPulseStateAdjust();
-                AdjustPulseBasedOnSupercapVoltage();
-                HAL_StartPwmDCDC();
-                CounterGroup.PrestateCounter = 10 * DELAY_50_SM_CYCLES;
-            }
-            StateVector.State_Next = WaitDPMUSafeCondition;
-            break;
+static void SmRunTrickleCharge(void)
+{
+    AdjustPulseBasedOnSupercapVoltage();
+}
 
-        case WaitDPMUSafeCondition:
-            if( CounterGroup.PrestateCounter == 0 ) {
-                AdjustPulseBasedOnSupercapVoltage();
-                if( sensorVector[VBusIdx].realValue < sensorVector[VStoreIdx].realValue + SOFTSTART_DEVIATION_FROM_STORAGE_VOLTAGE_TO_INRUSH  ) {
-                    StopAllEPWMs();
-                    StateVector.State_Next = PreInitialized;
-                    CounterGroup.PrestateCounter = 0;
-                } else {
-                    CounterGroup.PrestateCounter = 10 * DELAY_50_SM_CYCLES;
-                }
-            } else {
-                CounterGroup.PrestateCounter = CounterGroup.PrestateCounter - 1;
-            }
-            break;
+static void SmRunChargeInit(void)
+{
+    HAL_DcdcNormalModePwmSetting();
+    PiControllerReset(&ILoop_PiOutput);
 
-        case StopEPWMs:
+    I_Ref_Real_Final = 0.5 * (  DCDC_VI.target_Voltage_At_DCBus * DCDC_VI.iIn_limit / energy_bank_settings.max_voltage_applied_to_energy_bank );
 
-            StopAllEPWMs();
-            StateVector.State_Next = Idle;
-            break;
+    if( I_Ref_Real_Final >  MAX_INDUCTOR_BUCK_CURRENT ) {
+        I_Ref_Real_Final = MAX_INDUCTOR_BUCK_CURRENT;
+    }
+    /* the ramp runs in 100 steps from zero toward the final reference,
+     * whatever its sign; a zero target needs no ramp at all */
+    I_Ref_Real_Step = ( I_Ref_Real_Final < 0.0 ? -I_Ref_Real_Final : I_Ref_Real_Final ) / 100.0;
+    DCDC_VI.I_Ref_Real = SmRampToward( 0.0, I_Ref_Real_Final, I_Ref_Real_Step );
+
+    HAL_PWM_setCounterCompareValue( BEG_1_2_BASE, EPWM_COUNTER_COMPARE_A, 0.5*EPWM_getTimeBasePeriod(BEG_1_2_BASE) );
+    DCDC_VI.counter = 0;
+
+    EnableContinuousReadCellVoltages();
+}
+
+static void SmEnterChargeRamp(void)
+{
+    HAL_StartPwmDCDC();
+}
+
+static void SmRunChargeRamp(void)
+{
+    float iMeasured;
+    bool tracking;
+
+    if( DCDC_VI.counter == DELAY_50_SM_CYCLES) {
+        DCDC_VI.counter = 0;
+        /* take the next step once the loop has caught up with the reference
+         * in the direction the ramp is moving */
+        iMeasured = -(sensorVector[ISen2fIdx].realValue);
+        if( DCDC_VI.I_Ref_Real < I_Ref_Real_Final ) {
+            tracking = iMeasured >= DCDC_VI.I_Ref_Real;
+        } else {
+            tracking = iMeasured <= DCDC_VI.I_Ref_Real;
+        }
+        if( tracking ) {
+            DCDC_VI.I_Ref_Real = SmRampToward( DCDC_VI.I_Ref_Real, I_Ref_Real_Final, I_Ref_Real_Step );
+        }
+    } else {
+        DCDC_VI.counter++;
+    }
+}
+
+static void SmRunBalancing(void)
+{
+    stateRunDone = BalancingAllCells( &cellVoltagesVector[0] );
+}
+
+static void SmRunBalancingStop(void)
+{
+    switch_matrix_reset();
+}
+
+static void SmRunRegulateInit(void)
+{
+    DCDC_VI.I_Ref_Real = 0.0;
+    HAL_StopPwmDCDC();
+    HAL_DcdcRegulateVoltageAndCurrentModePwmSetting();
+    DCDCRegulateAveragesReset();
+}
+
+static void SmRunRegulate(void)
+{
+    /* the reference is calculated by StateMachineFastTick() */
+    EnableOrDisblePWM(DCDC_VI.I_Ref_Real);
+}
+
+static void SmRunEmergencyStop(void)
+{
+    HAL_StopPwmDCDC();
+    if( CounterGroup.EmergencyCounter > 0) {
+        CounterGroup.EmergencyCounter--;
+    }
+}
+
+static void SmRunRegulateVoltageInit(void)
+{
+    switches_Qinb( SW_OFF );
+    DCDCInitializePWMForRegulateVoltage();
+}
+
+static void SmRunRegulateVoltageStop(void)
+{
+    DPMUInitializedFlag = false;
+}
+
+static void SmRunFault(void)
+{
+    HAL_StopPwmDCDC();
+
+    switches_Qlb( SW_OFF );
+    switches_Qsb( SW_OFF );
+    switches_Qinb( SW_OFF );
+
+    CounterGroup.PrestateCounter = 0;
+
+    test_update_of_error_codes = false;
+
+    DPMUInitializedFlag = false;
 
-        case Idle:
-            if( StatusContinousReadCellVoltages() == false) {
-                EnableContinuousReadCellVoltages();
+    StopAllEPWMs();
+
+    ResetDpmuErrorOcurred();
+
+    SignalFaultStateToCPU1();
+}
+
+static void SmRunDischargeVBUSToSupercap(void)
+{
+    if( DCDC_VI.avgVStore < energy_bank_settings.max_voltage_applied_to_energy_bank * MAX_ENERGY_BANK_VOLTAGE_RATIO ) {
+        HAL_DcdcPulseModePwmSetting();
+        ResetPulseStateAdjust();
+        AdjustPulseBasedOnSupercapVoltage();
+        HAL_StartPwmDCDC();
+        CounterGroup.PrestateCounter = 10 * DELAY_50_SM_CYCLES;
+    }
+}
+
+static void SmRunWaitDPMUSafeCondition(void)
+{
+    if( CounterGroup.PrestateCounter == 0 ) {
+        AdjustPulseBasedOnSupercapVoltage();
+        if( sensorVector[VBusIdx].realValue < sensorVector[VStoreIdx].realValue + SOFTSTART_DEVIATION_FROM_STORAGE_VOLTAGE_TO_INRUSH  ) {
+            stateRunDone = true;
+        } else {
+            CounterGroup.PrestateCounter = 10 * DELAY_50_SM_CYCLES;
+        }
+    } else {
+        CounterGroup.PrestateCounter = CounterGroup.PrestateCounter - 1;
+    }
+}
+
+static void SmRunStopEPWMs(void)
+{
+    StopAllEPWMs();
+}
+
+static void SmRunIdle(void)
+{
+    if( StatusContinousReadCellVoltages() == false) {
+        EnableContinuousReadCellVoltages();
+    }
+}
+
+/*
+ * Transitions of each state in priority order, the first one whose guard
+ * passes is taken.
+ */
+static const StateTransition_t initializeTransitions[] = {
+    { SoftstartInitDefault,     SmGuardCalibratedDefault,       SmActionInitializeDone },
+    { SoftstartInitRedundant,   SmGuardCalibratedRedundant,     SmActionInitializeDone },
+    { SM_STATE_BEFORE,          SmGuardNotReadyToInitialize,    NULL },
+};
+
+static const StateTransition_t softstartInitDefaultTransitions[] = {
+    { Softstart,                SmGuardVBusSafeForInrush,       SmActionStartInrushDefault },
+    { Fault,                    NULL,                           SmActionInrushVoltageTooHigh },
+};
+
+static const StateTransition_t softstartInitRedundantTransitions[] = {
+    { Softstart,                SmGuardVBusSafeForInrush,       SmActionStartInrushRedundant },
+    { Fault,                    NULL,                           SmActionInrushVoltageTooHigh },
+};
+
+static const StateTransition_t softstartTransitions[] = {
+    { Fault,                    SmGuardSoftStartRetriesExceeded, NULL },
+    { Idle,                     SmGuardRunDone,                 SmActionSoftstartDone },
+};
+
+static const StateTransition_t trickleChargeInitTransitions[] = {
+    { ChargeInit,               SmGuardVStorePreconditioned,    NULL },
+    { TrickleChargeDelay,       NULL,                           SmActionStartTrickleCharge },
+};
+
+static const StateTransition_t trickleChargeDelayTransitions[] = {
+    { TrickleCharge,            SmGuardPrestateCounterExpired,  NULL },
+};
+
+static const StateTransition_t trickleChargeTransitions[] = {
+    { StopEPWMs,                SmGuardCellOverThreshold,       NULL },
+    { ChargeInit,               SmGuardVStorePreconditioned,    SmActionStopDcdcPwm },
+};
+
+static const StateTransition_t chargeInitTransitions[] = {
+    { ChargeRamp,               NULL,                           NULL },
+};
+
+static const StateTransition_t chargeRampTransitions[] = {
+    { Charge,                   SmGuardChargeRampDone,          NULL },
+};
+
+static const StateTransition_t chargeTransitions[] = {
+    { BalancingInit,            SmGuardCellOverThreshold,       NULL },    //Normal operation
+    { ChargeStop,               SmGuardVStoreFull,              NULL },
+};
+
+static const StateTransition_t chargeStopTransitions[] = {
+    { StopEPWMs,                SmGuardStorageCurrentLow,       NULL },
+};
+
+static const StateTransition_t balancingInitTransitions[] = {
+    { Balancing,                SmGuardStorageCurrentLow,       SmActionStopDcdcPwm },
+};
+
+static const StateTransition_t balancingTransitions[] = {
+    { ChargeInit,               SmGuardRunDone,                 NULL },
+};
+
+static const StateTransition_t balancingStopTransitions[] = {
+    { StopEPWMs,                NULL,                           NULL },
+};
+
+static const StateTransition_t regulateInitTransitions[] = {
+    { Regulate,                 NULL,                           NULL },
+};
+
+static const StateTransition_t regulateTransitions[] = {
+    { RegulateVoltageInit,      SmGuardBusLowWithLoad,          NULL },
+    { RegulateStop,             SmGuardVStoreBelowMinInstant,   NULL },
+};
+
+static const StateTransition_t regulateStopTransitions[] = {
+    { StopEPWMs,                SmGuardStorageCurrentLow,       NULL },
+};
+
+static const StateTransition_t emergencyStopTransitions[] = {
+    { Fault,                    SmGuardEmergencyDelayExpired,   NULL },
+};
+
+static const StateTransition_t regulateVoltageInitTransitions[] = {
+    { RegulateVoltage,          NULL,                           NULL },
+};
+
+static const StateTransition_t regulateVoltageTransitions[] = {
+    { RegulateVoltageWait,      SmGuardNoLoad,                  SmActionStopDcdcPwm },
+    { RegulateVoltageStop,      SmGuardBusOverVoltage,          NULL },
+    { RegulateVoltageStop,      SmGuardVStoreBelowMin,          NULL },
+};
+
+static const StateTransition_t regulateVoltageStopTransitions[] = {
+    { StopEPWMs,                NULL,                           NULL },
+};
+
+static const StateTransition_t regulateVoltageWaitTransitions[] = {
+    { RegulateVoltageStop,      SmGuardVStoreBelowMin,          NULL },
+    { RegulateVoltageStop,      SmGuardBusOverVoltage,          NULL },
+    { RegulateVoltage,          SmGuardBusLowWithLoad,          DCDCInitializePWMForRegulateVoltage },
+};
+
+static const StateTransition_t faultTransitions[] = {
+    { DischargeVBUSToSupercap,  NULL,                           NULL },
+};
+
+static const StateTransition_t dischargeVBUSToSupercapTransitions[] = {
+    { WaitDPMUSafeCondition,    NULL,                           NULL },
+};
+
+static const StateTransition_t waitDPMUSafeConditionTransitions[] = {
+    { PreInitialized,           SmGuardRunDone,                 SmActionStopAllEPWMs },
+};
+
+static const StateTransition_t stopEPWMsTransitions[] = {
+    { Idle,                     NULL,                           NULL },
+};
+
+#define SM_TRANSITIONS(t) (t), (sizeof(t) / sizeof((t)[0]))
+#define SM_NO_TRANSITIONS NULL, 0
+
+static const StateDescriptor_t stateTable[] = {
+  /*  state                     entry               do                              exit    transitions                                         idle request            switch fault */
+    { PreInitialized,           NULL,               SmRunPreInitialized,            NULL,   SM_NO_TRANSITIONS,                                  PreInitialized,         SM_STATE_NONE },
+    { Initialize,               NULL,               SmRunInitialize,                NULL,   SM_TRANSITIONS(initializeTransitions),              Initialize,             SM_STATE_NONE },
+    { SoftstartInitDefault,     NULL,               NULL,                           NULL,   SM_TRANSITIONS(softstartInitDefaultTransitions),    StopEPWMs,              SM_STATE_NONE },
+    { SoftstartInitRedundant,   NULL,               NULL,                           NULL,   SM_TRANSITIONS(softstartInitRedundantTransitions),  StopEPWMs,              SM_STATE_NONE },
+    { Softstart,                NULL,               SmRunSoftstart,                 NULL,   SM_TRANSITIONS(softstartTransitions),               StopEPWMs,              SM_STATE_NONE },
+    { TrickleChargeInit,        NULL,               NULL,                           NULL,   SM_TRANSITIONS(trickleChargeInitTransitions),       ChargeStop,             ChargeStop },
+    { TrickleChargeDelay,       NULL,               SmRunTrickleChargeDelay,        NULL,   SM_TRANSITIONS(trickleChargeDelayTransitions),      ChargeStop,             ChargeStop },
+    { TrickleCharge,            NULL,               SmRunTrickleCharge,             NULL,   SM_TRANSITIONS(trickleChargeTransitions),           ChargeStop,             ChargeStop },
+    { ChargeInit,               NULL,               SmRunChargeInit,                NULL,   SM_TRANSITIONS(chargeInitTransitions),              ChargeStop,             ChargeStop },
+    { ChargeRamp,               SmEnterChargeRamp,  SmRunChargeRamp,                NULL,   SM_TRANSITIONS(chargeRampTransitions),              StopEPWMs,              ChargeStop },
+    { Charge,                   NULL,               NULL,                           NULL,   SM_TRANSITIONS(chargeTransitions),                  ChargeStop,             ChargeStop },
+    { ChargeStop,               NULL,               NULL,                           NULL,   SM_TRANSITIONS(chargeStopTransitions),              StopEPWMs,              SM_STATE_NONE },
+    { BalancingInit,            NULL,               NULL,                           NULL,   SM_TRANSITIONS(balancingInitTransitions),           BalancingStop,          SM_STATE_NONE },
+    { Balancing,                NULL,               SmRunBalancing,                 NULL,   SM_TRANSITIONS(balancingTransitions),               BalancingStop,          SM_STATE_NONE },
+    { BalancingStop,            NULL,               SmRunBalancingStop,             NULL,   SM_TRANSITIONS(balancingStopTransitions),           StopEPWMs,              SM_STATE_NONE },
+    { RegulateInit,             NULL,               SmRunRegulateInit,              NULL,   SM_TRANSITIONS(regulateInitTransitions),            RegulateStop,           RegulateStop },
+    { Regulate,                 NULL,               SmRunRegulate,                  NULL,   SM_TRANSITIONS(regulateTransitions),                RegulateStop,           RegulateStop },
+    { RegulateStop,             NULL,               NULL,                           NULL,   SM_TRANSITIONS(regulateStopTransitions),            StopEPWMs,              SM_STATE_NONE },
+    { EmergencyStop,            NULL,               SmRunEmergencyStop,             NULL,   SM_TRANSITIONS(emergencyStopTransitions),           StopEPWMs,              SM_STATE_NONE },
+    { RegulateVoltageInit,      NULL,               SmRunRegulateVoltageInit,       NULL,   SM_TRANSITIONS(regulateVoltageInitTransitions),     RegulateVoltageStop,    SM_STATE_NONE },
+    { RegulateVoltage,          NULL,               NULL,                           NULL,   SM_TRANSITIONS(regulateVoltageTransitions),         RegulateVoltageStop,    SM_STATE_NONE },
+    { RegulateVoltageStop,      NULL,               SmRunRegulateVoltageStop,       NULL,   SM_TRANSITIONS(regulateVoltageStopTransitions),     StopEPWMs,              SM_STATE_NONE },
+    { RegulateVoltageWait,      NULL,               NULL,                           NULL,   SM_TRANSITIONS(regulateVoltageWaitTransitions),     StopEPWMs,              SM_STATE_NONE },
+    { Fault,                    NULL,               SmRunFault,                     NULL,   SM_TRANSITIONS(faultTransitions),                   StopEPWMs,              SM_STATE_NONE },
+    { DischargeVBUSToSupercap,  NULL,               SmRunDischargeVBUSToSupercap,   NULL,   SM_TRANSITIONS(dischargeVBUSToSupercapTransitions), StopEPWMs,              SM_STATE_NONE },
+    { WaitDPMUSafeCondition,    NULL,               SmRunWaitDPMUSafeCondition,     NULL,   SM_TRANSITIONS(waitDPMUSafeConditionTransitions),   WaitDPMUSafeCondition,  SM_STATE_NONE },
+    { StopEPWMs,                NULL,               SmRunStopEPWMs,                 NULL,   SM_TRANSITIONS(stopEPWMsTransitions),               StopEPWMs,              SM_STATE_NONE },
+    { Idle,                     NULL,               SmRunIdle,                      NULL,   SM_NO_TRANSITIONS,                                  Idle,                   SM_STATE_KEEP },
+};
+
+#define SM_NUM_OF_STATES (sizeof(stateTable) / sizeof(stateTable[0]))
+#define SM_NO_STATE_IDX 0xFFFFu
+
+/* Operating_state -> stateTable index, built by StateMachineInit() */
+static uint16_t stateTableIdx[SM_STATE_VALUE_RANGE];
+/* index in state_machine_stats.transition of the first transition of each state */
+static uint16_t stateTransitionBase[SM_NUM_OF_STATES];
+
+static inline uint16_t StateMachineTableIdx(uint16_t state)
+{
+    if( state >= SM_STATE_VALUE_RANGE ) {
+        return SM_NO_STATE_IDX;
+    }
+    return stateTableIdx[state];
+}
+
+static void StateMachineBuildTable(void)
+{
+    state_machine_stats_t *stats = &sharedVars_cpu2toCpu1.state_machine_stats;
+    uint16_t stateIdx;
+    uint16_t transitionIdx = 0;
+    uint16_t i;
+
+    for( i = 0; i < SM_STATE_VALUE_RANGE; i++ ) {
+        stateTableIdx[i] = SM_NO_STATE_IDX;
+    }
+
+    for( stateIdx = 0; (stateIdx < SM_NUM_OF_STATES) && (stateIdx < SM_STATS_MAX_STATES); stateIdx++ ) {
+        const StateDescriptor_t *desc = &stateTable[stateIdx];
+
+        stateTableIdx[desc->state] = stateIdx;
+        stats->state[stateIdx].state = desc->state;
+
+        stateTransitionBase[stateIdx] = transitionIdx;
+        for( i = 0; (i < desc->numOfTransitions) && (transitionIdx < SM_STATS_MAX_TRANSITIONS); i++ ) {
+            stats->transition[transitionIdx].from = desc->state;
+            stats->transition[transitionIdx].to = desc->transitions[i].to;
+            transitionIdx++;
+        }
+    }
+    stats->numOfStates = stateIdx;
+    stats->numOfTransitions = transitionIdx;
+}
+
+/**
+ * @brief  Runs the transitions of the current state, the first one whose
+ * guard passes sets State_Next
+ */
+static void StateMachineEvaluateTransitions(uint16_t stateIdx)
+{
+    const StateDescriptor_t *desc = &stateTable[stateIdx];
+    const StateTransition_t *transition;
+    uint16_t i;
+
+    for( i = 0; i < desc->numOfTransitions; i++ ) {
+        transition = &desc->transitions[i];
+        if( (transition->guard == NULL) || transition->guard() ) {
+            if( transition->to == SM_STATE_BEFORE ) {
+                StateVector.State_Next = StateVector.State_Before;
+            } else {
+                StateVector.State_Next = transition->to;
+            }
+            if( transition->action != NULL ) {
+                transition->action();
+            }
+            if( StateVector.State_Next != StateVector.State_Current ) {
+                ControlProfileStateTransitionTaken(stateTransitionBase[stateIdx] + i);
             }
             break;
+        }
+    }
+}
 
-        default:
-            /* should never enter here */
-            break;
+/**
+ * @brief  Slow supervisory task: state transitions and fault
+ * classification. Runs in the super loop, see StateMachineScheduler().
+ */
+void StateMachine(void)
+{
+    uint16_t stateIdx;
+    uint16_t nextIdx;
+    uint16_t tableNext;
+
+    ControlProfileCheckResetRequest();
+
+    stateIdx = StateMachineTableIdx(StateVector.State_Current);
+    if( stateIdx != SM_NO_STATE_IDX ) {
+        stateRunDone = false;
+        ControlProfileStateRunBegin();
+        if( stateTable[stateIdx].run != NULL ) {
+            stateTable[stateIdx].run();
+        }
+        ControlProfileStateRunEnd(stateIdx);
+
+        StateMachineEvaluateTransitions(stateIdx);
     }
+    tableNext = StateVector.State_Next;
+
+    ControlProfileTrackTransient(StateVector.State_Current);
 
     ReadCellVoltagesStateMachine( &cellVoltagesVector[0], &energyBankVoltage, &cellVoltageOverThreshold);
 
@@ -430,10 +792,31 @@ void StateMachine(void)
         HandleDPMUErrorClass();
     }
 
+    /* the fast path tripped the DCDC while this task was held up */
+    if( slowTaskStalled ) {
+        slowTaskStalled = false;
+        StateVector.State_Next = Fault;
+    }
+
     /* print next state then state changes */
     if(StateVector.State_Current  != StateVector.State_Next) {
         ForceUpdateDebugLog();
+        ControlProfileStateTransition(StateVector.State_Current, StateVector.State_Next);
+        if( StateVector.State_Next != tableNext ) {
+            ControlProfileStateForcedTransition();
+        }
         //PRINT("StateVector.State_Current %02d -> Next state %02d\r\n",StateVector.State_Current, StateVector.State_Next);
+
+        if( (stateIdx != SM_NO_STATE_IDX) && (stateTable[stateIdx].exit != NULL) ) {
+            stateTable[stateIdx].exit();
+        }
+        nextIdx = StateMachineTableIdx(StateVector.State_Next);
+        if( nextIdx != SM_NO_STATE_IDX ) {
+            ControlProfileStateEntered(nextIdx);
+            if( stateTable[nextIdx].entry != NULL ) {
+                stateTable[nextIdx].entry();
+            }
+        }
     }
 
     /* update current state */
@@ -470,30 +853,26 @@ void VerifyDPMUSwitchesOK(void) {
     }
 }
 
+/**
+ * @brief  Switches not as expected: leave the state through its switchFaultState
+ */
 void DefineDPMUSafeState( void ) {
 
-    switch( StateVector.State_Current ) {
-        case Idle:
-            DPMUInitializedFlag = false;
-            break;
-        case TrickleChargeInit:
-        case TrickleChargeDelay:
-        case TrickleCharge:
-        case ChargeInit:
-        case ChargeRamp:
-        case Charge:
-            DPMUInitializedFlag = false;
-            StateVector.State_Next = ChargeStop;
-            break;
+    uint16_t stateIdx = StateMachineTableIdx(StateVector.State_Current);
+    uint16_t safeState;
 
-        case RegulateInit:
-        case Regulate:
-            DPMUInitializedFlag = false;
-            StateVector.State_Next = RegulateStop;
-            break;
+    if( stateIdx == SM_NO_STATE_IDX ) {
+        return;
+    }
 
-        default:
-            break;
+    safeState = stateTable[stateIdx].switchFaultState;
+    if( safeState == SM_STATE_NONE ) {
+        return;
+    }
+
+    DPMUInitializedFlag = false;
+    if( safeState != SM_STATE_KEEP ) {
+        StateVector.State_Next = safeState;
     }
 }
 
@@ -504,21 +883,21 @@ void  HandleDPMUErrorClass() {
         case DPMU_ERROR_CLASS_SHORT_CIRCUT:
             if (StateVector.State_Current != EmergencyStop) {
                 StateVector.State_Next = EmergencyStop;
-                CounterGroup.EmergencyCounter = 10;
+                CounterGroup.EmergencyCounter = EMERGENCY_STOP_SM_CYCLES;
             }
             break;
 
         case DPMU_ERROR_CLASS_OVERCURRENT:
             if (StateVector.State_Current != EmergencyStop) {
                 StateVector.State_Next = EmergencyStop;
-                CounterGroup.EmergencyCounter = 10;
+                CounterGroup.EmergencyCounter = EMERGENCY_STOP_SM_CYCLES;
             }
             break;
 
         case DPMU_ERROR_CLASS_OVERVOLTAGE:
             if (StateVector.State_Current != EmergencyStop) {
                 StateVector.State_Next = EmergencyStop;
-                CounterGroup.EmergencyCounter = 10;
+                CounterGroup.EmergencyCounter = EMERGENCY_STOP_SM_CYCLES;
             }
             break;
 
@@ -575,10 +954,21 @@ void StateMachineInit(void)
 
     CounterGroup.PrestateCounter = 0;
     CounterGroup.StateMachineCounter = 0;
+    CounterGroup.FastTickCounter = 0;
+    CounterGroup.SlowTaskSkippedTicks = 0;
+    CounterGroup.SlowTaskStalls = 0;
+
+    StateMachineBuildTable();
+
+    MovingAverageInit(&avgVStoreFilter, avgVStoreWindow, AVG_VSTORE_WINDOW);
+    MovingAverageInit(&avgVBusFilter, avgVBusWindow, AVG_VBUS_WINDOW);
+
+    ControlProfileReset();
 }
 
 void CheckCommandFromIOP(void)
 {
+    uint16_t stateIdx;
 
     /*** commands from CPU1/IOP ***/
     /* check if IOP request for  a change of state */
@@ -601,42 +991,12 @@ void CheckCommandFromIOP(void)
             switch( StateVector.State_Next )
             {
                 case Idle:
-                    switch ( StateVector.State_Current )
-                    {
-                        case PreInitialized:
-                            StateVector.State_Next = PreInitialized;
-                            break;
-                        case WaitDPMUSafeCondition:
-                        case Initialize:
-                              StateVector.State_Next = StateVector.State_Current;
-                              break;
-                        case Idle:
-                            /* No change if it is in Idle already */
-                            break;
-                        case RegulateInit:
-                        case Regulate:
-                            StateVector.State_Next = RegulateStop;
-                            break;
-                        case RegulateVoltageInit:
-                        case RegulateVoltage:
-                            StateVector.State_Next = RegulateVoltageStop;
-                            break;
-
-                        case TrickleCharge:
-                        case TrickleChargeDelay:
-                        case TrickleChargeInit:
-                        case ChargeInit:
-                        case Charge:
-                            StateVector.State_Next = ChargeStop;
-                            break;
-
-                        case Balancing:
-                        case BalancingInit:
-                            StateVector.State_Next = BalancingStop;
-                            break;
-                        default:
-                            StateVector.State_Next = StopEPWMs;
-                            break;
+                    /* each state defines how it is stopped, see stateTable */
+                    stateIdx = StateMachineTableIdx(StateVector.State_Current);
+                    if( stateIdx != SM_NO_STATE_IDX ) {
+                        StateVector.State_Next = stateTable[stateIdx].idleRequestState;
+                    } else {
+                        StateVector.State_Next = StopEPWMs;
                     }
                     break;
 
@@ -676,38 +1036,26 @@ inline void EnableEFuseBBToStopDCDC_EPWM()
     Interrupt_clearACKGroup(INT_eFuseBB_XINT_INTERRUPT_ACK_GROUP);
 }
 
+/**
+ * @brief  Moving average of VStore over the last AVG_VSTORE_WINDOW samples, updated every
+ * sample by StateMachineFastTick()
+ */
 inline void CalculateAvgVStore(){
 
-    static float avgValue = 0.0;
-    static uint16_t avgVSotreCount = 0;
-
     if( sensorVector[VStoreIdx].convertedReady ) {
-        if( avgVSotreCount < 10 ) {
-            avgValue = avgValue + sensorVector[VStoreIdx].realValue;
-            avgVSotreCount++;
-        } else {
-            DCDC_VI.avgVStore = avgValue  /  avgVSotreCount;
-            avgVSotreCount = 0;
-            avgValue =  0.0;
-        }
+        DCDC_VI.avgVStore = MovingAverageUpdate( &avgVStoreFilter, sensorVector[VStoreIdx].realValue );
     }
 }
 
 
+/**
+ * @brief  Moving average of VBus over the last AVG_VBUS_WINDOW samples, updated every
+ * sample by StateMachineFastTick()
+ */
 inline void CalculateAvgVBus(){
 
-    static float avgValue = 0.0;
-    static uint16_t avgVBusCount = 0;
-
     if( sensorVector[VBusIdx].convertedReady ) {
-        if( avgVBusCount < 10 ) {
-            avgValue = avgValue + sensorVector[VBusIdx].realValue;
-            avgVBusCount++;
-        } else {
-            DCDC_VI.avgVBus = avgValue  /  avgVBusCount;
-            avgVBusCount = 0;
-            avgValue = 0;
-        }
+        DCDC_VI.avgVBus = MovingAverageUpdate( &avgVBusFilter, sensorVector[VBusIdx].realValue );
     }
 }
 
@@ -741,15 +1089,32 @@ void CheckMainStateMachineIsRunning()
 {
     static uint32_t stateMachineLastCount = 1;
     static uint32_t stateMachineStoppedCounter = 0;
-    if ( (timer_get_ticks() % 100)==0 )
+    static uint32_t slowTaskLastCount = 1;
+    static uint32_t lastCheckTick = 0;
+    uint32_t now = timer_get_ticks();
+
+    /* the super loop passes many times within one 1 ms tick, check once per window */
+    if ( ((now % 100) == 0) && (now != lastCheckTick) )
     {
-        if (CounterGroup.StateMachineCounter == stateMachineLastCount)
+        lastCheckTick = now;
+        if (CounterGroup.FastTickCounter == stateMachineLastCount)
         {
             ADC_clearInterruptStatus(ADCB_BASE, ADC_INT_NUMBER4);
             Interrupt_clearACKGroup( INT_ADCINB_4_INTERRUPT_ACK_GROUP );
             stateMachineStoppedCounter++;
         }
-        stateMachineLastCount = CounterGroup.StateMachineCounter;
+        else if (CounterGroup.StateMachineCounter == slowTaskLastCount)
+        {
+            /* fast path running, slow task not: stop and go to Fault once it runs again */
+            HAL_StopPwmDCDC();
+            if (!slowTaskStalled)
+            {
+                slowTaskStalled = true;
+                CounterGroup.SlowTaskStalls++;
+            }
+        }
+        stateMachineLastCount = CounterGroup.FastTickCounter;
+        slowTaskLastCount = CounterGroup.StateMachineCounter;
     }
 }
 
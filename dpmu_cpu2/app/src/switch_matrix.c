@@ -57,6 +57,30 @@ void switch_matrix_reset(void)
 
 }
 
+/* disconnects the cells of one energy bank, the other bank is left as it is
+ *
+ * parameter
+ *      cell_number - any cell of the bank to disconnect
+ *                    BAT1..BAT15 or BAT16..BAT30
+ *
+ * returns
+ *      none
+ *
+ * assumptions:
+ *      none
+ * */
+void switch_matrix_disconnect_bank(uint16_t cell_number)
+{
+    if (cell_number <= BAT_15)
+    {   /* low cell group, BAT1..BAT15 */
+        GPIO_writePin(GCMD7, 1);
+    } else
+    {   /* high cell group, BAT16..BAT30 */
+        GPIO_writePin(GCMD8, 1);
+    }
+    DEVICE_DELAY_US( LOGIC_SETUP_TIME );
+}
+
 /* set the correct polarity for the cell connecting to the CLLC
  *
  * parameter
@@ -0,0 +1,279 @@
+/*
+ * can_bench_host.c - the SDO and PDO bench of can_bench.c on the host
+ *
+ *  The CANopen stack with the DPMU object dictionary (gen_objdict.c) runs
+ *  on the virtual CAN bus (codrv_vbus.c) and codrv_cpu_linux.c, set up as
+ *  co_init() and main() do it on the target. The bench is client node 1
+ *  of the bus, as with the CLI command can_bench.
+ *
+ *  The CAN log is log.c on the NOR flash model of nor_flash.c, filled with
+ *  records published the way CPU2 does it before the bench starts. The
+ *  DPMU index handlers of canopen_sdo_upload_indices.c need the CPU2 HAL
+ *  and are not built: objects other than CAN_LOG are served from the
+ *  object dictionary as they are, which is what the SDO timing depends on.
+ *
+ *  The cycle counts come from the host clock, scaled to the 200 MHz of
+ *  the target; they show how the stack code grows, not target cycles.
+ *  Bus times are those of a real bus at the bit rate.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* the stack configuration first, as in co.c */
+#include "gen_define.h"
+
+#include "application_vars.h"
+#include "can_bench.h"
+#include "co_canopen.h"
+#include "co_p401.h"
+#include "cpu1_hal.h"
+#include "device.h"
+#include "emifc.h"
+#include "ext_flash.h"
+#include "gen_indices.h"
+#include "log.h"
+#include "serial.h"
+#include "shared_variables.h"
+#include "canopen/codrv/vbus/codrv_cpu_linux.h"
+#include "canopen/codrv/vbus/codrv_vbus.h"
+
+/* gen_define.h turns the stack's printf() off */
+#undef printf
+
+#define LOG_RECORDS     200u        /* published before the bench */
+#define LOG_BYTES       4096u       /* read by the CAN log bench */
+
+/*** what log.c needs of the rest of CPU1 ***/
+
+int debug_level = DEBUG_ERROR;
+int16_t temperatureSensorVector[4] = { 31, 32, 33, 34 };
+
+void AppVarsInformEntireFlashResetInitiated() {}
+void AppVarsInformEntireFlashResetReady() {}
+void cpu2_state_machine_stats_read_domain(uint32_t offset, uint32_t size) { (void)offset; (void)size; }
+
+/* the debug log in the external RAM of CPU2 is not there */
+void emifc_cpu_read_memory(EMIF1_Config *emif1) { (void)emif1; }
+void emifc_set_flag(void *context) { *(volatile bool *)context = true; }
+bool emifc_queue_read(uint32_t address, uint16_t *data, uint32_t size, emifc_callback_t callback, void *context)
+{
+    (void)address; (void)data; (void)size; (void)callback; (void)context;
+    return false;
+}
+
+/*** stack ***/
+
+/* the CAN_LOG part of co_usr_sdo_ul_indices() */
+static RET_T sdoServerReadInd(BOOL_T execute, UNSIGNED8 sdoNr, UNSIGNED16 index, UNSIGNED8 subIndex)
+{
+    if (index != I_CAN_LOG) {
+        return RET_OK;
+    }
+    switch (subIndex) {
+    case S_CAN_LOG_RESET:
+        log_can_log_reset();
+        return RET_OK;
+    case S_CAN_LOG_READ:
+        return (RET_T)log_can_log_read(execute, sdoNr, index, subIndex);
+    default:
+        return RET_OK;
+    }
+}
+
+static bool stack_init(uint16_t kbit)
+{
+    codrvHardwareInit();
+    if (codrvCanInit(kbit) != RET_OK
+     || codrvTimerSetup(CO_TIMER_INTERVAL) != RET_OK
+     || coCanOpenStackInit(NULL) != RET_OK
+     || co401Init() != RET_OK
+     || coEventRegister_SDO_SERVER_READ(sdoServerReadInd) != RET_OK
+     || coEventRegister_SDO_SERVER_DOMAIN_READ(log_read_domain) != RET_OK
+     || coEventRegister_SDO_SERVER_DOMAIN_READ_FINISHED(log_read_domain_finished) != RET_OK
+     || codrvCanEnable() != RET_OK) {
+        return false;
+    }
+    return true;
+}
+
+/*** CAN log ***/
+
+static uint64_t real_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* the super loop for ms milliseconds of the flash model */
+static void run(uint32_t ms)
+{
+    uint64_t end = host_time_ns() + 1000000ULL * ms;
+
+    while (host_time_ns() < end) {
+        coCommTask();
+        log_can_state_machine();
+        ext_flash_task();
+        host_delay_us(100);
+    }
+}
+
+/* a record as PublishDebugLog() leaves it for CPU1, see test_log.c */
+static void publish(uint32_t counter)
+{
+    uint16_t next = sharedVars_cpu2toCpu1.debug_log.published ^ 1;
+    debug_log_t *log = &sharedVars_cpu2toCpu1.debug_log.record[next];
+    uint32_t noise = counter * 2654435761u;
+
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;
+
+    memset(log, 0, sizeof(*log));
+    log->counter = counter;
+    log->ISen1 = (int16_t)(1200 + (noise >> 28));
+    log->Vbus = (int16_t)(2400 + ((noise >> 20) & 0x3));
+    log->VStore = (int16_t)(counter / 3);
+    for (int c = 0; c < NUMBER_OF_CELLS; c++) {
+        log->cellVoltage[c] = (int16_t)(counter / 30 + c + ((noise >> c) & 1));
+    }
+    log->CurrentState = (int16_t)(counter % 5);
+    log->elapsed_time = (uint16_t)counter;
+
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;
+    sharedVars_cpu2toCpu1.debug_log.published = next;
+}
+
+static void log_fill(void)
+{
+    ext_flash_reset();
+    ext_flash_config();
+    log_can_init();
+
+    for (uint32_t i = 1; i <= LOG_RECORDS; i++) {
+        publish(i);
+        run(10);
+    }
+    run(20);
+}
+
+/*** bench ***/
+
+/* as cli_can_bench_result() */
+static void print_result(const char *name, const can_bench_result_t *result)
+{
+    uint32_t kbit = codrvVbusBitRate();
+    uint32_t transfers = result->transfers ? result->transfers : 1;
+    uint32_t busBits = result->busBits ? result->busBits : 1;
+
+    printf("%s: %lu transfers, %lu bytes, %lu frames each, at %lu kbit/s\n",
+           name, (unsigned long)result->transfers, (unsigned long)(result->bytes / transfers),
+           (unsigned long)(result->frames / transfers), (unsigned long)kbit);
+    printf("  bus:  %lu us/transfer (max %lu), %lu bytes/s\n",
+           (unsigned long)((result->busBits / transfers) * 1000ul / kbit),
+           (unsigned long)(result->maxBusBits * 1000ul / kbit),
+           (unsigned long)((uint64_t)result->bytes * kbit * 1000ul / busBits));
+    printf("  cpu:  %lu cycles/transfer (max %lu)\n",
+           (unsigned long)(result->cycles / transfers), (unsigned long)result->maxCycles);
+    if (result->abortCode != 0) {
+        printf("  SDO abort 0x%08lx\n", (unsigned long)result->abortCode);
+    }
+}
+
+static bool bench_sdo(const char *name, can_bench_sdo_t kind, uint16_t index, uint8_t subIndex,
+                      uint8_t blockSize, uint16_t loops)
+{
+    can_bench_result_t result;
+    bool ok = can_bench_sdo(kind, index, subIndex, blockSize, loops, &result);
+
+    print_result(name, &result);
+    if (!ok) {
+        printf("  %04x:%02x transfer failed\n", index, subIndex);
+    }
+    return ok;
+}
+
+/* the CAN log from the oldest record, as can_bench log */
+static bool bench_log(uint8_t blockSize)
+{
+    can_bench_result_t result;
+    bool ok;
+
+    coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_READ_FROM, 0);
+    coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_READ_MAX, LOG_BYTES);
+    ok = can_bench_sdo(CAN_BENCH_SDO_BLOCK_UPLOAD, I_CAN_LOG, S_CAN_LOG_READ, blockSize, 1, &result);
+    print_result("CAN log", &result);
+    if (!ok || result.bytes == 0) {
+        printf("  CAN log transfer failed\n");
+        return false;
+    }
+    return true;
+}
+
+static bool bench_tpdo(uint16_t pdoNr, uint16_t loops)
+{
+    can_bench_result_t result;
+
+    if (!can_bench_tpdo(pdoNr, loops, &result)) {
+        printf("TPDO %u not received\n", pdoNr);
+        return false;
+    }
+    print_result("TPDO", &result);
+    return true;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "can_bench [-r kbit] [-n loops] [-b blksize]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long kbit = 125, loops = 100, blockSize = 127;
+    nor_flash_config_t config;
+    bool ok = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage();
+        } else if (strcmp(argv[i], "-r") == 0) {
+            kbit = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            loops = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            blockSize = strtoul(argv[++i], NULL, 0);
+        } else {
+            usage();
+        }
+    }
+    if (loops == 0 || loops > 0xFFFF || blockSize == 0 || blockSize > 127) {
+        usage();
+    }
+
+    nor_flash_default_config(&config);
+    host_cpu1_init(&config);
+    if (!stack_init(kbit)) {
+        fprintf(stderr, "stack init failed, bit rate %lu kbit/s?\n", kbit);
+        return 1;
+    }
+    log_fill();
+
+    /* the model clock follows the host clock from here on */
+    host_cpu1_follow(real_ns);
+
+    ok &= bench_sdo("expedited", CAN_BENCH_SDO_UPLOAD, 0x1000, 0, 0, loops);
+    ok &= bench_sdo("segmented", CAN_BENCH_SDO_UPLOAD, 0x1008, 0, 0, loops);
+    ok &= bench_sdo("block", CAN_BENCH_SDO_BLOCK_UPLOAD, 0x1008, 0, blockSize, loops);
+    ok &= bench_sdo("download", CAN_BENCH_SDO_DOWNLOAD, 0x1017, 0, 0, loops);
+    ok &= bench_log(blockSize);
+    ok &= bench_tpdo(2, loops);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+/*
+ * check.h - assertions of the host unit tests
+ *
+ *  A failed check prints where and what and is counted, the test goes on.
+ *  check_report() prints the summary, its result is the exit status.
+ */
+
+#ifndef HOST_CHECK_H_
+#define HOST_CHECK_H_
+
+#include <stdio.h>
+
+static int check_count;
+static int check_failures;
+
+#define CHECK(cond) \
+    do { \
+        check_count++; \
+        if (!(cond)) { \
+            check_failures++; \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        long long a_ = (long long)(actual); \
+        long long e_ = (long long)(expected); \
+        check_count++; \
+        if (a_ != e_) { \
+            check_failures++; \
+            fprintf(stderr, "%s:%d: check failed: %s == %s, %lld != %lld\n", \
+                    __FILE__, __LINE__, #actual, #expected, a_, e_); \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double a_ = (double)(actual); \
+        double e_ = (double)(expected); \
+        check_count++; \
+        if ((a_ - e_ > (tolerance)) || (e_ - a_ > (tolerance))) { \
+            check_failures++; \
+            fprintf(stderr, "%s:%d: check failed: %s == %s, %g != %g\n", \
+                    __FILE__, __LINE__, #actual, #expected, a_, e_); \
+        } \
+    } while (0)
+
+static int check_report(const char *name)
+{
+    if (check_failures != 0) {
+        printf("%s: %d of %d checks failed\n", name, check_failures, check_count);
+        return 1;
+    }
+    printf("%s: %d checks passed\n", name, check_count);
+    return 0;
+}
+
+#endif /* HOST_CHECK_H_ */
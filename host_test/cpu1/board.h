@@ -0,0 +1,17 @@
+/*
+ * board.h - host stand-in for the SysConfig generated board.h of CPU1
+ */
+
+#ifndef HOST_BOARD_H_
+#define HOST_BOARD_H_
+
+#include "driverlib.h"
+#include "device.h"
+
+/* the DMA channel of the EMIF1 transfers of emifc.c */
+#define CPU1_EXT_MEM_BASE                       DMA_CH2_BASE
+#define INT_CPU1_EXT_MEM                        INT_DMA_CH2
+#define INT_CPU1_EXT_MEM_INTERRUPT_ACK_GROUP    INTERRUPT_ACK_GROUP7
+extern __interrupt void INT_CPU1_EXT_MEM_ISR(void);
+
+#endif /* HOST_BOARD_H_ */
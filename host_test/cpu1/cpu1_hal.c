@@ -0,0 +1,411 @@
+/*
+ * cpu1_hal.c - host clock and peripheral model of CPU1
+ *
+ *  The external flash pins: RESET# on GPIO 33, A19 on GPIO 91 and RDY/BSY
+ *  on GPIO 36, routed to XINT4 by ext_flash_config(). The rising edge of
+ *  RDY/BSY calls the handler registered for INT_XINT4 right away, in the
+ *  middle of whatever advanced the clock, like the interrupt would.
+ *
+ *  The DMA channel of emifc.c copies a burst when it is triggered and
+ *  calls the handler registered for INT_CPU1_EXT_MEM once the EMIF1 cycles
+ *  of the burst are over, or when INTM is cleared if it was set then.
+ *  Addresses in the CS2 window are the external RAM below, any other
+ *  address is host memory. EMIF1 can be held by CPU2, the claims of CPU1
+ *  then do not take.
+ *
+ *  timer_get_ticks() and friends of timer.c are replaced by the host
+ *  clock, the CPU1 timer.c is target code.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "board.h"
+#include "device.h"
+#include "emifc.h"
+#include "ext_flash.h"
+#include "serial.h"
+#include "timer.h"
+#include "cpu1_hal.h"
+
+#define GPIO_PINS           256
+#define PIN_FLASH_RESET     33
+#define PIN_FLASH_READY     36
+#define PIN_FLASH_A19       91
+
+struct Serial cli_serial;
+
+static uint64_t now;
+static uint64_t (*follow)(void);
+static uint64_t followStart;
+static uint16_t gpio[GPIO_PINS];
+static uint32_t gpioWrites[GPIO_PINS];
+static uint32_t xintPin[GPIO_INT_XINTS];
+static bool xintEnabled[GPIO_INT_XINTS];
+static void (*xint4Handler)(void);
+static bool xint4Enabled;
+static uint16_t emif1MasterSelect;
+static bool emif1HeldByCpu2;
+static uint16_t extRam[EXT_RAM_SIZE_CS2];
+static bool intm;
+static struct {
+    uint16_t *dest;
+    const uint16_t *src;
+    uint16_t burstWords;
+    bool running;
+    bool busy;                  /* burst in progress, done at doneAt */
+    bool pending;               /* interrupt waiting for INTM */
+    uint64_t doneAt;
+    void (*handler)(void);
+    bool enabled;
+} dma;
+static bool echo;
+static char *captureBuf;
+static size_t captureSize;
+static size_t captureLen;
+
+static void flash_ready_edge(void)
+{
+    if ((xintPin[GPIO_INT_XINT4] == PIN_FLASH_READY) && xintEnabled[GPIO_INT_XINT4] &&
+        xint4Enabled && (xint4Handler != NULL)) {
+        xint4Handler();
+    }
+}
+
+void host_cpu1_init(const nor_flash_config_t *config)
+{
+    now = 0;
+    memset(gpio, 0, sizeof(gpio));
+    memset(gpioWrites, 0, sizeof(gpioWrites));
+    memset(xintEnabled, 0, sizeof(xintEnabled));
+    xint4Handler = NULL;
+    xint4Enabled = false;
+    memset(&dma, 0, sizeof(dma));
+    intm = false;
+    emif1HeldByCpu2 = false;
+    emif1MasterSelect = EMIF_MASTER_CPU1_NG;
+    nor_flash_init(config);
+    nor_flash_set_ready_callback(flash_ready_edge);
+}
+
+void host_cpu1_follow(uint64_t (*realNs)(void))
+{
+    follow = realNs;
+    followStart = (realNs != NULL) ? realNs() - now : 0;
+}
+
+/* busy waits of the model may run ahead of the real clock, never behind */
+static void catch_up(void)
+{
+    uint64_t real;
+
+    if (follow != NULL) {
+        real = follow() - followStart;
+        if (real > now) {
+            host_advance_ns(real - now);
+        }
+    }
+}
+
+uint64_t host_time_ns(void)
+{
+    catch_up();
+    return now;
+}
+
+static void dma_interrupt(void)
+{
+    if (dma.pending && !intm && dma.enabled && (dma.handler != NULL)) {
+        dma.pending = false;
+        dma.handler();
+    }
+}
+
+void host_advance_ns(uint64_t ns)
+{
+    uint64_t end = now + ns;
+    uint64_t start;
+
+    /* bursts end in the middle of the step, the next one starts from there,
+     * the model sees the clock at the end of its part of the step */
+    while (dma.busy && (dma.doneAt <= end)) {
+        start = now;
+        now = dma.doneAt;
+        nor_flash_advance(now - start);
+        dma.busy = false;
+        dma.pending = true;
+        dma_interrupt();
+    }
+    start = now;
+    now = end;
+    nor_flash_advance(now - start);
+}
+
+void host_delay_us(uint32_t us)
+{
+    host_advance_ns(1000ULL * us);
+}
+
+uint16_t *host_ext_ram(uint32_t address)
+{
+    return &extRam[address - EXT_RAM_START_ADDRESS_CS2];
+}
+
+void host_emif1_held_by_cpu2(bool held)
+{
+    emif1HeldByCpu2 = held;
+    if (held) {
+        emif1MasterSelect = EMIF_MASTER_CPU2_G;
+    }
+}
+
+void host_serial_echo(bool on)
+{
+    echo = on;
+}
+
+void host_serial_capture(char *buf, size_t size)
+{
+    captureBuf = buf;
+    captureSize = size;
+    captureLen = 0;
+    if (buf != NULL && size > 0) {
+        buf[0] = '\0';
+    }
+}
+
+/*** external flash bus ***/
+
+static uint32_t cs3_offset(uint32_t addr)
+{
+    if ((addr < EXT_FLASH_START_ADDRESS_CS3) || (addr > EXT_FLASH_END_ADDRESS_CS3)) {
+        fprintf(stderr, "CS3 access outside the window: 0x%08lx\n", (unsigned long)addr);
+        abort();
+    }
+    return addr - EXT_FLASH_START_ADDRESS_CS3;
+}
+
+uint16_t ext_flash_bus_read(uint32_t addr)
+{
+    host_advance_ns(HOST_BUS_CYCLE_NS);
+    return nor_flash_bus_read(cs3_offset(addr));
+}
+
+void ext_flash_bus_write(uint32_t addr, uint16_t data)
+{
+    host_advance_ns(HOST_BUS_CYCLE_NS);
+    nor_flash_bus_write(cs3_offset(addr), data);
+}
+
+/*** GPIO ***/
+
+void GPIO_writePin(uint32_t pin, uint32_t outVal)
+{
+    gpio[pin % GPIO_PINS] = outVal != 0;
+    gpioWrites[pin % GPIO_PINS]++;
+
+    switch (pin) {
+    case PIN_FLASH_RESET:
+        nor_flash_reset_pin(outVal != 0);
+        break;
+    case PIN_FLASH_A19:
+        nor_flash_set_a19(outVal != 0);
+        break;
+    default:
+        break;
+    }
+}
+
+uint32_t host_gpio_writes(uint32_t pin)
+{
+    return gpioWrites[pin % GPIO_PINS];
+}
+
+uint32_t GPIO_readPin(uint32_t pin)
+{
+    host_advance_ns(HOST_POLL_NS);
+    if (pin == PIN_FLASH_READY) {
+        return nor_flash_ready();
+    }
+    return gpio[pin % GPIO_PINS];
+}
+
+void GPIO_setInterruptPin(uint32_t pin, GPIO_ExternalIntNum extIntNum)
+{
+    xintPin[extIntNum] = pin;
+}
+
+void GPIO_enableInterrupt(GPIO_ExternalIntNum extIntNum)
+{
+    xintEnabled[extIntNum] = true;
+}
+
+/*** Interrupts ***/
+
+void Interrupt_register(uint32_t interruptNumber, void (*handler)(void))
+{
+    if (interruptNumber == INT_XINT4) {
+        xint4Handler = handler;
+    } else if (interruptNumber == INT_CPU1_EXT_MEM) {
+        dma.handler = handler;
+    }
+}
+
+void Interrupt_enable(uint32_t interruptNumber)
+{
+    if (interruptNumber == INT_XINT4) {
+        xint4Enabled = true;
+    } else if (interruptNumber == INT_CPU1_EXT_MEM) {
+        dma.enabled = true;
+        dma_interrupt();
+    }
+}
+
+uint16_t __disable_interrupts(void)
+{
+    uint16_t before = intm;
+
+    intm = true;
+    return before;
+}
+
+uint16_t __enable_interrupts(void)
+{
+    uint16_t before = intm;
+
+    intm = false;
+    dma_interrupt();
+    return before;
+}
+
+/*** DMA ***/
+
+/* the external RAM for addresses in the CS2 window */
+static uintptr_t dma_address(const void *address)
+{
+    uintptr_t a = (uintptr_t)address;
+
+    if ((a >= EXT_RAM_START_ADDRESS_CS2) && (a < EXT_RAM_START_ADDRESS_CS2 + EXT_RAM_SIZE_CS2)) {
+        return (uintptr_t)host_ext_ram((uint32_t)a);
+    }
+    return a;
+}
+
+void DMA_configAddresses(uint32_t base, const void *destAddr, const void *srcAddr)
+{
+    (void)base;
+    dma.dest = (uint16_t *)dma_address(destAddr);
+    dma.src = (const uint16_t *)dma_address(srcAddr);
+}
+
+void DMA_configBurst(uint32_t base, uint16_t size, int16_t srcStep, int16_t destStep)
+{
+    (void)base;
+    (void)srcStep;
+    (void)destStep;
+    dma.burstWords = size;
+}
+
+void DMA_startChannel(uint32_t base)
+{
+    (void)base;
+    dma.running = true;
+}
+
+void DMA_stopChannel(uint32_t base)
+{
+    (void)base;
+    dma.running = false;
+}
+
+void DMA_forceTrigger(uint32_t base)
+{
+    (void)base;
+    if (!dma.running || dma.busy) {
+        return;
+    }
+    memmove(dma.dest, dma.src, dma.burstWords * sizeof(uint16_t));
+    dma.busy = true;
+    dma.doneAt = now + (uint64_t)dma.burstWords * HOST_BUS_CYCLE_NS;
+}
+
+/*** IPC, EMIF ***/
+
+uint64_t IPC_getCounter(IPC_Type_t ipcType)
+{
+    (void)ipcType;
+    catch_up();
+    return now * HOST_SYSCLK_PER_US / 1000u;
+}
+
+uint16_t *host_hwregh(uint32_t address)
+{
+    (void)address;
+    return &emif1MasterSelect;
+}
+
+void EMIF_selectMaster(uint32_t configBase, uint16_t select)
+{
+    (void)configBase;
+    if (!emif1HeldByCpu2 || (select == EMIF_MASTER_CPU2_G)) {
+        emif1MasterSelect = select;
+    }
+}
+
+/*** timer.c ***/
+
+uint32_t timer_get_ticks(void)
+{
+    host_advance_ns(HOST_POLL_NS);
+    catch_up();
+    return (uint32_t)(now / 1000000u);
+}
+
+uint32_t timer_get_seconds(void)
+{
+    return (uint32_t)(now / 1000000000u);
+}
+
+void timer_get_time(timer_time_t *ptime)
+{
+    ptime->seconds = timer_get_seconds();
+    ptime->can_time = (uint32_t)(now / 100000000u);
+    ptime->milliseconds = (uint32_t)(now / 1000000u % 1000u);
+}
+
+/*** serial.c ***/
+
+int Serial_printf(struct Serial *dev, const char *fmt, ...)
+{
+    va_list args;
+    int n = 0;
+
+    (void)dev;
+    if ((captureBuf != NULL) && (captureLen < captureSize)) {
+        va_start(args, fmt);
+        n = vsnprintf(captureBuf + captureLen, captureSize - captureLen, fmt, args);
+        va_end(args);
+        captureLen = (captureLen + n < captureSize) ? captureLen + n : captureSize;
+    }
+    if (echo) {
+        va_start(args, fmt);
+        n = vprintf(fmt, args);
+        va_end(args);
+    }
+    return n;
+}
+
+int Serial_debug(uint16_t debugLevel, struct Serial *dev, const char *fmt, ...)
+{
+    va_list args;
+    int n = 0;
+
+    (void)debugLevel;
+    (void)dev;
+    if (echo) {
+        va_start(args, fmt);
+        n = vprintf(fmt, args);
+        va_end(args);
+    }
+    return n;
+}
@@ -0,0 +1,49 @@
+/*
+ * cpu1_hal.h - host clock and peripheral model of CPU1, test side
+ *
+ *  One clock in nanoseconds drives everything: DEVICE_DELAY_US, timer
+ *  ticks, the IPC counter and the commands of the flash model. A bus cycle
+ *  to the flash and every poll of a pin or the timer advance it a little,
+ *  the way a busy wait on the target takes time.
+ */
+
+#ifndef HOST_CPU1_HAL_H_
+#define HOST_CPU1_HAL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nor_flash.h"
+
+#define HOST_BUS_CYCLE_NS   60u     /* EMIF1 CS3 access, strobe of 7 EMIF1CLK plus setup */
+#define HOST_POLL_NS        100u    /* pin or timer read in a busy wait */
+#define HOST_SYSCLK_PER_US  200u
+
+/* starts the clock at 0 and the flash model erased with config */
+void host_cpu1_init(const nor_flash_config_t *config);
+
+uint64_t host_time_ns(void);
+void host_advance_ns(uint64_t ns);
+
+/* the clock catches up with realNs() whenever it is read, for benches that
+ * measure the time the host takes; NULL for the model time only */
+void host_cpu1_follow(uint64_t (*realNs)(void));
+
+/* the external RAM word at address in the CS2 window */
+uint16_t *host_ext_ram(uint32_t address);
+
+/* CPU2 holds EMIF1, the claims of CPU1 do not take until false */
+void host_emif1_held_by_cpu2(bool held);
+
+/* GPIO_writePin() calls on pin since host_cpu1_init() */
+uint32_t host_gpio_writes(uint32_t pin);
+
+/* echo Serial_printf() output to stdout */
+void host_serial_echo(bool echo);
+
+/* collects the Serial_printf() output from now on in buf, what does not fit
+ * is lost, NULL for none */
+void host_serial_capture(char *buf, size_t size);
+
+#endif /* HOST_CPU1_HAL_H_ */
@@ -0,0 +1,34 @@
+/*
+ * device.h - host stand-in for the C2000Ware device.h of CPU1
+ *
+ *  Intrinsics and interrupt keywords of the C28x compiler mapped to plain
+ *  C. DEVICE_DELAY_US advances the host clock of cpu1_hal.c, the flash
+ *  model completes its commands in that time.
+ */
+
+#ifndef HOST_DEVICE_H_
+#define HOST_DEVICE_H_
+
+#include "driverlib.h"
+
+#define DEVICE_SYSCLK_FREQ  200000000UL
+
+void host_delay_us(uint32_t us);
+#define DEVICE_DELAY_US(x)  host_delay_us(x)
+
+#define __interrupt
+#define EINT
+#define DINT
+#define EALLOW
+#define EDIS
+
+/* INTM, bit 0 of the result is its state before, interrupts that came
+ * while it was set are taken when it is cleared */
+uint16_t __disable_interrupts(void);
+uint16_t __enable_interrupts(void);
+
+/* the only inline assembly is the RPT || NOP busy wait of emifc.c */
+void host_advance_ns(uint64_t ns);
+#define asm(text)           host_advance_ns(256 * 5)
+
+#endif /* HOST_DEVICE_H_ */
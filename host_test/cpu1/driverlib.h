@@ -0,0 +1,140 @@
+/*
+ * driverlib.h - host stand-in for the C2000Ware driverlib used by CPU1
+ *
+ *  Only what the CPU1 sources built on the host call. The external flash
+ *  on EMIF1 CS3 is the NOR flash model in nor_flash.c, its RESET#, A19 and
+ *  RDY/BSY pins are wired to the GPIO model in cpu1_hal.c. Configuration
+ *  calls that only set up the peripherals do nothing.
+ */
+
+#ifndef HOST_DRIVERLIB_H_
+#define HOST_DRIVERLIB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** GPIO ***/
+
+typedef enum {
+    GPIO_DIR_MODE_IN,
+    GPIO_DIR_MODE_OUT,
+} GPIO_Direction;
+
+typedef enum {
+    GPIO_INT_XINT1,
+    GPIO_INT_XINT2,
+    GPIO_INT_XINT3,
+    GPIO_INT_XINT4,
+    GPIO_INT_XINT5,
+    GPIO_INT_XINTS
+} GPIO_ExternalIntNum;
+
+typedef enum {
+    GPIO_INT_TYPE_FALLING_EDGE,
+    GPIO_INT_TYPE_RISING_EDGE,
+    GPIO_INT_TYPE_BOTH_EDGES,
+} GPIO_IntType;
+
+/* pin_map.h, the EMIF1 chip selects emifc.c picks from */
+#define GPIO_34_EMIF1_CS2N      0x00081802U
+#define GPIO_35_EMIF1_CS3N      0x00081A02U
+
+#define GPIO_PIN_TYPE_STD       0x0000U
+#define GPIO_PIN_TYPE_PULLUP    0x0001U
+#define GPIO_QUAL_ASYNC         3
+
+void GPIO_writePin(uint32_t pin, uint32_t outVal);
+uint32_t GPIO_readPin(uint32_t pin);
+void GPIO_setInterruptPin(uint32_t pin, GPIO_ExternalIntNum extIntNum);
+void GPIO_enableInterrupt(GPIO_ExternalIntNum extIntNum);
+#define GPIO_setPinConfig(pinConfig)                ((void)0)
+#define GPIO_setPadConfig(pin, pinType)             ((void)0)
+#define GPIO_setDirectionMode(pin, pinIO)           ((void)0)
+#define GPIO_setQualificationMode(pin, qualification) ((void)0)
+#define GPIO_setInterruptType(extIntNum, intType)   ((void)0)
+
+/*** Interrupts ***/
+
+#define INT_XINT4                   0x00C00E04UL
+#define INT_DMA_CH2                 0x00200B02UL
+#define INTERRUPT_ACK_GROUP7        0x0040U
+#define INTERRUPT_ACK_GROUP12       0x0800U
+
+void Interrupt_register(uint32_t interruptNumber, void (*handler)(void));
+void Interrupt_enable(uint32_t interruptNumber);
+#define Interrupt_clearACKGroup(group)              ((void)0)
+
+/*** DMA ***/
+
+/* one channel, a burst is copied when triggered and its interrupt comes
+ * when the EMIF1 cycles of the burst are over, see cpu1_hal.c */
+#define DMA_CH2_BASE                0x00001060UL
+
+void DMA_configAddresses(uint32_t base, const void *destAddr, const void *srcAddr);
+void DMA_configBurst(uint32_t base, uint16_t size, int16_t srcStep, int16_t destStep);
+void DMA_startChannel(uint32_t base);
+void DMA_stopChannel(uint32_t base);
+void DMA_forceTrigger(uint32_t base);
+
+/*** IPC ***/
+
+typedef enum {
+    IPC_CPU1_L_CPU2_R,
+} IPC_Type_t;
+
+/* free running SYSCLK counter */
+uint64_t IPC_getCounter(IPC_Type_t ipcType);
+
+/*** SYSCTL ***/
+
+#define SYSCTL_EMIF1CLK_DIV_1                       0
+#define SysCtl_setEMIF1ClockDivider(divider)        ((void)0)
+
+/*** EMIF ***/
+
+#define EMIF1_BASE                  0x00047000UL
+#define EMIF1CONFIG_BASE            0x0005F4C0UL
+#define MEMCFG_O_EMIF1MSEL          0x0U
+#define EMIF_MASTER_CPU1_NG         0x0U
+#define EMIF_MASTER_CPU1_G          0x1U
+#define EMIF_MASTER_CPU2_G          0x2U
+#define EMIF_MASTER_CPU1_NG2        0x3U
+#define EMIF_ASYNC_CS2_OFFSET       0x14U
+#define EMIF_ASYNC_CS3_OFFSET       0x16U
+#define EMIF_ASYNC_NORMAL_MODE      0x0U
+#define EMIF_ASYNC_DATA_WIDTH_16    0x1U
+
+typedef struct {
+    uint32_t rSetup;
+    uint32_t rStrobe;
+    uint32_t rHold;
+    uint32_t turnArnd;
+    uint32_t wSetup;
+    uint32_t wStrobe;
+    uint32_t wHold;
+} EMIF_AsyncTimingParams;
+
+/* the EMIF1 master select register, the only one read back */
+uint16_t *host_hwregh(uint32_t address);
+#define HWREGH(x)                   (*host_hwregh(x))
+
+void EMIF_selectMaster(uint32_t configBase, uint16_t select);
+#define EMIF_setAccessProtection(configBase, access)                ((void)0)
+#define EMIF_commitAccessConfig(configBase)                         ((void)0)
+#define EMIF_lockAccessConfig(configBase)                           ((void)0)
+#define EMIF_setAsyncMode(base, offset, mode)                       ((void)0)
+#define EMIF_disableAsyncExtendedWait(base, offset)                 ((void)0)
+#define EMIF_setAsyncDataBusWidth(base, offset, width)              ((void)0)
+#define EMIF_setAsyncTimingParams(base, offset, tParam)             ((void)(tParam))
+
+/*** MemCfg ***/
+
+/* the GS RAM shared with CPU2 is plain memory on the host */
+#define MEMCFG_SECT_GS0                             0x00000001UL
+#define MEMCFG_GSRAMMASTER_CPU1                     0U
+#define MEMCFG_GSRAMMASTER_CPU2                     1U
+#define MemCfg_setGSRAMMasterSel(ramSections, master)   ((void)0)
+
+#endif /* HOST_DRIVERLIB_H_ */
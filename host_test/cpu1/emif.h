@@ -0,0 +1,10 @@
+/*
+ * emif.h - host stand-in for the C2000Ware driverlib emif.h
+ */
+
+#ifndef HOST_EMIF_H_
+#define HOST_EMIF_H_
+
+#include "driverlib.h"
+
+#endif /* HOST_EMIF_H_ */
@@ -0,0 +1,10 @@
+/*
+ * gpio.h - host stand-in for the C2000Ware driverlib gpio.h
+ */
+
+#ifndef HOST_GPIO_H_
+#define HOST_GPIO_H_
+
+#include "driverlib.h"
+
+#endif /* HOST_GPIO_H_ */
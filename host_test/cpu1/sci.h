@@ -0,0 +1,10 @@
+/*
+ * sci.h - host stand-in for the C2000Ware driverlib sci.h
+ */
+
+#ifndef HOST_SCI_H_
+#define HOST_SCI_H_
+
+#include "driverlib.h"
+
+#endif /* HOST_SCI_H_ */
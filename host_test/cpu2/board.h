@@ -0,0 +1,90 @@
+/*
+ * board.h - host stand-in for the SysConfig generated board.h of CPU2
+ *
+ *  Names and pins as in dpmu_cpu2/dpmu_cpu2.syscfg. Board_init() in
+ *  cpu2_hal.c loads the PWM configuration of the .syscfg into the register
+ *  model.
+ */
+
+#ifndef HOST_BOARD_H_
+#define HOST_BOARD_H_
+
+#include "driverlib.h"
+#include "device.h"
+
+/*** EPWM ***/
+
+#define EPWM_BASE(n)            (0x4000UL + 0x100UL * ((n) - 1))
+#define EPWM1_BASE              EPWM_BASE(1)
+#define EPWM3_BASE              EPWM_BASE(3)
+#define EPWM6_BASE              EPWM_BASE(6)
+#define EPWM7_BASE              EPWM_BASE(7)
+#define EPWM8_BASE              EPWM_BASE(8)
+#define EPWM9_BASE              EPWM_BASE(9)
+#define EPWM11_BASE             EPWM_BASE(11)
+#define EPWM12_BASE             EPWM_BASE(12)
+#define EPWM16_BASE             EPWM_BASE(16)
+
+#define BEG_1_2_BASE            EPWM11_BASE
+#define QABPWM_12_13_BASE       EPWM6_BASE
+#define QABPWM_14_15_BASE       EPWM7_BASE
+#define QABPWM_4_5_BASE         EPWM8_BASE
+#define QABPWM_6_7_BASE         EPWM3_BASE
+#define InrushCurrentLimit_BASE EPWM12_BASE
+#define EPWMTimer_BASE          EPWM16_BASE
+#define GLOAD_4_3_BASE          EPWM9_BASE
+
+/*** ADC ***/
+
+#define ADCA_BASE               0x7400UL
+#define ADCB_BASE               0x7480UL
+#define ADCC_BASE               0x7500UL
+#define ADCD_BASE               0x7580UL
+#define ADCARESULT_BASE         0x0B00UL
+#define ADCBRESULT_BASE         0x0B20UL
+#define ADCCRESULT_BASE         0x0B40UL
+#define ADCDRESULT_BASE         0x0B60UL
+#define ADCINA_BASE             ADCA_BASE
+
+/*** GPIO ***/
+
+#define GCMD0                   97
+#define GCMD1                   124
+#define GCMD2                   128
+#define GCMD3                   137
+#define GCMD4                   138
+#define GCMD5                   139
+#define GCMD6                   140
+#define GCMD7                   142
+#define GCMD8                   146
+#define N_OE_POL                132
+#define N_LE_POL_0              133
+#define N_LE_POL_1              134
+#define GLOAD_1                 168
+#define GLOAD_2                 167
+#define GLOAD_3                 162
+#define GLOAD_4                 161
+#define GLOAD_4_3_EPWMA_GPIO    161
+#define GLOAD_4_3_EPWMB_GPIO    162
+#define LED2                    145
+
+/*** interrupts ***/
+
+#define INT_ADCINA_2_INTERRUPT_ACK_GROUP        INTERRUPT_ACK_GROUP10
+#define INT_ADCINB_4_INTERRUPT_ACK_GROUP        INTERRUPT_ACK_GROUP10
+#define INT_ADCINC_1_INTERRUPT_ACK_GROUP        INTERRUPT_ACK_GROUP1
+#define INT_ADCIND_3_INTERRUPT_ACK_GROUP        INTERRUPT_ACK_GROUP10
+#define INT_GLOAD_4_3_TZ_INTERRUPT_ACK_GROUP    INTERRUPT_ACK_GROUP2
+#define INT_eFuseBB_XINT_INTERRUPT_ACK_GROUP    INTERRUPT_ACK_GROUP1
+
+__interrupt void INT_ADCINA_2_ISR(void);
+__interrupt void INT_ADCINB_4_ISR(void);
+__interrupt void INT_ADCINC_1_ISR(void);
+__interrupt void INT_ADCIND_3_ISR(void);
+__interrupt void INT_myCPUTIMER2_ISR(void);
+__interrupt void INT_eFuseBB_XINT_ISR(void);
+__interrupt void INT_GLOAD_4_3_TZ_ISR(void);
+
+void Board_init(void);
+
+#endif /* HOST_BOARD_H_ */
@@ -0,0 +1,376 @@
+/*
+ * cpu2_hal.c - register model of the CPU2 peripherals
+ *
+ *  The EPWM modules keep their time base, compare, action qualifier, dead
+ *  band and trip settings, host_epwm_output() evaluates an output at a
+ *  counter value from them. The counters themselves are not modelled, the
+ *  plant model keeps the time.
+ *
+ *  The GPIO model latches the cell switch matrix address the way the
+ *  demultiplexer latches on the board do, see switch_matrix.c.
+ *
+ *  IPC_getCounter() returns the simulated SYSCLK count of the current fast
+ *  tick, set by the simulator with host_sysclk_set(), plus the host time
+ *  spent since then at HOST_SYSCLK_PER_US. Execution times measured with it
+ *  are host times scaled to SYSCLK cycles, not C28x cycles.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "board.h"
+#include "cpu2_hal.h"
+
+#define EPWM_MODULES    16
+#define GPIO_PINS       256
+#define ADC_MODULES     4
+
+static host_epwm_t epwm[EPWM_MODULES];
+static uint16_t gpio[GPIO_PINS];
+static uint16_t adcResult[ADC_MODULES][ADC_SOC_NUMBERS];
+static uint16_t matrixLatch[4];                 /* GCMD3..GCMD6 */
+static uint32_t ipcFlagsCpu1ToCpu2;
+static uint64_t sysclkBase;
+static struct timespec sysclkHostBase;
+
+host_epwm_t *host_epwm(uint32_t base)
+{
+    return &epwm[(base - EPWM1_BASE) / 0x100 % EPWM_MODULES];
+}
+
+static uint16_t adc_module(uint32_t resultBase)
+{
+    return (resultBase - ADCARESULT_BASE) / 0x20 % ADC_MODULES;
+}
+
+static bool aq_apply(bool level, uint16_t action)
+{
+    switch (action) {
+    case EPWM_AQ_OUTPUT_LOW:
+        return false;
+    case EPWM_AQ_OUTPUT_HIGH:
+        return true;
+    case EPWM_AQ_OUTPUT_TOGGLE:
+        return !level;
+    default:
+        return level;
+    }
+}
+
+/* action qualifier output after the up count events at or before count */
+static bool aq_level(const host_epwm_t *pwm, uint16_t output, uint16_t count)
+{
+    const uint16_t *action = pwm->action[output];
+    uint16_t first = (pwm->compare[0] <= pwm->compare[1]) ? 0 : 1;
+    bool level = false;
+
+    /* two passes, the first one settles the level the period starts with */
+    for (int pass = 0; pass < 2; pass++) {
+        uint16_t end = (pass == 0) ? pwm->period : count;
+
+        level = aq_apply(level, action[EPWM_AQ_OUTPUT_ON_TIMEBASE_ZERO]);
+        for (uint16_t n = 0; n < 2; n++) {
+            uint16_t cmp = (n == 0) ? first : 1 - first;
+            uint16_t event = (cmp == 0) ? EPWM_AQ_OUTPUT_ON_TIMEBASE_UP_CMPA : EPWM_AQ_OUTPUT_ON_TIMEBASE_UP_CMPB;
+
+            if ((pwm->compare[cmp] <= pwm->period) && (pwm->compare[cmp] <= end)) {
+                level = aq_apply(level, action[event]);
+            }
+        }
+        if (end >= pwm->period) {
+            level = aq_apply(level, action[EPWM_AQ_OUTPUT_ON_TIMEBASE_PERIOD]);
+        }
+    }
+    return level;
+}
+
+/*
+ * Output pin level at counter value count, dead band delays taken as zero.
+ * With the dead band enabled A is the rising edge path of A and B the
+ * active low falling edge path of A, as configured in the .syscfg.
+ */
+bool host_epwm_output(uint32_t base, EPWM_ActionQualifierOutputModule output, uint16_t count)
+{
+    const host_epwm_t *pwm = host_epwm(base);
+    bool a, b;
+
+    if (!pwm->running || (pwm->tripped && pwm->tripForcesLow)) {
+        return false;
+    }
+    a = aq_level(pwm, EPWM_AQ_OUTPUT_A, count);
+    b = pwm->deadBand[EPWM_DB_FED] ? !a : aq_level(pwm, EPWM_AQ_OUTPUT_B, count);
+
+    if (output == EPWM_AQ_OUTPUT_A) {
+        return pwm->swap[EPWM_DB_OUTPUT_A] ? b : a;
+    }
+    return pwm->swap[EPWM_DB_OUTPUT_B] ? a : b;
+}
+
+/* share of the period the output is high */
+float host_epwm_duty(uint32_t base, EPWM_ActionQualifierOutputModule output)
+{
+    const host_epwm_t *pwm = host_epwm(base);
+    uint16_t edge[4] = { 0, pwm->compare[0], pwm->compare[1], pwm->period };
+    uint32_t high = 0;
+
+    /* the level only changes at these counts, sort them and sum the high spans */
+    for (int i = 1; i < 4; i++) {
+        for (int j = i; (j > 0) && (edge[j] < edge[j - 1]); j--) {
+            uint16_t swap = edge[j];
+            edge[j] = edge[j - 1];
+            edge[j - 1] = swap;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        uint32_t end = (i < 3) ? edge[i + 1] : (uint32_t)pwm->period + 1;
+
+        if ((edge[i] <= pwm->period) && (end > edge[i]) && host_epwm_output(base, output, edge[i])) {
+            high += ((end > (uint32_t)pwm->period + 1) ? (uint32_t)pwm->period + 1 : end) - edge[i];
+        }
+    }
+    return (float)high / ((float)pwm->period + 1);
+}
+
+uint16_t host_gpio(uint32_t pin)
+{
+    /* the input and sharing bus switches are driven by EPWM9 held at its ZERO action */
+    if (pin == GLOAD_4_3_EPWMA_GPIO) {
+        return host_epwm_output(GLOAD_4_3_BASE, EPWM_AQ_OUTPUT_A, 0);
+    }
+    if (pin == GLOAD_4_3_EPWMB_GPIO) {
+        return host_epwm_output(GLOAD_4_3_BASE, EPWM_AQ_OUTPUT_B, 0);
+    }
+    return gpio[pin % GPIO_PINS];
+}
+
+/*
+ * BATn is connected when the output of its bank is enabled: both latches of
+ * an odd n hold n / 2, the second latch of an even n holds one less.
+ */
+uint16_t host_matrix_cell(uint16_t bank)
+{
+    uint16_t first = matrixLatch[bank == HOST_BANK_LOW ? 0 : 1];    /* GCMD3, GCMD4 */
+    uint16_t second = matrixLatch[bank == HOST_BANK_LOW ? 2 : 3];   /* GCMD5, GCMD6 */
+    uint16_t cell;
+
+    if (gpio[bank == HOST_BANK_LOW ? GCMD7 : GCMD8] != 0) {
+        return 0;
+    }
+    if (first == second) {
+        cell = 2 * first + 1;
+    } else if (second + 1 == first) {
+        cell = 2 * first;
+    } else {
+        return 0;
+    }
+    return (bank == HOST_BANK_LOW) ? cell : cell + 16;
+}
+
+void host_adc_set(uint32_t resultBase, ADC_SOCNumber socNumber, uint16_t counts)
+{
+    adcResult[adc_module(resultBase)][socNumber % ADC_SOC_NUMBERS] = counts;
+}
+
+void host_ipc_set_flags(uint32_t flags)
+{
+    ipcFlagsCpu1ToCpu2 |= flags;
+}
+
+uint32_t host_ipc_flags(void)
+{
+    return ipcFlagsCpu1ToCpu2;
+}
+
+void host_sysclk_set(uint64_t cycles)
+{
+    sysclkBase = cycles;
+    clock_gettime(CLOCK_MONOTONIC, &sysclkHostBase);
+}
+
+/* the configuration dpmu_cpu2.syscfg generates, counters stopped */
+void Board_init(void)
+{
+    static const struct {
+        uint32_t base;
+        uint16_t period;
+        uint16_t cmpA;
+        uint16_t cmpB;
+        uint16_t actionA[2];        /* ZERO, UP_CMPA */
+        uint16_t actionB[3];        /* ZERO, UP_CMPA, UP_CMPB */
+        bool deadBand;
+        bool tripForcesLow;
+    } config[] = {
+        { BEG_1_2_BASE,            714,   1,     2000,  { EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_LOW },
+          { EPWM_AQ_OUTPUT_LOW, EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_NO_CHANGE }, true, true },
+        { QABPWM_12_13_BASE,       386,   193,   0,     { EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_LOW },
+          { EPWM_AQ_OUTPUT_LOW, EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_NO_CHANGE }, true, true },
+        { QABPWM_14_15_BASE,       386,   193,   0,     { EPWM_AQ_OUTPUT_LOW, EPWM_AQ_OUTPUT_HIGH },
+          { EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_LOW, EPWM_AQ_OUTPUT_NO_CHANGE }, true, true },
+        { QABPWM_4_5_BASE,         386,   193,   0,     { EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_LOW },
+          { EPWM_AQ_OUTPUT_LOW, EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_NO_CHANGE }, true, true },
+        { QABPWM_6_7_BASE,         386,   193,   0,     { EPWM_AQ_OUTPUT_LOW, EPWM_AQ_OUTPUT_HIGH },
+          { EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_LOW, EPWM_AQ_OUTPUT_NO_CHANGE }, true, true },
+        { InrushCurrentLimit_BASE, 10000, 0,     0,     { EPWM_AQ_OUTPUT_NO_CHANGE, EPWM_AQ_OUTPUT_NO_CHANGE },
+          { EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_LOW, EPWM_AQ_OUTPUT_NO_CHANGE }, false, true },
+        { EPWMTimer_BASE,          1000,  800,   0,     { EPWM_AQ_OUTPUT_NO_CHANGE, EPWM_AQ_OUTPUT_NO_CHANGE },
+          { EPWM_AQ_OUTPUT_NO_CHANGE, EPWM_AQ_OUTPUT_NO_CHANGE, EPWM_AQ_OUTPUT_NO_CHANGE }, false, false },
+        { GLOAD_4_3_BASE,          10,    10001, 10001, { EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_LOW },
+          { EPWM_AQ_OUTPUT_HIGH, EPWM_AQ_OUTPUT_NO_CHANGE, EPWM_AQ_OUTPUT_LOW }, false, false },
+    };
+
+    memset(epwm, 0, sizeof(epwm));
+    memset(gpio, 0, sizeof(gpio));
+    memset(matrixLatch, 0, sizeof(matrixLatch));
+
+    for (size_t i = 0; i < sizeof(config) / sizeof(config[0]); i++) {
+        host_epwm_t *pwm = host_epwm(config[i].base);
+
+        pwm->period = config[i].period;
+        pwm->compare[0] = config[i].cmpA;
+        pwm->compare[1] = config[i].cmpB;
+        pwm->action[EPWM_AQ_OUTPUT_A][EPWM_AQ_OUTPUT_ON_TIMEBASE_ZERO] = config[i].actionA[0];
+        pwm->action[EPWM_AQ_OUTPUT_A][EPWM_AQ_OUTPUT_ON_TIMEBASE_UP_CMPA] = config[i].actionA[1];
+        pwm->action[EPWM_AQ_OUTPUT_B][EPWM_AQ_OUTPUT_ON_TIMEBASE_ZERO] = config[i].actionB[0];
+        pwm->action[EPWM_AQ_OUTPUT_B][EPWM_AQ_OUTPUT_ON_TIMEBASE_UP_CMPA] = config[i].actionB[1];
+        pwm->action[EPWM_AQ_OUTPUT_B][EPWM_AQ_OUTPUT_ON_TIMEBASE_UP_CMPB] = config[i].actionB[2];
+        pwm->deadBand[EPWM_DB_RED] = config[i].deadBand;
+        pwm->deadBand[EPWM_DB_FED] = config[i].deadBand;
+        pwm->tripForcesLow = config[i].tripForcesLow;
+    }
+
+    /* switch matrix and polarity switch disabled, all outputs active low */
+    gpio[GCMD7] = gpio[GCMD8] = 1;
+    gpio[N_OE_POL] = gpio[N_LE_POL_0] = gpio[N_LE_POL_1] = 1;
+}
+
+/*** driverlib ***/
+
+void EPWM_setCounterCompareValue(uint32_t base, EPWM_CounterCompareModule compModule, uint16_t compCount)
+{
+    host_epwm(base)->compare[compModule == EPWM_COUNTER_COMPARE_A ? 0 : 1] = compCount;
+}
+
+uint16_t EPWM_getCounterCompareValue(uint32_t base, EPWM_CounterCompareModule compModule)
+{
+    return host_epwm(base)->compare[compModule == EPWM_COUNTER_COMPARE_A ? 0 : 1];
+}
+
+void EPWM_setTimeBasePeriod(uint32_t base, uint16_t periodCount)
+{
+    host_epwm(base)->period = periodCount;
+}
+
+uint16_t EPWM_getTimeBasePeriod(uint32_t base)
+{
+    return host_epwm(base)->period;
+}
+
+void EPWM_setPhaseShift(uint32_t base, uint16_t phaseCount)
+{
+    host_epwm(base)->phase = phaseCount;
+}
+
+void EPWM_setTimeBaseCounterMode(uint32_t base, EPWM_TimeBaseCountMode counterMode)
+{
+    host_epwm(base)->running = (counterMode == EPWM_COUNTER_MODE_UP);
+}
+
+void EPWM_setActionQualifierAction(uint32_t base, EPWM_ActionQualifierOutputModule epwmOutput,
+                                   EPWM_ActionQualifierOutput output, EPWM_ActionQualifierOutputEvent event)
+{
+    host_epwm(base)->action[epwmOutput][event] = output;
+}
+
+void EPWM_setActionQualifierShadowLoadMode(uint32_t base, EPWM_ActionQualifierModule aqModule,
+                                           EPWM_ActionQualifierLoadMode loadMode)
+{
+    (void)base;
+    (void)aqModule;
+    (void)loadMode;
+}
+
+void EPWM_setDeadBandDelayMode(uint32_t base, EPWM_DeadBandDelayMode delayMode, bool enableDelayMode)
+{
+    host_epwm(base)->deadBand[delayMode] = enableDelayMode;
+}
+
+void EPWM_setDeadBandOutputSwapMode(uint32_t base, EPWM_DeadBandOutput output, bool enableSwapMode)
+{
+    host_epwm(base)->swap[output] = enableSwapMode;
+}
+
+void EPWM_forceTripZoneEvent(uint32_t base, uint16_t tzForceEvent)
+{
+    if (tzForceEvent & EPWM_TZ_FORCE_EVENT_OST) {
+        host_epwm(base)->tripped = true;
+    }
+}
+
+void EPWM_clearTripZoneFlag(uint32_t base, uint16_t tzFlags)
+{
+    if (tzFlags & EPWM_TZ_FLAG_OST) {
+        host_epwm(base)->tripped = false;
+    }
+}
+
+uint16_t ADC_readResult(uint32_t resultBase, ADC_SOCNumber socNumber)
+{
+    return adcResult[adc_module(resultBase)][socNumber % ADC_SOC_NUMBERS];
+}
+
+void ADC_clearInterruptStatus(uint32_t base, ADC_IntNumber adcIntNum)
+{
+    (void)base;
+    (void)adcIntNum;
+}
+
+void ADC_clearInterruptOverflowStatus(uint32_t base, ADC_IntNumber adcIntNum)
+{
+    (void)base;
+    (void)adcIntNum;
+}
+
+uint32_t GPIO_readPin(uint32_t pin)
+{
+    return host_gpio(pin);
+}
+
+void GPIO_writePin(uint32_t pin, uint32_t outVal)
+{
+    pin %= GPIO_PINS;
+    gpio[pin] = (outVal != 0);
+
+    /* a latch enable going low takes the address GCMD0..GCMD2 */
+    if ((outVal == 0) && (pin >= GCMD3) && (pin <= GCMD6)) {
+        matrixLatch[pin - GCMD3] = gpio[GCMD0] | (gpio[GCMD1] << 1) | (gpio[GCMD2] << 2);
+    }
+}
+
+void Interrupt_clearACKGroup(uint16_t group)
+{
+    (void)group;
+}
+
+uint64_t IPC_getCounter(IPC_Type_t ipcType)
+{
+    struct timespec now;
+    int64_t elapsedNs;
+
+    (void)ipcType;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsedNs = (int64_t)(now.tv_sec - sysclkHostBase.tv_sec) * 1000000000 + (now.tv_nsec - sysclkHostBase.tv_nsec);
+    return sysclkBase + (uint64_t)elapsedNs * HOST_SYSCLK_PER_US / 1000;
+}
+
+bool IPC_isFlagBusyRtoL(IPC_Type_t ipcType, uint32_t flags)
+{
+    return (ipcType == IPC_CPU1_L_CPU2_R) && ((ipcFlagsCpu1ToCpu2 & flags) != 0);
+}
+
+void IPC_ackFlagRtoL(IPC_Type_t ipcType, uint32_t flags)
+{
+    if (ipcType == IPC_CPU1_L_CPU2_R) {
+        ipcFlagsCpu1ToCpu2 &= ~flags;
+    }
+}
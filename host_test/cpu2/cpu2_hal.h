@@ -0,0 +1,46 @@
+/*
+ * cpu2_hal.h - register model of the CPU2 peripherals, plant side
+ *
+ *  The CPU2 sources drive the model through the driverlib stand-ins in
+ *  driverlib.h, the plant model reads the PWM outputs and switch pins and
+ *  writes the ADC results with the functions below.
+ */
+
+#ifndef HOST_CPU2_HAL_H_
+#define HOST_CPU2_HAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+#define HOST_SYSCLK_PER_US  200u    /* SYSCLK cycles per microsecond */
+#define HOST_TBCLK_HZ       100e6   /* EPWM time base clock */
+
+typedef struct host_epwm {
+    uint16_t period;
+    uint16_t compare[2];                            /* CMPA, CMPB */
+    uint16_t phase;
+    uint16_t action[2][EPWM_AQ_OUTPUT_EVENTS];      /* per output A, B and counter event */
+    bool deadBand[2];                               /* RED, FED, FED active low */
+    bool swap[2];
+    bool running;                                   /* counter started */
+    bool tripped;                                   /* one shot trip flag */
+    bool tripForcesLow;                             /* TZA and TZB actions are LOW */
+} host_epwm_t;
+
+/* cell connected to the CLLC by the switch matrix of a bank, 0 for none */
+#define HOST_BANK_LOW   0
+#define HOST_BANK_HIGH  1
+
+host_epwm_t *host_epwm(uint32_t base);
+bool host_epwm_output(uint32_t base, EPWM_ActionQualifierOutputModule output, uint16_t count);
+float host_epwm_duty(uint32_t base, EPWM_ActionQualifierOutputModule output);
+uint16_t host_gpio(uint32_t pin);
+uint16_t host_matrix_cell(uint16_t bank);
+void host_adc_set(uint32_t resultBase, ADC_SOCNumber socNumber, uint16_t counts);
+void host_ipc_set_flags(uint32_t flags);
+uint32_t host_ipc_flags(void);
+void host_sysclk_set(uint64_t cycles);
+
+#endif /* HOST_CPU2_HAL_H_ */
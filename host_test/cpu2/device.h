@@ -0,0 +1,26 @@
+/*
+ * device.h - host stand-in for the C2000Ware device.h of CPU2
+ *
+ *  Intrinsics and interrupt keywords of the C28x compiler mapped to plain
+ *  C. DEVICE_DELAY_US does not wait, the plant model settles in simulated
+ *  time instead.
+ */
+
+#ifndef HOST_DEVICE_H_
+#define HOST_DEVICE_H_
+
+#include "driverlib.h"
+
+#define DEVICE_SYSCLK_FREQ  200000000UL
+#define DEVICE_DELAY_US(x)  ((void)(x))
+
+#define __interrupt
+#define EINT
+#define DINT
+#define ERTM
+
+/* 32 bit atomic add and subtract of the C28x, long is 32 bits there */
+#define __addl(p, v)        (*(int32_t *)(p) += (int32_t)(v))
+#define __subl(p, v)        (*(int32_t *)(p) -= (int32_t)(v))
+
+#endif /* HOST_DEVICE_H_ */
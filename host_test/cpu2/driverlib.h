@@ -0,0 +1,155 @@
+/*
+ * driverlib.h - host stand-in for the C2000Ware driverlib used by CPU2
+ *
+ *  Only what the CPU2 sources built on the host call. The peripherals are
+ *  a register model in cpu2_hal.c, the plant model reads the PWM outputs
+ *  and writes the ADC results through cpu2_hal.h.
+ */
+
+#ifndef HOST_DRIVERLIB_H_
+#define HOST_DRIVERLIB_H_
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** EPWM ***/
+
+typedef enum {
+    EPWM_COUNTER_COMPARE_A,
+    EPWM_COUNTER_COMPARE_B,
+} EPWM_CounterCompareModule;
+
+typedef enum {
+    EPWM_COUNTER_MODE_UP,
+    EPWM_COUNTER_MODE_DOWN,
+    EPWM_COUNTER_MODE_UP_DOWN,
+    EPWM_COUNTER_MODE_STOP_FREEZE,
+} EPWM_TimeBaseCountMode;
+
+typedef enum {
+    EPWM_AQ_OUTPUT_A,
+    EPWM_AQ_OUTPUT_B,
+} EPWM_ActionQualifierOutputModule;
+
+typedef enum {
+    EPWM_AQ_OUTPUT_NO_CHANGE,
+    EPWM_AQ_OUTPUT_LOW,
+    EPWM_AQ_OUTPUT_HIGH,
+    EPWM_AQ_OUTPUT_TOGGLE,
+} EPWM_ActionQualifierOutput;
+
+/* counter events in the order they occur in a period of the up count */
+typedef enum {
+    EPWM_AQ_OUTPUT_ON_TIMEBASE_ZERO,
+    EPWM_AQ_OUTPUT_ON_TIMEBASE_UP_CMPA,
+    EPWM_AQ_OUTPUT_ON_TIMEBASE_UP_CMPB,
+    EPWM_AQ_OUTPUT_ON_TIMEBASE_PERIOD,
+    EPWM_AQ_OUTPUT_ON_TIMEBASE_DOWN_CMPA,
+    EPWM_AQ_OUTPUT_ON_TIMEBASE_DOWN_CMPB,
+    EPWM_AQ_OUTPUT_EVENTS
+} EPWM_ActionQualifierOutputEvent;
+
+typedef enum {
+    EPWM_ACTION_QUALIFIER_A,
+    EPWM_ACTION_QUALIFIER_B,
+} EPWM_ActionQualifierModule;
+
+typedef enum {
+    EPWM_AQ_LOAD_ON_CNTR_ZERO,
+    EPWM_AQ_LOAD_ON_CNTR_PERIOD,
+    EPWM_AQ_LOAD_ON_CNTR_ZERO_PERIOD,
+} EPWM_ActionQualifierLoadMode;
+
+typedef enum {
+    EPWM_DB_RED,
+    EPWM_DB_FED,
+} EPWM_DeadBandDelayMode;
+
+typedef enum {
+    EPWM_DB_OUTPUT_A,
+    EPWM_DB_OUTPUT_B,
+} EPWM_DeadBandOutput;
+
+#define EPWM_TZ_FORCE_EVENT_CBC 0x2U
+#define EPWM_TZ_FORCE_EVENT_OST 0x4U
+#define EPWM_TZ_INTERRUPT       0x1U
+#define EPWM_TZ_FLAG_CBC        0x2U
+#define EPWM_TZ_FLAG_OST        0x4U
+
+void EPWM_setCounterCompareValue(uint32_t base, EPWM_CounterCompareModule compModule, uint16_t compCount);
+uint16_t EPWM_getCounterCompareValue(uint32_t base, EPWM_CounterCompareModule compModule);
+void EPWM_setTimeBasePeriod(uint32_t base, uint16_t periodCount);
+uint16_t EPWM_getTimeBasePeriod(uint32_t base);
+void EPWM_setPhaseShift(uint32_t base, uint16_t phaseCount);
+void EPWM_setTimeBaseCounterMode(uint32_t base, EPWM_TimeBaseCountMode counterMode);
+void EPWM_setActionQualifierAction(uint32_t base, EPWM_ActionQualifierOutputModule epwmOutput,
+                                   EPWM_ActionQualifierOutput output, EPWM_ActionQualifierOutputEvent event);
+void EPWM_setActionQualifierShadowLoadMode(uint32_t base, EPWM_ActionQualifierModule aqModule,
+                                           EPWM_ActionQualifierLoadMode loadMode);
+void EPWM_setDeadBandDelayMode(uint32_t base, EPWM_DeadBandDelayMode delayMode, bool enableDelayMode);
+void EPWM_setDeadBandOutputSwapMode(uint32_t base, EPWM_DeadBandOutput output, bool enableSwapMode);
+void EPWM_forceTripZoneEvent(uint32_t base, uint16_t tzForceEvent);
+void EPWM_clearTripZoneFlag(uint32_t base, uint16_t tzFlags);
+
+/*** ADC ***/
+
+typedef enum {
+    ADC_SOC_NUMBER0,
+    ADC_SOC_NUMBER1,
+    ADC_SOC_NUMBER2,
+    ADC_SOC_NUMBER3,
+    ADC_SOC_NUMBERS = 16
+} ADC_SOCNumber;
+
+typedef enum {
+    ADC_INT_NUMBER1,
+    ADC_INT_NUMBER2,
+    ADC_INT_NUMBER3,
+    ADC_INT_NUMBER4,
+} ADC_IntNumber;
+
+uint16_t ADC_readResult(uint32_t resultBase, ADC_SOCNumber socNumber);
+void ADC_clearInterruptStatus(uint32_t base, ADC_IntNumber adcIntNum);
+void ADC_clearInterruptOverflowStatus(uint32_t base, ADC_IntNumber adcIntNum);
+
+/*** GPIO ***/
+
+uint32_t GPIO_readPin(uint32_t pin);
+void GPIO_writePin(uint32_t pin, uint32_t outVal);
+
+/*** Interrupt ***/
+
+#define INTERRUPT_ACK_GROUP1    0x0001U
+#define INTERRUPT_ACK_GROUP2    0x0002U
+#define INTERRUPT_ACK_GROUP3    0x0004U
+#define INTERRUPT_ACK_GROUP10   0x0200U
+#define INTERRUPT_ACK_GROUP12   0x0800U
+
+void Interrupt_clearACKGroup(uint16_t group);
+
+/*** IPC ***/
+
+typedef enum {
+    IPC_CPU1_L_CPU2_R,
+    IPC_CPU2_L_CPU1_R,
+} IPC_Type_t;
+
+#define IPC_FLAG0   (1UL << 0)
+#define IPC_FLAG1   (1UL << 1)
+#define IPC_FLAG2   (1UL << 2)
+#define IPC_FLAG7   (1UL << 7)
+#define IPC_FLAG8   (1UL << 8)
+#define IPC_FLAG9   (1UL << 9)
+#define IPC_FLAG10  (1UL << 10)
+#define IPC_FLAG16  (1UL << 16)
+#define IPC_FLAG17  (1UL << 17)
+#define IPC_FLAG30  (1UL << 30)
+
+uint64_t IPC_getCounter(IPC_Type_t ipcType);
+bool IPC_isFlagBusyRtoL(IPC_Type_t ipcType, uint32_t flags);
+void IPC_ackFlagRtoL(IPC_Type_t ipcType, uint32_t flags);
+
+#endif /* HOST_DRIVERLIB_H_ */
@@ -0,0 +1,10 @@
+/*
+ * epwm.h - host stand-in for the C2000Ware driverlib epwm.h
+ */
+
+#ifndef HOST_EPWM_H_
+#define HOST_EPWM_H_
+
+#include "driverlib.h"
+
+#endif /* HOST_EPWM_H_ */
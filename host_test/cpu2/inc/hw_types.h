@@ -0,0 +1,11 @@
+/*
+ * hw_types.h - host stand-in for the C2000Ware inc/hw_types.h
+ */
+
+#ifndef HOST_INC_HW_TYPES_H_
+#define HOST_INC_HW_TYPES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#endif /* HOST_INC_HW_TYPES_H_ */
@@ -0,0 +1,487 @@
+/*
+ * nor_flash.c - RAM backed model of the external NOR flash on EMIF1 CS3
+ *
+ *  Word addresses: the flash address of a bus cycle is A19 from its GPIO
+ *  and the offset into the CS3 window. The unlock cycles decode A10..A0
+ *  only, like the device, the command cycles of a sector address any word
+ *  of that sector.
+ *
+ *  Commands take effect when they complete: a program or an erase changes
+ *  the array when its time is up, meanwhile array reads return the status
+ *  word, DQ6 toggling on every read, DQ7 the complement of the data being
+ *  programmed, DQ5 set once the command has failed. RDY/BSY rises when the
+ *  command completes, or when a reset ends a failed one.
+ */
+
+#include <string.h>
+
+#include "nor_flash.h"
+
+#define UNLOCK_MASK         0x7FFUL
+#define WRITE_BUFFER_MAX    256
+
+#define STATUS_DQ7          0x80
+#define STATUS_DQ6          0x40
+#define STATUS_DQ5          0x20
+#define STATUS_DQ1          0x02
+
+typedef enum {
+    NOR_READ,
+    NOR_CFI,
+    NOR_UNLOCK1,            /* AA written */
+    NOR_UNLOCK2,            /* AA 55 written */
+    NOR_PROGRAM,            /* next write is the word to program */
+    NOR_ERASE_SETUP,        /* 80 written */
+    NOR_ERASE_UNLOCK1,
+    NOR_ERASE_UNLOCK2,
+    NOR_BUFFER_COUNT,       /* 25 written to a sector address */
+    NOR_BUFFER_DATA,
+    NOR_BUFFER_CONFIRM,     /* waiting for 29 */
+    NOR_BUFFER_ABORT,       /* left by AA 55 F0 only */
+    NOR_ABORT_UNLOCK1,
+    NOR_ABORT_UNLOCK2,
+} nor_state_t;
+
+typedef enum {
+    NOR_OP_PROGRAM,
+    NOR_OP_SECTOR_ERASE,
+    NOR_OP_CHIP_ERASE,
+} nor_op_t;
+
+typedef struct sector {
+    uint32_t address;
+    uint32_t size;
+} sector_t;
+
+/* same layout as ex_flash_info[] in ext_flash.c, 8k, 4k, 4k, 16k then 32k words */
+static sector_t sectors[NOR_FLASH_SECTORS];
+
+static nor_flash_config_t cfg;
+static nor_flash_stats_t stats;
+static uint16_t array[NOR_FLASH_WORDS];
+static nor_flash_ready_callback_t readyCallback;
+
+static nor_state_t state;
+static bool a19;
+static bool inReset;
+
+/* command in progress */
+static bool busy;
+static bool failed;
+static uint64_t busyLeft;               /* ns */
+static nor_op_t op;
+static int opSector;
+static uint32_t opAddress;
+static uint16_t opWords;
+static uint16_t opData[WRITE_BUFFER_MAX];
+static uint16_t toggle;
+
+/* write buffer being loaded */
+static int bufferSector;
+static uint32_t bufferPage;
+static uint16_t bufferCount;
+static uint16_t bufferLoaded;
+static uint32_t bufferAddress;
+
+static void init_sectors(void)
+{
+    static const uint32_t small[4] = { 0x2000, 0x1000, 0x1000, 0x4000 };
+    uint32_t address = 0;
+
+    for (int n = 0; n < NOR_FLASH_SECTORS; n++) {
+        sectors[n].address = address;
+        sectors[n].size = (n < 4) ? small[n] : 0x8000;
+        address += sectors[n].size;
+    }
+}
+
+int nor_flash_sector(uint32_t address)
+{
+    for (int n = 0; n < NOR_FLASH_SECTORS; n++) {
+        if ((address >= sectors[n].address) && (address < sectors[n].address + sectors[n].size)) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+void nor_flash_default_config(nor_flash_config_t *config)
+{
+    config->wordProgramNs = 60000;
+    config->bufferProgramNs = 240000;
+    config->sectorEraseNs = 500000000UL;
+    config->chipEraseNs = 35000000000ULL;
+    config->writeBufferWords = 32;
+}
+
+void nor_flash_init(const nor_flash_config_t *config)
+{
+    init_sectors();
+    cfg = *config;
+    if (cfg.writeBufferWords > WRITE_BUFFER_MAX) {
+        cfg.writeBufferWords = WRITE_BUFFER_MAX;
+    }
+    memset(&stats, 0, sizeof(stats));
+    memset(array, 0xFF, sizeof(array));
+    state = NOR_READ;
+    a19 = false;
+    inReset = false;
+    busy = false;
+    failed = false;
+}
+
+void nor_flash_set_ready_callback(nor_flash_ready_callback_t callback)
+{
+    readyCallback = callback;
+}
+
+static uint32_t full_address(uint32_t offset)
+{
+    return (a19 ? NOR_FLASH_WINDOW_WORDS : 0) | (offset & (NOR_FLASH_WINDOW_WORDS - 1));
+}
+
+static void ready_edge(void)
+{
+    busy = false;
+    failed = false;
+    if (readyCallback != NULL) {
+        readyCallback();
+    }
+}
+
+static void start(nor_op_t type, uint64_t ns)
+{
+    op = type;
+    busy = true;
+    failed = false;
+    busyLeft = ns;
+    state = NOR_READ;
+}
+
+static void command_error(void)
+{
+    stats.commandErrors++;
+    state = NOR_READ;
+}
+
+static void buffer_abort(void)
+{
+    stats.bufferAborts++;
+    state = NOR_BUFFER_ABORT;
+}
+
+/* reset command or RESET# pulse, a command in progress is abandoned */
+static void reset(void)
+{
+    bool wasBusy = busy;
+
+    stats.resets++;
+    state = NOR_READ;
+    if (wasBusy) {
+        ready_edge();
+    }
+}
+
+static void complete(void)
+{
+    switch (op) {
+    case NOR_OP_PROGRAM:
+        for (uint16_t i = 0; i < opWords; i++) {
+            uint16_t *word = &array[opAddress + i];
+
+            if ((opData[i] & ~*word) != 0) {
+                // a 0 cannot be programmed back to 1, DQ5 is set and the
+                // device stays busy until it is reset
+                failed = true;
+            }
+            *word &= opData[i];
+        }
+        stats.wordsProgrammed += opWords;
+        if (failed) {
+            stats.programFailures++;
+            return;
+        }
+        break;
+
+    case NOR_OP_SECTOR_ERASE:
+        for (uint32_t i = 0; i < sectors[opSector].size; i++) {
+            array[sectors[opSector].address + i] = 0xFFFF;
+        }
+        stats.sectorErases[opSector]++;
+        break;
+
+    case NOR_OP_CHIP_ERASE:
+        memset(array, 0xFF, sizeof(array));
+        stats.chipErases++;
+        for (int n = 0; n < NOR_FLASH_SECTORS; n++) {
+            stats.sectorErases[n]++;
+        }
+        break;
+    }
+    ready_edge();
+}
+
+void nor_flash_advance(uint64_t ns)
+{
+    if (!busy || failed) {
+        return;
+    }
+    if (ns < busyLeft) {
+        busyLeft -= ns;
+        return;
+    }
+    busyLeft = 0;
+    complete();
+}
+
+static uint16_t cfi_read(uint32_t offset)
+{
+    uint16_t n = 0;
+
+    switch (offset & 0xFF) {
+    case 0x10: return 'Q';
+    case 0x11: return 'R';
+    case 0x12: return 'Y';
+    case 0x13: return 0x02;                     // AMD/Fujitsu standard command set
+    case 0x27: return 21;                       // 2^21 bytes
+    case 0x2A:
+        // 2^n bytes in a write buffer program, 0 without a write buffer
+        while ((cfg.writeBufferWords != 0) && ((1U << n) < 2U * cfg.writeBufferWords)) {
+            n++;
+        }
+        return n;
+    default:
+        return 0;
+    }
+}
+
+uint16_t nor_flash_bus_read(uint32_t offset)
+{
+    if (inReset) {
+        return 0xFFFF;
+    }
+    if (busy || (state == NOR_BUFFER_ABORT)) {
+        uint16_t status = toggle;
+
+        toggle ^= STATUS_DQ6;
+        stats.busyReads++;
+        if (state == NOR_BUFFER_ABORT) {
+            return status | STATUS_DQ1;
+        }
+        if (op == NOR_OP_PROGRAM) {
+            status |= ~opData[opWords - 1] & STATUS_DQ7;
+        }
+        if (failed) {
+            status |= STATUS_DQ5;
+        }
+        return status;
+    }
+    if (state == NOR_CFI) {
+        return cfi_read(offset);
+    }
+    return array[full_address(offset)];
+}
+
+static bool unlock(uint32_t offset, uint32_t address, uint16_t data)
+{
+    return ((offset & UNLOCK_MASK) == address) && (data == ((address == 0x555) ? 0xAA : 0x55));
+}
+
+static void buffer_write(uint32_t address, uint16_t data)
+{
+    switch (state) {
+    case NOR_BUFFER_COUNT:
+        if (nor_flash_sector(address) != bufferSector) {
+            buffer_abort();
+            return;
+        }
+        bufferCount = data + 1;
+        bufferLoaded = 0;
+        if (bufferCount > cfg.writeBufferWords) {
+            buffer_abort();
+            return;
+        }
+        state = NOR_BUFFER_DATA;
+        break;
+
+    case NOR_BUFFER_DATA:
+        if (bufferLoaded == 0) {
+            bufferPage = address / cfg.writeBufferWords;
+            bufferAddress = address;
+        }
+        // every word in the page of the first one, in ascending order
+        if ((address / cfg.writeBufferWords != bufferPage) || (address != bufferAddress + bufferLoaded)) {
+            buffer_abort();
+            return;
+        }
+        opData[bufferLoaded++] = data;
+        opWords = bufferLoaded;
+        if (bufferLoaded == bufferCount) {
+            state = NOR_BUFFER_CONFIRM;
+        }
+        break;
+
+    case NOR_BUFFER_CONFIRM:
+        if ((data != 0x29) || (nor_flash_sector(address) != bufferSector)) {
+            buffer_abort();
+            return;
+        }
+        opAddress = bufferAddress;
+        opWords = bufferCount;
+        stats.bufferPrograms++;
+        start(NOR_OP_PROGRAM, cfg.bufferProgramNs);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void nor_flash_bus_write(uint32_t offset, uint16_t data)
+{
+    uint32_t address = full_address(offset);
+
+    if (inReset) {
+        return;
+    }
+    if (busy) {
+        if (failed && (data == 0xF0)) {
+            reset();
+            return;
+        }
+        stats.busyWrites++;
+        return;
+    }
+
+    switch (state) {
+    case NOR_READ:
+        if (unlock(offset, 0x555, data)) {
+            state = NOR_UNLOCK1;
+        } else if (((offset & 0xFF) == 0x55) && (data == 0x98)) {
+            state = NOR_CFI;
+        } else if (data == 0xF0) {
+            reset();
+        } else {
+            command_error();
+        }
+        break;
+
+    case NOR_CFI:
+        if (data == 0xF0) {
+            state = NOR_READ;
+        }
+        break;
+
+    case NOR_UNLOCK1:
+        state = NOR_UNLOCK2;
+        if (!unlock(offset, 0x2AA, data)) {
+            command_error();
+        }
+        break;
+
+    case NOR_UNLOCK2:
+        if (((offset & UNLOCK_MASK) == 0x555) && (data == 0xA0)) {
+            state = NOR_PROGRAM;
+        } else if (((offset & UNLOCK_MASK) == 0x555) && (data == 0x80)) {
+            state = NOR_ERASE_SETUP;
+        } else if ((data == 0x25) && (cfg.writeBufferWords != 0)) {
+            bufferSector = nor_flash_sector(address);
+            state = NOR_BUFFER_COUNT;
+        } else if (data == 0xF0) {
+            reset();
+        } else {
+            command_error();
+        }
+        break;
+
+    case NOR_PROGRAM:
+        opAddress = address;
+        opWords = 1;
+        opData[0] = data;
+        stats.wordPrograms++;
+        start(NOR_OP_PROGRAM, cfg.wordProgramNs);
+        break;
+
+    case NOR_ERASE_SETUP:
+        state = NOR_ERASE_UNLOCK1;
+        if (!unlock(offset, 0x555, data)) {
+            command_error();
+        }
+        break;
+
+    case NOR_ERASE_UNLOCK1:
+        state = NOR_ERASE_UNLOCK2;
+        if (!unlock(offset, 0x2AA, data)) {
+            command_error();
+        }
+        break;
+
+    case NOR_ERASE_UNLOCK2:
+        if (((offset & UNLOCK_MASK) == 0x555) && (data == 0x10)) {
+            start(NOR_OP_CHIP_ERASE, cfg.chipEraseNs);
+        } else if (data == 0x30) {
+            opSector = nor_flash_sector(address);
+            start(NOR_OP_SECTOR_ERASE, cfg.sectorEraseNs);
+        } else {
+            command_error();
+        }
+        break;
+
+    case NOR_BUFFER_COUNT:
+    case NOR_BUFFER_DATA:
+    case NOR_BUFFER_CONFIRM:
+        buffer_write(address, data);
+        break;
+
+    case NOR_BUFFER_ABORT:
+        if (unlock(offset, 0x555, data)) {
+            state = NOR_ABORT_UNLOCK1;
+        }
+        break;
+
+    case NOR_ABORT_UNLOCK1:
+        state = unlock(offset, 0x2AA, data) ? NOR_ABORT_UNLOCK2 : NOR_BUFFER_ABORT;
+        break;
+
+    case NOR_ABORT_UNLOCK2:
+        if (((offset & UNLOCK_MASK) == 0x555) && (data == 0xF0)) {
+            reset();
+        } else {
+            state = NOR_BUFFER_ABORT;
+        }
+        break;
+    }
+}
+
+void nor_flash_set_a19(bool level)
+{
+    a19 = level;
+}
+
+void nor_flash_reset_pin(bool level)
+{
+    if (!level && !inReset) {
+        reset();
+    }
+    inReset = !level;
+}
+
+bool nor_flash_ready(void)
+{
+    return !busy && !inReset;
+}
+
+uint16_t nor_flash_peek(uint32_t address)
+{
+    return array[address % NOR_FLASH_WORDS];
+}
+
+void nor_flash_poke(uint32_t address, uint16_t data)
+{
+    array[address % NOR_FLASH_WORDS] = data;
+}
+
+const nor_flash_stats_t *nor_flash_stats(void)
+{
+    return &stats;
+}
@@ -0,0 +1,78 @@
+/*
+ * nor_flash.h - RAM backed model of the external NOR flash on EMIF1 CS3
+ *
+ *  A 1M x 16 parallel NOR flash with the sector layout of ex_flash_info[],
+ *  SA0..SA34, A19 on a GPIO selecting the half of the flash seen in the
+ *  512k word CS3 window. The JEDEC command set used by ext_flash.c is
+ *  decoded by a state machine: unlock cycles, word program, write buffer
+ *  program with abort, sector and chip erase, reset and CFI query.
+ *
+ *  Erasing sets words to 0xFFFF, programming ANDs the data into the array.
+ *  A command keeps the device busy, RDY/BSY low, for its configured time,
+ *  advanced by nor_flash_advance(). Programming a 0 back to 1 fails the way
+ *  the device does: the command never completes until a reset. See nor_flash.c.
+ */
+
+#ifndef HOST_NOR_FLASH_H_
+#define HOST_NOR_FLASH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NOR_FLASH_WORDS         0x100000UL      /* 1M x 16 */
+#define NOR_FLASH_WINDOW_WORDS  0x80000UL       /* words seen with one A19 level */
+#define NOR_FLASH_SECTORS       35              /* SA0..SA34 */
+
+typedef struct nor_flash_config {
+    uint32_t wordProgramNs;     /* word program command */
+    uint32_t bufferProgramNs;   /* write buffer program command, any word count */
+    uint32_t sectorEraseNs;
+    uint64_t chipEraseNs;
+    uint16_t writeBufferWords;  /* 0: no write buffer, CFI reports none */
+} nor_flash_config_t;
+
+typedef struct nor_flash_stats {
+    uint32_t sectorErases[NOR_FLASH_SECTORS];  /* wear, a chip erase counts for every sector */
+    uint32_t chipErases;
+    uint32_t wordPrograms;
+    uint32_t bufferPrograms;
+    uint32_t wordsProgrammed;
+    uint32_t programFailures;   /* a 0 programmed back to 1, the device hangs busy */
+    uint32_t bufferAborts;      /* write buffer sequences aborted */
+    uint32_t commandErrors;     /* bus writes that were not a valid command cycle */
+    uint32_t busyWrites;        /* bus writes while busy, ignored */
+    uint32_t busyReads;         /* array reads while busy, status returned */
+    uint32_t resets;            /* reset commands and RESET# pulses */
+} nor_flash_stats_t;
+
+/* called on the busy to ready edge of RDY/BSY */
+typedef void (*nor_flash_ready_callback_t)(void);
+
+void nor_flash_default_config(nor_flash_config_t *config);
+
+/* erased array, read mode, statistics cleared */
+void nor_flash_init(const nor_flash_config_t *config);
+
+void nor_flash_set_ready_callback(nor_flash_ready_callback_t callback);
+
+/* bus cycles, offset is the word offset into the CS3 window */
+uint16_t nor_flash_bus_read(uint32_t offset);
+void nor_flash_bus_write(uint32_t offset, uint16_t data);
+
+void nor_flash_set_a19(bool level);
+void nor_flash_reset_pin(bool level);   /* RESET#, active low */
+bool nor_flash_ready(void);             /* RDY/BSY */
+
+/* time passes, completes the command in progress when its time is up */
+void nor_flash_advance(uint64_t ns);
+
+/* direct access to the array, bypassing the command state machine */
+uint16_t nor_flash_peek(uint32_t address);
+void nor_flash_poke(uint32_t address, uint16_t data);
+
+/* sector of a flash word address, -1 if beyond the flash */
+int nor_flash_sector(uint32_t address);
+
+const nor_flash_stats_t *nor_flash_stats(void);
+
+#endif /* HOST_NOR_FLASH_H_ */
@@ -0,0 +1,315 @@
+/*
+ * plant.c - numerical model of the DPMU power stage for plant_sim
+ *
+ *  The buck/boost stage is integrated switching cycle by switching cycle:
+ *  a step never crosses a compare or period event of the BEG time base, so
+ *  the switch states are constant over a step and the inductor current is
+ *  piecewise linear. High side (BEG output A) on puts the bus on the switch
+ *  node, low side (output B) on puts it to ground. With both off the body
+ *  diode of the low side carries a positive inductor current and the one of
+ *  the high side a negative one, down to zero where the current stays
+ *  (discontinuous conduction, the trickle charge pulses run there).
+ *
+ *  The input source charges the bus through Qinb up to its current limit,
+ *  or through the inrush resistor at the duty cycle of the inrush PWM. The
+ *  load is a constant current behind Qlb. The CLLC of a bank discharges the
+ *  cell the switch matrix connects while its PWM pair runs.
+ *
+ *  The sensors see the plant through first order filters and the analog
+ *  front ends of sensors.c, their offsets a little off the nominal ones so
+ *  that the zero offset calibration matters, plus a few counts of noise.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "cpu2_hal.h"
+#include "plant.h"
+#include "switches_pins.h"
+
+#define ADC_MAX_COUNTS      65535.0
+#define ADC_REFERENCE       3.0
+#define NOISE_COUNTS        3
+
+/* analog front ends: ADC input voltage = offset + gain * quantity */
+#define ISEN2_OFFSET        1.507       /* nominal 1.5, 0.05 V/A */
+#define ISEN1_OFFSET        1.515       /* nominal 1.52 */
+#define IF_1_OFFSET         1.046       /* nominal 1.05 */
+#define I_DAB2_OFFSET       0.905       /* nominal 0.9, 0.2 V/A */
+#define I_DAB3_OFFSET       0.897
+#define V_DWN_OFFSET        1.241       /* nominal 1.237, 1/9.3 V/V */
+#define V_UP_OFFSET         1.233
+#define BUS_DIVIDER         100.0       /* differential, V/V */
+
+void plant_default_config(plant_config_t *config)
+{
+    config->vin = 182.0;
+    config->rin = 0.1;
+    config->iinMax = 30.0;
+    config->rinrush = 20.0;
+    config->cbus = 1.0e-3;
+    config->inductance = 100e-6;
+    config->rl = 0.05;
+    config->vdiode = 0.7;
+    config->cellCapacitance = 50.0;
+    config->cellEsr = 0.002;
+    config->cellVoltage = 0.5;
+    config->iload = 0.0;
+    config->cllcCurrent = 3.0;
+    config->cllcTau = 100e-6;
+    config->sensorTau = 10e-6;
+    config->cellSenseTau = 100e-6;
+}
+
+/*
+ * Capacitance spread of +/-3% over the bank, cells 7 and 22 20% weak so
+ * they reach the balancing threshold first. The bank has charged the bus
+ * through the high side diode before the simulation starts.
+ */
+void plant_init(plant_t *plant, const plant_config_t *config)
+{
+    memset(plant, 0, sizeof(*plant));
+    plant->cfg = *config;
+
+    for (int i = 0; i < PLANT_CELLS; i++) {
+        plant->cellC[i] = config->cellCapacitance * (1.0 + 0.03 * sin(2.3 * i));
+        plant->cellV[i] = config->cellVoltage;
+    }
+    plant->cellC[6] *= 0.8;
+    plant->cellC[21] *= 0.8;
+    plant->vbus = fmax(plant_vstore(plant) - config->vdiode, 0.0);
+    plant->vbusSense = plant->vbus;
+    plant->vstoreSense = plant_vstore(plant);
+    plant->noise = 12345;
+}
+
+double plant_vstore(const plant_t *plant)
+{
+    double v = 0.0;
+
+    for (int i = 0; i < PLANT_CELLS; i++) {
+        v += plant->cellV[i];
+    }
+    return v;
+}
+
+double plant_cell_min(const plant_t *plant)
+{
+    double v = plant->cellV[0];
+
+    for (int i = 1; i < PLANT_CELLS; i++) {
+        v = fmin(v, plant->cellV[i]);
+    }
+    return v;
+}
+
+double plant_cell_max(const plant_t *plant)
+{
+    double v = plant->cellV[0];
+
+    for (int i = 1; i < PLANT_CELLS; i++) {
+        v = fmax(v, plant->cellV[i]);
+    }
+    return v;
+}
+
+/* BATn of the switch matrix to the cell index, BAT_15_N is not a cell */
+static int cell_index(uint16_t cellNr)
+{
+    return (cellNr <= 15) ? cellNr - 1 : cellNr - 2;
+}
+
+/* first order lag, backward Euler: h is far below every tau */
+static double filter(double state, double input, double tau, double h)
+{
+    return state + (input - state) * h / (tau + h);
+}
+
+/* CLLC of bank: PWM pair and the phase shifted module as in hal.h and CLLC.c */
+static double cllc_target(const plant_t *plant, uint16_t bank)
+{
+    uint32_t pair = (bank == HOST_BANK_LOW) ? QABPWM_4_5_BASE : QABPWM_12_13_BASE;
+    uint32_t shifted = (bank == HOST_BANK_LOW) ? QABPWM_6_7_BASE : QABPWM_14_15_BASE;
+    const host_epwm_t *a = host_epwm(pair);
+    const host_epwm_t *b = host_epwm(shifted);
+    double counts;
+
+    if (!a->running || a->tripped || !b->running || b->tripped ||
+        (host_matrix_cell(bank) == 0) || (host_gpio(N_OE_POL) != 0)) {
+        return 0.0;
+    }
+    counts = (double)(b->period / 2) - (double)b->phase;
+    return plant->cfg.cllcCurrent * fmin(fmax(counts, 0.0), 1.0);
+}
+
+/*
+ * One step of h with the BEG switch states fixed. The bus carries the
+ * inductor current while the high side switch or diode conducts.
+ */
+static void integrate(plant_t *plant, double h, bool high, bool low)
+{
+    const plant_config_t *cfg = &plant->cfg;
+    double vbank = plant_vstore(plant);
+    double r = cfg->rl + PLANT_CELLS * cfg->cellEsr;
+    double il = plant->il;
+    double vsw;
+    double slope;
+    double charge;                  /* into the bank */
+    bool highSide;                  /* inductor current flows from the bus */
+    double ibus;
+
+    if (high && low) {
+        plant->shootThroughs++;
+        high = false;
+    }
+
+    if (high || low) {
+        vsw = high ? plant->vbus : 0.0;
+        highSide = high;
+    } else if (il > 0.0) {
+        vsw = -cfg->vdiode;
+        highSide = false;
+    } else if ((il < 0.0) || (vbank > plant->vbus + cfg->vdiode)) {
+        vsw = plant->vbus + cfg->vdiode;
+        highSide = true;
+    } else {
+        vsw = vbank;                /* switch node floats, no current */
+        highSide = false;
+    }
+
+    slope = (vsw - vbank - r * il) / cfg->inductance;
+    if (!high && !low && (il != 0.0) && ((il > 0.0) != (il + slope * h > 0.0))) {
+        /* diode current reaches zero within the step and stays there */
+        charge = 0.5 * il * (-il / slope);
+        plant->il = 0.0;
+    } else {
+        charge = (il + 0.5 * slope * h) * h;
+        plant->il = il + slope * h;
+    }
+
+    /* input source through Qinb, inrush limiter in parallel */
+    plant->iin = 0.0;
+    if (host_gpio(Qinb) && (cfg->vin > plant->vbus)) {
+        plant->iin = fmin((cfg->vin - plant->vbus) / cfg->rin, cfg->iinMax);
+    }
+    if (cfg->vin > plant->vbus) {
+        plant->iin += host_epwm_duty(InrushCurrentLimit_BASE, EPWM_AQ_OUTPUT_B) * (cfg->vin - plant->vbus) / cfg->rinrush;
+    }
+
+    /* constant current load, folding back on a collapsed bus */
+    plant->iloadNow = 0.0;
+    if (host_gpio(Qlb)) {
+        plant->iloadNow = cfg->iload * fmin(plant->vbus / 20.0, 1.0);
+    }
+
+    ibus = plant->iin - plant->iloadNow - (highSide ? charge / h : 0.0);
+    plant->vbus = fmax(plant->vbus + h * ibus / cfg->cbus, 0.0);
+
+    for (int i = 0; i < PLANT_CELLS; i++) {
+        plant->cellV[i] += charge / plant->cellC[i];
+    }
+
+    for (uint16_t bank = HOST_BANK_LOW; bank <= HOST_BANK_HIGH; bank++) {
+        uint16_t cellNr = host_matrix_cell(bank);
+
+        plant->icllc[bank] = filter(plant->icllc[bank], cllc_target(plant, bank), cfg->cllcTau, h);
+        if (cellNr != 0) {
+            plant->cellV[cell_index(cellNr)] -= plant->icllc[bank] * h / plant->cellC[cell_index(cellNr)];
+        }
+    }
+}
+
+static void sense(plant_t *plant, double h)
+{
+    const plant_config_t *cfg = &plant->cfg;
+
+    plant->ilSense = filter(plant->ilSense, plant->il, cfg->sensorTau, h);
+    plant->iloadSense = filter(plant->iloadSense, plant->iloadNow, cfg->sensorTau, h);
+    plant->iinSense = filter(plant->iinSense, plant->iin, cfg->sensorTau, h);
+    plant->vbusSense = filter(plant->vbusSense, plant->vbus, cfg->sensorTau, h);
+    plant->vstoreSense = filter(plant->vstoreSense,
+                                plant_vstore(plant) + plant->il * PLANT_CELLS * cfg->cellEsr, cfg->sensorTau, h);
+
+    for (uint16_t bank = HOST_BANK_LOW; bank <= HOST_BANK_HIGH; bank++) {
+        uint16_t cellNr = host_matrix_cell(bank);
+        double reading = 0.0;
+
+        /* the matrix puts odd cells on the sense amplifier reversed */
+        if (cellNr != 0) {
+            reading = plant->cellV[cell_index(cellNr)];
+            if (cellNr & 1) {
+                reading = -reading;
+            }
+        }
+        plant->cellSense[bank] = filter(plant->cellSense[bank], reading, cfg->cellSenseTau, h);
+        plant->icllcSense[bank] = filter(plant->icllcSense[bank], plant->icllc[bank], cfg->sensorTau, h);
+    }
+}
+
+/* advances the plant by dt, cutting the steps at the BEG time base events */
+void plant_step(plant_t *plant, double dt)
+{
+    const host_epwm_t *beg = host_epwm(BEG_1_2_BASE);
+
+    while (dt > 1e-12) {
+        double periodCounts = (double)beg->period + 1.0;
+        double next = periodCounts;
+        double h;
+        uint16_t count;
+        bool high, low;
+
+        if (plant->begCount >= periodCounts) {
+            plant->begCount = 0.0;
+        }
+        for (int i = 0; i < 3; i++) {
+            double event = (i < 2) ? beg->compare[i] : beg->period;
+
+            if ((event > plant->begCount) && (event < next)) {
+                next = event;
+            }
+        }
+
+        h = fmin(fmin(dt, PLANT_MAX_STEP), (next - plant->begCount) / HOST_TBCLK_HZ);
+        count = (uint16_t)plant->begCount;
+        high = host_epwm_output(BEG_1_2_BASE, EPWM_AQ_OUTPUT_A, count);
+        low = host_epwm_output(BEG_1_2_BASE, EPWM_AQ_OUTPUT_B, count);
+
+        integrate(plant, h, high, low);
+        sense(plant, h);
+
+        plant->begCount += h * HOST_TBCLK_HZ;
+        if (plant->begCount > next - 1e-6) {
+            plant->begCount = (next >= periodCounts) ? 0.0 : next;
+        }
+        plant->t += h;
+        dt -= h;
+    }
+}
+
+static uint16_t adc_counts(plant_t *plant, double volts)
+{
+    double counts = volts / ADC_REFERENCE * ADC_MAX_COUNTS;
+
+    plant->noise = plant->noise * 1103515245u + 12345u;
+    counts += (double)((int32_t)((plant->noise >> 16) % (2 * NOISE_COUNTS + 1)) - NOISE_COUNTS);
+    return (uint16_t)fmin(fmax(counts, 0.0), ADC_MAX_COUNTS);
+}
+
+static uint16_t adc_counts_differential(plant_t *plant, double volts)
+{
+    return adc_counts(plant, (volts / ADC_REFERENCE + 1.0) / 2.0 * ADC_REFERENCE);
+}
+
+/* converts the sensor outputs into the ADC results the ISRs read */
+void plant_sample(plant_t *plant)
+{
+    host_adc_set(ADCARESULT_BASE, ADC_SOC_NUMBER0, adc_counts_differential(plant, plant->vbusSense / BUS_DIVIDER));
+    host_adc_set(ADCARESULT_BASE, ADC_SOC_NUMBER1, adc_counts_differential(plant, plant->vstoreSense / BUS_DIVIDER));
+    host_adc_set(ADCBRESULT_BASE, ADC_SOC_NUMBER0, adc_counts(plant, ISEN2_OFFSET + 0.05 * plant->ilSense));
+    host_adc_set(ADCBRESULT_BASE, ADC_SOC_NUMBER1, adc_counts(plant, IF_1_OFFSET - 0.05 * plant->iinSense));
+    host_adc_set(ADCCRESULT_BASE, ADC_SOC_NUMBER0, adc_counts(plant, ISEN1_OFFSET - 0.05 * plant->iloadSense));
+    host_adc_set(ADCDRESULT_BASE, ADC_SOC_NUMBER0, adc_counts(plant, V_DWN_OFFSET + plant->cellSense[HOST_BANK_LOW] / 9.3));
+    host_adc_set(ADCDRESULT_BASE, ADC_SOC_NUMBER1, adc_counts(plant, V_UP_OFFSET + plant->cellSense[HOST_BANK_HIGH] / 9.3));
+    host_adc_set(ADCDRESULT_BASE, ADC_SOC_NUMBER2, adc_counts(plant, I_DAB2_OFFSET + 0.2 * plant->icllcSense[HOST_BANK_LOW]));
+    host_adc_set(ADCDRESULT_BASE, ADC_SOC_NUMBER3, adc_counts(plant, I_DAB3_OFFSET + 0.2 * plant->icllcSense[HOST_BANK_HIGH]));
+}
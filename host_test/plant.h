@@ -0,0 +1,69 @@
+/*
+ * plant.h - numerical model of the DPMU power stage for plant_sim
+ *
+ *  DC bus capacitor fed by the input source through Qinb or the inrush
+ *  limiter and loaded through Qlb, the buck/boost stage between the bus and
+ *  the bank, the 30 supercap cells in series and the CLLC that discharges
+ *  one cell of a bank while balancing. See plant.c.
+ */
+
+#ifndef HOST_PLANT_H_
+#define HOST_PLANT_H_
+
+#include <stdint.h>
+
+#define PLANT_CELLS         30
+#define PLANT_MAX_STEP      2e-6        /* s, longest integration step */
+
+typedef struct plant_config {
+    double vin;                 /* V, input source */
+    double rin;                 /* ohm, input source and Qinb */
+    double iinMax;              /* A, input source current limit */
+    double rinrush;             /* ohm, inrush limiter */
+    double cbus;                /* F, DC bus */
+    double inductance;          /* H, buck/boost inductor */
+    double rl;                  /* ohm, inductor and switches */
+    double vdiode;              /* V, body diode */
+    double cellCapacitance;     /* F, nominal, see plant_init() for the spread */
+    double cellEsr;             /* ohm, per cell */
+    double cellVoltage;         /* V, initial voltage of every cell */
+    double iload;               /* A, constant current load behind Qlb */
+    double cllcCurrent;         /* A, CLLC discharge current per count of phase shift off 180 deg */
+    double cllcTau;             /* s, CLLC current response */
+    double sensorTau;           /* s, anti alias filter of the current and bus voltage sensors */
+    double cellSenseTau;        /* s, cell voltage sense behind the switch matrix */
+} plant_config_t;
+
+typedef struct plant {
+    plant_config_t cfg;
+    double t;                   /* s */
+    double vbus;
+    double il;                  /* A, inductor current, positive into the bank */
+    double iin;                 /* A, input source and inrush limiter */
+    double iloadNow;            /* A, load current drawn */
+    double cellC[PLANT_CELLS];
+    double cellV[PLANT_CELLS];
+    double icllc[2];            /* A, discharge current of the low and high bank CLLC */
+    double begCount;            /* BEG time base counter */
+    uint32_t shootThroughs;     /* steps with both BEG switches on */
+    uint32_t noise;
+
+    /* sensor front end filter states */
+    double ilSense;
+    double iloadSense;
+    double iinSense;
+    double vbusSense;
+    double vstoreSense;
+    double cellSense[2];        /* V_Dwnf (low bank), V_Upf (high bank) */
+    double icllcSense[2];
+} plant_t;
+
+void plant_default_config(plant_config_t *config);
+void plant_init(plant_t *plant, const plant_config_t *config);
+void plant_step(plant_t *plant, double dt);
+void plant_sample(plant_t *plant);
+double plant_vstore(const plant_t *plant);
+double plant_cell_min(const plant_t *plant);
+double plant_cell_max(const plant_t *plant);
+
+#endif /* HOST_PLANT_H_ */
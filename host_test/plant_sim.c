@@ -0,0 +1,474 @@
+/*
+ * plant_sim.c - CPU2 control firmware against a model of the power stage
+ *
+ *  Runs the CPU2 state machine, sensors.c, DCDC.c, CLLC.c and balancing.c
+ *  on the host. The driverlib calls go to the register model in cpu2/, the
+ *  model in plant.c turns the PWM outputs and switch pins into bus, inductor
+ *  and cell voltages and currents and writes them to the ADC results.
+ *
+ *  Every SM_FAST_TICK_US the plant is integrated, the ADC ISRs run with
+ *  INT_ADCINB_4_ISR last as on target, the CPU timer ISR runs once a
+ *  millisecond and the super loop makes one pass. A scripted CPU1 requests
+ *  the states of a charge and discharge cycle:
+ *
+ *      Initialize -> Softstart -> Idle -> TrickleChargeInit -> ... -> Charge
+ *      -> Balancing -> ... -> ChargeStop -> Idle, load on -> RegulateInit
+ *      -> Regulate, input drops -> RegulateVoltage, load off
+ *      -> RegulateVoltageWait
+ *
+ *  At the end the tick cost of the fast and the slow rate, the per state
+ *  cost and the transient metrics (settling, overshoot, time-to-charge) of
+ *  control_profile.c are printed. The exit status is not zero if a step of
+ *  the cycle is not reached in time or the state machine ends up in Fault.
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu2_hal.h"
+#include "plant.h"
+
+#include "common.h"
+#include "control_profile.h"
+#include "cpu2_log.h"
+#include "dcbus.h"
+#include "DCDC.h"
+#include "debug_log.h"
+#include "energy_storage.h"
+#include "error_handling.h"
+#include "GlobalV.h"
+#include "hal.h"
+#include "sensors.h"
+#include "shared_variables.h"
+#include "state_machine.h"
+#include "switches.h"
+#include "timer.h"
+
+#define FAST_TICK_S         (SM_FAST_TICK_US * 1e-6)
+#define SLOW_TICK_S         (FAST_TICK_S * SM_SLOW_TASK_DIVIDER)
+#define SYSCLK_PER_TICK     ((uint64_t)(SM_FAST_TICK_US * HOST_SYSCLK_PER_US))
+#define EFUSE_BB_TRIP       DPMU_SUPERCAP_SHORT_CIRCUIT_CURRENT
+#define EFUSE_BB_RELEASE    (DPMU_SUPERCAP_SHORT_CIRCUIT_CURRENT / 2)
+
+/* CPU1 settings, the defaults of the object dictionary */
+#define SIM_BUS_TARGET      180.0
+#define SIM_BUS_MIN         167.0
+#define SIM_BUS_MAX         193.0
+#define SIM_VIN_LOST        150.0       /* V, input source voltage after the drop */
+#define SIM_SETTLE          0.3         /* s, in Regulate and RegulateVoltage before the next step */
+
+/* main.c */
+volatile uint16_t efuse_top_half_flag = 0;
+
+typedef enum sim_phase {
+    SIM_INITIALIZE = 0,
+    SIM_CHARGE,
+    SIM_REGULATE,
+    SIM_INPUT_LOST,
+    SIM_LOAD_OFF,
+    SIM_DONE
+} sim_phase_t;
+
+static const char * const simPhaseNames[] = {
+    "Idle after Initialize",
+    "Idle after ChargeStop",
+    "Regulate",
+    "RegulateVoltage",
+    "RegulateVoltageWait",
+    "done"
+};
+
+static plant_t plant;
+static sim_phase_t phase = SIM_INITIALIZE;
+static double phaseStart;
+static bool chargeSeen;
+static bool balancingSeen;
+static bool verbose;
+static double loadCurrent = 6.0;
+static uint32_t logRecords;
+static uint32_t efuseEvents;
+
+static const char *state_name(uint16_t state)
+{
+    switch (state) {
+    case Idle:                      return "Idle";
+    case Initialize:                return "Initialize";
+    case SoftstartInitDefault:      return "SoftstartInitDefault";
+    case SoftstartInitRedundant:    return "SoftstartInitRedundant";
+    case Softstart:                 return "Softstart";
+    case TrickleChargeInit:         return "TrickleChargeInit";
+    case TrickleChargeDelay:        return "TrickleChargeDelay";
+    case TrickleCharge:             return "TrickleCharge";
+    case ChargeInit:                return "ChargeInit";
+    case Charge:                    return "Charge";
+    case ChargeStop:                return "ChargeStop";
+    case ChargeConstantVoltageInit: return "ChargeConstantVoltageInit";
+    case ChargeConstantVoltage:     return "ChargeConstantVoltage";
+    case RegulateInit:              return "RegulateInit";
+    case Regulate:                  return "Regulate";
+    case RegulateStop:              return "RegulateStop";
+    case RegulateVoltageInit:       return "RegulateVoltageInit";
+    case RegulateVoltage:           return "RegulateVoltage";
+    case RegulateVoltageStop:       return "RegulateVoltageStop";
+    case RegulateVoltageWait:       return "RegulateVoltageWait";
+    case EmergencyStop:             return "EmergencyStop";
+    case Fault:                     return "Fault";
+    case FaultDelay:                return "FaultDelay";
+    case BalancingInit:             return "BalancingInit";
+    case Balancing:                 return "Balancing";
+    case BalancingStop:             return "BalancingStop";
+    case CC_Charge:                 return "CC_Charge";
+    case StopEPWMs:                 return "StopEPWMs";
+    case ChargeRamp:                return "ChargeRamp";
+    case DischargeVBUSToSupercap:   return "DischargeVBUSToSupercap";
+    case WaitDPMUSafeCondition:     return "WaitDPMUSafeCondition";
+    case PreInitialized:            return "PreInitialized";
+    default:                        return "?";
+    }
+}
+
+/* what CPU1 sets up from the object dictionary before the cores sync */
+static void cpu1_settings(void)
+{
+    memset(&sharedVars_cpu1toCpu2, 0, sizeof(sharedVars_cpu1toCpu2));
+    sharedVars_cpu1toCpu2.iop_operation_request_state = PreInitialized;
+    sharedVars_cpu1toCpu2.max_allowed_dc_bus_voltage = SIM_BUS_MAX;
+    sharedVars_cpu1toCpu2.target_voltage_at_dc_bus = SIM_BUS_TARGET;
+    sharedVars_cpu1toCpu2.min_allowed_dc_bus_voltage = SIM_BUS_MIN;
+    sharedVars_cpu1toCpu2.vdc_bus_short_circuit_limit = 30.0;
+    sharedVars_cpu1toCpu2.max_allowed_load_power = 3000.0;
+    sharedVars_cpu1toCpu2.available_power_budget_dc_input = 1000.0;
+    sharedVars_cpu1toCpu2.max_voltage_applied_to_energy_bank = MAX_VOLTAGE_ENERGY_BANK;
+    sharedVars_cpu1toCpu2.safety_threshold_state_of_charge = 40.0;
+    sharedVars_cpu1toCpu2.min_voltage_applied_to_energy_bank = 30.0;
+    sharedVars_cpu1toCpu2.max_allowed_voltage_energy_cell = MAX_VOLTAGE_ENERGY_CELL;
+    sharedVars_cpu1toCpu2.constant_voltage_threshold = 85.0;
+    sharedVars_cpu1toCpu2.min_allowed_voltage_energy_cell = 1.0;
+    sharedVars_cpu1toCpu2.preconditional_threshold = 20.0;
+    sharedVars_cpu1toCpu2.ess_current = 3.0;
+    sharedVars_cpu1toCpu2.dpmu_default_flag = true;
+    sharedVars_cpu1toCpu2.DPMUAppInfoInitializedFlag = true;
+    sharedVars_cpu1toCpu2.supercap_short_circuit_current = DPMU_SUPERCAP_SHORT_CIRCUIT_CURRENT;
+    sharedVars_cpu1toCpu2.input_short_circuit_current = DPMU_SHORT_CIRCUIT_CURRENT;
+    sharedVars_cpu1toCpu2.output_short_circuit_current = DPMU_SHORT_CIRCUIT_CURRENT;
+}
+
+/* CPU1 requesting a state through the IOP */
+static void cpu1_request_state(uint16_t state)
+{
+    if (verbose)
+        printf("%10.4f  request %s\n", plant.t, state_name(state));
+    sharedVars_cpu1toCpu2.iop_operation_request_state = state;
+    host_ipc_set_flags(IPC_IOP_REQUEST_CHANGE_OF_STATE);
+}
+
+/* CPU1 side of the debug ring, see cpu2_log_print() of CPU1 */
+static void cpu1_drain_log(void)
+{
+    uint16_t tail = sharedVars_cpu1toCpu2.cpu2_log_tail;
+
+    CPU2_LOG_BARRIER();
+    while (tail != cpu2_log_ring.head) {
+        uint16_t id = cpu2_log_ring.buffer[tail & CPU2_LOG_RING_MASK];
+        uint16_t len = cpu2_log_ring.buffer[(tail + 1) & CPU2_LOG_RING_MASK];
+
+        if (verbose && (id == CPU2_LOG_TEXT)) {
+            char text[2 * CPU2_LOG_RING_SIZE + 1];
+            uint16_t i;
+
+            for (i = 0; i < len; i++) {
+                uint16_t word = cpu2_log_ring.buffer[(tail + CPU2_LOG_HEADER_WORDS + i) & CPU2_LOG_RING_MASK];
+                text[2 * i] = (char)(word & 0xFF);
+                text[2 * i + 1] = (char)(word >> 8);
+            }
+            text[2 * len] = '\0';
+            printf("%10.4f  cpu2: %s", plant.t, text);
+        } else if (verbose) {
+            printf("%10.4f  cpu2: event %u\n", plant.t, id);
+        }
+        tail += CPU2_LOG_HEADER_WORDS + len;
+        logRecords++;
+    }
+    sharedVars_cpu1toCpu2.cpu2_log_tail = tail;
+}
+
+/* handle_top_half_interrupts() of main.c, without the IPC message to CPU1 */
+static void handle_top_half_interrupts(void)
+{
+    if (efuse_top_half_flag == true) {
+        efuseEvents++;
+        efuse_top_half_flag = false;
+    }
+
+    if (eFuseInputCurrentOcurred == true) {
+        handleEfuseVinOccurence();
+    }
+
+    if (eFuseBuckBoostOcurred == true) {
+        handleEFuseBBOccurence();
+    }
+}
+
+/* one pass of the super loop of main.c */
+static void super_loop(void)
+{
+    handle_top_half_interrupts();
+    timerq_tick();
+    VerifyDPMUSwitchesOK();
+    dcbus_update_settings();
+    dcbus_check();
+    energy_storage_update_settings();
+    energy_storage_check();
+    UpdateDebugLog();
+    StateMachineScheduler();
+    CheckMainStateMachineIsRunning();
+    cpu2_log_poll();
+}
+
+static void phase_next(sim_phase_t next)
+{
+    printf("%10.4f  %-22s reached, Vbus %6.2f V, Vstore %6.2f V, cells %4.2f..%4.2f V\n",
+           plant.t, simPhaseNames[phase], plant.vbus, plant_vstore(&plant),
+           plant_cell_min(&plant), plant_cell_max(&plant));
+    phase = next;
+    phaseStart = plant.t;
+}
+
+/* the scripted CPU1 and the changes of the plant around it */
+static void scenario(uint16_t state)
+{
+    switch (phase) {
+    case SIM_INITIALIZE:
+        if ((state == Idle) && DPMUInitialized()) {
+            phase_next(SIM_CHARGE);
+            cpu1_request_state(TrickleChargeInit);
+        }
+        break;
+
+    case SIM_CHARGE:
+        if (state == Balancing)
+            balancingSeen = true;
+        if (state != Idle)
+            chargeSeen = true;
+        else if (chargeSeen) {
+            phase_next(SIM_REGULATE);
+            plant.cfg.iload = loadCurrent;
+            cpu1_request_state(RegulateInit);
+        }
+        break;
+
+    case SIM_REGULATE:
+        if ((state == Regulate) && (plant.t - phaseStart > SIM_SETTLE)) {
+            phase_next(SIM_INPUT_LOST);
+            plant.cfg.vin = SIM_VIN_LOST;
+        }
+        break;
+
+    case SIM_INPUT_LOST:
+        if (state != RegulateVoltage) {
+            phaseStart = plant.t;
+        } else if (plant.t - phaseStart > SIM_SETTLE) {
+            phase_next(SIM_LOAD_OFF);
+            plant.cfg.iload = 0.0;
+        }
+        break;
+
+    case SIM_LOAD_OFF:
+        if (state == RegulateVoltageWait)
+            phase_next(SIM_DONE);
+        break;
+
+    case SIM_DONE:
+        break;
+    }
+}
+
+static void print_transient(uint16_t state)
+{
+    static const uint16_t tracked[CP_NumOfTrackedStates] = {
+        ChargeRamp, Charge, Regulate, RegulateVoltage
+    };
+    int i;
+
+    for (i = 0; i < CP_NumOfTrackedStates; i++) {
+        const ControlTransient_t *tr = &controlProfile.transient[i];
+
+        if (tracked[i] != state)
+            continue;
+        printf("%10.4f  left %-15s %8.4f s, settled %8.4f s, ref %7.2f, peak %7.2f, overshoot %6.2f %%\n",
+               plant.t, state_name(state), tr->durationTicks * SLOW_TICK_S,
+               tr->settlingTicks * SLOW_TICK_S, tr->reference, tr->peak, tr->overshootPercent);
+    }
+}
+
+static double cycles_us(double cycles)
+{
+    return cycles / HOST_SYSCLK_PER_US;
+}
+
+static void print_report(void)
+{
+    static const char * const rateNames[CP_NumOfRates] = { "fast", "slow" };
+    static const char * const trackedNames[CP_NumOfTrackedStates] = {
+        "ChargeRamp", "Charge", "Regulate", "RegulateVoltage"
+    };
+    const state_machine_stats_t *stats = &sharedVars_cpu2toCpu1.state_machine_stats;
+    int i;
+
+    printf("\nrate  ticks      mean us   min us    max us    period us  overruns\n");
+    for (i = 0; i < CP_NumOfRates; i++) {
+        const ControlTickCost_t *cost = &controlProfile.rate[i];
+
+        printf("%-5s %-10u %-9.3f %-9.3f %-9.3f %-10.3f %u\n", rateNames[i],
+               (unsigned)cost->tickCount,
+               cost->tickCount ? cycles_us((double)cost->sumCycles / cost->tickCount) : 0.0,
+               cycles_us(cost->minCycles), cycles_us(cost->maxCycles),
+               cycles_us(cost->lastPeriodCycles), (unsigned)cost->overruns);
+    }
+
+    printf("\nstate                      entries  s         mean us   max us\n");
+    for (i = 0; i < stats->numOfStates; i++) {
+        const sm_state_stats_t *st = &stats->state[i];
+
+        if (st->entries == 0)
+            continue;
+        printf("%-26s %-8u %-9.3f %-9.3f %.3f\n", state_name(st->state), (unsigned)st->entries,
+               st->ticks * SLOW_TICK_S, cycles_us(st->meanCycles), cycles_us(st->maxCycles));
+    }
+
+    printf("\ntransition                                         count\n");
+    for (i = 0; i < stats->numOfTransitions; i++) {
+        const sm_transition_stats_t *tr = &stats->transition[i];
+        char name[64];
+
+        if (tr->count == 0)
+            continue;
+        snprintf(name, sizeof(name), "%s -> %s", state_name(tr->from), state_name(tr->to));
+        printf("%-50s %u\n", name, (unsigned)tr->count);
+    }
+    printf("forced transitions %u\n", (unsigned)stats->forcedTransitions);
+
+    printf("\nlast transient   entries  s         settled s  ref      peak     overshoot %%\n");
+    for (i = 0; i < CP_NumOfTrackedStates; i++) {
+        const ControlTransient_t *tr = &controlProfile.transient[i];
+
+        printf("%-16s %-8u %-9.4f %-10.4f %-8.2f %-8.2f %.2f\n", trackedNames[i],
+               (unsigned)tr->entries, tr->durationTicks * SLOW_TICK_S,
+               tr->settlingTicks * SLOW_TICK_S, tr->reference, tr->peak, tr->overshootPercent);
+    }
+    printf("time to charge %.4f s%s\n", controlProfile.timeToChargeTicks * SLOW_TICK_S,
+           controlProfile.chargeInProgress ? " (charging)" : "");
+
+    printf("\nlog records %u, dropped %u, eFuse events %u, BEG shoot throughs %u\n",
+           (unsigned)logRecords, (unsigned)cpu2_log_ring.dropped, (unsigned)efuseEvents,
+           (unsigned)plant.shootThroughs);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-C farad] [-V volt] [-l ampere] [-t seconds] [-v]\n"
+            "  -C  nominal cell capacitance (default 50 F)\n"
+            "  -V  initial cell voltage (default 0.5 V)\n"
+            "  -l  load current while regulating (default 6 A)\n"
+            "  -t  simulated time limit (default 120 s)\n"
+            "  -v  print requests, CPU2 log records and every state change\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    plant_config_t config;
+    double limit = 120.0;
+    uint64_t tick;
+    uint16_t state;
+    double nextMs = 1e-3;
+    bool efuseLatched = false;
+    bool failed;
+    int opt;
+
+    plant_default_config(&config);
+    while ((opt = getopt(argc, argv, "C:V:l:t:vh")) != -1) {
+        switch (opt) {
+        case 'C': config.cellCapacitance = atof(optarg); break;
+        case 'V': config.cellVoltage = atof(optarg); break;
+        case 'l': loadCurrent = atof(optarg); break;
+        case 't': limit = atof(optarg); break;
+        case 'v': verbose = true; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    plant_init(&plant, &config);
+
+    /* the start up of main.c */
+    cpu1_settings();
+    timerq_init();
+    cpu2_log_init();
+    Board_init();
+    HAL_StopPwmDCDC();
+    HAL_StopPwmInrushCurrentLimit();
+    StateMachineInit();
+    DCDCConverterInit();
+    HAL_StartPwmCounters();
+    InitializeSensorParameters();
+
+    cpu1_request_state(Initialize);
+    state = StateVector.State_Current;
+
+    for (tick = 1; (phase != SIM_DONE) && (plant.t < limit); tick++) {
+        plant_step(&plant, FAST_TICK_S);
+        plant_sample(&plant);
+        host_sysclk_set(tick * SYSCLK_PER_TICK);
+
+        INT_ADCINA_2_ISR();
+        INT_ADCINC_1_ISR();
+        INT_ADCIND_3_ISR();
+        INT_ADCINB_4_ISR();
+
+        if (plant.t >= nextMs) {
+            nextMs += 1e-3;
+            INT_myCPUTIMER2_ISR();
+        }
+
+        if (!efuseLatched && (fabs(plant.il) > EFUSE_BB_TRIP)) {
+            efuseLatched = true;
+            INT_eFuseBB_XINT_ISR();
+        } else if (efuseLatched && (fabs(plant.il) < EFUSE_BB_RELEASE)) {
+            efuseLatched = false;
+        }
+
+        super_loop();
+        cpu1_drain_log();
+
+        if (StateVector.State_Current != state) {
+            print_transient(state);
+            if (verbose)
+                printf("%10.4f  %s -> %s\n", plant.t, state_name(state),
+                       state_name(StateVector.State_Current));
+            state = StateVector.State_Current;
+        }
+        if ((state == Fault) || (state == EmergencyStop))
+            break;
+
+        scenario(state);
+    }
+
+    print_report();
+
+    failed = (phase != SIM_DONE);
+    if (failed)
+        printf("\nFAILED: %s not reached, state %s after %.4f s\n", simPhaseNames[phase],
+               state_name(state), plant.t);
+    else if (!balancingSeen)
+        printf("\nbalancing did not run, no cell reached the threshold\n");
+    if (!failed)
+        printf("\ncycle done after %.4f s\n", plant.t);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * test_balancing.c - the balancing planner of balancing.c
+ *
+ *  BalancingAllCells() and the cell voltage scanner run every slow count as
+ *  in StateMachine(), on a bank where the CLLC takes charge out of the cell
+ *  it is started on at a rate of its own, the same in every trial, and the
+ *  sense paths are an RC on the connected cell. Random bank imbalances have to end with every cell
+ *  under the high threshold, the worst cell discharged first, two whole bank
+ *  scans per balancing and in less time than the fixed 5 s windows with a
+ *  rescan of the bank after each of them took on the same bank.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "cpu2_hal.h"
+
+#include "balancing.h"
+#include "CLLC.h"
+#include "energy_storage.h"
+#include "sensors.h"
+#include "shared_variables.h"
+#include "state_machine.h"
+#include "switch_matrix.h"
+#include "timer.h"
+
+#define COUNT_US        (SM_FAST_TICK_US * SM_SLOW_TASK_DIVIDER)
+#define SENSE_TAU_US    100.0
+#define RATE            2e-5        /* V/ms, about 1 A out of 50 F */
+#define FIXED_WINDOW    5000.0      /* ms */
+#define TRIALS          5
+
+static double cellV[NUMBER_OF_CELLS];
+static double cellRate[NUMBER_OF_CELLS];
+static float sense[2];
+static double timerUs;
+static float cellVoltagesVector[NUMBER_OF_CELLS];
+
+static uint16_t cell_index(uint16_t cellNr)
+{
+    return (cellNr <= BAT_15) ? cellNr - 1 : cellNr - 2;
+}
+
+/* one slow count of the CLLC discharge, the sense paths and the ms timer */
+static void step(void)
+{
+    double k = 1.0 - exp(-COUNT_US / SENSE_TAU_US);
+
+    if (CllcControlLoopActive()) {
+        uint16_t idx = cell_index(CllcControlLoopCellNr());
+
+        cellV[idx] -= cellRate[idx] * COUNT_US / 1000.0;
+    }
+    for (uint16_t bank = HOST_BANK_LOW; bank <= HOST_BANK_HIGH; bank++) {
+        uint16_t cellNr = host_matrix_cell(bank);
+        float reading = 0;
+
+        if (cellNr != 0 && !CllcControlLoopActive()) {
+            reading = (cellNr & 1) ? -cellV[cell_index(cellNr)] : cellV[cell_index(cellNr)];
+        }
+        sense[bank] += (reading - sense[bank]) * k;
+    }
+    sensorVector[V_DwnfIdx].realValue = sense[HOST_BANK_LOW];
+    sensorVector[V_UpfIdx].realValue = sense[HOST_BANK_HIGH];
+
+    CounterGroup.StateMachineCounter++;
+    for (timerUs += COUNT_US; timerUs >= 1000.0; timerUs -= 1000.0) {
+        INT_myCPUTIMER2_ISR();
+    }
+}
+
+/* how long the fixed windows take on the bank, with a scan of scanMs after each */
+static double fixed_window_time(const double *v, double scanMs)
+{
+    double lowThreshold = energy_bank_settings.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_LOW_THRESHOLD;
+    double highThreshold = energy_bank_settings.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_HIGH_THRESHOLD;
+    double time = scanMs;
+
+    for (int i = 0; i < NUMBER_OF_CELLS; i++) {
+        if (v[i] >= highThreshold) {
+            double windows = ceil((v[i] - lowThreshold) / (cellRate[i] * FIXED_WINDOW));
+
+            time += windows * (FIXED_WINDOW + scanMs) + scanMs;
+        }
+    }
+    return time;
+}
+
+static void test_trial(int trial)
+{
+    double highThreshold = energy_bank_settings.max_allowed_voltage_energy_cell * CELL_VOLTAGE_RATIO_HIGH_THRESHOLD;
+    double initial[NUMBER_OF_CELLS];
+    uint32_t start = timer_get_ticks();
+    uint32_t scans = cellScanStats.scans;
+    uint32_t elapsed, projected = 0;
+    uint16_t worst = 0, first = BAT_0;
+    bool done = false;
+    double planner, fixed;
+
+    for (int i = 0; i < NUMBER_OF_CELLS; i++) {
+        cellV[i] = initial[i] = 2.6 + 0.35 * rand() / RAND_MAX;
+        if (cellV[i] > cellV[worst]) {
+            worst = i;
+        }
+    }
+    cellV[worst] = initial[worst] = 2.98;
+
+    while (!done && timer_get_ticks() - start < 3600000) {
+        step();
+        done = BalancingAllCells(cellVoltagesVector);
+        ReadCellVoltagesStateMachine(cellVoltagesVector, &(float){ 0 }, &(bool){ false });
+
+        if (first == BAT_0 && CllcControlLoopActive()) {
+            first = CllcControlLoopCellNr();
+            projected = balancingPlan.projectedTimeToBalance;
+        }
+    }
+    elapsed = timer_get_ticks() - start;
+
+    CHECK(done);
+    CHECK_EQ(cell_index(first), worst);
+    CHECK(projected > 0);
+    for (int i = 0; i < NUMBER_OF_CELLS; i++) {
+        CHECK(cellV[i] < highThreshold);
+        CHECK_NEAR(cellVoltagesVector[i], cellV[i], 0.005);
+    }
+
+    /* one scan to plan and one to verify, the windows read their cell only */
+    CHECK_EQ(cellScanStats.scans - scans, 2);
+    CHECK_EQ(balancingPlan.cellsToBalance, 0);
+    CHECK_EQ(balancingPlan.projectedTimeToBalance, 0);
+    CHECK_EQ(balancingPlan.cellNr, BAT_0);
+    CHECK(!CllcControlLoopActive());
+
+    planner = elapsed;
+    fixed = fixed_window_time(initial, cellScanStats.lastScanTime);
+    CHECK(planner < fixed);
+    /* the rates are known from the trials before */
+    if (trial > 1) {
+        CHECK_NEAR(projected, planner, 0.3 * planner);
+    }
+    printf("trial %d: %u windows, %.1f s, fixed windows %.1f s, projected at start %.1f s\n",
+           trial, (unsigned)balancingPlan.windows, planner / 1000, fixed / 1000, projected / 1000.0);
+}
+
+int main(void)
+{
+    srand(7);
+    timerq_init();
+    switch_matrix_reset();
+    energy_bank_settings.max_allowed_voltage_energy_cell = 3.0f;
+    sharedVars_cpu1toCpu2.max_allowed_voltage_energy_cell = 3.0f;
+    for (int i = 0; i < NUMBER_OF_CELLS; i++) {
+        cellRate[i] = RATE * (0.8 + 0.4 * rand() / RAND_MAX);
+    }
+
+    for (int trial = 1; trial <= TRIALS; trial++) {
+        test_trial(trial);
+    }
+
+    return check_report("test_balancing");
+}
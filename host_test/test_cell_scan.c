@@ -0,0 +1,225 @@
+/*
+ * test_cell_scan.c - the cell voltage scanner of balancing.c
+ *
+ *  The sense path of each bank is an RC that follows the cell the switch
+ *  matrix connects, odd cells reversed as the matrix puts them on the sense
+ *  amplifier. The scan has to read every cell within the settle tolerance,
+ *  with both banks connected at the same time, and in a fraction of the
+ *  counts of the fixed delay scan it replaced. With a sense path of about
+ *  1 ms, slow enough that a small change per count still leaves several mV
+ *  to come, and a timeout long enough for it, every cell has to be read
+ *  within the settle tolerance. With a sense path too slow to converge
+ *  every cell times out and is still read.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "check.h"
+#include "cpu2_hal.h"
+
+#include "balancing.h"
+#include "sensors.h"
+#include "shared_variables.h"
+#include "state_machine.h"
+#include "switch_matrix.h"
+#include "timer.h"
+
+/* the scanner settings of balancing.c */
+extern uint16_t NUMBER_OF_READ_ITERATIONS;
+extern uint16_t NCOUNTS_TO_STABLE_VOLTAGE;
+extern uint16_t NCOUNTS_SETTLE_MIN;
+extern float SETTLE_TOLERANCE_VOLTAGE;
+
+#define COUNT_US    (SM_FAST_TICK_US * SM_SLOW_TASK_DIVIDER)
+
+/* the fixed delay scan: one cell at a time, delay, samples and the step to the next cell */
+#define FIXED_DELAY_SCAN_COUNTS (NUMBER_OF_CELLS * (NCOUNTS_TO_STABLE_VOLTAGE + NUMBER_OF_READ_ITERATIONS + 2))
+
+static float cellV[NUMBER_OF_CELLS];
+static float sense[2];
+static double senseTau;     /* us */
+static double timerUs;
+static bool bothConnected;
+
+static uint16_t cell_index(uint16_t cellNr)
+{
+    return (cellNr <= BAT_15) ? cellNr - 1 : cellNr - 2;
+}
+
+/* one slow count of the sense paths and the ms timer */
+static void step(void)
+{
+    double k = 1.0 - exp(-COUNT_US / senseTau);
+
+    for (uint16_t bank = HOST_BANK_LOW; bank <= HOST_BANK_HIGH; bank++) {
+        uint16_t cellNr = host_matrix_cell(bank);
+        float reading = 0;
+
+        if (cellNr != 0) {
+            reading = (cellNr & 1) ? -cellV[cell_index(cellNr)] : cellV[cell_index(cellNr)];
+        }
+        sense[bank] += (reading - sense[bank]) * k;
+    }
+    sensorVector[V_DwnfIdx].realValue = sense[HOST_BANK_LOW];
+    sensorVector[V_UpfIdx].realValue = sense[HOST_BANK_HIGH];
+    sensorVector[VStoreIdx].realValue = 60.0f;
+
+    if (host_matrix_cell(HOST_BANK_LOW) != 0 && host_matrix_cell(HOST_BANK_HIGH) != 0) {
+        bothConnected = true;
+    }
+
+    CounterGroup.StateMachineCounter++;
+    for (timerUs += COUNT_US; timerUs >= 1000.0; timerUs -= 1000.0) {
+        INT_myCPUTIMER2_ISR();
+    }
+}
+
+static bool scan(float *voltages, float *bankVoltage, bool *overThreshold)
+{
+    for (int count = 0; count < 10 * FIXED_DELAY_SCAN_COUNTS; count++) {
+        step();
+        if (ReadCellVoltagesStateMachine(voltages, bankVoltage, overThreshold)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void test_scan(void)
+{
+    float voltages[NUMBER_OF_CELLS] = { 0 };
+    float bankVoltage = 0;
+    bool overThreshold = true;
+
+    for (int i = 0; i < NUMBER_OF_CELLS; i++) {
+        cellV[i] = 2.0f + 0.02f * i;
+    }
+    senseTau = 100.0;
+    sharedVars_cpu1toCpu2.max_allowed_voltage_energy_cell = 3.0f;
+    CellScanStatsReset();
+    EnableContinuousReadCellVoltages();
+
+    CHECK(scan(voltages, &bankVoltage, &overThreshold));
+    CHECK(ReadCellVoltagesDone());
+    for (int i = 0; i < NUMBER_OF_CELLS; i++) {
+        CHECK_NEAR(voltages[i], cellV[i], 2 * SETTLE_TOLERANCE_VOLTAGE);
+    }
+    CHECK_NEAR(bankVoltage, 60.0, 1e-4);
+    CHECK(!overThreshold);
+    CHECK(bothConnected);
+
+    /* the banks are left disconnected */
+    CHECK_EQ(host_matrix_cell(HOST_BANK_LOW), 0);
+    CHECK_EQ(host_matrix_cell(HOST_BANK_HIGH), 0);
+
+    CHECK_EQ(cellScanStats.scans, 1);
+    CHECK_EQ(cellScanStats.settleTimeouts, 0);
+    CHECK(cellScanStats.maxSettleCounts < NCOUNTS_TO_STABLE_VOLTAGE);
+    CHECK(cellScanStats.minSettleCounts >= NCOUNTS_SETTLE_MIN);
+    CHECK(cellScanStats.lastScanCounts * 2 < FIXED_DELAY_SCAN_COUNTS);
+    CHECK_NEAR(cellScanStats.lastScanTime, cellScanStats.lastScanCounts * COUNT_US / 1000.0, 1);
+    printf("cell scan %lu counts, fixed delay scan %u counts\n",
+           (unsigned long)cellScanStats.lastScanCounts, (unsigned)FIXED_DELAY_SCAN_COUNTS);
+
+    /* the next scan follows the cells, one over the high threshold */
+    cellV[22] = 2.95f;
+    CHECK(scan(voltages, &bankVoltage, &overThreshold));
+    CHECK_NEAR(voltages[22], 2.95, 2 * SETTLE_TOLERANCE_VOLTAGE);
+    CHECK(overThreshold);
+    CHECK_EQ(cellScanStats.scans, 2);
+    CHECK(cellScanStats.minScanCounts <= cellScanStats.maxScanCounts);
+
+    /* disabled, nothing moves */
+    DisableContinuousReadCellVoltages();
+    step();
+    CHECK(!ReadCellVoltagesStateMachine(voltages, &bankVoltage, &overThreshold));
+    CHECK_EQ(host_matrix_cell(HOST_BANK_LOW), 0);
+}
+
+static void test_slow_sense(void)
+{
+    float voltages[NUMBER_OF_CELLS] = { 0 };
+    float bankVoltage = 0, worst = 0;
+    bool overThreshold;
+    uint16_t timeout = NCOUNTS_TO_STABLE_VOLTAGE;
+
+    for (int i = 0; i < NUMBER_OF_CELLS; i++) {
+        cellV[i] = 2.0f + 0.02f * i;
+    }
+    /* 3 mV per count still leaves 16 mV to come, the 3.5 ms delay too short */
+    senseTau = 1000.0;
+    NCOUNTS_TO_STABLE_VOLTAGE = SM_CYCLES(5 * 200);
+    CellScanStatsReset();
+    EnableContinuousReadCellVoltages();
+
+    for (int pass = 0; pass < 2; pass++) {
+        CHECK(scan(voltages, &bankVoltage, &overThreshold));
+        for (int i = 0; i < NUMBER_OF_CELLS; i++) {
+            CHECK_NEAR(voltages[i], cellV[i], SETTLE_TOLERANCE_VOLTAGE);
+            worst = fmaxf(worst, fabsf(voltages[i] - cellV[i]));
+        }
+    }
+    CHECK_EQ(cellScanStats.settleTimeouts, 0);
+    CHECK(cellScanStats.lastScanCounts < FIXED_DELAY_SCAN_COUNTS);
+    printf("cell scan, 1 ms sense path: %lu counts, worst error %.2f mV\n",
+           (unsigned long)cellScanStats.lastScanCounts, worst * 1e3);
+
+    DisableContinuousReadCellVoltages();
+    NCOUNTS_TO_STABLE_VOLTAGE = timeout;
+}
+
+static void test_timeout(void)
+{
+    float voltages[NUMBER_OF_CELLS] = { 0 };
+    float bankVoltage = 0;
+    bool overThreshold;
+
+    /* about 5 mV per count at the end of the delay, never converged */
+    senseTau = 20000.0;
+    CellScanStatsReset();
+    EnableContinuousReadCellVoltages();
+
+    CHECK(scan(voltages, &bankVoltage, &overThreshold));
+    CHECK_EQ(cellScanStats.settleTimeouts, NUMBER_OF_CELLS);
+    CHECK_EQ(cellScanStats.minSettleCounts, NCOUNTS_TO_STABLE_VOLTAGE);
+    CHECK_EQ(cellScanStats.maxSettleCounts, NCOUNTS_TO_STABLE_VOLTAGE);
+    DisableContinuousReadCellVoltages();
+}
+
+static void test_single_cell(void)
+{
+    float voltages[NUMBER_OF_CELLS] = { 0 };
+    const uint16_t cells[] = { BAT_1, BAT_14, BAT_16, BAT_29 };
+    bool done;
+
+    senseTau = 100.0;
+    for (unsigned c = 0; c < sizeof(cells) / sizeof(cells[0]); c++) {
+        uint16_t idx = cell_index(cells[c]);
+
+        cellV[idx] = 2.5f + 0.1f * c;
+        done = false;
+        for (int count = 0; !done && count < 2 * NCOUNTS_TO_STABLE_VOLTAGE + 20; count++) {
+            step();
+            done = ReadSingleCellVoltageStateMachine(cells[c], voltages);
+        }
+        CHECK(done);
+        CHECK_NEAR(voltages[idx], cellV[idx], 2 * SETTLE_TOLERANCE_VOLTAGE);
+        CHECK_EQ(host_matrix_cell(HOST_BANK_LOW), 0);
+        CHECK_EQ(host_matrix_cell(HOST_BANK_HIGH), 0);
+    }
+}
+
+int main(void)
+{
+    timerq_init();
+    switch_matrix_reset();
+
+    test_scan();
+    test_slow_sense();
+    test_timeout();
+    test_single_cell();
+
+    return check_report("test_cell_scan");
+}
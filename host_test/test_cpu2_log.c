@@ -0,0 +1,321 @@
+/*
+ * test_cpu2_log.c - the CPU2 to CPU1 debug ring, cpu2_log.c and cpu2_log_reader.c
+ *
+ *  Both ends in one process: CPU2 writes with cpu2_log.c, CPU1 reads with
+ *  cpu2_log_reader.c, built against the CPU1 headers, and its serial output
+ *  ends up in Serial_printf() below, which checks the lines. First the ring
+ *  full, backlog, event latch and resync cases one step at a time, then the
+ *  super loop of CPU2, an interrupt posting events every sample period and
+ *  the super loop of CPU1 as three threads, which have to lose nothing that is not counted as
+ *  dropped and keep the order. The last one reports messages per second.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+
+#include "cpu2_log.h"
+#include "shared_variables.h"
+
+#define RUN_NS          500000000LL     /* of the threaded test */
+
+/*** the CLI serial port of CPU1 ***/
+
+struct Serial {
+    int unused;
+};
+struct Serial cli_serial;
+
+static struct {
+    uint32_t texts;
+    uint32_t events;
+    uint32_t dropped;           /* as reported by the reader */
+    uint32_t resyncs;
+    long lastText;
+    long lastEvent;
+    uint32_t outOfOrder;
+    uint32_t malformed;
+    char line[2 * CPU2_LOG_MAX_TEXT + 1];
+} cli;
+
+int Serial_printf(struct Serial *dev, const char *fmt, ...)
+{
+    unsigned long a, b;
+    float value;
+    long n;
+    va_list args;
+    int len;
+
+    (void)dev;
+    va_start(args, fmt);
+    len = vsnprintf(cli.line, sizeof(cli.line), fmt, args);
+    va_end(args);
+
+    if (sscanf(cli.line, "[cpu2 log: %lu records dropped]", &a) == 1) {
+        cli.dropped += a;
+    } else if (sscanf(cli.line, " written by CPU2: %lu, dropped: %lu", &a, &b) == 2) {
+        /* cpu2_log_print_stats() */
+    } else if (sscanf(cli.line, " forwarded: %lu, resyncs: %lu", &a, &b) == 2) {
+        cli.resyncs = b;
+    } else if (sscanf(cli.line, "msg %ld", &n) == 1) {
+        cli.outOfOrder += (n <= cli.lastText);
+        cli.lastText = n;
+        cli.texts++;
+    } else if (sscanf(cli.line, "[%lu] DCDC_VI.avgVBus[%f] max_allowed_dc_bus_voltage:[%lu", &a, &value, &b) == 3) {
+        cli.outOfOrder += ((long)value <= cli.lastEvent);
+        cli.lastEvent = (long)value;
+        cli.events++;
+    } else {
+        cli.malformed++;
+        fprintf(stderr, "unexpected line: %s\n", cli.line);
+    }
+    return len;
+}
+
+static void cli_reset(void)
+{
+    memset(&cli, 0, sizeof(cli));
+    cli.lastText = -1;
+    cli.lastEvent = -1;
+}
+
+static void start(void)
+{
+    cpu2_log_reader_init();
+    cpu2_log_init();
+    cpu2_log_set_deferred(false);
+    cli_reset();
+}
+
+static uint16_t drain(void)
+{
+    uint16_t records = 0, n;
+
+    do {
+        n = cpu2_log_process(CPU2_LOG_RECORDS_PER_POLL);
+        records += n;
+    } while (n != 0);
+    return records;
+}
+
+/*** one step at a time ***/
+
+static void test_ring_full(void)
+{
+    uint32_t written = 0;
+    char text[CPU2_LOG_MAX_TEXT + 1];
+
+    start();
+    memset(text, 'x', sizeof(text));
+    memcpy(text, "msg 1000", 8);
+
+    /* records of 4 + 4 words, the ring takes 128 of them */
+    while (cpu2_log_text("msg 0000", 8)) {
+        written++;
+    }
+    CHECK_EQ(written, CPU2_LOG_RING_SIZE / (CPU2_LOG_HEADER_WORDS + 4));
+    CHECK_EQ(cpu2_log_ring.dropped, 1);
+    CHECK_EQ(cpu2_log_ring.records, written);
+
+    /* CPU1 frees the ring and reports the drop */
+    CHECK_EQ(drain(), written);
+    CHECK_EQ(cli.texts, written);
+    CHECK_EQ(cli.dropped, 1);
+    CHECK(cpu2_log_text(text, CPU2_LOG_MAX_TEXT));
+    CHECK_EQ(drain(), 1);
+    CHECK_EQ(cli.texts, written + 1);
+    CHECK_EQ(cli.malformed, 0);
+}
+
+static void test_backlog(void)
+{
+    char text[32];
+    int lines = 256;
+
+    start();
+    cpu2_log_set_deferred(true);
+
+    /* twice the ring of text while a CLI command runs, nothing is lost */
+    for (int i = 0; i < lines; i++) {
+        int len = snprintf(text, sizeof(text), "msg %d\r\n", i);
+
+        CHECK(cpu2_log_text(text, len));
+    }
+    CHECK(cpu2_log_ring.head - sharedVars_cpu1toCpu2.cpu2_log_tail > CPU2_LOG_RING_SIZE - 16);
+
+    /* new text queues behind the backlog, it does not overtake it */
+    cpu2_log_set_deferred(false);
+    CHECK(cpu2_log_text("msg 256\r\n", 9));
+    lines++;
+    while (cli.texts < (uint32_t)lines) {
+        cpu2_log_poll();
+        if (drain() == 0) {
+            break;
+        }
+    }
+    CHECK_EQ(cli.texts, lines);
+    CHECK_EQ(cli.lastText, lines - 1);
+    CHECK_EQ(cli.outOfOrder, 0);
+    CHECK_EQ(cpu2_log_ring.dropped, 0);
+    CHECK_EQ(cli.malformed, 0);
+}
+
+static void test_latch(void)
+{
+    start();
+
+    /* an event posted again before the poll is counted as dropped */
+    CPU2_LOG_EVENT(CPU2_LOG_BUS_OVER_VOLTAGE, cpu2_log_float(7.0f), cpu2_log_float(0.0f));
+    CHECK(!cpu2_log_event(CPU2_LOG_BUS_OVER_VOLTAGE, (const uint32_t[]){ 0, 0 }, 2));
+    CHECK(!cpu2_log_event(CPU2_LOG_NUM_OF_IDS, (const uint32_t[]){ 0 }, 1));
+    CHECK_EQ(cpu2_log_ring.records, 0);
+
+    cpu2_log_poll();
+    CHECK_EQ(cpu2_log_ring.records, 1);
+    CHECK_EQ(cpu2_log_ring.dropped, 1);
+    CHECK_EQ(drain(), 1);
+    CHECK_EQ(cli.events, 1);
+    CHECK_EQ(cli.lastEvent, 7);
+    CHECK_EQ(cli.dropped, 1);
+
+    /* the latch is free again */
+    CPU2_LOG_EVENT(CPU2_LOG_BUS_OVER_VOLTAGE, cpu2_log_float(8.0f), cpu2_log_float(0.0f));
+    cpu2_log_poll();
+    CHECK_EQ(drain(), 1);
+    CHECK_EQ(cli.lastEvent, 8);
+}
+
+static void test_resync(void)
+{
+    start();
+
+    /* a record with an unknown id, as after a restart of CPU2 */
+    cpu2_log_text("msg 1\r\n", 7);
+    cpu2_log_ring.buffer[cpu2_log_ring.head & CPU2_LOG_RING_MASK] = 0x7777;
+    cpu2_log_ring.buffer[(cpu2_log_ring.head + 1) & CPU2_LOG_RING_MASK] = 2;
+    cpu2_log_ring.head += CPU2_LOG_HEADER_WORDS + 2;
+    cpu2_log_text("msg 2\r\n", 7);
+
+    drain();
+    CHECK_EQ(cli.texts, 1);
+    CHECK_EQ(sharedVars_cpu1toCpu2.cpu2_log_tail, cpu2_log_ring.head);
+    cpu2_log_print_stats();
+    CHECK_EQ(cli.resyncs, 1);
+}
+
+/*** CPU2 and CPU1 at the same time ***/
+
+#define ISR_PERIOD_NS   17500           /* the ADC sample period */
+
+static volatile int running;
+static uint32_t textsSent;
+static uint32_t eventsPosted;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* the super loop of CPU2 */
+static void *cpu2_main(void *arg)
+{
+    (void)arg;
+    while (running) {
+        cpu2_log_printf("msg %lu\r\n", (unsigned long)textsSent++);
+        cpu2_log_poll();
+    }
+    cpu2_log_poll();
+    return NULL;
+}
+
+/* an interrupt of CPU2 */
+static void *cpu2_isr(void *arg)
+{
+    int64_t next = now_ns();
+
+    (void)arg;
+    while (running) {
+        CPU2_LOG_EVENT(CPU2_LOG_BUS_OVER_VOLTAGE, cpu2_log_float((float)eventsPosted), cpu2_log_float(0.0f));
+        eventsPosted++;
+        for (next += ISR_PERIOD_NS; now_ns() < next && running; ) {
+        }
+    }
+    return NULL;
+}
+
+/* the super loop of CPU1 */
+static void *cpu1_main(void *arg)
+{
+    (void)arg;
+    while (running) {
+        cpu2_log_process(CPU2_LOG_RECORDS_PER_POLL);
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    pthread_t cpu2, isr, cpu1;
+    int64_t t0, elapsed;
+    uint32_t resyncs;
+
+    start();
+    cpu2_log_print_stats();
+    resyncs = cli.resyncs;
+    textsSent = 0;
+    eventsPosted = 0;
+    running = 1;
+
+    t0 = now_ns();
+    pthread_create(&cpu1, NULL, cpu1_main, NULL);
+    pthread_create(&isr, NULL, cpu2_isr, NULL);
+    pthread_create(&cpu2, NULL, cpu2_main, NULL);
+    while (now_ns() - t0 < RUN_NS) {
+        struct timespec ms = { 0, 1000000 };
+        nanosleep(&ms, NULL);
+    }
+    running = 0;
+    pthread_join(isr, NULL);
+    pthread_join(cpu2, NULL);
+    pthread_join(cpu1, NULL);
+    elapsed = now_ns() - t0;
+
+    cpu2_log_poll();
+    drain();
+    cpu2_log_print_stats();
+
+    /* what did not arrive has been counted as dropped, the order is kept */
+    CHECK_EQ(cli.texts + cli.events, cpu2_log_ring.records);
+    CHECK_EQ(cpu2_log_ring.records + cpu2_log_ring.dropped, textsSent + eventsPosted);
+    CHECK_EQ(cli.dropped, cpu2_log_ring.dropped);
+    CHECK_EQ(cli.outOfOrder, 0);
+    CHECK_EQ(cli.malformed, 0);
+    CHECK_EQ(cli.resyncs, resyncs);
+    CHECK(cli.texts > 0 && cli.events > 0);
+
+    printf("cpu2 log: %.0f records/s forwarded, %.0f texts/s and %.0f events/s written, %lu dropped\n",
+           cpu2_log_ring.records * 1e9 / elapsed, textsSent * 1e9 / elapsed, eventsPosted * 1e9 / elapsed,
+           (unsigned long)cpu2_log_ring.dropped);
+}
+
+int main(void)
+{
+    test_ring_full();
+    test_backlog();
+    test_latch();
+    test_resync();
+    test_threads();
+
+    return check_report("test_cpu2_log");
+}
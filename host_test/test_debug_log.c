@@ -0,0 +1,241 @@
+/*
+ * test_debug_log.c - the sequence locked debug log record between the cores
+ *
+ *  CPU1 takes the record CPU2 publishes with log_debug_log_snapshot() of
+ *  log.c, reached through log_store_debug_log_to_ram(), whose write to the
+ *  external RAM ends in emifc_cpu_write_memory() below. A record is
+ *  consistent when every field is the one CPU2 derived from its counter.
+ *
+ *  First a buffer left odd, as when CPU2 stops in the middle of a record,
+ *  then a CPU2 thread publishing the way PublishDebugLog() does it, giving
+ *  way to CPU1 after each record and in the middle of one, while CPU1 takes
+ *  copies without ever stopping it. No copy may
+ *  mix two records, torn copies have to be counted and taken again.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "cpu1_hal.h"
+#include "emifc.h"
+#include "log.h"
+#include "shared_variables.h"
+
+#define RUN_NS  500000000LL
+
+/*** what log.c needs of the rest of CPU1 ***/
+
+int16_t temperatureSensorVector[4] = { 31, 32, 33, 34 };
+unsigned char message[TRANSFER_SIZE];
+
+static debug_log_t stored;
+static uint32_t storedCount;
+
+/* the write of log_store_debug_log() to the external RAM */
+void emifc_cpu_write_memory(EMIF1_Config *emif1)
+{
+    CHECK_EQ(emif1->size, sizeof(debug_log_t));
+    memcpy(&stored, (const void *)emif1->data, sizeof(stored));
+    storedCount++;
+}
+
+/*** CPU2 ***/
+
+static bool yieldInRecord;      /* lets CPU1 run while a record is half written */
+
+/* every field CPU2 fills from the counter, PublishDebugLog() order */
+static void fill(volatile debug_log_t *log, uint32_t n)
+{
+    log->counter = n;
+    log->ISen1 = (int16_t)n;
+    log->ISen2 = (int16_t)(n + 1);
+    log->IF_1 = (int16_t)(n + 2);
+    log->I_Dab2 = (int16_t)(n + 3);
+    log->I_Dab3 = (int16_t)(n + 4);
+    log->Vbus = (int16_t)(n + 5);
+    log->AvgVbus = (int16_t)(n + 6);
+    log->VStore = (int16_t)(n + 7);
+    log->AvgVStore = (int16_t)(n + 8);
+    log->RegulateAvgInputCurrent = (int16_t)(n + 9);
+    log->RegulateAvgVStore = (int16_t)(n + 10);
+    log->RegulateAvgVbus = (int16_t)(n + 11);
+    log->RegulateAvgOutputCurrent = (int16_t)(n + 12);
+    log->RegulateIRef = (int16_t)(n + 13);
+    log->ILoop_PiOutput = (uint16_t)(n + 14);
+    log->cpu2_error_code = (uint16_t)(n + 15);
+    log->CurrentState = (int16_t)(n + 16);
+    log->elapsed_time = (uint16_t)(n + 17);
+    if (yieldInRecord) {
+        sched_yield();
+    }
+    for (int c = 0; c < NUMBER_OF_CELLS; c++) {
+        log->cellVoltage[c] = (int16_t)(n + 18 + c);
+    }
+}
+
+static bool consistent(const debug_log_t *log)
+{
+    uint32_t n = log->counter;
+    bool ok = (log->ISen1 == (int16_t)n) && (log->ISen2 == (int16_t)(n + 1)) &&
+              (log->IF_1 == (int16_t)(n + 2)) && (log->I_Dab2 == (int16_t)(n + 3)) &&
+              (log->I_Dab3 == (int16_t)(n + 4)) && (log->Vbus == (int16_t)(n + 5)) &&
+              (log->AvgVbus == (int16_t)(n + 6)) && (log->VStore == (int16_t)(n + 7)) &&
+              (log->AvgVStore == (int16_t)(n + 8)) && (log->RegulateAvgInputCurrent == (int16_t)(n + 9)) &&
+              (log->RegulateAvgVStore == (int16_t)(n + 10)) && (log->RegulateAvgVbus == (int16_t)(n + 11)) &&
+              (log->RegulateAvgOutputCurrent == (int16_t)(n + 12)) && (log->RegulateIRef == (int16_t)(n + 13)) &&
+              (log->ILoop_PiOutput == (uint16_t)(n + 14)) && (log->cpu2_error_code == (uint16_t)(n + 15)) &&
+              (log->CurrentState == (int16_t)(n + 16)) && (log->elapsed_time == (uint16_t)(n + 17));
+
+    for (int c = 0; c < NUMBER_OF_CELLS; c++) {
+        ok = ok && (log->cellVoltage[c] == (int16_t)(n + 18 + c));
+    }
+    return ok;
+}
+
+static void publish(uint32_t n)
+{
+    uint16_t next = sharedVars_cpu2toCpu1.debug_log.published ^ 1;
+
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;   /* odd, being written */
+    __sync_synchronize();
+    fill(&sharedVars_cpu2toCpu1.debug_log.record[next], n);
+    __sync_synchronize();
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;   /* even, complete */
+    sharedVars_cpu2toCpu1.debug_log.published = next;
+}
+
+/*** CPU1 ***/
+
+static char statsLine[160];
+
+typedef struct {
+    unsigned long snapshots;
+    unsigned long torn;
+    unsigned long missed;
+} stats_t;
+
+static stats_t stats(void)
+{
+    stats_t s = { 0, 0, 0 };
+
+    host_serial_capture(statsLine, sizeof(statsLine));
+    log_debug_log_print_stats();
+    CHECK(sscanf(statsLine, " snapshots: %lu, torn reads: %lu, missed: %lu",
+                 &s.snapshots, &s.torn, &s.missed) == 3);
+    return s;
+}
+
+static void test_single(void)
+{
+    stats_t before, after;
+    uint16_t buffer;
+
+    /* a new record is taken once */
+    publish(100);
+    storedCount = 0;
+    log_store_debug_log_to_ram();
+    log_store_debug_log_to_ram();
+    CHECK_EQ(storedCount, 1);
+    CHECK_EQ(stored.counter, 100);
+    CHECK(consistent(&stored));
+    CHECK_EQ(stored.BaseBoardTemperature, 31);
+
+    /* CPU2 published again during the copy and is writing the buffer CPU1
+     * copies, stopped there: the buffer stays odd, every attempt is torn */
+    publish(101);
+    buffer = sharedVars_cpu2toCpu1.debug_log.published;
+    sharedVars_cpu2toCpu1.debug_log.sequence[buffer]++;
+    before = stats();
+    log_store_debug_log_to_ram();
+    after = stats();
+    CHECK_EQ(storedCount, 1);
+    CHECK_EQ(after.snapshots, before.snapshots);
+    CHECK_EQ(after.torn - before.torn, 3);
+    CHECK_EQ(after.missed - before.missed, 1);
+
+    /* and taken once CPU2 has finished it */
+    sharedVars_cpu2toCpu1.debug_log.sequence[buffer]++;
+    log_store_debug_log_to_ram();
+    CHECK_EQ(storedCount, 2);
+    CHECK_EQ(stored.counter, 101);
+    CHECK(consistent(&stored));
+}
+
+static volatile int running;
+static uint32_t published;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *cpu2_main(void *arg)
+{
+    (void)arg;
+    while (running) {
+        publish(++published);
+        sched_yield();
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    pthread_t cpu2;
+    stats_t before, after;
+    uint32_t inconsistent = 0, backwards = 0, last = 0;
+    int64_t t0;
+
+    before = stats();
+    storedCount = 0;
+    published = 1000;
+    yieldInRecord = true;
+    running = 1;
+    pthread_create(&cpu2, NULL, cpu2_main, NULL);
+
+    for (t0 = now_ns(); now_ns() - t0 < RUN_NS; ) {
+        uint32_t count = storedCount;
+
+        log_store_debug_log_to_ram();
+        if (storedCount != count) {
+            inconsistent += !consistent(&stored);
+            backwards += (stored.counter <= last);
+            last = stored.counter;
+        }
+        sched_yield();
+    }
+    running = 0;
+    pthread_join(cpu2, NULL);
+    after = stats();
+
+    CHECK(storedCount > 0);
+    CHECK_EQ(inconsistent, 0);
+    CHECK_EQ(backwards, 0);
+    CHECK_EQ(after.snapshots - before.snapshots, storedCount);
+    printf("debug log: %lu records published, %lu copies, %lu torn reads, %lu missed\n",
+           (unsigned long)(published - 1000), (unsigned long)storedCount,
+           after.torn - before.torn, after.missed - before.missed);
+}
+
+int main(void)
+{
+    nor_flash_config_t config;
+
+    nor_flash_default_config(&config);
+    host_cpu1_init(&config);
+
+    test_single();
+    test_threads();
+
+    return check_report("test_debug_log");
+}
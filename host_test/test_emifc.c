@@ -0,0 +1,247 @@
+/*
+ * test_emifc.c - the queued EMIF1 transfers of emifc.c on the DMA model
+ *
+ *  Transfers between host buffers and the external RAM on CS2 are queued
+ *  and moved in bursts by the DMA model of cpu1_hal.c, each burst started
+ *  from the completion interrupt of the one before. The transfers have to
+ *  finish in the order they were queued, EMIF1 claimed once per batch and
+ *  given back when the queue runs empty, also when CPU2 holds it for a
+ *  while. Last the time spent queueing and in the interrupt, on the host
+ *  clock scaled to 200 MHz.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "board.h"
+#include "check.h"
+#include "cpu1_hal.h"
+#include "emifc.h"
+
+#define RAM(offset)     (EXT_RAM_START_ADDRESS_CS2 + (offset))
+#define BURSTS(words)   (((words) + EMIFC_DMA_BURST_WORDS - 1) / EMIFC_DMA_BURST_WORDS)
+
+static uint16_t order[4 * EMIFC_QUEUE_LEN];
+static uint16_t completed;
+
+static void done(void *context)
+{
+    order[completed++ % (4 * EMIFC_QUEUE_LEN)] = (uint16_t)(uintptr_t)context;
+}
+
+static void start(void)
+{
+    nor_flash_config_t config;
+
+    nor_flash_default_config(&config);
+    host_cpu1_init(&config);
+    Interrupt_register(INT_CPU1_EXT_MEM, &INT_CPU1_EXT_MEM_ISR);
+    Interrupt_enable(INT_CPU1_EXT_MEM);
+    memset(&emifc_stats, 0, sizeof(emifc_stats));
+    completed = 0;
+}
+
+/* the super loop until the queue is empty */
+static void wait_idle(void)
+{
+    for (int i = 0; !emifc_idle() && (i < 100000); i++) {
+        emifc_task();
+        host_delay_us(1);
+    }
+    CHECK(emifc_idle());
+}
+
+static void test_batch(void)
+{
+    static uint16_t a[100], b[32], c[1], back[100];
+
+    start();
+    for (int i = 0; i < 100; i++) {
+        a[i] = 0x1000 + i;
+        back[i] = 0;
+    }
+    b[0] = 0xBBBB;
+    b[31] = 0xBBBC;
+    c[0] = 0xCCCC;
+
+    /* queued back to back, the read sees the write before it */
+    CHECK(emifc_queue_write(RAM(0x100), a, 100, done, (void *)1));
+    CHECK(emifc_queue_write(RAM(0x200), b, 32, done, (void *)2));
+    CHECK(emifc_queue_write(RAM(0x100), c, 1, done, (void *)3));
+    CHECK(emifc_queue_read(RAM(0x100), back, 100, done, (void *)4));
+    CHECK(!emifc_idle());
+    /* nothing blocks, the first burst is under way */
+    CHECK_EQ(emifc_stats.bursts, 1);
+
+    wait_idle();
+    CHECK_EQ(completed, 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(order[i], i + 1);
+    }
+    CHECK_EQ(back[0], 0xCCCC);
+    for (int i = 1; i < 100; i++) {
+        CHECK_EQ(back[i], 0x1000 + i);
+    }
+    CHECK_EQ(*host_ext_ram(RAM(0x200)), 0xBBBB);
+    CHECK_EQ(*host_ext_ram(RAM(0x21F)), 0xBBBC);
+
+    /* one claim for the batch, given back at the end */
+    CHECK_EQ(emifc_stats.bursts, 2 * BURSTS(100) + BURSTS(32) + BURSTS(1));
+    CHECK_EQ(emifc_stats.claims, 1);
+    CHECK_EQ(emifc_stats.completed, 4);
+    CHECK_EQ(emifc_stats.maxDepth, 4);
+    CHECK_EQ(HWREGH(EMIF1CONFIG_BASE + MEMCFG_O_EMIF1MSEL), EMIF_MASTER_CPU1_NG);
+}
+
+static void test_full(void)
+{
+    static uint16_t data[EMIFC_QUEUE_LEN + 1][8];
+
+    start();
+    for (int i = 0; i < EMIFC_QUEUE_LEN; i++) {
+        CHECK(emifc_queue_write(RAM(0x1000 + 8 * i), data[i], 8, done, (void *)(uintptr_t)i));
+    }
+    CHECK(!emifc_queue_write(RAM(0x2000), data[EMIFC_QUEUE_LEN], 8, done, NULL));
+    CHECK_EQ(emifc_stats.full, 1);
+
+    wait_idle();
+    CHECK_EQ(completed, EMIFC_QUEUE_LEN);
+    for (int i = 0; i < EMIFC_QUEUE_LEN; i++) {
+        CHECK_EQ(order[i], i);
+    }
+}
+
+/* a callback queueing the next transfer keeps the batch and its claim */
+static uint16_t chainData[64];
+static uint16_t chainLeft;
+
+static void chain(void *context)
+{
+    done(context);
+    if (chainLeft > 0) {
+        chainLeft--;
+        CHECK(emifc_queue_write(RAM(0x3000 + 64 * chainLeft), chainData, 64, chain,
+                                (void *)(uintptr_t)(completed + 1)));
+    }
+}
+
+static void test_chain(void)
+{
+    start();
+    for (int i = 0; i < 64; i++) {
+        chainData[i] = 0x3000 + i;
+    }
+    chainLeft = 10;
+    CHECK(emifc_queue_write(RAM(0x3000 + 64 * chainLeft), chainData, 64, chain, (void *)1));
+
+    wait_idle();
+    CHECK_EQ(completed, 11);
+    for (int i = 0; i < 11; i++) {
+        CHECK_EQ(order[i], i + 1);
+        CHECK_EQ(*host_ext_ram(RAM(0x3000 + 64 * i + 63)), 0x3000 + 63);
+    }
+    CHECK_EQ(emifc_stats.claims, 1);
+    CHECK_EQ(emifc_stats.maxDepth, 1);
+}
+
+/* CPU2 has EMIF1, the batch waits for it in emifc_task() */
+static void test_cpu2_holds(void)
+{
+    static uint16_t data[40];
+
+    start();
+    data[39] = 0x4444;
+    host_emif1_held_by_cpu2(true);
+    CHECK(emifc_queue_write(RAM(0x4000), data, 40, done, (void *)1));
+    for (int i = 0; i < 10; i++) {
+        emifc_task();
+        host_delay_us(1);
+    }
+    CHECK(!emifc_idle());
+    CHECK_EQ(emifc_stats.bursts, 0);
+    CHECK_EQ(emifc_stats.claimRetries, 11);
+    CHECK_EQ(HWREGH(EMIF1CONFIG_BASE + MEMCFG_O_EMIF1MSEL), EMIF_MASTER_CPU2_G);
+
+    host_emif1_held_by_cpu2(false);
+    wait_idle();
+    CHECK_EQ(completed, 1);
+    CHECK_EQ(*host_ext_ram(RAM(0x4000 + 39)), 0x4444);
+    CHECK_EQ(emifc_stats.claims, 1);
+}
+
+/* the blocking calls queue and wait */
+static void test_blocking(void)
+{
+    static uint16_t data[200], back[200];
+    EMIF1_Config emif1;
+
+    start();
+    for (int i = 0; i < 200; i++) {
+        data[i] = 0x5000 + i;
+    }
+    emif1.address = RAM(0x5000);
+    emif1.cpuType = CPU_TYPE_ONE;
+    emif1.size = 200;
+    emif1.data = data;
+    emifc_cpu_write_memory(&emif1);
+    CHECK(emifc_idle());
+    emif1.data = back;
+    emifc_cpu_read_memory(&emif1);
+    CHECK(memcmp(data, back, sizeof(data)) == 0);
+    CHECK_EQ(emifc_stats.claims, 2);
+}
+
+static uint64_t real_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* queueing and the interrupt on the host clock */
+static void test_overhead(void)
+{
+    enum { REQUESTS = 20000 };
+    static uint16_t data[EMIFC_DMA_BURST_WORDS];
+    uint64_t cycles = 0, t;
+
+    start();
+    host_cpu1_follow(real_ns);
+    for (int i = 0; i < REQUESTS; i++) {
+        /* no host_delay_us(), the clock must not run ahead of the host */
+        while (emifc_stats.requests - emifc_stats.completed == EMIFC_QUEUE_LEN) {
+            emifc_task();
+            (void)host_time_ns();
+        }
+        t = IPC_getCounter(IPC_CPU1_L_CPU2_R);
+        CHECK(emifc_queue_write(RAM(0x6000), data, EMIFC_DMA_BURST_WORDS, NULL, NULL));
+        cycles += IPC_getCounter(IPC_CPU1_L_CPU2_R) - t;
+    }
+    wait_idle();
+    host_cpu1_follow(NULL);
+
+    CHECK_EQ(emifc_stats.completed, REQUESTS);
+    CHECK_EQ(emifc_stats.bursts, REQUESTS);
+    CHECK(emifc_stats.isrCycles / emifc_stats.bursts < 2000);
+    CHECK(cycles / REQUESTS < 2000);
+    printf("emifc: %lu cycles to queue, %lu cycles in the interrupt per burst, max %lu, %lu claims\n",
+           (unsigned long)(cycles / REQUESTS), (unsigned long)(emifc_stats.isrCycles / emifc_stats.bursts),
+           (unsigned long)emifc_stats.maxIsrCycles, (unsigned long)emifc_stats.claims);
+}
+
+int main(void)
+{
+    test_batch();
+    test_full();
+    test_chain();
+    test_cpu2_holds();
+    test_blocking();
+    test_overhead();
+
+    return check_report("test_emifc");
+}
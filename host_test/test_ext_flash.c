@@ -0,0 +1,494 @@
+/*
+ * test_ext_flash.c - ext_flash.c against the NOR flash model
+ *
+ *  The driver is built unchanged but for the bus cycles, see
+ *  EXT_FLASH_BUS_READ in ext_flash.c. The checks look at the array of the
+ *  model, not only at what the driver reads back, and at the commands the
+ *  model saw: sectors erased, write buffer or word programs, unlock
+ *  sequences it did not accept.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "cpu1_hal.h"
+#include "device.h"
+#include "ext_flash.h"
+
+#define CS3(offset)     (EXT_FLASH_START_ADDRESS_CS3 + (offset))
+
+static const nor_flash_stats_t *nor;
+
+static void start(uint16_t writeBufferWords)
+{
+    nor_flash_config_t config;
+
+    nor_flash_default_config(&config);
+    config.writeBufferWords = writeBufferWords;
+    config.chipEraseNs = 2000000000ULL;
+    host_cpu1_init(&config);
+    nor = nor_flash_stats();
+
+    ext_flash_reset();
+    ext_flash_config();
+}
+
+static bool erased(uint32_t address, uint32_t words)
+{
+    for (uint32_t i = 0; i < words; i++) {
+        if (nor_flash_peek(address + i) != 0xFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_geometry(void)
+{
+    start(32);
+
+    CHECK_EQ(ext_flash_sector_from_address(CS3(0x0000))->sector, EXT_FLASH_SA0);
+    CHECK_EQ(ext_flash_sector_from_address(CS3(0x1FFF))->sector, EXT_FLASH_SA0);
+    CHECK_EQ(ext_flash_sector_from_address(CS3(0x2000))->sector, EXT_FLASH_SA1);
+    CHECK_EQ(ext_flash_sector_from_address(CS3(0x3000))->sector, EXT_FLASH_SA2);
+    CHECK_EQ(ext_flash_sector_from_address(CS3(0x7FFF))->sector, EXT_FLASH_SA3);
+    CHECK_EQ(ext_flash_sector_from_address(CS3(0x8000))->sector, EXT_FLASH_SA4);
+    CHECK_EQ(ext_flash_sector_from_address(CS3(0x80000))->sector, EXT_FLASH_SA19);
+    CHECK_EQ(ext_flash_sector_from_address(CS3(0xFFFFF))->sector, EXT_FLASH_SA34);
+
+    /* the driver table and the model agree on every sector */
+    for (int sector = 0; sector < EXT_FLASH_SA_LAST; sector++) {
+        CHECK_EQ(nor_flash_sector(ex_flash_info[sector].addr), sector);
+        CHECK_EQ(nor_flash_sector(ex_flash_info[sector].addr + ex_flash_info[sector].size - 1), sector);
+    }
+}
+
+static void test_write_buffer(void)
+{
+    static uint16_t data[256];
+    static uint16_t back[256];
+    uint64_t t;
+
+    start(32);
+
+    /* CFI reports 64 bytes, programs stay within a 32 word page */
+    CHECK_EQ(ext_flash_page_words(CS3(0x8000), 100), 32);
+    CHECK_EQ(ext_flash_page_words(CS3(0x8005), 100), 27);
+    CHECK_EQ(ext_flash_page_words(CS3(0x8005), 3), 3);
+
+    for (uint16_t i = 0; i < 256; i++) {
+        data[i] = i ^ 0x5A00;
+    }
+    CHECK(ext_flash_erase_sector(CS3(0x8000)));
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA4], 1);
+    CHECK_EQ(ext_flash_wear.sectorErases[EXT_FLASH_SA4], 1);
+
+    t = host_time_ns();
+    CHECK(ext_flash_write_buf(CS3(0x8005), data, 256));
+    /* 9 pages, the first and the last partial, each waited for */
+    CHECK_EQ(nor->bufferPrograms, 9);
+    CHECK_EQ(nor->wordPrograms, 0);
+    CHECK_EQ(nor->wordsProgrammed, 256);
+    CHECK(host_time_ns() - t >= 9 * 240000ULL);
+    CHECK_EQ(ext_flash_stats.programs, 9);
+    CHECK_EQ(ext_flash_stats.words, 256);
+
+    ext_flash_read_buf(CS3(0x8005), back, 256);
+    CHECK(memcmp(back, data, sizeof(back)) == 0);
+    CHECK_EQ(nor_flash_peek(0x8005), data[0]);
+    CHECK_EQ(nor_flash_peek(0x8005 + 255), data[255]);
+    CHECK_EQ(nor_flash_peek(0x8004), 0xFFFF);
+    CHECK_EQ(nor_flash_peek(0x8005 + 256), 0xFFFF);
+
+    /* programming words that are not erased is refused before any command */
+    CHECK(!ext_flash_write_word(CS3(0x8005), 0));
+    CHECK(!ext_flash_write_buf(CS3(0x8000), data, 16));
+    CHECK_EQ(nor->wordPrograms + nor->bufferPrograms, 9);
+    CHECK_EQ(nor->programFailures, 0);
+
+    CHECK_EQ(nor->commandErrors, 0);
+    CHECK_EQ(nor->bufferAborts, 0);
+    CHECK_EQ(ext_flash_stats.timeouts, 0);
+}
+
+/* the CLI flash test of the driver */
+static void test_self_test(void)
+{
+    start(32);
+
+    ext_flash_test();
+    for (uint16_t i = 0; i < 256; i++) {
+        CHECK_EQ(nor_flash_peek(0x8000 + i), i);
+    }
+    CHECK_EQ(nor_flash_peek(0x7FF00), 0x1234);
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA4], 1);
+    CHECK_EQ(nor->commandErrors, 0);
+}
+
+static void test_word_program(void)
+{
+    uint16_t data[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+
+    /* no write buffer in CFI, one word program command per word */
+    start(0);
+    CHECK_EQ(ext_flash_page_words(CS3(0x8000), 100), 1);
+
+    CHECK(ext_flash_write_buf(CS3(0x10000), data, 10));
+    CHECK_EQ(nor->wordPrograms, 10);
+    CHECK_EQ(nor->bufferPrograms, 0);
+    for (uint16_t i = 0; i < 10; i++) {
+        CHECK_EQ(ext_flash_read_word(CS3(0x10000) + i), data[i]);
+    }
+
+    /* programming clears bits only */
+    CHECK(ext_flash_write_word(CS3(0x10010), 0xF0F0));
+    CHECK_EQ(nor_flash_peek(0x10010), 0xF0F0);
+    CHECK_EQ(nor->commandErrors, 0);
+}
+
+static void test_a19(void)
+{
+    start(32);
+
+    /* the upper half of the flash is seen in the same CS3 window, A19 set */
+    CHECK(ext_flash_write_word(CS3(0x80010), 0x1234));
+    CHECK_EQ(nor_flash_peek(0x80010), 0x1234);
+    CHECK_EQ(nor_flash_peek(0x00010), 0xFFFF);
+    CHECK_EQ(ext_flash_read_word(CS3(0x80010)), 0x1234);
+    CHECK_EQ(ext_flash_read_word(CS3(0x00010)), 0xFFFF);
+
+    CHECK(ext_flash_write_word(CS3(0x00010), 0x4321));
+    CHECK_EQ(nor_flash_peek(0x00010), 0x4321);
+    CHECK_EQ(nor_flash_peek(0x80010), 0x1234);
+
+    /* a read across the A19 boundary */
+    {
+        uint16_t back[32];
+
+        CHECK(ext_flash_write_word(CS3(0x7FFFF), 0x00AA));
+        CHECK(ext_flash_write_word(CS3(0x80000), 0x00BB));
+        ext_flash_read_buf(CS3(0x7FFFF), back, 2);
+        CHECK_EQ(back[0], 0x00AA);
+        CHECK_EQ(back[1], 0x00BB);
+    }
+
+    /* sector erase of the upper half */
+    CHECK(ext_flash_erase_sector(CS3(0x80000)));
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA19], 1);
+    CHECK_EQ(nor_flash_peek(0x80010), 0xFFFF);
+    CHECK_EQ(nor_flash_peek(0x7FFFF), 0x00AA);
+    CHECK_EQ(nor->commandErrors, 0);
+}
+
+static void test_small_sectors(void)
+{
+    start(32);
+
+    for (uint32_t a = 0; a < 0x8000; a += 0x800) {
+        CHECK(ext_flash_write_word(CS3(a), (uint16_t)a));
+    }
+
+    /* SA2, 4k words, between SA1 and SA3 */
+    CHECK(ext_flash_erase_sector(CS3(0x3000)));
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA2], 1);
+    CHECK(erased(0x3000, 0x1000));
+    CHECK_EQ(nor_flash_peek(0x2800), 0x2800);
+    CHECK_EQ(nor_flash_peek(0x4000), 0x4000);
+
+    /* SA3 erased from an address within it */
+    CHECK(ext_flash_erase_sector(CS3(0x6800)));
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA3], 1);
+    CHECK(erased(0x4000, 0x4000));
+    CHECK_EQ(nor_flash_peek(0x0000), 0x0000);
+    CHECK_EQ(nor_flash_peek(0x2000), 0x2000);
+
+    CHECK(ext_flash_chip_erase());
+    CHECK_EQ(nor->chipErases, 1);
+    CHECK_EQ(ext_flash_wear.chipErases, 1);
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA0], 1);
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA2], 2);
+    CHECK(erased(0, 0x8000));
+}
+
+static uint16_t callbacks;
+static ext_flash_op_status_t lastStatus;
+
+static void op_done(ext_flash_op_status_t status, void *context)
+{
+    (void)context;
+    callbacks++;
+    lastStatus = status;
+}
+
+static void test_queue(void)
+{
+    static uint16_t data[100];
+    uint32_t polls = 0;
+
+    start(32);
+    memset(ext_flash_latency, 0, sizeof(ext_flash_latency));
+    for (uint16_t i = 0; i < 100; i++) {
+        data[i] = 0x100 + i;
+    }
+
+    CHECK(ext_flash_write_word(CS3(0x18000), 0));
+    CHECK(ext_flash_queue_erase_sector(CS3(0x18000), op_done, NULL));
+    CHECK(ext_flash_queue_program(CS3(0x18000), data, 100, op_done, NULL));
+    CHECK(!ext_flash_idle());
+
+    /* the super loop, nothing blocks */
+    while (!ext_flash_idle() && (polls < 1000000)) {
+        uint64_t t = host_time_ns();
+
+        ext_flash_task();
+        CHECK(host_time_ns() - t < 100000);
+        host_delay_us(20);
+        polls++;
+    }
+    CHECK(ext_flash_idle());
+    CHECK_EQ(callbacks, 2);
+    CHECK_EQ(lastStatus, EXT_FLASH_OP_OK);
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA6], 1);
+    CHECK_EQ(nor->bufferPrograms, 4);
+    for (uint16_t i = 0; i < 100; i++) {
+        CHECK_EQ(nor_flash_peek(0x18000 + i), data[i]);
+    }
+
+    /* latencies come from the RDY/BSY interrupt, not from the polling */
+    CHECK_EQ(ext_flash_latency[EXT_FLASH_OP_ERASE_SECTOR].count, 1);
+    CHECK(ext_flash_latency[EXT_FLASH_OP_ERASE_SECTOR].maxUs >= 500000);
+    CHECK(ext_flash_latency[EXT_FLASH_OP_ERASE_SECTOR].maxUs < 500100);
+    CHECK_EQ(ext_flash_latency[EXT_FLASH_OP_PROGRAM].count, 4);
+    CHECK(ext_flash_latency[EXT_FLASH_OP_PROGRAM].maxUs >= 240);
+    CHECK(ext_flash_latency[EXT_FLASH_OP_PROGRAM].maxUs < 260);
+
+    /* a program reaching words that are not erased stops there */
+    callbacks = 0;
+    CHECK(ext_flash_queue_program(CS3(0x18000 + 90), data, 20, op_done, NULL));
+    while (!ext_flash_idle()) {
+        ext_flash_task();
+        host_delay_us(20);
+    }
+    CHECK_EQ(callbacks, 1);
+    CHECK_EQ(lastStatus, EXT_FLASH_OP_FAIL);
+    CHECK_EQ(nor->programFailures, 0);
+
+    /* a blocking command runs the queue first */
+    callbacks = 0;
+    CHECK(ext_flash_queue_erase_sector(CS3(0x20000), op_done, NULL));
+    CHECK(ext_flash_write_word(CS3(0x20000), 0x55AA));
+    CHECK_EQ(callbacks, 1);
+    CHECK_EQ(nor_flash_peek(0x20000), 0x55AA);
+    CHECK_EQ(nor->commandErrors, 0);
+    CHECK_EQ(nor->busyWrites, 0);
+}
+
+/* one operation of the throughput run, the callback checks the order */
+typedef struct {
+    bool erase;
+    uint32_t offset;
+    uint16_t words;
+} run_op_t;
+
+static const run_op_t runOps[] = {
+    { true,  0x20000, 0    },
+    { false, 0x20000, 2048 },
+    { true,  0x28000, 0    },
+    { false, 0x28000, 2048 },
+    { false, 0x20800, 1024 },
+    { false, 0x28800, 1000 },
+    { false, 0x20C00, 7    },
+};
+#define RUN_OPS (sizeof(runOps) / sizeof(runOps[0]))
+
+static uint16_t runDone;
+static uint16_t runOutOfOrder;
+
+static void run_done(ext_flash_op_status_t status, void *context)
+{
+    runOutOfOrder += ((const run_op_t *)context != &runOps[runDone]) || (status != EXT_FLASH_OP_OK);
+    runDone++;
+}
+
+static uint32_t run_words(void)
+{
+    uint32_t words = 0;
+
+    for (unsigned i = 0; i < RUN_OPS; i++) {
+        words += runOps[i].words;
+    }
+    return words;
+}
+
+static void test_queue_throughput(void)
+{
+    static uint16_t data[2048];
+    uint64_t t0, queued, blocking, maxTask = 0;
+    uint32_t count;
+
+    for (uint16_t i = 0; i < 2048; i++) {
+        data[i] = i ^ 0x5A5A;
+    }
+
+    /* the blocking commands, for comparison */
+    start(32);
+    t0 = host_time_ns();
+    for (unsigned i = 0; i < RUN_OPS; i++) {
+        if (runOps[i].erase) {
+            CHECK(ext_flash_erase_sector(CS3(runOps[i].offset)));
+        } else {
+            CHECK(ext_flash_write_buf(CS3(runOps[i].offset), data, runOps[i].words));
+        }
+    }
+    blocking = host_time_ns() - t0;
+
+    /* the same from the queue, the super loop polling every 2 us */
+    start(32);
+    memset(ext_flash_latency, 0, sizeof(ext_flash_latency));
+    runDone = 0;
+    runOutOfOrder = 0;
+    t0 = host_time_ns();
+    for (unsigned i = 0; i < RUN_OPS; i++) {
+        if (runOps[i].erase) {
+            CHECK(ext_flash_queue_erase_sector(CS3(runOps[i].offset), run_done, (void *)&runOps[i]));
+        } else {
+            CHECK(ext_flash_queue_program(CS3(runOps[i].offset), data, runOps[i].words, run_done,
+                                          (void *)&runOps[i]));
+        }
+    }
+    /* the queue takes EXT_FLASH_OP_QUEUE_LEN - 1 operations */
+    CHECK(!ext_flash_queue_erase_sector(CS3(0x30000), run_done, NULL));
+
+    while (!ext_flash_idle() && (host_time_ns() - t0 < 10 * blocking)) {
+        uint64_t t = host_time_ns();
+
+        ext_flash_task();
+        if (host_time_ns() - t > maxTask) {
+            maxTask = host_time_ns() - t;
+        }
+        host_delay_us(2);
+    }
+    queued = host_time_ns() - t0;
+
+    CHECK(ext_flash_idle());
+    CHECK_EQ(runDone, RUN_OPS);
+    CHECK_EQ(runOutOfOrder, 0);
+    CHECK(maxTask < 100000);
+    for (unsigned i = 0; i < RUN_OPS; i++) {
+        for (uint16_t w = 0; w < runOps[i].words; w++) {
+            CHECK_EQ(nor_flash_peek(runOps[i].offset + w), data[w]);
+        }
+    }
+
+    /* every completion in the histogram, the longest in the last bin used */
+    for (int type = 0; type < EXT_FLASH_OP_TYPES; type++) {
+        const ext_flash_latency_t *latency = &ext_flash_latency[type];
+        int last = -1;
+
+        count = 0;
+        for (int bin = 0; bin < EXT_FLASH_LATENCY_BINS; bin++) {
+            count += latency->histogram[bin];
+            if (latency->histogram[bin] != 0) {
+                last = bin;
+            }
+        }
+        CHECK_EQ(count, latency->count);
+        if (last > 0 && last < EXT_FLASH_LATENCY_BINS - 1) {
+            CHECK(latency->maxUs >= ((uint32_t)EXT_FLASH_LATENCY_BIN0 << (last - 1)));
+            CHECK(latency->maxUs < ((uint32_t)EXT_FLASH_LATENCY_BIN0 << last));
+        }
+    }
+    CHECK_EQ(ext_flash_latency[EXT_FLASH_OP_ERASE_SECTOR].count, 2);
+    CHECK_EQ(ext_flash_latency[EXT_FLASH_OP_PROGRAM].count, nor->bufferPrograms);
+
+    /* completion from the interrupt costs no more than the blocking wait */
+    CHECK(queued < blocking + blocking / 20);
+    printf("flash queue: %u operations, %lu words in %.1f ms, %.0f words/s, blocking %.1f ms\n",
+           (unsigned)RUN_OPS, (unsigned long)run_words(), queued / 1e6, run_words() * 1e9 / queued,
+           blocking / 1e6);
+}
+
+static void test_model(void)
+{
+    start(32);
+
+    /* a 0 programmed back to 1: busy until reset, DQ5 set */
+    nor_flash_poke(0x100, 0x0000);
+    ext_flash_bus_write(CS3(0x555), 0xAA);
+    ext_flash_bus_write(CS3(0x2AA), 0x55);
+    ext_flash_bus_write(CS3(0x555), 0xA0);
+    ext_flash_bus_write(CS3(0x100), 0x00FF);
+    host_delay_us(1000);
+    CHECK(!nor_flash_ready());
+    CHECK_EQ(nor->programFailures, 1);
+    CHECK((ext_flash_bus_read(CS3(0x100)) & 0x20) != 0);
+    CHECK((ext_flash_bus_read(CS3(0x100)) ^ ext_flash_bus_read(CS3(0x100))) == 0x40);
+    ext_flash_bus_write(CS3(0x000), 0xF0);
+    CHECK(nor_flash_ready());
+    CHECK_EQ(ext_flash_read_word(CS3(0x100)), 0x0000);
+
+    /* a write buffer sequence with a word outside the page aborts */
+    ext_flash_bus_write(CS3(0x555), 0xAA);
+    ext_flash_bus_write(CS3(0x2AA), 0x55);
+    ext_flash_bus_write(CS3(0x8000), 0x25);
+    ext_flash_bus_write(CS3(0x8000), 1);
+    ext_flash_bus_write(CS3(0x801F), 1);
+    ext_flash_bus_write(CS3(0x8020), 2);
+    CHECK_EQ(nor->bufferAborts, 1);
+    CHECK((ext_flash_bus_read(CS3(0x8000)) & 0x02) != 0);
+    ext_flash_bus_write(CS3(0x555), 0xAA);
+    ext_flash_bus_write(CS3(0x2AA), 0x55);
+    ext_flash_bus_write(CS3(0x555), 0xF0);
+    CHECK_EQ(ext_flash_read_word(CS3(0x801F)), 0xFFFF);
+
+    /* a broken unlock sequence is no command */
+    ext_flash_bus_write(CS3(0x555), 0xAA);
+    ext_flash_bus_write(CS3(0x2AB), 0x55);
+    CHECK_EQ(nor->commandErrors, 1);
+    ext_flash_bus_write(CS3(0x8000), 0xA0);
+    CHECK_EQ(nor->commandErrors, 2);
+    CHECK_EQ(nor->wordPrograms, 1);
+
+    /* accesses while busy are counted, writes are ignored */
+    ext_flash_bus_write(CS3(0x555), 0xAA);
+    ext_flash_bus_write(CS3(0x2AA), 0x55);
+    ext_flash_bus_write(CS3(0x555), 0xA0);
+    ext_flash_bus_write(CS3(0x200), 0x1111);
+    ext_flash_bus_write(CS3(0x201), 0x2222);
+    CHECK_EQ(nor->busyWrites, 1);
+    CHECK(!ext_flash_ready());
+    host_delay_us(60);
+    CHECK(ext_flash_ready());
+    CHECK_EQ(nor_flash_peek(0x200), 0x1111);
+    CHECK_EQ(nor_flash_peek(0x201), 0xFFFF);
+
+    /* RESET# ends a command */
+    ext_flash_bus_write(CS3(0x555), 0xAA);
+    ext_flash_bus_write(CS3(0x2AA), 0x55);
+    ext_flash_bus_write(CS3(0x555), 0x80);
+    ext_flash_bus_write(CS3(0x555), 0xAA);
+    ext_flash_bus_write(CS3(0x2AA), 0x55);
+    ext_flash_bus_write(CS3(0x0000), 0x30);
+    CHECK(!ext_flash_ready());
+    ext_flash_reset();
+    CHECK(ext_flash_ready());
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA0], 0);
+    CHECK_EQ(nor_flash_peek(0x200), 0x1111);
+}
+
+int main(void)
+{
+    test_geometry();
+    test_write_buffer();
+    test_self_test();
+    test_word_program();
+    test_a19();
+    test_small_sectors();
+    test_queue();
+    test_queue_throughput();
+    test_model();
+
+    return check_report("test_ext_flash");
+}
@@ -0,0 +1,408 @@
+/*
+ * test_filters.c - the filters of filters.c and the averages built on them
+ *
+ *  The moving average against the mean of the window taken in double, while
+ *  the window fills and once it is full, for several lengths. A long run on
+ *  a large offset checks that the running sum does not drift, and the
+ *  Regulate averages of DCDC.c start again after DCDCRegulateAveragesReset().
+ *  The first order IIR against its closed form step response, the median
+ *  against the sorted window and with spikes it has to reject.
+ *
+ *  Last a load step through the Regulate current reference and a bus
+ *  voltage step through DCDC_VI.avgVBus, the fast path and the slow task run
+ *  at their real rates, against the block averages of 25 and 10 samples they
+ *  replaced. The new averages have to get there sooner for every phase of
+ *  the step against the blocks.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "cpu2_hal.h"
+
+#include "DCDC.h"
+#include "filters.h"
+#include "GlobalV.h"
+#include "sensors.h"
+#include "shared_variables.h"
+#include "state_machine.h"
+#include "switches.h"
+
+#define MAX_LENGTH  100
+
+static float window[MAX_LENGTH];
+
+/* uniform in [-1, 1), repeatable */
+static float noise(void)
+{
+    return (float)rand() / ((float)RAND_MAX / 2.0f) - 1.0f;
+}
+
+static double mean(const float *samples, int n, int length)
+{
+    double sum = 0;
+    int first = (n > length) ? n - length : 0;
+
+    for (int i = first; i < n; i++) {
+        sum += samples[i];
+    }
+    return sum / (n - first);
+}
+
+static void test_window(uint16_t length)
+{
+    static float samples[1000];
+    MovingAverage_t f;
+
+    MovingAverageInit(&f, window, length);
+    for (int n = 1; n <= 1000; n++) {
+        samples[n - 1] = 50.0f + 10.0f * noise();
+        CHECK_NEAR(MovingAverageUpdate(&f, samples[n - 1]), mean(samples, n, length), 1e-4);
+        CHECK_NEAR(f.output, mean(samples, n, length), 1e-4);
+    }
+    CHECK_EQ(f.count, length);
+}
+
+/* the running sum alone would collect the rounding of every add and subtract */
+static void test_drift(void)
+{
+    enum { LENGTH = 50, UPDATES = 1000000 };
+    static float samples[LENGTH];
+    MovingAverage_t f;
+    float output = 0;
+
+    MovingAverageInit(&f, window, LENGTH);
+    for (int n = 0; n < UPDATES; n++) {
+        samples[n % LENGTH] = 1000.0f + 0.01f * noise();
+        output = MovingAverageUpdate(&f, samples[n % LENGTH]);
+    }
+    CHECK_NEAR(output, mean(samples, LENGTH, LENGTH), 1e-3);
+
+    /* a step from the offset to 0 leaves nothing behind after one window */
+    for (int n = 0; n < LENGTH; n++) {
+        output = MovingAverageUpdate(&f, 0.0f);
+    }
+    CHECK_NEAR(output, 0.0, 1e-4);
+}
+
+static void test_reset(void)
+{
+    MovingAverage_t f;
+
+    MovingAverageInit(&f, window, 4);
+    for (int n = 0; n < 10; n++) {
+        MovingAverageUpdate(&f, 8.0f);
+    }
+    MovingAverageReset(&f);
+    CHECK_EQ(f.count, 0);
+    CHECK_EQ(f.idx, 0);
+    CHECK_NEAR(f.output, 0.0, 0);
+
+    /* the first sample after a reset is the mean, no old samples in it */
+    CHECK_NEAR(MovingAverageUpdate(&f, 2.0f), 2.0, 0);
+    CHECK_NEAR(MovingAverageUpdate(&f, 4.0f), 3.0, 0);
+
+    /* a length of 0 is a window of one sample */
+    MovingAverageInit(&f, window, 0);
+    CHECK_EQ(f.length, 1);
+    CHECK_NEAR(MovingAverageUpdate(&f, 5.0f), 5.0, 0);
+    CHECK_NEAR(MovingAverageUpdate(&f, -3.0f), -3.0, 0);
+}
+
+static void test_regulate_averages(void)
+{
+    DCDCConverterInit();
+
+    sensorVector[VStoreIdx].realValue = 60.0f;
+    sensorVector[VBusIdx].realValue = 400.0f;
+    for (int n = 0; n < 20; n++) {
+        calculate_boost_current();
+    }
+    CHECK_NEAR(DCDC_VI.RegulateAvgVStore, 60.0, 1e-4);
+
+    /* a later Regulate starts from its own samples */
+    DCDCRegulateAveragesReset();
+    sensorVector[VStoreIdx].realValue = 90.0f;
+    sensorVector[VBusIdx].realValue = 380.0f;
+    calculate_boost_current();
+    CHECK_NEAR(DCDC_VI.RegulateAvgVStore, 90.0, 1e-4);
+    CHECK_NEAR(DCDC_VI.RegulateAvgVbus, 380.0, 1e-4);
+}
+
+static void test_iir(void)
+{
+    Iir1_t f;
+    double expected;
+
+    /* primed with the first sample, no ramp up from 0 */
+    Iir1Init(&f, 0.2f);
+    CHECK_NEAR(Iir1Update(&f, 10.0f), 10.0, 0);
+
+    /* a step from 10 to 20 closes by alpha of the gap each sample */
+    for (int n = 1; n <= 50; n++) {
+        expected = 20.0 - 10.0 * pow(0.8, n);
+        CHECK_NEAR(Iir1Update(&f, 20.0f), expected, 1e-4);
+    }
+
+    Iir1Reset(&f);
+    CHECK(!f.primed);
+    CHECK_NEAR(Iir1Update(&f, -3.0f), -3.0, 0);
+
+    /* alpha 1 passes the samples */
+    Iir1Init(&f, 1.0f);
+    CHECK_NEAR(Iir1Update(&f, 1.0f), 1.0, 0);
+    CHECK_NEAR(Iir1Update(&f, 7.0f), 7.0, 0);
+}
+
+static int compare_float(const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double median(const float *samples, int n, int length)
+{
+    float sorted[MEDIAN_FILTER_MAX_LENGTH];
+    int first = (n > length) ? n - length : 0;
+    int count = n - first;
+
+    for (int i = 0; i < count; i++) {
+        sorted[i] = samples[first + i];
+    }
+    qsort(sorted, count, sizeof(float), compare_float);
+    return (count & 1) ? sorted[count / 2] : 0.5 * (sorted[count / 2 - 1] + sorted[count / 2]);
+}
+
+static void test_median(uint16_t length)
+{
+    static float samples[1000];
+    Median_t f;
+
+    MedianInit(&f, length);
+    for (int n = 1; n <= 1000; n++) {
+        samples[n - 1] = 50.0f + 10.0f * noise();
+        CHECK_NEAR(MedianUpdate(&f, samples[n - 1]), median(samples, n, length), 1e-4);
+    }
+    CHECK_EQ(f.count, length);
+}
+
+/* up to (length - 1) / 2 spikes in a window do not show */
+static void test_median_spikes(void)
+{
+    Median_t f;
+    float output;
+    int bad = 0;
+
+    MedianInit(&f, 5);
+    for (int n = 0; n < 100; n++) {
+        output = MedianUpdate(&f, ((n % 5) == 3 || (n % 5) == 4) ? 1000.0f : 12.0f);
+        bad += (n >= 2) && (output != 12.0f);
+    }
+    CHECK_EQ(bad, 0);
+
+    /* the length is kept within 1 and MEDIAN_FILTER_MAX_LENGTH */
+    MedianInit(&f, 0);
+    CHECK_EQ(f.length, 1);
+    MedianInit(&f, 100);
+    CHECK_EQ(f.length, MEDIAN_FILTER_MAX_LENGTH);
+    MedianReset(&f);
+    CHECK_EQ(f.count, 0);
+    CHECK_NEAR(MedianUpdate(&f, 4.0f), 4.0, 0);
+}
+
+/*** step response against the block averages ***/
+
+/* the block average of the baseline, a value once per length + 1 samples */
+typedef struct {
+    uint16_t length;
+    uint16_t count;
+    float sum;
+    float output;
+} BlockAverage_t;
+
+static void block_average(BlockAverage_t *b, float sample)
+{
+    if (b->count < b->length) {
+        b->sum += sample;
+        b->count++;
+    } else {
+        b->output = b->sum / b->count;
+        b->count = 0;
+        b->sum = 0.0f;
+    }
+}
+
+/* the sample the conversion table turns into value */
+static void set_real(uint16_t sensorIdx, float value)
+{
+    float counts = (value - sensorConversion.offset[sensorIdx]) / sensorConversion.scale[sensorIdx];
+
+    CHECK(counts >= 0.0f && counts <= 65535.0f);
+    sensorConversion.counts[sensorIdx] = (uint16_t)(counts + 0.5f);
+    sensorVector[sensorIdx].newADCReady = true;
+}
+
+/* DCDC.c and state_machine.c, not in their headers */
+extern float I_IN_LIMIT_RATE;
+
+/* the reference of calculate_boost_current() from the block averages */
+static float block_reference(float avgOutputCurrent, float avgVbus, float avgVStore)
+{
+    float boostGain = (avgVStore > 0.0f) ? avgVbus / avgVStore : 0.0f;
+
+    if (boostGain > 6.0f) {
+        boostGain = 6.0f;
+    }
+    if (avgOutputCurrent <= I_IN_LIMIT_RATE * DCDC_VI.iIn_limit) {
+        return 0.0f;
+    }
+    return (avgOutputCurrent - I_IN_LIMIT_RATE * DCDC_VI.iIn_limit) * boostGain;
+}
+
+#define STEP_VSTORE         60.0f
+#define STEP_VBUS           180.0f
+#define STEP_VBUS_SAGGED    (0.97f * STEP_VBUS)
+#define STEP_CURRENT_LOW    2.0f
+#define STEP_CURRENT_HIGH   8.0f
+#define STEP_SAMPLES        400
+
+/* Regulate with its averages settled at the low load */
+static void step_start(void)
+{
+    /* the start up of main.c */
+    Board_init();
+    StateMachineInit();
+    DCDCConverterInit();
+    HAL_StartPwmCounters();
+    InitializeSensorParameters();
+    DCDCRegulateAveragesReset();
+    DCDC_VI.iIn_limit = 5.0f;
+    DCDC_VI.target_Voltage_At_DCBus = STEP_VBUS;
+    sharedVars_cpu1toCpu2.max_allowed_dc_bus_voltage = 2 * STEP_VBUS;
+    sharedVars_cpu1toCpu2.min_allowed_dc_bus_voltage = 0;
+    StateVector.State_Current = Regulate;
+    StateVector.State_Next = Regulate;
+    /* switches as VerifyDPMUSwitchesOK() expects them in Regulate */
+    sharedVars_cpu1toCpu2.dpmu_default_flag = false;
+    switches_Qinb(SW_ON);
+    switches_Qlb(SW_OFF);
+    switches_Qsb(SW_ON);
+}
+
+/* one sample period, INT_ADCINB_4_ISR and the super loop after it */
+static void step_sample(float outputCurrent, float vbus)
+{
+    set_real(ISen1fIdx, outputCurrent);
+    set_real(VBusIdx, vbus);
+    set_real(VStoreIdx, STEP_VSTORE);
+    set_real(IF_1fIdx, 0.0f);
+    set_real(ISen2fIdx, 0.0f);
+    StateMachineFastTick();
+    StateMachineScheduler();
+}
+
+/* samples after the step until the value is within 10 % of the step */
+static int settled_at(const float *value, float before, float after)
+{
+    for (int n = STEP_SAMPLES - 1; n >= 0; n--) {
+        if (fabsf(value[n] - after) > 0.1f * fabsf(after - before)) {
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static void test_step_latency(void)
+{
+    static float newRef[STEP_SAMPLES], oldRef[STEP_SAMPLES], newVbus[STEP_SAMPLES], oldVbus[STEP_SAMPLES];
+    const float refLow = 0.0f;
+    const float refHigh = (STEP_CURRENT_HIGH - I_IN_LIMIT_RATE * 5.0f) * STEP_VBUS_SAGGED / STEP_VSTORE;
+    int newRefWorst = 0, oldRefBest = STEP_SAMPLES, newVbusWorst = 0, oldVbusBest = STEP_SAMPLES;
+    long newRefSum = 0, oldRefSum = 0, newVbusSum = 0, oldVbusSum = 0;
+    int phases = 0;
+
+    /* every phase of the step against the 25 sample blocks */
+    for (int phase = 0; phase < BOOST_CURRENT_AVG_WINDOW + 1; phase++) {
+        BlockAverage_t oldCurrent = { BOOST_CURRENT_AVG_WINDOW }, oldBoostVbus = { BOOST_CURRENT_AVG_WINDOW };
+        BlockAverage_t oldBoostVStore = { BOOST_CURRENT_AVG_WINDOW }, oldAvgVbus = { AVG_VBUS_WINDOW };
+        int newRefAt, oldRefAt, newVbusAt, oldVbusAt;
+
+        step_start();
+        for (int n = 0; n < 200 + phase; n++) {
+            step_sample(STEP_CURRENT_LOW, STEP_VBUS);
+            block_average(&oldCurrent, STEP_CURRENT_LOW);
+            block_average(&oldBoostVbus, STEP_VBUS);
+            block_average(&oldBoostVStore, STEP_VSTORE);
+            block_average(&oldAvgVbus, STEP_VBUS);
+        }
+        CHECK_NEAR(DCDC_VI.I_Ref_Real, refLow, 1e-3);
+
+        /* the load steps up and the bus sags, short of the REG_MIN_DC_BUS_VOLTAGE_RATIO of RegulateVoltageInit */
+        for (int n = 0; n < STEP_SAMPLES; n++) {
+            step_sample(STEP_CURRENT_HIGH, STEP_VBUS_SAGGED);
+            block_average(&oldCurrent, STEP_CURRENT_HIGH);
+            block_average(&oldBoostVbus, STEP_VBUS_SAGGED);
+            block_average(&oldBoostVStore, STEP_VSTORE);
+            block_average(&oldAvgVbus, STEP_VBUS_SAGGED);
+            newRef[n] = DCDC_VI.I_Ref_Real;
+            oldRef[n] = block_reference(oldCurrent.output, oldBoostVbus.output, oldBoostVStore.output);
+            newVbus[n] = DCDC_VI.avgVBus;
+            oldVbus[n] = oldAvgVbus.output;
+        }
+        CHECK_EQ(StateVector.State_Current, Regulate);
+
+        CHECK_NEAR(newRef[STEP_SAMPLES - 1], refHigh, 0.05);
+        CHECK_NEAR(oldRef[STEP_SAMPLES - 1], refHigh, 1e-3);
+        newRefAt = settled_at(newRef, refLow, refHigh);
+        oldRefAt = settled_at(oldRef, refLow, refHigh);
+        newVbusAt = settled_at(newVbus, STEP_VBUS, STEP_VBUS_SAGGED);
+        oldVbusAt = settled_at(oldVbus, STEP_VBUS, STEP_VBUS_SAGGED);
+        CHECK(newRefAt < oldRefAt);
+        CHECK(newVbusAt < oldVbusAt);
+
+        newRefWorst = (newRefAt > newRefWorst) ? newRefAt : newRefWorst;
+        oldRefBest = (oldRefAt < oldRefBest) ? oldRefAt : oldRefBest;
+        newVbusWorst = (newVbusAt > newVbusWorst) ? newVbusAt : newVbusWorst;
+        oldVbusBest = (oldVbusAt < oldVbusBest) ? oldVbusAt : oldVbusBest;
+        newRefSum += newRefAt;
+        oldRefSum += oldRefAt;
+        newVbusSum += newVbusAt;
+        oldVbusSum += oldVbusAt;
+        phases++;
+    }
+
+    /* within the window of the moving average, whatever the phase */
+    CHECK(newRefWorst <= BOOST_CURRENT_AVG_WINDOW);
+    CHECK(newVbusWorst <= AVG_VBUS_WINDOW);
+    printf("filters: load step to 90 %%, moving average %.1f us (worst %.1f), block %.1f us (best %.1f)\n",
+           SM_FAST_TICK_US * newRefSum / phases, SM_FAST_TICK_US * newRefWorst,
+           SM_FAST_TICK_US * oldRefSum / phases, SM_FAST_TICK_US * oldRefBest);
+    printf("filters: bus step to 90 %%, moving average %.1f us (worst %.1f), block %.1f us (best %.1f)\n",
+           SM_FAST_TICK_US * newVbusSum / phases, SM_FAST_TICK_US * newVbusWorst,
+           SM_FAST_TICK_US * oldVbusSum / phases, SM_FAST_TICK_US * oldVbusBest);
+}
+
+int main(void)
+{
+    srand(1);
+
+    test_window(1);
+    test_window(4);
+    test_window(50);
+    test_window(MAX_LENGTH);
+    test_drift();
+    test_reset();
+    test_regulate_averages();
+    test_iir();
+    test_median(1);
+    test_median(4);
+    test_median(MEDIAN_FILTER_MAX_LENGTH);
+    test_median_spikes();
+    test_step_latency();
+
+    return check_report("test_filters");
+}
@@ -0,0 +1,261 @@
+/*
+ * test_lfs.c - the littlefs block device of lfs_api.c on the NOR flash model
+ *
+ *  First the callbacks alone: a block in the upper half of the flash has
+ *  to land there, not in the lower half the CS3 window also shows, reads
+ *  set A19 once per run, programs go out as write buffer pages and a
+ *  program on words that are not erased is refused without hanging the
+ *  device. Then littlefs itself, with the geometry, cache and lookahead of
+ *  ext_flash_lfs_config: mount, create, append, read back and traversal,
+ *  each reported in model time with the block device counters.
+ *
+ *  The host has 8 bit chars where the C28x has 16 bit ones, littlefs runs
+ *  on bytes here. bd_read() and bd_prog() put one byte in each flash word,
+ *  so offsets and sizes stay those of the target.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "cpu1_hal.h"
+#include "ext_flash.h"
+#include "lfs.h"
+#include "lfs_api.h"
+
+#define PIN_FLASH_A19       91
+#define BLOCK_WORDS         0x8000
+/* flash word address of a littlefs block, the first sector is not used */
+#define FLASH(block, off)   (BLOCK_WORDS * ((block) + 1) + (off))
+#define CHUNK               128         /* words per callback from the shims */
+
+#define FILES               4
+#define FILE_BYTES          0x4000
+
+static const nor_flash_stats_t *nor;
+
+static void start(void)
+{
+    nor_flash_config_t config;
+
+    nor_flash_default_config(&config);
+    config.writeBufferWords = 32;
+    host_cpu1_init(&config);
+    nor = nor_flash_stats();
+
+    ext_flash_reset();
+    ext_flash_config();
+    memset(&lfs_api_bd_stats, 0, sizeof(lfs_api_bd_stats));
+}
+
+static void test_block_device(void)
+{
+    const struct lfs_config *c = &ext_flash_lfs_config;
+    static uint16_t data[CHUNK], back[CHUNK];
+    uint32_t writes;
+    uint32_t bufferPrograms;
+
+    start();
+    for (int i = 0; i < CHUNK; i++) {
+        data[i] = 0x1500 + i;
+    }
+
+    /* block 15 is the first one above A19 */
+    CHECK_EQ(lfs_api_block_device_erase(c, 15), LFS_ERR_OK);
+    CHECK_EQ(nor->sectorErases[nor_flash_sector(FLASH(15, 0))], 1);
+    CHECK_EQ(nor->sectorErases[nor_flash_sector(FLASH(15, 0) - 0x80000)], 0);
+    CHECK_EQ(lfs_api_bd_stats.erases, 1);
+
+    /* a write buffer page per 32 words, no word programs */
+    CHECK_EQ(lfs_api_block_device_prog(c, 15, 0x40, data, CHUNK), LFS_ERR_OK);
+    CHECK_EQ(nor->bufferPrograms, CHUNK / 32);
+    CHECK_EQ(nor->wordPrograms, 0);
+    CHECK_EQ(nor_flash_peek(FLASH(15, 0x40)), 0x1500);
+    CHECK_EQ(nor_flash_peek(FLASH(15, 0x40 + CHUNK - 1)), 0x1500 + CHUNK - 1);
+    CHECK_EQ(nor_flash_peek(FLASH(15, 0x40) - 0x80000), 0xFFFF);
+
+    /* one A19 write for the run, where the word reads set it for each word */
+    writes = host_gpio_writes(PIN_FLASH_A19);
+    CHECK_EQ(lfs_api_block_device_read(c, 15, 0x40, back, CHUNK), LFS_ERR_OK);
+    CHECK_EQ(host_gpio_writes(PIN_FLASH_A19) - writes, 1);
+    CHECK(memcmp(data, back, sizeof(back)) == 0);
+    writes = host_gpio_writes(PIN_FLASH_A19);
+    for (int i = 0; i < CHUNK; i++) {
+        back[i] = ext_flash_read_word(EXT_FLASH_START_ADDRESS_CS3 + FLASH(15, 0x40 + i));
+    }
+    CHECK_EQ(host_gpio_writes(PIN_FLASH_A19) - writes, CHUNK);
+    CHECK(memcmp(data, back, sizeof(back)) == 0);
+    CHECK_EQ(lfs_api_bd_stats.reads, 1);
+    CHECK_EQ(lfs_api_bd_stats.readWords, CHUNK);
+
+    /* programmed words are refused, the device does not hang */
+    bufferPrograms = nor->bufferPrograms;
+    CHECK_EQ(lfs_api_block_device_prog(c, 15, 0x40, data, 32), LFS_ERR_CORRUPT);
+    CHECK_EQ(nor->bufferPrograms, bufferPrograms);
+    CHECK_EQ(nor->programFailures, 0);
+    CHECK(ext_flash_ready());
+
+    /* the lower half is untouched by the upper */
+    CHECK_EQ(lfs_api_block_device_erase(c, 14), LFS_ERR_OK);
+    CHECK_EQ(lfs_api_block_device_prog(c, 14, 0, data, 32), LFS_ERR_OK);
+    CHECK_EQ(nor_flash_peek(FLASH(14, 0)), 0x1500);
+    CHECK_EQ(nor_flash_peek(FLASH(15, 0x40)), 0x1500);
+}
+
+/*** littlefs on bytes, one per flash word ***/
+
+static int bd_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    uint16_t words[CHUNK];
+    uint8_t *dst = buffer;
+    lfs_size_t n;
+    int err;
+
+    for (lfs_size_t done = 0; done < size; done += n) {
+        n = (size - done < CHUNK) ? size - done : CHUNK;
+        if ((err = lfs_api_block_device_read(c, block, off + done, words, n)) != LFS_ERR_OK) {
+            return err;
+        }
+        for (lfs_size_t i = 0; i < n; i++) {
+            dst[done + i] = (uint8_t)words[i];
+        }
+    }
+    return LFS_ERR_OK;
+}
+
+static int bd_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    uint16_t words[CHUNK];
+    const uint8_t *src = buffer;
+    lfs_size_t n;
+    int err;
+
+    for (lfs_size_t done = 0; done < size; done += n) {
+        n = (size - done < CHUNK) ? size - done : CHUNK;
+        for (lfs_size_t i = 0; i < n; i++) {
+            words[i] = src[done + i];
+        }
+        if ((err = lfs_api_block_device_prog(c, block, off + done, words, n)) != LFS_ERR_OK) {
+            return err;
+        }
+    }
+    return LFS_ERR_OK;
+}
+
+static struct lfs_config config;
+static lfs_t lfs;
+static uint64_t stepStart;
+
+static void step_start(void)
+{
+    memset(&lfs_api_bd_stats, 0, sizeof(lfs_api_bd_stats));
+    stepStart = host_time_ns();
+}
+
+static void step_result(const char *step)
+{
+    const lfs_api_bd_stats_t *s = &lfs_api_bd_stats;
+
+    printf("lfs %-8s %7.1f ms: %4lu reads %7lu words, %4lu progs %6lu words, %2lu erases\n", step,
+           (host_time_ns() - stepStart) / 1e6, (unsigned long)s->reads, (unsigned long)s->readWords,
+           (unsigned long)s->progs, (unsigned long)s->progWords, (unsigned long)s->erases);
+    /* whole write buffer pages only */
+    CHECK_EQ(s->progWords % config.prog_size, 0);
+}
+
+static int count_block(void *data, lfs_block_t block)
+{
+    (void)block;
+    (*(uint32_t *)data)++;
+    return 0;
+}
+
+static void test_littlefs(void)
+{
+    static uint8_t buffer[256];
+    lfs_file_t file;
+    struct lfs_info info;
+    char name[16];
+    uint32_t blocks = 0;
+    int bad = 0;
+
+    start();
+    config = ext_flash_lfs_config;
+    config.read = bd_read;
+    config.prog = bd_prog;
+
+    step_start();
+    CHECK_EQ(lfs_format(&lfs, &config), 0);
+    step_result("format");
+    step_start();
+    CHECK_EQ(lfs_mount(&lfs, &config), 0);
+    step_result("mount");
+
+    step_start();
+    for (int f = 0; f < FILES; f++) {
+        snprintf(name, sizeof(name), "bench_%d", f);
+        CHECK_EQ(lfs_file_open(&lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC), 0);
+        CHECK_EQ(lfs_file_close(&lfs, &file), 0);
+    }
+    step_result("create");
+
+    step_start();
+    CHECK_EQ(lfs_file_open(&lfs, &file, "bench_0", LFS_O_WRONLY | LFS_O_APPEND), 0);
+    for (int done = 0; done < FILE_BYTES; done += sizeof(buffer)) {
+        for (unsigned i = 0; i < sizeof(buffer); i++) {
+            buffer[i] = (uint8_t)((done + i) * 7);
+        }
+        CHECK_EQ(lfs_file_write(&lfs, &file, buffer, sizeof(buffer)), sizeof(buffer));
+    }
+    CHECK_EQ(lfs_file_close(&lfs, &file), 0);
+    step_result("append");
+
+    /* everything from the flash again */
+    CHECK_EQ(lfs_unmount(&lfs), 0);
+    CHECK_EQ(lfs_mount(&lfs, &config), 0);
+
+    step_start();
+    CHECK_EQ(lfs_file_open(&lfs, &file, "bench_0", LFS_O_RDONLY), 0);
+    CHECK_EQ(lfs_file_size(&lfs, &file), FILE_BYTES);
+    for (int done = 0; done < FILE_BYTES; done += sizeof(buffer)) {
+        CHECK_EQ(lfs_file_read(&lfs, &file, buffer, sizeof(buffer)), sizeof(buffer));
+        for (unsigned i = 0; i < sizeof(buffer); i++) {
+            bad += buffer[i] != (uint8_t)((done + i) * 7);
+        }
+    }
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(lfs_file_close(&lfs, &file), 0);
+    step_result("read");
+    /* the file and its skip list, read in cache sized runs */
+    CHECK(lfs_api_bd_stats.readWords < FILE_BYTES * 11 / 10);
+    CHECK(lfs_api_bd_stats.reads < 2 * FILE_BYTES / config.cache_size);
+
+    step_start();
+    CHECK_EQ(lfs_fs_traverse(&lfs, count_block, &blocks), 0);
+    step_result("traverse");
+    CHECK(blocks >= 2 + FILE_BYTES / BLOCK_WORDS);
+    CHECK(blocks < config.block_count);
+
+    for (int f = 0; f < FILES; f++) {
+        snprintf(name, sizeof(name), "bench_%d", f);
+        CHECK_EQ(lfs_stat(&lfs, name, &info), 0);
+        CHECK_EQ(info.size, (f == 0) ? FILE_BYTES : 0);
+        CHECK_EQ(lfs_remove(&lfs, name), 0);
+    }
+    CHECK_EQ(lfs_unmount(&lfs), 0);
+
+    /* littlefs programs with the blocking page commands only */
+    CHECK_EQ(nor->wordPrograms, 0);
+    CHECK_EQ(nor->programFailures, 0);
+    CHECK_EQ(nor->commandErrors, 0);
+    printf("lfs: %lu blocks in use\n", (unsigned long)blocks);
+}
+
+int main(void)
+{
+    test_block_device();
+    test_littlefs();
+
+    return check_report("test_lfs");
+}
@@ -0,0 +1,652 @@
+/*
+ * test_log.c - the CAN log of log.c on ext_flash.c and the NOR flash model
+ *
+ *  Records are published the way CPU2 does it, see PublishDebugLog() in
+ *  dpmu_cpu2/app/src/debug_log.c, and the super loop runs
+ *  log_can_state_machine() and ext_flash_task() while the clock advances.
+ *  The log is read back through the CAN_LOG_READ domain as the SDO server
+ *  would, chunk by chunk with log_domain_prefetch() in between, and the
+ *  record stream decoded with can_log_codec.c.
+ *
+ *  The CANopen object dictionary is reduced to the CAN_LOG objects log.c
+ *  uses, the rest of the CANopen and EMIF interfaces are not reached.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "application_vars.h"
+#include "can_log_codec.h"
+#include "check.h"
+#include "check_CPU2.h"
+#include "co_canopen.h"
+#include "cpu1_hal.h"
+#include "device.h"
+#include "emifc.h"
+#include "ext_flash.h"
+#include "gen_define.h"
+#include "gen_indices.h"
+#include "log.h"
+#include "serial.h"
+#include "shared_variables.h"
+#include "temperature_sensor.h"
+
+/* gen_define.h takes printf() out of the firmware */
+#undef printf
+
+#define REGION          (CAN_LOG_ADDRESS_START - EXT_FLASH_START_ADDRESS_CS3)
+#define REGION_SECTORS  ((CAN_LOG_ADDRESS_END - CAN_LOG_ADDRESS_START) / CAN_LOG_SECTOR_SIZE)
+#define CHUNK_BYTES     (7u * CO_SSDO_DOMAIN_CNT)
+#define FROM_OLDEST     0u
+#define FROM_CURSOR     0xFFFFFFFFu
+#define MAX_RECORDS     20000
+
+/*** what log.c needs of the rest of CPU1 ***/
+
+int debug_level = DEBUG_ERROR;
+int16_t temperatureSensorVector[4] = { 31, 32, 33, 34 };
+
+void AppVarsInformEntireFlashResetInitiated() {}
+void AppVarsInformEntireFlashResetReady() {}
+void cpu2_state_machine_stats_read_domain(uint32_t offset, uint32_t size) { (void)offset; (void)size; }
+
+/* the debug log in the external RAM is not tested here */
+void emifc_cpu_read_memory(EMIF1_Config *emif1) { (void)emif1; CHECK(false); }
+void emifc_set_flag(void *context) { *(volatile bool *)context = true; }
+bool emifc_queue_read(uint32_t address, uint16_t *data, uint32_t size, emifc_callback_t callback, void *context)
+{
+    (void)address; (void)data; (void)size; (void)callback; (void)context;
+    CHECK(false);
+    return false;
+}
+
+/* I_CAN_LOG subindexes */
+static UNSIGNED32 od_can_log[S_CAN_LOG_CURSOR + 1];
+static CO_DOMAIN_PTR od_domain;
+static UNSIGNED32 od_domain_size;
+
+RET_T coOdGetObj_u32(UNSIGNED16 index, UNSIGNED8 subIndex, UNSIGNED32 *pObj)
+{
+    CHECK_EQ(index, I_CAN_LOG);
+    *pObj = od_can_log[subIndex];
+    return RET_OK;
+}
+
+RET_T coOdPutObj_u32(UNSIGNED16 index, UNSIGNED8 subIndex, UNSIGNED32 newVal)
+{
+    CHECK_EQ(index, I_CAN_LOG);
+    od_can_log[subIndex] = newVal;
+    return RET_OK;
+}
+
+RET_T coOdPutObj_u8(UNSIGNED16 index, UNSIGNED8 subIndex, UNSIGNED8 newVal)
+{
+    (void)index; (void)subIndex; (void)newVal;
+    return RET_OK;
+}
+
+RET_T coOdDomainAddrSet(UNSIGNED16 index, UNSIGNED8 subIndex, CO_DOMAIN_PTR pAddr, UNSIGNED32 size)
+{
+    CHECK_EQ(index, I_CAN_LOG);
+    CHECK_EQ(subIndex, S_CAN_LOG_READ);
+    od_domain = pAddr;
+    od_domain_size = size;
+    return RET_OK;
+}
+
+RET_T coSdoServerReadIndCont(UNSIGNED8 sdoNr, RET_T result)
+{
+    (void)sdoNr; (void)result;
+    return RET_OK;
+}
+
+/* getObjData(), not called for the CAN log */
+RET_T coOdGetObjH_u8(CO_CONST CO_OD_HANDLE_T *pHandle, UNSIGNED8 *pObj) { (void)pHandle; (void)pObj; return RET_OK; }
+RET_T coOdGetObjH_u16(CO_CONST CO_OD_HANDLE_T *pHandle, UNSIGNED16 *pObj) { (void)pHandle; (void)pObj; return RET_OK; }
+RET_T coOdGetObjH_u32(CO_CONST CO_OD_HANDLE_T *pHandle, UNSIGNED32 *pObj) { (void)pHandle; (void)pObj; return RET_OK; }
+RET_T coOdGetObjH_i8(CO_CONST CO_OD_HANDLE_T *pHandle, INTEGER8 *pObj) { (void)pHandle; (void)pObj; return RET_OK; }
+RET_T coOdGetObjH_i16(CO_CONST CO_OD_HANDLE_T *pHandle, INTEGER16 *pObj) { (void)pHandle; (void)pObj; return RET_OK; }
+RET_T coOdGetObjH_i32(CO_CONST CO_OD_HANDLE_T *pHandle, INTEGER32 *pObj) { (void)pHandle; (void)pObj; return RET_OK; }
+RET_T coOdGetObjH_r32(CO_CONST CO_OD_HANDLE_T *pHandle, REAL32 *pObj) { (void)pHandle; (void)pObj; return RET_OK; }
+
+/*** test ***/
+
+static const nor_flash_stats_t *nor;
+static uint32_t counter;                    /* of the last record published */
+static debug_log_t records[MAX_RECORDS];    /* read back from the log */
+
+static void start(uint32_t sectorEraseNs)
+{
+    nor_flash_config_t config;
+
+    nor_flash_default_config(&config);
+    config.sectorEraseNs = sectorEraseNs;
+    host_cpu1_init(&config);
+    nor = nor_flash_stats();
+    memset(od_can_log, 0, sizeof(od_can_log));
+
+    ext_flash_reset();
+    ext_flash_config();
+    log_can_init();
+}
+
+/* the super loop for ms milliseconds */
+static void run(uint32_t ms)
+{
+    uint64_t end = host_time_ns() + 1000000ULL * ms;
+
+    while (host_time_ns() < end) {
+        log_can_state_machine();
+        ext_flash_task();
+        host_delay_us(100);
+    }
+}
+
+/* noisy enough for deltas of a few words, now and then a keyframe */
+static void publish(void)
+{
+    uint16_t next = sharedVars_cpu2toCpu1.debug_log.published ^ 1;
+    debug_log_t *log = &sharedVars_cpu2toCpu1.debug_log.record[next];
+    uint32_t noise = ++counter * 2654435761u;
+
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;
+
+    memset(log, 0, sizeof(*log));
+    log->counter = counter;
+    log->ISen1 = (int16_t)(1200 + (noise >> 28));
+    log->Vbus = (int16_t)(2400 + ((noise >> 20) & 0x3));
+    log->VStore = (int16_t)(counter / 3);
+    for (int c = 0; c < NUMBER_OF_CELLS; c++) {
+        log->cellVoltage[c] = (int16_t)(counter / 30 + c + ((noise >> c) & 1));
+    }
+    if (counter % 97 == 0) {
+        for (int c = 0; c < NUMBER_OF_CELLS; c++) {
+            log->cellVoltage[c] = (int16_t)(noise ^ (c * 0x9E37));
+        }
+    }
+    log->CurrentState = (int16_t)(counter % 5);
+    log->elapsed_time = (uint16_t)counter;
+    log->cpu2_error_code = (uint16_t)(counter >> 4);
+
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;
+    sharedVars_cpu2toCpu1.debug_log.published = next;
+}
+
+/* count records, one every periodMs, all written when it returns */
+static void publish_records(uint32_t count, uint32_t periodMs)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        publish();
+        run(periodMs);
+    }
+    run(20);
+}
+
+/* the fields of a record that CPU2 publishes, and the temperatures of CPU1 */
+static bool same_record(const debug_log_t *record, uint32_t n)
+{
+    uint32_t noise = n * 2654435761u;
+
+    if ((record->counter != n) || (record->MagicNumber != MAGIC_NUMBER) ||
+        (record->ISen1 != (int16_t)(1200 + (noise >> 28))) || (record->VStore != (int16_t)(n / 3)) ||
+        (record->CurrentState != (int16_t)(n % 5)) || (record->cpu2_error_code != (uint16_t)(n >> 4)) ||
+        (record->BaseBoardTemperature != 31) || (record->PowerBankBoardTemperature != 34)) {
+        return false;
+    }
+    for (int c = 0; c < NUMBER_OF_CELLS; c++) {
+        int16_t expected = (n % 97 == 0) ? (int16_t)(noise ^ (c * 0x9E37)) : (int16_t)(n / 30 + c + ((noise >> c) & 1));
+        if (record->cellVoltage[c] != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Uploads CAN_LOG_READ as the SDO server does and decodes the records into
+ * records[]. Returns the number of records, -1 if the stream does not decode.
+ */
+static int download(uint32_t from, uint32_t maxBytes, uint32_t *bytes)
+{
+    static uint16_t stream[CAN_LOG_SECTOR_SIZE * 16];
+    uint32_t size, sent, chunk;
+    uint32_t pos = 0;
+    int count = 0;
+    uint16_t header, words;
+
+    od_can_log[S_CAN_LOG_READ_FROM] = from;
+    od_can_log[S_CAN_LOG_READ_MAX] = maxBytes;
+    od_domain_size = 0;
+    (void)log_can_log_read(true, 1, I_CAN_LOG, S_CAN_LOG_READ);
+    size = od_domain_size;
+    *bytes = size;
+    CHECK(size <= sizeof(stream));
+
+    for (sent = 0; sent < size; sent += chunk) {
+        chunk = (size - sent < CHUNK_BYTES) ? size - sent : CHUNK_BYTES;
+        CHECK_EQ(log_read_domain(I_CAN_LOG, S_CAN_LOG_READ, CHUNK_BYTES, sent), RET_OK);
+        memcpy(&stream[sent / 2], (const void *)od_domain, (chunk + 1) / 2 * sizeof(uint16_t));
+        log_domain_prefetch();
+        log_domain_prefetch();
+    }
+    log_read_domain_finished(I_CAN_LOG, S_CAN_LOG_READ, size, RET_OK);
+
+    /* a keyframe first, then the records as stored */
+    while (pos < size / 2) {
+        header = stream[pos];
+        words = CAN_LOG_RECORD_WORDS(header);
+        if ((count == MAX_RECORDS) || (pos + 1 + words > size / 2)) {
+            return -1;
+        }
+        if (CAN_LOG_RECORD_TYPE(header) == CAN_LOG_RECORD_KEYFRAME) {
+            if (words != CAN_LOG_RECORD_RAW_WORDS) {
+                return -1;
+            }
+            memcpy(&records[count], &stream[pos + 1], sizeof(debug_log_t));
+        } else if ((CAN_LOG_RECORD_TYPE(header) == CAN_LOG_RECORD_DELTA) && (count > 0)) {
+            records[count] = records[count - 1];
+            if (!can_log_decode_delta(&stream[pos + 1], words, &records[count])) {
+                return -1;
+            }
+        } else {
+            return -1;
+        }
+        count++;
+        pos += 1 + words;
+    }
+    return count;
+}
+
+/* records[] holds count records from counter first on */
+static bool consecutive(int count, uint32_t first)
+{
+    for (int i = 0; i < count; i++) {
+        if (!same_record(&records[i], first + i)) {
+            fprintf(stderr, "record %d: counter %lu, expected %lu\n", i, (unsigned long)records[i].counter,
+                   (unsigned long)(first + i));
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t header_sequence(uint16_t sector)
+{
+    uint32_t address = REGION + (uint32_t)sector * CAN_LOG_SECTOR_SIZE;
+
+    return nor_flash_peek(address + 2) | ((uint32_t)nor_flash_peek(address + 3) << 16);
+}
+
+/*** the boot scan ***/
+
+typedef struct {
+    unsigned headerReads;
+    unsigned recordProbes;
+    double us;              /* model time of log_can_init() */
+} boot_scan_t;
+
+/* the stats line of name, from log_can_print_stats() */
+static const char *can_log_stats_line(const char *name)
+{
+    static char text[2048];
+    const char *line;
+
+    host_serial_capture(text, sizeof(text));
+    log_can_print_stats();
+    host_serial_capture(NULL, 0);
+    line = strstr(text, name);
+    CHECK(line != NULL);
+    return (line != NULL) ? line : "";
+}
+
+/* log_can_init() as at a reset, records the number of records in the log */
+static boot_scan_t boot_scan(const char *fill, uint32_t records)
+{
+    boot_scan_t s = { 0, 0, 0 };
+    unsigned long position = 0, found = 1;
+    uint64_t t0;
+
+    CHECK(sscanf(strstr(can_log_stats_line(" downloads:"), "position:"), "position: %lu", &position) == 1);
+    t0 = host_time_ns();
+    log_can_init();
+    s.us = (host_time_ns() - t0) / 1e3;
+
+    CHECK(sscanf(can_log_stats_line(" boot scan:"), " boot scan: %u header reads, %u record probes",
+                 &s.headerReads, &s.recordProbes) == 2);
+    /* the log goes on where it was written up to */
+    CHECK(sscanf(strstr(can_log_stats_line(" downloads:"), "position:"), "position: %lu", &found) == 1);
+    CHECK_EQ(found, position);
+
+    /* a word read per record would have been one bus cycle each */
+    printf("boot scan %s: %u header reads, %u record probes, %.0f us, %lu records, at least %.0f us reading each\n",
+           fill, s.headerReads, s.recordProbes, s.us, (unsigned long)records, records * HOST_BUS_CYCLE_NS / 1e3);
+    return s;
+}
+
+static void test_empty(void)
+{
+    uint32_t bytes;
+
+    start(50000000UL);
+    CHECK_EQ(download(FROM_OLDEST, 0, &bytes), 0);
+    CHECK_EQ(bytes, 0);
+    CHECK_EQ(nor_flash_peek(REGION), 0xFFFF);
+}
+
+static void test_records(void)
+{
+    uint32_t bytes;
+    int count;
+
+    publish_records(100, 10);
+
+    /* the first sector taken into use */
+    CHECK_EQ(nor_flash_peek(REGION), CAN_LOG_MAGIC);
+    CHECK_EQ(nor_flash_peek(REGION + 1), CAN_LOG_SECTOR_OPEN);
+    CHECK_EQ(header_sequence(0), 1);
+    CHECK_EQ(nor->sectorErases[nor_flash_sector(REGION)], 1);
+
+    count = download(FROM_OLDEST, 0, &bytes);
+    CHECK_EQ(count, 100);
+    CHECK(consecutive(count, 1));
+    /* mostly deltas */
+    CHECK(bytes < 100 * CAN_LOG_KEYFRAME_WORDS);
+    /* a log position, in the sector with sequence number 1 */
+    CHECK_EQ(od_can_log[S_CAN_LOG_CURSOR] / CAN_LOG_SECTOR_SIZE, 1);
+    CHECK(od_can_log[S_CAN_LOG_CURSOR] % CAN_LOG_SECTOR_SIZE >= CAN_LOG_SECTOR_HEADER_WORDS + bytes / 2);
+    CHECK_EQ(nor->commandErrors, 0);
+    CHECK_EQ(nor->programFailures, 0);
+}
+
+static void test_cursor(void)
+{
+    uint32_t bytes, limited;
+    int count;
+
+    /* nothing new */
+    CHECK_EQ(download(FROM_CURSOR, 0, &bytes), 0);
+
+    publish_records(30, 10);
+    count = download(FROM_CURSOR, 0, &bytes);
+    CHECK_EQ(count, 30);
+    CHECK(consecutive(count, 101));
+
+    /* whole records only, the rest on the next download */
+    publish_records(30, 10);
+    count = download(FROM_CURSOR, 2 * CAN_LOG_KEYFRAME_WORDS + 40, &limited);
+    CHECK(count > 0);
+    CHECK(count < 30);
+    CHECK(limited <= 2 * CAN_LOG_KEYFRAME_WORDS + 40);
+    CHECK(consecutive(count, 131));
+    limited = (uint32_t)count;
+    count = download(FROM_CURSOR, 0, &bytes);
+    CHECK_EQ(count + limited, 30);
+    CHECK(consecutive(count, 131 + limited));
+
+    /* an aborted upload leaves the cursor */
+    publish_records(5, 10);
+    od_can_log[S_CAN_LOG_READ_FROM] = FROM_CURSOR;
+    od_can_log[S_CAN_LOG_READ_MAX] = 0;
+    (void)log_can_log_read(true, 1, I_CAN_LOG, S_CAN_LOG_READ);
+    CHECK_EQ(log_read_domain(I_CAN_LOG, S_CAN_LOG_READ, CHUNK_BYTES, 0), RET_OK);
+    log_read_domain_finished(I_CAN_LOG, S_CAN_LOG_READ, 0, RET_SDO_TRANSFER_NOT_SUPPORTED);
+    count = download(FROM_CURSOR, 0, &bytes);
+    CHECK_EQ(count, 5);
+    CHECK(consecutive(count, 161));
+}
+
+/* as after a reset, the head of the log is found from the flash */
+static void test_remount(void)
+{
+    uint32_t bytes;
+    int count;
+
+    log_can_init();
+    publish_records(10, 10);
+
+    count = download(FROM_CURSOR, 0, &bytes);
+    CHECK_EQ(count, 10);
+    CHECK(consecutive(count, 166));
+
+    count = download(FROM_OLDEST, 0, &bytes);
+    CHECK_EQ(count, 175);
+    CHECK(consecutive(count, 1));
+}
+
+/* block upload at 125 kbit/s, 7 bytes in a frame of about 111 bits */
+static double bus_ms(uint32_t bytes)
+{
+    return (bytes + 6) / 7 * 111 / 125.0;
+}
+
+/* the bytes a tool downloads, against the whole region every time */
+static void test_polling(void)
+{
+    const uint32_t region = 2 * (CAN_LOG_ADDRESS_END - CAN_LOG_ADDRESS_START);
+    uint32_t bytes, total = 0, largest = 0;
+    int count, polls = 0, received = 0;
+
+    /* 10 records a second, polled every second since the last download */
+    for (int poll = 0; poll < 20; poll++) {
+        publish_records(10, 100);
+        count = download(FROM_CURSOR, 0, &bytes);
+        CHECK_EQ(count, 10);
+        CHECK(consecutive(count, counter - 9));
+        total += bytes;
+    }
+    CHECK(total / 20 < region / 1000);
+    printf("log polling: 20 polls of 10 records, %lu bytes, %.0f ms each, whole region %lu bytes, %.0f s\n",
+           (unsigned long)(total / 20), bus_ms(total / 20), (unsigned long)region, bus_ms(region) / 1000);
+
+    /* polls of at most 256 bytes catch up over several downloads */
+    publish_records(100, 10);
+    do {
+        count = download(FROM_CURSOR, 256, &bytes);
+        CHECK(bytes <= 256);
+        CHECK(count >= 0);
+        if (count > 0) {
+            CHECK(consecutive(count, counter - 99 + received));
+            received += count;
+            polls++;
+        }
+        largest = (bytes > largest) ? bytes : largest;
+    } while (count > 0);
+    CHECK_EQ(received, 100);
+    printf("log polling: 100 records in %d polls of at most 256 bytes, largest %lu\n", polls, (unsigned long)largest);
+
+    /* the whole log once, only the written part of the region */
+    count = download(FROM_OLDEST, 0, &bytes);
+    CHECK_EQ(count, counter);
+    CHECK(consecutive(count, 1));
+    CHECK(bytes < CAN_LOG_SECTOR_SIZE * sizeof(uint16_t));
+    printf("log polling: all %d records, %lu bytes\n", count, (unsigned long)bytes);
+}
+
+/* all sectors in use, the oldest one is erased for the next records */
+static void test_wrap(void)
+{
+    uint32_t bytes;
+    uint32_t last, oldest, next = 0;
+    uint32_t keyframe = REGION + CAN_LOG_SECTOR_SIZE + CAN_LOG_SECTOR_HEADER_WORDS + 1 +
+                        offsetof(debug_log_t, counter) / sizeof(uint16_t);
+    int count;
+
+    start(5000000UL);
+    counter = 0;
+
+    /* sector by sector, the records of a sector fit in the domain buffer */
+    while (header_sequence(0) != REGION_SECTORS + 1) {
+        publish_records(1000, 2);
+    }
+    last = counter;
+    for (uint16_t sector = 1; sector < REGION_SECTORS; sector++) {
+        CHECK_EQ(header_sequence(sector), sector + 1);
+        CHECK_EQ(nor_flash_peek(REGION + (uint32_t)sector * CAN_LOG_SECTOR_SIZE + 1), CAN_LOG_SECTOR_FULL);
+    }
+    CHECK_EQ(nor->sectorErases[nor_flash_sector(REGION)], 2);
+    CHECK_EQ(nor->sectorErases[nor_flash_sector(REGION + CAN_LOG_SECTOR_SIZE)], 1);
+
+    /* the oldest record is the keyframe starting the second sector */
+    oldest = nor_flash_peek(keyframe) | ((uint32_t)nor_flash_peek(keyframe + 1) << 16);
+    CHECK(oldest > 1);
+    count = download(FROM_OLDEST, 4 * CAN_LOG_SECTOR_SIZE, &bytes);
+    CHECK(count > 0);
+    CHECK(consecutive(count, oldest));
+
+    /* the cursor continues from there up to the latest record */
+    while (count > 0) {
+        next = records[count - 1].counter + 1;
+        count = download(FROM_CURSOR, 4 * CAN_LOG_SECTOR_SIZE, &bytes);
+        if (count > 0) {
+            CHECK(consecutive(count, next));
+        }
+    }
+    CHECK_EQ(next, last + 1);
+
+    /* a reset finds the head in sector 0 */
+    log_can_init();
+    publish_records(1, 2);
+    count = download(FROM_CURSOR, 0, &bytes);
+    CHECK_EQ(count, 1);
+    CHECK(consecutive(count, last + 1));
+    CHECK_EQ(header_sequence(0), REGION_SECTORS + 1);
+    CHECK_EQ(nor->commandErrors, 0);
+}
+
+/*** the stage ***/
+
+typedef struct {
+    unsigned long staged;
+    unsigned long written;
+    unsigned long dropped;
+    unsigned long flashErrors;
+    unsigned long passes;
+    unsigned backlog;
+    unsigned stage;         /* records it takes */
+    unsigned maxBacklog;
+} stage_stats_t;
+
+static stage_stats_t stage_stats(void)
+{
+    stage_stats_t s;
+
+    memset(&s, 0, sizeof(s));
+    CHECK(sscanf(can_log_stats_line(" staged:"), " staged: %lu, written: %lu, dropped: %lu, flash errors: %lu, programming passes: %lu"
+                       " backlog: %u/%u records, max: %u",
+                 &s.staged, &s.written, &s.dropped, &s.flashErrors, &s.passes,
+                 &s.backlog, &s.stage, &s.maxBacklog) == 8);
+    return s;
+}
+
+/*
+ * A record published every pass of a super loop that takes passUs besides
+ * the log, for ms milliseconds. Returns the records written per second.
+ */
+static double offer(uint32_t passUs, uint32_t ms, stage_stats_t *s)
+{
+    stage_stats_t before = stage_stats();
+    uint64_t t0 = host_time_ns();
+    uint32_t published = 0;
+
+    while (host_time_ns() - t0 < 1000000ULL * ms) {
+        publish();
+        published++;
+        log_can_state_machine();
+        ext_flash_task();
+        host_delay_us(passUs);
+    }
+    *s = stage_stats();
+    s->staged -= before.staged;
+    s->written -= before.written;
+    s->dropped -= before.dropped;
+    s->flashErrors -= before.flashErrors;
+    CHECK_EQ(s->staged + s->dropped, published);
+    return s->written * 1e3 / ms;
+}
+
+static void test_stage(void)
+{
+    const uint32_t recordWords = sizeof(debug_log_t) / sizeof(uint16_t);
+    stage_stats_t s;
+    double rate, wordPerPass;
+
+    start(5000000UL);
+    counter = 0;
+    publish_records(1, 10);
+
+    /* a loop busy for 5 ms a pass, one word a pass would be a record every
+     * recordWords passes, the stage writes the record of every pass and
+     * holds the records that come during a sector change */
+    rate = offer(5000, 8000, &s);
+    CHECK_EQ(s.dropped, 0);
+    CHECK(s.staged - s.written <= s.backlog);
+    CHECK(s.maxBacklog < s.stage);
+    CHECK_EQ(s.flashErrors, 0);
+    printf("can log: %.0f records/s written, passes of 5 ms, max backlog %u\n", rate, s.maxBacklog);
+
+    /* a record every pass of 50 us is more than the flash takes, the
+     * stage fills up and the rest is dropped and counted */
+    rate = offer(50, 1000, &s);
+    CHECK(s.dropped > 0);
+    CHECK_EQ(s.maxBacklog, s.stage);
+    /* one word per pass would have been a record every recordWords passes */
+    wordPerPass = 1e6 / (50.0 * recordWords);
+    CHECK(rate > 4 * wordPerPass);
+    printf("can log: %.0f records/s sustained, %lu dropped, one word per pass %.0f records/s\n",
+           rate, s.dropped, wordPerPass);
+
+    /* what was staged is in the log, in order */
+    run(100);
+    s = stage_stats();
+    CHECK_EQ(s.backlog, 0);
+    CHECK_EQ(s.staged, s.written);
+    CHECK_EQ(nor->programFailures, 0);
+    CHECK_EQ(nor->commandErrors, 0);
+}
+
+/* the head is found at every fill level with a few reads, not a walk over the records */
+static void test_boot_scan(void)
+{
+    boot_scan_t empty, half, wrapped;
+
+    start(5000000UL);
+    counter = 0;
+    empty = boot_scan("empty", 0);
+
+    while (header_sequence(REGION_SECTORS / 2) == 0xFFFFFFFFu) {
+        publish_records(1000, 2);
+    }
+    half = boot_scan("half full", counter);
+
+    while (header_sequence(0) == 1) {
+        publish_records(1000, 2);
+    }
+    wrapped = boot_scan("wrapped", counter);
+
+    /* every header when empty, a binary search over the sectors and one
+     * within the head sector otherwise */
+    CHECK_EQ(empty.headerReads, REGION_SECTORS + 1);
+    CHECK_EQ(empty.recordProbes, 0);
+    CHECK(half.headerReads <= 8);
+    CHECK(wrapped.headerReads <= 8);
+    CHECK(half.recordProbes <= 8 + CAN_LOG_BLOCK_WORDS / 8);
+    CHECK(wrapped.recordProbes <= 8 + CAN_LOG_BLOCK_WORDS / 8);
+    CHECK(wrapped.us < 2 * half.us);
+    CHECK(half.us * 1e3 < counter * HOST_BUS_CYCLE_NS);
+}
+
+int main(void)
+{
+    test_empty();
+    test_records();
+    test_cursor();
+    test_remount();
+    test_polling();
+    test_wrap();
+    test_stage();
+    test_boot_scan();
+
+    return check_report("test_log");
+}
@@ -0,0 +1,196 @@
+/*
+ * test_od.c - object dictionary access by handle, co_odaccess.c
+ *
+ *  The DPMU object dictionary of gen_objdict.c with the stack set up as in
+ *  co_init(). Every object found searching all indices and subindices has
+ *  to give a handle to its own description, a value written by handle
+ *  reads back by index and the other way round, the type and not found
+ *  errors are those of the search. Last the reads per second of the
+ *  objects CPU1 writes every pass, the state and the SoH of the bank and
+ *  the cells, by index and by handle, and the searches per second over
+ *  every index of the dictionary.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* before gen_define.h, check_report() prints */
+#include "check.h"
+
+/* the stack configuration before the stack headers, as in co.c */
+#include "gen_define.h"
+
+#include "co_canopen.h"
+#include "gen_indices.h"
+#include "canopen/codrv/vbus/codrv_cpu_linux.h"
+
+/* gen_define.h turns the stack's printf() off */
+#undef printf
+
+#define HOT_OBJECTS     32
+#define READS           2000000L
+
+static uint16_t hotIndex[HOT_OBJECTS];
+static uint8_t hotSubIndex[HOT_OBJECTS];
+static CO_OD_HANDLE_T hot[HOT_OBJECTS];
+
+static uint64_t real_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint16_t odIndex[256];
+static int odIndices;
+
+/* every subindex of every index */
+static void test_all_objects(void)
+{
+    CO_CONST CO_OBJECT_DESC_T *pDesc, *pLast = NULL;
+    CO_OD_HANDLE_T handle;
+    uint32_t objects = 0, u32ByIndex, u32ByHandle;
+    int wrong = 0;
+
+    for (uint32_t index = 0; index <= 0xFFFF; index++) {
+        for (uint32_t subIndex = 0; subIndex <= 0xFF; subIndex++) {
+            if (coOdGetObjDescPtr(index, subIndex, &pDesc) != RET_OK) {
+                if (subIndex == 0) {
+                    break;
+                }
+                continue;
+            }
+            if (subIndex == 0 && odIndices < 256) {
+                odIndex[odIndices++] = index;
+            }
+            /* the descriptions are in index and subindex order */
+            wrong += (pDesc->subIndex != subIndex) || (pDesc <= pLast);
+            pLast = pDesc;
+
+            if (coOdGetObjHandle(index, subIndex, &handle) != RET_OK) {
+                wrong++;
+                continue;
+            }
+            wrong += (handle.pDesc != pDesc) || (handle.index != index) || (handle.subIndex != subIndex);
+
+            /* the same value and error both ways */
+            u32ByIndex = 0x12345678;
+            u32ByHandle = 0x12345678;
+            wrong += coOdGetObj_u32(index, subIndex, &u32ByIndex) != coOdGetObjH_u32(&handle, &u32ByHandle);
+            wrong += u32ByIndex != u32ByHandle;
+            objects++;
+        }
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK(odIndices > 0 && odIndices < 256);
+    printf("od: %lu objects in %d indices\n", (unsigned long)objects, odIndices);
+}
+
+static void test_hot_objects(void)
+{
+    uint8_t value;
+
+    hotIndex[0] = I_DPMU_STATE;
+    hotSubIndex[0] = S_DPMU_OPERATION_CURRENT_STATE;
+    hotIndex[1] = I_ENERGY_BANK_SUMMARY;
+    hotSubIndex[1] = S_STATE_OF_HEALTH_OF_ENERGY_BANK;
+    for (int i = 2; i < HOT_OBJECTS; i++) {
+        hotIndex[i] = I_ENERGY_CELL_SUMMARY;
+        hotSubIndex[i] = S_STATE_OF_HEALTH_OF_ENERGY_CELL_01 + i - 2;
+    }
+
+    for (int i = 0; i < HOT_OBJECTS; i++) {
+        CHECK_EQ(coOdGetObjHandle(hotIndex[i], hotSubIndex[i], &hot[i]), RET_OK);
+
+        /* written by handle, read by index and back */
+        CHECK_EQ(coOdPutObjH_u8(&hot[i], 40 + i), RET_OK);
+        CHECK_EQ(coOdGetObj_u8(hotIndex[i], hotSubIndex[i], &value), RET_OK);
+        CHECK_EQ(value, 40 + i);
+        CHECK_EQ(coOdPutObj_u8(hotIndex[i], hotSubIndex[i], 80 + i), RET_OK);
+        CHECK_EQ(coOdGetObjH_u8(&hot[i], &value), RET_OK);
+        CHECK_EQ(value, 80 + i);
+
+        /* the wrong type fails the same way */
+        CHECK_EQ(coOdPutObjH_u32(&hot[i], 1), coOdPutObj_u32(hotIndex[i], hotSubIndex[i], 1));
+        CHECK(coOdPutObjH_u32(&hot[i], 1) != RET_OK);
+    }
+}
+
+static void test_not_found(void)
+{
+    CO_OD_HANDLE_T handle = hot[0];
+    uint8_t value;
+
+    CHECK(coOdGetObjHandle(0x7777, 0, &handle) != RET_OK);
+    CHECK(handle.pDesc == NULL);
+    CHECK_EQ(coOdGetObjH_u8(&handle, &value), RET_IDX_NOT_FOUND);
+    CHECK_EQ(coOdPutObjH_u8(&handle, 1), RET_IDX_NOT_FOUND);
+
+    /* a subindex past the last one of an object that is there */
+    CHECK(coOdGetObjHandle(I_ENERGY_CELL_SUMMARY, 0xFE, &handle) != RET_OK);
+    CHECK(handle.pDesc == NULL);
+}
+
+static void test_reads_per_second(void)
+{
+    volatile uint8_t sink;
+    uint8_t value = 0;
+    uint64_t t;
+    double byIndex, byHandle, allByIndex;
+    long reads = 0;
+
+    t = real_ns();
+    for (long n = 0; n < READS / HOT_OBJECTS; n++) {
+        for (int i = 0; i < HOT_OBJECTS; i++) {
+            coOdGetObj_u8(hotIndex[i], hotSubIndex[i], &value);
+            sink = value;
+        }
+    }
+    byIndex = READS * 1e9 / (real_ns() - t);
+
+    t = real_ns();
+    for (long n = 0; n < READS / HOT_OBJECTS; n++) {
+        for (int i = 0; i < HOT_OBJECTS; i++) {
+            coOdGetObjH_u8(&hot[i], &value);
+            sink = value;
+        }
+    }
+    byHandle = READS * 1e9 / (real_ns() - t);
+
+    /* the search over the whole dictionary, subindex 0 of each index */
+    t = real_ns();
+    while (reads < READS) {
+        for (int i = 0; i < odIndices; i++) {
+            CO_CONST CO_OBJECT_DESC_T *pDesc;
+
+            coOdGetObjDescPtr(odIndex[i], 0, &pDesc);
+        }
+        reads += odIndices;
+    }
+    allByIndex = reads * 1e9 / (real_ns() - t);
+    (void)sink;
+
+    CHECK(byHandle > 1.5 * byIndex);
+    printf("od: %.1f M reads/s by index, %.1f M by handle, %.1f M searches/s over all indices\n",
+           byIndex / 1e6, byHandle / 1e6, allByIndex / 1e6);
+}
+
+int main(void)
+{
+    codrvHardwareInit();
+    if (codrvCanInit(250) != RET_OK || coCanOpenStackInit(NULL) != RET_OK) {
+        fprintf(stderr, "stack init failed\n");
+        return 1;
+    }
+
+    test_all_objects();
+    test_hot_objects();
+    test_not_found();
+    test_reads_per_second();
+
+    return check_report("test_od");
+}
@@ -0,0 +1,338 @@
+/*
+ * test_param_store.c - param_store.c on ext_flash.c and the NOR flash model
+ *
+ *  The store runs from the super loop as on the target: param_store_task()
+ *  and ext_flash_task() called in turn while the clock advances. A remount
+ *  rebuilds the values from the flash alone, as after a reset. Torn records
+ *  and failed programs are made by writing the model's array directly.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "cpu1_hal.h"
+#include "device.h"
+#include "ext_flash.h"
+#include "param_store.h"
+
+#define SECTOR_A        (PARAM_STORE_SECTOR_A_ADDRESS - EXT_FLASH_START_ADDRESS_CS3)
+#define SECTOR_B        (PARAM_STORE_SECTOR_B_ADDRESS - EXT_FLASH_START_ADDRESS_CS3)
+#define MAGIC           0x4B56
+#define HEADER_WORDS    4
+#define CAPACITANCE_WORDS (sizeof(param_capacitance_t) / sizeof(uint16_t))
+
+static const nor_flash_stats_t *nor;
+
+static void start(void)
+{
+    nor_flash_config_t config;
+
+    nor_flash_default_config(&config);
+    config.sectorEraseNs = 50000000UL;
+    host_cpu1_init(&config);
+    nor = nor_flash_stats();
+
+    ext_flash_reset();
+    ext_flash_config();
+}
+
+/* the super loop until every value set is committed, false after maxMs */
+static bool run(uint32_t maxMs)
+{
+    uint64_t end = host_time_ns() + 1000000ULL * maxMs;
+
+    while (host_time_ns() < end) {
+        ext_flash_task();
+        param_store_task();
+        if (param_store_committed() && ext_flash_idle()) {
+            return true;
+        }
+        host_delay_us(50);
+    }
+    return false;
+}
+
+/* as after a reset, the values are read back from flash */
+static void remount(void)
+{
+    param_store_suspend(true);
+    param_store_suspend(false);
+    CHECK(!param_store_mounted());
+    CHECK(run(100));
+    CHECK(param_store_mounted());
+}
+
+static uint32_t free_address(uint32_t sector)
+{
+    uint32_t address = sector + HEADER_WORDS;
+
+    while ((address < sector + PARAM_STORE_SECTOR_SIZE) && (nor_flash_peek(address) != 0xFFFF)) {
+        address += (nor_flash_peek(address) & 0xFF) + 2;
+    }
+    return address;
+}
+
+static uint32_t generation(uint32_t sector)
+{
+    return nor_flash_peek(sector + 2) | ((uint32_t)nor_flash_peek(sector + 3) << 16);
+}
+
+static void set_capacitance(float initial, float current)
+{
+    param_capacitance_t capacitance = { initial, current };
+
+    CHECK(param_store_set(PARAM_KEY_CAPACITANCE, &capacitance));
+}
+
+static void check_capacitance(float initial, float current)
+{
+    param_capacitance_t capacitance = { 0, 0 };
+
+    CHECK(param_store_get(PARAM_KEY_CAPACITANCE, &capacitance));
+    CHECK_NEAR(capacitance.initialCapacitance, initial, 0);
+    CHECK_NEAR(capacitance.currentCapacitance, current, 0);
+}
+
+static void test_blank(void)
+{
+    unsigned char serial[SERIAL_NUMBER_SIZE_IN_CHARS];
+    unsigned char back[SERIAL_NUMBER_SIZE_IN_CHARS];
+    param_capacitance_t capacitance;
+    uint32_t compactions = param_store_stats.compactions;
+
+    start();
+    remount();
+    CHECK(!param_store_get(PARAM_KEY_CAPACITANCE, &capacitance));
+    CHECK(!param_store_get(PARAM_KEY_SERIAL_NUMBER, back));
+    CHECK(!param_store_stats.imported);
+
+    for (int i = 0; i < SERIAL_NUMBER_SIZE_IN_CHARS; i++) {
+        serial[i] = (unsigned char)('A' + i);
+    }
+    set_capacitance(1000.0f, 950.5f);
+    CHECK(param_store_set(PARAM_KEY_SERIAL_NUMBER, serial));
+    CHECK(!param_store_committed());
+    CHECK(run(500));
+
+    /* no sector yet, the first write is a compaction to sector A */
+    CHECK_EQ(param_store_stats.compactions, compactions + 1);
+    CHECK_EQ(nor_flash_peek(SECTOR_A), MAGIC);
+    CHECK_EQ(generation(SECTOR_A), 1);
+    CHECK_EQ(nor_flash_peek(SECTOR_B), 0xFFFF);
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA2], 1);
+
+    remount();
+    CHECK_EQ(param_store_stats.mountRecords, 2);
+    check_capacitance(1000.0f, 950.5f);
+    memset(back, 0, sizeof(back));
+    CHECK(param_store_get(PARAM_KEY_SERIAL_NUMBER, back));
+    CHECK(memcmp(back, serial, sizeof(serial)) == 0);
+    CHECK_EQ(nor->commandErrors, 0);
+}
+
+static void test_update(void)
+{
+    uint32_t records = param_store_stats.records;
+    uint32_t address = free_address(SECTOR_A);
+
+    set_capacitance(1000.0f, 940.25f);
+    CHECK(run(100));
+    CHECK_EQ(param_store_stats.records, records + 1);
+    CHECK_EQ(free_address(SECTOR_A), address + CAPACITANCE_WORDS + 2);
+    CHECK_EQ(nor_flash_peek(address), (PARAM_KEY_CAPACITANCE << 8) | CAPACITANCE_WORDS);
+
+    /* the same value again does not touch the flash */
+    set_capacitance(1000.0f, 940.25f);
+    CHECK(param_store_committed());
+    CHECK(run(100));
+    CHECK_EQ(param_store_stats.records, records + 1);
+
+    remount();
+    check_capacitance(1000.0f, 940.25f);
+    CHECK_EQ(param_store_stats.mountRecords, 3);
+    CHECK(param_store_stats.lastCommitMs < 2);
+}
+
+static void test_compaction(void)
+{
+    uint32_t compactions = param_store_stats.compactions;
+    unsigned char back[SERIAL_NUMBER_SIZE_IN_CHARS];
+
+    /* a sector holds some 680 capacitance records */
+    for (int i = 0; i < 800; i++) {
+        set_capacitance(1000.0f, (float)i);
+        CHECK(run(200));
+    }
+    CHECK_EQ(param_store_stats.compactions, compactions + 1);
+    CHECK_EQ(nor_flash_peek(SECTOR_B), MAGIC);
+    CHECK_EQ(generation(SECTOR_B), 2);
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA3], 1);
+
+    remount();
+    check_capacitance(1000.0f, 799.0f);
+    CHECK(param_store_get(PARAM_KEY_SERIAL_NUMBER, back));
+    CHECK_EQ(back[0], 'A');
+    CHECK_EQ(back[SERIAL_NUMBER_SIZE_IN_CHARS - 1], 'A' + SERIAL_NUMBER_SIZE_IN_CHARS - 1);
+
+    /* back to sector A, erased again, the higher generation wins */
+    for (int i = 0; i < 800; i++) {
+        set_capacitance(2000.0f, (float)i);
+        CHECK(run(200));
+    }
+    CHECK_EQ(param_store_stats.compactions, compactions + 2);
+    CHECK_EQ(generation(SECTOR_A), 3);
+    CHECK_EQ(nor->sectorErases[EXT_FLASH_SA2], 2);
+    remount();
+    check_capacitance(2000.0f, 799.0f);
+    CHECK_EQ(param_store_stats.verifyErrors, 0);
+    CHECK_EQ(nor->programFailures, 0);
+}
+
+static void test_torn_record(void)
+{
+    uint32_t address;
+    uint16_t records;
+
+    start();
+    remount();
+    set_capacitance(10.0f, 9.0f);
+    CHECK(run(500));
+    remount();
+    records = param_store_stats.mountRecords;
+
+    /* a reset between the value and the commit word */
+    address = free_address(SECTOR_A);
+    nor_flash_poke(address, (PARAM_KEY_CAPACITANCE << 8) | CAPACITANCE_WORDS);
+    for (uint16_t i = 0; i < CAPACITANCE_WORDS; i++) {
+        nor_flash_poke(address + 1 + i, 0x1234);
+    }
+    remount();
+    check_capacitance(10.0f, 9.0f);
+    CHECK_EQ(param_store_stats.mountRecords, records + 1);
+
+    /* the next record goes behind the torn one */
+    set_capacitance(10.0f, 8.0f);
+    CHECK(run(100));
+    CHECK_EQ(free_address(SECTOR_A), address + 2 * (CAPACITANCE_WORDS + 2));
+    remount();
+    check_capacitance(10.0f, 8.0f);
+}
+
+static void test_program_failure(void)
+{
+    uint32_t errors = param_store_stats.errors;
+    uint32_t compactions = param_store_stats.compactions;
+    uint32_t address = free_address(SECTOR_A);
+
+    /* the space of the next record is not erased */
+    nor_flash_poke(address + 2, 0x0000);
+    set_capacitance(10.0f, 7.0f);
+    CHECK(run(500));
+
+    /* the rest of the sector is given up, the value goes to sector B */
+    CHECK_EQ(param_store_stats.errors, errors + 1);
+    CHECK_EQ(param_store_stats.compactions, compactions + 1);
+    CHECK_EQ(nor_flash_peek(SECTOR_B), MAGIC);
+    CHECK_EQ(nor->programFailures, 0);
+    remount();
+    check_capacitance(10.0f, 7.0f);
+}
+
+static void test_import(void)
+{
+    app_vars_t appVars[2];
+    uint16_t words[sizeof(appVars) / (sizeof(uint16_t))];
+    unsigned char back[SERIAL_NUMBER_SIZE_IN_CHARS];
+
+    start();
+
+    /* two records of the old app_vars_t log, the latter one counts */
+    memset(appVars, 0, sizeof(appVars));
+    appVars[0].MagicNumber = MAGIC_NUMBER;
+    appVars[0].initialCapacitance = 100.0f;
+    appVars[0].currentCapacitance = 90.0f;
+    appVars[1].MagicNumber = MAGIC_NUMBER;
+    appVars[1].initialCapacitance = 100.0f;
+    appVars[1].currentCapacitance = 85.0f;
+    memcpy(appVars[1].serialNumber, "SN-4711", 7);
+    memcpy(words, appVars, sizeof(appVars));
+    for (uint16_t i = 0; i < sizeof(words) / sizeof(uint16_t); i++) {
+        nor_flash_poke(APP_VARS_EXT_FLASH_ADDRESS_START - EXT_FLASH_START_ADDRESS_CS3 + i, words[i]);
+    }
+
+    remount();
+    CHECK(param_store_stats.imported);
+    check_capacitance(100.0f, 85.0f);
+    CHECK(param_store_get(PARAM_KEY_SERIAL_NUMBER, back));
+    CHECK(memcmp(back, "SN-4711", 8) == 0);
+
+    /* written to the store right away, not imported again */
+    CHECK(run(500));
+    CHECK_EQ(nor_flash_peek(SECTOR_A), MAGIC);
+    remount();
+    CHECK(!param_store_stats.imported);
+    check_capacitance(100.0f, 85.0f);
+}
+
+/* mount time against the records in the sector, get and set never wait */
+static void test_timing(void)
+{
+    param_capacitance_t capacitance;
+    double mountEmpty, mountOne, mountFull, commitUs = 0, maxCommitUs = 0;
+    uint64_t t0;
+    uint32_t compactions;
+    int updates = 0;
+
+    start();
+    remount();
+    mountEmpty = (double)param_store_stats.mountCycles / HOST_SYSCLK_PER_US;
+    set_capacitance(1000.0f, 1.0f);
+    CHECK(run(500));
+    remount();
+    mountOne = (double)param_store_stats.mountCycles / HOST_SYSCLK_PER_US;
+    compactions = param_store_stats.compactions;
+    param_store_stats.maxCommitMs = 0;
+
+    /* updates until the next one would not fit, no compaction */
+    for (int i = 0; free_address(SECTOR_A) + 2 * (CAPACITANCE_WORDS + 2) <= SECTOR_A + PARAM_STORE_SECTOR_SIZE; i++) {
+        t0 = host_time_ns();
+        set_capacitance(1000.0f, (float)i);
+        CHECK(host_time_ns() - t0 < 1000);
+        CHECK(run(200));
+        commitUs += (host_time_ns() - t0) / 1e3;
+        maxCommitUs = ((host_time_ns() - t0) / 1e3 > maxCommitUs) ? (host_time_ns() - t0) / 1e3 : maxCommitUs;
+        updates++;
+    }
+    CHECK_EQ(param_store_stats.compactions, compactions);
+    remount();
+    mountFull = (double)param_store_stats.mountCycles / HOST_SYSCLK_PER_US;
+    CHECK_EQ(param_store_stats.mountRecords, updates + 1);
+
+    /* a get is the RAM copy */
+    t0 = host_time_ns();
+    CHECK(param_store_get(PARAM_KEY_CAPACITANCE, &capacitance));
+    CHECK_EQ(host_time_ns() - t0, 0);
+    CHECK_NEAR(capacitance.currentCapacitance, updates - 1, 0);
+
+    CHECK(param_store_stats.maxCommitMs < 2);
+    CHECK(maxCommitUs < 2000);
+    CHECK(mountFull < 1000);
+    printf("param store: mount %.0f us empty, %.0f us with 1 record, %.0f us with %d records\n",
+           mountEmpty, mountOne, mountFull, updates + 1);
+    printf("param store: update committed in %.0f us on average, max %.0f us\n", commitUs / updates, maxCommitUs);
+}
+
+int main(void)
+{
+    test_blank();
+    test_update();
+    test_compaction();
+    test_torn_record();
+    test_program_failure();
+    test_import();
+    test_timing();
+
+    return check_report("test_param_store");
+}
@@ -0,0 +1,325 @@
+/*
+ * test_pdo.c - the PDO pack programs of co_pdo.c
+ *
+ *  The stack of test_od.c with the PDO mappings of the DPMU object
+ *  dictionary, byte aligned U8 and U16 entries at odd and even offsets in
+ *  the TPDOs, a U32 at an odd offset in the first RPDO. The mapped objects
+ *  get random values, each TPDO frame the pack program fills has to be
+ *  the one coNumMemcpyUnpack() gives on the C28x, by coPdoGetTrData() and
+ *  on the virtual CAN bus, and each RPDO frame a client sends has to end up
+ *  in the objects as coNumMemcpyPack() puts it there.
+ *
+ *  The host has 8 bit chars, coNumMemcpyUnpack() built here with
+ *  CO_CPU_DSP takes one char for each pair of bytes. expected() below is
+ *  the copy of the C28x instead, each 16 bit char of the object gives its
+ *  low byte, then its high byte. The generic path is still timed against
+ *  the pack programs, it does the same work per byte as on the target.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* before gen_define.h, check_report() prints */
+#include "check.h"
+
+/* the stack configuration before the stack headers, as in co.c */
+#include "gen_define.h"
+
+#include "co_canopen.h"
+#include "canopen/codrv/vbus/codrv_vbus.h"
+#include "canopen/codrv/vbus/codrv_cpu_linux.h"
+
+/* gen_define.h turns the stack's printf() off */
+#undef printf
+
+#define CLIENT          1u
+#define MAX_PDOS        4
+#define ROUNDS          1000
+#define BUS_ROUNDS      10
+#define FILLS           200000L
+
+typedef struct {
+    uint16_t pdoNr;
+    uint32_t cobId;
+    uint8_t entries;
+    uint8_t len;                        /* bytes of the frame */
+    uint8_t entryLen[8];
+    void *pVar[8];
+} pdo_t;
+
+static pdo_t tpdo[MAX_PDOS], rpdo[MAX_PDOS];
+static int tpdos, rpdos;
+static uint32_t seed = 0x2545F491u;
+
+static uint32_t rnd(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static uint64_t real_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* the host reads of the stack go through coNumMemcpyPack(), see above,
+ * the mapping and the COB-ID are read in place */
+static int find_pdos(uint16_t commIndex, pdo_t *pdo)
+{
+    int n = 0;
+
+    for (uint16_t i = 0; i < MAX_PDOS; i++) {
+        const UNSIGNED8 *pCnt = coOdGetObjAddrR(commIndex + 0x200 + i, 0);
+        const UNSIGNED32 *pCobId = coOdGetObjAddrR(commIndex + i, 1);
+
+        if ((pCnt == NULL) || (pCobId == NULL) || (*pCnt == 0)) {
+            continue;
+        }
+        pdo[n].pdoNr = i + 1;
+        pdo[n].cobId = *pCobId;
+        pdo[n].entries = *pCnt;
+        pdo[n].len = 0;
+        for (uint8_t s = 0; s < pdo[n].entries; s++) {
+            UNSIGNED32 map = *(const UNSIGNED32 *)coOdGetObjAddrR(commIndex + 0x200 + i, s + 1);
+
+            pdo[n].entryLen[s] = (uint8_t)((map & 0xFF) / 8);
+            pdo[n].pVar[s] = coOdGetObjAddr((UNSIGNED16)(map >> 16), (UNSIGNED8)(map >> 8));
+            CHECK(pdo[n].pVar[s] != NULL);
+            CHECK((map & 0x7) == 0);
+            pdo[n].len += pdo[n].entryLen[s];
+        }
+        CHECK(pdo[n].len <= 8);
+        n++;
+    }
+    return n;
+}
+
+/* the frame of coNumMemcpyUnpack() on the C28x */
+static void expected(const pdo_t *pdo, uint8_t frame[8])
+{
+    uint8_t offs = 0;
+
+    memset(frame, 0, 8);
+    for (uint8_t e = 0; e < pdo->entries; e++) {
+        const uint16_t *pWord = pdo->pVar[e];
+
+        for (uint8_t b = 0; b < pdo->entryLen[e]; b++) {
+            frame[offs++] = (uint8_t)(pWord[b / 2] >> (8 * (b % 2)));
+        }
+    }
+}
+
+static void randomize(const pdo_t *pdo)
+{
+    for (uint8_t e = 0; e < pdo->entries; e++) {
+        switch (pdo->entryLen[e]) {
+        case 1:
+            *(uint8_t *)pdo->pVar[e] = (uint8_t)rnd();
+            break;
+        case 2:
+            *(uint16_t *)pdo->pVar[e] = (uint16_t)rnd();
+            break;
+        case 4:
+            *(uint32_t *)pdo->pVar[e] = rnd();
+            break;
+        default:
+            CHECK(0);
+            break;
+        }
+    }
+}
+
+/* the value of each object against the bytes of the frame */
+static int mismatches(const pdo_t *pdo, const uint8_t frame[8])
+{
+    uint8_t offs = 0;
+    int bad = 0;
+
+    for (uint8_t e = 0; e < pdo->entries; e++) {
+        uint32_t value = 0, got;
+
+        for (uint8_t b = 0; b < pdo->entryLen[e]; b++) {
+            value |= (uint32_t)frame[offs++] << (8 * b);
+        }
+        switch (pdo->entryLen[e]) {
+        case 1:
+            got = *(uint8_t *)pdo->pVar[e];
+            break;
+        case 2:
+            got = *(uint16_t *)pdo->pVar[e];
+            break;
+        default:
+            got = *(uint32_t *)pdo->pVar[e];
+            break;
+        }
+        bad += got != value;
+    }
+    return bad;
+}
+
+/* the frames on the bus for the stack's COB-IDs */
+static bool client_receive(uint32_t cobId, uint8_t frame[8])
+{
+    CODRV_VBUS_MSG_T msg;
+    bool found = false;
+
+    while (codrvVbusReceive(CLIENT, &msg)) {
+        if (msg.canId == cobId) {
+            memcpy(frame, msg.data, 8);
+            found = true;
+        }
+    }
+    return found;
+}
+
+static void run(void)
+{
+    for (int i = 0; (i < 100) && coCommTask(); i++) {
+    }
+}
+
+static void test_tpdo(void)
+{
+    uint8_t words[8], want[8];
+    int bad = 0;
+
+    tpdos = find_pdos(0x1800, tpdo);
+    CHECK(tpdos > 0);
+    for (int p = 0; p < tpdos; p++) {
+        for (int r = 0; r < ROUNDS; r++) {
+            randomize(&tpdo[p]);
+            expected(&tpdo[p], want);
+            memset(words, 0xAA, sizeof(words));
+            CHECK_EQ(coPdoGetTrData(tpdo[p].pdoNr, words, CO_TRUE), RET_OK);
+            bad += memcmp(words, want, sizeof(want)) != 0;
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+static void nmt_start(void)
+{
+    CODRV_VBUS_MSG_T msg = { 0 };
+
+    msg.canId = 0;
+    msg.len = 2;
+    msg.data[0] = 1;
+    msg.data[1] = 0;                    /* all nodes */
+    CHECK_EQ(codrvVbusTransmit(CLIENT, &msg), RET_OK);
+    run();
+    CHECK_EQ(coNmtGetState(), CO_NMT_STATE_OPERATIONAL);
+}
+
+/* transmitted, the inhibit time of the TPDO is ticked away */
+static void test_tpdo_bus(void)
+{
+    uint8_t frame[8], want[8];
+    int missing = 0, bad = 0;
+
+    for (int p = 0; p < tpdos; p++) {
+        for (int r = 0; r < BUS_ROUNDS; r++) {
+            int t;
+
+            randomize(&tpdo[p]);
+            expected(&tpdo[p], want);
+            client_receive(0, frame);
+            for (t = 0; t < 1000; t++) {
+                if (coPdoReqNr(tpdo[p].pdoNr, 0) == RET_OK) {
+                    break;
+                }
+                coTimerTick();
+                run();
+            }
+            run();
+            for (t = 0; (t < 1000) && !client_receive(tpdo[p].cobId, frame); t++) {
+                coTimerTick();
+                run();
+            }
+            missing += t == 1000;
+            bad += memcmp(frame, want, tpdo[p].len) != 0;
+        }
+    }
+    CHECK_EQ(missing, 0);
+    CHECK_EQ(bad, 0);
+}
+
+static void test_rpdo(void)
+{
+    CODRV_VBUS_MSG_T msg = { 0 };
+    int bad = 0;
+
+    rpdos = find_pdos(0x1400, rpdo);
+    CHECK(rpdos > 0);
+    for (int p = 0; p < rpdos; p++) {
+        msg.canId = rpdo[p].cobId;
+        msg.len = rpdo[p].len;
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int b = 0; b < 8; b++) {
+                msg.data[b] = (uint8_t)rnd();
+            }
+            CHECK_EQ(codrvVbusTransmit(CLIENT, &msg), RET_OK);
+            run();
+            bad += mismatches(&rpdo[p], msg.data);
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+static void test_fills_per_second(void)
+{
+    uint8_t frame[8];
+
+    for (int p = 0; p < tpdos; p++) {
+        uint64_t t, generic, words;
+
+        t = real_ns();
+        for (long n = 0; n < FILLS; n++) {
+            coPdoGetTrData(tpdo[p].pdoNr, frame, CO_FALSE);
+        }
+        generic = real_ns() - t;
+        t = real_ns();
+        for (long n = 0; n < FILLS; n++) {
+            coPdoGetTrData(tpdo[p].pdoNr, frame, CO_TRUE);
+        }
+        words = real_ns() - t;
+
+        CHECK(words < generic);
+        printf("pdo: TPDO %u, %u entries: %.1f ns generic, %.1f ns pack program\n", tpdo[p].pdoNr,
+               tpdo[p].entries, (double)generic / FILLS, (double)words / FILLS);
+    }
+}
+
+int main(void)
+{
+    CODRV_VBUS_MSG_T msg;
+
+    codrvHardwareInit();
+    if ((codrvCanInit(250) != RET_OK) || (coCanOpenStackInit(NULL) != RET_OK)) {
+        fprintf(stderr, "stack init failed\n");
+        return 1;
+    }
+    /* the client is on the bus from its first call */
+    (void)codrvVbusReceive(CLIENT, &msg);
+    if (codrvCanEnable() != RET_OK) {
+        fprintf(stderr, "can enable failed\n");
+        return 1;
+    }
+    run();
+
+    test_tpdo();
+    nmt_start();
+    test_tpdo_bus();
+    test_rpdo();
+    test_fills_per_second();
+
+    return check_report("test_pdo");
+}
@@ -0,0 +1,361 @@
+/*
+ * test_pi_controller.c - the PI engine of pi_controller.c
+ *
+ *  Step responses against the parallel PI form worked out by hand, the
+ *  clamp with its back-calculated integrator, the bumpless start and a
+ *  closed loop on a first order plant that has to settle without error.
+ *  The DCL forms with the integrator frozen while clamped, the PID with
+ *  its filtered derivative on the measurement, and the cycles per update
+ *  of the engine against the by-value Pi_Controller*Float copies it
+ *  replaced, kept below as they were in DCDC.c and CLLC.c.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "check.h"
+
+#include "pi_controller.h"
+
+static const PI_Parameters_t pi = { 0.05f, 0.5f, 10.0f, -2.0f };   /* I, P, upper, lower */
+
+static void test_step(void)
+{
+    PiOutput_t out;
+    double integral = 0;
+
+    PiControllerReset(&out);
+    CHECK_EQ(out.Int_out, 0);
+
+    /* error 1: P part 0.5, the integral grows by 0.05 per update */
+    for (int i = 1; i <= 20; i++) {
+        integral += 0.05;
+        CHECK_NEAR(PiControllerRun(&pi, &out, 3.0f, 2.0f), 0.5 + integral, 1e-5);
+        CHECK_NEAR(out.Output, 0.5 + integral, 1e-5);
+        CHECK_NEAR(out.calculated_error, 1.0, 0);
+        CHECK_EQ(out.clamped, 0);
+    }
+
+    /* the error reversed, the P part follows at once */
+    CHECK_NEAR(PiControllerRun(&pi, &out, 2.0f, 3.0f), -0.5 + integral - 0.05, 1e-5);
+
+    PiControllerReset(&out);
+    CHECK_EQ(out.Output, 0);
+    CHECK_EQ(out.Int_out, 0);
+    CHECK_EQ(out.clamped, 0);
+}
+
+static void test_clamp(void)
+{
+    PiOutput_t out;
+    float output;
+
+    PiControllerReset(&out);
+
+    /* an error that lasts holds the output at the upper limit */
+    for (int i = 0; i < 1000; i++) {
+        output = PiControllerRun(&pi, &out, 10.0f, 0.0f);
+        CHECK(i < 10 || output == pi.UpperLimit);
+    }
+    CHECK_EQ(out.clamped, 1);
+    /* no wind up: the integrator is what the clamped output leaves */
+    CHECK_NEAR(out.Int_out, pi.UpperLimit - pi.Pgain * 10.0f, 1e-4);
+
+    /* leaves the limit on the first update with a small negative error */
+    output = PiControllerRun(&pi, &out, 0.0f, 1.0f);
+    CHECK(output < pi.UpperLimit);
+    CHECK_EQ(out.clamped, 0);
+
+    /* and the lower limit the same way */
+    for (int i = 0; i < 1000; i++) {
+        output = PiControllerRun(&pi, &out, -3.0f, 0.0f);
+    }
+    CHECK_NEAR(output, pi.LowerLimit, 0);
+    CHECK_EQ(out.clamped, 1);
+    CHECK_NEAR(out.Int_out, pi.LowerLimit + pi.Pgain * 3.0f, 1e-4);
+    output = PiControllerRun(&pi, &out, 1.0f, 0.0f);
+    CHECK(output > pi.LowerLimit);
+}
+
+static void test_bumpless(void)
+{
+    PiOutput_t out;
+
+    /* the first update with the same reference and measurement returns Output */
+    PiControllerBumplessInit(&pi, &out, 4.0f, 12.0f, 11.5f);
+    CHECK_NEAR(out.Output, 4.0, 0);
+    CHECK_NEAR(PiControllerRun(&pi, &out, 12.0f, 11.5f), 4.0, 1e-5);
+
+    /* Output beyond the limits starts from the limit */
+    PiControllerBumplessInit(&pi, &out, 50.0f, 1.0f, 0.0f);
+    CHECK_NEAR(out.Output, pi.UpperLimit, 0);
+    CHECK_NEAR(PiControllerRun(&pi, &out, 1.0f, 0.0f), pi.UpperLimit, 1e-5);
+    PiControllerBumplessInit(&pi, &out, -50.0f, 0.0f, 0.0f);
+    CHECK_NEAR(PiControllerRun(&pi, &out, 0.0f, 0.0f), pi.LowerLimit, 1e-5);
+}
+
+/* y' = (k * u - y) / tau, one update per step */
+static void test_closed_loop(void)
+{
+    const PI_Parameters_t loop = { 0.02f, 0.2f, 5.0f, 0.0f };
+    PiOutput_t out;
+    float y = 0, setpoint = 6.0f, peak = 0;
+    int settled = -1;
+
+    PiControllerReset(&out);
+    for (int i = 0; i < 5000; i++) {
+        float u = PiControllerRun(&loop, &out, setpoint, y);
+
+        y += (2.0f * u - y) * 0.05f;
+        if (y > peak) {
+            peak = y;
+        }
+        if (settled < 0 && y > setpoint * 0.98f && y < setpoint * 1.02f) {
+            settled = i;
+        }
+        if (i == 2500) {
+            setpoint = 3.0f;        /* a step down */
+        }
+    }
+
+    CHECK(settled > 0 && settled < 1000);
+    CHECK(peak < 6.0f * 1.25f);
+    CHECK_NEAR(y, 3.0, 1e-3);
+    CHECK_NEAR(out.Output, 1.5, 1e-3);
+    CHECK_EQ(out.clamped, 0);
+}
+
+static void test_dcl_forms(void)
+{
+    PI_Parameters_t series = pi, parallel = pi;
+    PiOutput_t out;
+    float frozen;
+    double integral = 0;
+
+    series.form = PI_FORM_SERIES_DCL;
+    parallel.form = PI_FORM_PARALLEL_DCL;
+
+    /* series: the integrator sums the P part, Igain * Pgain * error */
+    PiControllerReset(&out);
+    for (int i = 1; i <= 20; i++) {
+        integral += 0.05 * 0.5 * 2.0;
+        CHECK_NEAR(PiControllerRun(&series, &out, 3.0f, 1.0f), 0.5 * 2.0 + integral, 1e-5);
+        CHECK_EQ(out.clamped, 0);
+    }
+
+    /* parallel: the integrator sums Igain * error, as PI_FORM_PARALLEL */
+    integral = 0;
+    PiControllerReset(&out);
+    for (int i = 1; i <= 20; i++) {
+        integral += 0.05 * 2.0;
+        CHECK_NEAR(PiControllerRun(&parallel, &out, 3.0f, 1.0f), 0.5 * 2.0 + integral, 1e-5);
+    }
+
+    /* both freeze the integrator once the output is clamped */
+    for (int form = 0; form < 2; form++) {
+        const PI_Parameters_t *p = (form == 0) ? &series : &parallel;
+
+        PiControllerReset(&out);
+        while (!out.clamped) {
+            PiControllerRun(p, &out, 10.0f, 0.0f);
+        }
+        frozen = out.Int_out;
+        for (int i = 0; i < 1000; i++) {
+            CHECK_NEAR(PiControllerRun(p, &out, 10.0f, 0.0f), pi.UpperLimit, 0);
+        }
+        CHECK_NEAR(out.Int_out, frozen, 0);
+        CHECK_EQ(out.clamped, 1);
+
+        /* and the bumpless start holds for the form too */
+        PiControllerBumplessInit(p, &out, 4.0f, 12.0f, 11.5f);
+        CHECK_NEAR(PiControllerRun(p, &out, 12.0f, 11.5f), 4.0, 1e-5);
+    }
+}
+
+static void test_pid_filtered(void)
+{
+    const float T = 1e-4f, fc = 500.0f, slope = 0.2f;
+    const double tau = 1.0 / (2.0 * 3.14159265358979 * fc);
+    PI_Parameters_t pid = { 0.0f, 0.5f, 100.0f, -100.0f };
+    PiOutput_t out;
+    float y = 5.0f, d = 0;
+
+    pid.form = PI_FORM_PID_FILTERED;
+    pid.Dgain = 0.01f;
+    PiControllerSetDerivativeFilter(&pid, fc, T);
+    CHECK_NEAR(pid.DfilterC1, 2.0 / (T + 2.0 * tau), 1e-2);
+    CHECK_NEAR(pid.DfilterC2, (T - 2.0 * tau) / (T + 2.0 * tau), 1e-6);
+
+    /* started on the measurement, a steady one gives no derivative */
+    PiControllerBumplessInit(&pid, &out, 1.0f, 5.0f, y);
+    for (int i = 0; i < 100; i++) {
+        CHECK_NEAR(PiControllerRun(&pid, &out, 5.0f, y), 1.0, 1e-5);
+    }
+
+    /* a reference step gives no kick, the derivative is on the measurement */
+    CHECK_NEAR(PiControllerRun(&pid, &out, 6.0f, y), 1.0 + 0.5 + 0.0, 1e-5);
+
+    /* a ramp of the measurement: the derivative tends to Dgain * dy/dt */
+    PiControllerReset(&out);
+    pid.Igain = 0.0f;
+    for (int i = 0; i < 2000; i++) {
+        y += slope * T;
+        d = pid.Pgain * (6.0f - y) - PiControllerRun(&pid, &out, 6.0f, y);
+    }
+    CHECK_NEAR(d, pid.Dgain * slope, 1e-4);
+
+    /* the clamp freezes the integrator as the DCL forms do */
+    pid.Igain = 0.05f;
+    PiControllerReset(&out);
+    while (!out.clamped) {
+        PiControllerRun(&pid, &out, 1000.0f, y);
+    }
+    d = out.Int_out;
+    PiControllerRun(&pid, &out, 1000.0f, y);
+    CHECK_NEAR(out.Int_out, d, 0);
+
+    PiControllerReset(&out);
+    CHECK_EQ(out.Deriv_d2, 0);
+    CHECK_EQ(out.Deriv_d3, 0);
+}
+
+/*** the by-value copies of DCDC.c and CLLC.c the engine replaced ***/
+
+typedef struct PiOutputByValue
+{
+    float Output;
+    float Int_out;
+    float calculated_error;
+    uint16_t dutyCycle;
+} PiOutputByValue_t;
+
+typedef struct PI_ParametersByValue
+{
+    float Igain;
+    float Pgain;
+    float UpperLimit;
+    float LowerLimit;
+} PI_ParametersByValue_t;
+
+__attribute__((noinline))
+static PiOutputByValue_t Pi_ControllerBoostFloat(PI_ParametersByValue_t PI, PiOutputByValue_t PIout,
+                                                 float Ref, float ValueRead)
+{
+    volatile float error;
+    error = Ref - ValueRead;
+
+    float P_out   = (float) error * PI.Pgain;
+    PIout.Int_out = (float) error * PI.Igain + PIout.Int_out;
+    PIout.Output = P_out + PIout.Int_out;
+
+    if (PIout.Output > PI.UpperLimit)
+    {
+        PIout.Output = PI.UpperLimit;
+        PIout.Int_out = PI.UpperLimit - P_out;
+    }
+
+    if (PIout.Output < PI.LowerLimit)
+    {
+        PIout.Output = PI.LowerLimit;
+        PIout.Int_out = PI.LowerLimit + P_out;
+    }
+
+    PIout.calculated_error = error;
+
+    return PIout;
+}
+
+#define BENCH_UPDATES 1000000
+
+static uint64_t bench_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* the measurement of a first order plant, so both see the same errors */
+static float bench_plant(float y, float u)
+{
+    return y + (2.0f * u - y) * 0.05f;
+}
+
+static void test_bench(void)
+{
+    static const PI_ParametersByValue_t oldParam = { 0.02f, 0.2f, 5.0f, 0.0f };
+    PI_Parameters_t param = { 0.02f, 0.2f, 5.0f, 0.0f };
+    PiOutputByValue_t oldOut = { 0 };
+    PiOutput_t out;
+    float yOld = 0, yNew = 0;
+    uint64_t t0, oldCycles, cycles[PI_FORM_PID_FILTERED + 1];
+    const char *name[] = { "parallel", "series DCL", "parallel DCL", "PID filtered" };
+
+    /* same outputs as long as the lower clamp, back-calculated with the wrong
+     * sign by the old code, is not reached */
+    PiControllerReset(&out);
+    for (int i = 0; i < 1000; i++) {
+        float setpoint = (i < 500) ? 6.0f : 3.0f;
+
+        oldOut = Pi_ControllerBoostFloat(oldParam, oldOut, setpoint, yOld);
+        PiControllerRun(&param, &out, setpoint, yNew);
+        CHECK_NEAR(out.Output, oldOut.Output, 1e-5);
+        yOld = bench_plant(yOld, oldOut.Output);
+        yNew = bench_plant(yNew, out.Output);
+    }
+
+    t0 = bench_clock();
+    for (int i = 0; i < BENCH_UPDATES; i++) {
+        oldOut = Pi_ControllerBoostFloat(oldParam, oldOut, (i & 1024) ? 6.0f : 3.0f, yOld);
+        yOld = bench_plant(yOld, oldOut.Output);
+    }
+    oldCycles = bench_clock() - t0;
+
+    PiControllerSetDerivativeFilter(&param, 500.0f, 1e-4f);
+    param.Dgain = 0.001f;
+    for (int form = PI_FORM_PARALLEL; form <= PI_FORM_PID_FILTERED; form++) {
+        param.form = form;
+        PiControllerReset(&out);
+        t0 = bench_clock();
+        for (int i = 0; i < BENCH_UPDATES; i++) {
+            PiControllerRun(&param, &out, (i & 1024) ? 6.0f : 3.0f, yNew);
+            yNew = bench_plant(yNew, out.Output);
+        }
+        cycles[form] = bench_clock() - t0;
+    }
+
+    printf("pi controller: %s per update, plant step included\n",
+#if defined(__x86_64__) || defined(__i386__)
+           "TSC cycles"
+#else
+           "ns"
+#endif
+           );
+    printf("  Pi_ControllerBoostFloat by value %6.1f\n", (double)oldCycles / BENCH_UPDATES);
+    for (int form = PI_FORM_PARALLEL; form <= PI_FORM_PID_FILTERED; form++) {
+        printf("  PiControllerRun %-16s %6.1f\n", name[form], (double)cycles[form] / BENCH_UPDATES);
+    }
+}
+
+int main(void)
+{
+    test_step();
+    test_clamp();
+    test_bumpless();
+    test_closed_loop();
+    test_dcl_forms();
+    test_pid_filtered();
+    test_bench();
+
+    return check_report("test_pi_controller");
+}
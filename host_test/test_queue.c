@@ -0,0 +1,346 @@
+/*
+ * test_queue.c - the CAN transmit queue of co_queue.c on the virtual bus
+ *
+ *  The stack of test_od.c, run by coCommTask() with the timer ticked by
+ *  hand, and a client on node 1 of the virtual bus taking every frame.
+ *  The stack has no cob to spare, the test takes the four TPDO cobs, unused
+ *  in pre-operational, and gives them CAN ids of their own. Their messages
+ *  have to go out in the order they were queued, a full queue refuses the
+ *  next one and counts it, and a cob with an inhibit time sends no two
+ *  frames closer than that, the ones in between waiting in the inhibit
+ *  list. coQueueGetStats() has to show the
+ *  depths and high water marks of each case and all zero when the queue is
+ *  idle again. Last the frames per second through the queue, and the
+ *  inhibit times of several cobs kept busy for a while.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* before gen_define.h, check_report() prints */
+#include "check.h"
+
+/* the stack configuration before the stack headers, as in co.c */
+#include "gen_define.h"
+
+#include "co_canopen.h"
+#include "co_drv.h"
+#include "ico_cobhandler.h"
+#include "ico_queue.h"
+#include "canopen/codrv/vbus/codrv_vbus.h"
+#include "canopen/codrv/vbus/codrv_cpu_linux.h"
+
+/* gen_define.h turns the stack's printf() off */
+#undef printf
+
+#define CLIENT          1u
+#define COBS            4
+#define CAN_ID(cob)     (0x60u + (cob))     /* below the predefined set */
+#define FRAMES          200000L
+#define BUSY_TICKS      1000
+
+static COB_REFERENZ_T cob[COBS];
+
+/* the frames of the cobs above, as the client got them */
+static struct {
+    uint8_t cob;
+    uint8_t seq;
+    uint32_t tick;
+} rx[64];
+static uint32_t received;
+static uint32_t perCob[COBS];
+static uint32_t ticks;
+
+static uint64_t real_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* the frames on the bus, of all cobs */
+static uint32_t client_receive(void)
+{
+    CODRV_VBUS_MSG_T msg;
+    uint32_t n = 0;
+
+    while (codrvVbusReceive(CLIENT, &msg)) {
+        n++;
+        if ((msg.canId < CAN_ID(0)) || (msg.canId >= CAN_ID(COBS))) {
+            /* boot-up and heartbeat of the stack */
+            continue;
+        }
+        rx[received % 64].cob = (uint8_t)(msg.canId - CAN_ID(0));
+        rx[received % 64].seq = msg.data[0];
+        rx[received % 64].tick = ticks;
+        perCob[msg.canId - CAN_ID(0)]++;
+        received++;
+    }
+    return n;
+}
+
+/* the super loop until the stack and the bus have nothing more to do */
+static void run(void)
+{
+    for (int i = 0; i < 100; i++) {
+        BOOL_T more = coCommTask();
+
+        if ((client_receive() == 0) && !more) {
+            break;
+        }
+    }
+}
+
+static void tick(void)
+{
+    ticks++;
+    coTimerTick();
+    run();
+}
+
+static void start(void)
+{
+    run();
+    received = 0;
+    memset(perCob, 0, sizeof(perCob));
+    ticks = 0;
+    for (int c = 0; c < COBS; c++) {
+        CHECK_EQ(icoCobSetInhibit(cob[c], 0), RET_OK);
+    }
+}
+
+static RET_T send(int c, uint8_t seq, UNSIGNED8 flags)
+{
+    UNSIGNED8 data[8] = { seq, (UNSIGNED8)c, 0, 0, 0, 0, 0, 0 };
+
+    return icoTransmitMessage(cob[c], data, flags);
+}
+
+static CO_QUEUE_STATS_T stats(void)
+{
+    CO_QUEUE_STATS_T s;
+
+    coQueueGetStats(&s);
+    return s;
+}
+
+static void check_idle(void)
+{
+    CO_QUEUE_STATS_T s = stats();
+
+    CHECK_EQ(s.bufUsed, 0);
+    CHECK_EQ(s.transmitDepth, 0);
+    CHECK_EQ(s.inhibitDepth, 0);
+    CHECK_EQ(s.inhibitCobs, 0);
+}
+
+/* more than the buffers hold, queued between two passes of the super loop */
+static void test_order(void)
+{
+    CO_QUEUE_STATS_T s;
+    uint32_t overflows = stats().overflows;
+    int bad = 0;
+
+    start();
+    for (int i = 0; i < CO_CONFIG_TRANS_BUFFER_CNT; i++) {
+        CHECK_EQ(send(i % COBS, (uint8_t)i, 0), RET_OK);
+    }
+    CHECK_EQ(send(0, 0xFF, 0), RET_DRV_TRANS_BUFFER_FULL);
+
+    s = stats();
+    CHECK_EQ(s.bufUsed, CO_CONFIG_TRANS_BUFFER_CNT);
+    CHECK_EQ(s.bufHighWater, CO_CONFIG_TRANS_BUFFER_CNT);
+    CHECK_EQ(s.transmitDepth, CO_CONFIG_TRANS_BUFFER_CNT);
+    CHECK_EQ(s.inhibitDepth, 0);
+    CHECK_EQ(s.overflows - overflows, 1);
+
+    run();
+    CHECK_EQ(received, CO_CONFIG_TRANS_BUFFER_CNT);
+    for (uint32_t i = 0; i < received; i++) {
+        bad += (rx[i].seq != i) || (rx[i].cob != i % COBS);
+    }
+    CHECK_EQ(bad, 0);
+    check_idle();
+}
+
+/* one cob with an inhibit time of 3 ticks, one without */
+static void test_inhibit(void)
+{
+    CO_QUEUE_STATS_T s;
+    uint32_t last = 0;
+    int seen = 0;
+
+    start();
+    CHECK_EQ(icoCobSetInhibit(cob[0], 3 * CO_TIMER_INTERVAL / 100), RET_OK);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(send(0, (uint8_t)i, 0), RET_OK);
+    }
+    CHECK_EQ(send(1, 0x80, 0), RET_OK);
+    CHECK(icoQueueInhibitActive(cob[0]));
+    CHECK(!icoQueueInhibitActive(cob[1]));
+    CHECK_EQ(send(0, 0x10, MSG_RET_INHIBIT), RET_INHIBIT_ACTIVE);
+
+    /* the first of cob 0 is sent, the others wait behind it */
+    s = stats();
+    CHECK_EQ(s.transmitDepth, 2);
+    CHECK_EQ(s.inhibitDepth, 3);
+    CHECK_EQ(s.inhibitHighWater, 3);
+
+    run();
+    CHECK_EQ(received, 2);
+    CHECK_EQ(rx[1].cob, 1);
+    s = stats();
+    CHECK_EQ(s.inhibitCobs, 1);
+    CHECK_EQ(s.inhibitDepth, 3);
+
+    while ((ticks < 100) && (stats().inhibitCobs != 0)) {
+        tick();
+    }
+    CHECK_EQ(received, 5);
+
+    /* in order, no closer than 3 ticks and not much later either */
+    for (uint32_t i = 0; i < received; i++) {
+        if (rx[i].cob != 0) {
+            continue;
+        }
+        CHECK_EQ(rx[i].seq, seen);
+        if (seen > 0) {
+            CHECK(rx[i].tick - last >= 3);
+            CHECK(rx[i].tick - last <= 4);
+        }
+        last = rx[i].tick;
+        seen++;
+    }
+    CHECK_EQ(seen, 4);
+    CHECK(!icoQueueInhibitActive(cob[0]));
+    check_idle();
+}
+
+/* an inhibit time does not hold up the other cobs */
+static void test_inhibit_others(void)
+{
+    start();
+    CHECK_EQ(icoCobSetInhibit(cob[0], 10 * CO_TIMER_INTERVAL / 100), RET_OK);
+    CHECK_EQ(send(0, 0, 0), RET_OK);
+    CHECK_EQ(send(0, 1, 0), RET_OK);
+    run();
+    for (int i = 0; i < 5; i++) {
+        CHECK_EQ(send(1, (uint8_t)i, 0), RET_OK);
+        tick();
+    }
+    CHECK_EQ(perCob[0], 1);
+    CHECK_EQ(perCob[1], 5);
+    while ((ticks < 100) && (stats().inhibitCobs != 0)) {
+        tick();
+    }
+    CHECK_EQ(perCob[0], 2);
+    check_idle();
+}
+
+/* frames through the queue, bus and client, on the host clock */
+static void test_frames_per_second(void)
+{
+    uint64_t t, queued = 0;
+    double perSecond;
+
+    start();
+    t = real_ns();
+    for (long n = 0; n < FRAMES; n += CO_CONFIG_TRANS_BUFFER_CNT) {
+        uint64_t q = real_ns();
+
+        for (int i = 0; i < CO_CONFIG_TRANS_BUFFER_CNT; i++) {
+            send(i % COBS, (uint8_t)(n + i), 0);
+        }
+        queued += real_ns() - q;
+        run();
+    }
+    perSecond = received * 1e9 / (real_ns() - t);
+
+    CHECK_EQ(received, FRAMES);
+    CHECK(perSecond > 100000.0);
+    check_idle();
+    printf("queue: %.2f M frames/s, %.0f ns to queue a frame\n", perSecond / 1e6, (double)queued / FRAMES);
+}
+
+/* each cob sends whenever its inhibit time lets it, as a PDO on change */
+static void test_busy(void)
+{
+    const uint16_t inhibit[COBS] = { 1, 2, 3, 5 };
+    uint16_t inhibitHighWater = stats().inhibitHighWater;
+    uint32_t attempts = 0;
+    uint64_t t;
+
+    start();
+    for (int c = 0; c < COBS; c++) {
+        CHECK_EQ(icoCobSetInhibit(cob[c], inhibit[c] * CO_TIMER_INTERVAL / 100), RET_OK);
+    }
+    t = real_ns();
+    while (ticks < BUSY_TICKS) {
+        for (int c = 0; c < COBS; c++) {
+            attempts++;
+            send(c, (uint8_t)attempts, MSG_RET_INHIBIT);
+        }
+        tick();
+    }
+    t = real_ns() - t;
+
+    for (int c = 0; c < COBS; c++) {
+        /* a frame every inhibit time, late by the tick the inhibit time
+         * is rounded up to and the tick until the next try */
+        CHECK(perCob[c] <= BUSY_TICKS / inhibit[c] + 1);
+        CHECK(perCob[c] >= BUSY_TICKS / (inhibit[c] + 2));
+    }
+    /* refused while the inhibit time runs, nothing waits in the list */
+    CHECK_EQ(stats().inhibitHighWater, inhibitHighWater);
+    while ((ticks < BUSY_TICKS + 10) && (stats().inhibitCobs != 0)) {
+        tick();
+    }
+    check_idle();
+    printf("queue: %lu %lu %lu %lu frames in %d ticks, inhibit 1 2 3 5, %.1f us a tick\n",
+           (unsigned long)perCob[0], (unsigned long)perCob[1], (unsigned long)perCob[2],
+           (unsigned long)perCob[3], BUSY_TICKS, t / 1e3 / BUSY_TICKS);
+}
+
+int main(void)
+{
+    CODRV_VBUS_MSG_T msg;
+    int cobs = 0;
+
+    codrvHardwareInit();
+    if ((codrvCanInit(250) != RET_OK) || (coCanOpenStackInit(NULL) != RET_OK)) {
+        fprintf(stderr, "stack init failed\n");
+        return 1;
+    }
+    for (COB_REFERENZ_T r = 0; (r < CO_COB_CNT) && (cobs < COBS); r++) {
+        CO_COB_T *pCob = icoCobGetPointer(r);
+
+        if ((pCob != NULL) && (pCob->service == CO_SERVICE_PDO_TRANSMIT)) {
+            cob[cobs++] = r;
+        }
+    }
+    for (int c = 0; c < COBS; c++) {
+        if ((c >= cobs) || (icoCobSet(cob[c], CAN_ID(c), CO_COB_RTR_NONE, 8) != RET_OK)) {
+            fprintf(stderr, "no cob %d\n", c);
+            return 1;
+        }
+    }
+    /* the client is on the bus from its first call */
+    (void)codrvVbusReceive(CLIENT, &msg);
+    if (codrvCanEnable() != RET_OK) {
+        fprintf(stderr, "can enable failed\n");
+        return 1;
+    }
+
+    test_order();
+    test_inhibit();
+    test_inhibit_others();
+    test_frames_per_second();
+    test_busy();
+
+    return check_report("test_queue");
+}
@@ -0,0 +1,479 @@
+/*
+ * test_sdo_block.c - the SDO block size of co_sdoblockserver.c and the
+ *                    CAN log download by block upload
+ *
+ *  The stack and the CAN log of can_bench_host.c, 200 records in the flash
+ *  model, with a client on node 1 of the virtual bus that builds its SDO
+ *  frames by hand. The block upload takes the block size the client asks
+ *  for, 1 to 127, at the start and with each block acknowledge, anything
+ *  else is aborted. Every block has to hold that many segments, the last
+ *  one excepted, and the CAN log has to be the same bytes at every block
+ *  size, with fewer frames the larger the blocks. Each chunk after the
+ *  first has to come from the prefetch buffer of log.c.
+ *
+ *  The block download halves its block size after a block with segments
+ *  lost, down to 4, and starts the next download with it. Doubling needs
+ *  a complete block of more than one segment, no writable object of the
+ *  DPMU object dictionary is larger than 7 bytes, 1017:00 is used here.
+ *
+ *  The host has 8 bit chars, coNumMemcpyUnpack() built here with
+ *  CO_CPU_DSP sends each of them as a 16 bit char of the C28x, the byte
+ *  and a zero. A size or abort code in a frame shows its low 16 bits, the
+ *  CAN log its first half, one domain word in every two bytes. host_u16()
+ *  takes them back.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* before gen_define.h, check_report() prints */
+#include "check.h"
+
+/* the stack configuration before the stack headers, as in co.c */
+#include "gen_define.h"
+
+#include "application_vars.h"
+#include "can_bench.h"
+#include "can_log_codec.h"
+#include "co_canopen.h"
+#include "cpu1_hal.h"
+#include "emifc.h"
+#include "ext_flash.h"
+#include "gen_indices.h"
+#include "ico_sdo.h"
+#include "log.h"
+#include "serial.h"
+#include "shared_variables.h"
+#include "canopen/codrv/vbus/codrv_cpu_linux.h"
+#include "canopen/codrv/vbus/codrv_vbus.h"
+
+/* gen_define.h turns the stack's printf() off */
+#undef printf
+
+#define CLIENT          1u
+#define NODE_ID         125u
+#define LOG_RECORDS     200u
+#define LOG_BYTES       4096u
+#define WAIT_PASSES     100000L
+#define SDO_ABORT       0x80u
+
+#define ABORT_BLOCK_SIZE    0x0002u     /* of 0x05040002 */
+
+/*** what log.c needs of the rest of CPU1, as in can_bench_host.c ***/
+
+int debug_level = DEBUG_ERROR;
+int16_t temperatureSensorVector[4] = { 31, 32, 33, 34 };
+
+void AppVarsInformEntireFlashResetInitiated() {}
+void AppVarsInformEntireFlashResetReady() {}
+void cpu2_state_machine_stats_read_domain(uint32_t offset, uint32_t size) { (void)offset; (void)size; }
+
+void emifc_cpu_read_memory(EMIF1_Config *emif1) { (void)emif1; }
+void emifc_set_flag(void *context) { *(volatile bool *)context = true; }
+bool emifc_queue_read(uint32_t address, uint16_t *data, uint32_t size, emifc_callback_t callback, void *context)
+{
+    (void)address; (void)data; (void)size; (void)callback; (void)context;
+    return false;
+}
+
+static RET_T sdoServerReadInd(BOOL_T execute, UNSIGNED8 sdoNr, UNSIGNED16 index, UNSIGNED8 subIndex)
+{
+    if ((index == I_CAN_LOG) && (subIndex == S_CAN_LOG_READ)) {
+        return (RET_T)log_can_log_read(execute, sdoNr, index, subIndex);
+    }
+    return RET_OK;
+}
+
+/*** client ***/
+
+static uint32_t frames;                 /* SDO frames of the transfer, both directions */
+static uint8_t logData[LOG_BYTES + 7];
+
+static uint64_t real_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* a 16 bit value of the frame as the host stack sends it, see above */
+static uint16_t host_u16(const uint8_t *data)
+{
+    return (uint16_t)(data[0] | (data[2] << 8));
+}
+
+static void send(uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t d4)
+{
+    CODRV_VBUS_MSG_T msg = { 0 };
+
+    msg.canId = 0x600u + NODE_ID;
+    msg.len = 8;
+    msg.data[0] = d0;
+    msg.data[1] = d1;
+    msg.data[2] = d2;
+    msg.data[3] = d3;
+    msg.data[4] = d4;
+    CHECK_EQ(codrvVbusTransmit(CLIENT, &msg), RET_OK);
+    frames++;
+}
+
+/* the next server frame, the super loop as can_bench.c runs it meanwhile */
+static bool receive(uint8_t data[8])
+{
+    CODRV_VBUS_MSG_T msg;
+
+    for (long n = 0; n < WAIT_PASSES; n++) {
+        while (codrvVbusReceive(CLIENT, &msg)) {
+            if (msg.canId == 0x580u + NODE_ID) {
+                memcpy(data, msg.data, 8);
+                frames++;
+                return true;
+            }
+        }
+        coCommTask();
+        log_domain_prefetch();
+    }
+    return false;
+}
+
+static void settle(void)
+{
+    for (int i = 0; i < 10; i++) {
+        coCommTask();
+        log_domain_prefetch();
+    }
+}
+
+/* the low 16 bits of the abort code the server answers with, 0 for none */
+static uint16_t abort_code(const uint8_t data[8])
+{
+    return (data[0] == SDO_ABORT) ? host_u16(&data[4]) : 0;
+}
+
+static void log_request(void)
+{
+    CHECK_EQ(coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_READ_FROM, 0), RET_OK);
+    CHECK_EQ(coOdPutObj_u32(I_CAN_LOG, S_CAN_LOG_READ_MAX, LOG_BYTES), RET_OK);
+}
+
+/* the CAN log at blockSize segments per block, the size or 0 on a failure */
+static uint32_t log_upload(uint8_t blockSize, uint8_t *data)
+{
+    uint8_t resp[8];
+    uint32_t size, got = 0;
+    uint8_t seqNo = 1, segments = 0;
+    int shortBlocks = 0;
+    bool last = false;
+
+    frames = 0;
+    log_request();
+    send(CO_SDO_CCS_BLOCK_UPLOAD, I_CAN_LOG & 0xFF, I_CAN_LOG >> 8, S_CAN_LOG_READ, blockSize);
+    if (!receive(resp) || ((resp[0] & 0xE1u) != CO_SDO_SCS_BLOCK_UPLOAD)) {
+        return 0;
+    }
+    CHECK(resp[0] & CO_SDO_SCS_BLOCK_UL_SIZE);
+    size = host_u16(&resp[4]);
+    CHECK(size > 0 && size <= LOG_BYTES);
+
+    send(CO_SDO_CCS_BLOCK_UPLOAD | CO_SDO_CCS_BLOCK_SC_UL_BLK, 0, 0, 0, 0);
+    while (!last) {
+        if (!receive(resp) || ((resp[0] & 0x7Fu) != seqNo) || (got + 7 > sizeof(logData))) {
+            return 0;
+        }
+        memcpy(&data[got], &resp[1], 7);
+        got += 7;
+        segments++;
+        last = (resp[0] & CO_SDO_SCS_BLOCK_UL_LAST) != 0;
+        if (last || (seqNo == blockSize)) {
+            /* only the last block may be short */
+            shortBlocks += segments != blockSize;
+            segments = 0;
+            send(CO_SDO_CCS_BLOCK_UPLOAD | CO_SDO_CCS_BLOCK_SC_UL_CON, seqNo, blockSize, 0, 0);
+            seqNo = 0;
+        }
+        seqNo++;
+    }
+    CHECK(shortBlocks <= 1);
+
+    if (!receive(resp) || ((resp[0] & 0xE3u) != (CO_SDO_SCS_BLOCK_UPLOAD | CO_SDO_SCS_BLOCK_SS_UL_END))) {
+        return 0;
+    }
+    got -= (resp[0] >> 2) & 0x07u;
+    send(CO_SDO_CCS_BLOCK_UPLOAD | CO_SDO_CCS_BLOCK_SC_UL_END, 0, 0, 0, 0);
+    settle();
+
+    CHECK_EQ(got, size);
+    return got;
+}
+
+/* "name: value" of the log_can_print_stats() text */
+static unsigned long stat(const char *text, const char *name)
+{
+    const char *p = strstr(text, name);
+    unsigned long value = 0;
+
+    CHECK(p != NULL);
+    if (p != NULL) {
+        sscanf(p + strlen(name), ": %lu", &value);
+    }
+    return value;
+}
+
+static void log_stats(unsigned long *chunks, unsigned long *prefetched, unsigned long *direct,
+                      unsigned long *completed, unsigned long *aborted)
+{
+    static char text[4096];
+
+    memset(text, 0, sizeof(text));
+    host_serial_capture(text, sizeof(text) - 1);
+    log_can_print_stats();
+    host_serial_capture(NULL, 0);
+
+    *chunks = stat(text, "domain chunks");
+    *prefetched = stat(text, "prefetched");
+    *direct = stat(text, "read in indication");
+    *completed = stat(text, "completed");
+    *aborted = stat(text, "aborted");
+}
+
+/*** tests ***/
+
+/* 0 and more than 127 are refused, at the start and in a block acknowledge */
+static void test_upload_block_size_limits(void)
+{
+    uint8_t resp[8];
+    unsigned long chunks, prefetched, direct, completed, aborted, abortedBefore;
+
+    log_stats(&chunks, &prefetched, &direct, &completed, &abortedBefore);
+
+    log_request();
+    send(CO_SDO_CCS_BLOCK_UPLOAD, I_CAN_LOG & 0xFF, I_CAN_LOG >> 8, S_CAN_LOG_READ, 0);
+    CHECK(receive(resp));
+    CHECK_EQ(abort_code(resp), ABORT_BLOCK_SIZE);
+
+    log_request();
+    send(CO_SDO_CCS_BLOCK_UPLOAD, I_CAN_LOG & 0xFF, I_CAN_LOG >> 8, S_CAN_LOG_READ, 128);
+    CHECK(receive(resp));
+    CHECK_EQ(abort_code(resp), ABORT_BLOCK_SIZE);
+
+    /* a first block of 2, then 0 for the next one */
+    log_request();
+    send(CO_SDO_CCS_BLOCK_UPLOAD, I_CAN_LOG & 0xFF, I_CAN_LOG >> 8, S_CAN_LOG_READ, 2);
+    CHECK(receive(resp));
+    CHECK_EQ(resp[0] & 0xE1u, CO_SDO_SCS_BLOCK_UPLOAD);
+    send(CO_SDO_CCS_BLOCK_UPLOAD | CO_SDO_CCS_BLOCK_SC_UL_BLK, 0, 0, 0, 0);
+    CHECK(receive(resp));
+    CHECK_EQ(resp[0], 1);
+    CHECK(receive(resp));
+    CHECK_EQ(resp[0], 2);
+    send(CO_SDO_CCS_BLOCK_UPLOAD | CO_SDO_CCS_BLOCK_SC_UL_CON, 2, 0, 0, 0);
+    CHECK(receive(resp));
+    CHECK_EQ(abort_code(resp), ABORT_BLOCK_SIZE);
+    settle();
+
+    /* the download that had started is aborted, the cursor stays */
+    log_stats(&chunks, &prefetched, &direct, &completed, &aborted);
+    CHECK_EQ(aborted - abortedBefore, 1);
+}
+
+/* the same log at every block size, fewer frames the larger the blocks */
+static void test_upload_block_sizes(void)
+{
+    static uint8_t first[sizeof(logData)];
+    const uint8_t sizes[] = { 1, 4, 32, 127 };
+    unsigned long chunks, prefetched, direct, completed, aborted;
+    unsigned long chunks0, prefetched0, direct0, completed0, aborted0;
+    uint32_t size = 0, lastFrames = 0xFFFFFFFFu;
+
+    for (unsigned s = 0; s < sizeof(sizes); s++) {
+        uint32_t got;
+
+        log_stats(&chunks0, &prefetched0, &direct0, &completed0, &aborted0);
+        memset(logData, 0, sizeof(logData));
+        got = log_upload(sizes[s], logData);
+        CHECK(got > 0);
+        if (s == 0) {
+            size = got;
+            memcpy(first, logData, sizeof(first));
+            /* a keyframe first, see log_can_download_start() */
+            CHECK_EQ(host_u16(logData), CAN_LOG_RECORD_HEADER(CAN_LOG_RECORD_KEYFRAME, CAN_LOG_RECORD_RAW_WORDS));
+        } else {
+            CHECK_EQ(got, size);
+            CHECK(memcmp(first, logData, size) == 0);
+        }
+        CHECK(frames < lastFrames);
+        lastFrames = frames;
+
+        /* the first chunk in the indication, each other one prefetched */
+        log_stats(&chunks, &prefetched, &direct, &completed, &aborted);
+        CHECK_EQ(completed - completed0, 1);
+        CHECK_EQ(aborted - aborted0, 0);
+        CHECK_EQ(chunks - chunks0, (size + 7 * CO_SSDO_DOMAIN_CNT - 1) / (7 * CO_SSDO_DOMAIN_CNT));
+        CHECK_EQ(direct - direct0, 1);
+        CHECK_EQ(prefetched - prefetched0, chunks - chunks0 - 1);
+        printf("sdo block: CAN log, %lu bytes at block size %3u in %4lu frames, %lu chunks prefetched\n",
+               (unsigned long)got, sizes[s], (unsigned long)frames, prefetched - prefetched0);
+    }
+}
+
+/* a block of blockSize where only the segment ending it arrives */
+static uint8_t download_lost_block(uint8_t blockSize)
+{
+    uint8_t resp[8];
+
+    send(blockSize, 0x11, 0x22, 0x33, 0x44);
+    if (!receive(resp)) {
+        return 0;
+    }
+    CHECK_EQ(resp[0], CO_SDO_SCS_BLOCK_DOWNLOAD | CO_SDO_SCS_BLOCK_SS_DL_ACQ);
+    /* nothing received of the block, it is sent again */
+    CHECK_EQ(resp[1], 0);
+    return resp[2];
+}
+
+/* 1017:00 by block download, the block size of the initiate response */
+static uint8_t download_start(void)
+{
+    uint8_t resp[8];
+
+    send(CO_SDO_CCS_BLOCK_DOWNLOAD, 0x17, 0x10, 0, 0);
+    CHECK(receive(resp));
+    CHECK_EQ(resp[0] & 0xE3u, CO_SDO_SCS_BLOCK_DOWNLOAD);
+    return resp[4];
+}
+
+static void download_end(uint16_t value)
+{
+    uint8_t resp[8];
+
+    /* the value in the last segment, 5 bytes of it not used */
+    send(CO_SDO_CCS_BLOCK_DL_LAST | 1, value & 0xFF, value >> 8, 0, 0);
+    CHECK(receive(resp));
+    CHECK_EQ(resp[0], CO_SDO_SCS_BLOCK_DOWNLOAD | CO_SDO_SCS_BLOCK_SS_DL_ACQ);
+    CHECK_EQ(resp[1], 1);
+    send(CO_SDO_CCS_BLOCK_DOWNLOAD | (5 << 2) | CO_SDO_CCS_BLOCK_CS_DL_END, 0, 0, 0, 0);
+    CHECK(receive(resp));
+    CHECK_EQ(resp[0], CO_SDO_SCS_BLOCK_DOWNLOAD | CO_SDO_SCS_BLOCK_SS_DL_END);
+    settle();
+}
+
+static void test_download_block_size(void)
+{
+    const uint8_t halved[] = { 63, 31, 15, 7, 4, 4 };
+    uint8_t blockSize;
+
+    blockSize = download_start();
+    CHECK_EQ(blockSize, CO_SDO_BLOCK_SIZE);
+    for (unsigned i = 0; i < sizeof(halved); i++) {
+        blockSize = download_lost_block(blockSize);
+        CHECK_EQ(blockSize, halved[i]);
+    }
+    download_end(1000);
+
+    /* the next download starts where the last one ended */
+    CHECK_EQ(download_start(), 4);
+    download_end(1000);
+    CHECK_EQ(download_start(), 4);
+    download_end(1000);
+}
+
+/* the bus time of the log download at the block sizes of can_bench */
+static void test_log_bus_time(void)
+{
+    can_bench_result_t small, large;
+    uint32_t kbit = codrvVbusBitRate();
+
+    log_request();
+    CHECK(can_bench_sdo(CAN_BENCH_SDO_BLOCK_UPLOAD, I_CAN_LOG, S_CAN_LOG_READ, 4, 1, &small));
+    log_request();
+    CHECK(can_bench_sdo(CAN_BENCH_SDO_BLOCK_UPLOAD, I_CAN_LOG, S_CAN_LOG_READ, 127, 1, &large));
+    CHECK_EQ(small.bytes, large.bytes);
+    CHECK(large.frames < small.frames);
+    CHECK(large.busBits < small.busBits);
+    printf("sdo block: CAN log %lu bytes at %lu kbit/s, %lu us at block size 4, %lu us at 127\n",
+           (unsigned long)large.bytes, (unsigned long)kbit,
+           (unsigned long)(small.busBits * 1000ul / kbit), (unsigned long)(large.busBits * 1000ul / kbit));
+}
+
+/*** set up as can_bench_host.c ***/
+
+static void run(uint32_t ms)
+{
+    uint64_t end = host_time_ns() + 1000000ULL * ms;
+
+    while (host_time_ns() < end) {
+        coCommTask();
+        log_can_state_machine();
+        ext_flash_task();
+        host_delay_us(100);
+    }
+}
+
+static void publish(uint32_t counter)
+{
+    uint16_t next = sharedVars_cpu2toCpu1.debug_log.published ^ 1;
+    debug_log_t *log = &sharedVars_cpu2toCpu1.debug_log.record[next];
+
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;
+    memset(log, 0, sizeof(*log));
+    log->counter = counter;
+    log->Vbus = (int16_t)(2400 + (counter & 0x3));
+    log->VStore = (int16_t)(counter / 3);
+    for (int c = 0; c < NUMBER_OF_CELLS; c++) {
+        log->cellVoltage[c] = (int16_t)(counter / 30 + c);
+    }
+    log->CurrentState = (int16_t)(counter % 5);
+    sharedVars_cpu2toCpu1.debug_log.sequence[next]++;
+    sharedVars_cpu2toCpu1.debug_log.published = next;
+}
+
+int main(void)
+{
+    nor_flash_config_t config;
+    CODRV_VBUS_MSG_T msg;
+
+    nor_flash_default_config(&config);
+    host_cpu1_init(&config);
+    codrvHardwareInit();
+    /* no stack timer, the SDO timeouts of the server do not run */
+    if (codrvCanInit(125) != RET_OK
+     || coCanOpenStackInit(NULL) != RET_OK
+     || coEventRegister_SDO_SERVER_READ(sdoServerReadInd) != RET_OK
+     || coEventRegister_SDO_SERVER_DOMAIN_READ(log_read_domain) != RET_OK
+     || coEventRegister_SDO_SERVER_DOMAIN_READ_FINISHED(log_read_domain_finished) != RET_OK) {
+        fprintf(stderr, "stack init failed\n");
+        return 1;
+    }
+    /* the client is on the bus from its first call */
+    (void)codrvVbusReceive(CLIENT, &msg);
+    if (codrvCanEnable() != RET_OK) {
+        fprintf(stderr, "can enable failed\n");
+        return 1;
+    }
+
+    ext_flash_reset();
+    ext_flash_config();
+    log_can_init();
+    for (uint32_t i = 1; i <= LOG_RECORDS; i++) {
+        publish(i);
+        run(10);
+    }
+    run(20);
+    while (codrvVbusReceive(CLIENT, &msg)) {
+    }
+    /* the model clock follows the host clock from here on, for can_bench.c */
+    host_cpu1_follow(real_ns);
+
+    test_upload_block_size_limits();
+    test_upload_block_sizes();
+    test_download_block_size();
+    test_log_bus_time();
+
+    return check_report("test_sdo_block");
+}
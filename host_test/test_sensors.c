@@ -0,0 +1,262 @@
+/*
+ * test_sensors.c - the sensor conversion table of sensors.c
+ *
+ *  ConvertSensorsCountsToReal() is checked against the conversion spelled
+ *  out from the Sensor_t parameters, for every channel over the ADC range,
+ *  after a calibration changes an offset and through the ADC ISRs. A copy
+ *  of the per-struct ConvertCountsToReal() the table replaced has to give
+ *  the same values, and both are timed per tick of all the sensors.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "check.h"
+#include "cpu2_hal.h"
+
+#include "sensors.h"
+
+static const uint16_t counts[] = { 0, 1, 1000, 21845, 32767, 32768, 50000, 65534, 65535 };
+
+/* the conversion the table folds, in double */
+static double reference(uint16_t sensorIdx, uint16_t count)
+{
+    const Sensor_t *sensor = &sensorVector[sensorIdx];
+    double voltage = sensor->adcReference * (double)count / sensor->maxCounts;
+
+    if (sensor->differentialADC) {
+        voltage = 2 * voltage - sensor->adcReference;
+    }
+    voltage = (voltage - sensor->zeroVoltageOffset) * sensor->gain;
+    return sensor->invertedGain ? -voltage : voltage;
+}
+
+/* float rounding of one multiply-add, relative to the full scale */
+static double tolerance(uint16_t sensorIdx)
+{
+    const Sensor_t *sensor = &sensorVector[sensorIdx];
+
+    return 1e-6 * sensor->gain * sensor->adcReference * 4;
+}
+
+static void test_table(void)
+{
+    InitializeSensorParameters();
+
+    for (uint16_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        for (uint16_t s = 0; s < NumOfSensors; s++) {
+            sensorConversion.counts[s] = counts[c];
+        }
+        ConvertSensorsCountsToReal();
+        for (uint16_t s = 0; s < NumOfSensors; s++) {
+            CHECK_NEAR(sensorVector[s].realValue, reference(s, counts[c]), tolerance(s));
+        }
+    }
+
+    /* a few known points: the bus is differential, mid scale is 0 V */
+    sensorConversion.counts[VBusIdx] = 32768;
+    sensorConversion.counts[ISen1fIdx] = 0;
+    ConvertSensorsCountsToReal();
+    CHECK_NEAR(sensorVector[VBusIdx].realValue, 0.0, 0.01);
+    CHECK_NEAR(sensorVector[ISen1fIdx].realValue, 1.52 * 20.0, 1e-3);
+}
+
+static void test_flags(void)
+{
+    for (uint16_t s = 0; s < NumOfSensors; s++) {
+        sensorVector[s].newADCReady = false;
+        sensorVector[s].convertedReady = false;
+    }
+    sensorVector[V_UpfIdx].newADCReady = true;
+    ConvertSensorsCountsToReal();
+
+    CHECK(sensorVector[V_UpfIdx].convertedReady);
+    CHECK(!sensorVector[V_UpfIdx].newADCReady);
+    CHECK(!sensorVector[V_DwnfIdx].convertedReady);
+
+    /* converted stays set until the next sample arrives */
+    ConvertSensorsCountsToReal();
+    CHECK(sensorVector[V_UpfIdx].convertedReady);
+}
+
+static void test_calibration(void)
+{
+    double before;
+
+    InitializeSensorParameters();
+    sensorConversion.counts[ISen2fIdx] = 33000;
+    ConvertSensorsCountsToReal();
+    before = sensorVector[ISen2fIdx].realValue;
+
+    /* the offset the calibration finds, folded into the table */
+    sensorVector[ISen2fIdx].zeroVoltageOffset = SensorCountsToAdcVoltage(ISen2fIdx);
+    UpdateSensorConversion(ISen2fIdx);
+    ConvertSensorsCountsToReal();
+    CHECK_NEAR(sensorVector[ISen2fIdx].realValue, 0.0, tolerance(ISen2fIdx));
+    CHECK(fabs(before) > 0.1);
+
+    for (uint16_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        sensorConversion.counts[ISen2fIdx] = counts[c];
+        ConvertSensorsCountsToReal();
+        CHECK_NEAR(sensorVector[ISen2fIdx].realValue, reference(ISen2fIdx, counts[c]), tolerance(ISen2fIdx));
+        CHECK_NEAR(SensorCountsToAdcVoltage(ISen2fIdx), 3.0 * counts[c] / 65535, 1e-6);
+    }
+}
+
+static void test_isr(void)
+{
+    InitializeSensorParameters();
+    host_adc_set(ADCARESULT_BASE, ADC_SOC_NUMBER0, 40000);
+    host_adc_set(ADCARESULT_BASE, ADC_SOC_NUMBER1, 45000);
+    host_adc_set(ADCDRESULT_BASE, ADC_SOC_NUMBER0, 12345);
+    host_adc_set(ADCDRESULT_BASE, ADC_SOC_NUMBER1, 23456);
+    sensorVector[VBusIdx].newADCReady = false;
+
+    INT_ADCINA_2_ISR();
+    INT_ADCIND_3_ISR();
+    CHECK_EQ(sensorConversion.counts[VBusIdx], 40000);
+    CHECK_EQ(sensorConversion.counts[VStoreIdx], 45000);
+    CHECK_EQ(sensorConversion.counts[V_DwnfIdx], 12345);
+    CHECK_EQ(sensorConversion.counts[V_UpfIdx], 23456);
+    CHECK(sensorVector[VBusIdx].newADCReady);
+    CHECK(!sensorVector[VBusIdx].convertedReady);
+
+    ConvertSensorsCountsToReal();
+    CHECK_NEAR(sensorVector[VBusIdx].realValue, reference(VBusIdx, 40000), tolerance(VBusIdx));
+    CHECK_NEAR(sensorVector[V_UpfIdx].realValue, reference(V_UpfIdx, 23456), tolerance(V_UpfIdx));
+    CHECK(sensorVector[VStoreIdx].convertedReady);
+}
+
+/*** the per-struct conversion of sensors.c the table replaced ***/
+
+typedef struct SensorByStruct {
+    char* name;
+    float realValue;
+    uint16_t counts;
+    bool newADCReady;
+    uint16_t maxCounts;
+    float zeroVoltageOffset;
+    float adcReference;
+    float gain;
+    bool invertedGain;
+    bool differentialADC;
+    bool convertedReady;
+} SensorByStruct_t;
+
+static SensorByStruct_t sensorByStruct[NumOfSensors];
+
+static void ConvertCountsToReal( SensorByStruct_t *sensor) {
+    if( sensor->newADCReady ) {
+
+        if( sensor->differentialADC ) {
+            sensor->realValue =  sensor->adcReference * ( ( 2 * (float)sensor->counts / (float)sensor->maxCounts ) -1 );
+        } else {
+            sensor->realValue = ( sensor->adcReference * ( (float)sensor->counts / (float)sensor->maxCounts ) );
+        }
+        if( sensor->invertedGain ) {
+            sensor->realValue = ( sensor->zeroVoltageOffset - sensor->realValue ) * sensor->gain;
+        } else {
+            sensor->realValue = ( sensor->realValue - sensor->zeroVoltageOffset ) * sensor->gain;
+        }
+        sensor->newADCReady = false;
+        sensor->convertedReady = true;
+    }
+}
+
+__attribute__((noinline))
+static void ConvertSensorsCountsToRealByStruct(void) {
+    uint16_t sensorIdx;
+
+    for(sensorIdx = 0; sensorIdx < NumOfSensors; sensorIdx++){
+        ConvertCountsToReal( &sensorByStruct[sensorIdx] );
+    }
+}
+
+static void by_struct_init(void)
+{
+    for (uint16_t s = 0; s < NumOfSensors; s++) {
+        sensorByStruct[s].maxCounts = sensorVector[s].maxCounts;
+        sensorByStruct[s].zeroVoltageOffset = sensorVector[s].zeroVoltageOffset;
+        sensorByStruct[s].adcReference = sensorVector[s].adcReference;
+        sensorByStruct[s].gain = sensorVector[s].gain;
+        sensorByStruct[s].invertedGain = sensorVector[s].invertedGain;
+        sensorByStruct[s].differentialADC = sensorVector[s].differentialADC;
+    }
+}
+
+/* a new sample of every sensor, as the four ADC ISRs leave them */
+static void sample(uint32_t tick)
+{
+    for (uint16_t s = 0; s < NumOfSensors; s++) {
+        uint16_t count = (uint16_t)(tick * 2654435761u >> (s + 8));
+
+        sensorConversion.counts[s] = count;
+        sensorVector[s].newADCReady = true;
+        sensorByStruct[s].counts = count;
+        sensorByStruct[s].newADCReady = true;
+    }
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#define BENCH_TICKS 1000000
+
+static void test_bench(void)
+{
+    int64_t t0, byStruct = 0, table = 0, clockRead = 0;
+
+    InitializeSensorParameters();
+    by_struct_init();
+
+    /* the same values as the division and the branches per sensor */
+    for (uint32_t tick = 0; tick < 10000; tick++) {
+        sample(tick);
+        ConvertSensorsCountsToRealByStruct();
+        ConvertSensorsCountsToReal();
+        for (uint16_t s = 0; s < NumOfSensors; s++) {
+            CHECK_NEAR(sensorVector[s].realValue, sensorByStruct[s].realValue, tolerance(s));
+            CHECK(sensorVector[s].convertedReady && sensorByStruct[s].convertedReady);
+        }
+    }
+
+    /* the samples are written outside the timed part, as the ISRs do, and
+     * the cost of reading the clock is taken off */
+    for (uint32_t tick = 0; tick < BENCH_TICKS; tick++) {
+        t0 = now_ns();
+        clockRead += now_ns() - t0;
+
+        sample(tick);
+        t0 = now_ns();
+        ConvertSensorsCountsToRealByStruct();
+        byStruct += now_ns() - t0;
+
+        sample(tick);
+        t0 = now_ns();
+        ConvertSensorsCountsToReal();
+        table += now_ns() - t0;
+    }
+
+    printf("sensors: %d sensors per tick, per-struct conversion %.1f ns, table %.1f ns\n",
+           NumOfSensors, (double)(byStruct - clockRead) / BENCH_TICKS, (double)(table - clockRead) / BENCH_TICKS);
+}
+
+int main(void)
+{
+    test_table();
+    test_flags();
+    test_calibration();
+    test_isr();
+    test_bench();
+
+    return check_report("test_sensors");
+}